@@ -0,0 +1,595 @@
+// Track fitting, key quantisation, the clip file and the sampler
+#include "AnimationClip.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <emmintrin.h>
+#include <fstream>
+
+namespace
+{
+	constexpr uint32_t c_Magic = 0x4d494e41;		//"ANIM"
+	constexpr uint32_t c_Version = 1;
+	constexpr uint32_t c_MaxName = 260;
+	constexpr uint32_t c_MaxClips = 1024;
+	constexpr uint32_t c_MaxFrames = 65536;
+	constexpr uint32_t c_MaxTracks = 4096;
+	constexpr uint32_t c_MaxKeys = 1u << 24;
+
+	constexpr float c_ComponentRange = 0.70710678f;		//no component but the largest of a unit quaternion is bigger
+	constexpr float c_ComponentSteps = 32767.0f;
+
+	template<typename T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValue(std::ifstream& file, T& value)
+	{
+		return bool(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	void WriteString(std::ofstream& file, const std::string& value)
+	{
+		WriteValue(file, static_cast<uint32_t>(value.size()));
+		file.write(value.data(), value.size());
+	}
+
+	bool ReadString(std::ifstream& file, std::string& value)
+	{
+		uint32_t length;
+		if (!ReadValue(file, length) || length > c_MaxName)
+		{
+			return false;
+		}
+		value.resize(length);
+		return length == 0 || bool(file.read(&value[0], length));
+	}
+
+	template<typename T>
+	void WriteArray(std::ofstream& file, const std::vector<T>& values)
+	{
+		WriteValue(file, static_cast<uint32_t>(values.size()));
+		file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadArray(std::ifstream& file, std::vector<T>& values)
+	{
+		uint32_t count;
+		if (!ReadValue(file, count) || count > c_MaxKeys)
+		{
+			return false;
+		}
+		values.resize(count);
+		return count == 0 || bool(file.read(reinterpret_cast<char*>(values.data()), count * sizeof(T)));
+	}
+
+	bool EqualNames(const std::string& a, const std::string& b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+		{
+			return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+		});
+	}
+
+	void NormalizeQuaternion(float* q)
+	{
+		float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		for (int i = 0; i < 4; ++i)
+		{
+			q[i] *= scale;
+		}
+		if (length <= 0.0f)
+		{
+			q[3] = 1.0f;
+		}
+	}
+
+	// Normalised lerp, b flipped onto a's side so the blend takes the shorter arc
+	void Nlerp(const float* a, const float* b, float t, float* out)
+	{
+		float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+		float tb = dot < 0.0f ? -t : t;
+		float ta = 1.0f - t;
+		for (int i = 0; i < 4; ++i)
+		{
+			out[i] = a[i] * ta + b[i] * tb;
+		}
+		NormalizeQuaternion(out);
+	}
+
+	// Angle between two rotations from the chord between them, acos of their dot loses small angles to rounding
+	float RotationError(const float* a, const float* b)
+	{
+		float sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f ? -1.0f : 1.0f;
+		float x = a[0] - b[0] * sign, y = a[1] - b[1] * sign, z = a[2] - b[2] * sign, w = a[3] - b[3] * sign;
+		return 4.0f * std::asin(std::min(std::sqrt(x * x + y * y + z * z + w * w) * 0.5f, 1.0f));
+	}
+
+	float TranslationError(const float* a, const float* b)
+	{
+		float x = a[0] - b[0], y = a[1] - b[1], z = a[2] - b[2];
+		return std::sqrt(x * x + y * y + z * z);
+	}
+
+	uint16_t QuantizeComponent(float value)
+	{
+		float unit = std::min(std::max(value / c_ComponentRange, -1.0f), 1.0f) * 0.5f + 0.5f;
+		return static_cast<uint16_t>(unit * c_ComponentSteps + 0.5f);
+	}
+
+	float DequantizeComponent(uint16_t value)
+	{
+		return ((value & 0x7fff) / c_ComponentSteps * 2.0f - 1.0f) * c_ComponentRange;
+	}
+
+	// Smallest three: the largest component is made positive and dropped, its index goes in the top bits
+	void QuantizeRotation(const float* rotation, uint16_t* packed)
+	{
+		float q[4] = { rotation[0], rotation[1], rotation[2], rotation[3] };
+		NormalizeQuaternion(q);
+		int largest = 0;
+		for (int i = 1; i < 4; ++i)
+		{
+			if (std::fabs(q[i]) > std::fabs(q[largest]))
+			{
+				largest = i;
+			}
+		}
+		float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+		for (int i = 0, out = 0; i < 4; ++i)
+		{
+			if (i != largest)
+			{
+				packed[out++] = QuantizeComponent(q[i] * sign);
+			}
+		}
+		packed[0] |= static_cast<uint16_t>((largest & 1) << 15);
+		packed[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+	}
+
+	// Where the three stored components go for each dropped one, a table rather than a branch per component
+	constexpr int c_Stored[4][3] = { { 1, 2, 3 }, { 0, 2, 3 }, { 0, 1, 3 }, { 0, 1, 2 } };
+
+	void DequantizeRotation(const uint16_t* packed, float* rotation)
+	{
+		int largest = (packed[0] >> 15) | ((packed[1] >> 15) << 1);
+		float a = DequantizeComponent(packed[0]), b = DequantizeComponent(packed[1]), c = DequantizeComponent(packed[2]);
+		const int* stored = c_Stored[largest];
+		rotation[stored[0]] = a;
+		rotation[stored[1]] = b;
+		rotation[stored[2]] = c;
+		rotation[largest] = std::sqrt(std::max(1.0f - (a * a + b * b + c * c), 0.0f));
+	}
+
+	// Keys for one channel of one track: the first frame, then each frame that the span from the previous key can't
+	// reach without missing a frame in between by more than the tolerance, then the last frame. Error is measured
+	// against the decoded keys, so quantisation counts against the tolerance as well.
+	template<typename Decode, typename Interpolate, typename Error>
+	std::vector<uint32_t> FitKeys(uint32_t frameCount, float tolerance, Decode decode, Interpolate interpolate, Error error)
+	{
+		std::vector<uint32_t> keys(1, 0);
+		float start[4], end[4], between[4], value[4];
+		uint32_t key = 0;
+		while (key + 1 < frameCount)
+		{
+			decode(key, start);
+			uint32_t reach = key + 1;
+			for (uint32_t candidate = key + 2; candidate < frameCount; ++candidate)
+			{
+				decode(candidate, end);
+				bool fits = true;
+				for (uint32_t frame = key + 1; frame < candidate && fits; ++frame)
+				{
+					interpolate(start, end, float(frame - key) / float(candidate - key), between);
+					decode(frame, value);
+					fits = error(between, value) <= tolerance;
+				}
+				if (!fits)
+				{
+					break;
+				}
+				reach = candidate;
+			}
+			keys.push_back(reach);
+			key = reach;
+		}
+
+		// Two keys that decode alike are a constant channel, one key holds it
+		if (keys.size() == 2)
+		{
+			decode(keys[0], start);
+			decode(keys[1], end);
+			if (error(start, end) == 0.0f)
+			{
+				keys.pop_back();
+			}
+		}
+		return keys;
+	}
+
+	// Finds the key at or before frame from the cursor, stepping on when the clip moves forward and searching when it
+	// jumps back
+	uint32_t FindKey(const uint16_t* frames, uint32_t count, float frame, uint32_t cursor)
+	{
+		if (cursor >= count || frames[cursor] > frame)
+		{
+			return static_cast<uint32_t>(std::upper_bound(frames, frames + count, frame,
+				[](float value, uint16_t key) { return value < key; }) - frames) - 1;
+		}
+		while (cursor + 1 < count && frames[cursor + 1] <= frame)
+		{
+			++cursor;
+		}
+		return cursor;
+	}
+}
+
+AnimationClip::AnimationClip() :
+	m_sampleRate(30.0f),
+	m_frameCount(0)
+{
+}
+
+bool AnimationClip::Reset(const std::string & name, float sampleRate, uint32_t frameCount)
+{
+	m_boneNames.clear();
+	m_tracks.clear();
+	m_rotationFrames.clear();
+	m_rotations.clear();
+	m_translationFrames.clear();
+	m_translations.clear();
+	m_name = name;
+	m_sampleRate = sampleRate;
+	bool valid = frameCount > 0 && frameCount <= c_MaxFrames && sampleRate > 0.0f;
+	m_frameCount = valid ? frameCount : 0;
+	return valid;
+}
+
+bool AnimationClip::AddTrack(const std::string & bone, const BonePose * frames, float rotationTolerance, float translationTolerance)
+{
+	if (m_frameCount == 0 || m_tracks.size() >= c_MaxTracks)
+	{
+		return false;
+	}
+	for (const std::string& name : m_boneNames)
+	{
+		if (EqualNames(name, bone))
+		{
+			return false;
+		}
+	}
+
+	Track track = {};
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float low = frames[0].translation[axis], high = low;
+		for (uint32_t frame = 1; frame < m_frameCount; ++frame)
+		{
+			low = std::min(low, frames[frame].translation[axis]);
+			high = std::max(high, frames[frame].translation[axis]);
+		}
+		track.translationMin[axis] = low;
+		track.translationStep[axis] = (high - low) / 65535.0f;
+	}
+
+	std::vector<QuantizedRotation> rotations(m_frameCount);
+	std::vector<QuantizedTranslation> translations(m_frameCount);
+	for (uint32_t frame = 0; frame < m_frameCount; ++frame)
+	{
+		QuantizeRotation(frames[frame].rotation, rotations[frame].packed);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float step = track.translationStep[axis];
+			float value = step > 0.0f ? (frames[frame].translation[axis] - track.translationMin[axis]) / step : 0.0f;
+			translations[frame].value[axis] = static_cast<uint16_t>(std::min(std::max(value + 0.5f, 0.0f), 65535.0f));
+		}
+	}
+
+	// Both the keys and the frames between them are the quantised frames, what a key can't hold isn't there to lose
+	auto rotationKeys = FitKeys(m_frameCount, rotationTolerance,
+		[&](uint32_t frame, float* q) { DequantizeRotation(rotations[frame].packed, q); },
+		Nlerp,
+		[&](const float* interpolated, const float* decoded) { return RotationError(interpolated, decoded); });
+	auto translationKeys = FitKeys(m_frameCount, translationTolerance,
+		[&](uint32_t frame, float* t)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				t[axis] = track.translationMin[axis] + translations[frame].value[axis] * track.translationStep[axis];
+			}
+		},
+		[](const float* a, const float* b, float t, float* out)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				out[axis] = a[axis] + (b[axis] - a[axis]) * t;
+			}
+		},
+		[](const float* interpolated, const float* decoded) { return TranslationError(interpolated, decoded); });
+
+	track.firstRotation = static_cast<uint32_t>(m_rotations.size());
+	track.rotationCount = static_cast<uint32_t>(rotationKeys.size());
+	for (uint32_t frame : rotationKeys)
+	{
+		m_rotationFrames.push_back(static_cast<uint16_t>(frame));
+		m_rotations.push_back(rotations[frame]);
+	}
+	track.firstTranslation = static_cast<uint32_t>(m_translations.size());
+	track.translationCount = static_cast<uint32_t>(translationKeys.size());
+	for (uint32_t frame : translationKeys)
+	{
+		m_translationFrames.push_back(static_cast<uint16_t>(frame));
+		m_translations.push_back(translations[frame]);
+	}
+
+	m_boneNames.push_back(bone);
+	m_tracks.push_back(track);
+	return true;
+}
+
+size_t AnimationClip::GetDataSize() const
+{
+	return m_tracks.size() * sizeof(Track)
+		+ m_rotations.size() * (sizeof(QuantizedRotation) + sizeof(uint16_t))
+		+ m_translations.size() * (sizeof(QuantizedTranslation) + sizeof(uint16_t));
+}
+
+bool AnimationClip::Save(const std::string & path, const std::vector<AnimationClip>& clips)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	WriteValue(file, c_Magic);
+	WriteValue(file, c_Version);
+	WriteValue(file, static_cast<uint32_t>(clips.size()));
+	for (const AnimationClip& clip : clips)
+	{
+		WriteString(file, clip.m_name);
+		WriteValue(file, clip.m_sampleRate);
+		WriteValue(file, clip.m_frameCount);
+		WriteValue(file, clip.GetTrackCount());
+		for (uint32_t i = 0; i < clip.GetTrackCount(); ++i)
+		{
+			WriteString(file, clip.m_boneNames[i]);
+			WriteValue(file, clip.m_tracks[i]);
+		}
+		WriteArray(file, clip.m_rotationFrames);
+		WriteArray(file, clip.m_rotations);
+		WriteArray(file, clip.m_translationFrames);
+		WriteArray(file, clip.m_translations);
+	}
+	return file.good();
+}
+
+bool AnimationClip::Load(const std::string & path, std::vector<AnimationClip>& clips)
+{
+	clips.clear();
+
+	std::ifstream file(path, std::ios::binary);
+	uint32_t magic, version, count;
+	if (!file || !ReadValue(file, magic) || magic != c_Magic || !ReadValue(file, version) || version != c_Version
+		|| !ReadValue(file, count) || count > c_MaxClips)
+	{
+		return false;
+	}
+
+	clips.resize(count);
+	for (AnimationClip& clip : clips)
+	{
+		uint32_t trackCount;
+		if (!ReadString(file, clip.m_name) || !ReadValue(file, clip.m_sampleRate) || !(clip.m_sampleRate > 0.0f)
+			|| !ReadValue(file, clip.m_frameCount) || clip.m_frameCount == 0 || clip.m_frameCount > c_MaxFrames
+			|| !ReadValue(file, trackCount) || trackCount > c_MaxTracks)
+		{
+			clips.clear();
+			return false;
+		}
+
+		clip.m_boneNames.resize(trackCount);
+		clip.m_tracks.resize(trackCount);
+		for (uint32_t i = 0; i < trackCount; ++i)
+		{
+			if (!ReadString(file, clip.m_boneNames[i]) || !ReadValue(file, clip.m_tracks[i]))
+			{
+				clips.clear();
+				return false;
+			}
+		}
+		if (!ReadArray(file, clip.m_rotationFrames) || !ReadArray(file, clip.m_rotations)
+			|| !ReadArray(file, clip.m_translationFrames) || !ReadArray(file, clip.m_translations)
+			|| clip.m_rotationFrames.size() != clip.m_rotations.size()
+			|| clip.m_translationFrames.size() != clip.m_translations.size())
+		{
+			clips.clear();
+			return false;
+		}
+
+		// Every channel starts at frame 0 with its keys in order inside the clip, the sampler relies on it
+		auto validKeys = [&](const std::vector<uint16_t>& frames, uint32_t first, uint32_t keyCount)
+		{
+			if (keyCount == 0 || first > frames.size() || keyCount > frames.size() - first || frames[first] != 0)
+			{
+				return false;
+			}
+			for (uint32_t key = first + 1; key < first + keyCount; ++key)
+			{
+				if (frames[key] <= frames[key - 1])
+				{
+					return false;
+				}
+			}
+			return frames[first + keyCount - 1] < clip.m_frameCount;
+		};
+		for (const Track& track : clip.m_tracks)
+		{
+			if (!validKeys(clip.m_rotationFrames, track.firstRotation, track.rotationCount)
+				|| !validKeys(clip.m_translationFrames, track.firstTranslation, track.translationCount))
+			{
+				clips.clear();
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void AnimationClip::SampleTrack(const Track & track, float frame, uint32_t & rotationCursor, uint32_t & translationCursor, BonePose & pose) const
+{
+	const uint16_t* rotationFrames = m_rotationFrames.data() + track.firstRotation;
+	const QuantizedRotation* rotations = m_rotations.data() + track.firstRotation;
+	rotationCursor = FindKey(rotationFrames, track.rotationCount, frame, rotationCursor);
+	if (rotationCursor + 1 < track.rotationCount)
+	{
+		float a[4], b[4];
+		DequantizeRotation(rotations[rotationCursor].packed, a);
+		DequantizeRotation(rotations[rotationCursor + 1].packed, b);
+		float t = (frame - rotationFrames[rotationCursor]) / float(rotationFrames[rotationCursor + 1] - rotationFrames[rotationCursor]);
+		Nlerp(a, b, t, pose.rotation);
+	}
+	else
+	{
+		DequantizeRotation(rotations[rotationCursor].packed, pose.rotation);
+	}
+
+	const uint16_t* translationFrames = m_translationFrames.data() + track.firstTranslation;
+	const QuantizedTranslation* translations = m_translations.data() + track.firstTranslation;
+	translationCursor = FindKey(translationFrames, track.translationCount, frame, translationCursor);
+	const QuantizedTranslation& a = translations[translationCursor];
+	float t = 0.0f;
+	const QuantizedTranslation* b = &a;
+	if (translationCursor + 1 < track.translationCount)
+	{
+		b = &translations[translationCursor + 1];
+		t = (frame - translationFrames[translationCursor]) / float(translationFrames[translationCursor + 1] - translationFrames[translationCursor]);
+	}
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float value = a.value[axis] + (float(b->value[axis]) - float(a.value[axis])) * t;
+		pose.translation[axis] = track.translationMin[axis] + value * track.translationStep[axis];
+	}
+}
+
+ClipSampler::ClipSampler() :
+	m_clip(nullptr)
+{
+}
+
+void ClipSampler::Bind(const AnimationClip * clip, const Rig & rig)
+{
+	m_clip = clip;
+	m_tracks.clear();
+	m_bones.clear();
+	if (clip)
+	{
+		for (uint32_t track = 0; track < clip->GetTrackCount(); ++track)
+		{
+			uint32_t bone = rig.Find(clip->GetBoneName(track));
+			if (bone != Rig::c_NoBone)
+			{
+				m_tracks.push_back(track);
+				m_bones.push_back(bone);
+			}
+		}
+	}
+	m_rotationCursors.assign(m_tracks.size(), 0);
+	m_translationCursors.assign(m_tracks.size(), 0);
+}
+
+void ClipSampler::Sample(float time, bool loop, BonePose * pose)
+{
+	if (!m_clip)
+	{
+		return;
+	}
+
+	float frame = GetFrame(time, loop);
+	for (size_t i = 0; i < m_tracks.size(); ++i)
+	{
+		m_clip->SampleTrack(m_clip->m_tracks[m_tracks[i]], frame, m_rotationCursors[i], m_translationCursors[i], pose[m_bones[i]]);
+	}
+}
+
+void ClipSampler::Sample(float time, bool loop, float * lane, const uint32_t * offsets, size_t stride)
+{
+	if (!m_clip)
+	{
+		return;
+	}
+
+	float frame = GetFrame(time, loop);
+	for (size_t i = 0; i < m_tracks.size(); ++i)
+	{
+		BonePose pose;
+		m_clip->SampleTrack(m_clip->m_tracks[m_tracks[i]], frame, m_rotationCursors[i], m_translationCursors[i], pose);
+		float* out = lane + offsets[m_bones[i]];
+		for (size_t e = 0; e < 4; ++e)
+		{
+			out[e * stride] = pose.rotation[e];
+		}
+		for (size_t e = 0; e < 3; ++e)
+		{
+			out[(4 + e) * stride] = pose.translation[e];
+		}
+	}
+}
+
+float ClipSampler::GetFrame(float time, bool loop) const
+{
+	float last = float(m_clip->m_frameCount - 1);
+	float frame = time * m_clip->m_sampleRate;
+	if (loop && last > 0.0f)
+	{
+		frame = std::fmod(frame, last);
+		if (frame < 0.0f)
+		{
+			frame += last;
+		}
+	}
+	return std::min(std::max(frame, 0.0f), last);
+}
+
+void BlendPoses(const BonePose * a, const BonePose * b, float weight, size_t count, BonePose * out)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		Nlerp(a[i].rotation, b[i].rotation, weight, out[i].rotation);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			out[i].translation[axis] = a[i].translation[axis] + (b[i].translation[axis] - a[i].translation[axis]) * weight;
+		}
+	}
+}
+
+void ComposeBoneTransforms(const BonePose * pose, const float * bind, size_t count, float * local)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float* q = pose[i].rotation;
+		float xx = q[0] * q[0], yy = q[1] * q[1], zz = q[2] * q[2];
+		float xy = q[0] * q[1], xz = q[0] * q[2], yz = q[1] * q[2];
+		float wx = q[3] * q[0], wy = q[3] * q[1], wz = q[3] * q[2];
+
+		// Rotation and translation rows as DirectXMath builds them, each broadcast against the bind rows
+		const float* in = bind + i * 16;
+		__m128 b0 = _mm_loadu_ps(in), b1 = _mm_loadu_ps(in + 4), b2 = _mm_loadu_ps(in + 8), b3 = _mm_loadu_ps(in + 12);
+		auto row = [&](float x, float y, float z)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(x), b0), _mm_mul_ps(_mm_set1_ps(y), b1)), _mm_mul_ps(_mm_set1_ps(z), b2));
+		};
+		float* out = local + i * 16;
+		_mm_storeu_ps(out, row(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy)));
+		_mm_storeu_ps(out + 4, row(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx)));
+		_mm_storeu_ps(out + 8, row(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy)));
+		const float* t = pose[i].translation;
+		_mm_storeu_ps(out + 12, _mm_add_ps(row(t[0], t[1], t[2]), b3));
+	}
+}
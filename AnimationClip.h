@@ -0,0 +1,128 @@
+//
+// AnimationClip.h - Compressed keyframe clips for rigidly animated bones, their sampler and pose blending
+//
+// A clip has one track per animated bone, matched to the model's bones by name so the file doesn't depend on one
+// model's bone order. A track's pose is a rotation then a translation applied before the bone's bind transform, so a
+// bone without a track, or with the identity pose, stays at rest. Tracks are fitted to one sample per frame when the
+// clip is built: a key is only kept where interpolating from the previous key can't reproduce the frames in between
+// within a tolerance. Rotations are stored smallest three (the largest component dropped and the other three in 15 bits
+// each, 6 bytes a key), translations in 16 bits per axis across the track's range.
+//
+// ClipSampler keeps a key cursor per track, so a clip played forward finds its keys without searching, and a Sample
+// walks the tracks in order, each one's keys next to each other.
+//
+
+#pragma once
+
+#include "Rig.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BonePose
+{
+	float	rotation[4];		//quaternion x, y, z, w
+	float	translation[3];
+
+	static BonePose Identity() { return { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } }; }
+};
+
+class AnimationClip
+{
+public:
+	AnimationClip();
+
+	//Empty clip of frameCount frames at sampleRate a second, the first at time 0 and the last at GetDuration().
+	//False for no frames or more than 65536.
+	bool Reset(const std::string& name, float sampleRate, uint32_t frameCount);
+
+	//Fits a track to one pose per frame. The tolerances are the largest error kept, in radians and in model units.
+	//False if the clip already has a track for the bone.
+	bool AddTrack(const std::string& bone, const BonePose* frames, float rotationTolerance, float translationTolerance);
+
+	const std::string& GetName() const { return m_name; }
+	float GetSampleRate() const { return m_sampleRate; }
+	uint32_t GetFrameCount() const { return m_frameCount; }
+	float GetDuration() const { return m_frameCount > 1 ? (m_frameCount - 1) / m_sampleRate : 0.0f; }
+
+	uint32_t GetTrackCount() const { return static_cast<uint32_t>(m_tracks.size()); }
+	const std::string& GetBoneName(uint32_t track) const { return m_boneNames[track]; }
+	size_t GetKeyCount() const { return m_rotations.size() + m_translations.size(); }
+	size_t GetDataSize() const;		//bytes of tracks and keys
+
+	//Every clip of a file, in order
+	static bool Save(const std::string& path, const std::vector<AnimationClip>& clips);
+	static bool Load(const std::string& path, std::vector<AnimationClip>& clips);
+
+private:
+	friend class ClipSampler;
+
+	struct QuantizedRotation
+	{
+		uint16_t	packed[3];		//15 bits a component, the dropped component's index in the top bits of the first two
+	};
+
+	struct QuantizedTranslation
+	{
+		uint16_t	value[3];
+	};
+
+	struct Track
+	{
+		uint32_t	firstRotation;
+		uint32_t	rotationCount;
+		uint32_t	firstTranslation;
+		uint32_t	translationCount;
+		float		translationMin[3];
+		float		translationStep[3];		//the track's range over 65535
+	};
+
+	void SampleTrack(const Track& track, float frame, uint32_t& rotationCursor, uint32_t& translationCursor, BonePose& pose) const;
+
+	std::string							m_name;
+	float								m_sampleRate;
+	uint32_t							m_frameCount;
+	std::vector<std::string>			m_boneNames;
+	std::vector<Track>					m_tracks;
+	std::vector<uint16_t>				m_rotationFrames;		//frame of each key, in the same order as the keys
+	std::vector<QuantizedRotation>		m_rotations;
+	std::vector<uint16_t>				m_translationFrames;
+	std::vector<QuantizedTranslation>	m_translations;
+};
+
+//Plays one clip on a skeleton
+class ClipSampler
+{
+public:
+	ClipSampler();
+
+	//Matches the clip's tracks to the rig's bones by name, ignoring case. Tracks of bones the rig hasn't got are skipped.
+	void Bind(const AnimationClip* clip, const Rig& rig);
+	const AnimationClip* GetClip() const { return m_clip; }
+
+	//Every track at time in seconds into pose, which has one entry per bone. Time wraps into the clip when looping and
+	//is clamped otherwise. Bones without a track are left as they were.
+	void Sample(float time, bool loop, BonePose* pose);
+
+	//The same into one instance's lanes of pose blocks, see BoneHierarchy.h: a bone's pose starts at lane +
+	//offsets[bone], its rotation then translation stride floats apart
+	void Sample(float time, bool loop, float* lane, const uint32_t* offsets, size_t stride);
+
+private:
+	float GetFrame(float time, bool loop) const;
+
+	const AnimationClip*	m_clip;
+	std::vector<uint32_t>	m_tracks;				//bound tracks, in the clip's order
+	std::vector<uint32_t>	m_bones;				//bone of each bound track
+	std::vector<uint32_t>	m_rotationCursors;		//key the last sample started from, per bound track
+	std::vector<uint32_t>	m_translationCursors;
+};
+
+//Per bone from a to b by weight (0 is all a), rotations along the shorter arc
+void BlendPoses(const BonePose* a, const BonePose* b, float weight, size_t count, BonePose* out);
+
+//Each bone's local transform: its pose's rotation, then translation, then its bind transform. Matrices are row major
+//for row vectors, 16 floats a bone, as DirectXMath stores them.
+void ComposeBoneTransforms(const BonePose* pose, const float* bind, size_t count, float* local);
@@ -0,0 +1,225 @@
+// Crowd instances, their LOD and the parallel posing pass
+#include "AnimationCrowd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+	constexpr size_t c_Lanes = BoneHierarchy::c_Lanes;
+	constexpr size_t c_BlocksPerTask = 4;
+
+	static_assert(Rig::c_NoBone == BoneHierarchy::c_NoParent, "the rig's parents go to the hierarchy as they are");
+}
+
+AnimationCrowd::AnimationCrowd() :
+	m_clips(nullptr),
+	m_lodDistances{ 20.0f, 40.0f, 80.0f },
+	m_frame(0),
+	m_posedCount(0)
+{
+}
+
+bool AnimationCrowd::Init(const std::vector<AnimationClip>* clips, const Rig & rig)
+{
+	Reset();
+	if (!clips || !m_hierarchy.SetHierarchy(rig.GetParents(), rig.GetCount()))
+	{
+		return false;
+	}
+
+	m_clips = clips;
+	m_bind.assign(rig.GetBind(), rig.GetBind() + rig.GetCount() * 16);
+	m_clipSamplers.resize(clips->size());
+	for (size_t clip = 0; clip < clips->size(); ++clip)
+	{
+		m_clipSamplers[clip].Bind(&(*clips)[clip], rig);
+	}
+	return true;
+}
+
+void AnimationCrowd::Reset()
+{
+	m_clips = nullptr;
+	m_bind.clear();
+	m_hierarchy.SetHierarchy(nullptr, 0);
+	m_clipSamplers.clear();
+	m_instances.clear();
+	m_states.clear();
+	for (std::vector<float>& poses : m_poses)
+	{
+		poses.clear();
+	}
+	m_local.clear();
+	m_absolute.clear();
+	m_frame = 0;
+	m_posedCount = 0;
+}
+
+size_t AnimationCrowd::AddInstance(const CrowdInstance & instance)
+{
+	size_t index = m_instances.size();
+	m_instances.push_back(instance);
+	m_states.emplace_back();
+
+	// A new block's lanes all start at rest, the ones no instance has yet too, so the lane by lane passes over the
+	// whole block see unit rotations
+	size_t blocks = BoneHierarchy::GetBlockCount(m_instances.size());
+	if (index % c_Lanes == 0)
+	{
+		for (std::vector<float>& poses : m_poses)
+		{
+			poses.resize(blocks * m_hierarchy.GetPoseBlockSize());
+			for (size_t lane = index; lane < index + c_Lanes; ++lane)
+			{
+				m_hierarchy.ResetPoses(poses.data(), lane);
+			}
+		}
+		m_local.resize(blocks * m_hierarchy.GetBlockSize(), 0.0f);
+		m_absolute.resize(blocks * m_hierarchy.GetBlockSize(), 0.0f);
+	}
+	BindInstance(index);
+	return index;
+}
+
+void AnimationCrowd::SetInstance(size_t index, const CrowdInstance & instance)
+{
+	bool rebind = instance.clip != m_instances[index].clip || instance.blendClip != m_instances[index].blendClip;
+	m_instances[index] = instance;
+	if (rebind)
+	{
+		BindInstance(index);
+	}
+	m_states[index].dirty = true;
+}
+
+void AnimationCrowd::SetLodDistances(float half, float quarter, float eighth)
+{
+	m_lodDistances[0] = half;
+	m_lodDistances[1] = quarter;
+	m_lodDistances[2] = eighth;
+}
+
+void AnimationCrowd::BindInstance(size_t index)
+{
+	// Copies of the bound samplers, each instance needs cursors of its own
+	const CrowdInstance& instance = m_instances[index];
+	InstanceState& state = m_states[index];
+	state.samplers[0] = instance.clip < m_clipSamplers.size() ? m_clipSamplers[instance.clip] : ClipSampler();
+	state.samplers[1] = instance.blendClip < m_clipSamplers.size() ? m_clipSamplers[instance.blendClip] : ClipSampler();
+	state.dirty = true;
+
+	// Bones without a track in the new clips go back to rest
+	m_hierarchy.ResetPoses(m_poses[0].data(), index);
+	m_hierarchy.ResetPoses(m_poses[1].data(), index);
+}
+
+uint32_t AnimationCrowd::GetInterval(const CrowdInstance & instance, const float * cameraPosition) const
+{
+	float x = instance.world[12] - cameraPosition[0], y = instance.world[13] - cameraPosition[1], z = instance.world[14] - cameraPosition[2];
+	float distanceSquared = x * x + y * y + z * z;
+	uint32_t level = 0;
+	while (level < c_LodLevels - 1 && distanceSquared > m_lodDistances[level] * m_lodDistances[level])
+	{
+		++level;
+	}
+	return 1u << level;
+}
+
+void AnimationCrowd::Update(float elapsed, const float * cameraPosition, ThreadPool * pool, PaletteEntry * palette)
+{
+	const size_t count = m_instances.size(), boneCount = m_hierarchy.GetCount();
+	const size_t blockSize = m_hierarchy.GetBlockSize(), poseBlockSize = m_hierarchy.GetPoseBlockSize();
+	if (count == 0 || boneCount == 0)
+	{
+		m_posedCount = 0;
+		return;
+	}
+	++m_frame;
+
+	std::atomic<size_t> posedCount(0);
+	ThreadPool::For(pool, BoneHierarchy::GetBlockCount(count), c_BlocksPerTask, [&](size_t begin, size_t end)
+	{
+		const uint32_t* offsets = m_hierarchy.GetPoseOffsets();
+		size_t posed = 0;
+
+		for (size_t block = begin; block < end; ++block)
+		{
+			// Every lane of the block is blended and composed again, so the ones not due this frame get the weight
+			// they were last posed with and come out as they were
+			size_t first = block * c_Lanes, last = std::min(first + c_Lanes, count);
+			float weights[c_Lanes] = {};
+			uint32_t lanes = 0;
+			for (size_t index = first; index < last; ++index)
+			{
+				CrowdInstance& instance = m_instances[index];
+				InstanceState& state = m_states[index];
+				instance.time += elapsed * instance.speed;
+				bool blends = state.samplers[1].GetClip() && instance.blend > 0.0f;
+				weights[index - first] = blends ? instance.blend : 0.0f;
+
+				uint32_t interval = GetInterval(instance, cameraPosition);
+				if (!state.dirty && (m_frame + block) % interval != 0)
+				{
+					continue;
+				}
+				state.dirty = false;
+
+				// Bones without a track in either clip keep the rest pose BindInstance gave them
+				size_t lane = m_hierarchy.GetPoseLane(index);
+				state.samplers[0].Sample(instance.time, true, m_poses[0].data() + lane, offsets, c_Lanes);
+				if (blends)
+				{
+					state.samplers[1].Sample(instance.time, true, m_poses[1].data() + lane, offsets, c_Lanes);
+				}
+				lanes |= 1u << (index - first);
+			}
+			if (!lanes)
+			{
+				continue;
+			}
+
+			const float* poses = m_poses[0].data() + block * poseBlockSize;
+			if (std::any_of(weights, weights + c_Lanes, [](float weight) { return weight > 0.0f; }))
+			{
+				float* blended = m_poses[2].data() + block * poseBlockSize;
+				m_hierarchy.Blend(poses, m_poses[1].data() + block * poseBlockSize, weights, blended, 1);
+				poses = blended;
+			}
+			m_hierarchy.Compose(poses, m_bind.data(), m_local.data() + block * blockSize, 1);
+			m_hierarchy.Solve(m_local.data() + block * blockSize, m_absolute.data() + block * blockSize, 1);
+			for (size_t index = first; index < last; ++index)
+			{
+				if (!(lanes & (1u << (index - first))))
+				{
+					continue;
+				}
+				++posed;
+				if (!palette)
+				{
+					continue;
+				}
+
+				// Each bone into the world straight from the lanes, then the world alone as the last entry
+				const float* world = m_instances[index].world;
+				PaletteEntry* entries = palette + index * (boneCount + 1);
+				m_hierarchy.WritePalette(m_absolute.data(), index, world, entries);
+				for (int column = 0; column < 3; ++column)
+				{
+					for (int row = 0; row < 4; ++row)
+					{
+						entries[boneCount].rows[column][row] = world[row * 4 + column];
+					}
+				}
+			}
+		}
+		posedCount += posed;
+	});
+	m_posedCount = posedCount;
+}
+
+void AnimationCrowd::GetAbsoluteTransforms(size_t index, float * matrices) const
+{
+	m_hierarchy.Unpack(m_absolute.data(), index, matrices);
+}
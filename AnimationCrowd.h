@@ -0,0 +1,95 @@
+//
+// AnimationCrowd.h - Many animated instances of one rigid model, posed in parallel with animation LOD
+//
+// Every instance has its own world, clips, blend, playback speed and clip time, and keeps its own sampler cursors, see
+// AnimationClip.h. Update advances every instance's time, then evaluates the instances due this frame a block of
+// BoneHierarchy::c_Lanes at a time on the thread pool. Poses, local and absolute transforms all stay in the block's
+// lanes (see BoneHierarchy.h): each due instance samples its clips into its lanes, the block blends and composes over
+// the bind pose lane by lane, the hierarchy is solved and each updated instance's palette entries are read from its
+// lanes. A block belongs to one task, so nothing is shared between threads.
+//
+// Instances further from the camera are posed less often, every second, fourth or eighth frame past each LOD
+// distance, staggered by block so the work is spread over the frames and the instances due in a frame share blocks. A
+// skipped instance keeps its last pose and palette, its clock still runs so it doesn't fall behind.
+//
+
+#pragma once
+
+#include "AnimationClip.h"
+#include "BoneHierarchy.h"
+#include "BonePalette.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+struct CrowdInstance
+{
+	static constexpr uint32_t c_NoClip = 0xffffffffu;
+
+	float		world[16];		//row major, as DirectXMath stores it
+	uint32_t	clip;			//index into the crowd's clips
+	uint32_t	blendClip;		//c_NoClip to play clip alone
+	float		blend;			//weight of blendClip
+	float		speed;			//clip seconds per second
+	float		time;			//clip time, advanced by Update
+};
+
+class AnimationCrowd
+{
+public:
+	static constexpr size_t c_LodLevels = 4;		//every frame, every 2nd, every 4th, every 8th
+
+	AnimationCrowd();
+
+	//The clips and the model's rig, kept by the caller, the clips must outlive the crowd. False if the rig's hierarchy
+	//has a cycle, and the crowd is then empty.
+	bool Init(const std::vector<AnimationClip>* clips, const Rig& rig);
+	void Reset();
+
+	size_t AddInstance(const CrowdInstance& instance);
+	size_t GetInstanceCount() const { return m_instances.size(); }
+	const CrowdInstance& GetInstance(size_t index) const { return m_instances[index]; }
+
+	//Posed again on the next Update whatever its LOD
+	void SetInstance(size_t index, const CrowdInstance& instance);
+
+	//Distances from the camera past which an instance is posed every 2nd, 4th and 8th frame, increasing
+	void SetLodDistances(float half, float quarter, float eighth);
+
+	//Advances every instance by elapsed seconds and poses the ones due, on pool if there is one. palette, if not null,
+	//has GetBoneCount() + 1 entries per instance, the last its world alone as BonePaletteModel lays it out, and gets the
+	//entries of every instance posed.
+	void Update(float elapsed, const float* cameraPosition, ThreadPool* pool, PaletteEntry* palette);
+
+	//An instance's absolute transforms from its last pose, row major 4x4 per bone
+	void GetAbsoluteTransforms(size_t index, float* matrices) const;
+
+	size_t GetBoneCount() const { return m_hierarchy.GetCount(); }
+	size_t GetPosedCount() const { return m_posedCount; }		//instances posed by the last Update
+
+private:
+	struct InstanceState
+	{
+		ClipSampler		samplers[2];
+		bool			dirty;
+	};
+
+	void BindInstance(size_t index);
+	uint32_t GetInterval(const CrowdInstance& instance, const float* cameraPosition) const;
+
+	const std::vector<AnimationClip>*	m_clips;
+	std::vector<float>					m_bind;
+	BoneHierarchy						m_hierarchy;
+	std::vector<ClipSampler>			m_clipSamplers;			//one bound per clip, copied into the instances
+	std::vector<CrowdInstance>			m_instances;
+	std::vector<InstanceState>			m_states;
+	std::vector<float>					m_poses[3];				//pose blocks of clip, blend clip and their blend
+	std::vector<float>					m_local;				//instance blocks, see BoneHierarchy.h
+	std::vector<float>					m_absolute;
+	float								m_lodDistances[c_LodLevels - 1];
+	uint32_t							m_frame;
+	size_t								m_posedCount;
+};
@@ -0,0 +1,297 @@
+// Table of contents lookup, validation and the archive writer
+#include "AssetArchive.h"
+#include "Hash.h"
+#include "Lz4.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	constexpr uint32_t c_Magic = 0x4b415041;		//"APAK"
+	constexpr uint32_t c_Version = 1;
+	constexpr size_t c_MaxNameLength = 0xffff;
+	constexpr uint32_t c_CompressedAlignment = 16;
+
+	struct Header
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint32_t	count;
+		uint32_t	alignment;
+		uint64_t	tableOffset;		//count AssetEntries, sorted by hash
+		uint64_t	namesOffset;
+		uint64_t	namesSize;
+	};
+
+	static_assert(sizeof(AssetEntry) == 40, "AssetEntry is written to disk as it is");
+	static_assert(sizeof(Header) == 40, "Header is written to disk as it is");
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	template<typename T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void WritePadding(std::ofstream& file, size_t& position, size_t alignment)
+	{
+		static const char zeros[c_CompressedAlignment] = {};
+		size_t target = AlignUp(position, alignment);
+		for (; position < target; position += std::min(target - position, sizeof(zeros)))
+		{
+			file.write(zeros, std::min(target - position, sizeof(zeros)));
+		}
+	}
+}
+
+AssetArchive::AssetArchive() :
+	m_entries(nullptr),
+	m_names(nullptr),
+	m_count(0)
+{
+}
+
+bool AssetArchive::Open(const std::string & path)
+{
+	Close();
+	if (!m_file.Open(path) || m_file.GetSize() < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	const uint8_t* data = m_file.GetData();
+	size_t size = m_file.GetSize();
+	Header header;
+	std::memcpy(&header, data, sizeof(header));
+	if (header.magic != c_Magic || header.version != c_Version || !header.alignment || (header.alignment & (header.alignment - 1))
+		|| header.tableOffset % alignof(AssetEntry) || header.tableOffset > size
+		|| header.count > (size - header.tableOffset) / sizeof(AssetEntry)
+		|| header.namesOffset > size || header.namesSize > size - header.namesOffset)
+	{
+		Close();
+		return false;
+	}
+
+	// Every entry has to lie in the file, have its name in the name block and come in hash order
+	const AssetEntry* entries = reinterpret_cast<const AssetEntry*>(data + header.tableOffset);
+	for (uint32_t i = 0; i < header.count; ++i)
+	{
+		const AssetEntry& entry = entries[i];
+		bool stored = entry.compression == AssetCompression::None;
+		if (entry.offset > size || entry.size > size - entry.offset
+			|| entry.nameOffset > header.namesSize || entry.nameLength > header.namesSize - entry.nameOffset
+			|| (!stored && entry.compression != AssetCompression::Lz4) || (stored && entry.size != entry.originalSize)
+			|| (!stored && entry.originalSize / 255 > entry.size)		//more than LZ4 can expand to
+			|| (i > 0 && entries[i - 1].hash > entry.hash))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	m_entries = entries;
+	m_names = reinterpret_cast<const char*>(data + header.namesOffset);
+	m_count = header.count;
+	return true;
+}
+
+void AssetArchive::Close()
+{
+	m_file.Close();
+	m_entries = nullptr;
+	m_names = nullptr;
+	m_count = 0;
+}
+
+const AssetEntry * AssetArchive::Find(const std::string & name) const
+{
+	std::string normalized = NormalizeName(name);
+	uint64_t hash = HashName(normalized);
+	const AssetEntry* end = m_entries + m_count;
+	const AssetEntry* entry = std::lower_bound(m_entries, end, hash, [](const AssetEntry& a, uint64_t b) { return a.hash < b; });
+	for (; entry != end && entry->hash == hash; ++entry)
+	{
+		if (entry->nameLength == normalized.size() && !std::memcmp(m_names + entry->nameOffset, normalized.data(), normalized.size()))
+		{
+			return entry;
+		}
+	}
+	return nullptr;
+}
+
+const uint8_t * AssetArchive::GetStoredData(const AssetEntry & entry) const
+{
+	return entry.compression == AssetCompression::None ? m_file.GetData() + entry.offset : nullptr;
+}
+
+bool AssetArchive::Read(const std::string & name, std::vector<uint8_t>& data) const
+{
+	const AssetEntry* entry = Find(name);
+	return entry && Read(*entry, data);
+}
+
+bool AssetArchive::Read(const AssetEntry & entry, std::vector<uint8_t>& data) const
+{
+	const uint8_t* source = m_file.GetData() + entry.offset;
+	if (entry.compression == AssetCompression::None)
+	{
+		data.assign(source, source + entry.size);
+		return true;
+	}
+
+	data.resize(entry.originalSize);
+	if (!Lz4::Decompress(source, entry.size, data.data(), data.size()))
+	{
+		data.clear();
+		return false;
+	}
+	return true;
+}
+
+std::string AssetArchive::GetName(const AssetEntry & entry) const
+{
+	return std::string(m_names + entry.nameOffset, entry.nameLength);
+}
+
+std::string AssetArchive::NormalizeName(const std::string & name)
+{
+	std::string normalized = name;
+	for (char& c : normalized)
+	{
+		c = c == '\\' ? '/' : (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+	}
+	while (normalized.compare(0, 2, "./") == 0)
+	{
+		normalized.erase(0, 2);
+	}
+	return normalized;
+}
+
+uint64_t AssetArchive::HashName(const std::string & name)
+{
+	std::string normalized = NormalizeName(name);
+	return Hash::Fnv1a(normalized.data(), normalized.size());
+}
+
+bool AssetArchiveWriter::Add(const std::string & name, const uint8_t * data, size_t size, AssetCompression compression)
+{
+	Entry entry;
+	entry.name = AssetArchive::NormalizeName(name);
+	if (entry.name.empty() || entry.name.size() > c_MaxNameLength)
+	{
+		return false;
+	}
+	for (const Entry& other : m_entries)
+	{
+		if (other.name == entry.name)
+		{
+			return false;
+		}
+	}
+
+	entry.compression = AssetCompression::None;
+	entry.originalSize = size;
+	if (compression == AssetCompression::Lz4 && size > 0)
+	{
+		entry.data.resize(Lz4::GetMaxCompressedSize(size));
+		size_t compressed = Lz4::Compress(data, size, entry.data.data(), entry.data.size());
+		if (compressed && compressed <= size - size / 16)
+		{
+			entry.data.resize(compressed);
+			entry.compression = AssetCompression::Lz4;
+		}
+	}
+	if (entry.compression == AssetCompression::None)
+	{
+		entry.data.assign(data, data + size);
+	}
+
+	m_entries.push_back(std::move(entry));
+	return true;
+}
+
+bool AssetArchiveWriter::Write(const std::string & path, uint32_t alignment) const
+{
+	if (!alignment || (alignment & (alignment - 1)))
+	{
+		return false;
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	// Data first, in the order the entries were added so related files stay together. The header is filled in last.
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	WriteValue(file, header);
+
+	std::vector<AssetEntry> table(m_entries.size());
+	std::string names;
+	size_t position = sizeof(Header);
+	for (size_t i = 0; i < m_entries.size(); ++i)
+	{
+		const Entry& entry = m_entries[i];
+		WritePadding(file, position, entry.compression == AssetCompression::None ? alignment : c_CompressedAlignment);
+
+		AssetEntry& out = table[i];
+		std::memset(&out, 0, sizeof(out));
+		out.hash = Hash::Fnv1a(entry.name.data(), entry.name.size());
+		out.offset = position;
+		out.size = entry.data.size();
+		out.originalSize = entry.originalSize;
+		out.nameOffset = static_cast<uint32_t>(names.size());
+		out.nameLength = static_cast<uint16_t>(entry.name.size());
+		out.compression = entry.compression;
+		names += entry.name;
+
+		file.write(reinterpret_cast<const char*>(entry.data.data()), entry.data.size());
+		position += entry.data.size();
+	}
+
+	std::stable_sort(table.begin(), table.end(), [](const AssetEntry& a, const AssetEntry& b) { return a.hash < b.hash; });
+
+	WritePadding(file, position, alignof(AssetEntry));
+	header.magic = c_Magic;
+	header.version = c_Version;
+	header.count = static_cast<uint32_t>(table.size());
+	header.alignment = alignment;
+	header.tableOffset = position;
+	header.namesOffset = position + table.size() * sizeof(AssetEntry);
+	header.namesSize = names.size();
+
+	file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(AssetEntry));
+	file.write(names.data(), names.size());
+	file.seekp(0);
+	WriteValue(file, header);
+	return file.good();
+}
+
+size_t AssetArchiveWriter::GetOriginalBytes() const
+{
+	size_t bytes = 0;
+	for (const Entry& entry : m_entries)
+	{
+		bytes += entry.originalSize;
+	}
+	return bytes;
+}
+
+size_t AssetArchiveWriter::GetStoredBytes() const
+{
+	size_t bytes = 0;
+	for (const Entry& entry : m_entries)
+	{
+		bytes += entry.data.size();
+	}
+	return bytes;
+}
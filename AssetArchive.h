@@ -0,0 +1,105 @@
+//
+// AssetArchive.h - One memory mapped file holding the game's loose assets
+//
+// Layout: a header, the entry data, then a table of contents sorted by the hash of each entry's name and the names
+// themselves. Looking an entry up is a binary search of the table, with the name compared to rule out collisions.
+// Entries stored as they are start on an alignment boundary (a page by default) and are used straight from the
+// mapping, so a DDS file in the archive still streams its levels without a copy. Entries compressed with LZ4 are
+// decompressed into the caller's buffer. Names are matched ignoring case and with either kind of slash, the way the
+// game's file names behave on Windows.
+//
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class AssetCompression : uint8_t
+{
+	None,
+	Lz4,
+};
+
+//One entry of the table of contents, as it is on disk
+struct AssetEntry
+{
+	uint64_t			hash;			//AssetArchive::HashName of the name
+	uint64_t			offset;			//from the start of the archive
+	uint64_t			size;			//bytes in the archive
+	uint64_t			originalSize;	//bytes once decompressed, the same as size when stored
+	uint32_t			nameOffset;		//into the name block
+	uint16_t			nameLength;
+	AssetCompression	compression;
+	uint8_t				padding;
+};
+
+class AssetArchive
+{
+public:
+	AssetArchive();
+
+	AssetArchive(AssetArchive const&) = delete;
+	AssetArchive& operator= (AssetArchive const&) = delete;
+
+	//Maps and validates an archive: header, table order and every entry inside the file. False (and closed) otherwise.
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const { return m_file.IsOpen(); }
+
+	//Null if there is no entry of that name
+	const AssetEntry* Find(const std::string& name) const;
+
+	//A stored entry straight from the mapping, null if it is compressed
+	const uint8_t* GetStoredData(const AssetEntry& entry) const;
+
+	//The whole entry, decompressed if need be. False if it is missing or doesn't decompress to its size.
+	bool Read(const std::string& name, std::vector<uint8_t>& data) const;
+	bool Read(const AssetEntry& entry, std::vector<uint8_t>& data) const;
+
+	uint32_t GetCount() const { return m_count; }
+	const AssetEntry& GetEntry(uint32_t index) const { return m_entries[index]; }
+	std::string GetName(const AssetEntry& entry) const;
+
+	//Lower case with forward slashes and no leading "./", the form names are stored and hashed in
+	static std::string NormalizeName(const std::string& name);
+	static uint64_t HashName(const std::string& name);
+
+private:
+	MappedFile			m_file;
+	const AssetEntry*	m_entries;		//in the mapping, sorted by hash
+	const char*			m_names;
+	uint32_t			m_count;
+};
+
+//Builds an archive in memory and writes it out in one go, for the packer
+class AssetArchiveWriter
+{
+public:
+	static constexpr uint32_t c_DefaultAlignment = 4096;
+
+	//Compression is only kept if it saves at least one sixteenth, otherwise the entry is stored. False for a name
+	//that is empty, too long or already added.
+	bool Add(const std::string& name, const uint8_t* data, size_t size, AssetCompression compression);
+
+	//Stored entries start on a multiple of alignment (a power of two), compressed ones on 16 bytes
+	bool Write(const std::string& path, uint32_t alignment = c_DefaultAlignment) const;
+
+	uint32_t GetCount() const { return static_cast<uint32_t>(m_entries.size()); }
+	size_t GetOriginalBytes() const;
+	size_t GetStoredBytes() const;
+
+private:
+	struct Entry
+	{
+		std::string				name;		//normalized
+		AssetCompression		compression;
+		size_t					originalSize;
+		std::vector<uint8_t>	data;
+	};
+
+	std::vector<Entry>	m_entries;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "AssetLoader.h"
+
+#include <exception>
+
+namespace DX
+{
+	//A whole file through the loader, from the archive, a prefetch or the disk, see AssetLoader.h. Without a loader
+	//it is read from disk, in the working directory or next to the executable. Throws if it isn't anywhere.
+	inline std::vector<uint8_t> ReadAsset(AssetLoader* assets, const wchar_t* name)
+	{
+		// Asset names are plain ASCII
+		std::string narrow;
+		for (const wchar_t* c = name; *c; ++c)
+		{
+			narrow += static_cast<char>(*c);
+		}
+
+		std::vector<uint8_t> data;
+		if (!(assets ? assets->Read(narrow, data) : AssetLoader::ReadLoose(narrow, data)))
+		{
+			throw std::exception("ReadAsset");
+		}
+		return data;
+	}
+}
@@ -0,0 +1,107 @@
+// Startup file reads from the archive, prefetched loose files or the disk
+#include "AssetLoader.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+AssetLoader::AssetLoader(unsigned ioThreads) :
+	m_reader(ioThreads),
+	m_archive(nullptr)
+{
+}
+
+void AssetLoader::Prefetch(const std::vector<std::string>& names)
+{
+	for (const std::string& name : names)
+	{
+		if (m_archive && m_archive->Find(name))
+		{
+			continue;
+		}
+		std::string normalized = AssetArchive::NormalizeName(name);
+		auto queued = std::find_if(m_prefetches.begin(), m_prefetches.end(), [&](const Prefetched& prefetched) { return prefetched.name == normalized; });
+		if (queued != m_prefetches.end())
+		{
+			++queued->uses;
+			continue;
+		}
+		m_prefetches.push_back({ normalized, m_reader.ReadFile(name, m_cancel), FileData(), 1 });
+	}
+}
+
+bool AssetLoader::Read(const std::string & name, std::vector<uint8_t>& data)
+{
+	if (m_archive && m_archive->Read(name, data))
+	{
+		return true;
+	}
+
+	std::string normalized = AssetArchive::NormalizeName(name);
+	for (Prefetched& prefetched : m_prefetches)
+	{
+		if (prefetched.name != normalized || !prefetched.uses)
+		{
+			continue;
+		}
+		if (prefetched.read.valid())
+		{
+			prefetched.file = prefetched.read.get();
+		}
+		if (prefetched.file.status != ReadStatus::Done)
+		{
+			break;
+		}
+		// The last use takes the data rather than copying it
+		if (--prefetched.uses)
+		{
+			data = prefetched.file.data;
+		}
+		else
+		{
+			data = std::move(prefetched.file.data);
+			prefetched.file = FileData();
+		}
+		return true;
+	}
+	return ReadLoose(name, data);
+}
+
+void AssetLoader::ClearPrefetches()
+{
+	m_cancel.Cancel();
+	m_cancel = CancelToken();
+	m_prefetches.clear();
+}
+
+bool AssetLoader::ReadLoose(const std::string & name, std::vector<uint8_t>& data)
+{
+	// Sized from the open handle and read in one go, no stream and no seeking
+	FileData file = AsyncFileReader::ReadFileNow(name);
+#if defined(_WIN32) && (!defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP))
+	if (file.status != ReadStatus::Done)
+	{
+		char moduleName[MAX_PATH];
+		DWORD length = GetModuleFileNameA(nullptr, moduleName, MAX_PATH);
+		if (length && length < MAX_PATH)
+		{
+			std::string path(moduleName, length);
+			file = AsyncFileReader::ReadFileNow(path.substr(0, path.find_last_of("\\/") + 1) + name);
+		}
+	}
+#endif
+	if (file.status != ReadStatus::Done)
+	{
+		return false;
+	}
+	data = std::move(file.data);
+	return true;
+}
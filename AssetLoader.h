@@ -0,0 +1,61 @@
+//
+// AssetLoader.h - The game's startup files, from the archive when it holds them and from loose files otherwise
+//
+// Prefetch submits every loose file it is given to the AsyncFileReader at once, so they are read on its I/O threads
+// while the device objects are being created, and Read only waits on a file's future when the file is needed. A
+// name given n times is read once and serves n Reads, copied for all but the last, which takes the data; the shaders
+// shared by several passes are listed once per pass. Files that weren't prefetched, were already read as often as
+// they were listed, or whose prefetch failed, are read on the calling thread: from the working directory, then on
+// Windows desktop from next to the executable.
+//
+
+#pragma once
+
+#include "AssetArchive.h"
+#include "AsyncFile.h"
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+class AssetLoader
+{
+public:
+	explicit AssetLoader(unsigned ioThreads = 2);
+
+	AssetLoader(AssetLoader const&) = delete;
+	AssetLoader& operator= (AssetLoader const&) = delete;
+
+	//Files in the archive are read from it. The archive has to outlive the loader.
+	void SetArchive(const AssetArchive* archive) { m_archive = archive; }
+	const AssetArchive* GetArchive() const { return m_archive; }
+
+	//Starts reading the names the archive doesn't hold, all at once. A name already prefetched serves one more Read.
+	void Prefetch(const std::vector<std::string>& names);
+
+	//The whole file, waiting for its prefetch if it is still being read. False if it is nowhere.
+	bool Read(const std::string& name, std::vector<uint8_t>& data);
+
+	//Cancels the prefetches still queued and drops the data of the rest, for once the startup reads are done
+	void ClearPrefetches();
+
+	size_t GetPrefetchCount() const { return m_prefetches.size(); }
+
+	//A loose file on the calling thread, in the working directory or next to the executable
+	static bool ReadLoose(const std::string& name, std::vector<uint8_t>& data);
+
+private:
+	struct Prefetched
+	{
+		std::string					name;		//AssetArchive::NormalizeName form
+		std::future<FileData>		read;		//until the first Read waits on it
+		FileData					file;
+		uint32_t					uses;		//Reads it still serves
+	};
+
+	AsyncFileReader				m_reader;
+	const AssetArchive*			m_archive;
+	CancelToken					m_cancel;
+	std::vector<Prefetched>		m_prefetches;
+};
@@ -0,0 +1,312 @@
+// Positioned file reads on the I/O threads, Win32 and POSIX
+#include "AsyncFile.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// An open file read at explicit offsets, so one handle serves a batch without seeking between ranges
+	class File
+	{
+	public:
+		File(const File&) = delete;
+		File& operator= (const File&) = delete;
+
+#ifdef _WIN32
+		File() : m_handle(INVALID_HANDLE_VALUE) {}
+		~File()
+		{
+			if (m_handle != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(m_handle);
+			}
+		}
+
+		bool Open(const std::string& path)
+		{
+			m_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			return m_handle != INVALID_HANDLE_VALUE;
+		}
+
+		bool GetSize(uint64_t& size) const
+		{
+			LARGE_INTEGER value;
+			if (!GetFileSizeEx(m_handle, &value))
+			{
+				return false;
+			}
+			size = static_cast<uint64_t>(value.QuadPart);
+			return true;
+		}
+
+		// size is at most a chunk, well inside a DWORD
+		bool ReadAt(uint64_t offset, void* buffer, size_t size) const
+		{
+			uint8_t* out = static_cast<uint8_t*>(buffer);
+			while (size)
+			{
+				OVERLAPPED position = {};
+				position.Offset = static_cast<DWORD>(offset);
+				position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+				DWORD read = 0;
+				if (!::ReadFile(m_handle, out, static_cast<DWORD>(size), &read, &position) || read == 0)
+				{
+					return false;
+				}
+				out += read;
+				offset += read;
+				size -= read;
+			}
+			return true;
+		}
+
+	private:
+		HANDLE	m_handle;
+#else
+		File() : m_handle(-1) {}
+		~File()
+		{
+			if (m_handle >= 0)
+			{
+				close(m_handle);
+			}
+		}
+
+		bool Open(const std::string& path)
+		{
+			m_handle = open(path.c_str(), O_RDONLY);
+			return m_handle >= 0;
+		}
+
+		bool GetSize(uint64_t& size) const
+		{
+			struct stat status;
+			if (fstat(m_handle, &status) != 0)
+			{
+				return false;
+			}
+			size = static_cast<uint64_t>(status.st_size);
+			return true;
+		}
+
+		bool ReadAt(uint64_t offset, void* buffer, size_t size) const
+		{
+			uint8_t* out = static_cast<uint8_t*>(buffer);
+			while (size)
+			{
+				ssize_t read = pread(m_handle, out, size, static_cast<off_t>(offset));
+				if (read < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				if (read <= 0)
+				{
+					return false;
+				}
+				out += read;
+				offset += static_cast<uint64_t>(read);
+				size -= static_cast<size_t>(read);
+			}
+			return true;
+		}
+
+	private:
+		int		m_handle;
+#endif
+	};
+
+	// A range in chunks, checking for cancellation before each one
+	template<typename Cancelled>
+	ReadStatus ReadChunked(const File& file, uint64_t offset, uint8_t* buffer, size_t size, size_t& bytes, Cancelled cancelled)
+	{
+		for (size_t done = 0; done < size; )
+		{
+			if (cancelled())
+			{
+				return ReadStatus::Cancelled;
+			}
+			size_t chunk = std::min(size - done, AsyncFileReader::c_ChunkSize);
+			if (!file.ReadAt(offset + done, buffer + done, chunk))
+			{
+				return ReadStatus::Failed;
+			}
+			done += chunk;
+			bytes += chunk;
+		}
+		return ReadStatus::Done;
+	}
+
+	template<typename Cancelled>
+	FileData ReadWholeFile(const std::string& path, Cancelled cancelled)
+	{
+		FileData result;
+		if (cancelled())
+		{
+			result.status = ReadStatus::Cancelled;
+			return result;
+		}
+
+		File file;
+		uint64_t size;
+		if (!file.Open(path) || !file.GetSize(size) || size > SIZE_MAX)
+		{
+			return result;
+		}
+
+		// The size comes from the open handle, the data is read straight into the vector without a seek
+		result.data.resize(static_cast<size_t>(size));
+		size_t bytes = 0;
+		result.status = ReadChunked(file, 0, result.data.data(), result.data.size(), bytes, cancelled);
+		if (result.status != ReadStatus::Done)
+		{
+			result.data.clear();
+		}
+		return result;
+	}
+
+	template<typename Cancelled>
+	ReadResult ReadRanges(const std::string& path, std::vector<ReadRange> ranges, Cancelled cancelled)
+	{
+		ReadResult result;
+		if (cancelled())
+		{
+			result.status = ReadStatus::Cancelled;
+			return result;
+		}
+
+		File file;
+		if (!file.Open(path))
+		{
+			return result;
+		}
+
+		// Forward through the file, with ranges that follow on in both the file and memory read as one
+		std::sort(ranges.begin(), ranges.end(), [](const ReadRange& a, const ReadRange& b) { return a.offset < b.offset; });
+		size_t merged = 0;
+		for (size_t i = 0; i < ranges.size(); ++i)
+		{
+			const ReadRange& range = ranges[i];
+			if (!range.size)
+			{
+				continue;
+			}
+			ReadRange* last = merged > 0 ? &ranges[merged - 1] : nullptr;
+			if (last && last->offset + last->size == range.offset && static_cast<uint8_t*>(last->buffer) + last->size == range.buffer)
+			{
+				last->size += range.size;
+			}
+			else
+			{
+				ranges[merged++] = range;
+			}
+		}
+		ranges.resize(merged);
+
+		for (const ReadRange& range : ranges)
+		{
+			result.status = ReadChunked(file, range.offset, static_cast<uint8_t*>(range.buffer), range.size, result.bytes, cancelled);
+			if (result.status != ReadStatus::Done)
+			{
+				return result;
+			}
+		}
+		result.status = ReadStatus::Done;
+		return result;
+	}
+}
+
+AsyncFileReader::AsyncFileReader(unsigned ioThreads) :
+	m_cancelGeneration(0),
+	m_io(std::max(ioThreads, 1u))
+{
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	// Queued reads still run, but only to report Cancelled, before the pool joins its threads
+	CancelAll();
+}
+
+std::future<FileData> AsyncFileReader::ReadFile(const std::string & path, const CancelToken & cancel)
+{
+	auto promise = std::make_shared<std::promise<FileData>>();
+	std::future<FileData> future = promise->get_future();
+	Cancellation cancellation = { cancel, m_cancelGeneration.load() };
+	m_io.Submit([this, promise, path, cancellation]()
+	{
+		promise->set_value(ReadWholeFile(path, [this, &cancellation]() { return IsCancelled(cancellation); }));
+	});
+	return future;
+}
+
+std::future<ReadResult> AsyncFileReader::Read(const std::string & path, uint64_t offset, void * buffer, size_t size, const CancelToken & cancel)
+{
+	return ReadBatch(path, { { offset, size, buffer } }, cancel);
+}
+
+std::future<ReadResult> AsyncFileReader::ReadBatch(const std::string & path, std::vector<ReadRange> ranges, const CancelToken & cancel)
+{
+	auto promise = std::make_shared<std::promise<ReadResult>>();
+	std::future<ReadResult> future = promise->get_future();
+	Cancellation cancellation = { cancel, m_cancelGeneration.load() };
+	auto shared = std::make_shared<std::vector<ReadRange>>(std::move(ranges));
+	m_io.Submit([this, promise, path, shared, cancellation]()
+	{
+		promise->set_value(ReadRanges(path, std::move(*shared), [this, &cancellation]() { return IsCancelled(cancellation); }));
+	});
+	return future;
+}
+
+std::future<std::vector<FileData>> AsyncFileReader::ReadFiles(std::vector<std::string> paths, const CancelToken & cancel)
+{
+	auto promise = std::make_shared<std::promise<std::vector<FileData>>>();
+	std::future<std::vector<FileData>> future = promise->get_future();
+	Cancellation cancellation = { cancel, m_cancelGeneration.load() };
+	auto shared = std::make_shared<std::vector<std::string>>(std::move(paths));
+	m_io.Submit([this, promise, shared, cancellation]()
+	{
+		std::vector<FileData> files;
+		files.reserve(shared->size());
+		for (const std::string& path : *shared)
+		{
+			files.push_back(ReadWholeFile(path, [this, &cancellation]() { return IsCancelled(cancellation); }));
+		}
+		promise->set_value(std::move(files));
+	});
+	return future;
+}
+
+void AsyncFileReader::CancelAll()
+{
+	m_cancelGeneration.fetch_add(1);
+}
+
+FileData AsyncFileReader::ReadFileNow(const std::string & path, const CancelToken * cancel)
+{
+	return ReadWholeFile(path, [cancel]() { return cancel && cancel->IsCancelled(); });
+}
+
+ReadResult AsyncFileReader::ReadBatchNow(const std::string & path, const std::vector<ReadRange>& ranges, const CancelToken * cancel)
+{
+	return ReadRanges(path, ranges, [cancel]() { return cancel && cancel->IsCancelled(); });
+}
+
+bool AsyncFileReader::IsCancelled(const Cancellation & cancellation) const
+{
+	return cancellation.token.IsCancelled() || m_cancelGeneration.load(std::memory_order_relaxed) != cancellation.generation;
+}
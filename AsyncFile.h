@@ -0,0 +1,109 @@
+//
+// AsyncFile.h - Background file reads returning futures
+//
+// Reads run on a few I/O threads and each returns a std::future. A read can go into a buffer the caller already
+// owns, and many ranges of one file (or many whole files) can be submitted as one batch. A batch costs one task and
+// one open per file, and its ranges are read in offset order. Files are read with positioned reads (pread,
+// ReadFile with an offset), sized once from the open handle, never by seeking. Every read can be cancelled through
+// a CancelToken: queued reads finish straight away as Cancelled and running ones stop at the next chunk.
+//
+// Everything here builds on Windows and POSIX systems without extra libraries. There is no io_uring path; batching
+// on the thread pool gets most of the benefit for the game's file counts without tying the code to one kernel.
+//
+
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class ReadStatus : uint8_t
+{
+	Done,
+	Cancelled,
+	Failed,			//missing, unreadable, or shorter than the range asked for
+};
+
+//Shared flag, copies cancel the same reads
+class CancelToken
+{
+public:
+	CancelToken() : m_flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+	void Cancel() { m_flag->store(true, std::memory_order_relaxed); }
+	bool IsCancelled() const { return m_flag->load(std::memory_order_relaxed); }
+
+private:
+	std::shared_ptr<std::atomic<bool>>	m_flag;
+};
+
+struct FileData
+{
+	ReadStatus				status = ReadStatus::Failed;
+	std::vector<uint8_t>	data;
+};
+
+struct ReadResult
+{
+	ReadStatus				status = ReadStatus::Failed;
+	size_t					bytes = 0;		//read into the caller's buffers
+};
+
+//One range of a batch. The buffer must hold size bytes and stay alive until the batch's future is ready.
+struct ReadRange
+{
+	uint64_t				offset;
+	size_t					size;
+	void*					buffer;
+};
+
+class AsyncFileReader
+{
+public:
+	//Reads are split into chunks of this size, so cancelling a large one takes effect within a chunk
+	static constexpr size_t c_ChunkSize = 1 << 20;
+
+	explicit AsyncFileReader(unsigned ioThreads = 2);
+	~AsyncFileReader();		//cancels whatever hasn't started and waits for the rest
+
+	AsyncFileReader(AsyncFileReader const&) = delete;
+	AsyncFileReader& operator= (AsyncFileReader const&) = delete;
+
+	//A whole file into a new buffer
+	std::future<FileData> ReadFile(const std::string& path, const CancelToken& cancel = CancelToken());
+
+	//size bytes from offset into the caller's buffer, which must stay alive until the future is ready
+	std::future<ReadResult> Read(const std::string& path, uint64_t offset, void* buffer, size_t size, const CancelToken& cancel = CancelToken());
+
+	//Ranges of one file with a single open, read in offset order. Failed if any range is.
+	std::future<ReadResult> ReadBatch(const std::string& path, std::vector<ReadRange> ranges, const CancelToken& cancel = CancelToken());
+
+	//Whole files as one task, for many small ones. The results are in the order of paths.
+	std::future<std::vector<FileData>> ReadFiles(std::vector<std::string> paths, const CancelToken& cancel = CancelToken());
+
+	//Cancels every read submitted so far
+	void CancelAll();
+
+	//The same reads on the calling thread, for code that needs the data before it can go on
+	static FileData ReadFileNow(const std::string& path, const CancelToken* cancel = nullptr);
+	static ReadResult ReadBatchNow(const std::string& path, const std::vector<ReadRange>& ranges, const CancelToken* cancel = nullptr);
+
+private:
+	//Whether a read should stop, from its own token or CancelAll
+	struct Cancellation
+	{
+		CancelToken				token;
+		uint64_t				generation;
+	};
+
+	bool IsCancelled(const Cancellation& cancellation) const;
+
+	std::atomic<uint64_t>		m_cancelGeneration;		//bumped by CancelAll, reads started before it stop
+	ThreadPool					m_io;					//last, so its threads are joined before the rest goes
+};
@@ -0,0 +1,1129 @@
+// Principal axis endpoints, SSE2 index fitting and the BC block layouts
+#include "BlockCompression.h"
+#include "DDSFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <vector>
+
+using BlockCompression::Quality;
+
+namespace
+{
+	// BC7 4 bit index weights out of 64
+	const int c_BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// How far each palette entry sits from the first endpoint towards the second
+	const float c_FourColourWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	const float c_ThreeColourWeights[3] = { 0.0f, 1.0f, 0.5f };
+
+	// The 16 pixels of a block split into channels, four pixels to an SSE register. Pixels with weight 0 (BC1
+	// transparent ones) are left out of the fit.
+	struct Block
+	{
+		alignas(16) float	channel[4][16];
+		alignas(16) float	weight[16];
+	};
+
+	void LoadBlock(const uint8_t rgba[64], Block& block)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				block.channel[c][i] = float(rgba[i * 4 + c]);
+			}
+			block.weight[i] = 1.0f;
+		}
+	}
+
+	float Clamp255(float value)
+	{
+		return std::min(std::max(value, 0.0f), 255.0f);
+	}
+
+	// Nearest of paletteSize entries for every pixel over the first channels channels, returns the weighted squared
+	// error of the whole block
+	float FitIndices(const Block& block, const float palette[][4], int paletteSize, int channels, uint8_t indices[16])
+	{
+		__m128 total = _mm_setzero_ps();
+		for (int group = 0; group < 16; group += 4)
+		{
+			__m128 pixel[4];
+			for (int c = 0; c < channels; ++c)
+			{
+				pixel[c] = _mm_load_ps(block.channel[c] + group);
+			}
+
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (int p = 0; p < paletteSize; ++p)
+			{
+				__m128 error = _mm_setzero_ps();
+				for (int c = 0; c < channels; ++c)
+				{
+					__m128 d = _mm_sub_ps(pixel[c], _mm_set1_ps(palette[p][c]));
+					error = _mm_add_ps(error, _mm_mul_ps(d, d));
+				}
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(error, best));
+				best = _mm_min_ps(error, best);
+				bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+			}
+
+			alignas(16) int32_t index[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(index), bestIndex);
+			for (int k = 0; k < 4; ++k)
+			{
+				indices[group + k] = static_cast<uint8_t>(index[k]);
+			}
+			total = _mm_add_ps(total, _mm_mul_ps(best, _mm_load_ps(block.weight + group)));
+		}
+
+		alignas(16) float sum[4];
+		_mm_store_ps(sum, total);
+		return sum[0] + sum[1] + sum[2] + sum[3];
+	}
+
+	// Ends of the principal axis of the weighted pixels, found by power iteration on their covariance
+	void PrincipalAxisEndpoints(const Block& block, int channels, float e0[4], float e1[4])
+	{
+		float mean[4] = {};
+		float total = 0.0f;
+		for (int i = 0; i < 16; ++i)
+		{
+			total += block.weight[i];
+			for (int c = 0; c < channels; ++c)
+			{
+				mean[c] += block.weight[i] * block.channel[c][i];
+			}
+		}
+		for (int c = 0; c < channels; ++c)
+		{
+			mean[c] = total > 0.0f ? mean[c] / total : 0.0f;
+			e0[c] = e1[c] = mean[c];
+		}
+		if (total <= 0.0f)
+		{
+			return;
+		}
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			float d[4];
+			for (int c = 0; c < channels; ++c)
+			{
+				d[c] = block.channel[c][i] - mean[c];
+			}
+			for (int a = 0; a < channels; ++a)
+			{
+				for (int b = 0; b < channels; ++b)
+				{
+					covariance[a][b] += block.weight[i] * d[a] * d[b];
+				}
+			}
+		}
+
+		// Starting from the row of the widest channel keeps the start from being orthogonal to the answer
+		int widest = 0;
+		for (int c = 1; c < channels; ++c)
+		{
+			if (covariance[c][c] > covariance[widest][widest])
+			{
+				widest = c;
+			}
+		}
+		float axis[4] = {};
+		for (int c = 0; c < channels; ++c)
+		{
+			axis[c] = covariance[widest][c];
+		}
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			float largest = 0.0f;
+			for (int a = 0; a < channels; ++a)
+			{
+				for (int b = 0; b < channels; ++b)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				largest = std::max(largest, std::fabs(next[a]));
+			}
+			if (largest < 1e-6f)
+			{
+				return;
+			}
+			for (int c = 0; c < channels; ++c)
+			{
+				axis[c] = next[c] / largest;
+			}
+		}
+
+		float length = 0.0f;
+		for (int c = 0; c < channels; ++c)
+		{
+			length += axis[c] * axis[c];
+		}
+		length = std::sqrt(length);
+		for (int c = 0; c < channels; ++c)
+		{
+			axis[c] /= length;
+		}
+
+		float minT = FLT_MAX, maxT = -FLT_MAX;
+		for (int i = 0; i < 16; ++i)
+		{
+			if (block.weight[i] <= 0.0f)
+			{
+				continue;
+			}
+			float t = 0.0f;
+			for (int c = 0; c < channels; ++c)
+			{
+				t += (block.channel[c][i] - mean[c]) * axis[c];
+			}
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+		for (int c = 0; c < channels; ++c)
+		{
+			e0[c] = Clamp255(mean[c] + axis[c] * minT);
+			e1[c] = Clamp255(mean[c] + axis[c] * maxT);
+		}
+	}
+
+	// Least squares endpoints for fixed indices. False when the indices don't pin both ends down.
+	bool RefineEndpoints(const Block& block, int channels, const uint8_t indices[16], const float* weights, float e0[4], float e1[4])
+	{
+		float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			if (block.weight[i] <= 0.0f)
+			{
+				continue;
+			}
+			float b = weights[indices[i]];
+			float a = 1.0f - b;
+			aa += a * a;
+			bb += b * b;
+			ab += a * b;
+			for (int c = 0; c < channels; ++c)
+			{
+				ax[c] += a * block.channel[c][i];
+				bx[c] += b * block.channel[c][i];
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+		{
+			return false;
+		}
+		for (int c = 0; c < channels; ++c)
+		{
+			e0[c] = Clamp255((ax[c] * bb - bx[c] * ab) / determinant);
+			e1[c] = Clamp255((bx[c] * aa - ax[c] * ab) / determinant);
+		}
+		return true;
+	}
+
+	//
+	// BC1 colour
+	//
+
+	uint16_t Pack565(const float colour[3])
+	{
+		int r = static_cast<int>(colour[0] * 31.0f / 255.0f + 0.5f);
+		int g = static_cast<int>(colour[1] * 63.0f / 255.0f + 0.5f);
+		int b = static_cast<int>(colour[2] * 31.0f / 255.0f + 0.5f);
+		return static_cast<uint16_t>((std::min(r, 31) << 11) | (std::min(g, 63) << 5) | std::min(b, 31));
+	}
+
+	void Unpack565(uint16_t value, int rgb[3])
+	{
+		int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// The palette the way DecodeBlock builds it, the fourth entry black (transparent in BC1) in three colour mode
+	void BuildColourPalette(uint16_t c0, uint16_t c1, bool fourColour, int palette[4][4])
+	{
+		int a[3], b[3];
+		Unpack565(c0, a);
+		Unpack565(c1, b);
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[0][c] = a[c];
+			palette[1][c] = b[c];
+			palette[2][c] = fourColour ? (2 * a[c] + b[c]) / 3 : (a[c] + b[c]) / 2;
+			palette[3][c] = fourColour ? (a[c] + 2 * b[c]) / 3 : 0;
+		}
+		for (int i = 0; i < 4; ++i)
+		{
+			palette[i][3] = fourColour || i < 3 ? 255 : 0;
+		}
+	}
+
+	struct ColourFit
+	{
+		uint16_t	c0;
+		uint16_t	c1;
+		uint8_t		indices[16];
+		float		error;
+	};
+
+	void EvaluateColour(const Block& block, bool fourColour, ColourFit& fit)
+	{
+		int entries[4][4];
+		BuildColourPalette(fit.c0, fit.c1, fourColour, entries);
+		float palette[4][4];
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				palette[i][c] = float(entries[i][c]);
+			}
+		}
+		// Three colour mode never uses the black entry for a visible pixel
+		fit.error = FitIndices(block, palette, fourColour ? 4 : 3, 3, fit.indices);
+	}
+
+	// Tries one step either way on each 5 or 6 bit component of both endpoints until nothing improves
+	void SearchColour(const Block& block, bool fourColour, ColourFit& best)
+	{
+		const int shifts[3] = { 11, 5, 0 };
+		const int masks[3] = { 31, 63, 31 };
+		for (int pass = 0; pass < 8; ++pass)
+		{
+			bool improved = false;
+			for (int endpoint = 0; endpoint < 2; ++endpoint)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					for (int step = -1; step <= 1; step += 2)
+					{
+						ColourFit trial = best;
+						uint16_t& value = endpoint ? trial.c1 : trial.c0;
+						int component = ((value >> shifts[c]) & masks[c]) + step;
+						if (component < 0 || component > masks[c])
+						{
+							continue;
+						}
+						value = static_cast<uint16_t>((value & ~(masks[c] << shifts[c])) | (component << shifts[c]));
+						EvaluateColour(block, fourColour, trial);
+						if (trial.error < best.error)
+						{
+							best = trial;
+							improved = true;
+						}
+					}
+				}
+			}
+			if (!improved)
+			{
+				return;
+			}
+		}
+	}
+
+	ColourFit FitColourMode(const Block& block, bool fourColour, const float e0[4], const float e1[4], Quality quality)
+	{
+		ColourFit best;
+		best.c0 = Pack565(e0);
+		best.c1 = Pack565(e1);
+		EvaluateColour(block, fourColour, best);
+
+		int refinements = quality == Quality::Fast ? 0 : quality == Quality::Normal ? 1 : 2;
+		for (int i = 0; i < refinements; ++i)
+		{
+			float r0[4], r1[4];
+			if (!RefineEndpoints(block, 3, best.indices, fourColour ? c_FourColourWeights : c_ThreeColourWeights, r0, r1))
+			{
+				break;
+			}
+			ColourFit trial;
+			trial.c0 = Pack565(r0);
+			trial.c1 = Pack565(r1);
+			EvaluateColour(block, fourColour, trial);
+			if (trial.error >= best.error)
+			{
+				break;
+			}
+			best = trial;
+		}
+
+		if (quality == Quality::High)
+		{
+			SearchColour(block, fourColour, best);
+		}
+		return best;
+	}
+
+	void WriteColourBlock(ColourFit fit, bool fourColour, const bool transparent[16], uint8_t out[8])
+	{
+		// The decoder tells the modes apart by the endpoint order, four colours need c0 > c1
+		if (fourColour && fit.c0 < fit.c1)
+		{
+			std::swap(fit.c0, fit.c1);
+			for (uint8_t& index : fit.indices)
+			{
+				index ^= 1;
+			}
+		}
+		else if (fourColour && fit.c0 == fit.c1)
+		{
+			std::memset(fit.indices, 0, sizeof(fit.indices));
+		}
+		else if (!fourColour && fit.c0 > fit.c1)
+		{
+			std::swap(fit.c0, fit.c1);
+			for (uint8_t& index : fit.indices)
+			{
+				index = index < 2 ? index ^ 1 : index;
+			}
+		}
+
+		uint32_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			bits |= uint32_t(transparent && transparent[i] ? 3 : fit.indices[i]) << (i * 2);
+		}
+		out[0] = uint8_t(fit.c0);
+		out[1] = uint8_t(fit.c0 >> 8);
+		out[2] = uint8_t(fit.c1);
+		out[3] = uint8_t(fit.c1 >> 8);
+		std::memcpy(out + 4, &bits, 4);
+	}
+
+	// BC1 colour block, or the colour half of BC2 / BC3 (always decoded as four colours) without punchThrough
+	void EncodeColour(const uint8_t rgba[64], bool punchThrough, Quality quality, uint8_t out[8])
+	{
+		Block block;
+		LoadBlock(rgba, block);
+
+		bool transparent[16];
+		bool anyTransparent = false, anyOpaque = false;
+		for (int i = 0; i < 16; ++i)
+		{
+			transparent[i] = punchThrough && rgba[i * 4 + 3] < 128;
+			block.weight[i] = transparent[i] ? 0.0f : 1.0f;
+			anyTransparent |= transparent[i];
+			anyOpaque |= !transparent[i];
+		}
+		if (!anyOpaque)
+		{
+			ColourFit fit = {};
+			WriteColourBlock(fit, false, transparent, out);
+			return;
+		}
+
+		float e0[4], e1[4];
+		PrincipalAxisEndpoints(block, 3, e0, e1);
+
+		// Transparent pixels need the three colour mode, High also tries it for blocks whose colours sit on a line
+		bool fourColour = !anyTransparent;
+		ColourFit best = FitColourMode(block, fourColour, e0, e1, quality);
+		if (punchThrough && !anyTransparent && quality == Quality::High)
+		{
+			ColourFit three = FitColourMode(block, false, e0, e1, quality);
+			if (three.error < best.error)
+			{
+				best = three;
+				fourColour = false;
+			}
+		}
+		WriteColourBlock(best, fourColour, anyTransparent ? transparent : nullptr, out);
+	}
+
+	//
+	// BC4 single channel, also the alpha of BC3 and both halves of BC5
+	//
+
+	void BuildChannelPalette(int a0, int a1, int palette[8])
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+		if (a0 > a1)
+		{
+			for (int i = 1; i < 7; ++i)
+			{
+				palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+			}
+		}
+		else
+		{
+			for (int i = 1; i < 5; ++i)
+			{
+				palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	int EvaluateChannel(const uint8_t values[16], int a0, int a1, uint8_t indices[16])
+	{
+		int palette[8];
+		BuildChannelPalette(a0, a1, palette);
+		int total = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			int best = INT32_MAX;
+			for (int p = 0; p < 8; ++p)
+			{
+				int d = values[i] - palette[p];
+				if (d * d < best)
+				{
+					best = d * d;
+					indices[i] = static_cast<uint8_t>(p);
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	void EncodeChannel(const uint8_t values[16], Quality quality, uint8_t out[8])
+	{
+		int low = 255, high = 0, innerLow = 255, innerHigh = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			low = std::min<int>(low, values[i]);
+			high = std::max<int>(high, values[i]);
+			if (values[i] > 0 && values[i] < 255)
+			{
+				innerLow = std::min<int>(innerLow, values[i]);
+				innerHigh = std::max<int>(innerHigh, values[i]);
+			}
+		}
+
+		// Eight interpolated values across the range (a0 > a1); a flat block falls into the six value mode, exactly
+		int a0 = high, a1 = low;
+		uint8_t indices[16];
+		int error = EvaluateChannel(values, a0, a1, indices);
+
+		auto consider = [&](int t0, int t1)
+		{
+			uint8_t trial[16];
+			int trialError = EvaluateChannel(values, t0, t1, trial);
+			if (trialError < error)
+			{
+				error = trialError;
+				a0 = t0;
+				a1 = t1;
+				std::memcpy(indices, trial, sizeof(indices));
+			}
+		};
+
+		// Six interpolated values between the ones that aren't exactly 0 or 255, which get their own entries
+		if (quality != Quality::Fast && innerLow <= innerHigh)
+		{
+			consider(innerLow, innerHigh);
+		}
+		if (quality == Quality::High && high > low)
+		{
+			for (int d0 = -2; d0 <= 2; ++d0)
+			{
+				for (int d1 = -2; d1 <= 2; ++d1)
+				{
+					int t0 = std::min(std::max(high + d0, 0), 255);
+					int t1 = std::min(std::max(low + d1, 0), 255);
+					if (t0 > t1)
+					{
+						consider(t0, t1);
+					}
+				}
+			}
+		}
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			bits |= uint64_t(indices[i]) << (i * 3);
+		}
+		out[0] = static_cast<uint8_t>(a0);
+		out[1] = static_cast<uint8_t>(a1);
+		for (int i = 0; i < 6; ++i)
+		{
+			out[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+		}
+	}
+
+	void EncodeChannel(const uint8_t rgba[64], int channel, Quality quality, uint8_t out[8])
+	{
+		uint8_t values[16];
+		for (int i = 0; i < 16; ++i)
+		{
+			values[i] = rgba[i * 4 + channel];
+		}
+		EncodeChannel(values, quality, out);
+	}
+
+	//
+	// BC7 mode 6
+	//
+
+	struct BC7Endpoints
+	{
+		int		q[2][4];		//7 bit values
+		int		p[2];			//p-bit shared by every channel of an endpoint
+	};
+
+	struct BC7Fit
+	{
+		BC7Endpoints	endpoints;
+		uint8_t			indices[16];
+		float			error;
+	};
+
+	void QuantizeBC7(const float e[4], int p, int q[4])
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			q[c] = std::min(std::max(static_cast<int>((e[c] - float(p)) * 0.5f + 0.5f), 0), 127);
+		}
+	}
+
+	// p-bit with the smaller rounding error over the four channels
+	int ChooseBC7PBit(const float e[4])
+	{
+		float error[2] = {};
+		for (int p = 0; p < 2; ++p)
+		{
+			int q[4];
+			QuantizeBC7(e, p, q);
+			for (int c = 0; c < 4; ++c)
+			{
+				float d = float((q[c] << 1) | p) - e[c];
+				error[p] += d * d;
+			}
+		}
+		return error[1] < error[0] ? 1 : 0;
+	}
+
+	void EvaluateBC7(const Block& block, BC7Fit& fit)
+	{
+		float palette[16][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			int a = (fit.endpoints.q[0][c] << 1) | fit.endpoints.p[0];
+			int b = (fit.endpoints.q[1][c] << 1) | fit.endpoints.p[1];
+			for (int i = 0; i < 16; ++i)
+			{
+				palette[i][c] = float(((64 - c_BC7Weights[i]) * a + c_BC7Weights[i] * b + 32) >> 6);
+			}
+		}
+		fit.error = FitIndices(block, palette, 16, 4, fit.indices);
+	}
+
+	BC7Fit FitBC7(const Block& block, const float e0[4], const float e1[4], int p0, int p1)
+	{
+		BC7Fit fit;
+		fit.endpoints.p[0] = p0;
+		fit.endpoints.p[1] = p1;
+		QuantizeBC7(e0, p0, fit.endpoints.q[0]);
+		QuantizeBC7(e1, p1, fit.endpoints.q[1]);
+		EvaluateBC7(block, fit);
+		return fit;
+	}
+
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(uint8_t* out) : m_out(out), m_position(0) {}
+
+		void Write(uint32_t value, uint32_t bits)
+		{
+			for (uint32_t b = 0; b < bits; ++b, ++m_position)
+			{
+				if ((value >> b) & 1)
+				{
+					m_out[m_position >> 3] |= static_cast<uint8_t>(1 << (m_position & 7));
+				}
+			}
+		}
+
+	private:
+		uint8_t*	m_out;
+		uint32_t	m_position;
+	};
+
+	class BitReader
+	{
+	public:
+		explicit BitReader(const uint8_t* in) : m_in(in), m_position(0) {}
+
+		uint32_t Read(uint32_t bits)
+		{
+			uint32_t value = 0;
+			for (uint32_t b = 0; b < bits; ++b, ++m_position)
+			{
+				value |= uint32_t((m_in[m_position >> 3] >> (m_position & 7)) & 1) << b;
+			}
+			return value;
+		}
+
+	private:
+		const uint8_t*	m_in;
+		uint32_t		m_position;
+	};
+
+	void DecodeColour(const uint8_t* block, bool allowThreeColour, uint8_t rgba[64])
+	{
+		uint16_t c0 = uint16_t(block[0] | (block[1] << 8));
+		uint16_t c1 = uint16_t(block[2] | (block[3] << 8));
+		uint32_t bits;
+		std::memcpy(&bits, block + 4, 4);
+
+		int palette[4][4];
+		BuildColourPalette(c0, c1, !allowThreeColour || c0 > c1, palette);
+		for (int i = 0; i < 16; ++i)
+		{
+			const int* entry = palette[(bits >> (i * 2)) & 3];
+			for (int c = 0; c < 4; ++c)
+			{
+				rgba[i * 4 + c] = static_cast<uint8_t>(entry[c]);
+			}
+		}
+	}
+
+	void DecodeChannel(const uint8_t* block, int channel, uint8_t rgba[64])
+	{
+		int palette[8];
+		BuildChannelPalette(block[0], block[1], palette);
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i)
+		{
+			bits |= uint64_t(block[2 + i]) << (i * 8);
+		}
+		for (int i = 0; i < 16; ++i)
+		{
+			rgba[i * 4 + channel] = static_cast<uint8_t>(palette[(bits >> (i * 3)) & 7]);
+		}
+	}
+
+	bool DecodeBC7(const uint8_t* block, uint8_t rgba[64])
+	{
+		BitReader reader(block);
+		if (reader.Read(7) != 0x40)
+		{
+			return false;
+		}
+
+		int endpoint[2][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			endpoint[0][c] = static_cast<int>(reader.Read(7)) << 1;
+			endpoint[1][c] = static_cast<int>(reader.Read(7)) << 1;
+		}
+		for (int e = 0; e < 2; ++e)
+		{
+			int p = static_cast<int>(reader.Read(1));
+			for (int c = 0; c < 4; ++c)
+			{
+				endpoint[e][c] |= p;
+			}
+		}
+		for (int i = 0; i < 16; ++i)
+		{
+			int w = c_BC7Weights[reader.Read(i == 0 ? 3 : 4)];
+			for (int c = 0; c < 4; ++c)
+			{
+				rgba[i * 4 + c] = static_cast<uint8_t>(((64 - w) * endpoint[0][c] + w * endpoint[1][c] + 32) >> 6);
+			}
+		}
+		return true;
+	}
+}
+
+void BlockCompression::EncodeBC1(const uint8_t rgba[64], uint8_t block[8], Quality quality)
+{
+	EncodeColour(rgba, true, quality, block);
+}
+
+void BlockCompression::EncodeBC3(const uint8_t rgba[64], uint8_t block[16], Quality quality)
+{
+	EncodeChannel(rgba, 3, quality, block);
+	EncodeColour(rgba, false, quality, block + 8);
+}
+
+void BlockCompression::EncodeBC4(const uint8_t rgba[64], uint8_t block[8], Quality quality)
+{
+	EncodeChannel(rgba, 0, quality, block);
+}
+
+void BlockCompression::EncodeBC5(const uint8_t rgba[64], uint8_t block[16], Quality quality)
+{
+	EncodeChannel(rgba, 0, quality, block);
+	EncodeChannel(rgba, 1, quality, block + 8);
+}
+
+void BlockCompression::EncodeBC7(const uint8_t rgba[64], uint8_t block[16], Quality quality)
+{
+	Block pixels;
+	LoadBlock(rgba, pixels);
+
+	bool opaque = true;
+	for (int i = 0; i < 16; ++i)
+	{
+		opaque &= rgba[i * 4 + 3] == 255;
+	}
+
+	// Opaque blocks keep alpha at exactly 255, which takes the p-bits at 1
+	float e0[4], e1[4];
+	PrincipalAxisEndpoints(pixels, opaque ? 3 : 4, e0, e1);
+	if (opaque)
+	{
+		e0[3] = e1[3] = 255.0f;
+	}
+
+	auto fitEndpoints = [&](const float a[4], const float b[4])
+	{
+		if (opaque)
+		{
+			return FitBC7(pixels, a, b, 1, 1);
+		}
+		if (quality != Quality::High)
+		{
+			return FitBC7(pixels, a, b, ChooseBC7PBit(a), ChooseBC7PBit(b));
+		}
+		BC7Fit best;
+		best.error = FLT_MAX;
+		for (int p = 0; p < 4; ++p)
+		{
+			BC7Fit trial = FitBC7(pixels, a, b, p & 1, p >> 1);
+			if (trial.error < best.error)
+			{
+				best = trial;
+			}
+		}
+		return best;
+	};
+
+	BC7Fit best = fitEndpoints(e0, e1);
+	int refinements = quality == Quality::Fast ? 0 : quality == Quality::Normal ? 1 : 2;
+	for (int i = 0; i < refinements; ++i)
+	{
+		float weights[16];
+		for (int w = 0; w < 16; ++w)
+		{
+			weights[w] = c_BC7Weights[w] / 64.0f;
+		}
+		float r0[4], r1[4];
+		if (!RefineEndpoints(pixels, 4, best.indices, weights, r0, r1))
+		{
+			break;
+		}
+		if (opaque)
+		{
+			r0[3] = r1[3] = 255.0f;
+		}
+		BC7Fit trial = fitEndpoints(r0, r1);
+		if (trial.error >= best.error)
+		{
+			break;
+		}
+		best = trial;
+	}
+
+	if (quality == Quality::High)
+	{
+		int channels = opaque ? 3 : 4;
+		for (int pass = 0; pass < 4; ++pass)
+		{
+			bool improved = false;
+			for (int e = 0; e < 2; ++e)
+			{
+				for (int c = 0; c < channels; ++c)
+				{
+					for (int step = -1; step <= 1; step += 2)
+					{
+						BC7Fit trial = best;
+						int& value = trial.endpoints.q[e][c];
+						value += step;
+						if (value < 0 || value > 127)
+						{
+							continue;
+						}
+						EvaluateBC7(pixels, trial);
+						if (trial.error < best.error)
+						{
+							best = trial;
+							improved = true;
+						}
+					}
+				}
+			}
+			if (!improved)
+			{
+				break;
+			}
+		}
+	}
+
+	// The first pixel's index is stored with its top bit implied 0, swapping the endpoints makes it so
+	if (best.indices[0] >= 8)
+	{
+		std::swap(best.endpoints.q[0], best.endpoints.q[1]);
+		std::swap(best.endpoints.p[0], best.endpoints.p[1]);
+		for (uint8_t& index : best.indices)
+		{
+			index = static_cast<uint8_t>(15 - index);
+		}
+	}
+
+	std::memset(block, 0, 16);
+	BitWriter writer(block);
+	writer.Write(0x40, 7);
+	for (int c = 0; c < 4; ++c)
+	{
+		writer.Write(best.endpoints.q[0][c], 7);
+		writer.Write(best.endpoints.q[1][c], 7);
+	}
+	writer.Write(best.endpoints.p[0], 1);
+	writer.Write(best.endpoints.p[1], 1);
+	for (int i = 0; i < 16; ++i)
+	{
+		writer.Write(best.indices[i], i == 0 ? 3 : 4);
+	}
+}
+
+bool BlockCompression::DecodeBlock(uint32_t format, const uint8_t * block, uint8_t rgba[64])
+{
+	switch (format)
+	{
+	case DDS::FormatBC1Unorm:
+		DecodeColour(block, true, rgba);
+		return true;
+
+	case DDS::FormatBC2Unorm:
+		DecodeColour(block + 8, false, rgba);
+		for (int i = 0; i < 16; ++i)
+		{
+			int alpha = (block[i / 2] >> ((i & 1) * 4)) & 15;
+			rgba[i * 4 + 3] = static_cast<uint8_t>(alpha * 17);
+		}
+		return true;
+
+	case DDS::FormatBC3Unorm:
+		DecodeColour(block + 8, false, rgba);
+		DecodeChannel(block, 3, rgba);
+		return true;
+
+	case DDS::FormatBC4Unorm:
+	case DDS::FormatBC5Unorm:
+		for (int i = 0; i < 16; ++i)
+		{
+			rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+			rgba[i * 4 + 3] = 255;
+		}
+		DecodeChannel(block, 0, rgba);
+		if (format == DDS::FormatBC5Unorm)
+		{
+			DecodeChannel(block + 8, 1, rgba);
+		}
+		return true;
+
+	case DDS::FormatBC7Unorm:
+		return DecodeBC7(block, rgba);
+
+	default:
+		return false;
+	}
+}
+
+bool BlockCompression::CanEncode(uint32_t format)
+{
+	switch (format)
+	{
+	case DDS::FormatBC1Unorm:
+	case DDS::FormatBC3Unorm:
+	case DDS::FormatBC4Unorm:
+	case DDS::FormatBC5Unorm:
+	case DDS::FormatBC7Unorm:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool BlockCompression::EncodeImage(uint32_t format, const uint8_t * rgba, uint32_t width, uint32_t height, uint8_t * output, Quality quality, ThreadPool * pool)
+{
+	if (!CanEncode(format) || !width || !height)
+	{
+		return false;
+	}
+
+	uint32_t blockBytes = DDS::GetBytesPerBlock(format);
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	ThreadPool::For(pool, blocksY, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t by = begin; by < end; ++by)
+		{
+			for (uint32_t bx = 0; bx < blocksX; ++bx)
+			{
+				uint8_t pixels[64];
+				for (uint32_t y = 0; y < 4; ++y)
+				{
+					uint32_t sy = std::min(uint32_t(by) * 4 + y, height - 1);
+					for (uint32_t x = 0; x < 4; ++x)
+					{
+						uint32_t sx = std::min(bx * 4 + x, width - 1);
+						std::memcpy(pixels + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+					}
+				}
+
+				uint8_t* block = output + (by * blocksX + bx) * blockBytes;
+				switch (format)
+				{
+				case DDS::FormatBC1Unorm:	EncodeBC1(pixels, block, quality);	break;
+				case DDS::FormatBC3Unorm:	EncodeBC3(pixels, block, quality);	break;
+				case DDS::FormatBC4Unorm:	EncodeBC4(pixels, block, quality);	break;
+				case DDS::FormatBC5Unorm:	EncodeBC5(pixels, block, quality);	break;
+				default:					EncodeBC7(pixels, block, quality);	break;
+				}
+			}
+		}
+	});
+	return true;
+}
+
+bool BlockCompression::DecodeImage(uint32_t format, const uint8_t * data, uint32_t width, uint32_t height, uint8_t * rgba)
+{
+	size_t pixels = size_t(width) * height;
+	switch (format)
+	{
+	case DDS::FormatR8G8B8A8Unorm:
+		std::memcpy(rgba, data, pixels * 4);
+		return true;
+
+	case DDS::FormatB8G8R8A8Unorm:
+	case DDS::FormatB8G8R8X8Unorm:
+		for (size_t i = 0; i < pixels; ++i)
+		{
+			rgba[i * 4 + 0] = data[i * 4 + 2];
+			rgba[i * 4 + 1] = data[i * 4 + 1];
+			rgba[i * 4 + 2] = data[i * 4 + 0];
+			rgba[i * 4 + 3] = format == DDS::FormatB8G8R8X8Unorm ? 255 : data[i * 4 + 3];
+		}
+		return true;
+
+	default:
+		break;
+	}
+
+	uint32_t blockBytes = DDS::GetBytesPerBlock(format);
+	if (!blockBytes)
+	{
+		return false;
+	}
+
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	for (uint32_t by = 0; by < blocksY; ++by)
+	{
+		for (uint32_t bx = 0; bx < blocksX; ++bx)
+		{
+			uint8_t decoded[64];
+			if (!DecodeBlock(format, data + (size_t(by) * blocksX + bx) * blockBytes, decoded))
+			{
+				return false;
+			}
+			for (uint32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+			{
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+				{
+					std::memcpy(rgba + ((size_t(by) * 4 + y) * width + bx * 4 + x) * 4, decoded + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void BlockCompression::Downsample(const uint8_t * rgba, uint32_t width, uint32_t height, uint8_t * output)
+{
+	uint32_t outWidth = std::max(1u, width / 2);
+	uint32_t outHeight = std::max(1u, height / 2);
+	for (uint32_t y = 0; y < outHeight; ++y)
+	{
+		// The source rows this output row covers, the last one of an odd height takes three
+		uint32_t y0 = y * height / outHeight;
+		uint32_t y1 = (y + 1) * height / outHeight;
+		for (uint32_t x = 0; x < outWidth; ++x)
+		{
+			uint32_t x0 = x * width / outWidth;
+			uint32_t x1 = (x + 1) * width / outWidth;
+			uint32_t sum[4] = {};
+			for (uint32_t sy = y0; sy < y1; ++sy)
+			{
+				for (uint32_t sx = x0; sx < x1; ++sx)
+				{
+					const uint8_t* pixel = rgba + (size_t(sy) * width + sx) * 4;
+					for (int c = 0; c < 4; ++c)
+					{
+						sum[c] += pixel[c];
+					}
+				}
+			}
+			uint32_t count = (y1 - y0) * (x1 - x0);
+			for (int c = 0; c < 4; ++c)
+			{
+				output[(size_t(y) * outWidth + x) * 4 + c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+			}
+		}
+	}
+}
+
+void BlockCompression::Resize(const uint8_t * rgba, uint32_t width, uint32_t height, uint8_t * output, uint32_t outputWidth, uint32_t outputHeight)
+{
+	// Box filtered halves first, bilinear alone would skip source pixels when shrinking by more than two
+	std::vector<uint8_t> level(rgba, rgba + size_t(width) * height * 4), next;
+	while (width / 2 >= outputWidth && height / 2 >= outputHeight)
+	{
+		next.resize(size_t(width / 2) * (height / 2) * 4);
+		Downsample(level.data(), width, height, next.data());
+		level.swap(next);
+		width /= 2;
+		height /= 2;
+	}
+
+	float scaleX = float(width) / outputWidth, scaleY = float(height) / outputHeight;
+	for (uint32_t y = 0; y < outputHeight; ++y)
+	{
+		// Pixel centres line up, the taps either side of the first and last wrap to the other edge
+		float sourceY = (y + 0.5f) * scaleY - 0.5f;
+		float floorY = std::floor(sourceY);
+		float fy = sourceY - floorY;
+		uint32_t y0 = (static_cast<int>(floorY) + height) % height;
+		uint32_t y1 = (y0 + 1) % height;
+		for (uint32_t x = 0; x < outputWidth; ++x)
+		{
+			float sourceX = (x + 0.5f) * scaleX - 0.5f;
+			float floorX = std::floor(sourceX);
+			float fx = sourceX - floorX;
+			uint32_t x0 = (static_cast<int>(floorX) + width) % width;
+			uint32_t x1 = (x0 + 1) % width;
+
+			const uint8_t* p00 = level.data() + (size_t(y0) * width + x0) * 4;
+			const uint8_t* p01 = level.data() + (size_t(y0) * width + x1) * 4;
+			const uint8_t* p10 = level.data() + (size_t(y1) * width + x0) * 4;
+			const uint8_t* p11 = level.data() + (size_t(y1) * width + x1) * 4;
+			for (int c = 0; c < 4; ++c)
+			{
+				float top = p00[c] + (p01[c] - p00[c]) * fx;
+				float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+				output[(size_t(y) * outputWidth + x) * 4 + c] = static_cast<uint8_t>(top + (bottom - top) * fy + 0.5f);
+			}
+		}
+	}
+}
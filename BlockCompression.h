@@ -0,0 +1,54 @@
+//
+// BlockCompression.h - BC1/BC3/BC4/BC5/BC7 block encoding and decoding for the offline texture tools
+//
+// Encoding works on 4x4 blocks of RGBA8 pixels. Endpoints start at the ends of the principal axis of the block's
+// colours, indices are fitted four pixels at a time with SSE2, and the higher qualities refine the endpoints by least
+// squares and then a local search. BC7 uses mode 6 only (one subset, RGBA endpoints with 4 bit indices): much simpler
+// than searching all eight modes and still clearly better than BC3. Whole images are split over a ThreadPool by rows
+// of blocks.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+namespace BlockCompression
+{
+	enum class Quality : uint8_t
+	{
+		Fast,		//principal axis endpoints only
+		Normal,		//plus a least squares refit of the endpoints to the chosen indices
+		High,		//plus a local endpoint search, the 3 colour BC1 mode and every BC7 p-bit combination
+	};
+
+	//One block from 16 RGBA8 pixels, row major. BC1 gives pixels with alpha below 128 the transparent index,
+	//BC4 takes the red channel and BC5 red and green.
+	void EncodeBC1(const uint8_t rgba[64], uint8_t block[8], Quality quality);
+	void EncodeBC3(const uint8_t rgba[64], uint8_t block[16], Quality quality);
+	void EncodeBC4(const uint8_t rgba[64], uint8_t block[8], Quality quality);
+	void EncodeBC5(const uint8_t rgba[64], uint8_t block[16], Quality quality);
+	void EncodeBC7(const uint8_t rgba[64], uint8_t block[16], Quality quality);
+
+	//BC1 to BC5 and BC7 mode 6 blocks back to RGBA8. False for other formats and BC7 modes.
+	bool DecodeBlock(uint32_t format, const uint8_t* block, uint8_t rgba[64]);
+
+	//Whether EncodeImage can write the format
+	bool CanEncode(uint32_t format);
+
+	//A whole level, tightly packed. Sizes that aren't multiples of 4 repeat the last row and column in the edge blocks.
+	bool EncodeImage(uint32_t format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* output, Quality quality, ThreadPool* pool);
+
+	//A tightly packed level of a block compressed or 8 bit RGBA / BGRA format to RGBA8
+	bool DecodeImage(uint32_t format, const uint8_t* data, uint32_t width, uint32_t height, uint8_t* rgba);
+
+	//The next mip level down, each output pixel the average of the source pixels it covers (two by two, three wide
+	//at the end of an odd row or column)
+	void Downsample(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* output);
+
+	//Any size to any other: halved with Downsample while that doesn't go below the target, then bilinear filtered
+	//the rest of the way. Edges wrap, since the textures this is for tile.
+	void Resize(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* output, uint32_t outputWidth, uint32_t outputHeight);
+}
@@ -0,0 +1,467 @@
+// Bone order, instance lanes and the AVX2 and SSE2 blend, compose and hierarchy kernels
+#include "BoneHierarchy.h"
+
+#include <cstring>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// The AVX2 kernel is built for AVX2 whatever the rest of the file targets and only called when HasAvx2 says so
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+	constexpr size_t c_Lanes = BoneHierarchy::c_Lanes;
+	constexpr size_t c_Elements = BoneHierarchy::c_Elements;
+	constexpr size_t c_BoneSize = c_Elements * c_Lanes;
+	constexpr size_t c_PoseSize = BoneHierarchy::c_PoseElements * c_Lanes;
+
+	// Every bone of a pose block from a towards b by each lane's weight, as BlendPoses does: the rotations nlerped
+	// along the shorter arc, so b's weight takes the sign of the dot, then normalized
+	TARGET_AVX2 void BlendBlockAvx2(const float* a, const float* b, const float* weights, float* out, size_t count)
+	{
+		const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), signBit = _mm256_set1_ps(-0.0f);
+		const __m256 t = _mm256_loadu_ps(weights), ta = _mm256_sub_ps(one, t);
+		for (size_t position = 0; position < count; ++position)
+		{
+			const float* inA = a + position * c_PoseSize;
+			const float* inB = b + position * c_PoseSize;
+			float* pose = out + position * c_PoseSize;
+
+			__m256 qa[4], qb[4], dot = zero;
+			for (size_t e = 0; e < 4; ++e)
+			{
+				qa[e] = _mm256_loadu_ps(inA + e * c_Lanes);
+				qb[e] = _mm256_loadu_ps(inB + e * c_Lanes);
+				dot = _mm256_fmadd_ps(qa[e], qb[e], dot);
+			}
+			__m256 tb = _mm256_xor_ps(t, _mm256_and_ps(_mm256_cmp_ps(dot, zero, _CMP_LT_OQ), signBit));
+			__m256 q[4], lengthSquared = zero;
+			for (size_t e = 0; e < 4; ++e)
+			{
+				q[e] = _mm256_fmadd_ps(qb[e], tb, _mm256_mul_ps(qa[e], ta));
+				lengthSquared = _mm256_fmadd_ps(q[e], q[e], lengthSquared);
+			}
+			__m256 scale = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared));
+			for (size_t e = 0; e < 4; ++e)
+			{
+				_mm256_storeu_ps(pose + e * c_Lanes, _mm256_mul_ps(q[e], scale));
+			}
+			for (size_t e = 4; e < BoneHierarchy::c_PoseElements; ++e)
+			{
+				__m256 from = _mm256_loadu_ps(inA + e * c_Lanes);
+				_mm256_storeu_ps(pose + e * c_Lanes, _mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(inB + e * c_Lanes), from), t, from));
+			}
+		}
+	}
+
+	// The same four lanes at a time
+	void BlendBlockSse2(const float* a, const float* b, const float* weights, float* out, size_t count)
+	{
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), signBit = _mm_set1_ps(-0.0f);
+		for (size_t half = 0; half < c_Lanes; half += 4)
+		{
+			const __m128 t = _mm_loadu_ps(weights + half), ta = _mm_sub_ps(one, t);
+			for (size_t position = 0; position < count; ++position)
+			{
+				const float* inA = a + position * c_PoseSize + half;
+				const float* inB = b + position * c_PoseSize + half;
+				float* pose = out + position * c_PoseSize + half;
+
+				__m128 qa[4], qb[4], dot = zero;
+				for (size_t e = 0; e < 4; ++e)
+				{
+					qa[e] = _mm_loadu_ps(inA + e * c_Lanes);
+					qb[e] = _mm_loadu_ps(inB + e * c_Lanes);
+					dot = _mm_add_ps(dot, _mm_mul_ps(qa[e], qb[e]));
+				}
+				__m128 tb = _mm_xor_ps(t, _mm_and_ps(_mm_cmplt_ps(dot, zero), signBit));
+				__m128 q[4], lengthSquared = zero;
+				for (size_t e = 0; e < 4; ++e)
+				{
+					q[e] = _mm_add_ps(_mm_mul_ps(qa[e], ta), _mm_mul_ps(qb[e], tb));
+					lengthSquared = _mm_add_ps(lengthSquared, _mm_mul_ps(q[e], q[e]));
+				}
+				__m128 scale = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+				for (size_t e = 0; e < 4; ++e)
+				{
+					_mm_storeu_ps(pose + e * c_Lanes, _mm_mul_ps(q[e], scale));
+				}
+				for (size_t e = 4; e < BoneHierarchy::c_PoseElements; ++e)
+				{
+					__m128 from = _mm_loadu_ps(inA + e * c_Lanes);
+					_mm_storeu_ps(pose + e * c_Lanes, _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(inB + e * c_Lanes), from), t)));
+				}
+			}
+		}
+	}
+
+	// One bone of a pose block: the rotation's rows as DirectXMath builds them from the quaternion, the translation
+	// as the fourth, each times the bind transform, which is the same for every lane so its elements are broadcast
+	TARGET_AVX2 void ComposeBlockAvx2(const float* poses, const float* bind, float* local, const uint32_t* order, size_t count)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+		for (size_t position = 0; position < count; ++position)
+		{
+			const float* in = poses + position * c_PoseSize;
+			const float* b = bind + order[position] * 16;
+			float* out = local + position * c_BoneSize;
+
+			__m256 x = _mm256_loadu_ps(in), y = _mm256_loadu_ps(in + c_Lanes), z = _mm256_loadu_ps(in + 2 * c_Lanes), w = _mm256_loadu_ps(in + 3 * c_Lanes);
+			__m256 x2 = _mm256_mul_ps(x, two), y2 = _mm256_mul_ps(y, two), z2 = _mm256_mul_ps(z, two);
+			__m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+			__m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+			__m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+			const __m256 r[4][3] = {
+				{ _mm256_sub_ps(one, _mm256_add_ps(yy, zz)), _mm256_add_ps(xy, wz), _mm256_sub_ps(xz, wy) },
+				{ _mm256_sub_ps(xy, wz), _mm256_sub_ps(one, _mm256_add_ps(xx, zz)), _mm256_add_ps(yz, wx) },
+				{ _mm256_add_ps(xz, wy), _mm256_sub_ps(yz, wx), _mm256_sub_ps(one, _mm256_add_ps(xx, yy)) },
+				{ _mm256_loadu_ps(in + 4 * c_Lanes), _mm256_loadu_ps(in + 5 * c_Lanes), _mm256_loadu_ps(in + 6 * c_Lanes) } };
+			for (size_t row = 0; row < 4; ++row)
+			{
+				for (size_t column = 0; column < 3; ++column)
+				{
+					__m256 sum = row == 3 ? _mm256_set1_ps(b[12 + column]) : _mm256_setzero_ps();
+					sum = _mm256_fmadd_ps(r[row][0], _mm256_set1_ps(b[column]), sum);
+					sum = _mm256_fmadd_ps(r[row][1], _mm256_set1_ps(b[4 + column]), sum);
+					sum = _mm256_fmadd_ps(r[row][2], _mm256_set1_ps(b[8 + column]), sum);
+					_mm256_storeu_ps(out + (row * 3 + column) * c_Lanes, sum);
+				}
+			}
+		}
+	}
+
+	// The same four lanes at a time
+	void ComposeBlockSse2(const float* poses, const float* bind, float* local, const uint32_t* order, size_t count)
+	{
+		const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+		for (size_t position = 0; position < count; ++position)
+		{
+			const float* b = bind + order[position] * 16;
+			for (size_t half = 0; half < c_Lanes; half += 4)
+			{
+				const float* in = poses + position * c_PoseSize + half;
+				float* out = local + position * c_BoneSize + half;
+
+				__m128 x = _mm_loadu_ps(in), y = _mm_loadu_ps(in + c_Lanes), z = _mm_loadu_ps(in + 2 * c_Lanes), w = _mm_loadu_ps(in + 3 * c_Lanes);
+				__m128 x2 = _mm_mul_ps(x, two), y2 = _mm_mul_ps(y, two), z2 = _mm_mul_ps(z, two);
+				__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+				__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+				__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+				const __m128 r[4][3] = {
+					{ _mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_add_ps(xy, wz), _mm_sub_ps(xz, wy) },
+					{ _mm_sub_ps(xy, wz), _mm_sub_ps(one, _mm_add_ps(xx, zz)), _mm_add_ps(yz, wx) },
+					{ _mm_add_ps(xz, wy), _mm_sub_ps(yz, wx), _mm_sub_ps(one, _mm_add_ps(xx, yy)) },
+					{ _mm_loadu_ps(in + 4 * c_Lanes), _mm_loadu_ps(in + 5 * c_Lanes), _mm_loadu_ps(in + 6 * c_Lanes) } };
+				for (size_t row = 0; row < 4; ++row)
+				{
+					for (size_t column = 0; column < 3; ++column)
+					{
+						__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[row][0], _mm_set1_ps(b[column])), _mm_mul_ps(r[row][1], _mm_set1_ps(b[4 + column]))),
+							_mm_mul_ps(r[row][2], _mm_set1_ps(b[8 + column])));
+						if (row == 3)
+						{
+							sum = _mm_add_ps(sum, _mm_set1_ps(b[12 + column]));
+						}
+						_mm_storeu_ps(out + (row * 3 + column) * c_Lanes, sum);
+					}
+				}
+			}
+		}
+	}
+
+	// One bone of an instance block: local times the parent's absolute, both affine, so the parent's fourth column
+	// and the local's are (0, 0, 0, 1) and only the translation row adds the parent's
+	TARGET_AVX2 void SolveBlockAvx2(const float* local, float* absolute, const uint32_t* parents, size_t count)
+	{
+		for (size_t position = 0; position < count; ++position)
+		{
+			const float* in = local + position * c_BoneSize;
+			float* out = absolute + position * c_BoneSize;
+			uint32_t parent = parents[position];
+			if (parent == BoneHierarchy::c_NoParent)
+			{
+				std::memcpy(out, in, c_BoneSize * sizeof(float));
+				continue;
+			}
+
+			const float* up = absolute + parent * c_BoneSize;
+			__m256 p[c_Elements];
+			for (size_t e = 0; e < c_Elements; ++e)
+			{
+				p[e] = _mm256_loadu_ps(up + e * c_Lanes);
+			}
+			for (size_t row = 0; row < 4; ++row)
+			{
+				__m256 l0 = _mm256_loadu_ps(in + (row * 3) * c_Lanes);
+				__m256 l1 = _mm256_loadu_ps(in + (row * 3 + 1) * c_Lanes);
+				__m256 l2 = _mm256_loadu_ps(in + (row * 3 + 2) * c_Lanes);
+				for (size_t column = 0; column < 3; ++column)
+				{
+					__m256 sum = row == 3 ? p[9 + column] : _mm256_setzero_ps();
+					sum = _mm256_fmadd_ps(l0, p[column], sum);
+					sum = _mm256_fmadd_ps(l1, p[3 + column], sum);
+					sum = _mm256_fmadd_ps(l2, p[6 + column], sum);
+					_mm256_storeu_ps(out + (row * 3 + column) * c_Lanes, sum);
+				}
+			}
+		}
+	}
+
+	// The same four lanes at a time, for CPUs without AVX2
+	void SolveBlockSse2(const float* local, float* absolute, const uint32_t* parents, size_t count)
+	{
+		for (size_t position = 0; position < count; ++position)
+		{
+			const float* in = local + position * c_BoneSize;
+			float* out = absolute + position * c_BoneSize;
+			uint32_t parent = parents[position];
+			if (parent == BoneHierarchy::c_NoParent)
+			{
+				std::memcpy(out, in, c_BoneSize * sizeof(float));
+				continue;
+			}
+
+			const float* up = absolute + parent * c_BoneSize;
+			for (size_t half = 0; half < c_Lanes; half += 4)
+			{
+				__m128 p[c_Elements];
+				for (size_t e = 0; e < c_Elements; ++e)
+				{
+					p[e] = _mm_loadu_ps(up + e * c_Lanes + half);
+				}
+				for (size_t row = 0; row < 4; ++row)
+				{
+					__m128 l0 = _mm_loadu_ps(in + (row * 3) * c_Lanes + half);
+					__m128 l1 = _mm_loadu_ps(in + (row * 3 + 1) * c_Lanes + half);
+					__m128 l2 = _mm_loadu_ps(in + (row * 3 + 2) * c_Lanes + half);
+					for (size_t column = 0; column < 3; ++column)
+					{
+						__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(l0, p[column]), _mm_mul_ps(l1, p[3 + column])), _mm_mul_ps(l2, p[6 + column]));
+						if (row == 3)
+						{
+							sum = _mm_add_ps(sum, p[9 + column]);
+						}
+						_mm_storeu_ps(out + (row * 3 + column) * c_Lanes + half, sum);
+					}
+				}
+			}
+		}
+	}
+}
+
+bool BoneHierarchy::SetHierarchy(const uint32_t * parents, size_t count)
+{
+	m_order.clear();
+	m_position.assign(count, c_NoParent);
+	m_parents.clear();
+	m_poseOffsets.clear();
+
+	// Roots first, then the children of each bone already placed. Whatever is never reached is in a cycle.
+	std::vector<std::vector<uint32_t>> children(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (parents[i] == c_NoParent)
+		{
+			m_order.push_back(static_cast<uint32_t>(i));
+		}
+		else if (parents[i] < count)
+		{
+			children[parents[i]].push_back(static_cast<uint32_t>(i));
+		}
+		else
+		{
+			m_order.clear();
+			m_position.clear();
+			return false;
+		}
+	}
+	for (size_t next = 0; next < m_order.size(); ++next)
+	{
+		const std::vector<uint32_t>& bones = children[m_order[next]];
+		m_order.insert(m_order.end(), bones.begin(), bones.end());
+	}
+	if (m_order.size() != count)
+	{
+		m_order.clear();
+		m_position.clear();
+		return false;
+	}
+
+	for (size_t position = 0; position < count; ++position)
+	{
+		m_position[m_order[position]] = static_cast<uint32_t>(position);
+	}
+	m_parents.resize(count);
+	for (size_t position = 0; position < count; ++position)
+	{
+		uint32_t parent = parents[m_order[position]];
+		m_parents[position] = parent == c_NoParent ? c_NoParent : m_position[parent];
+	}
+	m_poseOffsets.resize(count);
+	for (size_t bone = 0; bone < count; ++bone)
+	{
+		m_poseOffsets[bone] = static_cast<uint32_t>(m_position[bone] * c_PoseSize);
+	}
+	return true;
+}
+
+void BoneHierarchy::ResetPoses(float * poses, size_t instance) const
+{
+	static const float identity[c_PoseElements] = { 0, 0, 0, 1, 0, 0, 0 };
+	float* lane = poses + GetPoseLane(instance);
+	for (size_t position = 0; position < m_order.size(); ++position)
+	{
+		for (size_t e = 0; e < c_PoseElements; ++e)
+		{
+			lane[position * c_PoseSize + e * c_Lanes] = identity[e];
+		}
+	}
+}
+
+void BoneHierarchy::Blend(const float * a, const float * b, const float * weights, float * out, size_t blockCount) const
+{
+	static const bool avx2 = HasAvx2();
+	const size_t poseBlockSize = GetPoseBlockSize();
+	for (size_t block = 0; block < blockCount; ++block)
+	{
+		size_t offset = block * poseBlockSize;
+		if (avx2)
+		{
+			BlendBlockAvx2(a + offset, b + offset, weights + block * c_Lanes, out + offset, m_order.size());
+		}
+		else
+		{
+			BlendBlockSse2(a + offset, b + offset, weights + block * c_Lanes, out + offset, m_order.size());
+		}
+	}
+}
+
+void BoneHierarchy::Compose(const float * poses, const float * bind, float * local, size_t blockCount) const
+{
+	static const bool avx2 = HasAvx2();
+	const size_t poseBlockSize = GetPoseBlockSize(), blockSize = GetBlockSize();
+	for (size_t block = 0; block < blockCount; ++block)
+	{
+		if (avx2)
+		{
+			ComposeBlockAvx2(poses + block * poseBlockSize, bind, local + block * blockSize, m_order.data(), m_order.size());
+		}
+		else
+		{
+			ComposeBlockSse2(poses + block * poseBlockSize, bind, local + block * blockSize, m_order.data(), m_order.size());
+		}
+	}
+}
+
+void BoneHierarchy::Unpack(const float * blocks, size_t instance, float * matrices) const
+{
+	const float* block = blocks + instance / c_Lanes * GetBlockSize() + instance % c_Lanes;
+	for (size_t bone = 0; bone < m_order.size(); ++bone)
+	{
+		const float* in = block + m_position[bone] * c_BoneSize;
+		float* matrix = matrices + bone * 16;
+		for (size_t row = 0; row < 4; ++row)
+		{
+			for (size_t column = 0; column < 3; ++column)
+			{
+				matrix[row * 4 + column] = in[(row * 3 + column) * c_Lanes];
+			}
+			matrix[row * 4 + 3] = row == 3 ? 1.0f : 0.0f;
+		}
+	}
+}
+
+void BoneHierarchy::Solve(const float * local, float * absolute, size_t blockCount) const
+{
+	static const bool avx2 = HasAvx2();
+	const size_t blockSize = GetBlockSize();
+	for (size_t block = 0; block < blockCount; ++block)
+	{
+		if (avx2)
+		{
+			SolveBlockAvx2(local + block * blockSize, absolute + block * blockSize, m_parents.data(), m_parents.size());
+		}
+		else
+		{
+			SolveBlockSse2(local + block * blockSize, absolute + block * blockSize, m_parents.data(), m_parents.size());
+		}
+	}
+}
+
+void BoneHierarchy::SolveReference(const float * local, float * absolute, size_t blockCount) const
+{
+	const size_t blockSize = GetBlockSize();
+	for (size_t block = 0; block < blockCount; ++block)
+	{
+		for (size_t position = 0; position < m_parents.size(); ++position)
+		{
+			const float* in = local + block * blockSize + position * c_BoneSize;
+			float* out = absolute + block * blockSize + position * c_BoneSize;
+			uint32_t parent = m_parents[position];
+			const float* up = parent == c_NoParent ? nullptr : absolute + block * blockSize + parent * c_BoneSize;
+			for (size_t lane = 0; lane < c_Lanes; ++lane)
+			{
+				for (size_t row = 0; row < 4; ++row)
+				{
+					for (size_t column = 0; column < 3; ++column)
+					{
+						float value = in[(row * 3 + column) * c_Lanes + lane];
+						if (up)
+						{
+							value = row == 3 ? up[(9 + column) * c_Lanes + lane] : 0.0f;
+							for (size_t k = 0; k < 3; ++k)
+							{
+								value += in[(row * 3 + k) * c_Lanes + lane] * up[(k * 3 + column) * c_Lanes + lane];
+							}
+						}
+						out[(row * 3 + column) * c_Lanes + lane] = value;
+					}
+				}
+			}
+		}
+	}
+}
+
+void BoneHierarchy::WritePalette(const float * absolute, size_t instance, const float * world, PaletteEntry * palette) const
+{
+	// The fourth column is (0, 0, 0, 1), so only the translation row adds the world's
+	const float* lane = absolute + instance / c_Lanes * GetBlockSize() + instance % c_Lanes;
+	for (size_t bone = 0; bone < m_order.size(); ++bone)
+	{
+		const float* in = lane + m_position[bone] * c_BoneSize;
+		PaletteEntry& entry = palette[bone];
+		for (size_t row = 0; row < 4; ++row)
+		{
+			float a0 = in[(row * 3) * c_Lanes], a1 = in[(row * 3 + 1) * c_Lanes], a2 = in[(row * 3 + 2) * c_Lanes];
+			for (size_t column = 0; column < 3; ++column)
+			{
+				float value = a0 * world[column] + a1 * world[4 + column] + a2 * world[8 + column];
+				entry.rows[column][row] = row == 3 ? value + world[12 + column] : value;
+			}
+		}
+	}
+}
+
+bool BoneHierarchy::HasAvx2()
+{
+#if defined(_MSC_VER)
+	// AVX2 and FMA from CPUID, and the OS saving the YMM registers from XGETBV
+	int info[4];
+	__cpuid(info, 1);
+	bool fma = (info[2] & (1 << 12)) != 0, osxsave = (info[2] & (1 << 27)) != 0;
+	if (!fma || !osxsave || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
@@ -0,0 +1,81 @@
+//
+// BoneHierarchy.h - Absolute bone transforms of many instances of one hierarchy at once
+//
+// Bones are stored structure of arrays in blocks of c_Lanes instances: for each bone, parents before children, the
+// twelve elements of its transform that an affine matrix uses, each as c_Lanes floats, one per instance. Solve is then
+// one linear pass over the bones of each block, and every instruction works on c_Lanes instances of the same bone,
+// whose parent is in the same lanes of an earlier bone: no gathers, no shuffles and no lane wasted but the last
+// block's. AVX2 with FMA takes a block a bone at a time when the CPU has it, SSE2 half a block otherwise.
+//
+// Poses are kept the same way, seven elements a bone, so an animation samples each instance straight into its lanes
+// (see ClipSampler::Sample), Blend mixes two blocks of poses lane by lane, Compose turns a block of poses into a block
+// of local transforms and WritePalette reads an instance's palette out of the solved block: no instance is ever packed
+// from or unpacked into matrices on the way.
+//
+// Instances are the lanes rather than one model's bones because a bone's siblings are few: the tank's 14 bones are 6
+// levels deep, at most 6 to a level, so bone lanes would be two thirds empty.
+//
+
+#pragma once
+
+#include "BonePalette.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BoneHierarchy
+{
+public:
+	static constexpr uint32_t c_NoParent = 0xffffffffu;
+	static constexpr size_t c_Lanes = 8;
+	static constexpr size_t c_Elements = 12;		//rows 0 to 3, columns 0 to 2 of a row major affine 4x4
+	static constexpr size_t c_PoseElements = 7;		//rotation x, y, z, w then translation x, y, z, as in BonePose
+
+	//False, and empty, if a parent index is out of range or the bones form a cycle
+	bool SetHierarchy(const uint32_t* parents, size_t count);
+	size_t GetCount() const { return m_order.size(); }
+
+	//Floats in one block of c_Lanes instances, and blocks for a number of instances
+	size_t GetBlockSize() const { return m_order.size() * c_Elements * c_Lanes; }
+	static size_t GetBlockCount(size_t instances) { return (instances + c_Lanes - 1) / c_Lanes; }
+	size_t GetPoseBlockSize() const { return m_order.size() * c_PoseElements * c_Lanes; }
+
+	//An instance's first pose float in blocks of poses, and each bone's offset from it. A bone's elements follow
+	//c_Lanes floats apart.
+	size_t GetPoseLane(size_t instance) const { return instance / c_Lanes * GetPoseBlockSize() + instance % c_Lanes; }
+	const uint32_t* GetPoseOffsets() const { return m_poseOffsets.data(); }
+
+	//Every bone of an instance to the identity pose, for the bones its clips have no track for
+	void ResetPoses(float* poses, size_t instance) const;
+
+	//Every bone from a towards b by its lane's weight, c_Lanes weights a block, as BlendPoses does. Lanes weighted 0
+	//come out as a. out may be a.
+	void Blend(const float* a, const float* b, const float* weights, float* out, size_t blockCount) const;
+
+	//Each bone's local transform from its pose, as ComposeBoneTransforms makes it: rotation, then translation, then
+	//the bone's bind transform. bind is row major 4x4 per bone in bone order, the same for every instance.
+	void Compose(const float* poses, const float* bind, float* local, size_t blockCount) const;
+
+	//One instance's transforms out of its lanes, row major 4x4 in bone order with the fourth column (0, 0, 0, 1). For
+	//tools and one off queries, not for every frame.
+	void Unpack(const float* blocks, size_t instance, float* matrices) const;
+
+	//Every instance's absolute transforms from its local ones, blockCount blocks in and out. absolute may not alias local.
+	void Solve(const float* local, float* absolute, size_t blockCount) const;
+
+	//The same in plain C++, to check the kernels against and to time them
+	void SolveReference(const float* local, float* absolute, size_t blockCount) const;
+
+	//One instance's palette entries in bone order straight from its lanes: each absolute transform times world, the
+	//first three columns as rows, as BonePalette writes them
+	void WritePalette(const float* absolute, size_t instance, const float* world, PaletteEntry* palette) const;
+
+	static bool HasAvx2();
+
+private:
+	std::vector<uint32_t>	m_order;			//bone at each position, parents before children
+	std::vector<uint32_t>	m_position;			//position of each bone
+	std::vector<uint32_t>	m_parents;			//position of each position's parent, c_NoParent for roots
+	std::vector<uint32_t>	m_poseOffsets;		//each bone's first pose float from its instance's, see GetPoseLane
+};
@@ -0,0 +1,134 @@
+// Bone hierarchy order and the SSE2 palette kernel
+#include "BonePalette.h"
+
+#include <emmintrin.h>
+
+namespace
+{
+	// One row of a * b: the row's elements broadcast against b's rows
+	inline __m128 MultiplyRow(__m128 row, __m128 b0, __m128 b1, __m128 b2, __m128 b3)
+	{
+		__m128 x = _mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0));
+		__m128 y = _mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 z = _mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2));
+		__m128 w = _mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3));
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, b0), _mm_mul_ps(y, b1)), _mm_add_ps(_mm_mul_ps(z, b2), _mm_mul_ps(w, b3)));
+	}
+
+	void MultiplyReference(const float* a, const float* b, float* out)
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				out[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column]
+					+ a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+			}
+		}
+	}
+}
+
+bool BonePalette::SetHierarchy(const uint32_t * parents, size_t count)
+{
+	m_parents.assign(parents, parents + count);
+	m_order.clear();
+	m_order.reserve(count);
+
+	// Roots first, then the children of each bone already placed. Whatever is never reached is in a cycle.
+	std::vector<std::vector<uint32_t>> children(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (parents[i] == c_NoParent)
+		{
+			m_order.push_back(static_cast<uint32_t>(i));
+		}
+		else if (parents[i] < count)
+		{
+			children[parents[i]].push_back(static_cast<uint32_t>(i));
+		}
+		else
+		{
+			m_parents.clear();
+			m_order.clear();
+			return false;
+		}
+	}
+	for (size_t next = 0; next < m_order.size(); ++next)
+	{
+		const std::vector<uint32_t>& bones = children[m_order[next]];
+		m_order.insert(m_order.end(), bones.begin(), bones.end());
+	}
+
+	if (m_order.size() != count)
+	{
+		m_parents.clear();
+		m_order.clear();
+		return false;
+	}
+	return true;
+}
+
+void BonePalette::Build(const float * local, const float * world, float * absolute, PaletteEntry * palette) const
+{
+	const __m128 w0 = _mm_load_ps(world), w1 = _mm_load_ps(world + 4), w2 = _mm_load_ps(world + 8), w3 = _mm_load_ps(world + 12);
+	const __m128 identity0 = _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f), identity1 = _mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f);
+	const __m128 identity2 = _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f), identity3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for (uint32_t bone : m_order)
+	{
+		const float* in = local + bone * 16;
+		__m128 l0 = _mm_load_ps(in), l1 = _mm_load_ps(in + 4), l2 = _mm_load_ps(in + 8), l3 = _mm_load_ps(in + 12);
+
+		// The parent's absolute transform was written earlier in the pass, a root's parent is the identity
+		__m128 p0 = identity0, p1 = identity1, p2 = identity2, p3 = identity3;
+		uint32_t parent = m_parents[bone];
+		if (parent != c_NoParent)
+		{
+			const float* parentAbsolute = absolute + parent * 16;
+			p0 = _mm_load_ps(parentAbsolute);
+			p1 = _mm_load_ps(parentAbsolute + 4);
+			p2 = _mm_load_ps(parentAbsolute + 8);
+			p3 = _mm_load_ps(parentAbsolute + 12);
+		}
+
+		__m128 a0 = MultiplyRow(l0, p0, p1, p2, p3), a1 = MultiplyRow(l1, p0, p1, p2, p3);
+		__m128 a2 = MultiplyRow(l2, p0, p1, p2, p3), a3 = MultiplyRow(l3, p0, p1, p2, p3);
+		float* out = absolute + bone * 16;
+		_mm_store_ps(out, a0);
+		_mm_store_ps(out + 4, a1);
+		_mm_store_ps(out + 8, a2);
+		_mm_store_ps(out + 12, a3);
+
+		// Into the world, then the columns become the entry's rows. The fourth column of an affine transform is
+		// always (0, 0, 0, 1) and isn't stored.
+		__m128 r0 = MultiplyRow(a0, w0, w1, w2, w3), r1 = MultiplyRow(a1, w0, w1, w2, w3);
+		__m128 r2 = MultiplyRow(a2, w0, w1, w2, w3), r3 = MultiplyRow(a3, w0, w1, w2, w3);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		PaletteEntry& entry = palette[bone];
+		_mm_store_ps(entry.rows[0], r0);
+		_mm_store_ps(entry.rows[1], r1);
+		_mm_store_ps(entry.rows[2], r2);
+	}
+}
+
+void BonePalette::BuildReference(const float * local, const float * world, float * absolute, PaletteEntry * palette) const
+{
+	static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+	for (uint32_t bone : m_order)
+	{
+		uint32_t parent = m_parents[bone];
+		float* out = absolute + bone * 16;
+		MultiplyReference(local + bone * 16, parent == c_NoParent ? identity : absolute + parent * 16, out);
+
+		float placed[16];
+		MultiplyReference(out, world, placed);
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				palette[bone].rows[row][column] = placed[column * 4 + row];
+			}
+		}
+	}
+}
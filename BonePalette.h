@@ -0,0 +1,41 @@
+//
+// BonePalette.h - Absolute bone transforms and the per frame palette of a rigidly animated model
+//
+// SetHierarchy orders the bones so every parent comes before its children. Build then makes one pass in that order:
+// each bone's absolute transform is its local transform times its parent's absolute one, and its palette entry is
+// the absolute transform times the object's world, transposed to the three float4 rows the vertex shader dots
+// positions with. Matrices are row major for row vectors, as DirectXMath stores them: 16 floats, 16 byte aligned.
+// The kernel is SSE2, a matrix row is four broadcast multiply-adds.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//One bone of the palette as the shader reads it, the first three columns of its 4x4 as rows
+struct alignas(16) PaletteEntry
+{
+	float	rows[3][4];
+};
+
+class BonePalette
+{
+public:
+	static constexpr uint32_t c_NoParent = 0xffffffffu;
+
+	//False, and empty, if a parent index is out of range or the bones form a cycle
+	bool SetHierarchy(const uint32_t* parents, size_t count);
+	size_t GetCount() const { return m_parents.size(); }
+
+	//count local transforms in, count absolute transforms and palette entries out. absolute may not alias local.
+	void Build(const float* local, const float* world, float* absolute, PaletteEntry* palette) const;
+
+	//The same in plain C++, to check the kernel against and to time it
+	void BuildReference(const float* local, const float* world, float* absolute, PaletteEntry* palette) const;
+
+private:
+	std::vector<uint32_t>	m_parents;
+	std::vector<uint32_t>	m_order;		//parents before children
+};
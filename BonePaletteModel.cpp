@@ -0,0 +1,407 @@
+// Bone palette upload and instanced part draws for the tank
+#include "pch.h"
+#include "BonePaletteModel.h"
+#include "InputLayoutCache.h"
+
+#include <numeric>
+
+using namespace DirectX;
+
+BonePaletteModel::BonePaletteModel() :
+	m_model(nullptr),
+	m_boneCount(0),
+	m_instanceCount(0),
+	m_lodsChanged(false),
+	m_lodIndexFormat(DXGI_FORMAT_UNKNOWN)
+{
+}
+
+
+BonePaletteModel::~BonePaletteModel()
+{
+}
+
+bool BonePaletteModel::Init(ID3D11Device * device, ID3D11DeviceContext * context, const Model & model, UINT instanceCount)
+{
+	Reset();
+
+	std::vector<uint32_t> parents(model.bones.size());
+	for (size_t i = 0; i < parents.size(); ++i)
+	{
+		uint32_t parent = model.bones[i].parentIndex;
+		parents[i] = parent == ModelBone::c_Invalid ? BonePalette::c_NoParent : parent;
+	}
+	if (model.meshes.empty() || instanceCount == 0 || !m_palette.SetHierarchy(parents.data(), parents.size()))
+	{
+		return false;
+	}
+
+	// One BONEINDEX per mesh and instance, a mesh's run of instances together so one draw of a part covers them all.
+	// A mesh without a bone gets the entry past its instance's bones that holds the world alone.
+	UINT boneCount = static_cast<UINT>(parents.size());
+	VertexFormat partFormat;
+	for (const auto& mesh : model.meshes)
+	{
+		UINT meshIndex = static_cast<UINT>(m_meshBones.size());
+		m_meshBones.push_back(mesh->boneIndex < boneCount ? mesh->boneIndex : boneCount);
+		for (UINT instance = 0; instance < instanceCount; ++instance)
+		{
+			m_boneIndexData.push_back(instance * (boneCount + 1) + m_meshBones.back());
+		}
+
+		UINT subset = 0;
+		for (const auto& part : mesh->meshParts)
+		{
+			m_parts.push_back({ part.get(), meshIndex, subset++, part->isAlpha, {}, nullptr });
+		}
+	}
+
+	for (Part& part : m_parts)
+	{
+		const ModelMeshPart* meshPart = part.part;
+		if (!meshPart->vbDecl || meshPart->vbDecl->empty())
+		{
+			Reset();
+			return false;
+		}
+		VertexFormat format = InputLayoutCache::FromInputElements(meshPart->vbDecl->data(), meshPart->vbDecl->size());
+		if (partFormat.Empty())
+		{
+			partFormat = format;
+		}
+		else if (format != partFormat)
+		{
+			Reset();
+			return false;
+		}
+
+		// The part's effect binds its diffuse texture, keep it to bind without the effect
+		if (meshPart->effect)
+		{
+			meshPart->effect->Apply(context);
+			context->PSGetShaderResources(0, 1, part.texture.GetAddressOf());
+		}
+	}
+	if (m_parts.empty())
+	{
+		Reset();
+		return false;
+	}
+	m_format = partFormat;
+	m_format.Add("BONEINDEX", 0, VertexElementFormat::UInt1, 1, true, 1);
+
+	// Rewritten in level order when instances change level, see Upload
+	D3D11_BUFFER_DESC indexDesc = {};
+	indexDesc.Usage = D3D11_USAGE_DYNAMIC;
+	indexDesc.ByteWidth = static_cast<UINT>(m_boneIndexData.size() * sizeof(uint32_t));
+	indexDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	indexDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	D3D11_SUBRESOURCE_DATA indexData = {};
+	indexData.pSysMem = m_boneIndexData.data();
+
+	D3D11_BUFFER_DESC paletteDesc;
+	paletteDesc.Usage = D3D11_USAGE_DYNAMIC;
+	paletteDesc.ByteWidth = (boneCount + 1) * instanceCount * static_cast<UINT>(sizeof(PaletteEntry));
+	paletteDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	paletteDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	paletteDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	paletteDesc.StructureByteStride = sizeof(PaletteEntry);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = (boneCount + 1) * instanceCount;
+
+	if (FAILED(device->CreateBuffer(&indexDesc, &indexData, m_boneIndices.ReleaseAndGetAddressOf()))
+		|| FAILED(device->CreateBuffer(&paletteDesc, NULL, m_paletteBuffer.ReleaseAndGetAddressOf()))
+		|| FAILED(device->CreateShaderResourceView(m_paletteBuffer.Get(), &srvDesc, m_paletteView.ReleaseAndGetAddressOf())))
+	{
+		Reset();
+		return false;
+	}
+
+	m_entries.assign((boneCount + 1) * instanceCount, PaletteEntry());
+	m_instanceLods.assign(instanceCount, 0);
+	m_lodOrder.resize(instanceCount);
+	std::iota(m_lodOrder.begin(), m_lodOrder.end(), 0u);
+	m_lodStarts = { 0, instanceCount };
+	m_lodErrors.assign(1, 0.0f);
+	m_boneCount = boneCount;
+	m_instanceCount = instanceCount;
+	m_model = &model;
+	return true;
+}
+
+void BonePaletteModel::Reset()
+{
+	m_model = nullptr;
+	m_boneCount = 0;
+	m_instanceCount = 0;
+	m_palette.SetHierarchy(nullptr, 0);
+	m_format = VertexFormat();
+	m_parts.clear();
+	m_entries.clear();
+	m_meshBones.clear();
+	m_instanceLods.clear();
+	m_lodOrder.clear();
+	m_lodStarts.clear();
+	m_lodErrors.clear();
+	m_boneIndexData.clear();
+	m_lodsChanged = false;
+	m_lodIndexFormat = DXGI_FORMAT_UNKNOWN;
+	m_lodIndices.Reset();
+	m_boneIndices.Reset();
+	m_paletteBuffer.Reset();
+	m_paletteView.Reset();
+}
+
+void BonePaletteModel::Update(const XMMATRIX * localBones, FXMMATRIX world, XMMATRIX * absoluteBones)
+{
+	if (!m_model)
+	{
+		return;
+	}
+
+	XMFLOAT4X4A worldRows;
+	XMStoreFloat4x4A(&worldRows, world);
+	m_palette.Build(reinterpret_cast<const float*>(localBones), &worldRows._11, reinterpret_cast<float*>(absoluteBones), m_entries.data());
+
+	// The entry past the bones is the world alone, its first three columns as rows
+	XMFLOAT4X4A columns;
+	XMStoreFloat4x4A(&columns, XMMatrixTranspose(world));
+	memcpy(m_entries[m_boneCount].rows, &columns._11, sizeof(m_entries[m_boneCount].rows));
+}
+
+bool BonePaletteModel::SetLods(ID3D11Device * device, const std::vector<LodChain>& chains)
+{
+	if (!m_model)
+	{
+		return false;
+	}
+
+	// The chains' errors are in each mesh's own units, its bone's scale at rest takes them to the model's
+	size_t boneCount = m_model->bones.size();
+	auto rest = ModelBone::MakeArray(boneCount);
+	m_model->CopyAbsoluteBoneTransformsTo(boneCount, rest.get());
+
+	std::vector<uint32_t> indices;
+	std::vector<float> errors(1, 0.0f);
+	bool wide = false;
+	for (Part& part : m_parts)
+	{
+		part.lods.clear();
+		const ModelMesh& mesh = *m_model->meshes[part.mesh];
+		std::string name;
+		for (wchar_t c : mesh.name)
+		{
+			name.push_back(static_cast<char>(c));
+		}
+		const LodChain* chain = LodChain::Find(chains, name, part.subset);
+		if (!chain || chain->GetLevelCount() < 2 || chain->GetLevel(0).indexCount != part.part->indexCount)
+		{
+			continue;
+		}
+
+		float scale = mesh.boneIndex < boneCount ? XMVectorGetX(XMVector3Length(rest[mesh.boneIndex].r[0])) : 1.0f;
+		part.lods.push_back({ 0, part.part->indexCount, 0.0f });
+		for (uint32_t level = 1; level < chain->GetLevelCount(); ++level)
+		{
+			const LodLevel& lod = chain->GetLevel(level);
+			part.lods.push_back({ static_cast<uint32_t>(indices.size()), lod.indexCount, lod.error * scale });
+			indices.insert(indices.end(), chain->GetIndices().begin() + lod.indexStart, chain->GetIndices().begin() + lod.indexStart + lod.indexCount);
+		}
+		if (errors.size() < part.lods.size())
+		{
+			errors.resize(part.lods.size(), 0.0f);
+		}
+		wide = wide || part.part->indexFormat == DXGI_FORMAT_R32_UINT;
+	}
+
+	// A part with a shorter chain draws its last level at the coarser ones, so that level's error counts there too
+	for (const Part& part : m_parts)
+	{
+		for (size_t level = 1; level < errors.size() && !part.lods.empty(); ++level)
+		{
+			errors[level] = std::max(errors[level], part.lods[std::min(level, part.lods.size() - 1)].error);
+		}
+	}
+
+	m_lodIndices.Reset();
+	if (indices.empty())
+	{
+		for (Part& part : m_parts)
+		{
+			part.lods.clear();
+		}
+		errors.resize(1);
+	}
+	else
+	{
+		// The parts' own format, 16 bits unless one of them needs 32
+		std::vector<uint16_t> narrow;
+		if (!wide)
+		{
+			narrow.assign(indices.begin(), indices.end());
+		}
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.ByteWidth = static_cast<UINT>(indices.size() * (wide ? sizeof(uint32_t) : sizeof(uint16_t)));
+		desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		D3D11_SUBRESOURCE_DATA data = {};
+		data.pSysMem = wide ? static_cast<const void*>(indices.data()) : narrow.data();
+		if (FAILED(device->CreateBuffer(&desc, &data, m_lodIndices.ReleaseAndGetAddressOf())))
+		{
+			for (Part& part : m_parts)
+			{
+				part.lods.clear();
+			}
+			errors.resize(1);
+		}
+		else
+		{
+			m_lodIndexFormat = wide ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+		}
+	}
+
+	m_lodErrors = errors;
+	for (UINT instance = 0; instance < m_instanceCount; ++instance)
+	{
+		SetInstanceLod(instance, m_instanceLods[instance]);
+	}
+	m_lodsChanged = true;
+	return m_lodErrors.size() > 1;
+}
+
+void BonePaletteModel::SetInstanceLod(UINT instance, UINT level)
+{
+	uint8_t clamped = static_cast<uint8_t>(std::min(level, GetLodCount() - 1));
+	if (m_instanceLods[instance] != clamped)
+	{
+		m_instanceLods[instance] = clamped;
+		m_lodsChanged = true;
+	}
+}
+
+void BonePaletteModel::Upload(ID3D11DeviceContext * context)
+{
+	if (!m_model)
+	{
+		return;
+	}
+
+	// Each mesh's run of BONEINDEX in level order, the same order for every mesh so one level's instances are the
+	// same stretch of each run
+	if (m_lodsChanged)
+	{
+		m_lodStarts.assign(GetLodCount() + 1, 0);
+		for (uint8_t level : m_instanceLods)
+		{
+			++m_lodStarts[level + 1];
+		}
+		std::partial_sum(m_lodStarts.begin(), m_lodStarts.end(), m_lodStarts.begin());
+		std::vector<UINT> next(m_lodStarts.begin(), m_lodStarts.end() - 1);
+		for (UINT instance = 0; instance < m_instanceCount; ++instance)
+		{
+			m_lodOrder[next[m_instanceLods[instance]]++] = instance;
+		}
+
+		for (size_t mesh = 0; mesh < m_meshBones.size(); ++mesh)
+		{
+			for (UINT i = 0; i < m_instanceCount; ++i)
+			{
+				m_boneIndexData[mesh * m_instanceCount + i] = m_lodOrder[i] * (m_boneCount + 1) + m_meshBones[mesh];
+			}
+		}
+
+		D3D11_MAPPED_SUBRESOURCE mappedIndices;
+		if (SUCCEEDED(context->Map(m_boneIndices.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedIndices)))
+		{
+			memcpy(mappedIndices.pData, m_boneIndexData.data(), m_boneIndexData.size() * sizeof(uint32_t));
+			context->Unmap(m_boneIndices.Get(), 0);
+			m_lodsChanged = false;
+		}
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (SUCCEEDED(context->Map(m_paletteBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+	{
+		memcpy(mappedResource.pData, m_entries.data(), m_entries.size() * sizeof(PaletteEntry));
+		context->Unmap(m_paletteBuffer.Get(), 0);
+	}
+}
+
+void BonePaletteModel::Draw(ID3D11DeviceContext * context, const CommonStates & states)
+{
+	for (bool alpha : { false, true })
+	{
+		ModelMesh::PrepareForRendering(context, states, alpha);
+		DrawParts(context, alpha ? 1 : 0, true);
+	}
+}
+
+void BonePaletteModel::DrawDepth(ID3D11DeviceContext * context)
+{
+	DrawParts(context, -1, false);
+}
+
+void BonePaletteModel::DrawParts(ID3D11DeviceContext * context, int alpha, bool withTextures)
+{
+	if (!m_model)
+	{
+		return;
+	}
+
+	ID3D11ShaderResourceView* palette = m_paletteView.Get();
+	context->VSSetShaderResources(0, 1, &palette);
+
+	for (const Part& part : m_parts)
+	{
+		if (alpha >= 0 && part.alpha != (alpha != 0))
+		{
+			continue;
+		}
+
+		const ModelMeshPart* meshPart = part.part;
+		ID3D11Buffer* buffers[2] = { meshPart->vertexBuffer.Get(), m_boneIndices.Get() };
+		UINT strides[2] = { meshPart->vertexStride, sizeof(uint32_t) };
+		UINT offsets[2] = { 0, 0 };
+		context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+		context->IASetPrimitiveTopology(meshPart->primitiveType);
+		if (withTextures)
+		{
+			ID3D11ShaderResourceView* texture = part.texture.Get();
+			context->PSSetShaderResources(0, 1, &texture);
+		}
+
+		// The start instance is the first BONEINDEX of the level's instances in the mesh's run, each instance reads the
+		// next one and the vertex shader finds its palette entry with it
+		bool ownIndices = false;
+		for (size_t level = 0; level + 1 < m_lodStarts.size(); ++level)
+		{
+			UINT instances = m_lodStarts[level + 1] - m_lodStarts[level];
+			if (!instances)
+			{
+				continue;
+			}
+
+			UINT startInstance = part.mesh * m_instanceCount + m_lodStarts[level];
+			if (level == 0 || part.lods.empty())
+			{
+				if (!ownIndices)
+				{
+					context->IASetIndexBuffer(meshPart->indexBuffer.Get(), meshPart->indexFormat, 0);
+					ownIndices = true;
+				}
+				context->DrawIndexedInstanced(meshPart->indexCount, instances, meshPart->startIndex, meshPart->vertexOffset, startInstance);
+			}
+			else
+			{
+				const LodLevel& lod = part.lods[std::min(level, part.lods.size() - 1)];
+				context->IASetIndexBuffer(m_lodIndices.Get(), m_lodIndexFormat, 0);
+				ownIndices = false;
+				context->DrawIndexedInstanced(lod.indexCount, instances, lod.indexStart, meshPart->vertexOffset, startInstance);
+			}
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "BonePalette.h"
+#include "LodChain.h"
+#include "VertexFormat.h"
+
+//Draws instances of a rigidly animated DirectXTK Model over a bone palette, see BonePalette.h. The bones' transforms
+//times the world go up once a frame and every part is one DrawIndexedInstanced over every instance, whose start
+//instance picks its mesh's run of bones, so no constants are written between parts. The vertex shaders built with
+//BONE_PALETTE read:
+//	t0 (VS)	StructuredBuffer<PaletteBone>	bonePalette, per instance one entry per bone plus the world alone for meshes without one
+//	slot 1	BONEINDEX						per instance, one uint per mesh and instance of the model
+//With levels of detail each mesh's run of BONEINDEX is ordered by level, rewritten when an instance changes level, and
+//a part is one draw per level in use over that level's instances.
+class BonePaletteModel
+{
+public:
+	BonePaletteModel();
+	~BonePaletteModel();
+
+	//Builds the hierarchy, the bone index stream and the palette buffer, and takes each part's texture from its effect.
+	//False if the model's hierarchy is broken or its parts don't share a vertex format, Model::Draw then draws it.
+	bool Init(ID3D11Device* device, ID3D11DeviceContext* context, const DirectX::Model& model, UINT instanceCount = 1);
+	void Reset();
+	bool IsReady() const { return m_model != nullptr; }
+
+	//The parts' vertex format plus BONEINDEX, for the shaders that draw the model
+	const VertexFormat& GetVertexFormat() const { return m_format; }
+
+	//This frame's absolute bone transforms from the local ones (16 byte aligned, one per bone) and the palette of the
+	//first instance
+	void Update(const DirectX::XMMATRIX* localBones, DirectX::FXMMATRIX world, DirectX::XMMATRIX* absoluteBones);
+
+	//An instance's GetBoneCount() + 1 entries, for palettes built elsewhere such as AnimationCrowd::Update
+	PaletteEntry* GetInstancePalette(UINT instance) { return m_entries.data() + instance * (m_boneCount + 1); }
+	UINT GetBoneCount() const { return m_boneCount; }
+	UINT GetInstanceCount() const { return m_instanceCount; }
+
+	//Coarser index runs for the parts from Tools/BuildLods, matched by mesh name and subset. A part without a chain, or
+	//with one not built from its indices, draws its own triangles at every level. False if no part matches.
+	bool SetLods(ID3D11Device* device, const std::vector<LodChain>& chains);
+	UINT GetLodCount() const { return static_cast<UINT>(m_lodErrors.size()); }
+	//Each level's largest error over the parts in model units, for LodSelector::Select
+	const float* GetLodErrors() const { return m_lodErrors.data(); }
+
+	//The level an instance is drawn at from the next Upload, 0 for the model's own triangles
+	void SetInstanceLod(UINT instance, UINT level);
+	UINT GetInstanceLod(UINT instance) const { return m_instanceLods[instance]; }
+
+	//Uploads the palette with one Map, once a frame before the first draw, and the bone indices if a level changed
+	void Upload(ID3D11DeviceContext* context);
+
+	//Every part with the shader already enabled, opaque ones then blended ones like Model::Draw, with their textures
+	void Draw(ID3D11DeviceContext* context, const DirectX::CommonStates& states);
+
+	//Every part in the states already set, no textures, for the depth only passes
+	void DrawDepth(ID3D11DeviceContext* context);
+
+private:
+	void DrawParts(ID3D11DeviceContext* context, int alpha, bool withTextures);		//alpha -1 for every part
+
+	struct Part
+	{
+		const DirectX::ModelMeshPart*							part;
+		UINT													mesh;		//its BONEINDEX run starts at mesh * instances
+		UINT													subset;		//of its mesh
+		bool													alpha;
+		std::vector<LodLevel>									lods;		//runs of m_lodIndices, level 0 unused
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>		texture;
+	};
+
+	const DirectX::Model*									m_model;
+	UINT													m_boneCount;
+	UINT													m_instanceCount;
+	BonePalette												m_palette;
+	VertexFormat											m_format;
+	std::vector<Part>										m_parts;
+	std::vector<PaletteEntry>								m_entries;
+	std::vector<uint32_t>									m_meshBones;		//palette entry of each mesh within an instance
+	std::vector<uint8_t>									m_instanceLods;
+	std::vector<UINT>										m_lodOrder;			//instances by level
+	std::vector<UINT>										m_lodStarts;		//first of each level in m_lodOrder, and the end
+	std::vector<float>										m_lodErrors;
+	std::vector<uint32_t>									m_boneIndexData;
+	bool													m_lodsChanged;
+	DXGI_FORMAT												m_lodIndexFormat;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>					m_lodIndices;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>					m_boneIndices;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>					m_paletteBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>		m_paletteView;
+};
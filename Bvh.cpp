@@ -0,0 +1,362 @@
+// Binned SAH build and stack based traversal
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	constexpr uint32_t c_Bins = 12;
+	constexpr uint32_t c_MaxLeafSize = 4;
+	constexpr uint32_t c_StackSize = 64;
+
+	struct Box
+	{
+		float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const float p[3])
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				min[k] = std::min(min[k], p[k]);
+				max[k] = std::max(max[k], p[k]);
+			}
+		}
+
+		void Grow(const Box& other)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				min[k] = std::min(min[k], other.min[k]);
+				max[k] = std::max(max[k], other.max[k]);
+			}
+		}
+
+		float Area() const
+		{
+			float e[3] = { max[0] - min[0], max[1] - min[1], max[2] - min[2] };
+			if (e[0] < 0.0f)
+			{
+				return 0.0f;
+			}
+			return e[0] * e[1] + e[1] * e[2] + e[2] * e[0];
+		}
+	};
+
+	// Triangle data used only while building
+	struct BuildTriangle
+	{
+		Box			bounds;
+		float		centre[3];
+		uint32_t	index;
+	};
+
+	bool RayBox(const float origin[3], const float invDirection[3], const float boxMin[3], const float boxMax[3], float tMax, float& tNear)
+	{
+		float t0 = 0.0f, t1 = tMax;
+		for (int k = 0; k < 3; ++k)
+		{
+			float a = (boxMin[k] - origin[k]) * invDirection[k];
+			float b = (boxMax[k] - origin[k]) * invDirection[k];
+			// NaN from 0 * inf (origin on the slab with a parallel ray) fails neither test, which keeps the box
+			t0 = std::max(t0, std::min(a, b));
+			t1 = std::min(t1, std::max(a, b));
+		}
+		tNear = t0;
+		return t0 <= t1;
+	}
+}
+
+Bvh::Bvh()
+{
+}
+
+void Bvh::Clear()
+{
+	m_nodes.clear();
+	m_triangles.clear();
+}
+
+void Bvh::Build(const float * positions, size_t vertexCount, const uint32_t * indices, size_t triangleCount)
+{
+	Clear();
+
+	std::vector<BuildTriangle> build;
+	build.reserve(triangleCount);
+	for (size_t i = 0; i < triangleCount; ++i)
+	{
+		const uint32_t* tri = indices + i * 3;
+		if (tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount)
+		{
+			continue;
+		}
+
+		BuildTriangle t;
+		for (int c = 0; c < 3; ++c)
+		{
+			t.bounds.Grow(positions + tri[c] * 3);
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			t.centre[k] = (t.bounds.min[k] + t.bounds.max[k]) * 0.5f;
+		}
+		t.index = static_cast<uint32_t>(i);
+		build.push_back(t);
+	}
+	if (build.empty())
+	{
+		return;
+	}
+
+	// Split ranges of build[] until they are small enough to be leaves, children always pushed as a pair
+	struct Task
+	{
+		uint32_t	node;
+		uint32_t	first;
+		uint32_t	count;
+	};
+	std::vector<Task> tasks;
+	m_nodes.reserve(build.size() * 2);
+	m_nodes.push_back(Node());
+	tasks.push_back({ 0, 0, static_cast<uint32_t>(build.size()) });
+
+	while (!tasks.empty())
+	{
+		Task task = tasks.back();
+		tasks.pop_back();
+
+		Box bounds, centres;
+		for (uint32_t i = task.first; i < task.first + task.count; ++i)
+		{
+			bounds.Grow(build[i].bounds);
+			centres.Grow(build[i].centre);
+		}
+
+		Node& node = m_nodes[task.node];
+		for (int k = 0; k < 3; ++k)
+		{
+			node.min[k] = bounds.min[k];
+			node.max[k] = bounds.max[k];
+		}
+		node.first = task.first;
+		node.count = task.count;
+		if (task.count <= c_MaxLeafSize)
+		{
+			continue;
+		}
+
+		// Cheapest bin boundary over all three axes
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float extent = centres.max[axis] - centres.min[axis];
+			if (extent <= 0.0f)
+			{
+				continue;
+			}
+
+			Box binBounds[c_Bins];
+			uint32_t binCounts[c_Bins] = {};
+			float scale = float(c_Bins) / extent;
+			for (uint32_t i = task.first; i < task.first + task.count; ++i)
+			{
+				uint32_t bin = std::min(c_Bins - 1, static_cast<uint32_t>((build[i].centre[axis] - centres.min[axis]) * scale));
+				binBounds[bin].Grow(build[i].bounds);
+				++binCounts[bin];
+			}
+
+			// Sweep from the right to get the cost of everything right of each boundary
+			float rightArea[c_Bins];
+			uint32_t rightCount[c_Bins];
+			Box right;
+			uint32_t count = 0;
+			for (uint32_t b = c_Bins - 1; b > 0; --b)
+			{
+				right.Grow(binBounds[b]);
+				count += binCounts[b];
+				rightArea[b] = right.Area();
+				rightCount[b] = count;
+			}
+
+			Box left;
+			count = 0;
+			for (uint32_t b = 0; b + 1 < c_Bins; ++b)
+			{
+				left.Grow(binBounds[b]);
+				count += binCounts[b];
+				if (!count || !rightCount[b + 1])
+				{
+					continue;
+				}
+				float cost = left.Area() * float(count) + rightArea[b + 1] * float(rightCount[b + 1]);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b + 1;
+				}
+			}
+		}
+
+		// Stay a leaf when no split beats intersecting everything here, unless that makes a very large leaf
+		if (bestAxis < 0 || (bestCost >= bounds.Area() * float(task.count) && task.count <= c_MaxLeafSize * 4))
+		{
+			continue;
+		}
+
+		float scale = float(c_Bins) / (centres.max[bestAxis] - centres.min[bestAxis]);
+		auto middle = std::partition(build.begin() + task.first, build.begin() + task.first + task.count,
+			[&](const BuildTriangle& t)
+		{
+			return std::min(c_Bins - 1, static_cast<uint32_t>((t.centre[bestAxis] - centres.min[bestAxis]) * scale)) < bestSplit;
+		});
+		uint32_t leftCount = static_cast<uint32_t>(middle - build.begin()) - task.first;
+
+		uint32_t children = static_cast<uint32_t>(m_nodes.size());
+		m_nodes[task.node].first = children;
+		m_nodes[task.node].count = 0;
+		m_nodes.push_back(Node());
+		m_nodes.push_back(Node());
+		tasks.push_back({ children, task.first, leftCount });
+		tasks.push_back({ children + 1, task.first + leftCount, task.count - leftCount });
+	}
+
+	// Leaves index straight into m_triangles, which follows the final order of build[]
+	m_triangles.resize(build.size());
+	for (size_t i = 0; i < build.size(); ++i)
+	{
+		const uint32_t* tri = indices + build[i].index * 3;
+		const float* p0 = positions + tri[0] * 3;
+		const float* p1 = positions + tri[1] * 3;
+		const float* p2 = positions + tri[2] * 3;
+		Triangle& t = m_triangles[i];
+		for (int k = 0; k < 3; ++k)
+		{
+			t.v0[k] = p0[k];
+			t.edge1[k] = p1[k] - p0[k];
+			t.edge2[k] = p2[k] - p0[k];
+		}
+		t.id = build[i].index;
+	}
+}
+
+bool Bvh::Intersect(const BvhRay & ray, BvhHit & hit) const
+{
+	return Traverse<false>(ray, hit);
+}
+
+bool Bvh::Occluded(const BvhRay & ray) const
+{
+	BvhHit hit;
+	return Traverse<true>(ray, hit);
+}
+
+void Bvh::GetBounds(float boundsMin[3], float boundsMax[3]) const
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		boundsMin[k] = m_nodes.empty() ? 0.0f : m_nodes[0].min[k];
+		boundsMax[k] = m_nodes.empty() ? 0.0f : m_nodes[0].max[k];
+	}
+}
+
+template<bool AnyHit>
+bool Bvh::Traverse(const BvhRay & ray, BvhHit & hit) const
+{
+	hit.t = ray.tMax;
+	hit.u = hit.v = 0.0f;
+	hit.triangle = c_NoHit;
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	float invDirection[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		invDirection[k] = 1.0f / ray.direction[k];
+	}
+
+	float tNear;
+	if (!RayBox(ray.origin, invDirection, m_nodes[0].min, m_nodes[0].max, hit.t, tNear))
+	{
+		return false;
+	}
+
+	uint32_t stack[c_StackSize];
+	uint32_t depth = 0;
+	stack[depth++] = 0;
+
+	while (depth)
+	{
+		const Node& node = m_nodes[stack[--depth]];
+
+		if (node.count)
+		{
+			// Moller-Trumbore, no back face culling
+			for (uint32_t i = node.first; i < node.first + node.count; ++i)
+			{
+				const Triangle& tri = m_triangles[i];
+				const float* d = ray.direction;
+				float p[3] = { d[1] * tri.edge2[2] - d[2] * tri.edge2[1], d[2] * tri.edge2[0] - d[0] * tri.edge2[2], d[0] * tri.edge2[1] - d[1] * tri.edge2[0] };
+				float det = tri.edge1[0] * p[0] + tri.edge1[1] * p[1] + tri.edge1[2] * p[2];
+				if (std::fabs(det) < 1e-12f)
+				{
+					continue;
+				}
+				float invDet = 1.0f / det;
+				float s[3] = { ray.origin[0] - tri.v0[0], ray.origin[1] - tri.v0[1], ray.origin[2] - tri.v0[2] };
+				float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+				if (u < 0.0f || u > 1.0f)
+				{
+					continue;
+				}
+				float q[3] = { s[1] * tri.edge1[2] - s[2] * tri.edge1[1], s[2] * tri.edge1[0] - s[0] * tri.edge1[2], s[0] * tri.edge1[1] - s[1] * tri.edge1[0] };
+				float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+				if (v < 0.0f || u + v > 1.0f)
+				{
+					continue;
+				}
+				float t = (tri.edge2[0] * q[0] + tri.edge2[1] * q[1] + tri.edge2[2] * q[2]) * invDet;
+				if (t > 0.0f && t < hit.t)
+				{
+					hit.t = t;
+					hit.u = u;
+					hit.v = v;
+					hit.triangle = tri.id;
+					if (AnyHit)
+					{
+						return true;
+					}
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first, pushing it last
+		const Node& a = m_nodes[node.first];
+		const Node& b = m_nodes[node.first + 1];
+		float tA, tB;
+		bool hitA = RayBox(ray.origin, invDirection, a.min, a.max, hit.t, tA);
+		bool hitB = RayBox(ray.origin, invDirection, b.min, b.max, hit.t, tB);
+		if (hitA && hitB)
+		{
+			if (depth + 2 > c_StackSize)
+			{
+				continue;
+			}
+			stack[depth++] = tA < tB ? node.first + 1 : node.first;
+			stack[depth++] = tA < tB ? node.first : node.first + 1;
+		}
+		else if ((hitA || hitB) && depth < c_StackSize)
+		{
+			stack[depth++] = hitA ? node.first : node.first + 1;
+		}
+	}
+
+	return hit.triangle != c_NoHit;
+}
@@ -0,0 +1,73 @@
+//
+// Bvh.h - Bounding volume hierarchy over triangles for CPU ray casts (light baking, picking)
+//
+// Built with binned SAH splits and stored flattened, children next to each other. Triangles are copied in with their
+// edges precomputed, so the source arrays can be released after Build.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct BvhRay
+{
+	float	origin[3];
+	float	direction[3];		//doesn't need to be normalised, t is in units of its length
+	float	tMax;
+};
+
+struct BvhHit
+{
+	float		t;
+	float		u;				//barycentrics of the hit, weight of vertex 1 and vertex 2
+	float		v;
+	uint32_t	triangle;		//index of the triangle as passed to Build
+};
+
+class Bvh
+{
+public:
+	static constexpr uint32_t c_NoHit = 0xffffffffu;
+
+	Bvh();
+
+	//positions are xyz per vertex, indices three per triangle
+	void Build(const float* positions, size_t vertexCount, const uint32_t* indices, size_t triangleCount);
+	void Clear();
+
+	//Closest hit before ray.tMax. Triangles are hit from both sides.
+	bool Intersect(const BvhRay& ray, BvhHit& hit) const;
+	//Any hit before ray.tMax, for shadow rays
+	bool Occluded(const BvhRay& ray) const;
+
+	bool Empty() const { return m_nodes.empty(); }
+	size_t GetNodeCount() const { return m_nodes.size(); }
+	size_t GetTriangleCount() const { return m_triangles.size(); }
+	void GetBounds(float boundsMin[3], float boundsMax[3]) const;
+
+private:
+	//32 bytes. Interior nodes have count 0 and their children at first and first + 1.
+	struct Node
+	{
+		float		min[3];
+		uint32_t	first;
+		float		max[3];
+		uint32_t	count;
+	};
+
+	struct Triangle
+	{
+		float		v0[3];
+		float		edge1[3];
+		float		edge2[3];
+		uint32_t	id;
+	};
+
+	template<bool AnyHit>
+	bool Traverse(const BvhRay& ray, BvhHit& hit) const;
+
+	std::vector<Node>		m_nodes;
+	std::vector<Triangle>	m_triangles;
+};
@@ -0,0 +1,56 @@
+//
+// ByteBuffer.h - Reading and writing plain values in byte buffers and whole files, for the baked resource formats
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace ByteBuffer
+{
+	// Appends the bytes of a plain-old-data value.
+	template<typename T>
+	inline void WriteValue(std::vector<uint8_t>& out, const T& value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	// Reads at offset and moves past it, false without moving if the data is too short.
+	template<typename T>
+	inline bool ReadValue(const uint8_t* data, size_t size, size_t& offset, T& value)
+	{
+		if (size - offset < sizeof(T))
+		{
+			return false;
+		}
+		std::memcpy(&value, data + offset, sizeof(T));
+		offset += sizeof(T);
+		return true;
+	}
+
+	// Writes the whole buffer to path, replacing the file.
+	inline bool WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+	{
+		std::ofstream file(path, std::ios::binary);
+		return file && file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	}
+
+	// Reads all of path into data, false if it could not be opened.
+	inline bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+		data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return true;
+	}
+}
@@ -0,0 +1,186 @@
+// Upload and binding of the clustered light lists
+#include "pch.h"
+#include "ClusteredLighting.h"
+
+using Microsoft::WRL::ComPtr;
+
+
+ClusteredLighting::ClusteredLighting() :
+	m_lightUploads(0),
+	m_lightsValid(false)
+{
+}
+
+
+ClusteredLighting::~ClusteredLighting()
+{
+}
+
+bool ClusteredLighting::Init(ID3D11Device * device)
+{
+	D3D11_BUFFER_DESC clusterBufferDesc;
+
+	m_device = device;
+	m_lightsValid = false;
+
+	// Setup the description of the dynamic cluster constant buffer that is in the pixel shader.
+	clusterBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	clusterBufferDesc.ByteWidth = sizeof(ClusterBufferType);
+	clusterBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	clusterBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	clusterBufferDesc.MiscFlags = 0;
+	clusterBufferDesc.StructureByteStride = 0;
+	if (FAILED(device->CreateBuffer(&clusterBufferDesc, NULL, m_clusterBuffer.ReleaseAndGetAddressOf())))
+	{
+		return false;
+	}
+
+	// Start with room for a handful of lights, the buffers grow on demand. The light list is written in place with
+	// UpdateSubresource, the cluster lists are rewritten every frame.
+	return Reserve(m_lights, 64, sizeof(PackedLight), D3D11_USAGE_DEFAULT)
+		&& Reserve(m_ranges, 16 * 9 * 24, sizeof(uint32_t) * 2, D3D11_USAGE_DYNAMIC)
+		&& Reserve(m_indices, 1024, sizeof(uint32_t), D3D11_USAGE_DYNAMIC);
+}
+
+void ClusteredLighting::Reset()
+{
+	m_clusterBuffer.Reset();
+	m_lights = StructuredBuffer();
+	m_ranges = StructuredBuffer();
+	m_indices = StructuredBuffer();
+	m_device.Reset();
+}
+
+void ClusteredLighting::Update(ID3D11DeviceContext * context, const LightClusters & clusters, LightManager & lights, float screenWidth, float screenHeight)
+{
+	const auto& ranges = clusters.GetClusterRanges();
+	const auto& indices = clusters.GetLightIndices();
+
+	// A new light buffer starts out empty, so every light has to go up again
+	ID3D11Buffer* previousLights = m_lights.buffer.Get();
+	if (!Reserve(m_lights, lights.GetCount(), sizeof(PackedLight), D3D11_USAGE_DEFAULT)
+		|| !Reserve(m_ranges, static_cast<UINT>(ranges.size() / 2), sizeof(uint32_t) * 2, D3D11_USAGE_DYNAMIC)
+		|| !Reserve(m_indices, static_cast<UINT>(indices.size()), sizeof(uint32_t), D3D11_USAGE_DYNAMIC))
+	{
+		return;
+	}
+	if (!m_lightsValid || m_lights.buffer.Get() != previousLights)
+	{
+		lights.MarkAllDirty();
+		m_lightsValid = true;
+	}
+
+	UploadLights(context, lights);
+	Upload(context, m_ranges, ranges.data(), ranges.size() * sizeof(uint32_t));
+	Upload(context, m_indices, indices.data(), indices.size() * sizeof(uint32_t));
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (SUCCEEDED(context->Map(m_clusterBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+	{
+		const ClusterGridDesc& grid = clusters.GetGrid();
+		ClusterBufferType* dataPtr = (ClusterBufferType*)mappedResource.pData;
+		dataPtr->screenSize[0] = screenWidth;
+		dataPtr->screenSize[1] = screenHeight;
+		dataPtr->sliceScale = clusters.GetSliceScale();
+		dataPtr->sliceBias = clusters.GetSliceBias();
+		dataPtr->tilesX = grid.tilesX;
+		dataPtr->tilesY = grid.tilesY;
+		dataPtr->slices = grid.slices;
+		dataPtr->lightCount = lights.GetCount();
+		context->Unmap(m_clusterBuffer.Get(), 0);
+	}
+}
+
+void ClusteredLighting::Bind(ID3D11DeviceContext * context)
+{
+	ID3D11ShaderResourceView* views[3] = { m_lights.srv.Get(), m_ranges.srv.Get(), m_indices.srv.Get() };
+	context->PSSetShaderResources(1, 3, views);		//note slot 0 is the material texture set by the Shader
+	context->PSSetConstantBuffers(1, 1, m_clusterBuffer.GetAddressOf());
+}
+
+bool ClusteredLighting::Reserve(StructuredBuffer & target, UINT elementCount, UINT stride, D3D11_USAGE usage)
+{
+	if (target.buffer && elementCount <= target.capacity)
+	{
+		return true;
+	}
+	if (!m_device)
+	{
+		return false;
+	}
+
+	// Grow in powers of two so a slowly rising light count doesn't recreate the buffer every frame
+	UINT capacity = 1;
+	while (capacity < elementCount)
+	{
+		capacity <<= 1;
+	}
+
+	D3D11_BUFFER_DESC desc;
+	desc.Usage = usage;
+	desc.ByteWidth = capacity * stride;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = usage == D3D11_USAGE_DYNAMIC ? D3D11_CPU_ACCESS_WRITE : 0;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = stride;
+
+	StructuredBuffer created;
+	if (FAILED(m_device->CreateBuffer(&desc, NULL, created.buffer.GetAddressOf())))
+	{
+		return false;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = capacity;
+	if (FAILED(m_device->CreateShaderResourceView(created.buffer.Get(), &srvDesc, created.srv.GetAddressOf())))
+	{
+		return false;
+	}
+
+	created.capacity = capacity;
+	target = created;
+	return true;
+}
+
+void ClusteredLighting::Upload(ID3D11DeviceContext * context, StructuredBuffer & target, const void * data, size_t bytes)
+{
+	if (!bytes)
+	{
+		return;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (SUCCEEDED(context->Map(target.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+	{
+		memcpy(mappedResource.pData, data, bytes);
+		context->Unmap(target.buffer.Get(), 0);
+	}
+}
+
+void ClusteredLighting::UploadLights(ID3D11DeviceContext * context, LightManager & lights)
+{
+	m_lightUploads = 0;
+	if (!lights.IsDirty())
+	{
+		return;
+	}
+
+	// One UpdateSubresource per coalesced run of changed lights, the rest of the buffer is left as it is
+	const PackedLight* packed = lights.GetPacked().data();
+	for (const LightRange& range : lights.GetDirtyRanges())
+	{
+		D3D11_BOX box;
+		box.left = range.first * static_cast<UINT>(sizeof(PackedLight));
+		box.right = (range.first + range.count) * static_cast<UINT>(sizeof(PackedLight));
+		box.top = 0;
+		box.bottom = 1;
+		box.front = 0;
+		box.back = 1;
+		context->UpdateSubresource(m_lights.buffer.Get(), 0, &box, packed + range.first, 0, 0);
+		++m_lightUploads;
+	}
+	lights.ClearDirty();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "LightClusters.h"
+#include "LightManager.h"
+
+//GPU side of clustered forward shading. Owns the structured buffers light_ps reads:
+//	t1	StructuredBuffer<PackedLight>	every light in the scene, only the dirty ranges are rewritten each frame
+//	t2	StructuredBuffer<uint2>			(offset, count) per cluster
+//	t3	StructuredBuffer<uint>			light indices, referenced by the ranges
+//	b1	ClusterBuffer					grid dimensions and depth slicing parameters
+class ClusteredLighting
+{
+public:
+	ClusteredLighting();
+	~ClusteredLighting();
+
+	bool Init(ID3D11Device* device);
+	void Reset();
+
+	//Uploads the lights that changed since the last call and this frame's cluster lists, growing the buffers if
+	//needed. Clears the dirty flags in lights.
+	void Update(ID3D11DeviceContext* context, const LightClusters& clusters, LightManager& lights, float screenWidth, float screenHeight);
+
+	//Binds the buffers to the pixel shader slots listed above
+	void Bind(ID3D11DeviceContext* context);
+
+	UINT GetLightUploadCount() const { return m_lightUploads; }
+
+private:
+	struct ClusterBufferType
+	{
+		float		screenSize[2];
+		float		sliceScale;
+		float		sliceBias;
+		uint32_t	tilesX;
+		uint32_t	tilesY;
+		uint32_t	slices;
+		uint32_t	lightCount;
+	};
+
+	struct StructuredBuffer
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer>				buffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	srv;
+		UINT												capacity = 0;
+	};
+
+	bool Reserve(StructuredBuffer& target, UINT elementCount, UINT stride, D3D11_USAGE usage);
+	void Upload(ID3D11DeviceContext* context, StructuredBuffer& target, const void* data, size_t bytes);
+	void UploadLights(ID3D11DeviceContext* context, LightManager& lights);
+
+	Microsoft::WRL::ComPtr<ID3D11Device>	m_device;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>	m_clusterBuffer;
+	StructuredBuffer						m_lights;
+	StructuredBuffer						m_ranges;
+	StructuredBuffer						m_indices;
+
+	UINT									m_lightUploads;		//UpdateSubresource calls made by the last Update
+	bool									m_lightsValid;		//false until the light buffer holds every light
+};
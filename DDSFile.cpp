@@ -0,0 +1,258 @@
+// DDS header parsing, and writing with the DX10 extended header
+#include "DDSFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	constexpr uint32_t c_FourCCDX10 = 0x30315844;		//"DX10"
+
+	// Header flags
+	constexpr uint32_t c_HeaderCaps = 0x1;
+	constexpr uint32_t c_HeaderHeight = 0x2;
+	constexpr uint32_t c_HeaderWidth = 0x4;
+	constexpr uint32_t c_HeaderPitch = 0x8;
+	constexpr uint32_t c_HeaderPixelFormat = 0x1000;
+	constexpr uint32_t c_HeaderMipMapCount = 0x20000;
+	constexpr uint32_t c_HeaderLinearSize = 0x80000;
+	constexpr uint32_t c_HeaderDepth = 0x800000;
+	constexpr uint32_t c_PixelFormatAlphaPixels = 0x1;
+	constexpr uint32_t c_PixelFormatFourCC = 0x4;
+	constexpr uint32_t c_PixelFormatRGB = 0x40;
+	constexpr uint32_t c_CapsTexture = 0x1000;
+	constexpr uint32_t c_CapsMipMap = 0x400000;
+	constexpr uint32_t c_CapsComplex = 0x8;
+	constexpr uint32_t c_Caps2Cubemap = 0x200;
+	constexpr uint32_t c_Caps2Volume = 0x200000;
+	constexpr uint32_t c_DimensionTexture2D = 3;
+	constexpr uint32_t c_DimensionTexture3D = 4;
+	constexpr uint32_t c_MiscTextureCube = 0x4;
+
+	constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+	}
+
+	// DXGI format of a header without the DX10 extension, only the layouts the scene's files and DirectXTK's
+	// writers use
+	uint32_t GetLegacyFormat(const DDS::PixelFormat& format)
+	{
+		if (format.flags & c_PixelFormatFourCC)
+		{
+			switch (format.fourCC)
+			{
+			case MakeFourCC('D', 'X', 'T', '1'):	return DDS::FormatBC1Unorm;
+			case MakeFourCC('D', 'X', 'T', '2'):
+			case MakeFourCC('D', 'X', 'T', '3'):	return DDS::FormatBC2Unorm;
+			case MakeFourCC('D', 'X', 'T', '4'):
+			case MakeFourCC('D', 'X', 'T', '5'):	return DDS::FormatBC3Unorm;
+			case MakeFourCC('A', 'T', 'I', '1'):
+			case MakeFourCC('B', 'C', '4', 'U'):	return DDS::FormatBC4Unorm;
+			case MakeFourCC('A', 'T', 'I', '2'):
+			case MakeFourCC('B', 'C', '5', 'U'):	return DDS::FormatBC5Unorm;
+			case 113:								return DDS::FormatR16G16B16A16Float;	//D3DFMT_A16B16G16R16F
+			default:								return DDS::FormatUnknown;
+			}
+		}
+
+		if ((format.flags & c_PixelFormatRGB) && format.rgbBitCount == 32)
+		{
+			if (format.rBitMask == 0x000000ff && format.gBitMask == 0x0000ff00 && format.bBitMask == 0x00ff0000)
+			{
+				return DDS::FormatR8G8B8A8Unorm;
+			}
+			if (format.rBitMask == 0x00ff0000 && format.gBitMask == 0x0000ff00 && format.bBitMask == 0x000000ff)
+			{
+				return (format.flags & c_PixelFormatAlphaPixels) && format.aBitMask == 0xff000000 ? DDS::FormatB8G8R8A8Unorm : DDS::FormatB8G8R8X8Unorm;
+			}
+		}
+		return DDS::FormatUnknown;
+	}
+}
+
+uint32_t DDS::GetBytesPerPixel(uint32_t format)
+{
+	switch (format)
+	{
+	case FormatR16G16B16A16Float:	return 8;
+	case FormatR8G8B8A8Unorm:
+	case FormatB8G8R8A8Unorm:
+	case FormatB8G8R8X8Unorm:		return 4;
+	default:						return 0;
+	}
+}
+
+uint32_t DDS::GetBytesPerBlock(uint32_t format)
+{
+	switch (format)
+	{
+	case FormatBC1Unorm:
+	case FormatBC4Unorm:			return 8;
+	case FormatBC2Unorm:
+	case FormatBC3Unorm:
+	case FormatBC5Unorm:
+	case FormatBC7Unorm:			return 16;
+	default:						return 0;
+	}
+}
+
+size_t DDS::GetSurfaceSize(uint32_t format, uint32_t width, uint32_t height)
+{
+	if (uint32_t blockBytes = GetBytesPerBlock(format))
+	{
+		return size_t(std::max(1u, (width + 3) / 4)) * std::max(1u, (height + 3) / 4) * blockBytes;
+	}
+	return size_t(width) * height * GetBytesPerPixel(format);
+}
+
+size_t DDS::GetTextureSize(const TextureInfo & info)
+{
+	size_t size = 0;
+	for (uint32_t level = 0; level < info.mipCount; ++level)
+	{
+		size += GetSurfaceSize(info.format, std::max(1u, info.width >> level), std::max(1u, info.height >> level))
+			* std::max(1u, info.depth >> level);
+	}
+	return size * info.arraySize;
+}
+
+bool DDS::ReadInfo(const void * data, size_t size, TextureInfo & info)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint32_t magic;
+	Header header;
+	if (size < sizeof(magic) + sizeof(Header))
+	{
+		return false;
+	}
+	std::memcpy(&magic, bytes, sizeof(magic));
+	std::memcpy(&header, bytes + sizeof(magic), sizeof(Header));
+	if (magic != c_Magic || header.size != sizeof(Header) || header.pixelFormat.size != sizeof(PixelFormat) || !header.width || !header.height)
+	{
+		return false;
+	}
+
+	info = TextureInfo();
+	info.width = header.width;
+	info.height = header.height;
+	info.depth = 1;
+	info.mipCount = std::max(1u, header.mipMapCount);
+	info.arraySize = 1;
+	info.dataOffset = sizeof(magic) + sizeof(Header);
+
+	if ((header.pixelFormat.flags & c_PixelFormatFourCC) && header.pixelFormat.fourCC == c_FourCCDX10)
+	{
+		HeaderDXT10 extended;
+		if (size < info.dataOffset + sizeof(HeaderDXT10))
+		{
+			return false;
+		}
+		std::memcpy(&extended, bytes + info.dataOffset, sizeof(HeaderDXT10));
+		info.dataOffset += sizeof(HeaderDXT10);
+		info.format = extended.dxgiFormat;
+		info.arraySize = std::max(1u, extended.arraySize);
+		info.cube = (extended.miscFlag & c_MiscTextureCube) != 0;
+		if (extended.resourceDimension != c_DimensionTexture2D && extended.resourceDimension != c_DimensionTexture3D)
+		{
+			return false;
+		}
+		if (extended.resourceDimension == c_DimensionTexture3D)
+		{
+			info.depth = std::max(1u, header.depth);
+		}
+	}
+	else
+	{
+		info.format = GetLegacyFormat(header.pixelFormat);
+		info.cube = (header.caps2 & c_Caps2Cubemap) != 0;
+		if ((header.flags & c_HeaderDepth) && (header.caps2 & c_Caps2Volume))
+		{
+			info.depth = std::max(1u, header.depth);
+		}
+	}
+	if (info.format == FormatUnknown || !GetSurfaceSize(info.format, 1, 1))
+	{
+		return false;
+	}
+
+	// Nothing a device couldn't create, which also keeps every size below well inside 64 bits
+	uint32_t maxDimension = info.depth > 1 ? c_MaxVolumeDimension : c_MaxDimension;
+	if (info.width > maxDimension || info.height > maxDimension || info.depth > c_MaxVolumeDimension || info.arraySize > c_MaxArraySize
+		|| (info.depth > 1 && (info.arraySize > 1 || info.cube)) || (info.cube && info.width != info.height))
+	{
+		return false;
+	}
+	uint32_t largest = std::max(std::max(info.width, info.height), info.depth);
+	uint32_t maxMips = 1;
+	while (largest >>= 1)
+	{
+		++maxMips;
+	}
+	if (info.mipCount > maxMips)
+	{
+		return false;
+	}
+
+	if (info.cube)
+	{
+		info.arraySize *= 6;
+	}
+	return true;
+}
+
+bool DDS::Write(const std::string & path, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t format, const void * data, size_t size,
+	uint32_t arraySize)
+{
+	if (!GetSurfaceSize(format, 1, 1) || !width || !height || !mipCount || !arraySize || arraySize > c_MaxArraySize)
+	{
+		return false;
+	}
+
+	// Every level of every item has to be there
+	size_t expected = 0;
+	for (uint32_t level = 0; level < mipCount; ++level)
+	{
+		expected += GetSurfaceSize(format, std::max(1u, width >> level), std::max(1u, height >> level));
+	}
+	expected *= arraySize;
+	if (size < expected)
+	{
+		return false;
+	}
+
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	header.size = sizeof(Header);
+	// Block compressed formats give the size of the top level rather than the pitch of a row
+	bool compressed = GetBytesPerBlock(format) != 0;
+	header.flags = c_HeaderCaps | c_HeaderHeight | c_HeaderWidth | c_HeaderPixelFormat
+		| (compressed ? c_HeaderLinearSize : c_HeaderPitch) | (mipCount > 1 ? c_HeaderMipMapCount : 0);
+	header.height = height;
+	header.width = width;
+	header.pitchOrLinearSize = static_cast<uint32_t>(GetSurfaceSize(format, width, compressed ? height : 1));
+	header.mipMapCount = mipCount;
+	header.pixelFormat.size = sizeof(PixelFormat);
+	header.pixelFormat.flags = c_PixelFormatFourCC;
+	header.pixelFormat.fourCC = c_FourCCDX10;
+	header.caps = c_CapsTexture | (mipCount > 1 ? c_CapsMipMap | c_CapsComplex : 0);
+
+	HeaderDXT10 extended;
+	std::memset(&extended, 0, sizeof(extended));
+	extended.dxgiFormat = format;
+	extended.resourceDimension = c_DimensionTexture2D;
+	extended.arraySize = arraySize;
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+	uint32_t magic = c_Magic;
+	file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(&extended), sizeof(extended));
+	file.write(static_cast<const char*>(data), expected);
+	return file.good();
+}
@@ -0,0 +1,112 @@
+//
+// DDSFile.h - DDS container layout, header parsing and writing
+//
+// Only the structures and DXGI format numbers are declared here so the tools and the texture streamer's workers
+// build without the Windows headers. DDSImage maps whole files and finds each level in them.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace DDS
+{
+	constexpr uint32_t c_Magic = 0x20534444;		//"DDS "
+
+	//DXGI_FORMAT values of the formats the tools write and the scene's textures use
+	enum Format : uint32_t
+	{
+		FormatUnknown = 0,
+		FormatR16G16B16A16Float = 10,
+		FormatR8G8B8A8Unorm = 28,
+		FormatBC1Unorm = 71,
+		FormatBC2Unorm = 74,
+		FormatBC3Unorm = 77,
+		FormatBC4Unorm = 80,
+		FormatBC5Unorm = 83,
+		FormatB8G8R8A8Unorm = 87,
+		FormatB8G8R8X8Unorm = 88,
+		FormatBC7Unorm = 98,
+	};
+
+	struct PixelFormat
+	{
+		uint32_t	size;
+		uint32_t	flags;
+		uint32_t	fourCC;
+		uint32_t	rgbBitCount;
+		uint32_t	rBitMask;
+		uint32_t	gBitMask;
+		uint32_t	bBitMask;
+		uint32_t	aBitMask;
+	};
+
+	struct Header
+	{
+		uint32_t	size;
+		uint32_t	flags;
+		uint32_t	height;
+		uint32_t	width;
+		uint32_t	pitchOrLinearSize;
+		uint32_t	depth;
+		uint32_t	mipMapCount;
+		uint32_t	reserved1[11];
+		PixelFormat	pixelFormat;
+		uint32_t	caps;
+		uint32_t	caps2;
+		uint32_t	caps3;
+		uint32_t	caps4;
+		uint32_t	reserved2;
+	};
+
+	//Follows Header when pixelFormat.fourCC is "DX10"
+	struct HeaderDXT10
+	{
+		uint32_t	dxgiFormat;
+		uint32_t	resourceDimension;
+		uint32_t	miscFlag;
+		uint32_t	arraySize;
+		uint32_t	miscFlags2;
+	};
+
+	//What a texture is, read from its headers without touching the pixel data
+	struct TextureInfo
+	{
+		uint32_t	width;
+		uint32_t	height;
+		uint32_t	depth;
+		uint32_t	mipCount;
+		uint32_t	arraySize;		//faces included for cube maps
+		uint32_t	format;			//DXGI_FORMAT, legacy pixel formats mapped to their DXGI equivalent
+		bool		cube;
+		size_t		dataOffset;		//bytes from the start of the file to the first level
+	};
+
+	//Bytes per pixel, 0 for block compressed or unknown formats
+	uint32_t GetBytesPerPixel(uint32_t format);
+
+	//Bytes per 4x4 block, 0 for formats that aren't block compressed
+	uint32_t GetBytesPerBlock(uint32_t format);
+
+	//Bytes in one level of one slice, 0 for formats this file doesn't know
+	size_t GetSurfaceSize(uint32_t format, uint32_t width, uint32_t height);
+
+	//Bytes in every level, slice and face
+	size_t GetTextureSize(const TextureInfo& info);
+
+	//D3D11 resource limits, headers beyond them are rejected
+	constexpr uint32_t c_MaxDimension = 16384;
+	constexpr uint32_t c_MaxVolumeDimension = 2048;
+	constexpr uint32_t c_MaxArraySize = 2048;
+
+	//Parses the headers at the start of a file. False if they aren't a texture this code can size or one D3D11
+	//couldn't create: too large, more levels than the size allows, non square cube maps or volume arrays.
+	bool ReadInfo(const void* data, size_t size, TextureInfo& info);
+
+	//Writes a 2D texture or texture array in any format GetSurfaceSize knows. data holds mipCount levels, tightly
+	//packed and largest first, for each of the arraySize items in turn.
+	bool Write(const std::string& path, uint32_t width, uint32_t height, uint32_t mipCount, uint32_t format, const void* data, size_t size,
+		uint32_t arraySize = 1);
+}
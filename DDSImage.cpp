@@ -0,0 +1,82 @@
+// Validation and the surface table of a mapped DDS file
+#include "DDSImage.h"
+
+#include <algorithm>
+
+DDSImage::DDSImage() :
+	m_data(nullptr),
+	m_size(0),
+	m_info()
+{
+}
+
+bool DDSImage::Open(const std::string & path)
+{
+	Close();
+	if (!m_file.Open(path) || !Parse(m_file.GetData(), m_file.GetSize()))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool DDSImage::Parse(const void * data, size_t size)
+{
+	m_surfaces.clear();
+	m_data = nullptr;
+	m_size = 0;
+	if (!data || !DDS::ReadInfo(data, size, m_info))
+	{
+		return false;
+	}
+
+	// ReadInfo keeps every dimension within the D3D11 limits, so 64 bit sums can't wrap
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t offset = m_info.dataOffset;
+	m_surfaces.reserve(size_t(m_info.mipCount) * m_info.arraySize);
+	for (uint32_t item = 0; item < m_info.arraySize; ++item)
+	{
+		for (uint32_t mip = 0; mip < m_info.mipCount; ++mip)
+		{
+			DDSSurface surface;
+			surface.width = std::max(1u, m_info.width >> mip);
+			surface.height = std::max(1u, m_info.height >> mip);
+			surface.depth = std::max(1u, m_info.depth >> mip);
+			surface.rowPitch = static_cast<uint32_t>(DDS::GetSurfaceSize(m_info.format, surface.width, 1));
+			surface.slicePitch = DDS::GetSurfaceSize(m_info.format, surface.width, surface.height);
+			uint64_t surfaceSize = uint64_t(surface.slicePitch) * surface.depth;
+			if (offset + surfaceSize > size)
+			{
+				m_surfaces.clear();
+				return false;
+			}
+			surface.data = bytes + offset;
+			surface.size = static_cast<size_t>(surfaceSize);
+			m_surfaces.push_back(surface);
+			offset += surfaceSize;
+		}
+	}
+
+	m_data = bytes;
+	m_size = size;
+	return true;
+}
+
+void DDSImage::Close()
+{
+	m_surfaces.clear();
+	m_data = nullptr;
+	m_size = 0;
+	m_info = DDS::TextureInfo();
+	m_file.Close();
+}
+
+const DDSSurface * DDSImage::GetSurface(uint32_t mip, uint32_t item) const
+{
+	if (mip >= m_info.mipCount || item >= m_info.arraySize || m_surfaces.empty())
+	{
+		return nullptr;
+	}
+	return &m_surfaces[size_t(item) * m_info.mipCount + mip];
+}
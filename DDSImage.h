@@ -0,0 +1,62 @@
+//
+// DDSImage.h - Zero copy access to the levels of a DDS file
+//
+// The file is memory mapped (or the caller's buffer borrowed) and checked once: headers, D3D11 limits and that every
+// level of every slice lies inside it. After that each surface is a pointer and pitches straight into the mapping,
+// ready to go to CreateTexture2D or UpdateSubresource without passing through a heap copy.
+//
+
+#pragma once
+
+#include "DDSFile.h"
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//One level of one array slice or cube face, all of its depth slices for a volume
+struct DDSSurface
+{
+	const uint8_t*	data;
+	size_t			size;
+	uint32_t		width;
+	uint32_t		height;
+	uint32_t		depth;
+	uint32_t		rowPitch;		//bytes per row of pixels, or of 4x4 blocks when block compressed
+	size_t			slicePitch;		//bytes per depth slice
+};
+
+class DDSImage
+{
+public:
+	DDSImage();
+
+	DDSImage(DDSImage const&) = delete;
+	DDSImage& operator= (DDSImage const&) = delete;
+
+	//Maps and validates a file, false (and closed) if it is missing or not a texture that fits in it
+	bool Open(const std::string& path);
+	//The same over memory the caller keeps alive for as long as the surfaces are used
+	bool Parse(const void* data, size_t size);
+	void Close();
+
+	bool IsValid() const { return m_data != nullptr; }
+	const DDS::TextureInfo& GetInfo() const { return m_info; }
+
+	//The file as it is, for loaders that take a whole DDS from memory
+	const uint8_t* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+	//item is the array slice, times six plus the face for cube maps. Null when out of range.
+	const DDSSurface* GetSurface(uint32_t mip, uint32_t item = 0) const;
+	uint32_t GetSurfaceCount() const { return static_cast<uint32_t>(m_surfaces.size()); }
+
+private:
+	MappedFile					m_file;
+	const uint8_t*				m_data;
+	size_t						m_size;
+	DDS::TextureInfo			m_info;
+	std::vector<DDSSurface>		m_surfaces;		//item major, the order they are stored in
+};
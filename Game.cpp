@@ -18,7 +18,53 @@ namespace
     const XMVECTORF32 START_POSITION = { 15.5f, -1.5f, 15.f, 180.f };
     const XMVECTORF32 ROOM_BOUNDS = { 50.f, 10.f, 42.f, 0.f };
     constexpr float ROTATION_GAIN = 0.003f;
-    constexpr float MOVEMENT_GAIN = 0.04f;
+    constexpr float MOVEMENT_SPEED = 2.4f;      //a second, 0.04 a frame at 60 Hz
+    //the camera is a sphere this size against the static objects, clear of the near plane at any wall
+    constexpr float CAMERA_RADIUS = 0.2f;
+
+    //shadows
+    constexpr UINT SHADOW_RESOLUTION = 1024;
+    constexpr UINT SHADOW_CASCADES = 3;
+    constexpr UINT POINT_SHADOW_RESOLUTION = 512;
+    constexpr float POINT_SHADOW_NEAR = 0.1f;
+    constexpr float POINT_SHADOW_FAR = 40.f;
+
+    //textures
+    constexpr size_t TEXTURE_BUDGET = 32 * 1024 * 1024;
+
+    //tank animation, rig written by Tools/BakeRig, clips baked by Tools/BakeTankClips
+    const char* const TANK_MESH = "tank.sdkmesh";
+    const char* const TANK_RIG = "tank.rig";
+    const char* const TANK_CLIPS = "tank.anim";
+    constexpr float TANK_BLEND_SECONDS = 0.5f;
+
+    //crowd of parked tanks in the outdoor area, posed less often past each LOD distance
+    constexpr size_t CROWD_COLUMNS = 6;
+    constexpr size_t CROWD_ROWS = 4;
+    constexpr float CROWD_SPACING = 2.5f;
+    const XMVECTORF32 CROWD_ORIGIN = { -4.f, -2.85f, 13.f, 0.f };
+    constexpr float CROWD_LOD_DISTANCES[3] = { 10.f, 20.f, 40.f };
+
+    //levels of detail, chains built by Tools/BuildLods. Their errors are the farthest a level strays anywhere from
+    //the full mesh, so a couple of pixels of it is hard to see, and a level has to be a quarter under that to be taken.
+    const char* const TANK_LODS = "tank.lod";
+    const char* const FENCE_LODS = "fence.lod";
+    constexpr float LOD_PIXEL_ERROR = 2.f;
+    constexpr float LOD_HYSTERESIS = 0.25f;
+    //planet spheres, DirectXTK's default tessellation then coarser ones
+    constexpr size_t SPHERE_TESSELLATIONS[] = { 16, 10, 6, 4 };
+
+    //textures, shaders and the tank packed by Tools/PackAssets, loose files are used for anything it doesn't hold
+    const char* const ASSET_ARCHIVE = "assets.pak";
+    //what CreateDeviceDependentResources reads, prefetched together, a shader once per pass using it; the textures
+    //stream in on their own
+    const char* const STARTUP_FILES[] =
+    {
+        "light_vs.cso", "light_ps.cso", "lightmap_vs.cso", "lightmap_ps.cso", "probe_vs.cso", "probe_ps.cso",
+        "light_vs.cso", "material_ps.cso", "lightmap_vs.cso", "lightmap_material_ps.cso", "shadow_vs.cso",
+        "shadow_clear_vs.cso", TANK_MESH, TANK_RIG, "rigid_vs.cso", "light_ps.cso", "rigid_vs.cso", "probe_ps.cso",
+        "rigid_shadow_vs.cso", TANK_LODS, FENCE_LODS
+    };
 }
 
 //constructor
@@ -28,18 +74,27 @@ Game::Game() noexcept(false) :
     m_yaw(0),
     m_cameraPos(START_POSITION),
     m_roomColor(Colors::White),
-    m_leftBackWheelBone(ModelBone::c_Invalid),
-    m_rightBackWheelBone(ModelBone::c_Invalid),
-    m_leftFrontWheelBone(ModelBone::c_Invalid),
-    m_rightFrontWheelBone(ModelBone::c_Invalid),
-    m_leftSteerBone(ModelBone::c_Invalid),
-    m_rightSteerBone(ModelBone::c_Invalid),
-    m_turretBone(ModelBone::c_Invalid),
-    m_cannonBone(ModelBone::c_Invalid),
-    m_hatchBone(ModelBone::c_Invalid)
+    m_tankIdleWeight(0),
+    m_tankIdling(false),
+    m_shadowMode(ShadowMode::Point),
+    m_shadowCaching(true),
+    m_shadowStats{},
+    m_materialsBound(false),
+    m_sceneBounds{},
+    m_planetObjects{},
+    m_tankObject(0),
+    m_tankPickInstances(0),
+    m_hover{},
+    m_picked{}
 {
+    m_hover.object = m_hover.instance = m_hover.triangle = ScenePicker::c_NoHit;
+    m_picked = m_hover;
+
     m_deviceResources = std::make_unique<DX::DeviceResources>();
     m_deviceResources->RegisterDeviceNotify(this);
+
+    m_assets.Open(ASSET_ARCHIVE);
+    m_loader.SetArchive(&m_assets);
 }
 
 Game::~Game()
@@ -75,12 +130,16 @@ void Game::Initialize(HWND window, int width, int height)
     //// m_Light.setPosition(10.0f, -10.0f, -10.0f);
     //m_Light2.setPosition(10.0f, -10.0f, -10.0f);
     //m_Light2.setDirection(-1.0f, -1.0f, 1.0f);
+
+    //additional lights handled by clustered shading
+    SetupSceneLights();
    
    
     //init keyboard and mouse movements
     m_keyboard = std::make_unique<Keyboard>();
     m_mouse = std::make_unique<Mouse>();
     m_mouse->SetWindow(window);
+    m_input.Reset(m_inputSampler.GetTicksPerSecond(), InputSampler::GetTime());
 
     //audio setup
     #ifndef audio
@@ -128,16 +187,28 @@ void Game::Update(DX::StepTimer const& timer)
     //mouse input functionality
     #ifndef mouse inputs
     auto mouse = m_mouse->GetState();
-
-    if (mouse.positionMode == Mouse::MODE_RELATIVE)
+    m_mouseButtons.Update(mouse);
+
+    //the events queued since the last frame, up to now. Events lost to a full queue could be a key let go, so
+    //everything is let go and held keys pick up again on their next repeat.
+    const int64_t frameEnd = InputSampler::GetTime();
+    m_input.BeginFrame(frameEnd);
+    InputEvent inputEvent;
+    while (m_inputSampler.GetQueue().Pop(inputEvent, frameEnd))
     {
-        Vector3 delta = Vector3(float(mouse.x), float(mouse.y), 0.f)
-            * ROTATION_GAIN;
-
-        m_pitch -= delta.y;
-        m_yaw -= delta.x;
+        m_input.Apply(inputEvent);
+    }
+    if (m_inputSampler.GetQueue().TakeDropped())
+    {
+        m_input.ReleaseAll(frameEnd);
     }
 
+    //looking around with the raw motion that came while the left button was down
+    int32_t lookX, lookY;
+    m_input.GetDragDelta(0, lookX, lookY);
+    m_pitch -= float(lookY) * ROTATION_GAIN;
+    m_yaw -= float(lookX) * ROTATION_GAIN;
+
     m_mouse->SetMode(mouse.leftButton
         ? Mouse::MODE_RELATIVE : Mouse::MODE_ABSOLUTE);
     #endif // !mouse inputs
@@ -148,35 +219,54 @@ void Game::Update(DX::StepTimer const& timer)
 
 
         auto kb = m_keyboard->GetState();
+        m_keyTracker.Update(kb);
         if (kb.Escape)
         {
             ExitGame();
         }
+        if (m_keyTracker.pressed.L)
+        {
+            //switch the main light between point (cube shadows) and directional (cascades)
+            m_shadowMode = m_shadowMode == ShadowMode::Point ? ShadowMode::Directional : ShadowMode::Point;
+        }
+        if (m_keyTracker.pressed.C)
+        {
+            //redraw every caster every frame instead of keeping the static ones, for comparing GetShadowStats
+            m_shadowCaching = !m_shadowCaching;
+            m_shadowCache.InvalidateAll();
+        }
+        if (m_keyTracker.pressed.T)
+        {
+            //cross fade the tank between its drive and idle clips
+            m_tankIdling = !m_tankIdling;
+        }
+        if (m_keyTracker.pressed.B)
+        {
+            //write the static meshes for BakeLightmaps, only ever on request
+            LightmapScene scene;
+            ExportLightmapScene(scene);
+            scene.Save("scene.lmscene");
+        }
         if (kb.Home)
         {
             m_cameraPos = START_POSITION.v;
             m_pitch = m_yaw = 0;
         }
 
-        Vector3 move = Vector3::Zero;
-
-        if (kb.Up || kb.W)
-            move.y += 1.f;
-
-        if (kb.Down || kb.S)
-            move.y -= 1.f;
-
-        if (kb.Left || kb.A)
-            move.x += 1.f;
-
-        if (kb.Right || kb.D)
-            move.x -= 1.f;
+        //each direction for as much of the frame as its key was held, a tap moves its length even between frames
+        auto held = [this](uint32_t key, uint32_t other)
+        {
+            return std::max(m_input.GetHeldSeconds(key), m_input.GetHeldSeconds(other));
+        };
 
-        if (kb.PageUp || kb.Space)
-            move.z += 1.f;
+        Vector3 move = Vector3::Zero;
 
-        if (kb.PageDown || kb.X)
-            move.z -= 1.f;
+        move.y += held(VK_UP, 'W');
+        move.y -= held(VK_DOWN, 'S');
+        move.x += held(VK_LEFT, 'A');
+        move.x -= held(VK_RIGHT, 'D');
+        move.z += held(VK_PRIOR, VK_SPACE);
+        move.z -= held(VK_NEXT, 'X');
     #endif // !keyboard inputs
 
     //camera movemments
@@ -185,9 +275,10 @@ void Game::Update(DX::StepTimer const& timer)
 
             move = Vector3::Transform(move, q);
 
-            move *= MOVEMENT_GAIN;
+            move *= MOVEMENT_SPEED;
 
-            m_cameraPos += move;
+            //sweeps the camera through the static objects' boxes, sliding along whatever it runs into
+            m_cameraCollision.Move(&m_cameraPos.x, &move.x, CAMERA_RADIUS);
 
             Vector3 halfBound = (Vector3(ROOM_BOUNDS.v) / Vector3(2.f))- Vector3(0.1f, 0.1f, 0.1f);
 
@@ -218,6 +309,9 @@ void Game::Update(DX::StepTimer const& timer)
 
             m_view = XMMatrixLookAtRH(m_cameraPos, lookAt, Vector3::Up);
 
+            //bin the clustered lights against this frame's view
+            UpdateSceneLights(time);
+            m_lightClusters.Build(&m_view._11, true, m_sceneLights.GetLights().data(), m_sceneLights.GetCount(), &m_threadPool);
             
            // XMMatrixLoo
     #endif // !camera movement
@@ -258,44 +352,59 @@ void Game::Update(DX::StepTimer const& timer)
 
     //animation and bone setup
     #ifndef animation
-                float wheelRotation = time * 5.f;
-                float steerRotation = sinf(time * 0.75f) * 0.5f;
-                float turretRotation = sinf(time * 0.333f) * 1.25f;
-                float cannonRotation = sinf(time * 0.25f) * 0.333f - 0.333f;
-                float hatchRotation = __min(0.f, __max(sinf(time * 2.f) * 2.f, -1.f));
-
-                XMMATRIX mat = XMMatrixRotationX(wheelRotation);
-                m_animBones[m_leftFrontWheelBone] = XMMatrixMultiply(mat,
-                    m_model->boneMatrices[m_leftFrontWheelBone]);
-                m_animBones[m_rightFrontWheelBone] = XMMatrixMultiply(mat,
-                    m_model->boneMatrices[m_rightFrontWheelBone]);
-                m_animBones[m_leftBackWheelBone] = XMMatrixMultiply(mat,
-                    m_model->boneMatrices[m_leftBackWheelBone]);
-                m_animBones[m_rightBackWheelBone] = XMMatrixMultiply(mat,
-                    m_model->boneMatrices[m_rightBackWheelBone]);
-
-                mat = XMMatrixRotationX(steerRotation);
-                m_animBones[m_leftSteerBone] = XMMatrixMultiply(mat,
-                    m_model->boneMatrices[m_leftSteerBone]);
-                m_animBones[m_rightSteerBone] = XMMatrixMultiply(mat,
-                    m_model->boneMatrices[m_rightSteerBone]);
-
-                mat = XMMatrixRotationY(turretRotation);
-                m_animBones[m_turretBone] = XMMatrixMultiply(mat,
-                    m_model->boneMatrices[m_turretBone]);
-
-                mat = XMMatrixRotationX(cannonRotation);
-                m_animBones[m_cannonBone] = XMMatrixMultiply(mat,
-                    m_model->boneMatrices[m_cannonBone]);
-
-                mat = XMMatrixRotationX(hatchRotation);
-                m_animBones[m_hatchBone] = XMMatrixMultiply(mat,
-                    m_model->boneMatrices[m_hatchBone]);
+                //only the clips with weight are sampled, every bone's local transform is its pose before its bind one
+                if (m_tankDrive.GetClip() || m_tankIdle.GetClip())
+                {
+                    float fade = elapsedTime / TANK_BLEND_SECONDS;
+                    m_tankIdleWeight = m_tankIdling ? std::min(m_tankIdleWeight + fade, 1.f) : std::max(m_tankIdleWeight - fade, 0.f);
 
+                    const BonePose* pose = m_tankPoses[0].data();
+                    if (m_tankIdleWeight < 1.f)
+                    {
+                        m_tankDrive.Sample(time, true, m_tankPoses[0].data());
+                    }
+                    if (m_tankIdleWeight > 0.f)
+                    {
+                        m_tankIdle.Sample(time, true, m_tankPoses[1].data());
+                        pose = m_tankPoses[1].data();
+                    }
+                    if (m_tankIdleWeight > 0.f && m_tankIdleWeight < 1.f)
+                    {
+                        BlendPoses(m_tankPoses[0].data(), m_tankPoses[1].data(), m_tankIdleWeight, m_tankPoses[2].size(), m_tankPoses[2].data());
+                        pose = m_tankPoses[2].data();
+                    }
+                    ComposeBoneTransforms(pose, m_tankRig.GetBind(), m_tankRig.GetCount(), reinterpret_cast<float*>(m_animBones.get()));
+                }
 
+                //the crowd is drawn with the tank's palette, so is only posed when there is one
+                if (m_tankPalette.IsReady() && m_tankPalette.GetInstanceCount() > 1)
+                {
+                    m_tankCrowd.Update(elapsedTime, &m_cameraPos.x, &m_threadPool, m_tankPalette.GetInstancePalette(1));
+                }
 
     #endif // !animation
 
+    //move the dynamic objects and fit the shadow cascades around this frame's view
+    UpdateScene(time);
+    SelectLods();
+
+    //the object under the free cursor, kept when it is clicked (the click also starts looking around)
+    if (mouse.positionMode == Mouse::MODE_ABSOLUTE)
+    {
+        auto size = m_deviceResources->GetOutputSize();
+        BvhRay ray;
+        if (!ScenePicker::ScreenRay(float(mouse.x) + 0.5f, float(mouse.y) + 0.5f, float(size.right), float(size.bottom), &m_view._11, &m_proj._11, ray)
+            || !m_picker.Pick(ray, m_hover))
+        {
+            m_hover.object = m_hover.instance = m_hover.triangle = ScenePicker::c_NoHit;
+        }
+        if (m_mouseButtons.leftButton == Mouse::ButtonStateTracker::PRESSED)
+        {
+            m_picked = m_hover;
+        }
+    }
+    Vector3 lightDirection = m_Light.getDirection();
+    m_shadowCascades.Build(&m_view._11, true, m_proj._11, m_proj._22, 0.1f, &lightDirection.x, m_sceneBounds);
           
     elapsedTime;
 }
@@ -311,372 +420,75 @@ void Game::Render()
         return;
     }
 
+    auto context = m_deviceResources->GetD3DDeviceContext();
+
+    //swap in whatever textures and mip levels finished reading since last frame, a couple at a time to keep frames
+    //even, and stream more levels for what the last frame drew up close
+    m_textures.Update(context);
+
+    //the tank's bones for this frame, uploaded once for the shadow passes and the main pass
+    m_tankPalette.Upload(context);
+
+    //shadow maps first, Clear() puts the back buffer and viewport back afterwards
+    RenderShadows(context);
+
     Clear();
 
     //Begin rendering context
     m_deviceResources->PIXBeginEvent(L"Render");
-    auto context = m_deviceResources->GetD3DDeviceContext();
-    auto time = static_cast<float>(m_timer.GetTotalSeconds());
 
   
     //Set Rendering states. 
-    context->OMSetBlendState(m_states->Opaque(), nullptr, 0xFFFFFFFF);
-    context->OMSetDepthStencilState(m_states->DepthDefault(), 0);
-    context->RSSetState(m_states->CullClockwise());
-
-    // Turn our shaders on,  set parameters
-    m_BasicShaderPair.EnableShader(context);
-
-    // RENDERING WORLD HERE
-    
-    //shapes and models
-#ifndef shapes
-
-    //room
-    m_room->Draw(Matrix::Identity, m_view, m_proj, m_roomColor, m_roomTex.Get());
+    context->OMSetBlendState(m_stateCache.Opaque(), nullptr, 0xFFFFFFFF);
+    context->OMSetDepthStencilState(m_stateCache.DepthDefault(), 0);
+    context->RSSetState(m_stateCache.CullClockwise());
 
-    //planet 1
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    SimpleMath::Matrix transform = Matrix::CreateTranslation(0.5f, -0.5f, -1.5f);
-    SimpleMath::Matrix scale = Matrix::CreateScale(2.5f, 2.5f, 2.5f);
-    SimpleMath::Matrix planet1Rotation = SimpleMath::Matrix::CreateRotationY(time);
-    m_effect->SetWorld(m_world);
-    m_world = m_world * planet1Rotation * transform * scale;
     // Turn our shaders on,  set parameters
-   // m_BasicShaderPair.EnableShader(context);
-    m_planet1->Draw(m_world, m_view, m_proj, Colors::BlanchedAlmond, m_planet1Tex.Get());
-
-    //planet 2
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = Matrix::CreateTranslation(0.5f, 1.2f, 3.0f);
-    scale = Matrix::CreateScale(1.5f, 1.5f, 1.5f);
-    SimpleMath::Matrix planet2Rotation = SimpleMath::Matrix::CreateRotationY(-time);
-    SimpleMath::Matrix transform2 = Matrix::CreateTranslation(0.5f, 0.5f, 1.0f);
-    m_effect->SetWorld(m_world);
-    m_world = m_world * transform2 * planet2Rotation * scale *transform;
-    m_planet2->Draw(m_world, m_view, m_proj, Colors::BlanchedAlmond, m_planet2Tex.Get());
-    
-    // planet 3
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = Matrix::CreateTranslation(1.5f, -0.1f, 0.5f);
-    transform2 = Matrix::CreateTranslation(-1.0f, 2.f, -1.0f);
-    SimpleMath::Matrix planet3Rotation = SimpleMath::Matrix::CreateRotationZ(time);
-    SimpleMath::Matrix spin = SimpleMath::Matrix::CreateRotationY(-time);
-    scale = Matrix::CreateScale(1.0f, 1.0f, 1.0f);
-    m_effect->SetWorld(m_world);
-    m_world = m_world * transform2 * scale * planet3Rotation * spin * transform;
-    m_planet3->Draw(m_world, m_view, m_proj, Colors::BlanchedAlmond, m_planet3Tex.Get());
-
-    // planet 4
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = Matrix::CreateTranslation(2.5f, 0.5f, -1.0f);
-    scale = Matrix::CreateScale(1.0f, 1.0f, 1.0f);
-    m_effect->SetWorld(m_world);
-    m_world = m_world * transform * scale;
-    m_planet4->Draw(m_world, m_view, m_proj, Colors::BlanchedAlmond, m_planet4Tex.Get());
-
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = Matrix::CreateTranslation(5.0f, -3.9f, -0.05f);
-    scale = Matrix::CreateScale(3.0f, 1.0f, 3.0f);
-    m_effect->SetWorld(m_world);
-    m_world = m_world * transform * scale;
-    m_stand->Draw(m_world, m_view, m_proj, Colors::BlanchedAlmond, marbleTex.Get());
-#endif // !shapes
-
-
-#ifndef drawing indoor room1
-
-    //DONE
-    //prepare transform for floor object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(15.0f, -4.9f, 0.0f);
-    m_world = m_world * transform;
-    //setup and draw floor
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, woodTex.Get());
-    floor.Render(context);
-
-    //DONE
-   //prepare transform for floor object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(15.0f, 4.8f, 0.0f);
-    m_world = m_world * transform;
-    //setup and draw floor
     m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, woodTex.Get());
-    roof1.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(15.0f, 0.0f, -7.5f);
-    m_world = m_world * transform;
-    //wall 1 - RIGHT WALL
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex.Get());
-    wall1.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(5.0f, 2.45f, 0.0f);
-    m_world = m_world * transform;
-    //wall 2 - back wall 
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex.Get());
-    wall2Top.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(5.0f, -2.45f, 5.0f);
-    m_world = m_world * transform;
-    //wall 2 - back wall 
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex.Get());
-    wall2Right.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(5.0f, -2.55f, -5.0f);
-    m_world = m_world * transform;
-    //wall 2 - back wall 
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex.Get());
-    wall2Left.Render(context);
-
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(15.0f, 2.5f, 7.5f);
-    m_world = m_world * transform;
-    //wall 3 - LEFT WALL top
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex.Get());
-    wall3Top.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(22.0f, -2.5f, 7.5f);
-    m_world = m_world * transform;
-    //wall 3 - LEFT WALL side
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex.Get());
-    wall3Right.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(9.0f, -2.5f, 7.5f);
-    m_world = m_world * transform;
-    //wall 3 - LEFT WALL side
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex.Get());
-    wall3Left.Render(context);
-
-      //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(24.8f, 0.0f, 0.0f);
-    m_world = m_world * transform;
-    //wall 2 - back wall 
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex.Get());
-    wall4.Render(context);
-
-#endif // !drawing indoor room1
-
-#ifndef render indoor room 2
-
-    //DONE
-    //prepare transform for floor object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(-5.0f, -4.9f, 0.0f);
-    m_world = m_world * transform;
-    //setup and draw floor
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, floorTex2.Get());
-    floorRoom2.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(-5.0f, 0.0f, -7.5f);
-    m_world = m_world * transform;
-    //ROOM 2 wall 1 - RIGHT WALL
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex2.Get());
-    room2Wall1.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(4.9f, 2.5f, 0.f);
-    m_world = m_world * transform;
-    //wall 3 - LEFT WALL top
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex2.Get());
-    room2Wall2.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(4.9f, -2.5f, -5.f);
-    m_world = m_world * transform;
-    //wall 3 - LEFT WALL side
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex2.Get());
-    room2Wall2Right.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(4.9f, -2.5f, 5.0f); 
-    m_world = m_world * transform;
-    //wall 3 - LEFT WALL side
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex2.Get());
-    room2Wall2Left.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(-5.0f, 0.0f, 7.5f);
-    m_world = m_world * transform;
-    //ROOM 2 wall 3 - RIGHT WALL
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex2.Get());
-    room2Wall3.Render(context);
-
-    //DONE
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(-15.0f, 0.0f, 0.0f);
-    m_world = m_world * transform;
-    //room 2 wall 4 - back wall 
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex2.Get());
-    room2Wall4.Render(context);
-
-    //DONE
-    //prepare transform for ceilintg object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(0.0f, 4.9f, 0.0f);
-    m_world = m_world * transform;
-    //setup and draw ceiling
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, wallTex2.Get());
-    room2Ceiling.Render(context);
-
-#endif //!render indoor room 2
-
-#ifndef rendering outdoor area
-    //prepare transform for ground  object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(-7.0f, -4.9f, 15.0f);
-    m_world = m_world * transform;
-    //setup and draw floor
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, grassTex.Get());
-    outsideGround.Render(context);
-
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(15.0f, 2.5f, 7.6f);
-    m_world = m_world * transform;
-    //outside wall
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, exteriorTex.Get());
-    outsideWallTop.Render(context);
-
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(22.0f, -2.5f, 7.6f);
-    m_world = m_world * transform;
-    //outside wall
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, exteriorTex.Get());
-    outsideWallRight.Render(context);
-
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(9.0f, -2.5f, 7.6f);
-    m_world = m_world * transform;
-    //outside wall
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, exteriorTex.Get());
-    outsideWallLeft.Render(context);
-
-    //prepare transform for wall object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(-5.0f,-0.0f, 7.6f);
-    m_world = m_world * transform;
-    //outside wall
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, exteriorTex.Get());
-    outsideWallExtension.Render(context);
-
-
-
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    transform = SimpleMath::Matrix::CreateTranslation(15.2f, -4.8f, 15.0f);
-    m_world = m_world * transform;
-    //path
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, cobbleTex.Get());
-    cobble.Render(context);
 
+    // Upload the clustered lights that moved and this frame's cluster lists, they stay bound for every draw using light_ps
+    auto size = m_deviceResources->GetOutputSize();
+    m_clusteredLighting.Update(context, m_lightClusters, m_sceneLights, float(size.right), float(size.bottom));
+    m_clusteredLighting.Bind(context);
 
-#endif // !rendering outdoor area
+    // Shadow maps for the main light, t4 / t5
+    Vector3 lightDirection = m_Light.getDirection();
+    Vector3 lightPosition = m_Light.getPosition();
+    m_shadowMap.Update(context, m_shadowMode, m_shadowCascades, &lightDirection.x, &lightPosition.x, POINT_SHADOW_NEAR, POINT_SHADOW_FAR);
+    m_shadowMap.Bind(context);
 
-#ifndef rendering fences
-    //fence
-  
+    // Baked lighting for the static objects, t6
+    if (m_lightmapTexture)
+    {
+        context->PSSetShaderResources(6, 1, m_lightmapTexture.GetAddressOf());
+    }
 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    scale = Matrix::CreateScale(5.0f, 5.0f, 5.0f);
-    SimpleMath::Matrix rotation = Matrix::CreateRotationY(300);
-    transform = Matrix::CreateTranslation(11.f, -4.9f, 11.f);
-    m_world = m_world * scale * rotation * transform;
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, fence.Get());
-    fenceRight.Render(context);
-
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    scale = Matrix::CreateScale(5.0f, 5.0f, 5.0f);
-    rotation = Matrix::CreateRotationY(300);
-    transform = Matrix::CreateTranslation(10.9f, -4.9f, 16.0f);
-    m_world = m_world * scale * rotation * transform;
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, fence.Get());
-    fenceRight1.Render(context);
-
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    scale = Matrix::CreateScale(5.0f, 5.0f, 5.0f);
-    rotation = Matrix::CreateRotationY(300);
-    transform = Matrix::CreateTranslation(10.8f, -4.9f, 21.f);
-    m_world = m_world * scale * rotation * transform;
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_proj, &m_Light, fence.Get());
-    fenceRight2.Render(context);
+    // Packed materials for the ModelClass objects, t7. Until the array arrives they draw with their own textures.
+    m_materialsBound = m_materials.Bind(context, m_textures);
 
-#endif
+    // RENDERING WORLD HERE
+    
+    //sky room, always around the camera
+    m_textures.Use(m_roomTex, 1.f, 0.f);
+    m_room->Draw(Matrix::Identity, m_view, m_proj, m_roomColor, m_textures.Get(m_roomTex));
 
-#ifndef models
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    scale = Matrix::CreateScale(0.5f, 0.5f, 0.5f);
-    transform = Matrix::CreateTranslation(30.5f, -5.7f, 0.5f);
-    m_effect->SetWorld(m_world);
-    m_world = m_world * transform * scale ;
-    size_t nbones = m_model->bones.size();
+    //rooms, outdoor area, planets and the tank
+    for (size_t i = 0; i < m_sceneObjects.size(); ++i)
+    {
+        const SceneObject& object = m_sceneObjects[i];
 
-    m_model->CopyAbsoluteBoneTransforms(nbones,m_animBones.get(), m_drawBones.get());
+        //how much of its texture each object can show from here, ModelClass shaders tile the texture twice. The
+        //material array is loaded whole, so objects drawn from it leave their own texture at its mip tail.
+        if (!m_materialsBound || object.material < 0)
+        {
+            Vector3 boundsMin(m_objectBounds[i].min), boundsMax(m_objectBounds[i].max);
+            float radius = Vector3::Distance(boundsMin, boundsMax) * 0.5f;
+            float distance = Vector3::Distance((boundsMin + boundsMax) * 0.5f, m_cameraPos) - radius;
+            m_textures.Use(object.texture, radius, distance, object.model ? 2.f : 1.f);
+        }
 
-    m_model->Draw(context, *m_states, nbones, m_drawBones.get(), m_world, m_view, m_proj);
-#endif // !models
+        DrawSceneObject(context, object);
+    }
 
 #ifndef lighting
     auto ilights = dynamic_cast<IEffectLights*>(effect.get());
@@ -785,8 +597,29 @@ void Game::CreateDeviceDependentResources()
 
     auto context = m_deviceResources->GetD3DDeviceContext();
 
+    //every loose file the startup below reads, submitted at once so they come in while the device objects are made
+    m_loader.Prefetch(std::vector<std::string>(std::begin(STARTUP_FILES), std::end(STARTUP_FILES)));
+
     //setup shader
-    m_BasicShaderPair.InitStandard(device, L"light_vs.cso", L"light_ps.cso");
+    m_stateCache.SetDevice(device);
+    m_BasicShaderPair.InitStandard(device, &m_inputLayouts, &m_stateCache, ModelClass::GetVertexFormat(), L"light_vs.cso", L"light_ps.cso", &m_loader);
+    m_lightmapShader.InitStandard(device, &m_inputLayouts, &m_stateCache, ModelClass::GetLightmappedVertexFormat(), L"lightmap_vs.cso", L"lightmap_ps.cso", &m_loader);
+    m_probeShader.InitStandard(device, &m_inputLayouts, &m_stateCache, ModelClass::GetVertexFormat(), L"probe_vs.cso", L"probe_ps.cso", &m_loader);
+    m_probeLighting.Init(device);
+    m_materialShader.InitStandard(device, &m_inputLayouts, &m_stateCache, ModelClass::GetVertexFormat(), L"light_vs.cso", L"material_ps.cso", &m_loader);
+    m_lightmapMaterialShader.InitStandard(device, &m_inputLayouts, &m_stateCache, ModelClass::GetLightmappedVertexFormat(), L"lightmap_vs.cso", L"lightmap_material_ps.cso", &m_loader);
+    m_materials.Init(device);
+    m_clusteredLighting.Init(device);
+
+    //depth only shader and targets for the main light's shadows
+    ShadowCascadeDesc cascadeDesc;
+    cascadeDesc.count = SHADOW_CASCADES;
+    cascadeDesc.resolution = SHADOW_RESOLUTION;
+    m_shadowCascades.SetDesc(cascadeDesc);
+    m_shadowShader.InitDepthOnly(device, &m_inputLayouts, ModelClass::GetVertexFormat(), L"shadow_vs.cso", &m_loader);
+    m_shadowMap.Init(device, &m_stateCache, SHADOW_RESOLUTION, SHADOW_CASCADES, POINT_SHADOW_RESOLUTION, &m_loader);
+    //views 0 .. cascades - 1 are the cascades, the six cube faces follow
+    m_shadowCache.Resize(m_shadowMap.GetCascadeCount() + 6);
 
     //effects
     #ifndef setup effects
@@ -806,6 +639,17 @@ void Game::CreateDeviceDependentResources()
         m_planet2 = GeometricPrimitive::CreateSphere(context);
         m_planet3 = GeometricPrimitive::CreateSphere(context);
         m_planet4 = GeometricPrimitive::CreateSphere(context);
+        //coarser planets, a level's error is how far the middle of its largest face sits inside the full sphere
+        m_sphereLodErrors.assign(1, 0.f);
+        for (size_t tessellation : SPHERE_TESSELLATIONS)
+        {
+            if (tessellation != SPHERE_TESSELLATIONS[0])
+            {
+                float sag = sinf(XM_PI / (2.f * float(tessellation)));
+                m_sphereLods.push_back(GeometricPrimitive::CreateSphere(context, 1.f, tessellation));
+                m_sphereLodErrors.push_back(0.5f * sag * sag);
+            }
+        }
         m_stand = GeometricPrimitive::CreateCube(context, 2);
         floor.InitializeBox(device, 20.0f, 0.1f, 15.0f);	//box includes dimensions
         roof1.InitializeBox(device, 20.0f, 0.1f, 15.0f);	//box includes dimensions
@@ -848,32 +692,50 @@ void Game::CreateDeviceDependentResources()
         fenceRight1.InitializeModel(device, "fence.obj");
         fenceRight2.InitializeModel(device, "fence.obj");
 
+        //every fence draws the same chain, a file that doesn't match the model leaves them at full detail
+        std::vector<LodChain> fenceLods;
+        std::vector<uint8_t> fenceLodData;
+        if (m_loader.Read(FENCE_LODS, fenceLodData) && LodChain::Deserialize(fenceLodData.data(), fenceLodData.size(), fenceLods))
+        {
+            if (const LodChain* chain = LodChain::Find(fenceLods, "fence", 0))
+            {
+                for (ModelClass* model : { &fenceLeft, &fenceLeft1, &fenceLeft2, &fenceRight, &fenceRight1, &fenceRight2 })
+                {
+                    model->SetLods(device, *chain);
+                }
+            }
+        }
+
     #endif // !initialise and create all models and shapes
 
   
-    //load in textures from file
+    //queue the textures, read on the streamer's I/O threads and created a couple per frame in Render. Handles come
+    //back straight away and draw as a grey placeholder until then. The camera starts outside, so that goes first.
     #ifndef textures
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"sky.dds", nullptr, m_roomTex.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"planet1.dds", nullptr, m_planet1Tex.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"planet2.dds", nullptr, m_planet2Tex.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"planet3.dds", nullptr, m_planet3Tex.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"planet4.dds", nullptr, m_planet4Tex.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"wallpaper.dds", nullptr, wallTex.ReleaseAndGetAddressOf()));    DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"wood.dds", nullptr, woodTex.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"t.dds", nullptr, marbleTex.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"GRASS.dds", nullptr, grassTex.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"stone.dds", nullptr, exteriorTex.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"cobble.dds", nullptr, cobbleTex.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"white.dds", nullptr, fence.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"space.dds", nullptr, wallTex2.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"tile.dds", nullptr, floorTex2.ReleaseAndGetAddressOf()));
-        DX::ThrowIfFailed(CreateDDSTextureFromFile(device, L"tree.dds", nullptr, treeTrunkTex.ReleaseAndGetAddressOf()));
+        m_textures.Init(device);
+        m_textures.SetArchive(&m_assets);
+        m_textures.SetBudget(TEXTURE_BUDGET);
+        grassTex = m_textures.Load("GRASS.dds", 2);
+        exteriorTex = m_textures.Load("stone.dds", 2);
+        cobbleTex = m_textures.Load("cobble.dds", 2);
+        fence = m_textures.Load("white.dds", 2);
+        m_roomTex = m_textures.Load("sky.dds", 1);
+        m_planet1Tex = m_textures.Load("planet1.dds");
+        m_planet2Tex = m_textures.Load("planet2.dds");
+        m_planet3Tex = m_textures.Load("planet3.dds");
+        m_planet4Tex = m_textures.Load("planet4.dds");
+        wallTex = m_textures.Load("wallpaper.dds");
+        woodTex = m_textures.Load("wood.dds");
+        marbleTex = m_textures.Load("t.dds");
+        wallTex2 = m_textures.Load("space.dds");
+        floorTex2 = m_textures.Load("tile.dds");
+        treeTrunkTex = m_textures.Load("tree.dds", -1);
+        //built by Tools/PackMaterials, without it every object keeps its own texture
+        m_materials.Load(m_textures, "materials.mat", 1);
     #endif // !textures
 
    
     #ifndef additional effects applications
-            //setting effects on texture
-            m_effect->SetTexture(m_planet1Tex.Get());
-
             m_states = std::make_unique<CommonStates>(device);
 
             m_fxFactory = std::make_unique<EffectFactory>(device);
@@ -883,35 +745,120 @@ void Game::CreateDeviceDependentResources()
     //loading in tank mesh, setting up bones for animation
     #ifndef animation model and bones
 
-                m_model = Model::CreateFromSDKMESH(device, L"tank.sdkmesh", *m_fxFactory, ModelLoader_CounterClockwise | ModelLoader_IncludeBones);
+                //the file (prefetched, or taken from the archive) is checked once, DirectXTK builds its buffers from it
+                //without reading it into another copy
+                std::vector<uint8_t> tankData;
+                SdkMeshFile tankFile;
+                if (!m_loader.Read(TANK_MESH, tankData) || !tankFile.Parse(tankData.data(), tankData.size()))
+                {
+                    throw std::exception(TANK_MESH);
+                }
+                m_model = Model::CreateFromSDKMESH(device, tankFile.GetData(), tankFile.GetSize(), *m_fxFactory, ModelLoader_CounterClockwise | ModelLoader_IncludeBones);
                 const size_t nbones = m_model->bones.size();
 
+                //the triangles of each of its meshes for picking, DirectXTK makes one ModelMesh of each in file order.
+                //A mesh without any gets an empty picker mesh that is never hit.
+                m_tankPickMeshes.clear();
+                for (uint32_t mesh = 0; mesh < m_model->meshes.size(); ++mesh)
+                {
+                    std::vector<float> positions;
+                    std::vector<uint32_t> indices;
+                    tankFile.GetTriangles(mesh, positions, indices);
+                    m_tankPickMeshes.push_back(m_picker.AddMesh(positions.data(), positions.size() / 3, indices.data(), indices.size() / 3));
+                }
+
                 m_drawBones = ModelBone::MakeArray(nbones);
                 m_animBones = ModelBone::MakeArray(nbones);
 
                 m_model->CopyBoneTransformsTo(nbones, m_animBones.get());
-                uint32_t index = 0;
-                for (const auto& it : m_model->bones)
+
+                //the rig and clips are CPU data and survive a device restore, they are only read the first time. A rig
+                //file that doesn't match the model is replaced by the model's own frames.
+                if (m_tankRig.GetCount() != nbones)
                 {
-                    if (_wcsicmp(it.name.c_str(), L"tank_geo") == 0)
+                    std::vector<uint8_t> rigData;
+                    bool loaded = m_loader.Read(TANK_RIG, rigData) && m_tankRig.Deserialize(rigData.data(), rigData.size());
+                    if (!loaded || m_tankRig.GetCount() != nbones)
                     {
-                        // Need to recenter the model.
-                      //  m_animBones[index] = XMMatrixIdentity();
+                        tankFile.GetRig(m_tankRig);
                     }
-                    else if (_wcsicmp(it.name.c_str(), L"l_back_wheel_geo") == 0) { m_leftBackWheelBone = index; }
-                    else if (_wcsicmp(it.name.c_str(), L"r_back_wheel_geo") == 0) { m_rightBackWheelBone = index; }
-                    else if (_wcsicmp(it.name.c_str(), L"l_front_wheel_geo") == 0) { m_leftFrontWheelBone = index; }
-                    else if (_wcsicmp(it.name.c_str(), L"r_front_wheel_geo") == 0) { m_rightFrontWheelBone = index; }
-                    else if (_wcsicmp(it.name.c_str(), L"l_steer_geo") == 0) { m_leftSteerBone = index; }
-                    else if (_wcsicmp(it.name.c_str(), L"r_steer_geo") == 0) { m_rightSteerBone = index; }
-                    else if (_wcsicmp(it.name.c_str(), L"turret_geo") == 0) { m_turretBone = index; }
-                    else if (_wcsicmp(it.name.c_str(), L"canon_geo") == 0) { m_cannonBone = index; }
-                    else if (_wcsicmp(it.name.c_str(), L"hatch_geo") == 0) { m_hatchBone = index; }
-                    ++index;
+                }
+                if (m_tankClips.empty())
+                {
+                    AnimationClip::Load(TANK_CLIPS, m_tankClips);
+                }
+
+                //the tank's clips bound through the rig's name table, a missing clip leaves its bones in the bind pose
+                const AnimationClip* driveClip = nullptr;
+                const AnimationClip* idleClip = nullptr;
+                for (const AnimationClip& clip : m_tankClips)
+                {
+                    if (clip.GetName() == "drive") { driveClip = &clip; }
+                    else if (clip.GetName() == "idle") { idleClip = &clip; }
+                }
+                m_tankDrive.Bind(driveClip, m_tankRig);
+                m_tankIdle.Bind(idleClip, m_tankRig);
+                for (auto& poses : m_tankPoses)
+                {
+                    poses.assign(nbones, BonePose::Identity());
+                }
+
+                //the crowd, each tank with its own heading, clip time and speed, every other one half idling
+                if (m_tankCrowd.Init(&m_tankClips, m_tankRig))
+                {
+                    m_tankCrowd.SetLodDistances(CROWD_LOD_DISTANCES[0], CROWD_LOD_DISTANCES[1], CROWD_LOD_DISTANCES[2]);
+                    uint32_t driveIndex = driveClip ? static_cast<uint32_t>(driveClip - m_tankClips.data()) : CrowdInstance::c_NoClip;
+                    uint32_t idleIndex = idleClip ? static_cast<uint32_t>(idleClip - m_tankClips.data()) : CrowdInstance::c_NoClip;
+                    for (size_t i = 0; i < CROWD_COLUMNS * CROWD_ROWS; ++i)
+                    {
+                        Vector3 position = Vector3(CROWD_ORIGIN) + Vector3(float(i % CROWD_COLUMNS), 0.f, float(i / CROWD_COLUMNS)) * CROWD_SPACING;
+                        Matrix world = Matrix::CreateScale(0.5f) * Matrix::CreateRotationY(float(i) * 1.3f) * Matrix::CreateTranslation(position);
+
+                        CrowdInstance instance = {};
+                        memcpy(instance.world, &world._11, sizeof(instance.world));
+                        instance.clip = driveIndex != CrowdInstance::c_NoClip ? driveIndex : idleIndex;
+                        instance.blendClip = i % 2 ? idleIndex : CrowdInstance::c_NoClip;
+                        instance.blend = 0.5f;
+                        instance.speed = 0.6f + float(i % 5) * 0.2f;
+                        instance.time = float(i) * 3.7f;
+                        m_tankCrowd.AddInstance(instance);
+                    }
+                }
+
+                //bone palette path for the tank, its shaders take the parts' vertex format
+                if (m_tankPalette.Init(device, context, *m_model, 1 + static_cast<UINT>(m_tankCrowd.GetInstanceCount())))
+                {
+                    const VertexFormat& rigidFormat = m_tankPalette.GetVertexFormat();
+                    if (!m_rigidShader.InitStandard(device, &m_inputLayouts, &m_stateCache, rigidFormat, L"rigid_vs.cso", L"light_ps.cso", &m_loader)
+                        || !m_rigidProbeShader.InitStandard(device, &m_inputLayouts, &m_stateCache, rigidFormat, L"rigid_vs.cso", L"probe_ps.cso", &m_loader)
+                        || !m_rigidShadowShader.InitDepthOnly(device, &m_inputLayouts, rigidFormat, L"rigid_shadow_vs.cso", &m_loader))
+                    {
+                        m_tankPalette.Reset();
+                    }
+                }
+
+                //coarser parts for the tank and the crowd, read the first time only
+                if (m_tankPalette.IsReady())
+                {
+                    if (m_tankLods.empty())
+                    {
+                        std::vector<uint8_t> lodData;
+                        if (m_loader.Read(TANK_LODS, lodData))
+                        {
+                            LodChain::Deserialize(lodData.data(), lodData.size(), m_tankLods);
+                        }
+                    }
+                    m_tankPalette.SetLods(device, m_tankLods);
                 }
 
     #endif // !animation model and bones
 
+    //object list used by the main and shadow passes, points at the shapes, models and textures created above
+    BuildScene();
+
+    //anything prefetched and not read (the rig and LODs are only read the first time) is let go
+    m_loader.ClearPrefetches();
+
     m_world = Matrix::Identity;
     device;
 }
@@ -924,6 +871,18 @@ void Game::CreateWindowSizeDependentResources()
     m_view = Matrix::CreateLookAt(Vector3(2.f, 2.f, 2.f), Vector3::Zero, Vector3::UnitY);
     m_proj = Matrix::CreatePerspectiveFieldOfView( XMConvertToRadians(70.f), float(size.right) / float(size.bottom), 0.01f, 100.f);
 
+    //light clusters cover the same frustum as the projection
+    ClusterGridDesc grid;
+    grid.nearZ = 0.1f;
+    grid.farZ = 100.f;
+    m_lightClusters.SetGrid(grid, m_proj._11, m_proj._22);
+
+    //texture streaming picks mip levels from how large objects are on screen
+    m_textures.SetProjection(m_proj._22, float(size.bottom));
+    //and levels of detail from how large their error is on screen
+    m_lodSelector.SetProjection(m_proj._22, float(size.bottom));
+    m_lodSelector.SetTolerance(LOD_PIXEL_ERROR, LOD_HYSTERESIS);
+
     m_effect->SetView(m_view);
     m_effect->SetProjection(m_proj);
 }
@@ -932,33 +891,825 @@ void Game::OnDeviceLost()
 {
     // TODO: Add Direct3D resource cleanup here.
     m_room.reset();
-    m_roomTex.Reset();
     m_planet1.reset();
     m_planet2.reset();
     m_planet3.reset();
     m_planet4.reset();
-    m_planet1Tex.Reset();
-    m_planet2Tex.Reset();
-    m_planet3Tex.Reset();
-    m_planet4Tex.Reset();
-    wallTex.Reset();
-    wallTex2.Reset();
+    m_sphereLods.clear();
+    m_textures.Reset();
      m_texture2.Reset();
-     woodTex.Reset();
-     grassTex.Reset();
-     marbleTex.Reset();
-    exteriorTex.Reset();
-     cobbleTex.Reset();
-     fence.Reset();
      treeTopTex.Reset();
-    floorTex2.Reset();
     m_effect.reset();
     m_inputLayout.Reset();
+    m_inputLayouts.Reset();
+    m_stateCache.Reset();
+    m_clusteredLighting.Reset();
+    m_shadowMap.Reset();
+    m_lightmapTexture.Reset();
+    m_probeLighting.Reset();
+    m_materials.Reset();
+    m_tankPalette.Reset();
+    m_tankCrowd.Reset();
+    m_picker.Clear();
+    m_tankPickMeshes.clear();
+    m_hover.object = m_hover.instance = m_hover.triangle = ScenePicker::c_NoHit;
+    m_sceneObjects.clear();
+    m_objectBounds.clear();
     m_states.reset();
     m_fxFactory.reset();
     m_model.reset();
 }
 
+// Lights shaded through the clusters, on top of the main scene light
+void Game::SetupSceneLights()
+{
+    auto pointLight = [](float x, float y, float z, float radius, float r, float g, float b, float intensity)
+    {
+        ClusterLight light = {};
+        light.position[0] = x; light.position[1] = y; light.position[2] = z;
+        light.radius = radius;
+        light.colour[0] = r; light.colour[1] = g; light.colour[2] = b;
+        light.intensity = intensity;
+        light.type = ClusterLightType::Point;
+        return light;
+    };
+
+    m_sceneLights.Clear();
+
+    //room 1 and room 2 ceiling lamps
+    m_sceneLights.Add(pointLight(20.0f, 3.5f, 0.0f, 10.0f, 1.0f, 0.6f, 0.3f, 6.0f));
+    m_sceneLights.Add(pointLight(10.0f, 3.5f, 0.0f, 10.0f, 1.0f, 0.6f, 0.3f, 6.0f));
+    m_sceneLights.Add(pointLight(-5.0f, 3.5f, 0.0f, 12.0f, 0.3f, 0.5f, 1.0f, 6.0f));
+
+    //two lights orbiting the planets, moved in UpdateSceneLights
+    m_sceneLights.Add(pointLight(0.0f, 1.0f, 0.0f, 4.0f, 1.0f, 0.2f, 0.2f, 4.0f));
+    m_sceneLights.Add(pointLight(0.0f, 1.0f, 0.0f, 4.0f, 0.2f, 1.0f, 0.3f, 4.0f));
+
+    //lamps along the outdoor path
+    for (int i = 0; i < 6; ++i)
+    {
+        m_sceneLights.Add(pointLight(-20.0f + i * 8.0f, -3.0f, 13.0f, 6.0f, 1.0f, 0.9f, 0.6f, 3.0f));
+    }
+
+    //spot light over the tank
+    ClusterLight spot = pointLight(15.0f, 2.0f, 0.5f, 12.0f, 1.0f, 1.0f, 0.9f, 8.0f);
+    spot.type = ClusterLightType::Spot;
+    spot.direction[0] = 0.0f; spot.direction[1] = -1.0f; spot.direction[2] = 0.0f;
+    spot.cosOuter = cosf(XMConvertToRadians(35.f));
+    spot.cosInner = cosf(XMConvertToRadians(25.f));
+    m_sceneLights.Add(spot);
+}
+
+void Game::UpdateSceneLights(float time)
+{
+    //planet lights circle the planet stand in opposite directions, the rest stay put and are never re-uploaded
+    ClusterLight red = m_sceneLights.Get(3);
+    red.position[0] = 1.0f + cosf(time) * 3.0f;
+    red.position[2] = sinf(time) * 3.0f;
+    m_sceneLights.Set(3, red);
+
+    ClusterLight green = m_sceneLights.Get(4);
+    green.position[0] = 1.0f + cosf(-time * 0.7f) * 3.5f;
+    green.position[2] = sinf(-time * 0.7f) * 3.5f;
+    m_sceneLights.Set(4, green);
+}
+
+// Scene objects, in the order the main pass draws them
+void Game::BuildScene()
+{
+    m_sceneObjects.clear();
+
+    auto addModel = [this](ModelClass& model, const Matrix& world, TextureHandle texture)
+    {
+        SceneObject object = {};
+        object.model = &model;
+        object.texture = texture;
+        object.material = m_materials.Find(m_textures.GetStreamer().GetPath(texture));
+        object.world = world;
+        object.isStatic = true;
+        model.GetBounds(object.localMin, object.localMax);
+        object.lodErrors = model.GetLodErrors();
+        object.lodCount = model.GetLodCount();
+        m_sceneObjects.push_back(object);
+    };
+    auto addPrimitive = [this](GeometricPrimitive* primitive, float size, const Matrix& world, TextureHandle texture, bool isStatic)
+    {
+        SceneObject object = {};
+        object.primitive = primitive;
+        object.texture = texture;
+        object.material = -1;
+        object.world = world;
+        object.localMin = Vector3(-size * 0.5f);
+        object.localMax = Vector3(size * 0.5f);
+        object.isStatic = isStatic;
+        object.lodCount = 1;
+        m_sceneObjects.push_back(object);
+        return m_sceneObjects.size() - 1;
+    };
+    auto addPlanet = [this, &addPrimitive](GeometricPrimitive* primitive, const Matrix& world, TextureHandle texture, bool isStatic)
+    {
+        SceneObject& object = m_sceneObjects[addPrimitive(primitive, 1.f, world, texture, isStatic)];
+        object.lodErrors = m_sphereLodErrors.data();
+        object.lodCount = static_cast<uint32_t>(m_sphereLodErrors.size());
+        object.primitiveLods = m_sphereLods.data();
+        return m_sceneObjects.size() - 1;
+    };
+
+    //planets, the first three orbit and get their world matrix in UpdateScene
+    m_planetObjects[0] = addPlanet(m_planet1.get(), Matrix::Identity, m_planet1Tex, false);
+    m_planetObjects[1] = addPlanet(m_planet2.get(), Matrix::Identity, m_planet2Tex, false);
+    m_planetObjects[2] = addPlanet(m_planet3.get(), Matrix::Identity, m_planet3Tex, false);
+    addPlanet(m_planet4.get(), Matrix::CreateTranslation(2.5f, 0.5f, -1.0f), m_planet4Tex, true);
+    addPrimitive(m_stand.get(), 2.f, Matrix::CreateTranslation(5.0f, -3.9f, -0.05f) * Matrix::CreateScale(3.0f, 1.0f, 3.0f), marbleTex, true);
+
+    //indoor room 1
+    addModel(floor, Matrix::CreateTranslation(15.0f, -4.9f, 0.0f), woodTex);
+    addModel(roof1, Matrix::CreateTranslation(15.0f, 4.8f, 0.0f), woodTex);
+    addModel(wall1, Matrix::CreateTranslation(15.0f, 0.0f, -7.5f), wallTex);          //RIGHT WALL
+    addModel(wall2Top, Matrix::CreateTranslation(5.0f, 2.45f, 0.0f), wallTex);        //back wall
+    addModel(wall2Right, Matrix::CreateTranslation(5.0f, -2.45f, 5.0f), wallTex);
+    addModel(wall2Left, Matrix::CreateTranslation(5.0f, -2.55f, -5.0f), wallTex);
+    addModel(wall3Top, Matrix::CreateTranslation(15.0f, 2.5f, 7.5f), wallTex);       //LEFT WALL
+    addModel(wall3Right, Matrix::CreateTranslation(22.0f, -2.5f, 7.5f), wallTex);
+    addModel(wall3Left, Matrix::CreateTranslation(9.0f, -2.5f, 7.5f), wallTex);
+    addModel(wall4, Matrix::CreateTranslation(24.8f, 0.0f, 0.0f), wallTex);
+
+    //indoor room 2
+    addModel(floorRoom2, Matrix::CreateTranslation(-5.0f, -4.9f, 0.0f), floorTex2);
+    addModel(room2Wall1, Matrix::CreateTranslation(-5.0f, 0.0f, -7.5f), wallTex2);
+    addModel(room2Wall2, Matrix::CreateTranslation(4.9f, 2.5f, 0.f), wallTex2);
+    addModel(room2Wall2Right, Matrix::CreateTranslation(4.9f, -2.5f, -5.f), wallTex2);
+    addModel(room2Wall2Left, Matrix::CreateTranslation(4.9f, -2.5f, 5.0f), wallTex2);
+    addModel(room2Wall3, Matrix::CreateTranslation(-5.0f, 0.0f, 7.5f), wallTex2);
+    addModel(room2Wall4, Matrix::CreateTranslation(-15.0f, 0.0f, 0.0f), wallTex2);
+    addModel(room2Ceiling, Matrix::CreateTranslation(0.0f, 4.9f, 0.0f), wallTex2);
+
+    //outdoor area
+    addModel(outsideGround, Matrix::CreateTranslation(-7.0f, -4.9f, 15.0f), grassTex);
+    addModel(outsideWallTop, Matrix::CreateTranslation(15.0f, 2.5f, 7.6f), exteriorTex);
+    addModel(outsideWallRight, Matrix::CreateTranslation(22.0f, -2.5f, 7.6f), exteriorTex);
+    addModel(outsideWallLeft, Matrix::CreateTranslation(9.0f, -2.5f, 7.6f), exteriorTex);
+    addModel(outsideWallExtension, Matrix::CreateTranslation(-5.0f, -0.0f, 7.6f), exteriorTex);
+    addModel(cobble, Matrix::CreateTranslation(15.2f, -4.8f, 15.0f), cobbleTex);   //path
+
+    //fences
+    Matrix fenceScaleRotation = Matrix::CreateScale(5.0f, 5.0f, 5.0f) * Matrix::CreateRotationY(300);
+    addModel(fenceRight, fenceScaleRotation * Matrix::CreateTranslation(11.f, -4.9f, 11.f), fence);
+    addModel(fenceRight1, fenceScaleRotation * Matrix::CreateTranslation(10.9f, -4.9f, 16.0f), fence);
+    addModel(fenceRight2, fenceScaleRotation * Matrix::CreateTranslation(10.8f, -4.9f, 21.f), fence);
+
+    //tank, its bounds follow the animated bones
+    SceneObject tank = {};
+    tank.mesh = m_model.get();
+    tank.texture = c_InvalidTexture;
+    tank.material = -1;
+    tank.world = Matrix::CreateTranslation(30.5f, -5.7f, 0.5f) * Matrix::CreateScale(0.5f, 0.5f, 0.5f);
+    tank.isStatic = false;
+    tank.lodCount = 1;
+    m_sceneObjects.push_back(tank);
+    m_tankObject = m_sceneObjects.size() - 1;
+
+    m_objectBounds.resize(m_sceneObjects.size());
+    for (size_t i = 0; i < m_sceneObjects.size(); ++i)
+    {
+        m_objectBounds[i] = ComputeBounds(m_sceneObjects[i]);
+    }
+    UpdateStaticBounds();
+    AddPickInstances();
+
+    LoadLightmap(m_deviceResources->GetD3DDevice());
+}
+
+void Game::UpdateScene(float time)
+{
+    if (m_sceneObjects.empty())
+    {
+        return;
+    }
+
+    //planet 1
+    SetObjectWorld(m_planetObjects[0], Matrix::CreateRotationY(time)
+        * Matrix::CreateTranslation(0.5f, -0.5f, -1.5f) * Matrix::CreateScale(2.5f, 2.5f, 2.5f));
+
+    //planet 2
+    SetObjectWorld(m_planetObjects[1], Matrix::CreateTranslation(0.5f, 0.5f, 1.0f) * Matrix::CreateRotationY(-time)
+        * Matrix::CreateScale(1.5f, 1.5f, 1.5f) * Matrix::CreateTranslation(0.5f, 1.2f, 3.0f));
+
+    //planet 3
+    SetObjectWorld(m_planetObjects[2], Matrix::CreateTranslation(-1.0f, 2.f, -1.0f) * Matrix::CreateScale(1.0f, 1.0f, 1.0f)
+        * Matrix::CreateRotationZ(time) * Matrix::CreateRotationY(-time) * Matrix::CreateTranslation(1.5f, -0.1f, 0.5f));
+
+    //tank bones for this frame's animation, its bounds follow them. The palette path builds the absolute transforms
+    //with its palette in one pass. One tank is too few to fill a block of BoneHierarchy lanes, so the fallback walks
+    //the bones as the model keeps them.
+    if (m_tankPalette.IsReady())
+    {
+        m_tankPalette.Update(m_animBones.get(), m_sceneObjects[m_tankObject].world, m_drawBones.get());
+    }
+    else
+    {
+        size_t nbones = m_model->bones.size();
+        m_model->CopyAbsoluteBoneTransforms(nbones, m_animBones.get(), m_drawBones.get());
+    }
+    m_objectBounds[m_tankObject] = ComputeBounds(m_sceneObjects[m_tankObject]);
+
+    //the crowd is drawn with the tank, its bounds grow over every parked tank with room for the tank's own extent
+    if (m_tankPalette.IsReady() && m_tankPalette.GetInstanceCount() > 1)
+    {
+        ShadowBounds& bounds = m_objectBounds[m_tankObject];
+        float radius = 0.5f * Vector3(bounds.max[0] - bounds.min[0], bounds.max[1] - bounds.min[1], bounds.max[2] - bounds.min[2]).Length();
+        for (size_t i = 0; i < m_tankCrowd.GetInstanceCount(); ++i)
+        {
+            const float* world = m_tankCrowd.GetInstance(i).world;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                bounds.min[axis] = std::min(bounds.min[axis], world[12 + axis] - radius);
+                bounds.max[axis] = std::max(bounds.max[axis], world[12 + axis] + radius);
+            }
+        }
+    }
+    UpdateTankPicking();
+}
+
+// The level each object and tank instance draws at this frame, from how far its nearest point is. Static objects in
+// the cached shadow texels keep whatever level they were drawn at until those texels are redrawn.
+void Game::SelectLods()
+{
+    for (size_t i = 0; i < m_sceneObjects.size(); ++i)
+    {
+        SceneObject& object = m_sceneObjects[i];
+        if (object.lodCount > 1)
+        {
+            Vector3 boundsMin(m_objectBounds[i].min), boundsMax(m_objectBounds[i].max);
+            float radius = Vector3::Distance(boundsMin, boundsMax) * 0.5f;
+            float distance = Vector3::Distance((boundsMin + boundsMax) * 0.5f, m_cameraPos) - radius;
+            float scale = Vector3(object.world._11, object.world._12, object.world._13).Length();
+            object.lod = m_lodSelector.Select(object.lodErrors, object.lodCount, scale, distance, object.lod);
+        }
+    }
+
+    //the tank's bounds cover the crowd, so each instance is measured from its own origin with room for the tank
+    //around it, in model units
+    if (!m_tankPalette.IsReady() || m_tankPalette.GetLodCount() < 2)
+    {
+        return;
+    }
+    const SceneObject& tank = m_sceneObjects[m_tankObject];
+    ShadowBounds tankBounds = ComputeBounds(tank);
+    Vector3 boundsMin(tankBounds.min), boundsMax(tankBounds.max);
+    float tankScale = Vector3(tank.world._11, tank.world._12, tank.world._13).Length();
+    float modelRadius = (Vector3::Distance((boundsMin + boundsMax) * 0.5f, tank.world.Translation())
+        + Vector3::Distance(boundsMin, boundsMax) * 0.5f) / tankScale;
+
+    for (UINT instance = 0; instance < m_tankPalette.GetInstanceCount(); ++instance)
+    {
+        Matrix world = instance ? Matrix(m_tankCrowd.GetInstance(instance - 1).world) : tank.world;
+        float scale = Vector3(world._11, world._12, world._13).Length();
+        float distance = Vector3::Distance(world.Translation(), m_cameraPos) - modelRadius * scale;
+        UINT lod = m_lodSelector.Select(m_tankPalette.GetLodErrors(), m_tankPalette.GetLodCount(), scale, distance, m_tankPalette.GetInstanceLod(instance));
+        m_tankPalette.SetInstanceLod(instance, lod);
+    }
+}
+
+// Moves an object and keeps its bounds in step. A static object also dirties the cached shadow texels it covered
+// before and covers now.
+void Game::SetObjectWorld(size_t index, const Matrix& world)
+{
+    SceneObject& object = m_sceneObjects[index];
+    if (object.isStatic && object.world == world)
+    {
+        return;
+    }
+
+    object.world = world;
+    if (object.pickInstance != ScenePicker::c_NoHit)
+    {
+        m_picker.SetWorld(object.pickInstance, &world._11);
+    }
+    ShadowBounds previous = m_objectBounds[index];
+    m_objectBounds[index] = ComputeBounds(object);
+
+    if (object.isStatic)
+    {
+        m_shadowCache.InvalidateBounds(previous);
+        m_shadowCache.InvalidateBounds(m_objectBounds[index]);
+        UpdateStaticBounds();
+    }
+}
+
+void Game::UpdateStaticBounds()
+{
+    std::vector<ShadowBounds> staticBounds;
+    std::vector<CollisionBox> colliders;
+    for (size_t i = 0; i < m_sceneObjects.size(); ++i)
+    {
+        if (m_sceneObjects[i].isStatic)
+        {
+            const ShadowBounds& bounds = m_objectBounds[i];
+            staticBounds.push_back(bounds);
+            colliders.push_back({ { bounds.min[0], bounds.min[1], bounds.min[2] }, { bounds.max[0], bounds.max[1], bounds.max[2] } });
+        }
+    }
+    m_sceneBounds = ShadowCascades::Merge(staticBounds.data(), staticBounds.size());
+
+    //the camera collides with the same boxes, the walls and floors are boxes already
+    m_cameraCollision.Build(colliders.data(), colliders.size());
+}
+
+// Every object's and tank instance's picker instance. The ModelClass objects and primitives get a picker mesh each
+// from their CPU geometry the first time one is placed, the tank's meshes are added when it is loaded.
+void Game::AddPickInstances()
+{
+    m_picker.ClearInstances();
+    std::vector<std::pair<const void*, uint32_t>> meshes;
+    auto addMesh = [this, &meshes](const void* key, const std::vector<VertexPositionNormalTexture>& vertices, const std::vector<uint16_t>& indices)
+    {
+        for (const auto& mesh : meshes)
+        {
+            if (mesh.first == key)
+            {
+                return mesh.second;
+            }
+        }
+        std::vector<float> positions;
+        positions.reserve(vertices.size() * 3);
+        for (const auto& vertex : vertices)
+        {
+            positions.insert(positions.end(), { vertex.position.x, vertex.position.y, vertex.position.z });
+        }
+        std::vector<uint32_t> wide(indices.begin(), indices.end());
+        uint32_t mesh = m_picker.AddMesh(positions.data(), vertices.size(), wide.data(), wide.size() / 3);
+        meshes.push_back({ key, mesh });
+        return mesh;
+    };
+
+    for (size_t i = 0; i < m_sceneObjects.size(); ++i)
+    {
+        SceneObject& object = m_sceneObjects[i];
+        object.pickInstance = ScenePicker::c_NoHit;
+        uint32_t mesh = ScenePicker::c_NoHit;
+        if (object.model)
+        {
+            mesh = addMesh(object.model, object.model->GetVertices(), object.model->GetIndices());
+        }
+        else if (object.primitive)
+        {
+            //the same shapes the primitives were made as, the stand is the cube and everything else a planet
+            std::vector<VertexPositionNormalTexture> vertices;
+            std::vector<uint16_t> indices;
+            bool cube = object.primitive == m_stand.get();
+            const void* key = cube ? static_cast<const void*>(m_stand.get()) : static_cast<const void*>(m_planet1.get());
+            if (cube)
+            {
+                GeometricPrimitive::CreateCube(vertices, indices, 2.f);
+            }
+            else
+            {
+                GeometricPrimitive::CreateSphere(vertices, indices);
+            }
+            mesh = addMesh(key, vertices, indices);
+        }
+        if (mesh != ScenePicker::c_NoHit)
+        {
+            object.pickInstance = m_picker.AddInstance(mesh, static_cast<uint32_t>(i), &object.world._11);
+        }
+    }
+
+    //one per tank instance and mesh, placed by UpdateTankPicking
+    m_tankPickInstances = static_cast<uint32_t>(m_picker.GetInstanceCount());
+    UINT tanks = m_tankPalette.IsReady() ? m_tankPalette.GetInstanceCount() : 1;
+    for (UINT tank = 0; tank < tanks; ++tank)
+    {
+        for (uint32_t mesh : m_tankPickMeshes)
+        {
+            m_picker.AddInstance(mesh, static_cast<uint32_t>(m_tankObject), &Matrix::Identity._11);
+        }
+    }
+    UpdateTankPicking();
+}
+
+// The tank's picker instances to this frame's bones, the tank from its absolute bones and the crowd from its palette
+void Game::UpdateTankPicking()
+{
+    if (m_tankPickMeshes.empty() || m_picker.GetInstanceCount() <= m_tankPickInstances)
+    {
+        return;
+    }
+
+    const Matrix& tankWorld = m_sceneObjects[m_tankObject].world;
+    const size_t nbones = m_model->bones.size();
+    UINT tanks = static_cast<UINT>((m_picker.GetInstanceCount() - m_tankPickInstances) / m_tankPickMeshes.size());
+    uint32_t instance = m_tankPickInstances;
+    for (UINT tank = 0; tank < tanks; ++tank)
+    {
+        const PaletteEntry* palette = tank ? m_tankPalette.GetInstancePalette(tank) : nullptr;
+        for (size_t mesh = 0; mesh < m_tankPickMeshes.size(); ++mesh, ++instance)
+        {
+            uint32_t bone = m_model->meshes[mesh]->boneIndex;
+            Matrix world;
+            if (palette)
+            {
+                //the entry's rows are the first three columns of the bone's matrix times the instance's world
+                const PaletteEntry& entry = palette[bone < nbones ? bone : nbones];
+                world = Matrix(entry.rows[0][0], entry.rows[1][0], entry.rows[2][0], 0.f,
+                               entry.rows[0][1], entry.rows[1][1], entry.rows[2][1], 0.f,
+                               entry.rows[0][2], entry.rows[1][2], entry.rows[2][2], 0.f,
+                               entry.rows[0][3], entry.rows[1][3], entry.rows[2][3], 1.f);
+            }
+            else
+            {
+                world = bone < nbones ? m_drawBones[bone] * tankWorld : tankWorld;
+            }
+            m_picker.SetWorld(instance, &world._11);
+        }
+    }
+}
+
+void Game::DrawSceneObject(ID3D11DeviceContext* context, const SceneObject& object)
+{
+    Matrix world = object.world;
+    ID3D11ShaderResourceView* texture = m_textures.Get(object.texture);
+
+    //the bake is of the main light as a point light, so the cascades mode lights everything in real time
+    bool baked = m_shadowMode == ShadowMode::Point;
+
+    if (object.model && m_materialsBound && object.material >= 0)
+    {
+        //the array is bound for the whole pass, the draw only sets its slice
+        Shader& shader = object.lightmapped && baked ? m_lightmapMaterialShader : m_materialShader;
+        shader.EnableShader(context);
+        shader.SetMatrixParameters(context, &world, &m_view, &m_proj);
+        shader.SetLightParameters(context, &m_Light);
+        m_materials.SetSlice(context, static_cast<uint32_t>(object.material));
+        object.model->Render(context, object.lod);
+        return;
+    }
+
+    if (object.model)
+    {
+        Shader& shader = object.lightmapped && baked ? m_lightmapShader : m_BasicShaderPair;
+        shader.EnableShader(context);
+        shader.SetShaderParameters(context, &world, &m_view, &m_proj, &m_Light, texture);
+        object.model->Render(context, object.lod);
+        return;
+    }
+
+    //everything else has no lightmap and takes its bounced light from the probes around the middle of its bounds
+    ShProbe probe;
+    bool probeLit = baked && m_probeLighting.IsLoaded();
+    if (probeLit)
+    {
+        ShadowBounds bounds = ComputeBounds(object);
+        float centre[3] = { (bounds.min[0] + bounds.max[0]) * 0.5f, (bounds.min[1] + bounds.max[1]) * 0.5f, (bounds.min[2] + bounds.max[2]) * 0.5f };
+        m_probeLighting.Sample(centre, probe);
+    }
+
+    if (object.primitive)
+    {
+        GeometricPrimitive* primitive = object.lod ? object.primitiveLods[object.lod - 1].get() : object.primitive;
+        if (!probeLit)
+        {
+            primitive->Draw(world, m_view, m_proj, Colors::BlanchedAlmond, texture);
+            return;
+        }
+
+        //swap the primitive's effect for the probe lit shader once it has set up the buffers, keeping the primitive's own
+        //input layout: VertexPositionNormalTexture puts the normal before the texture coordinate, ModelClass after it
+        primitive->Draw(world, m_view, m_proj, Colors::White, texture, false, [&]()
+        {
+            ComPtr<ID3D11InputLayout> layout;
+            context->IAGetInputLayout(layout.GetAddressOf());
+
+            m_probeShader.EnableShader(context);
+            context->IASetInputLayout(layout.Get());
+            m_probeShader.SetShaderParameters(context, &world, &m_view, &m_proj, &m_Light, texture);
+            m_probeLighting.Set(context, probe);
+        });
+    }
+    else if (object.mesh == m_model.get() && m_tankPalette.IsReady())
+    {
+        //every part against the palette, which holds the world already, so only view and projection are set
+        Matrix identity = Matrix::Identity;
+        Shader& shader = probeLit ? m_rigidProbeShader : m_rigidShader;
+        shader.EnableShader(context);
+        shader.SetMatrixParameters(context, &identity, &m_view, &m_proj);
+        shader.SetLightParameters(context, &m_Light);
+        if (probeLit)
+        {
+            m_probeLighting.Set(context, probe);
+        }
+        m_tankPalette.Draw(context, *m_states);
+    }
+    else if (object.mesh)
+    {
+        size_t nbones = object.mesh->bones.size();
+        if (!probeLit)
+        {
+            object.mesh->Draw(context, *m_states, nbones, m_drawBones.get(), world, m_view, m_proj);
+            return;
+        }
+
+        //mesh by mesh the way Model::Draw does it, so each part gets its bone's world matrix in the probe lit shader
+        for (bool alpha : { false, true })
+        {
+            ModelMesh::PrepareForRendering(context, *m_states, alpha);
+            for (const auto& mesh : object.mesh->meshes)
+            {
+                Matrix meshWorld = world;
+                if (mesh->boneIndex != ModelBone::c_Invalid && mesh->boneIndex < nbones)
+                {
+                    meshWorld = Matrix(m_drawBones[mesh->boneIndex]) * world;
+                }
+
+                mesh->Draw(context, meshWorld, m_view, m_proj, alpha, [&]()
+                {
+                    //the part's effect has already bound its input layout and texture, keep them
+                    ComPtr<ID3D11InputLayout> layout;
+                    ComPtr<ID3D11ShaderResourceView> partTexture;
+                    context->IAGetInputLayout(layout.GetAddressOf());
+                    context->PSGetShaderResources(0, 1, partTexture.GetAddressOf());
+
+                    m_probeShader.EnableShader(context);
+                    context->IASetInputLayout(layout.Get());
+                    m_probeShader.SetShaderParameters(context, &meshWorld, &m_view, &m_proj, &m_Light, partTexture.Get());
+                    m_probeLighting.Set(context, probe);
+                });
+            }
+        }
+    }
+}
+
+// Depth only passes for the main light, into the cascades or the six cube faces
+void Game::RenderShadows(ID3D11DeviceContext* context)
+{
+    m_deviceResources->PIXBeginEvent(L"Shadows");
+    m_shadowStats = {};
+
+    //last frame's shadow maps may still be bound as pixel shader inputs
+    m_shadowMap.Unbind(context);
+    context->OMSetBlendState(m_stateCache.Opaque(), nullptr, 0xFFFFFFFF);
+    context->OMSetDepthStencilState(m_stateCache.DepthDefault(), 0);
+
+    if (m_shadowMode == ShadowMode::Directional)
+    {
+        for (UINT cascade = 0; cascade < m_shadowCascades.GetCount(); ++cascade)
+        {
+            m_shadowCascades.CullCasters(cascade, m_objectBounds.data(), m_objectBounds.size(), m_visibleCasters);
+            RenderShadowView(context, cascade, Matrix(m_shadowCascades.GetCascade(cascade).viewProj));
+        }
+    }
+    else
+    {
+        Vector3 lightPosition = m_Light.getPosition();
+        for (UINT face = 0; face < 6; ++face)
+        {
+            Matrix viewProj;
+            ShadowCascades::BuildCubeFace(&lightPosition.x, POINT_SHADOW_NEAR, POINT_SHADOW_FAR, face, &viewProj._11);
+            ShadowCascades::CullCubeFace(&lightPosition.x, POINT_SHADOW_FAR, face, m_objectBounds.data(), m_objectBounds.size(), m_visibleCasters);
+            RenderShadowView(context, m_shadowMap.GetCascadeCount() + face, viewProj);
+        }
+    }
+
+    m_deviceResources->PIXEndEvent();
+}
+
+// One cascade or cube face, m_visibleCasters holds the casters culled for it
+void Game::RenderShadowView(ID3D11DeviceContext* context, UINT view, const Matrix& viewProj)
+{
+    UINT cascadeCount = m_shadowMap.GetCascadeCount();
+    bool cube = view >= cascadeCount;
+    UINT slice = cube ? view - cascadeCount : view;
+
+    if (!m_shadowCaching)
+    {
+        if (cube)
+        {
+            m_shadowMap.BeginCubeFace(context, slice);
+        }
+        else
+        {
+            m_shadowMap.BeginCascade(context, slice);
+        }
+        m_shadowStats.dynamicDraws += DrawShadowCasters(context, viewProj, m_visibleCasters, false);
+        return;
+    }
+
+    //a different matrix (the light or the cascade moved) throws the whole cached view away
+    m_shadowCache.SetView(view, &viewProj._11, cube ? m_shadowMap.GetCubeResolution() : m_shadowMap.GetResolution());
+    if (m_shadowCache.IsDirty(view))
+    {
+        const ShadowRect* dirty = m_shadowCache.IsFullyDirty(view) ? nullptr : &m_shadowCache.GetDirtyRect(view);
+
+        //static casters, and when patching only those reaching into the dirty rect
+        m_passCasters.clear();
+        for (uint32_t index : m_visibleCasters)
+        {
+            ShadowRect rect;
+            if (m_sceneObjects[index].isStatic
+                && (!dirty || (m_shadowCache.ProjectBounds(view, m_objectBounds[index], rect) && ShadowCache::Overlaps(rect, *dirty))))
+            {
+                m_passCasters.push_back(index);
+            }
+        }
+
+        if (cube)
+        {
+            m_shadowMap.BeginCachedCubeFace(context, slice, dirty);
+        }
+        else
+        {
+            m_shadowMap.BeginCachedCascade(context, slice, dirty);
+        }
+        m_shadowStats.staticDraws += DrawShadowCasters(context, viewProj, m_passCasters, dirty != nullptr);
+        if (dirty)
+        {
+            ++m_shadowStats.viewsPatched;
+        }
+        else
+        {
+            ++m_shadowStats.viewsRebuilt;
+        }
+        m_shadowCache.MarkClean(view);
+    }
+
+    //dynamic casters on top of a copy of the static depth
+    if (cube)
+    {
+        m_shadowMap.RestoreCubeFace(context, slice);
+    }
+    else
+    {
+        m_shadowMap.RestoreCascade(context, slice);
+    }
+    ++m_shadowStats.viewsCopied;
+
+    m_passCasters.clear();
+    for (uint32_t index : m_visibleCasters)
+    {
+        if (!m_sceneObjects[index].isStatic)
+        {
+            m_passCasters.push_back(index);
+        }
+    }
+    m_shadowStats.dynamicDraws += DrawShadowCasters(context, viewProj, m_passCasters, false);
+}
+
+uint32_t Game::DrawShadowCasters(ID3D11DeviceContext* context, const Matrix& viewProj, const std::vector<uint32_t>& casters, bool scissor)
+{
+    //thin walls have no back faces to speak of, so nothing is culled and the bias keeps surfaces off themselves
+    ID3D11RasterizerState* rasterizer = m_stateCache.DepthBiased(1000, 1.5f, D3D11_CULL_NONE, scissor);
+    Matrix identity = Matrix::Identity;
+    Matrix lightViewProj = viewProj;
+
+    //DirectXTK draws keep their own vertex shader and just lose the pixel shader
+    auto depthOnly = [context, rasterizer]()
+    {
+        context->PSSetShader(nullptr, nullptr, 0);
+        context->RSSetState(rasterizer);
+    };
+
+    for (uint32_t index : casters)
+    {
+        const SceneObject& object = m_sceneObjects[index];
+        Matrix world = object.world;
+
+        if (object.model)
+        {
+            context->RSSetState(rasterizer);
+            m_shadowShader.EnableShader(context);
+            m_shadowShader.SetMatrixParameters(context, &world, &identity, &lightViewProj);
+            object.model->Render(context, object.lod);
+        }
+        else if (object.primitive)
+        {
+            GeometricPrimitive* primitive = object.lod ? object.primitiveLods[object.lod - 1].get() : object.primitive;
+            primitive->Draw(world, identity, lightViewProj, Colors::White, nullptr, false, depthOnly);
+        }
+        else if (object.mesh == m_model.get() && m_tankPalette.IsReady())
+        {
+            context->RSSetState(rasterizer);
+            m_rigidShadowShader.EnableShader(context);
+            m_rigidShadowShader.SetMatrixParameters(context, &identity, &identity, &lightViewProj);
+            m_tankPalette.DrawDepth(context);
+        }
+        else if (object.mesh)
+        {
+            size_t nbones = object.mesh->bones.size();
+            object.mesh->Draw(context, *m_states, nbones, m_drawBones.get(), world, identity, lightViewProj, false, depthOnly);
+        }
+    }
+    return static_cast<uint32_t>(casters.size());
+}
+
+ShadowBounds Game::ComputeBounds(const SceneObject& object) const
+{
+    BoundingBox box;
+
+    if (object.mesh)
+    {
+        //each mesh hangs off a bone, the same way Model::Draw places it
+        size_t nbones = object.mesh->bones.size();
+        bool first = true;
+        for (const auto& mesh : object.mesh->meshes)
+        {
+            Matrix meshWorld = object.world;
+            if (mesh->boneIndex != ModelBone::c_Invalid && mesh->boneIndex < nbones)
+            {
+                meshWorld = Matrix(m_drawBones[mesh->boneIndex]) * object.world;
+            }
+
+            BoundingBox meshBox;
+            mesh->boundingBox.Transform(meshBox, meshWorld);
+            if (first)
+            {
+                box = meshBox;
+                first = false;
+            }
+            else
+            {
+                BoundingBox::CreateMerged(box, box, meshBox);
+            }
+        }
+    }
+    else
+    {
+        BoundingBox::CreateFromPoints(box, object.localMin, object.localMax);
+        box.Transform(box, object.world);
+    }
+
+    ShadowBounds bounds;
+    Vector3 boundsMin = Vector3(box.Center) - Vector3(box.Extents);
+    Vector3 boundsMax = Vector3(box.Center) + Vector3(box.Extents);
+    bounds.min[0] = boundsMin.x; bounds.min[1] = boundsMin.y; bounds.min[2] = boundsMin.z;
+    bounds.max[0] = boundsMax.x; bounds.max[1] = boundsMax.y; bounds.max[2] = boundsMax.z;
+    return bounds;
+}
+
+// Static ModelClass objects in the form the light baker reads
+void Game::ExportLightmapScene(LightmapScene& scene)
+{
+    Vector3 position = m_Light.getPosition();
+    Vector4 diffuse = m_Light.getDiffuseColour();
+    Vector4 ambient = m_Light.getAmbientColour();
+    scene.light = { { position.x, position.y, position.z }, { diffuse.x, diffuse.y, diffuse.z }, { ambient.x, ambient.y, ambient.z } };
+    scene.meshes.clear();
+
+    for (size_t i = 0; i < m_sceneObjects.size(); ++i)
+    {
+        const SceneObject& object = m_sceneObjects[i];
+        if (!object.isStatic || !object.model || object.model->GetIndices().empty())
+        {
+            continue;
+        }
+
+        LightmapMesh mesh;
+        mesh.object = static_cast<uint32_t>(i);
+        memcpy(mesh.world, &object.world._11, sizeof(mesh.world));
+        //textures aren't read by the baker, a mid grey stands in for them in the bounces
+        mesh.albedo[0] = mesh.albedo[1] = mesh.albedo[2] = 0.5f;
+        for (const auto& vertex : object.model->GetVertices())
+        {
+            mesh.positions.insert(mesh.positions.end(), { vertex.position.x, vertex.position.y, vertex.position.z });
+            mesh.normals.insert(mesh.normals.end(), { vertex.normal.x, vertex.normal.y, vertex.normal.z });
+        }
+        mesh.indices.assign(object.model->GetIndices().begin(), object.model->GetIndices().end());
+        scene.meshes.push_back(std::move(mesh));
+    }
+}
+
+// Uses lightmap.dds / lightmap.lmscene / lightmap.probes when they were baked from this exact scene, otherwise
+// keeps lighting everything in real time until B writes scene.lmscene for BakeLightmaps
+void Game::LoadLightmap(ID3D11Device* device)
+{
+    LightmapScene scene, baked;
+    ExportLightmapScene(scene);
+
+    m_lightmapTexture.Reset();
+    m_probeLighting.Unload();
+    if (scene.meshes.empty())
+    {
+        return;
+    }
+
+    //mapped and checked before DirectXTK creates the texture straight from the mapping
+    DDSImage lightmap;
+    if (!baked.Load("lightmap.lmscene") || baked.GetSourceHash() != scene.GetSourceHash() || !lightmap.Open("lightmap.dds")
+        || FAILED(CreateDDSTextureFromMemory(device, lightmap.GetData(), lightmap.GetSize(), nullptr, m_lightmapTexture.ReleaseAndGetAddressOf())))
+    {
+        m_lightmapTexture.Reset();
+        return;
+    }
+
+    for (const LightmapMesh& mesh : baked.meshes)
+    {
+        SceneObject& object = m_sceneObjects[mesh.object];
+        object.lightmapped = object.model->SetLightmapUVs(device, mesh.lightmapUVs);
+    }
+
+    //optional, without them the primitives and the tank keep their own effects
+    m_probeLighting.Load("lightmap.probes", scene.GetSourceHash());
+}
+
 void Game::OnDeviceRestored()
 {
     CreateDeviceDependentResources();
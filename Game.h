@@ -7,9 +7,28 @@
 #include "DeviceResources.h"
 #include "StepTimer.h"
 #include "Shader.h"
+#include "AssetLoader.h"
 #include "Light.h"
 #include "modelclass.h"
 #include "RenderTexture.h"
+#include "InputLayoutCache.h"
+#include "ThreadPool.h"
+#include "ClusteredLighting.h"
+#include "ShadowMap.h"
+#include "LightmapScene.h"
+#include "ProbeLighting.h"
+#include "MaterialArray.h"
+#include "TextureManager.h"
+#include "BonePaletteModel.h"
+#include "Rig.h"
+#include "SdkMeshFile.h"
+#include "AnimationClip.h"
+#include "AnimationCrowd.h"
+#include "LodChain.h"
+#include "SceneCollision.h"
+#include "ScenePicker.h"
+#include "InputIntegrator.h"
+#include "InputSampler.h"
 
 // A basic game implementation that creates a D3D11 device and
 // provides a game loop.
@@ -47,9 +66,19 @@ public:
     //audio
     void OnNewAudioDevice() noexcept { m_retryAudio = true; }
 
+    //input messages from the window procedure, stamped and queued for the next Update
+    void OnInputMessage(UINT message, WPARAM wParam, LPARAM lParam) { m_inputSampler.ProcessMessage(message, wParam, lParam); }
+
     // Properties
     void GetDefaultSize( int& width, int& height ) const noexcept;
 
+    //what the last frame's shadow passes drew, compare with caching on and off (C)
+    const ShadowDrawStats& GetShadowStats() const noexcept { return m_shadowStats; }
+
+    //what was under the cursor at the last click, object is an index into the scene's objects (every tank of the
+    //crowd is the tank's object, told apart by instance), c_NoHit if it was nothing
+    const PickHit& GetPicked() const noexcept { return m_picked; }
+
 private:
 
     void Update(DX::StepTimer const& timer);
@@ -60,21 +89,125 @@ private:
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
 
+    void SetupSceneLights();
+    void UpdateSceneLights(float time);
+
+    //one object of the scene, drawn by the main pass and by the shadow passes
+    struct SceneObject
+    {
+        ModelClass*                         model;          //ModelClass geometry drawn with m_BasicShaderPair, or
+        DirectX::GeometricPrimitive*        primitive;      //a DirectXTK primitive, or
+        DirectX::Model*                     mesh;           //the tank, drawn with its bones
+        TextureHandle                       texture;        //resolved through m_textures when drawn
+        int                                 material;       //slice of m_materials holding the same texture, -1 if it isn't packed
+        DirectX::SimpleMath::Matrix         world;
+        DirectX::SimpleMath::Vector3        localMin;       //object space bounds
+        DirectX::SimpleMath::Vector3        localMax;
+        bool                                isStatic;
+        bool                                lightmapped;    //model has lightmap uvs from the last bake
+        const float*                        lodErrors;      //each level's error in object space, lodCount of them
+        uint32_t                            lodCount;       //1 without coarser levels
+        uint32_t                            lod;            //level drawn this frame, from SelectLods
+        const std::unique_ptr<DirectX::GeometricPrimitive>* primitiveLods;     //levels 1 and on of a primitive
+        uint32_t                            pickInstance;   //in m_picker, ScenePicker::c_NoHit if it can't be picked
+    };
+
+    void BuildScene();
+    void UpdateScene(float time);
+    void SelectLods();
+    void DrawSceneObject(ID3D11DeviceContext* context, const SceneObject& object);
+    void SetObjectWorld(size_t index, const DirectX::SimpleMath::Matrix& world);
+    void UpdateStaticBounds();
+    void AddPickInstances();
+    void UpdateTankPicking();
+    void RenderShadows(ID3D11DeviceContext* context);
+    void RenderShadowView(ID3D11DeviceContext* context, UINT view, const DirectX::SimpleMath::Matrix& viewProj);
+    uint32_t DrawShadowCasters(ID3D11DeviceContext* context, const DirectX::SimpleMath::Matrix& viewProj,
+        const std::vector<uint32_t>& casters, bool scissor);
+    ShadowBounds ComputeBounds(const SceneObject& object) const;
+    void ExportLightmapScene(LightmapScene& scene);
+    void LoadLightmap(ID3D11Device* device);
+
     // Device resources.
     std::unique_ptr<DX::DeviceResources>    m_deviceResources;
 
     // Rendering loop timer.
     DX::StepTimer                           m_timer;
 
+    //packed assets, opened first and closed last since the texture streamer reads from it on its own threads
+    AssetArchive                            m_assets;
+    //startup reads from the archive or prefetched loose files, see AssetLoader.h
+    AssetLoader                             m_loader;
+
     //Input controls
     std::unique_ptr<DirectX::Keyboard> m_keyboard;
+    DirectX::Keyboard::KeyboardStateTracker m_keyTracker;
     std::unique_ptr<DirectX::Mouse> m_mouse;
+    DirectX::Mouse::ButtonStateTracker m_mouseButtons;
+    //camera motion from timestamped events rather than the state once a Tick, see InputQueue.h
+    InputSampler m_inputSampler;
+    InputIntegrator m_input;
+
+    //the object and triangle under the cursor, picked every frame the cursor is free and kept when it's clicked. One
+    //picker mesh per ModelClass, primitive shape and tank mesh, placed by every object and tank instance.
+    ScenePicker m_picker;
+    std::vector<uint32_t> m_tankPickMeshes;     //per mesh of the tank's SDKMESH
+    uint32_t m_tankPickInstances;               //first of the tank's, one per tank instance and mesh
+    PickHit m_hover;
+    PickHit m_picked;
     
     //Light
     Light										m_Light;
     //Light										m_Light2;
+
+    //clustered lights, binned on the worker threads every frame
+    ThreadPool									m_threadPool;
+    LightManager								m_sceneLights;
+    LightClusters								m_lightClusters;
+    ClusteredLighting							m_clusteredLighting;
+
+    //main light shadows, point light cube or directional cascades (toggled with L)
+    ShadowMode									m_shadowMode;
+    ShadowCascades								m_shadowCascades;
+    ShadowMap									m_shadowMap;
+    Shader										m_shadowShader;
+    //static casters are kept in cached maps, only the dynamic ones are redrawn each frame (toggled with C)
+    bool										m_shadowCaching;
+    ShadowCache									m_shadowCache;
+    ShadowDrawStats								m_shadowStats;
+    std::vector<uint32_t>						m_passCasters;
+
+    //baked main light and bounces for the static ModelClass objects, see Tools/BakeLightmaps.cpp
+    Shader										m_lightmapShader;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_lightmapTexture;
+    //the same bake as SH probes, for the primitives and the tank
+    Shader										m_probeShader;
+    ProbeLighting								m_probeLighting;
+    //the ModelClass textures packed into one array, see Tools/PackMaterials.cpp. Bound once per pass, the draws
+    //only change the slice
+    Shader										m_materialShader;
+    Shader										m_lightmapMaterialShader;
+    MaterialArray								m_materials;
+    bool										m_materialsBound;
+    //the tank's bones uploaded once a frame and every part drawn against them, see BonePaletteModel.h. Model::Draw
+    //draws it if the palette couldn't be set up.
+    BonePaletteModel							m_tankPalette;
+    Shader										m_rigidShader;
+    Shader										m_rigidProbeShader;
+    Shader										m_rigidShadowShader;
+
+    //everything in the scene except the sky room, with world bounds kept in step for culling
+    std::vector<SceneObject>					m_sceneObjects;
+    std::vector<ShadowBounds>					m_objectBounds;
+    ShadowBounds								m_sceneBounds;          //static objects only, so the cascades don't move with the planets
+    SceneCollision								m_cameraCollision;      //the static objects' boxes, rebuilt with m_sceneBounds
+    std::vector<uint32_t>						m_visibleCasters;
+    size_t										m_planetObjects[3];
+    size_t										m_tankObject;
     //Shaders
     Shader									m_BasicShaderPair;
+    InputLayoutCache						m_inputLayouts;
+    StateCache								m_stateCache;
 
     //scene elements
     std::unique_ptr<DirectX::GeometricPrimitive> m_room;
@@ -92,24 +225,25 @@ private:
     DirectX::SimpleMath::Color m_roomColor;
 
     std::shared_ptr<IEffect> effect;
-    //textures
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_roomTex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_planet1Tex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_planet2Tex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_planet3Tex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_planet4Tex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> wallTex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> wallTex2;
+    //textures, streamed in the background and drawn with a placeholder until they arrive
+    TextureManager m_textures;
+    TextureHandle m_roomTex;
+    TextureHandle m_planet1Tex;
+    TextureHandle m_planet2Tex;
+    TextureHandle m_planet3Tex;
+    TextureHandle m_planet4Tex;
+    TextureHandle wallTex;
+    TextureHandle wallTex2;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_texture2;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodTex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> grassTex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> marbleTex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> exteriorTex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleTex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> fence;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> treeTrunkTex;
+    TextureHandle woodTex;
+    TextureHandle grassTex;
+    TextureHandle marbleTex;
+    TextureHandle exteriorTex;
+    TextureHandle cobbleTex;
+    TextureHandle fence;
+    TextureHandle treeTrunkTex;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> treeTopTex;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorTex2;
+    TextureHandle floorTex2;
 
     //audio
     std::unique_ptr<DirectX::AudioEngine> m_audEngine;
@@ -179,15 +313,26 @@ private:
     //tank, anim and bones
     DirectX::ModelBone::TransformArray m_drawBones;
     DirectX::ModelBone::TransformArray m_animBones;
-    uint32_t m_leftBackWheelBone;
-    uint32_t m_rightBackWheelBone;
-    uint32_t m_leftFrontWheelBone;
-    uint32_t m_rightFrontWheelBone;
-    uint32_t m_leftSteerBone;
-    uint32_t m_rightSteerBone;
-    uint32_t m_turretBone;
-    uint32_t m_cannonBone;
-    uint32_t m_hatchBone;
+    //bone names, parents and bind transforms from Tools/BakeRig's tank.rig or the model's bones, taken once and kept
+    //across device loss, clips and the crowd bind through its name table
+    Rig m_tankRig;
+    //clips baked by Tools/BakeTankClips, T cross fades from driving to idling and back. Without them the tank keeps
+    //its bind pose.
+    std::vector<AnimationClip> m_tankClips;
+    ClipSampler m_tankDrive;
+    ClipSampler m_tankIdle;
+    std::vector<BonePose> m_tankPoses[3];      //drive, idle and the blend of the two, one per bone
+    float m_tankIdleWeight;
+    bool m_tankIdling;
+    //tanks parked outside, posed with the same clips and drawn as more instances of the tank's palette
+    AnimationCrowd m_tankCrowd;
+
+    //levels of detail, picked per object and per tank instance from their error in pixels. The tank's chains from
+    //Tools/BuildLods are CPU data and kept across device loss, the planets step down to coarser spheres.
+    LodSelector m_lodSelector;
+    std::vector<LodChain> m_tankLods;
+    std::vector<std::unique_ptr<DirectX::GeometricPrimitive>> m_sphereLods;
+    std::vector<float> m_sphereLodErrors;
 
     //effects
     std::unique_ptr<DirectX::BasicEffect> m_effect;
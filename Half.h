@@ -0,0 +1,95 @@
+//
+// Half.h - IEEE half precision conversions for data packed on the CPU (light cones, baked lightmaps)
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace Half
+{
+	// Float to half, rounding to nearest even. Infinities, NaNs and subnormals are handled.
+	inline uint16_t FromFloat(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		uint32_t sign = (bits >> 16) & 0x8000u;
+		int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xffu) - 127 + 15;
+		uint32_t mantissa = bits & 0x7fffffu;
+
+		if (((bits >> 23) & 0xffu) == 0xffu)
+		{
+			return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+		}
+		if (exponent >= 31)
+		{
+			return static_cast<uint16_t>(sign | 0x7c00u);
+		}
+		if (exponent <= 0)
+		{
+			if (exponent < -10)
+			{
+				return static_cast<uint16_t>(sign);
+			}
+			mantissa |= 0x800000u;
+			uint32_t shift = static_cast<uint32_t>(14 - exponent);
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1u);
+			uint32_t halfway = 1u << (shift - 1u);
+			if (rest > halfway || (rest == halfway && (half & 1u)))
+			{
+				++half;
+			}
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1fffu;
+		if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+		{
+			++half;		//may carry into the exponent, which is still the correctly rounded value
+		}
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	inline float ToFloat(uint16_t value)
+	{
+		uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+		uint32_t exponent = (value >> 10) & 0x1fu;
+		uint32_t mantissa = value & 0x3ffu;
+		uint32_t bits;
+
+		if (exponent == 0)
+		{
+			if (mantissa == 0)
+			{
+				bits = sign;
+			}
+			else
+			{
+				// subnormal, renormalise
+				exponent = 127 - 15 + 1;
+				while (!(mantissa & 0x400u))
+				{
+					mantissa <<= 1;
+					--exponent;
+				}
+				bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+			}
+		}
+		else if (exponent == 31)
+		{
+			bits = sign | 0x7f800000u | (mantissa << 13);
+		}
+		else
+		{
+			bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+		}
+
+		float result;
+		std::memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+}
@@ -0,0 +1,52 @@
+//
+// Hash.h - Small portable hashing helpers used by the resource caches
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Hash
+{
+	constexpr uint64_t c_Fnv64Offset = 0xcbf29ce484222325ull;
+	constexpr uint64_t c_Fnv64Prime = 0x100000001b3ull;
+
+	// FNV-1a over a block of bytes. Pass a previous result as seed to chain blocks together.
+	inline uint64_t Fnv1a(const void* data, size_t size, uint64_t seed = c_Fnv64Offset)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		uint64_t hash = seed;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= c_Fnv64Prime;
+		}
+		return hash;
+	}
+
+	// FNV-1a over a zero terminated string.
+	inline uint64_t Fnv1a(const char* str, uint64_t seed = c_Fnv64Offset)
+	{
+		uint64_t hash = seed;
+		for (; *str; ++str)
+		{
+			hash ^= static_cast<uint8_t>(*str);
+			hash *= c_Fnv64Prime;
+		}
+		return hash;
+	}
+
+	// Hashes a plain-old-data description by value (padding must be zeroed by the caller).
+	template<typename T>
+	inline uint64_t OfValue(const T& value, uint64_t seed = c_Fnv64Offset)
+	{
+		return Fnv1a(&value, sizeof(T), seed);
+	}
+
+	// Mixes two hashes into one (boost::hash_combine style, widened to 64 bits).
+	inline uint64_t Combine(uint64_t a, uint64_t b)
+	{
+		return a ^ (b + 0x9e3779b97f4a7c15ull + (a << 6) + (a >> 2));
+	}
+}
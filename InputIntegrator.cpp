@@ -0,0 +1,140 @@
+// Key holds and mouse motion of a frame from timestamped events
+#include "InputIntegrator.h"
+
+#include <algorithm>
+#include <iterator>
+
+InputIntegrator::InputIntegrator()
+{
+	Reset(1000, 0);
+}
+
+void InputIntegrator::Reset(int64_t ticksPerSecond, int64_t time)
+{
+	m_ticksPerSecond = ticksPerSecond > 0 ? ticksPerSecond : 1;
+	m_frameStart = m_frameEnd = time;
+	std::fill(std::begin(m_keyDownSince), std::end(m_keyDownSince), c_Up);
+	std::fill(std::begin(m_keyHeld), std::end(m_keyHeld), 0);
+	std::fill(std::begin(m_keyPressed), std::end(m_keyPressed), false);
+	std::fill(std::begin(m_buttonDown), std::end(m_buttonDown), false);
+	m_delta[0] = m_delta[1] = 0;
+	std::fill(&m_dragDelta[0][0], &m_dragDelta[0][0] + c_ButtonCount * 2, 0);
+	m_cursor[0] = m_cursor[1] = 0;
+}
+
+void InputIntegrator::BeginFrame(int64_t frameEnd)
+{
+	// A key still held carries over from the new frame's start
+	m_frameStart = m_frameEnd;
+	m_frameEnd = std::max(frameEnd, m_frameStart);
+	for (uint32_t key = 0; key < c_KeyCount; ++key)
+	{
+		m_keyHeld[key] = 0;
+		m_keyPressed[key] = false;
+		if (m_keyDownSince[key] != c_Up)
+		{
+			m_keyDownSince[key] = m_frameStart;
+		}
+	}
+	m_delta[0] = m_delta[1] = 0;
+	std::fill(&m_dragDelta[0][0], &m_dragDelta[0][0] + c_ButtonCount * 2, 0);
+}
+
+void InputIntegrator::Apply(const InputEvent & event)
+{
+	int64_t time = Clamp(event.time);
+	switch (event.type)
+	{
+	case InputEventType::Key:
+		if (event.code >= c_KeyCount)
+		{
+			break;
+		}
+		if (!event.down)
+		{
+			Release(event.code, time);
+		}
+		else if (m_keyDownSince[event.code] == c_Up)		//auto repeat downs change nothing
+		{
+			m_keyDownSince[event.code] = time;
+			m_keyPressed[event.code] = true;
+		}
+		break;
+
+	case InputEventType::Button:
+		if (event.code < c_ButtonCount)
+		{
+			m_buttonDown[event.code] = event.down;
+		}
+		break;
+
+	case InputEventType::MouseMove:
+		m_delta[0] += event.x;
+		m_delta[1] += event.y;
+		for (uint32_t button = 0; button < c_ButtonCount; ++button)
+		{
+			if (m_buttonDown[button])
+			{
+				m_dragDelta[button][0] += event.x;
+				m_dragDelta[button][1] += event.y;
+			}
+		}
+		break;
+
+	case InputEventType::Cursor:
+		m_cursor[0] = event.x;
+		m_cursor[1] = event.y;
+		break;
+
+	case InputEventType::Focus:
+		if (!event.down)
+		{
+			ReleaseAll(time);
+		}
+		break;
+	}
+}
+
+void InputIntegrator::ReleaseAll(int64_t time)
+{
+	time = Clamp(time);
+	for (uint32_t key = 0; key < c_KeyCount; ++key)
+	{
+		Release(key, time);
+	}
+	std::fill(std::begin(m_buttonDown), std::end(m_buttonDown), false);
+}
+
+float InputIntegrator::GetHeldSeconds(uint32_t key) const
+{
+	if (key >= c_KeyCount)
+	{
+		return 0.0f;
+	}
+	int64_t held = m_keyHeld[key];
+	if (m_keyDownSince[key] != c_Up)
+	{
+		held += m_frameEnd - m_keyDownSince[key];
+	}
+	return float(held) / float(m_ticksPerSecond);
+}
+
+void InputIntegrator::GetDragDelta(uint32_t button, int32_t & x, int32_t & y) const
+{
+	x = button < c_ButtonCount ? m_dragDelta[button][0] : 0;
+	y = button < c_ButtonCount ? m_dragDelta[button][1] : 0;
+}
+
+int64_t InputIntegrator::Clamp(int64_t time) const
+{
+	return std::min(std::max(time, m_frameStart), m_frameEnd);
+}
+
+void InputIntegrator::Release(uint32_t key, int64_t time)
+{
+	if (m_keyDownSince[key] != c_Up)
+	{
+		m_keyHeld[key] += std::max<int64_t>(time - m_keyDownSince[key], 0);
+		m_keyDownSince[key] = c_Up;
+	}
+}
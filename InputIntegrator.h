@@ -0,0 +1,65 @@
+//
+// InputIntegrator.h - A frame's input measured from timestamped events, for moving the camera
+//
+// BeginFrame opens the span from the last frame's end to this one's. Each event then applied in time order changes
+// what is held from its own time: a key down for part of the frame counts for that part, so a tap shorter than a frame
+// still moves the camera its length and a key let go early stops it there. Mouse motion is summed, and separately for
+// each button over the motion that came while it was held, so the counts before a click starts a drag don't turn the
+// camera. Events stamped before the frame began (a late message) count from its start and ones after its end from
+// its end.
+//
+
+#pragma once
+
+#include "InputQueue.h"
+
+#include <cstddef>
+#include <cstdint>
+
+class InputIntegrator
+{
+public:
+	static constexpr uint32_t c_KeyCount = 256;
+	static constexpr uint32_t c_ButtonCount = 5;
+
+	InputIntegrator();
+
+	//Ticks of the events' clock a second, and lets go of everything
+	void Reset(int64_t ticksPerSecond, int64_t time);
+
+	void BeginFrame(int64_t frameEnd);
+	void Apply(const InputEvent& event);
+	//Lets go of every key and button at time, after events were dropped or focus was lost
+	void ReleaseAll(int64_t time);
+
+	//Seconds of this frame the key was held
+	float GetHeldSeconds(uint32_t key) const;
+	bool IsKeyDown(uint32_t key) const { return key < c_KeyCount && m_keyDownSince[key] != c_Up; }
+	bool WasKeyPressed(uint32_t key) const { return key < c_KeyCount && m_keyPressed[key]; }
+	bool IsButtonDown(uint32_t button) const { return button < c_ButtonCount && m_buttonDown[button]; }
+
+	//Raw mouse motion this frame, all of it or only what came while button was held
+	void GetMouseDelta(int32_t& x, int32_t& y) const { x = m_delta[0]; y = m_delta[1]; }
+	void GetDragDelta(uint32_t button, int32_t& x, int32_t& y) const;
+
+	void GetCursor(int32_t& x, int32_t& y) const { x = m_cursor[0]; y = m_cursor[1]; }
+
+	float GetFrameSeconds() const { return float(m_frameEnd - m_frameStart) / float(m_ticksPerSecond); }
+
+private:
+	static constexpr int64_t c_Up = INT64_MIN;
+
+	int64_t Clamp(int64_t time) const;
+	void Release(uint32_t key, int64_t time);
+
+	int64_t		m_ticksPerSecond;
+	int64_t		m_frameStart;
+	int64_t		m_frameEnd;
+	int64_t		m_keyDownSince[c_KeyCount];		//c_Up if it isn't held
+	int64_t		m_keyHeld[c_KeyCount];			//ticks of this frame
+	bool		m_keyPressed[c_KeyCount];
+	bool		m_buttonDown[c_ButtonCount];
+	int32_t		m_delta[2];
+	int32_t		m_dragDelta[c_ButtonCount][2];
+	int32_t		m_cursor[2];
+};
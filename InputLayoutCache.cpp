@@ -0,0 +1,115 @@
+// Input layout cache, keyed by vertex format and shader input signature
+#include "pch.h"
+#include "InputLayoutCache.h"
+
+
+InputLayoutCache::InputLayoutCache()
+{
+}
+
+
+InputLayoutCache::~InputLayoutCache()
+{
+}
+
+ID3D11InputLayout* InputLayoutCache::Get(ID3D11Device * device, const VertexFormat & format, const void * vsBytecode, size_t bytecodeLength)
+{
+	ShaderInputSignature signature;
+	if (!ParseShaderInputSignature(vsBytecode, bytecodeLength, signature))
+	{
+		return nullptr;
+	}
+
+	Key key = { format.GetHash(), signature.hash };
+	auto it = m_layouts.find(key);
+	if (it != m_layouts.end() && it->second.format == format)
+	{
+		return it->second.layout.Get();
+	}
+
+	if (!VertexFormatMatchesSignature(format, signature))
+	{
+		return nullptr;
+	}
+
+	// Translate the portable descriptor into the D3D element array.
+	std::vector<D3D11_INPUT_ELEMENT_DESC> elements;
+	elements.reserve(format.GetElements().size());
+	for (const auto& element : format.GetElements())
+	{
+		D3D11_INPUT_ELEMENT_DESC desc;
+		desc.SemanticName = element.semantic;
+		desc.SemanticIndex = element.semanticIndex;
+		desc.Format = ToDXGIFormat(element.format);
+		desc.InputSlot = element.slot;
+		desc.AlignedByteOffset = element.offset;
+		desc.InputSlotClass = element.perInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+		desc.InstanceDataStepRate = element.instanceStepRate;
+		elements.push_back(desc);
+	}
+
+	Entry entry;
+	entry.format = format;
+	HRESULT result = device->CreateInputLayout(elements.data(), static_cast<UINT>(elements.size()), vsBytecode, bytecodeLength, entry.layout.GetAddressOf());
+	if (FAILED(result))
+	{
+		return nullptr;
+	}
+
+	ID3D11InputLayout* layout = entry.layout.Get();
+	m_layouts[key] = std::move(entry);
+	return layout;
+}
+
+void InputLayoutCache::Reset()
+{
+	m_layouts.clear();
+}
+
+DXGI_FORMAT InputLayoutCache::ToDXGIFormat(VertexElementFormat format)
+{
+	switch (format)
+	{
+	case VertexElementFormat::Float1:		return DXGI_FORMAT_R32_FLOAT;
+	case VertexElementFormat::Float2:		return DXGI_FORMAT_R32G32_FLOAT;
+	case VertexElementFormat::Float3:		return DXGI_FORMAT_R32G32B32_FLOAT;
+	case VertexElementFormat::Float4:		return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	case VertexElementFormat::UInt1:		return DXGI_FORMAT_R32_UINT;
+	case VertexElementFormat::UByte4:		return DXGI_FORMAT_R8G8B8A8_UINT;
+	case VertexElementFormat::UByte4Norm:	return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case VertexElementFormat::Half2:		return DXGI_FORMAT_R16G16_FLOAT;
+	case VertexElementFormat::Half4:		return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	default:								return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+VertexElementFormat InputLayoutCache::FromDXGIFormat(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32_FLOAT:				return VertexElementFormat::Float1;
+	case DXGI_FORMAT_R32G32_FLOAT:			return VertexElementFormat::Float2;
+	case DXGI_FORMAT_R32G32B32_FLOAT:		return VertexElementFormat::Float3;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:	return VertexElementFormat::Float4;
+	case DXGI_FORMAT_R32_UINT:				return VertexElementFormat::UInt1;
+	case DXGI_FORMAT_R8G8B8A8_UINT:			return VertexElementFormat::UByte4;
+	case DXGI_FORMAT_R8G8B8A8_UNORM:		return VertexElementFormat::UByte4Norm;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:		return VertexElementFormat::UByte4Norm;
+	case DXGI_FORMAT_R16G16_FLOAT:			return VertexElementFormat::Half2;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:	return VertexElementFormat::Half4;
+	default:								return VertexElementFormat::Unknown;
+	}
+}
+
+VertexFormat InputLayoutCache::FromInputElements(const D3D11_INPUT_ELEMENT_DESC * elements, size_t count)
+{
+	VertexFormat format;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const D3D11_INPUT_ELEMENT_DESC& desc = elements[i];
+		uint32_t offset = (desc.AlignedByteOffset == D3D11_APPEND_ALIGNED_ELEMENT) ? format.GetStride(desc.InputSlot) : desc.AlignedByteOffset;
+		format.AddAt(offset, desc.SemanticName, desc.SemanticIndex, FromDXGIFormat(desc.Format), desc.InputSlot,
+			desc.InputSlotClass == D3D11_INPUT_PER_INSTANCE_DATA, desc.InstanceDataStepRate);
+	}
+	return format;
+}
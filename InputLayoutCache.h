@@ -0,0 +1,48 @@
+#pragma once
+
+#include "VertexFormat.h"
+#include <unordered_map>
+
+//Shares ID3D11InputLayout objects between shaders and meshes.
+//Layouts are keyed by (vertex format hash, vertex shader input signature hash), so any number of shaders with the
+//same inputs reuse one layout per mesh format. The cache owns the layouts; Reset() must be called on device loss.
+class InputLayoutCache
+{
+public:
+	InputLayoutCache();
+	~InputLayoutCache();
+
+	//Returns the layout binding format to the shader, creating it on first use. Returns nullptr if the shader
+	//expects inputs the format does not provide.
+	ID3D11InputLayout* Get(ID3D11Device* device, const VertexFormat& format, const void* vsBytecode, size_t bytecodeLength);
+
+	void Reset();
+	size_t GetCount() const { return m_layouts.size(); }
+
+	static DXGI_FORMAT ToDXGIFormat(VertexElementFormat format);
+	static VertexElementFormat FromDXGIFormat(DXGI_FORMAT format);
+
+	//Builds a portable descriptor from an existing D3D element array (DirectXTK mesh parts carry these).
+	static VertexFormat FromInputElements(const D3D11_INPUT_ELEMENT_DESC* elements, size_t count);
+
+private:
+	struct Key
+	{
+		uint64_t format;
+		uint64_t signature;
+		bool operator==(const Key& other) const { return format == other.format && signature == other.signature; }
+	};
+
+	struct KeyHasher
+	{
+		size_t operator()(const Key& key) const { return static_cast<size_t>(key.format ^ (key.signature * 0x9e3779b97f4a7c15ull)); }
+	};
+
+	struct Entry
+	{
+		VertexFormat								format;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout>	layout;
+	};
+
+	std::unordered_map<Key, Entry, KeyHasher>	m_layouts;
+};
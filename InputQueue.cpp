@@ -0,0 +1,57 @@
+// Single producer, single consumer ring of input events
+#include "InputQueue.h"
+
+#include <algorithm>
+
+InputQueue::InputQueue(size_t capacity) :
+	m_head(0),
+	m_tail(0),
+	m_dropped(0)
+{
+	size_t size = 2;
+	while (size < capacity + 1)
+	{
+		size *= 2;
+	}
+	m_events.resize(size);
+	m_mask = size - 1;
+}
+
+bool InputQueue::Push(const InputEvent & event)
+{
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+	size_t next = (tail + 1) & m_mask;
+	if (next == m_head.load(std::memory_order_acquire))
+	{
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	m_events[tail] = event;
+	m_tail.store(next, std::memory_order_release);
+	return true;
+}
+
+bool InputQueue::Pop(InputEvent & event, int64_t time)
+{
+	size_t head = m_head.load(std::memory_order_relaxed);
+	if (head == m_tail.load(std::memory_order_acquire) || m_events[head].time > time)
+	{
+		return false;
+	}
+	event = m_events[head];
+	m_head.store((head + 1) & m_mask, std::memory_order_release);
+	return true;
+}
+
+uint32_t InputQueue::TakeDropped()
+{
+	return m_dropped.exchange(0, std::memory_order_relaxed);
+}
+
+int64_t BackdateTicks(int64_t now, uint32_t nowMs, uint32_t eventMs, int64_t ticksPerSecond, int64_t maxAge, int64_t notBefore)
+{
+	// Unsigned difference so the wrap every 49.7 days works out, an event stamped after now counts as now
+	uint32_t ageMs = nowMs - eventMs;
+	int64_t age = ageMs > 0x7fffffffu ? 0 : int64_t(ageMs) * ticksPerSecond / 1000;
+	return std::max(now - std::min(age, maxAge), std::min(notBefore, now));
+}
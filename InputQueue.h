@@ -0,0 +1,73 @@
+//
+// InputQueue.h - Timestamped input events handed from the message thread to the game's update
+//
+// The window procedure turns each key, button, raw mouse move and cursor message into an InputEvent stamped with
+// when Windows queued it, not when it was pumped, and pushes it here. Update takes the events up to the start of its
+// frame and InputIntegrator replays them in order, so a key's hold and a mouse drag are measured against the times they
+// happened rather than sampled once a Tick.
+//
+// The queue is a single producer, single consumer ring with no lock: the producer only writes m_tail and the consumer
+// only m_head, each published with release and read with acquire, on cache lines of their own. Pushing into a full
+// queue drops the event and counts it, so a long stall loses input rather than blocking the message thread.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class InputEventType : uint8_t
+{
+	Key,			//code is the virtual key
+	Button,			//code is the mouse button, 0 left, 1 right, 2 middle, 3 and 4 the side ones
+	MouseMove,		//x, y counts of raw relative motion
+	Cursor,			//x, y client position
+	Focus,			//down false when the window loses focus, everything held is let go
+};
+
+struct InputEvent
+{
+	int64_t			time;			//ticks of the game's clock (QueryPerformanceCounter on Windows)
+	InputEventType	type;
+	bool			down;
+	uint16_t		code;
+	int32_t			x;
+	int32_t			y;
+};
+
+class InputQueue
+{
+public:
+	//capacity is rounded up to a power of two, one slot is kept empty
+	explicit InputQueue(size_t capacity = 4096);
+
+	InputQueue(InputQueue const&) = delete;
+	InputQueue& operator= (InputQueue const&) = delete;
+
+	//Producer. False, and counted as dropped, if the queue is full.
+	bool Push(const InputEvent& event);
+
+	//Consumer. The oldest event if there is one stamped no later than time, events after it stay for the next frame.
+	bool Pop(InputEvent& event, int64_t time = INT64_MAX);
+
+	//Consumer. Events dropped since the last call.
+	uint32_t TakeDropped();
+
+	size_t GetCapacity() const { return m_mask; }
+
+private:
+	static constexpr size_t c_CacheLine = 64;
+
+	std::vector<InputEvent>					m_events;
+	size_t									m_mask;
+	alignas(c_CacheLine) std::atomic<size_t>	m_head;			//next to pop, written by the consumer
+	alignas(c_CacheLine) std::atomic<size_t>	m_tail;			//next to push, written by the producer
+	std::atomic<uint32_t>					m_dropped;		//by the producer, next to m_tail
+};
+
+//A message's time in clock ticks: now less how long ago it was queued by its millisecond stamp. Both millisecond
+//counts are the 32 bit tick count (GetMessageTime, GetTickCount) and wrap. An age over maxAge ticks, or one that
+//would go back before notBefore, is clamped so events stay in order.
+int64_t BackdateTicks(int64_t now, uint32_t nowMs, uint32_t eventMs, int64_t ticksPerSecond, int64_t maxAge, int64_t notBefore);
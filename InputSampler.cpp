@@ -0,0 +1,92 @@
+// Window input messages to timestamped events
+#include "pch.h"
+#include "InputSampler.h"
+
+namespace
+{
+	//a message older than this by its stamp is taken as this old, its stamp is off
+	constexpr int64_t c_MaxMessageAgeMs = 100;
+}
+
+InputSampler::InputSampler() :
+	m_lastTime(0)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	m_ticksPerSecond = frequency.QuadPart;
+}
+
+int64_t InputSampler::GetTime()
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+void InputSampler::ProcessMessage(UINT message, WPARAM wParam, LPARAM lParam)
+{
+	switch (message)
+	{
+	case WM_INPUT:
+	{
+		RAWINPUT raw;
+		UINT size = sizeof(raw);
+		if (GetRawInputData(reinterpret_cast<HRAWINPUT>(lParam), RID_INPUT, &raw, &size, sizeof(RAWINPUTHEADER)) != UINT(-1)
+			&& raw.header.dwType == RIM_TYPEMOUSE && !(raw.data.mouse.usFlags & MOUSE_MOVE_ABSOLUTE)
+			&& (raw.data.mouse.lLastX || raw.data.mouse.lLastY))
+		{
+			Push(InputEventType::MouseMove, false, 0, raw.data.mouse.lLastX, raw.data.mouse.lLastY);
+		}
+		break;
+	}
+
+	case WM_MOUSEMOVE:
+		Push(InputEventType::Cursor, false, 0, static_cast<short>(LOWORD(lParam)), static_cast<short>(HIWORD(lParam)));
+		break;
+
+	case WM_LBUTTONDOWN:
+	case WM_LBUTTONUP:
+		Push(InputEventType::Button, message == WM_LBUTTONDOWN, 0, 0, 0);
+		break;
+
+	case WM_RBUTTONDOWN:
+	case WM_RBUTTONUP:
+		Push(InputEventType::Button, message == WM_RBUTTONDOWN, 1, 0, 0);
+		break;
+
+	case WM_MBUTTONDOWN:
+	case WM_MBUTTONUP:
+		Push(InputEventType::Button, message == WM_MBUTTONDOWN, 2, 0, 0);
+		break;
+
+	case WM_XBUTTONDOWN:
+	case WM_XBUTTONUP:
+		Push(InputEventType::Button, message == WM_XBUTTONDOWN, GET_XBUTTON_WPARAM(wParam) == XBUTTON2 ? 4 : 3, 0, 0);
+		break;
+
+	case WM_KEYDOWN:
+	case WM_SYSKEYDOWN:
+	case WM_KEYUP:
+	case WM_SYSKEYUP:
+		Push(InputEventType::Key, message == WM_KEYDOWN || message == WM_SYSKEYDOWN, static_cast<uint32_t>(wParam & 0xff), 0, 0);
+		break;
+
+	case WM_ACTIVATEAPP:
+		Push(InputEventType::Focus, wParam != 0, 0, 0, 0);
+		break;
+	}
+}
+
+void InputSampler::Push(InputEventType type, bool down, uint32_t code, int32_t x, int32_t y)
+{
+	InputEvent event;
+	event.time = BackdateTicks(GetTime(), GetTickCount(), static_cast<uint32_t>(GetMessageTime()), m_ticksPerSecond,
+		c_MaxMessageAgeMs * m_ticksPerSecond / 1000, m_lastTime);
+	event.type = type;
+	event.down = down;
+	event.code = static_cast<uint16_t>(code);
+	event.x = x;
+	event.y = y;
+	m_lastTime = event.time;
+	m_queue.Push(event);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "InputQueue.h"
+
+//Turns the window's input messages into InputEvents on the message thread and queues them for Update, see
+//InputQueue.h. Each is stamped with when Windows queued it (GetMessageTime) carried over to QueryPerformanceCounter
+//ticks, so events pumped together between two frames keep the times they happened. Mouse motion is the raw input
+//DirectXTK's Mouse registers for, key and button changes and the cursor come from the ordinary messages.
+class InputSampler
+{
+public:
+	InputSampler();
+
+	InputSampler(InputSampler const&) = delete;
+	InputSampler& operator= (InputSampler const&) = delete;
+
+	void ProcessMessage(UINT message, WPARAM wParam, LPARAM lParam);
+
+	InputQueue& GetQueue() { return m_queue; }
+	int64_t GetTicksPerSecond() const { return m_ticksPerSecond; }
+	static int64_t GetTime();
+
+private:
+	void Push(InputEventType type, bool down, uint32_t code, int32_t x, int32_t y);
+
+	InputQueue	m_queue;
+	int64_t		m_ticksPerSecond;
+	int64_t		m_lastTime;			//events are never stamped before the one pushed last
+};
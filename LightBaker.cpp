@@ -0,0 +1,827 @@
+// Chart unwrapping, packing and the ray traced bake
+#include "LightBaker.h"
+#include "Bvh.h"
+#include "DDSFile.h"
+#include "Half.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+	constexpr float c_Pi = 3.14159265358979f;
+
+	inline float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	inline void Cross(const float a[3], const float b[3], float out[3])
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	inline void Normalize(float v[3])
+	{
+		float length = std::sqrt(Dot(v, v));
+		if (length > 0.0f)
+		{
+			v[0] /= length;
+			v[1] /= length;
+			v[2] /= length;
+		}
+	}
+
+	// Row vector transform, SimpleMath layout
+	void TransformPoint(const float m[16], const float p[3], float out[3])
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			out[k] = p[0] * m[k] + p[1] * m[4 + k] + p[2] * m[8 + k] + m[12 + k];
+		}
+	}
+
+	// Normals go through the cofactor matrix (the inverse transpose without the divide), so scaled boxes stay right
+	void TransformNormal(const float m[16], const float n[3], float out[3])
+	{
+		const float rows[3][3] = { { m[0], m[1], m[2] }, { m[4], m[5], m[6] }, { m[8], m[9], m[10] } };
+		float cofactor[3][3];
+		Cross(rows[1], rows[2], cofactor[0]);
+		Cross(rows[2], rows[0], cofactor[1]);
+		Cross(rows[0], rows[1], cofactor[2]);
+		float sign = Dot(rows[0], cofactor[0]) < 0.0f ? -1.0f : 1.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			out[k] = sign * (n[0] * cofactor[0][k] + n[1] * cofactor[1][k] + n[2] * cofactor[2][k]);
+		}
+		Normalize(out);
+	}
+
+	uint32_t FindRoot(std::vector<uint32_t>& parents, uint32_t i)
+	{
+		while (parents[i] != i)
+		{
+			parents[i] = parents[parents[i]];
+			i = parents[i];
+		}
+		return i;
+	}
+
+	struct Chart
+	{
+		uint32_t				mesh;
+		std::vector<uint32_t>	vertices;
+		float					axisU[3];
+		float					axisV[3];
+		float					minU, minV, maxU, maxV;
+		uint32_t				x, y, width, height;
+	};
+
+	// Shelf packing, tallest charts first. False if they run off the bottom.
+	bool PackCharts(std::vector<Chart>& charts, uint32_t size, float texelsPerUnit, uint32_t padding)
+	{
+		for (Chart& chart : charts)
+		{
+			chart.width = static_cast<uint32_t>(std::ceil((chart.maxU - chart.minU) * texelsPerUnit)) + 1 + padding * 2;
+			chart.height = static_cast<uint32_t>(std::ceil((chart.maxV - chart.minV) * texelsPerUnit)) + 1 + padding * 2;
+			if (chart.width > size || chart.height > size)
+			{
+				return false;
+			}
+		}
+
+		std::vector<uint32_t> order(charts.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::sort(order.begin(), order.end(), [&charts](uint32_t a, uint32_t b)
+		{
+			return charts[a].height != charts[b].height ? charts[a].height > charts[b].height : a < b;
+		});
+
+		uint32_t x = 0, y = 0, shelfHeight = 0;
+		for (uint32_t index : order)
+		{
+			Chart& chart = charts[index];
+			if (x + chart.width > size)
+			{
+				x = 0;
+				y += shelfHeight;
+				shelfHeight = 0;
+			}
+			if (y + chart.height > size)
+			{
+				return false;
+			}
+			chart.x = x;
+			chart.y = y;
+			x += chart.width;
+			shelfHeight = std::max(shelfHeight, chart.height);
+		}
+		return true;
+	}
+
+	// Small per texel generator, seeded from the texel so a bake is the same however it is split across threads
+	struct Random
+	{
+		uint32_t state;
+
+		explicit Random(uint32_t seed) : state(seed * 747796405u + 2891336453u) {}
+
+		float Next()
+		{
+			uint32_t s = state;
+			state = state * 747796405u + 2891336453u;
+			uint32_t word = ((s >> ((s >> 28u) + 4u)) ^ s) * 277803737u;
+			word = (word >> 22u) ^ word;
+			return float(word >> 8) * (1.0f / 16777216.0f);
+		}
+	};
+
+	// Cosine weighted direction around normal
+	void SampleHemisphere(const float normal[3], float r1, float r2, float out[3])
+	{
+		float tangent[3], bitangent[3];
+		const float up[3] = { 0.0f, 1.0f, 0.0f };
+		const float side[3] = { 1.0f, 0.0f, 0.0f };
+		Cross(std::fabs(normal[1]) < 0.99f ? up : side, normal, tangent);
+		Normalize(tangent);
+		Cross(normal, tangent, bitangent);
+
+		float radius = std::sqrt(r1);
+		float angle = 2.0f * c_Pi * r2;
+		float x = radius * std::cos(angle);
+		float y = radius * std::sin(angle);
+		float z = std::sqrt(std::max(0.0f, 1.0f - r1));
+		for (int k = 0; k < 3; ++k)
+		{
+			out[k] = tangent[k] * x + bitangent[k] * y + normal[k] * z;
+		}
+	}
+
+	// One texel of the atlas covered by the scene, in world space
+	struct Sample
+	{
+		float		position[3];
+		float		normal[3];
+		uint32_t	texel;
+		uint32_t	mesh;
+	};
+
+	// The whole scene in world space, one vertex array so Bvh triangle ids index straight into it
+	struct BakeGeometry
+	{
+		std::vector<float>		positions;
+		std::vector<float>		normals;
+		std::vector<float>		uvs;			//in texels
+		std::vector<uint32_t>	indices;
+		std::vector<uint32_t>	triangleMesh;
+		uint32_t				size = 0;
+		Bvh						bvh;
+
+		bool Build(const LightmapScene& scene)
+		{
+			size = scene.atlasSize;
+			for (uint32_t m = 0; m < scene.meshes.size(); ++m)
+			{
+				const LightmapMesh& mesh = scene.meshes[m];
+				size_t vertexCount = mesh.GetVertexCount();
+				if (mesh.lightmapUVs.size() != vertexCount * 2 || mesh.normals.size() != vertexCount * 3)
+				{
+					return false;
+				}
+
+				uint32_t base = static_cast<uint32_t>(positions.size() / 3);
+				for (size_t v = 0; v < vertexCount; ++v)
+				{
+					float p[3], n[3];
+					TransformPoint(mesh.world, &mesh.positions[v * 3], p);
+					TransformNormal(mesh.world, &mesh.normals[v * 3], n);
+					positions.insert(positions.end(), p, p + 3);
+					normals.insert(normals.end(), n, n + 3);
+					uvs.push_back(mesh.lightmapUVs[v * 2 + 0] * float(size));
+					uvs.push_back(mesh.lightmapUVs[v * 2 + 1] * float(size));
+				}
+				for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+				{
+					if (mesh.indices[i] >= vertexCount || mesh.indices[i + 1] >= vertexCount || mesh.indices[i + 2] >= vertexCount)
+					{
+						continue;
+					}
+					for (int c = 0; c < 3; ++c)
+					{
+						indices.push_back(base + mesh.indices[i + c]);
+					}
+					triangleMesh.push_back(m);
+				}
+			}
+
+			bvh.Build(positions.data(), positions.size() / 3, indices.data(), indices.size() / 3);
+			return true;
+		}
+
+		// Atlas texel under a hit. Backs of faces are inside walls, false for those so callers treat them as black
+		// rather than leaking light through.
+		bool HitTexel(const BvhRay& ray, const BvhHit& hit, size_t& texel) const
+		{
+			const uint32_t* tri = &indices[hit.triangle * 3];
+			float e1[3], e2[3], faceNormal[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				e1[k] = positions[tri[1] * 3 + k] - positions[tri[0] * 3 + k];
+				e2[k] = positions[tri[2] * 3 + k] - positions[tri[0] * 3 + k];
+			}
+			Cross(e1, e2, faceNormal);
+			float hitNormal[3];
+			float w = 1.0f - hit.u - hit.v;
+			for (int k = 0; k < 3; ++k)
+			{
+				hitNormal[k] = normals[tri[0] * 3 + k] * w + normals[tri[1] * 3 + k] * hit.u + normals[tri[2] * 3 + k] * hit.v;
+			}
+			if (Dot(faceNormal, hitNormal) < 0.0f)
+			{
+				faceNormal[0] = -faceNormal[0];
+				faceNormal[1] = -faceNormal[1];
+				faceNormal[2] = -faceNormal[2];
+			}
+			if (Dot(faceNormal, ray.direction) >= 0.0f)
+			{
+				return false;
+			}
+
+			float u = uvs[tri[0] * 2 + 0] * w + uvs[tri[1] * 2 + 0] * hit.u + uvs[tri[2] * 2 + 0] * hit.v;
+			float v = uvs[tri[0] * 2 + 1] * w + uvs[tri[1] * 2 + 1] * hit.u + uvs[tri[2] * 2 + 1] * hit.v;
+			uint32_t x = std::min(size - 1, uint32_t(std::max(u, 0.0f)));
+			uint32_t y = std::min(size - 1, uint32_t(std::max(v, 0.0f)));
+			texel = size_t(y) * size + x;
+			return true;
+		}
+	};
+}
+
+LightBaker::LightBaker(ThreadPool * pool) :
+	m_pool(pool),
+	m_stats{}
+{
+}
+
+bool LightBaker::Unwrap(LightmapScene & scene, const LightBakeSettings & settings)
+{
+	m_stats = LightBakeStats();
+	std::vector<Chart> charts;
+	float totalArea = 0.0f;
+
+	for (uint32_t m = 0; m < scene.meshes.size(); ++m)
+	{
+		const LightmapMesh& mesh = scene.meshes[m];
+		size_t vertexCount = mesh.GetVertexCount();
+		size_t triangleCount = mesh.indices.size() / 3;
+
+		std::vector<float> world(vertexCount * 3);
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			TransformPoint(mesh.world, &mesh.positions[v * 3], &world[v * 3]);
+		}
+
+		// Triangles sharing a vertex end up in the same chart, so the mesh's own seams become chart edges
+		std::vector<uint32_t> parents(vertexCount);
+		std::iota(parents.begin(), parents.end(), 0u);
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			const uint32_t* tri = &mesh.indices[t * 3];
+			if (tri[0] < vertexCount && tri[1] < vertexCount && tri[2] < vertexCount)
+			{
+				parents[FindRoot(parents, tri[1])] = FindRoot(parents, tri[0]);
+				parents[FindRoot(parents, tri[2])] = FindRoot(parents, tri[0]);
+			}
+		}
+
+		std::vector<uint32_t> chartOfRoot(vertexCount, UINT32_MAX);
+		size_t firstChart = charts.size();
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			uint32_t root = FindRoot(parents, v);
+			if (chartOfRoot[root] == UINT32_MAX)
+			{
+				chartOfRoot[root] = static_cast<uint32_t>(charts.size());
+				Chart chart = {};
+				chart.mesh = m;
+				charts.push_back(chart);
+			}
+			charts[chartOfRoot[root]].vertices.push_back(v);
+		}
+
+		// Area weighted normal of each chart, and how far its faces stray from it
+		std::vector<float> chartNormals((charts.size() - firstChart) * 3, 0.0f);
+		std::vector<std::vector<uint32_t>> chartTriangles(charts.size() - firstChart);
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			const uint32_t* tri = &mesh.indices[t * 3];
+			if (tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount)
+			{
+				continue;
+			}
+			const float* p0 = &world[tri[0] * 3];
+			const float* p1 = &world[tri[1] * 3];
+			const float* p2 = &world[tri[2] * 3];
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3];
+			Cross(e1, e2, n);
+			size_t local = chartOfRoot[FindRoot(parents, tri[0])] - firstChart;
+			for (int k = 0; k < 3; ++k)
+			{
+				chartNormals[local * 3 + k] += n[k];
+			}
+			chartTriangles[local].push_back(static_cast<uint32_t>(t));
+		}
+
+		for (size_t local = 0; local < chartTriangles.size(); ++local)
+		{
+			Chart& chart = charts[firstChart + local];
+			float* normal = &chartNormals[local * 3];
+			Normalize(normal);
+
+			const float up[3] = { 0.0f, 1.0f, 0.0f };
+			const float side[3] = { 1.0f, 0.0f, 0.0f };
+			Cross(std::fabs(normal[1]) < 0.99f ? up : side, normal, chart.axisU);
+			Normalize(chart.axisU);
+			Cross(normal, chart.axisU, chart.axisV);
+
+			chart.minU = chart.minV = 3.4e38f;
+			chart.maxU = chart.maxV = -3.4e38f;
+			for (uint32_t v : chart.vertices)
+			{
+				float u = Dot(chart.axisU, &world[v * 3]);
+				float w = Dot(chart.axisV, &world[v * 3]);
+				chart.minU = std::min(chart.minU, u);
+				chart.maxU = std::max(chart.maxU, u);
+				chart.minV = std::min(chart.minV, w);
+				chart.maxV = std::max(chart.maxV, w);
+			}
+			totalArea += (chart.maxU - chart.minU) * (chart.maxV - chart.minV);
+
+			for (uint32_t t : chartTriangles[local])
+			{
+				const uint32_t* tri = &mesh.indices[t * 3];
+				float e1[3], e2[3], n[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					e1[k] = world[tri[1] * 3 + k] - world[tri[0] * 3 + k];
+					e2[k] = world[tri[2] * 3 + k] - world[tri[0] * 3 + k];
+				}
+				Cross(e1, e2, n);
+				Normalize(n);
+				if (Dot(n, normal) < 0.7f)
+				{
+					++m_stats.nonPlanarCharts;
+					break;
+				}
+			}
+		}
+	}
+
+	if (charts.empty())
+	{
+		return false;
+	}
+
+	// Start from the density that would fill most of the atlas and back off until the shelves fit
+	uint32_t size = settings.atlasSize;
+	float texelsPerUnit = settings.texelsPerUnit;
+	bool packed = false;
+	if (texelsPerUnit > 0.0f)
+	{
+		packed = PackCharts(charts, size, texelsPerUnit, settings.padding);
+	}
+	else
+	{
+		texelsPerUnit = std::sqrt(0.8f * float(size) * float(size) / std::max(totalArea, 1e-6f));
+		for (int attempt = 0; attempt < 64 && !packed; ++attempt)
+		{
+			packed = PackCharts(charts, size, texelsPerUnit, settings.padding);
+			if (!packed)
+			{
+				texelsPerUnit *= 0.92f;
+			}
+		}
+	}
+	if (!packed)
+	{
+		return false;
+	}
+
+	for (LightmapMesh& mesh : scene.meshes)
+	{
+		mesh.lightmapUVs.assign(mesh.GetVertexCount() * 2, 0.0f);
+	}
+	for (const Chart& chart : charts)
+	{
+		LightmapMesh& mesh = scene.meshes[chart.mesh];
+		for (uint32_t v : chart.vertices)
+		{
+			float p[3];
+			TransformPoint(mesh.world, &mesh.positions[v * 3], p);
+			float u = float(chart.x + settings.padding) + 0.5f + (Dot(chart.axisU, p) - chart.minU) * texelsPerUnit;
+			float w = float(chart.y + settings.padding) + 0.5f + (Dot(chart.axisV, p) - chart.minV) * texelsPerUnit;
+			mesh.lightmapUVs[v * 2 + 0] = u / float(size);
+			mesh.lightmapUVs[v * 2 + 1] = w / float(size);
+		}
+	}
+
+	scene.atlasSize = size;
+	m_stats.charts = static_cast<uint32_t>(charts.size());
+	m_stats.texelsPerUnit = texelsPerUnit;
+	return true;
+}
+
+bool LightBaker::Bake(const LightmapScene & scene, const LightBakeSettings & settings, std::vector<float>& texels)
+{
+	auto start = std::chrono::steady_clock::now();
+	const uint32_t size = scene.atlasSize;
+	if (!size)
+	{
+		return false;
+	}
+
+	BakeGeometry geometry;
+	if (!geometry.Build(scene))
+	{
+		return false;
+	}
+	const std::vector<float>& positions = geometry.positions;
+	const std::vector<float>& normals = geometry.normals;
+	const std::vector<uint32_t>& indices = geometry.indices;
+	const std::vector<uint32_t>& triangleMesh = geometry.triangleMesh;
+	const Bvh& bvh = geometry.bvh;
+	const std::vector<float>& uvs = geometry.uvs;
+
+	// Rasterise every triangle in atlas space, texel centres inside it become samples
+	const size_t texelCount = size_t(size) * size;
+	std::vector<uint8_t> coverage(texelCount, 0);
+	std::vector<Sample> samples;
+	auto addSample = [&](uint32_t triangle, uint32_t x, uint32_t y, float b0, float b1, float b2)
+	{
+		uint32_t texel = y * size + x;
+		if (coverage[texel])
+		{
+			return;
+		}
+		coverage[texel] = 1;
+
+		const uint32_t* tri = &indices[triangle * 3];
+		Sample sample;
+		for (int k = 0; k < 3; ++k)
+		{
+			sample.position[k] = positions[tri[0] * 3 + k] * b0 + positions[tri[1] * 3 + k] * b1 + positions[tri[2] * 3 + k] * b2;
+			sample.normal[k] = normals[tri[0] * 3 + k] * b0 + normals[tri[1] * 3 + k] * b1 + normals[tri[2] * 3 + k] * b2;
+		}
+		Normalize(sample.normal);
+		sample.texel = texel;
+		sample.mesh = triangleMesh[triangle];
+		samples.push_back(sample);
+	};
+
+	for (uint32_t t = 0; t < triangleMesh.size(); ++t)
+	{
+		const float* uv0 = &uvs[indices[t * 3 + 0] * 2];
+		const float* uv1 = &uvs[indices[t * 3 + 1] * 2];
+		const float* uv2 = &uvs[indices[t * 3 + 2] * 2];
+		float area = (uv1[0] - uv0[0]) * (uv2[1] - uv0[1]) - (uv2[0] - uv0[0]) * (uv1[1] - uv0[1]);
+		if (std::fabs(area) < 1e-12f)
+		{
+			continue;
+		}
+
+		int x0 = std::max(0, int(std::floor(std::min({ uv0[0], uv1[0], uv2[0] }))));
+		int y0 = std::max(0, int(std::floor(std::min({ uv0[1], uv1[1], uv2[1] }))));
+		int x1 = std::min(int(size) - 1, int(std::ceil(std::max({ uv0[0], uv1[0], uv2[0] }))));
+		int y1 = std::min(int(size) - 1, int(std::ceil(std::max({ uv0[1], uv1[1], uv2[1] }))));
+		bool covered = false;
+		for (int y = y0; y <= y1; ++y)
+		{
+			for (int x = x0; x <= x1; ++x)
+			{
+				float px = float(x) + 0.5f, py = float(y) + 0.5f;
+				float b1 = ((px - uv0[0]) * (uv2[1] - uv0[1]) - (uv2[0] - uv0[0]) * (py - uv0[1])) / area;
+				float b2 = ((uv1[0] - uv0[0]) * (py - uv0[1]) - (px - uv0[0]) * (uv1[1] - uv0[1])) / area;
+				float b0 = 1.0f - b1 - b2;
+				if (b0 >= -1e-4f && b1 >= -1e-4f && b2 >= -1e-4f)
+				{
+					addSample(t, uint32_t(x), uint32_t(y), b0, b1, b2);
+					covered = true;
+				}
+			}
+		}
+
+		// Slivers thinner than a texel (the edges of the walls) still get the texel under their centre
+		if (!covered)
+		{
+			float cx = (uv0[0] + uv1[0] + uv2[0]) / 3.0f;
+			float cy = (uv0[1] + uv1[1] + uv2[1]) / 3.0f;
+			uint32_t x = uint32_t(std::min(std::max(cx, 0.0f), float(size - 1)));
+			uint32_t y = uint32_t(std::min(std::max(cy, 0.0f), float(size - 1)));
+			addSample(t, x, y, 1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f);
+		}
+	}
+
+	std::atomic<uint64_t> rays(0);
+	const float offset = settings.rayOffset;
+	const LightmapLight& light = scene.light;
+
+	// Direct: N.L towards the main light, zero where something static is in the way
+	std::vector<float> direct(samples.size(), 0.0f);
+	ThreadPool::For(m_pool, samples.size(), 256, [&](size_t begin, size_t end)
+	{
+		uint64_t localRays = 0;
+		for (size_t i = begin; i < end; ++i)
+		{
+			const Sample& sample = samples[i];
+			float toLight[3] = { light.position[0] - sample.position[0], light.position[1] - sample.position[1], light.position[2] - sample.position[2] };
+			float distance = std::sqrt(Dot(toLight, toLight));
+			if (distance <= offset)
+			{
+				continue;
+			}
+			float lightDir[3] = { toLight[0] / distance, toLight[1] / distance, toLight[2] / distance };
+			float nDotL = Dot(sample.normal, lightDir);
+			if (nDotL <= 0.0f)
+			{
+				continue;
+			}
+
+			BvhRay ray;
+			for (int k = 0; k < 3; ++k)
+			{
+				ray.origin[k] = sample.position[k] + sample.normal[k] * offset;
+				ray.direction[k] = lightDir[k];
+			}
+			ray.tMax = distance - offset;
+			++localRays;
+			if (!bvh.Occluded(ray))
+			{
+				direct[i] = std::min(nDotL, 1.0f);
+			}
+		}
+		rays += localRays;
+	});
+
+	// Light leaving each texel towards the next bounce, dilated so lookups near chart edges land on something
+	std::vector<float> indirect(samples.size() * 3, 0.0f);
+	std::vector<float> exitant(texelCount * 4, 0.0f);
+	auto updateExitant = [&]()
+	{
+		std::fill(exitant.begin(), exitant.end(), 0.0f);
+		for (size_t i = 0; i < samples.size(); ++i)
+		{
+			const float* albedo = scene.meshes[samples[i].mesh].albedo;
+			float* out = &exitant[size_t(samples[i].texel) * 4];
+			for (int k = 0; k < 3; ++k)
+			{
+				out[k] = albedo[k] * (direct[i] * light.diffuse[k] + indirect[i * 3 + k]);
+			}
+		}
+		std::vector<uint8_t> exitantCoverage = coverage;
+		Dilate(exitant.data(), exitantCoverage, size, settings.padding);
+	};
+
+	for (uint32_t bounce = 0; bounce < settings.bounces && settings.samples; ++bounce)
+	{
+		updateExitant();
+
+		// Cosine weighted gather, so the mean of what the rays see is the incoming light in light_ps's units
+		std::vector<float> gathered(samples.size() * 3, 0.0f);
+		ThreadPool::For(m_pool, samples.size(), 64, [&](size_t begin, size_t end)
+		{
+			uint64_t localRays = 0;
+			for (size_t i = begin; i < end; ++i)
+			{
+				const Sample& sample = samples[i];
+				Random random(settings.seed * 0x9e3779b9u ^ (sample.texel * 2654435761u) ^ (bounce * 40503u));
+				float sum[3] = { 0.0f, 0.0f, 0.0f };
+
+				for (uint32_t s = 0; s < settings.samples; ++s)
+				{
+					BvhRay ray;
+					float r1 = random.Next();
+					float r2 = random.Next();
+					SampleHemisphere(sample.normal, r1, r2, ray.direction);
+					for (int k = 0; k < 3; ++k)
+					{
+						ray.origin[k] = sample.position[k] + sample.normal[k] * offset;
+					}
+					ray.tMax = 1e30f;
+					++localRays;
+
+					BvhHit hit;
+					if (!bvh.Intersect(ray, hit))
+					{
+						continue;
+					}
+
+					size_t texel;
+					if (!geometry.HitTexel(ray, hit, texel))
+					{
+						continue;
+					}
+					const float* radiance = &exitant[texel * 4];
+					sum[0] += radiance[0];
+					sum[1] += radiance[1];
+					sum[2] += radiance[2];
+				}
+
+				for (int k = 0; k < 3; ++k)
+				{
+					gathered[i * 3 + k] = sum[k] / float(settings.samples);
+				}
+			}
+			rays += localRays;
+		});
+		indirect.swap(gathered);
+	}
+
+	texels.assign(texelCount * 4, 0.0f);
+	for (size_t i = 0; i < samples.size(); ++i)
+	{
+		float* out = &texels[size_t(samples[i].texel) * 4];
+		out[0] = indirect[i * 3 + 0];
+		out[1] = indirect[i * 3 + 1];
+		out[2] = indirect[i * 3 + 2];
+		out[3] = direct[i];
+	}
+	Dilate(texels.data(), coverage, size, settings.padding);
+
+	m_stats.texels = static_cast<uint32_t>(samples.size());
+	m_stats.rays = rays;
+	m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+bool LightBaker::BakeProbes(const LightmapScene & scene, const LightBakeSettings & settings, const std::vector<float>& texels, LightProbeGrid & probes)
+{
+	auto start = std::chrono::steady_clock::now();
+	const uint32_t size = scene.atlasSize;
+	probes.Clear();
+	if (!size || texels.size() != size_t(size) * size * 4 || settings.probeSpacing <= 0.0f || !settings.probeSamples)
+	{
+		return false;
+	}
+
+	BakeGeometry geometry;
+	if (!geometry.Build(scene) || geometry.bvh.Empty())
+	{
+		return false;
+	}
+
+	// Grid over the static scene, stretched on any axis that would need more than c_MaxProbes a side
+	constexpr uint32_t c_MaxProbes = 64;
+	float boundsMin[3], boundsMax[3], spacing[3];
+	uint32_t counts[3];
+	geometry.bvh.GetBounds(boundsMin, boundsMax);
+	for (int k = 0; k < 3; ++k)
+	{
+		float extent = boundsMax[k] - boundsMin[k];
+		counts[k] = std::min(c_MaxProbes, static_cast<uint32_t>(std::ceil(extent / settings.probeSpacing)) + 1);
+		spacing[k] = counts[k] > 1 ? extent / float(counts[k] - 1) : settings.probeSpacing;
+	}
+	probes.Resize(boundsMin, spacing, counts);
+	probes.sourceHash = scene.GetSourceHash();
+
+	// The same evenly spread directions for every probe (a spherical Fibonacci set), so neighbours differ only by
+	// what they see and not by noise
+	const uint32_t rayCount = settings.probeSamples;
+	std::vector<float> directions(size_t(rayCount) * 3);
+	const float goldenAngle = c_Pi * (3.0f - std::sqrt(5.0f));
+	for (uint32_t i = 0; i < rayCount; ++i)
+	{
+		float z = 1.0f - (2.0f * float(i) + 1.0f) / float(rayCount);
+		float radius = std::sqrt(std::max(0.0f, 1.0f - z * z));
+		float angle = goldenAngle * float(i);
+		directions[i * 3 + 0] = radius * std::cos(angle);
+		directions[i * 3 + 1] = radius * std::sin(angle);
+		directions[i * 3 + 2] = z;
+	}
+
+	std::atomic<uint64_t> rays(0);
+	std::atomic<uint32_t> valid(0);
+	const LightmapLight& light = scene.light;
+	const float weight = 4.0f * c_Pi / float(rayCount);
+	ThreadPool::For(m_pool, probes.GetProbeCount(), 16, [&](size_t begin, size_t end)
+	{
+		for (size_t p = begin; p < end; ++p)
+		{
+			BvhRay ray;
+			probes.GetProbePosition(static_cast<uint32_t>(p), ray.origin);
+
+			ShRadiance radiance;
+			uint32_t backFaces = 0;
+			for (uint32_t i = 0; i < rayCount; ++i)
+			{
+				ray.direction[0] = directions[i * 3 + 0];
+				ray.direction[1] = directions[i * 3 + 1];
+				ray.direction[2] = directions[i * 3 + 2];
+				ray.tMax = 1e30f;
+
+				BvhHit hit;
+				size_t texel;
+				if (!geometry.bvh.Intersect(ray, hit))
+				{
+					continue;
+				}
+				if (!geometry.HitTexel(ray, hit, texel))
+				{
+					++backFaces;
+					continue;
+				}
+
+				// Light leaving the surface, as the bounces in Bake see it
+				const float* albedo = scene.meshes[geometry.triangleMesh[hit.triangle]].albedo;
+				const float* baked = &texels[texel * 4];
+				float exitant[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					exitant[k] = albedo[k] * (baked[3] * light.diffuse[k] + baked[k]);
+				}
+				radiance.Add(ray.direction, exitant, weight);
+			}
+
+			// A probe that sees mostly the insides of walls would darken everything blended with it
+			bool inside = backFaces * 4 > rayCount;
+			probes.SetProbe(static_cast<uint32_t>(p), ShProbe::FromRadiance(radiance), !inside);
+			if (!inside)
+			{
+				++valid;
+			}
+		}
+		rays += uint64_t(end - begin) * rayCount;
+	});
+
+	m_stats.probes = probes.GetProbeCount();
+	m_stats.validProbes = valid;
+	m_stats.rays += rays;
+	m_stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+void LightBaker::Dilate(float * texels, std::vector<uint8_t>& coverage, uint32_t size, uint32_t passes)
+{
+	std::vector<uint8_t> next;
+	for (uint32_t pass = 0; pass < passes; ++pass)
+	{
+		next = coverage;
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				size_t texel = size_t(y) * size + x;
+				if (coverage[texel])
+				{
+					continue;
+				}
+
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				int count = 0;
+				for (int dy = -1; dy <= 1; ++dy)
+				{
+					for (int dx = -1; dx <= 1; ++dx)
+					{
+						int nx = int(x) + dx, ny = int(y) + dy;
+						if (nx < 0 || ny < 0 || nx >= int(size) || ny >= int(size) || !coverage[size_t(ny) * size + nx])
+						{
+							continue;
+						}
+						const float* source = &texels[(size_t(ny) * size + nx) * 4];
+						for (int k = 0; k < 4; ++k)
+						{
+							sum[k] += source[k];
+						}
+						++count;
+					}
+				}
+				if (count)
+				{
+					for (int k = 0; k < 4; ++k)
+					{
+						texels[texel * 4 + k] = sum[k] / float(count);
+					}
+					next[texel] = 1;
+				}
+			}
+		}
+		coverage.swap(next);
+	}
+}
+
+bool LightBaker::WriteAtlas(const std::string & path, const float * texels, uint32_t size)
+{
+	std::vector<uint16_t> halves(size_t(size) * size * 4);
+	for (size_t i = 0; i < halves.size(); ++i)
+	{
+		halves[i] = Half::FromFloat(texels[i]);
+	}
+	return DDS::Write(path, size, size, 1, DDS::FormatR16G16B16A16Float, halves.data(), halves.size() * sizeof(uint16_t));
+}
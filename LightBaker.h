@@ -0,0 +1,75 @@
+//
+// LightBaker.h - Offline lightmaps for the static scene
+//
+// Unwrap gives every static mesh its own charts in one atlas: triangles joined by shared vertices form a chart,
+// which is projected onto its average plane and shelf packed. Bake then ray traces the main light and its bounces
+// against a Bvh of the scene on the ThreadPool. BakeProbes then lights a grid of SH probes from the finished atlas
+// for the objects that have no lightmap. No GPU is involved, BakeLightmaps runs it from the command line.
+//
+
+#pragma once
+
+#include "LightmapScene.h"
+#include "LightProbes.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+struct LightBakeSettings
+{
+	uint32_t	atlasSize = 1024;
+	uint32_t	padding = 2;			//texels around each chart, filled by Dilate so filtering doesn't pick up other charts
+	float		texelsPerUnit = 0.0f;	//0 picks the highest density that fits the atlas
+	uint32_t	bounces = 2;
+	uint32_t	samples = 64;			//hemisphere rays per texel per bounce
+	float		rayOffset = 0.002f;		//start rays this far off the surface
+	uint32_t	seed = 1;
+	float		probeSpacing = 2.0f;	//world units between probes, 0 for no probes
+	uint32_t	probeSamples = 512;		//rays per probe, spread evenly over the sphere
+};
+
+struct LightBakeStats
+{
+	uint32_t	charts;
+	uint32_t	nonPlanarCharts;		//charts bent enough that the planar projection overlaps itself
+	uint32_t	texels;					//texels covered by geometry
+	float		texelsPerUnit;
+	uint32_t	probes;
+	uint32_t	validProbes;			//probes not buried in the walls
+	uint64_t	rays;
+	double		seconds;				//time spent in Bake and BakeProbes
+
+	double GetRaysPerSecond() const { return seconds > 0.0 ? double(rays) / seconds : 0.0; }
+};
+
+class LightBaker
+{
+public:
+	explicit LightBaker(ThreadPool* pool = nullptr);
+
+	//Fills lightmapUVs of every mesh and the scene's atlasSize. False if the charts don't fit.
+	bool Unwrap(LightmapScene& scene, const LightBakeSettings& settings);
+
+	//Four floats per texel: rgb is the bounced light, a the main light's N.L times its visibility. The shader
+	//scales a by the light's diffuse colour so the direct term keeps responding to the light.
+	bool Bake(const LightmapScene& scene, const LightBakeSettings& settings, std::vector<float>& texels);
+
+	//Fills a grid over the scene's bounds with the light reaching each probe from the baked surfaces. The main
+	//light itself isn't included, objects lit by the probes still get it in real time with their shadows.
+	bool BakeProbes(const LightmapScene& scene, const LightBakeSettings& settings, const std::vector<float>& texels, LightProbeGrid& probes);
+
+	const LightBakeStats& GetStats() const { return m_stats; }
+
+	//Grows covered texels into their uncovered neighbours, one texel per pass
+	static void Dilate(float* texels, std::vector<uint8_t>& coverage, uint32_t size, uint32_t passes);
+
+	//Writes the atlas as an RGBA16F DDS
+	static bool WriteAtlas(const std::string& path, const float* texels, uint32_t size);
+
+private:
+	ThreadPool*		m_pool;
+	LightBakeStats	m_stats;
+};
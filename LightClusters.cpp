@@ -0,0 +1,321 @@
+// Clustered light binning: SSE sphere/cluster tests, slices spread across the thread pool
+#include "LightClusters.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <emmintrin.h>
+
+namespace
+{
+	inline __m128 Max0(__m128 v)
+	{
+		return _mm_max_ps(v, _mm_setzero_ps());
+	}
+
+	// Selects a where mask is set, otherwise b (SSE2 has no blendv)
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline uint16_t ClampTile(float value, uint32_t count)
+	{
+		int tile = static_cast<int>(std::floor(value));
+		tile = std::max(0, std::min(static_cast<int>(count) - 1, tile));
+		return static_cast<uint16_t>(tile);
+	}
+}
+
+LightClusters::LightClusters() :
+	m_projScaleX(1.0f),
+	m_projScaleY(1.0f),
+	m_sliceScale(0.0f),
+	m_sliceBias(0.0f),
+	m_rowStride(0),
+	m_overflow(0)
+{
+	SetGrid(ClusterGridDesc(), 1.0f, 1.0f);
+}
+
+void LightClusters::SetGrid(const ClusterGridDesc& desc, float projScaleX, float projScaleY)
+{
+	m_grid = desc;
+	m_projScaleX = projScaleX;
+	m_projScaleY = projScaleY;
+	m_rowStride = (m_grid.tilesX + 3) & ~3u;
+
+	float logRange = std::log(m_grid.farZ / m_grid.nearZ);
+	m_sliceScale = static_cast<float>(m_grid.slices) / logRange;
+	m_sliceBias = -static_cast<float>(m_grid.slices) * std::log(m_grid.nearZ) / logRange;
+
+	size_t rows = size_t(m_grid.tilesY) * m_grid.slices;
+	size_t padded = rows * m_rowStride;
+	m_minX.assign(padded, FLT_MAX); m_minY.assign(padded, FLT_MAX); m_minZ.assign(padded, FLT_MAX);
+	m_maxX.assign(padded, -FLT_MAX); m_maxY.assign(padded, -FLT_MAX); m_maxZ.assign(padded, -FLT_MAX);
+
+	for (uint32_t z = 0; z < m_grid.slices; ++z)
+	{
+		// The first slice reaches back to the eye and the last one to the far plane so nothing falls between
+		float nearDepth = (z == 0) ? 0.0f : m_grid.nearZ * std::pow(m_grid.farZ / m_grid.nearZ, float(z) / m_grid.slices);
+		float farDepth = m_grid.nearZ * std::pow(m_grid.farZ / m_grid.nearZ, float(z + 1) / m_grid.slices);
+
+		for (uint32_t y = 0; y < m_grid.tilesY; ++y)
+		{
+			float top = 1.0f - 2.0f * y / m_grid.tilesY;
+			float bottom = 1.0f - 2.0f * (y + 1) / m_grid.tilesY;
+
+			for (uint32_t x = 0; x < m_grid.tilesX; ++x)
+			{
+				float left = -1.0f + 2.0f * x / m_grid.tilesX;
+				float right = -1.0f + 2.0f * (x + 1) / m_grid.tilesX;
+
+				size_t i = (size_t(z) * m_grid.tilesY + y) * m_rowStride + x;
+				m_minX[i] = std::min(std::min(left * nearDepth, left * farDepth), std::min(right * nearDepth, right * farDepth)) / m_projScaleX;
+				m_maxX[i] = std::max(std::max(left * nearDepth, left * farDepth), std::max(right * nearDepth, right * farDepth)) / m_projScaleX;
+				m_minY[i] = std::min(std::min(bottom * nearDepth, bottom * farDepth), std::min(top * nearDepth, top * farDepth)) / m_projScaleY;
+				m_maxY[i] = std::max(std::max(bottom * nearDepth, bottom * farDepth), std::max(top * nearDepth, top * farDepth)) / m_projScaleY;
+				m_minZ[i] = nearDepth;
+				m_maxZ[i] = farDepth;
+			}
+		}
+	}
+
+	uint32_t clusters = GetClusterCount();
+	m_scratch.resize(size_t(clusters) * c_MaxLightsPerCluster);
+	m_counts.assign(clusters, 0);
+	m_ranges.assign(size_t(clusters) * 2, 0);
+	m_rowTotals.assign(rows, 0);
+	m_rowOverflow.assign(rows, 0);
+	m_sliceLights.assign(m_grid.slices, std::vector<uint32_t>());
+}
+
+void LightClusters::Build(const float view[16], bool rightHanded, const ClusterLight* lights, size_t count, ThreadPool* pool)
+{
+	m_bounds.resize(count);
+
+	// Pass 1: view space bounds and cluster ranges of every light, four lights per SSE iteration
+	ThreadPool::For(pool, count, 256, [&](size_t begin, size_t end)
+	{
+		ComputeBounds(view, rightHanded, lights, begin, end);
+	});
+
+	// Bucket the visible lights by the slices they overlap so a row only walks the lights that can reach it
+	for (auto& bucket : m_sliceLights)
+	{
+		bucket.clear();
+	}
+	for (size_t l = 0; l < count; ++l)
+	{
+		const LightBounds& b = m_bounds[l];
+		if (!b.visible)
+			continue;
+		for (uint32_t z = b.z0; z <= b.z1; ++z)
+		{
+			m_sliceLights[z].push_back(static_cast<uint32_t>(l));
+		}
+	}
+
+	// Pass 2: each (slice, tile row) is owned by a single job so the per cluster lists need no synchronisation
+	uint32_t rows = m_grid.slices * m_grid.tilesY;
+	ThreadPool::For(pool, rows, 4, [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; ++row)
+		{
+			BinRow(static_cast<uint32_t>(row));
+		}
+	});
+
+	// Pass 3: compact the fixed capacity lists into one index list
+	std::vector<uint32_t> rowOffsets(rows);
+	uint32_t total = 0;
+	m_overflow = 0;
+	for (uint32_t row = 0; row < rows; ++row)
+	{
+		rowOffsets[row] = total;
+		total += m_rowTotals[row];
+		m_overflow += m_rowOverflow[row];
+	}
+	m_indices.resize(total);
+
+	ThreadPool::For(pool, rows, 8, [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; ++row)
+		{
+			uint32_t offset = rowOffsets[row];
+			for (uint32_t c = uint32_t(row) * m_grid.tilesX; c < uint32_t(row + 1) * m_grid.tilesX; ++c)
+			{
+				uint32_t n = m_counts[c];
+				m_ranges[c * 2 + 0] = offset;
+				m_ranges[c * 2 + 1] = n;
+				std::copy_n(&m_scratch[size_t(c) * c_MaxLightsPerCluster], n, m_indices.begin() + offset);
+				offset += n;
+			}
+		}
+	});
+}
+
+uint32_t LightClusters::SliceOfDepth(float depth) const
+{
+	if (depth <= m_grid.nearZ)
+		return 0;
+	int slice = static_cast<int>(std::floor(std::log(depth) * m_sliceScale + m_sliceBias));
+	return static_cast<uint32_t>(std::max(0, std::min(static_cast<int>(m_grid.slices) - 1, slice)));
+}
+
+void LightClusters::ComputeBounds(const float view[16], bool rightHanded, const ClusterLight* lights, size_t begin, size_t end)
+{
+	const __m128 m00 = _mm_set1_ps(view[0]), m01 = _mm_set1_ps(view[1]), m02 = _mm_set1_ps(view[2]);
+	const __m128 m10 = _mm_set1_ps(view[4]), m11 = _mm_set1_ps(view[5]), m12 = _mm_set1_ps(view[6]);
+	const __m128 m20 = _mm_set1_ps(view[8]), m21 = _mm_set1_ps(view[9]), m22 = _mm_set1_ps(view[10]);
+	const __m128 m30 = _mm_set1_ps(view[12]), m31 = _mm_set1_ps(view[13]), m32 = _mm_set1_ps(view[14]);
+	const __m128 zSign = _mm_set1_ps(rightHanded ? -1.0f : 1.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 nearZ = _mm_set1_ps(m_grid.nearZ);
+	const __m128 scaleX = _mm_set1_ps(m_projScaleX);
+	const __m128 scaleY = _mm_set1_ps(m_projScaleY);
+
+	for (size_t i = begin; i < end; i += 4)
+	{
+		size_t n = std::min<size_t>(4, end - i);
+
+		// Gather four lights into structure of arrays form, padding the tail with a zero radius light
+		alignas(16) float px[4] = {}, py[4] = {}, pz[4] = {}, pr[4] = {};
+		for (size_t k = 0; k < n; ++k)
+		{
+			px[k] = lights[i + k].position[0];
+			py[k] = lights[i + k].position[1];
+			pz[k] = lights[i + k].position[2];
+			pr[k] = lights[i + k].radius;
+		}
+		__m128 x = _mm_load_ps(px), y = _mm_load_ps(py), z = _mm_load_ps(pz), r = _mm_load_ps(pr);
+
+		__m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_add_ps(_mm_mul_ps(z, m20), m30));
+		__m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_add_ps(_mm_mul_ps(z, m21), m31));
+		__m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_add_ps(_mm_mul_ps(z, m22), m32));
+		vz = _mm_mul_ps(vz, zSign);
+
+		// Depth interval of the sphere, clamped to the near plane for the projection below
+		__m128 zMin = _mm_sub_ps(vz, r);
+		__m128 zMax = _mm_add_ps(vz, r);
+		__m128 dNear = _mm_max_ps(zMin, nearZ);
+		__m128 dFar = _mm_max_ps(zMax, nearZ);
+
+		// Conservative screen extent of the sphere's box: x/d is smallest for negative x at the nearest depth
+		__m128 xLo = _mm_sub_ps(vx, r), xHi = _mm_add_ps(vx, r);
+		__m128 yLo = _mm_sub_ps(vy, r), yHi = _mm_add_ps(vy, r);
+		__m128 ndcXMin = _mm_mul_ps(scaleX, _mm_div_ps(xLo, Select(_mm_cmplt_ps(xLo, zero), dNear, dFar)));
+		__m128 ndcXMax = _mm_mul_ps(scaleX, _mm_div_ps(xHi, Select(_mm_cmpgt_ps(xHi, zero), dNear, dFar)));
+		__m128 ndcYMin = _mm_mul_ps(scaleY, _mm_div_ps(yLo, Select(_mm_cmplt_ps(yLo, zero), dNear, dFar)));
+		__m128 ndcYMax = _mm_mul_ps(scaleY, _mm_div_ps(yHi, Select(_mm_cmpgt_ps(yHi, zero), dNear, dFar)));
+
+		alignas(16) float out[10][4];
+		_mm_store_ps(out[0], vx); _mm_store_ps(out[1], vy); _mm_store_ps(out[2], vz);
+		_mm_store_ps(out[3], zMin); _mm_store_ps(out[4], zMax);
+		_mm_store_ps(out[5], ndcXMin); _mm_store_ps(out[6], ndcXMax);
+		_mm_store_ps(out[7], ndcYMin); _mm_store_ps(out[8], ndcYMax);
+		_mm_store_ps(out[9], r);
+
+		for (size_t k = 0; k < n; ++k)
+		{
+			LightBounds& b = m_bounds[i + k];
+			b.centre[0] = out[0][k];
+			b.centre[1] = out[1][k];
+			b.centre[2] = out[2][k];
+			b.radius = out[9][k];
+			// Projected at the near plane, a sphere reaching in front of it covers less of the screen than it does, so
+			// such a light is tested against every tile of its slices
+			bool nearEye = out[3][k] < m_grid.nearZ;
+			b.visible = out[4][k] > 0.0f && out[3][k] < m_grid.farZ && b.radius > 0.0f
+				&& (nearEye || (out[6][k] >= -1.0f && out[5][k] <= 1.0f && out[8][k] >= -1.0f && out[7][k] <= 1.0f));
+			if (!b.visible)
+				continue;
+
+			if (nearEye)
+			{
+				b.x0 = b.y0 = 0;
+				b.x1 = static_cast<uint16_t>(m_grid.tilesX - 1);
+				b.y1 = static_cast<uint16_t>(m_grid.tilesY - 1);
+			}
+			else
+			{
+				b.x0 = ClampTile((out[5][k] * 0.5f + 0.5f) * m_grid.tilesX, m_grid.tilesX);
+				b.x1 = ClampTile((out[6][k] * 0.5f + 0.5f) * m_grid.tilesX, m_grid.tilesX);
+				// Tile rows run top to bottom, so the top of the sphere gives the first row
+				b.y0 = ClampTile((0.5f - out[8][k] * 0.5f) * m_grid.tilesY, m_grid.tilesY);
+				b.y1 = ClampTile((0.5f - out[7][k] * 0.5f) * m_grid.tilesY, m_grid.tilesY);
+			}
+			b.z0 = static_cast<uint16_t>(SliceOfDepth(out[3][k]));
+			b.z1 = static_cast<uint16_t>(SliceOfDepth(out[4][k]));
+		}
+	}
+}
+
+void LightClusters::BinRow(uint32_t row)
+{
+	uint32_t slice = row / m_grid.tilesY;
+	uint32_t y = row % m_grid.tilesY;
+	uint32_t firstCluster = row * m_grid.tilesX;
+	const float* minX = &m_minX[size_t(row) * m_rowStride];
+	const float* maxX = &m_maxX[size_t(row) * m_rowStride];
+	const float* minY = &m_minY[size_t(row) * m_rowStride];
+	const float* maxY = &m_maxY[size_t(row) * m_rowStride];
+	const float* minZ = &m_minZ[size_t(row) * m_rowStride];
+	const float* maxZ = &m_maxZ[size_t(row) * m_rowStride];
+	std::fill_n(m_counts.begin() + firstCluster, m_grid.tilesX, 0u);
+
+	uint32_t total = 0;
+	uint32_t overflow = 0;
+	const __m128i laneOffsets = _mm_set_epi32(3, 2, 1, 0);
+
+	for (uint32_t l : m_sliceLights[slice])
+	{
+		const LightBounds& b = m_bounds[l];
+		if (y < b.y0 || y > b.y1)
+			continue;
+
+		const __m128 cx = _mm_set1_ps(b.centre[0]);
+		const __m128 cy = _mm_set1_ps(b.centre[1]);
+		const __m128 cz = _mm_set1_ps(b.centre[2]);
+		const __m128 r2 = _mm_set1_ps(b.radius * b.radius);
+		const __m128i first = _mm_set1_epi32(b.x0 - 1);
+		const __m128i last = _mm_set1_epi32(b.x1 + 1);
+
+		for (uint32_t bx = b.x0 & ~3u; bx <= b.x1; bx += 4)
+		{
+			// Squared distance from the sphere centre to four cluster boxes at once
+			__m128 dx = Max0(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minX + bx), cx), _mm_sub_ps(cx, _mm_loadu_ps(maxX + bx))));
+			__m128 dy = Max0(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minY + bx), cy), _mm_sub_ps(cy, _mm_loadu_ps(maxY + bx))));
+			__m128 dz = Max0(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minZ + bx), cz), _mm_sub_ps(cz, _mm_loadu_ps(maxZ + bx))));
+			__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			// Keep only lanes inside the light's tile range
+			__m128i lanes = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(bx)), laneOffsets);
+			__m128i inRange = _mm_and_si128(_mm_cmpgt_epi32(lanes, first), _mm_cmplt_epi32(lanes, last));
+			int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(d2, r2), _mm_castsi128_ps(inRange)));
+
+			for (int lane = 0; mask; ++lane, mask >>= 1)
+			{
+				if (!(mask & 1))
+					continue;
+
+				uint32_t cluster = firstCluster + bx + lane;
+				uint32_t& n = m_counts[cluster];
+				if (n < c_MaxLightsPerCluster)
+				{
+					m_scratch[size_t(cluster) * c_MaxLightsPerCluster + n] = l;
+					++n;
+					++total;
+				}
+				else
+				{
+					++overflow;
+				}
+			}
+		}
+	}
+
+	m_rowTotals[row] = total;
+	m_rowOverflow[row] = overflow;
+}
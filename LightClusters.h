@@ -0,0 +1,108 @@
+//
+// LightClusters.h - CPU binning of point / spot lights into view frustum clusters
+//
+// The view frustum is split into tilesX * tilesY screen tiles and exponentially spaced depth slices. Each frame
+// every light's bounding sphere is tested against the clusters it can touch and a compact list of light indices
+// per cluster is produced, which light_ps walks instead of evaluating every light.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+enum class ClusterLightType : uint32_t
+{
+	Point = 0,
+	Spot = 1,
+};
+
+//World space description of a light that takes part in clustered shading
+struct ClusterLight
+{
+	float				position[3];
+	float				radius;				//light has no influence beyond this distance
+	float				colour[3];
+	float				intensity;
+	float				direction[3];		//spot lights only, normalised
+	float				cosOuter;			//cosine of the outer cone angle
+	float				cosInner;			//cosine of the inner cone angle
+	ClusterLightType	type;
+};
+
+struct ClusterGridDesc
+{
+	uint32_t	tilesX = 16;
+	uint32_t	tilesY = 9;
+	uint32_t	slices = 24;
+	float		nearZ = 0.1f;		//first slice starts here rather than at the projection near plane, which is tiny
+	float		farZ = 100.0f;
+};
+
+class LightClusters
+{
+public:
+	static constexpr uint32_t c_MaxLightsPerCluster = 128;
+
+	LightClusters();
+
+	//projScaleX / projScaleY are the _11 and _22 terms of the perspective projection.
+	//Call whenever the window size or projection changes; rebuilds the cluster bounds.
+	void SetGrid(const ClusterGridDesc& desc, float projScaleX, float projScaleY);
+
+	//Bins the lights for the given view. view is a row-major (row-vector) world to view matrix; rightHanded flips the
+	//sign of view z so depth is positive in front of the camera. pool may be null to run on the calling thread.
+	void Build(const float view[16], bool rightHanded, const ClusterLight* lights, size_t count, ThreadPool* pool);
+
+	const ClusterGridDesc& GetGrid() const { return m_grid; }
+	uint32_t GetClusterCount() const { return m_grid.tilesX * m_grid.tilesY * m_grid.slices; }
+
+	//(offset, count) into GetLightIndices() for each cluster, x fastest then y then slice
+	const std::vector<uint32_t>& GetClusterRanges() const { return m_ranges; }
+	const std::vector<uint32_t>& GetLightIndices() const { return m_indices; }
+
+	//Scale / bias that turn log(viewDepth) into a slice index, as used by the shader
+	float GetSliceScale() const { return m_sliceScale; }
+	float GetSliceBias() const { return m_sliceBias; }
+
+	//Number of light/cluster pairs dropped because a cluster hit c_MaxLightsPerCluster in the last Build
+	uint32_t GetOverflowCount() const { return m_overflow; }
+
+private:
+	//Per light data prepared by the first pass
+	struct LightBounds
+	{
+		float		centre[3];		//view space, z is positive depth
+		float		radius;
+		uint16_t	x0, x1, y0, y1, z0, z1;
+		bool		visible;
+	};
+
+	void ComputeBounds(const float view[16], bool rightHanded, const ClusterLight* lights, size_t begin, size_t end);
+	void BinRow(uint32_t row);
+	uint32_t SliceOfDepth(float depth) const;
+
+	ClusterGridDesc				m_grid;
+	float						m_projScaleX;
+	float						m_projScaleY;
+	float						m_sliceScale;
+	float						m_sliceBias;
+	uint32_t					m_rowStride;		//tilesX rounded up to a multiple of 4 for the SIMD tests
+
+	//Cluster AABBs in view space, structure of arrays, m_rowStride entries per (y, slice) row
+	std::vector<float>			m_minX, m_minY, m_minZ;
+	std::vector<float>			m_maxX, m_maxY, m_maxZ;
+
+	std::vector<LightBounds>	m_bounds;
+	std::vector<uint32_t>		m_scratch;			//c_MaxLightsPerCluster indices per cluster
+	std::vector<uint32_t>		m_counts;
+	std::vector<uint32_t>		m_rowTotals;
+	std::vector<uint32_t>		m_rowOverflow;
+	std::vector<std::vector<uint32_t>>	m_sliceLights;		//visible lights overlapping each slice
+	std::vector<uint32_t>		m_ranges;
+	std::vector<uint32_t>		m_indices;
+	uint32_t					m_overflow;
+};
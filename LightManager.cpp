@@ -0,0 +1,175 @@
+// Packing and dirty range tracking for the clustered lights
+#include "LightManager.h"
+#include "Half.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Point lights get a cone that is always fully open so the shader can apply the cone term without a branch
+	constexpr float c_PointCosOuter = -2.0f;
+	constexpr float c_PointCosInner = -1.0f;
+}
+
+LightManager::LightManager() :
+	m_dirtyCount(0)
+{
+}
+
+uint32_t LightManager::Add(const ClusterLight & light)
+{
+	uint32_t index = static_cast<uint32_t>(m_lights.size());
+	m_lights.push_back(light);
+	m_packed.emplace_back();
+	m_dirty.push_back(0);
+	Pack(light, m_packed[index]);
+	MarkDirty(index);
+	return index;
+}
+
+void LightManager::Set(uint32_t index, const ClusterLight & light)
+{
+	m_lights[index] = light;
+
+	PackedLight packed;
+	Pack(light, packed);
+	if (std::memcmp(&packed, &m_packed[index], sizeof(PackedLight)) != 0)
+	{
+		m_packed[index] = packed;
+		MarkDirty(index);
+	}
+}
+
+void LightManager::Remove(uint32_t index)
+{
+	uint32_t last = GetCount() - 1;
+	if (m_dirty[last])
+	{
+		--m_dirtyCount;
+	}
+	if (index != last)
+	{
+		m_lights[index] = m_lights[last];
+		if (std::memcmp(&m_packed[index], &m_packed[last], sizeof(PackedLight)) != 0)
+		{
+			m_packed[index] = m_packed[last];
+			MarkDirty(index);
+		}
+	}
+	m_lights.pop_back();
+	m_packed.pop_back();
+	m_dirty.pop_back();
+}
+
+void LightManager::Clear()
+{
+	m_lights.clear();
+	m_packed.clear();
+	m_dirty.clear();
+	m_ranges.clear();
+	m_dirtyCount = 0;
+}
+
+const std::vector<LightRange>& LightManager::GetDirtyRanges(uint32_t maxGap)
+{
+	m_ranges.clear();
+	if (!m_dirtyCount)
+	{
+		return m_ranges;
+	}
+
+	uint32_t count = GetCount();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (!m_dirty[i])
+		{
+			continue;
+		}
+
+		if (!m_ranges.empty())
+		{
+			LightRange& last = m_ranges.back();
+			uint32_t end = last.first + last.count;
+			if (i - end <= maxGap)
+			{
+				last.count = i + 1 - last.first;
+				continue;
+			}
+		}
+		m_ranges.push_back({ i, 1 });
+	}
+	return m_ranges;
+}
+
+void LightManager::ClearDirty()
+{
+	if (m_dirtyCount)
+	{
+		std::fill(m_dirty.begin(), m_dirty.end(), static_cast<uint8_t>(0));
+		m_dirtyCount = 0;
+	}
+}
+
+void LightManager::MarkAllDirty()
+{
+	std::fill(m_dirty.begin(), m_dirty.end(), static_cast<uint8_t>(1));
+	m_dirtyCount = GetCount();
+}
+
+void LightManager::Pack(const ClusterLight & light, PackedLight & packed)
+{
+	packed.positionRadius[0] = light.position[0];
+	packed.positionRadius[1] = light.position[1];
+	packed.positionRadius[2] = light.position[2];
+	packed.positionRadius[3] = light.radius;
+	packed.colourIntensity[0] = light.colour[0];
+	packed.colourIntensity[1] = light.colour[1];
+	packed.colourIntensity[2] = light.colour[2];
+	packed.colourIntensity[3] = light.intensity;
+
+	float cosOuter = c_PointCosOuter;
+	float cosInner = c_PointCosInner;
+	if (light.type == ClusterLightType::Spot)
+	{
+		packed.directionCone[0] = light.direction[0];
+		packed.directionCone[1] = light.direction[1];
+		packed.directionCone[2] = light.direction[2];
+		cosOuter = light.cosOuter;
+		cosInner = light.cosInner;
+	}
+	else
+	{
+		packed.directionCone[0] = 0.0f;
+		packed.directionCone[1] = 0.0f;
+		packed.directionCone[2] = 0.0f;
+	}
+	packed.cone = static_cast<uint32_t>(Half::FromFloat(cosOuter)) | (static_cast<uint32_t>(Half::FromFloat(cosInner)) << 16);
+}
+
+void LightManager::Unpack(const PackedLight & packed, ClusterLight & light)
+{
+	light.position[0] = packed.positionRadius[0];
+	light.position[1] = packed.positionRadius[1];
+	light.position[2] = packed.positionRadius[2];
+	light.radius = packed.positionRadius[3];
+	light.colour[0] = packed.colourIntensity[0];
+	light.colour[1] = packed.colourIntensity[1];
+	light.colour[2] = packed.colourIntensity[2];
+	light.intensity = packed.colourIntensity[3];
+	light.direction[0] = packed.directionCone[0];
+	light.direction[1] = packed.directionCone[1];
+	light.direction[2] = packed.directionCone[2];
+	light.cosOuter = Half::ToFloat(static_cast<uint16_t>(packed.cone & 0xffffu));
+	light.cosInner = Half::ToFloat(static_cast<uint16_t>(packed.cone >> 16));
+	light.type = light.cosOuter < -1.0f ? ClusterLightType::Point : ClusterLightType::Spot;
+}
+
+void LightManager::MarkDirty(uint32_t index)
+{
+	if (!m_dirty[index])
+	{
+		m_dirty[index] = 1;
+		++m_dirtyCount;
+	}
+}
@@ -0,0 +1,68 @@
+//
+// LightManager.h - CPU side list of the clustered lights and their packed GPU records
+//
+// Lights are packed into three float4s as soon as they change and flagged dirty. Once a frame the renderer asks
+// for the dirty ranges, merged across small gaps, and uploads only those parts of the structured buffer.
+//
+
+#pragma once
+
+#include "LightClusters.h"
+
+//GPU layout of one light, must match PackedLight in light_ps.hlsl
+struct PackedLight
+{
+	float		positionRadius[4];		//xyz world position, w radius
+	float		colourIntensity[4];		//rgb colour, a intensity
+	float		directionCone[3];		//spot direction, normalised
+	uint32_t	cone;					//cosOuter in the low 16 bits, cosInner in the high 16 bits, both half floats
+};
+
+//A run of lights [first, first + count) that has to be uploaded
+struct LightRange
+{
+	uint32_t	first;
+	uint32_t	count;
+};
+
+class LightManager
+{
+public:
+	LightManager();
+
+	//Adds a light and returns its index, which stays valid until Clear or a Remove moves it
+	uint32_t Add(const ClusterLight& light);
+	void Set(uint32_t index, const ClusterLight& light);
+	//Removes a light by moving the last one into its place, so only that one record has to be uploaded. Whoever holds
+	//the last light's index, GetCount() before the call less one, has to take index instead.
+	void Remove(uint32_t index);
+	void Clear();
+
+	const ClusterLight& Get(uint32_t index) const { return m_lights[index]; }
+	uint32_t GetCount() const { return static_cast<uint32_t>(m_lights.size()); }
+
+	//Unpacked lights for the cluster binning, packed records for the GPU
+	const std::vector<ClusterLight>& GetLights() const { return m_lights; }
+	const std::vector<PackedLight>& GetPacked() const { return m_packed; }
+
+	//Dirty lights merged into ranges. Runs separated by no more than maxGap clean lights are joined, uploading a few
+	//unchanged records is cheaper than another UpdateSubresource call.
+	const std::vector<LightRange>& GetDirtyRanges(uint32_t maxGap = 4);
+	bool IsDirty() const { return m_dirtyCount != 0; }
+	void ClearDirty();
+
+	//Flags every light, e.g. after the GPU buffer was recreated
+	void MarkAllDirty();
+
+	static void Pack(const ClusterLight& light, PackedLight& packed);
+	static void Unpack(const PackedLight& packed, ClusterLight& light);
+
+private:
+	void MarkDirty(uint32_t index);
+
+	std::vector<ClusterLight>	m_lights;
+	std::vector<PackedLight>	m_packed;
+	std::vector<uint8_t>		m_dirty;
+	std::vector<LightRange>		m_ranges;
+	uint32_t					m_dirtyCount;
+};
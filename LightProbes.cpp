@@ -0,0 +1,280 @@
+// SH projection, packing and the SSE probe blend
+#include "LightProbes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <fstream>
+
+namespace
+{
+	constexpr uint32_t c_Magic = 0x52504d4c;		//"LMPR"
+	constexpr uint32_t c_Version = 1;
+
+	// Real SH basis constants, bands 0 to 2
+	constexpr float c_Y0 = 0.282095f;
+	constexpr float c_Y1 = 0.488603f;
+	constexpr float c_Y2 = 1.092548f;
+	constexpr float c_Y20 = 0.315392f;
+	constexpr float c_Y22 = 0.546274f;
+
+	// Cosine lobe convolution per band divided by pi, so irradiance comes out as a mean rather than an integral
+	constexpr float c_A0 = 1.0f;
+	constexpr float c_A1 = 2.0f / 3.0f;
+	constexpr float c_A2 = 0.25f;
+
+	template<typename T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValue(std::ifstream& file, T& value)
+	{
+		return bool(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+}
+
+ShRadiance::ShRadiance()
+{
+	std::memset(coefficients, 0, sizeof(coefficients));
+}
+
+void ShRadiance::Add(const float direction[3], const float radiance[3], float weight)
+{
+	const float x = direction[0], y = direction[1], z = direction[2];
+	const float basis[9] =
+	{
+		c_Y0,
+		c_Y1 * y, c_Y1 * z, c_Y1 * x,
+		c_Y2 * x * y, c_Y2 * y * z, c_Y20 * (3.0f * z * z - 1.0f), c_Y2 * x * z, c_Y22 * (x * x - y * y)
+	};
+	for (int i = 0; i < 9; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			coefficients[i][c] += basis[i] * radiance[c] * weight;
+		}
+	}
+}
+
+ShProbe ShProbe::FromRadiance(const ShRadiance & radiance)
+{
+	const float scale[9] =
+	{
+		c_A0 * c_Y0,
+		c_A1 * c_Y1, c_A1 * c_Y1, c_A1 * c_Y1,
+		c_A2 * c_Y2, c_A2 * c_Y2, c_A2 * c_Y20, c_A2 * c_Y2, c_A2 * c_Y22
+	};
+
+	ShProbe probe;
+	for (int c = 0; c < 3; ++c)
+	{
+		float l[9];
+		for (int i = 0; i < 9; ++i)
+		{
+			l[i] = radiance.coefficients[i][c] * scale[i];
+		}
+
+		// dot(ShA, (n, 1)) + dot(ShB, n.xyzz * n.yzzx), with the constant part of the 3z^2 - 1 term folded into ShA.w
+		float* a = probe.coefficients[c];
+		float* b = probe.coefficients[3 + c];
+		a[0] = l[3]; a[1] = l[1]; a[2] = l[2]; a[3] = l[0] - l[6];
+		b[0] = l[4]; b[1] = l[5]; b[2] = 3.0f * l[6]; b[3] = l[7];
+		probe.coefficients[6][c] = l[8];
+	}
+	probe.coefficients[6][3] = 0.0f;
+	return probe;
+}
+
+void ShProbe::Evaluate(const float normal[3], float irradiance[3]) const
+{
+	const float x = normal[0], y = normal[1], z = normal[2];
+	const float n1[4] = { x, y, z, 1.0f };
+	const float n2[4] = { x * y, y * z, z * z, z * x };
+	for (int c = 0; c < 3; ++c)
+	{
+		const float* a = coefficients[c];
+		const float* b = coefficients[3 + c];
+		float sum = coefficients[6][c] * (x * x - y * y);
+		for (int k = 0; k < 4; ++k)
+		{
+			sum += a[k] * n1[k] + b[k] * n2[k];
+		}
+		irradiance[c] = std::max(sum, 0.0f);
+	}
+}
+
+LightProbeGrid::LightProbeGrid() :
+	sourceHash(0),
+	m_origin{},
+	m_spacing{ 1.0f, 1.0f, 1.0f },
+	m_counts{}
+{
+}
+
+void LightProbeGrid::Resize(const float origin[3], const float spacing[3], const uint32_t counts[3])
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		m_origin[k] = origin[k];
+		m_spacing[k] = spacing[k] > 0.0f ? spacing[k] : 1.0f;
+		m_counts[k] = std::max(counts[k], 1u);
+	}
+	size_t count = size_t(m_counts[0]) * m_counts[1] * m_counts[2];
+	m_probes.assign(count, ShProbe());
+	m_valid.assign(count, 0);
+}
+
+void LightProbeGrid::Clear()
+{
+	m_probes.clear();
+	m_valid.clear();
+	std::fill(m_counts, m_counts + 3, 0u);
+}
+
+void LightProbeGrid::GetProbePosition(uint32_t index, float position[3]) const
+{
+	uint32_t cell[3] = { index % m_counts[0], (index / m_counts[0]) % m_counts[1], index / (m_counts[0] * m_counts[1]) };
+	for (int k = 0; k < 3; ++k)
+	{
+		position[k] = m_origin[k] + float(cell[k]) * m_spacing[k];
+	}
+}
+
+void LightProbeGrid::SetProbe(uint32_t index, const ShProbe & probe, bool valid)
+{
+	if (index < m_probes.size())
+	{
+		m_probes[index] = probe;
+		m_valid[index] = valid ? 1 : 0;
+	}
+}
+
+bool LightProbeGrid::Sample(const float position[3], ShProbe & probe) const
+{
+	__m128 sum[7];
+	for (int j = 0; j < 7; ++j)
+	{
+		sum[j] = _mm_setzero_ps();
+	}
+
+	if (m_probes.empty())
+	{
+		for (int j = 0; j < 7; ++j)
+		{
+			_mm_store_ps(probe.coefficients[j], sum[j]);
+		}
+		return false;
+	}
+
+	// Lower corner of the cell and how far across it position is, clamped so objects outside the grid take the edge
+	uint32_t lower[3], upper[3];
+	float fraction[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		float g = std::min(std::max((position[k] - m_origin[k]) / m_spacing[k], 0.0f), float(m_counts[k] - 1));
+		lower[k] = std::min(static_cast<uint32_t>(g), m_counts[k] > 1 ? m_counts[k] - 2 : 0u);
+		upper[k] = std::min(lower[k] + 1, m_counts[k] - 1);
+		fraction[k] = m_counts[k] > 1 ? g - float(lower[k]) : 0.0f;
+	}
+
+	size_t indices[8];
+	float weights[8];
+	float total = 0.0f;
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		uint32_t x = corner & 1 ? upper[0] : lower[0];
+		uint32_t y = corner & 2 ? upper[1] : lower[1];
+		uint32_t z = corner & 4 ? upper[2] : lower[2];
+		indices[corner] = (size_t(z) * m_counts[1] + y) * m_counts[0] + x;
+		weights[corner] = !m_valid[indices[corner]] ? 0.0f : (corner & 1 ? fraction[0] : 1.0f - fraction[0])
+			* (corner & 2 ? fraction[1] : 1.0f - fraction[1])
+			* (corner & 4 ? fraction[2] : 1.0f - fraction[2]);
+		total += weights[corner];
+	}
+
+	// Right on an invalid probe (or a face of them) the trilinear weights all land on it, so the usable corners of
+	// the cell share it evenly instead
+	if (total <= 0.0f)
+	{
+		for (uint32_t corner = 0; corner < 8; ++corner)
+		{
+			weights[corner] = m_valid[indices[corner]] ? 1.0f : 0.0f;
+			total += weights[corner];
+		}
+	}
+
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		if (weights[corner] <= 0.0f)
+		{
+			continue;
+		}
+		const ShProbe& source = m_probes[indices[corner]];
+		__m128 w = _mm_set1_ps(weights[corner]);
+		for (int j = 0; j < 7; ++j)
+		{
+			sum[j] = _mm_add_ps(sum[j], _mm_mul_ps(w, _mm_load_ps(source.coefficients[j])));
+		}
+	}
+
+	__m128 scale = _mm_set1_ps(total > 0.0f ? 1.0f / total : 0.0f);
+	for (int j = 0; j < 7; ++j)
+	{
+		_mm_store_ps(probe.coefficients[j], _mm_mul_ps(sum[j], scale));
+	}
+	return total > 0.0f;
+}
+
+uint32_t LightProbeGrid::GetValidCount() const
+{
+	return static_cast<uint32_t>(std::count(m_valid.begin(), m_valid.end(), uint8_t(1)));
+}
+
+bool LightProbeGrid::Save(const std::string & path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	WriteValue(file, c_Magic);
+	WriteValue(file, c_Version);
+	WriteValue(file, sourceHash);
+	WriteValue(file, m_origin);
+	WriteValue(file, m_spacing);
+	WriteValue(file, m_counts);
+	file.write(reinterpret_cast<const char*>(m_probes.data()), sizeof(ShProbe) * m_probes.size());
+	file.write(reinterpret_cast<const char*>(m_valid.data()), m_valid.size());
+	return file.good();
+}
+
+bool LightProbeGrid::Load(const std::string & path)
+{
+	std::ifstream file(path, std::ios::binary);
+	uint32_t magic, version;
+	float origin[3], spacing[3];
+	uint32_t counts[3];
+	if (!file || !ReadValue(file, magic) || magic != c_Magic || !ReadValue(file, version) || version != c_Version
+		|| !ReadValue(file, sourceHash) || !ReadValue(file, origin) || !ReadValue(file, spacing) || !ReadValue(file, counts))
+	{
+		return false;
+	}
+	if (!counts[0] || !counts[1] || !counts[2] || size_t(counts[0]) * counts[1] * counts[2] > (1u << 20))
+	{
+		return false;
+	}
+
+	Resize(origin, spacing, counts);
+	if (!file.read(reinterpret_cast<char*>(m_probes.data()), sizeof(ShProbe) * m_probes.size())
+		|| !file.read(reinterpret_cast<char*>(m_valid.data()), m_valid.size()))
+	{
+		Clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+//
+// LightProbes.h - Spherical harmonic irradiance probes for objects the lightmap doesn't cover
+//
+// The baker projects the light arriving at each point of a regular grid onto L2 spherical harmonics (9 coefficients
+// per colour channel) and stores it already convolved with the cosine lobe and packed the way light_ps evaluates it.
+// Both steps are linear, so interpolating packed probes is the same as interpolating the radiance, and the per
+// object blend at runtime is a weighted sum of seven float4s.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Incoming radiance around a point, accumulated one direction at a time while baking
+struct ShRadiance
+{
+	float	coefficients[9][3];
+
+	ShRadiance();
+
+	//direction must be unit length, weight is the solid angle the sample stands for (4pi / count for uniform rays)
+	void Add(const float direction[3], const float radiance[3], float weight);
+};
+
+//Irradiance in light_ps units (the cosine weighted mean of the incoming light, so directly comparable with the
+//ambient colour) as seven float4s: ShAr ShAg ShAb ShBr ShBg ShBb ShC, see ProbeIrradiance in light_ps
+struct alignas(16) ShProbe
+{
+	float	coefficients[7][4];
+
+	static ShProbe FromRadiance(const ShRadiance& radiance);
+
+	//Scalar evaluation, the same sum light_ps does
+	void Evaluate(const float normal[3], float irradiance[3]) const;
+};
+
+class LightProbeGrid
+{
+public:
+	LightProbeGrid();
+
+	//Probes at origin + index * spacing, x fastest
+	void Resize(const float origin[3], const float spacing[3], const uint32_t counts[3]);
+	void Clear();
+
+	void GetProbePosition(uint32_t index, float position[3]) const;
+	void SetProbe(uint32_t index, const ShProbe& probe, bool valid);
+
+	//Trilinear blend of the eight probes around position, clamped to the grid. Probes flagged invalid (buried in
+	//walls) are left out and the rest reweighted, evenly when position sits right on an invalid one. False, with a
+	//zero probe, when none of the eight are usable.
+	bool Sample(const float position[3], ShProbe& probe) const;
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	uint32_t GetProbeCount() const { return static_cast<uint32_t>(m_probes.size()); }
+	uint32_t GetValidCount() const;
+	bool Empty() const { return m_probes.empty(); }
+
+	uint64_t	sourceHash;		//LightmapScene::GetSourceHash of the scene the probes were baked from
+
+private:
+	float					m_origin[3];
+	float					m_spacing[3];
+	uint32_t				m_counts[3];
+	std::vector<ShProbe>	m_probes;
+	std::vector<uint8_t>	m_valid;
+};
@@ -0,0 +1,119 @@
+// Binary reading and writing of the baker's scene files
+#include "LightmapScene.h"
+#include "Hash.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	constexpr uint32_t c_Magic = 0x43534d4c;		//"LMSC"
+	constexpr uint32_t c_Version = 1;
+
+	template<typename T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	void WriteArray(std::ofstream& file, const std::vector<T>& values)
+	{
+		uint32_t count = static_cast<uint32_t>(values.size());
+		WriteValue(file, count);
+		file.write(reinterpret_cast<const char*>(values.data()), sizeof(T) * count);
+	}
+
+	template<typename T>
+	bool ReadValue(std::ifstream& file, T& value)
+	{
+		return bool(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	template<typename T>
+	bool ReadArray(std::ifstream& file, std::vector<T>& values)
+	{
+		uint32_t count;
+		if (!ReadValue(file, count) || count > (1u << 28))
+		{
+			return false;
+		}
+		values.resize(count);
+		return bool(file.read(reinterpret_cast<char*>(values.data()), sizeof(T) * count));
+	}
+}
+
+LightmapScene::LightmapScene() :
+	light{},
+	atlasSize(0)
+{
+}
+
+bool LightmapScene::Save(const std::string & path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	WriteValue(file, c_Magic);
+	WriteValue(file, c_Version);
+	WriteValue(file, atlasSize);
+	WriteValue(file, light);
+	WriteValue(file, static_cast<uint32_t>(meshes.size()));
+	for (const LightmapMesh& mesh : meshes)
+	{
+		WriteValue(file, mesh.object);
+		WriteValue(file, mesh.world);
+		WriteValue(file, mesh.albedo);
+		WriteArray(file, mesh.positions);
+		WriteArray(file, mesh.normals);
+		WriteArray(file, mesh.indices);
+		WriteArray(file, mesh.lightmapUVs);
+	}
+	return file.good();
+}
+
+bool LightmapScene::Load(const std::string & path)
+{
+	std::ifstream file(path, std::ios::binary);
+	uint32_t magic, version, meshCount;
+	if (!file || !ReadValue(file, magic) || magic != c_Magic || !ReadValue(file, version) || version != c_Version)
+	{
+		return false;
+	}
+
+	if (!ReadValue(file, atlasSize) || !ReadValue(file, light) || !ReadValue(file, meshCount))
+	{
+		return false;
+	}
+	meshes.clear();
+	meshes.resize(meshCount);
+	for (LightmapMesh& mesh : meshes)
+	{
+		if (!ReadValue(file, mesh.object) || !ReadValue(file, mesh.world) || !ReadValue(file, mesh.albedo)
+			|| !ReadArray(file, mesh.positions) || !ReadArray(file, mesh.normals) || !ReadArray(file, mesh.indices)
+			|| !ReadArray(file, mesh.lightmapUVs))
+		{
+			meshes.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+uint64_t LightmapScene::GetSourceHash() const
+{
+	uint64_t hash = Hash::Fnv1a(&light, sizeof(light));
+	for (const LightmapMesh& mesh : meshes)
+	{
+		hash = Hash::Fnv1a(&mesh.object, sizeof(mesh.object), hash);
+		hash = Hash::Fnv1a(mesh.world, sizeof(mesh.world), hash);
+		hash = Hash::Fnv1a(mesh.albedo, sizeof(mesh.albedo), hash);
+		hash = Hash::Fnv1a(mesh.positions.data(), mesh.positions.size() * sizeof(float), hash);
+		hash = Hash::Fnv1a(mesh.normals.data(), mesh.normals.size() * sizeof(float), hash);
+		hash = Hash::Fnv1a(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), hash);
+	}
+	return hash;
+}
@@ -0,0 +1,50 @@
+//
+// LightmapScene.h - Static geometry and main light handed from the game to the light baker and back
+//
+// The game writes the static ModelClass meshes to scene.lmscene when B is pressed. The baker reads that, fills in
+// lightmapUVs and writes the result next to the lightmap atlas. The source hash covers everything except the UVs, so
+// the game can tell whether a bake still fits the scene it built.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct LightmapMesh
+{
+	uint32_t				object;				//index of the object in the game's scene list
+	float					world[16];			//row vector, SimpleMath layout
+	float					albedo[3];			//diffuse reflectance used for the bounces
+	std::vector<float>		positions;			//object space, xyz per vertex
+	std::vector<float>		normals;
+	std::vector<uint32_t>	indices;
+	std::vector<float>		lightmapUVs;		//uv per vertex in the atlas, empty until unwrapped
+
+	size_t GetVertexCount() const { return positions.size() / 3; }
+};
+
+//The main light, evaluated the way light_ps does it: point light, no falloff, N.L times diffuse
+struct LightmapLight
+{
+	float	position[3];
+	float	diffuse[3];
+	float	ambient[3];
+};
+
+class LightmapScene
+{
+public:
+	LightmapScene();
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	uint64_t GetSourceHash() const;
+
+	LightmapLight				light;
+	std::vector<LightmapMesh>	meshes;
+	uint32_t					atlasSize;		//width and height of the baked atlas, 0 before baking
+};
@@ -0,0 +1,201 @@
+// LOD chains, the .lod file and screen size level selection
+#include "LodChain.h"
+#include "ByteBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	constexpr uint32_t c_Magic = 0x20444f4c;		//"LOD "
+	constexpr uint32_t c_Version = 1;
+	constexpr uint32_t c_MaxChains = 65536;
+	constexpr uint32_t c_MaxName = 260;
+
+	using ByteBuffer::ReadValue;
+	using ByteBuffer::WriteValue;
+}
+
+LodChain::LodChain() :
+	m_part(0),
+	m_vertexCount(0)
+{
+}
+
+bool LodChain::Set(const std::string & mesh, uint32_t part, uint32_t vertexCount, const std::vector<LodLevel>& levels, const std::vector<uint32_t>& indices)
+{
+	if (levels.empty() || levels.size() > c_MaxLevels || mesh.size() > c_MaxName)
+	{
+		return false;
+	}
+	float previous = 0.0f;
+	for (const LodLevel& level : levels)
+	{
+		if (level.indexCount % 3 || level.indexStart > indices.size() || indices.size() - level.indexStart < level.indexCount
+			|| !std::isfinite(level.error) || level.error < previous)
+		{
+			return false;
+		}
+		previous = level.error;
+	}
+	for (uint32_t index : indices)
+	{
+		if (index >= vertexCount)
+		{
+			return false;
+		}
+	}
+
+	m_mesh = mesh;
+	m_part = part;
+	m_vertexCount = vertexCount;
+	m_levels = levels;
+	m_indices = indices;
+	return true;
+}
+
+const LodChain * LodChain::Find(const std::vector<LodChain>& chains, const std::string & mesh, uint32_t part)
+{
+	for (const LodChain& chain : chains)
+	{
+		if (chain.m_part == part && chain.m_mesh == mesh)
+		{
+			return &chain;
+		}
+	}
+	return nullptr;
+}
+
+void LodChain::Serialize(const std::vector<LodChain>& chains, std::vector<uint8_t>& out)
+{
+	WriteValue(out, c_Magic);
+	WriteValue(out, c_Version);
+	WriteValue(out, static_cast<uint32_t>(chains.size()));
+	for (const LodChain& chain : chains)
+	{
+		WriteValue(out, static_cast<uint32_t>(chain.m_mesh.size()));
+		out.insert(out.end(), chain.m_mesh.begin(), chain.m_mesh.end());
+		WriteValue(out, chain.m_part);
+		WriteValue(out, chain.m_vertexCount);
+		WriteValue(out, chain.GetLevelCount());
+		for (const LodLevel& level : chain.m_levels)
+		{
+			WriteValue(out, level);
+		}
+		WriteValue(out, static_cast<uint32_t>(chain.m_indices.size()));
+		const uint8_t* indices = reinterpret_cast<const uint8_t*>(chain.m_indices.data());
+		out.insert(out.end(), indices, indices + chain.m_indices.size() * sizeof(uint32_t));
+	}
+}
+
+bool LodChain::Deserialize(const uint8_t * data, size_t size, std::vector<LodChain>& chains)
+{
+	chains.clear();
+	size_t offset = 0;
+	uint32_t magic, version, count;
+	if (!ReadValue(data, size, offset, magic) || !ReadValue(data, size, offset, version) || !ReadValue(data, size, offset, count)
+		|| magic != c_Magic || version != c_Version || count > c_MaxChains)
+	{
+		return false;
+	}
+
+	std::vector<LodChain> read(count);
+	for (LodChain& chain : read)
+	{
+		uint32_t length, part, vertexCount, levelCount, indexCount;
+		if (!ReadValue(data, size, offset, length) || length > c_MaxName || size - offset < length)
+		{
+			return false;
+		}
+		std::string mesh(reinterpret_cast<const char*>(data + offset), length);
+		offset += length;
+
+		if (!ReadValue(data, size, offset, part) || !ReadValue(data, size, offset, vertexCount) || !ReadValue(data, size, offset, levelCount)
+			|| levelCount > c_MaxLevels)
+		{
+			return false;
+		}
+		std::vector<LodLevel> levels(levelCount);
+		for (LodLevel& level : levels)
+		{
+			if (!ReadValue(data, size, offset, level))
+			{
+				return false;
+			}
+		}
+
+		if (!ReadValue(data, size, offset, indexCount) || (size - offset) / sizeof(uint32_t) < indexCount)
+		{
+			return false;
+		}
+		std::vector<uint32_t> indices(indexCount);
+		if (indexCount)
+		{
+			std::memcpy(indices.data(), data + offset, indexCount * sizeof(uint32_t));
+		}
+		offset += indexCount * sizeof(uint32_t);
+
+		if (!chain.Set(mesh, part, vertexCount, levels, indices))
+		{
+			return false;
+		}
+	}
+	if (offset != size)
+	{
+		return false;
+	}
+	chains.swap(read);
+	return true;
+}
+
+bool LodChain::Save(const std::string & path, const std::vector<LodChain>& chains)
+{
+	std::vector<uint8_t> data;
+	Serialize(chains, data);
+	return ByteBuffer::WriteFile(path, data);
+}
+
+bool LodChain::Load(const std::string & path, std::vector<LodChain>& chains)
+{
+	chains.clear();
+	std::vector<uint8_t> data;
+	return ByteBuffer::ReadFile(path, data) && Deserialize(data.data(), data.size(), chains);
+}
+
+LodSelector::LodSelector() :
+	m_pixelsPerUnit(0.0f),
+	m_tolerance(1.0f),
+	m_hysteresis(0.25f)
+{
+}
+
+void LodSelector::SetTolerance(float pixels, float hysteresis)
+{
+	m_tolerance = std::max(pixels, 0.0f);
+	m_hysteresis = std::min(std::max(hysteresis, 0.0f), 1.0f);
+}
+
+uint32_t LodSelector::Select(const float * errors, uint32_t levelCount, float errorScale, float distance, uint32_t current) const
+{
+	if (levelCount < 2 || !(distance > 0.0f))
+	{
+		return 0;
+	}
+
+	// Pixels per unit of error at this distance, then the coarsest level under the tolerance: the full one to stay
+	// at the current level or go finer, the reduced one to go coarser
+	float pixels = errorScale * m_pixelsPerUnit / distance;
+	current = std::min(current, levelCount - 1);
+	uint32_t level = 0;
+	for (uint32_t i = levelCount - 1; i > 0; --i)
+	{
+		float limit = i > current ? m_tolerance * (1.0f - m_hysteresis) : m_tolerance;
+		if (errors[i] * pixels <= limit)
+		{
+			level = i;
+			break;
+		}
+	}
+	return level;
+}
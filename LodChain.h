@@ -0,0 +1,82 @@
+//
+// LodChain.h - Levels of detail of a mesh as index runs over its own vertices, the .lod file and picking a level
+//
+// Tools/BuildLods simplifies each part of a mesh, see MeshSimplifier.h, and writes one chain per part: level 0 is the
+// part's own triangles and each level after it fewer, all indexing the part's vertex buffer as it is, so a level is
+// only a different index run to draw. Each level keeps its error, the largest distance between it and the full part
+// in the mesh's units.
+//
+// LodSelector turns that error into pixels for an object this far away and takes the coarsest level under a pixel
+// tolerance. Going coarser needs the level to be under a fraction of the tolerance, going finer happens as soon as the
+// current level is over it, so an object sitting at a switch distance keeps one level instead of flickering.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct LodLevel
+{
+	uint32_t	indexStart;		//into the chain's indices
+	uint32_t	indexCount;
+	float		error;			//in the mesh's units, 0 for level 0
+};
+
+class LodChain
+{
+public:
+	static constexpr uint32_t c_MaxLevels = 8;
+
+	LodChain();
+
+	//False unless there are 1 to c_MaxLevels levels, each whole triangles inside indices, every index under vertexCount
+	//and the errors never going down from one level to the next
+	bool Set(const std::string& mesh, uint32_t part, uint32_t vertexCount, const std::vector<LodLevel>& levels, const std::vector<uint32_t>& indices);
+
+	const std::string& GetMesh() const { return m_mesh; }		//mesh name in the model file
+	uint32_t GetPart() const { return m_part; }					//subset of the mesh
+	uint32_t GetVertexCount() const { return m_vertexCount; }
+	uint32_t GetLevelCount() const { return static_cast<uint32_t>(m_levels.size()); }
+	const LodLevel& GetLevel(uint32_t level) const { return m_levels[level]; }
+	const std::vector<uint32_t>& GetIndices() const { return m_indices; }
+
+	//The chain of one part of a mesh in a file's chains, null if there isn't one
+	static const LodChain* Find(const std::vector<LodChain>& chains, const std::string& mesh, uint32_t part);
+
+	//Every chain of a file, in order
+	static void Serialize(const std::vector<LodChain>& chains, std::vector<uint8_t>& out);
+	static bool Deserialize(const uint8_t* data, size_t size, std::vector<LodChain>& chains);
+	static bool Save(const std::string& path, const std::vector<LodChain>& chains);
+	static bool Load(const std::string& path, std::vector<LodChain>& chains);
+
+private:
+	std::string				m_mesh;
+	uint32_t				m_part;
+	uint32_t				m_vertexCount;
+	std::vector<LodLevel>	m_levels;
+	std::vector<uint32_t>	m_indices;
+};
+
+class LodSelector
+{
+public:
+	LodSelector();
+
+	//The projection's y scale (_22) and the viewport height, as for TextureManager::SetProjection
+	void SetProjection(float projScaleY, float screenHeight) { m_pixelsPerUnit = projScaleY * screenHeight * 0.5f; }
+
+	//Largest error allowed on screen in pixels, and how far under it (0 to 1 of it) a coarser level has to be
+	void SetTolerance(float pixels, float hysteresis);
+
+	//The level to draw from levelCount errors, finest first, for an object scaled by errorScale whose nearest point is
+	//distance from the camera, given the level it is drawn at now. Level 0 when the camera is inside it.
+	uint32_t Select(const float* errors, uint32_t levelCount, float errorScale, float distance, uint32_t current) const;
+
+private:
+	float	m_pixelsPerUnit;
+	float	m_tolerance;
+	float	m_hysteresis;
+};
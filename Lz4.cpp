@@ -0,0 +1,267 @@
+// Greedy LZ4 block compressor and bounds checked decompressor
+#include "Lz4.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	constexpr size_t c_MinMatch = 4;
+	constexpr size_t c_LastLiterals = 5;		//the block always ends with at least this many literals
+	constexpr size_t c_MatchLimit = 12;			//and no match starts closer than this to the end
+	constexpr size_t c_MaxOffset = 65535;
+	constexpr uint32_t c_HashBits = 16;
+
+	uint32_t Read32(const uint8_t* data)
+	{
+		uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint32_t HashSequence(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - c_HashBits);
+	}
+
+	// Output with the capacity checked on every write, so a full buffer just fails the compression
+	struct Writer
+	{
+		uint8_t*	data;
+		size_t		capacity;
+		size_t		size;
+		bool		overflow;
+
+		void Byte(uint8_t value)
+		{
+			if (size >= capacity)
+			{
+				overflow = true;
+				return;
+			}
+			data[size++] = value;
+		}
+
+		void Bytes(const uint8_t* values, size_t count)
+		{
+			if (count > capacity - size)
+			{
+				overflow = true;
+				return;
+			}
+			if (count)
+			{
+				std::memcpy(data + size, values, count);
+				size += count;
+			}
+		}
+
+		// The part of a length past the 15 that fits in the token, as a run of 255s and a remainder
+		void Length(size_t length)
+		{
+			for (; length >= 255; length -= 255)
+			{
+				Byte(255);
+			}
+			Byte(static_cast<uint8_t>(length));
+		}
+	};
+
+	void WriteSequence(Writer& out, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+	{
+		size_t matchCode = matchLength - c_MinMatch;
+		uint8_t token = static_cast<uint8_t>(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+		out.Byte(token);
+		if (literalLength >= 15)
+		{
+			out.Length(literalLength - 15);
+		}
+		out.Bytes(literals, literalLength);
+		out.Byte(static_cast<uint8_t>(offset));
+		out.Byte(static_cast<uint8_t>(offset >> 8));
+		if (matchCode >= 15)
+		{
+			out.Length(matchCode - 15);
+		}
+	}
+
+	void WriteLastLiterals(Writer& out, const uint8_t* literals, size_t literalLength)
+	{
+		out.Byte(static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4));
+		if (literalLength >= 15)
+		{
+			out.Length(literalLength - 15);
+		}
+		out.Bytes(literals, literalLength);
+	}
+
+	// A length continued past its token nibble, false if the input runs out first
+	bool ReadLength(const uint8_t* input, size_t size, size_t& position, size_t& length)
+	{
+		uint8_t value;
+		do
+		{
+			if (position >= size)
+			{
+				return false;
+			}
+			value = input[position++];
+			length += value;
+		} while (value == 255);
+		return true;
+	}
+}
+
+size_t Lz4::GetMaxCompressedSize(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t Lz4::Compress(const uint8_t * input, size_t size, uint8_t * output, size_t capacity)
+{
+	// Positions are kept in 32 bits
+	if (size >= 0xffffffffu)
+	{
+		return 0;
+	}
+
+	Writer out = { output, capacity, 0, false };
+	size_t anchor = 0;
+
+	if (size > c_MatchLimit)
+	{
+		// Last position each hashed sequence was seen at, plus one so zero means never
+		std::vector<uint32_t> table(size_t(1) << c_HashBits, 0);
+		size_t matchStartLimit = size - c_MatchLimit;
+		size_t matchEndLimit = size - c_LastLiterals;
+
+		size_t position = 0;
+		while (position < matchStartLimit)
+		{
+			uint32_t sequence = Read32(input + position);
+			uint32_t& slot = table[HashSequence(sequence)];
+			size_t candidate = slot;
+			slot = static_cast<uint32_t>(position + 1);
+
+			if (!candidate || position - (candidate - 1) > c_MaxOffset || Read32(input + candidate - 1) != sequence)
+			{
+				// Step further the longer nothing has matched, incompressible data goes through quickly
+				position += 1 + ((position - anchor) >> 6);
+				continue;
+			}
+
+			size_t reference = candidate - 1;
+			while (position > anchor && reference > 0 && input[position - 1] == input[reference - 1])
+			{
+				--position;
+				--reference;
+			}
+			size_t length = c_MinMatch;
+			while (position + length < matchEndLimit && input[position + length] == input[reference + length])
+			{
+				++length;
+			}
+
+			WriteSequence(out, input + anchor, position - anchor, position - reference, length);
+			position += length;
+			anchor = position;
+
+			// The match hides the positions inside it, keep the one just before the next search
+			if (position < matchStartLimit)
+			{
+				table[HashSequence(Read32(input + position - 2))] = static_cast<uint32_t>(position - 2 + 1);
+			}
+		}
+	}
+
+	WriteLastLiterals(out, input + anchor, size - anchor);
+	return out.overflow ? 0 : out.size;
+}
+
+bool Lz4::Decompress(const uint8_t * input, size_t size, uint8_t * output, size_t outputSize)
+{
+	size_t in = 0, out = 0;
+	for (;;)
+	{
+		if (in >= size)
+		{
+			return false;
+		}
+		uint8_t token = input[in++];
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !ReadLength(input, size, in, literalLength))
+		{
+			return false;
+		}
+		if (literalLength > size - in || literalLength > outputSize - out)
+		{
+			return false;
+		}
+		// Most runs are short, one fixed size copy covers them when both buffers have room for it. Whatever it
+		// writes past the literals is overwritten by the match.
+		if (literalLength <= 16 && size - in >= 16 && outputSize - out >= 16)
+		{
+			std::memcpy(output + out, input + in, 16);
+		}
+		else if (literalLength)
+		{
+			std::memcpy(output + out, input + in, literalLength);
+		}
+		in += literalLength;
+		out += literalLength;
+
+		// The last sequence has literals only
+		if (in == size)
+		{
+			return out == outputSize;
+		}
+
+		if (size - in < 2)
+		{
+			return false;
+		}
+		size_t offset = input[in] | (size_t(input[in + 1]) << 8);
+		in += 2;
+		if (offset == 0 || offset > out)
+		{
+			return false;
+		}
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(input, size, in, matchLength))
+		{
+			return false;
+		}
+		matchLength += c_MinMatch;
+		if (matchLength > outputSize - out)
+		{
+			return false;
+		}
+
+		// Copied in chunks no longer than the offset, so each chunk only reads bytes written before it, when the
+		// output has room for the last chunk to run over. Shorter offsets repeat the bytes one at a time.
+		uint8_t* destination = output + out;
+		const uint8_t* source = destination - offset;
+		size_t chunk = offset >= 16 ? 16 : offset >= 8 ? 8 : 0;
+		if (chunk && outputSize - out >= matchLength + chunk)
+		{
+			for (size_t i = 0; i < matchLength; i += chunk)
+			{
+				std::memcpy(destination + i, source + i, chunk);
+			}
+		}
+		else if (offset >= matchLength)
+		{
+			std::memcpy(destination, source, matchLength);
+		}
+		else
+		{
+			for (size_t i = 0; i < matchLength; ++i)
+			{
+				destination[i] = source[i];
+			}
+		}
+		out += matchLength;
+	}
+}
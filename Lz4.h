@@ -0,0 +1,25 @@
+//
+// Lz4.h - LZ4 block compression for the asset archive
+//
+// Writes and reads the standard LZ4 block format (no frame header), so archives can be checked with the reference
+// tools. The compressor is the simple greedy one: a hash of the next four bytes finds the last position they were
+// seen at, matches are extended both ways and anything else is copied as literals. Decompression checks every length
+// and offset against both buffers, so a damaged archive fails rather than reading or writing out of bounds.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Lz4
+{
+	//Worst case output for size bytes of input that doesn't compress at all
+	size_t GetMaxCompressedSize(size_t size);
+
+	//Bytes written to output, 0 if they don't fit in capacity
+	size_t Compress(const uint8_t* input, size_t size, uint8_t* output, size_t capacity);
+
+	//True only if input decodes to exactly outputSize bytes
+	bool Decompress(const uint8_t* input, size_t size, uint8_t* output, size_t outputSize);
+}
@@ -261,6 +261,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         }
         Keyboard::ProcessMessage(message, wParam, lParam);
         Mouse::ProcessMessage(message, wParam, lParam);
+        if (game)
+        {
+            game->OnInputMessage(message, wParam, lParam);
+        }
         break;
 
     case WM_POWERBROADCAST:
@@ -300,12 +304,20 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     case WM_XBUTTONUP:
     case WM_MOUSEHOVER:
         Mouse::ProcessMessage(message, wParam, lParam);
+        if (game)
+        {
+            game->OnInputMessage(message, wParam, lParam);
+        }
         break;
 
     case WM_KEYDOWN:
     case WM_KEYUP:
     case WM_SYSKEYUP:
         Keyboard::ProcessMessage(message, wParam, lParam);
+        if (game)
+        {
+            game->OnInputMessage(message, wParam, lParam);
+        }
         break;
 
     case WM_SYSKEYDOWN:
@@ -340,6 +352,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             s_fullscreen = !s_fullscreen;
         }
         Keyboard::ProcessMessage(message, wParam, lParam);
+        if (game)
+        {
+            game->OnInputMessage(message, wParam, lParam);
+        }
         break;
 
     case WM_MENUCHAR:
@@ -0,0 +1,35 @@
+//
+// MappedFile.h - Read only memory mapping of a whole file
+//
+// The bytes are paged in by the OS as they are touched, so parsing a header only reads the first page and the rest
+// can be handed to the device straight from the mapping. Win32 file mapping on Windows, mmap elsewhere, so the tools
+// and the streamer build on both.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator= (MappedFile const&) = delete;
+
+	//False for missing, unreadable or empty files
+	bool Open(const std::string& path);
+	void Close();
+
+	const uint8_t* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+	bool IsOpen() const { return m_data != nullptr; }
+
+private:
+	const uint8_t*	m_data;
+	size_t			m_size;
+};
@@ -0,0 +1,93 @@
+// Binding the packed materials and the per draw slice
+#include "pch.h"
+#include "MaterialArray.h"
+
+namespace
+{
+	struct MaterialBufferType
+	{
+		uint32_t slice;
+		uint32_t padding[3];
+	};
+}
+
+MaterialArray::MaterialArray() :
+	m_texture(c_InvalidTexture)
+{
+}
+
+
+MaterialArray::~MaterialArray()
+{
+}
+
+bool MaterialArray::Init(ID3D11Device * device)
+{
+	D3D11_BUFFER_DESC materialBufferDesc;
+
+	// Setup the description of the dynamic material constant buffer that is in the pixel shader.
+	materialBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	materialBufferDesc.ByteWidth = sizeof(MaterialBufferType);
+	materialBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	materialBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	materialBufferDesc.MiscFlags = 0;
+	materialBufferDesc.StructureByteStride = 0;
+	return SUCCEEDED(device->CreateBuffer(&materialBufferDesc, NULL, m_materialBuffer.ReleaseAndGetAddressOf()));
+}
+
+void MaterialArray::Reset()
+{
+	// The table and the handle stay, the TextureManager streams the array in again after a device loss
+	m_materialBuffer.Reset();
+}
+
+bool MaterialArray::Load(TextureManager & textures, const std::string & tablePath, int priority)
+{
+	if (!m_table.Load(tablePath) || m_table.Empty() || m_table.texturePath.empty())
+	{
+		Unload();
+		return false;
+	}
+
+	size_t slash = tablePath.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? std::string() : tablePath.substr(0, slash + 1);
+	m_texture = textures.Load(directory + m_table.texturePath, priority);
+	return true;
+}
+
+void MaterialArray::Unload()
+{
+	m_table.Clear();
+	m_texture = c_InvalidTexture;
+}
+
+bool MaterialArray::Bind(ID3D11DeviceContext * context, const TextureManager & textures)
+{
+	if (m_texture == c_InvalidTexture || !m_materialBuffer)
+	{
+		return false;
+	}
+
+	const TextureStreamer& streamer = textures.GetStreamer();
+	if (streamer.GetState(m_texture) != TextureState::Resident || streamer.GetInfo(m_texture).arraySize < m_table.GetCount())
+	{
+		return false;
+	}
+
+	ID3D11ShaderResourceView* view = textures.Get(m_texture);
+	context->PSSetShaderResources(7, 1, &view);
+	return true;
+}
+
+void MaterialArray::SetSlice(ID3D11DeviceContext * context, uint32_t slice)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (FAILED(context->Map(m_materialBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+	{
+		return;
+	}
+	MaterialBufferType* dataPtr = (MaterialBufferType*)mappedResource.pData;
+	dataPtr->slice = slice;
+	context->Unmap(m_materialBuffer.Get(), 0);
+	context->PSSetConstantBuffers(4, 1, m_materialBuffer.GetAddressOf());
+}
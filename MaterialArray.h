@@ -0,0 +1,37 @@
+#pragma once
+
+#include "MaterialTable.h"
+#include "TextureManager.h"
+
+//GPU side of the packed materials, see MaterialTable.h. The array streams in through the TextureManager like the
+//other textures; until it has arrived, or when there's no table, draws fall back to their own texture.
+//Owns the constant buffer material_ps and lightmap_material_ps read:
+//	t7	materialTextures	every packed material, bound once per pass by Bind
+//	b4	MaterialBuffer		slice of the object being drawn, rewritten before every draw from the array
+class MaterialArray
+{
+public:
+	MaterialArray();
+	~MaterialArray();
+
+	bool Init(ID3D11Device* device);
+	void Reset();
+
+	//Reads the table and queues the array it names, from the same directory
+	bool Load(TextureManager& textures, const std::string& tablePath, int priority = 0);
+	void Unload();
+
+	//Slice of a texture, -1 if it isn't packed
+	int Find(const std::string& texturePath) const { return m_table.Find(texturePath); }
+
+	//Binds the array for this pass. False while it is loading, if it failed or has fewer slices than the table.
+	bool Bind(ID3D11DeviceContext* context, const TextureManager& textures);
+
+	//Uploads and binds the slice for the next draw
+	void SetSlice(ID3D11DeviceContext* context, uint32_t slice);
+
+private:
+	MaterialTable							m_table;
+	TextureHandle							m_texture;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>	m_materialBuffer;
+};
@@ -0,0 +1,119 @@
+// Slice lookup and the table file
+#include "MaterialTable.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+	constexpr uint32_t c_Magic = 0x4c42544d;		//"MTBL"
+	constexpr uint32_t c_Version = 1;
+	constexpr uint32_t c_MaxSlices = 2048;			//D3D11 array limit
+	constexpr uint32_t c_MaxName = 260;
+
+	template<typename T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadValue(std::ifstream& file, T& value)
+	{
+		return bool(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	void WriteString(std::ofstream& file, const std::string& value)
+	{
+		WriteValue(file, static_cast<uint32_t>(value.size()));
+		file.write(value.data(), value.size());
+	}
+
+	bool ReadString(std::ifstream& file, std::string& value)
+	{
+		uint32_t length;
+		if (!ReadValue(file, length) || length > c_MaxName)
+		{
+			return false;
+		}
+		value.resize(length);
+		return length == 0 || bool(file.read(&value[0], length));
+	}
+
+	std::string GetFileName(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+}
+
+MaterialTable::MaterialTable()
+{
+}
+
+uint32_t MaterialTable::Add(const std::string & name)
+{
+	int slice = Find(name);
+	if (slice >= 0)
+	{
+		return static_cast<uint32_t>(slice);
+	}
+	m_names.push_back(GetFileName(name));
+	return GetCount() - 1;
+}
+
+int MaterialTable::Find(const std::string & path) const
+{
+	auto found = std::find(m_names.begin(), m_names.end(), GetFileName(path));
+	return found == m_names.end() ? -1 : static_cast<int>(found - m_names.begin());
+}
+
+void MaterialTable::Clear()
+{
+	m_names.clear();
+	texturePath.clear();
+}
+
+bool MaterialTable::Save(const std::string & path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	WriteValue(file, c_Magic);
+	WriteValue(file, c_Version);
+	WriteString(file, texturePath);
+	WriteValue(file, GetCount());
+	for (const std::string& name : m_names)
+	{
+		WriteString(file, name);
+	}
+	return file.good();
+}
+
+bool MaterialTable::Load(const std::string & path)
+{
+	Clear();
+
+	std::ifstream file(path, std::ios::binary);
+	uint32_t magic, version, count;
+	if (!file || !ReadValue(file, magic) || magic != c_Magic || !ReadValue(file, version) || version != c_Version
+		|| !ReadString(file, texturePath) || !ReadValue(file, count) || count > c_MaxSlices)
+	{
+		Clear();
+		return false;
+	}
+
+	m_names.resize(count);
+	for (std::string& name : m_names)
+	{
+		if (!ReadString(file, name))
+		{
+			Clear();
+			return false;
+		}
+	}
+	return true;
+}
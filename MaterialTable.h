@@ -0,0 +1,38 @@
+//
+// MaterialTable.h - Which slice of the packed material array each scene texture went to
+//
+// Tools/PackMaterials resamples the textures of the static ModelClass surfaces to one size and writes them as a single
+// Texture2DArray, with this table alongside it. At runtime the array is bound once per pass and each draw only
+// passes its slice, instead of binding its own texture. A texture missing from the table is drawn the old way.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class MaterialTable
+{
+public:
+	MaterialTable();
+
+	//Slice for a texture, the existing one if it was already added. Names are file names without the directory.
+	uint32_t Add(const std::string& name);
+	//Slice of a texture, -1 if it isn't in the array. Any directory in path is ignored.
+	int Find(const std::string& path) const;
+	void Clear();
+
+	uint32_t GetCount() const { return static_cast<uint32_t>(m_names.size()); }
+	const std::string& GetName(uint32_t slice) const { return m_names[slice]; }
+	bool Empty() const { return m_names.empty(); }
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	//File name of the array the slices are in, relative to the table
+	std::string	texturePath;
+
+private:
+	std::vector<std::string>	m_names;
+};
@@ -0,0 +1,549 @@
+// Quadric error edge collapse over a mesh's own vertices
+#include "MeshSimplifier.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t c_None = 0xffffffffu;
+	constexpr double c_EdgeWeight = 10.0;		//border and seam planes against the area weighted triangle planes
+
+	enum VertexKind : uint8_t
+	{
+		Manifold,		//one copy, every edge shared by two triangles, moves anywhere
+		Border,			//one copy on an open border, moves along it
+		Seam,			//two copies whose open edges pair up, both move along the seam
+		Locked,			//corners, more copies or anything non manifold, never moves
+	};
+
+	struct Quadric
+	{
+		double	a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+		double	weight;
+	};
+
+	struct Collapse
+	{
+		uint32_t	from;
+		uint32_t	to;
+		uint32_t	seamFrom;		//the other copy of a seam vertex and where it goes, c_None otherwise
+		uint32_t	seamTo;
+		double		error;
+	};
+
+	struct Vector
+	{
+		double	x, y, z;
+	};
+
+	Vector Load(const float* p) { return { p[0], p[1], p[2] }; }
+	Vector Sub(const Vector& a, const Vector& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	double Dot(const Vector& a, const Vector& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	Vector Cross(const Vector& a, const Vector& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+	void AddPlane(Quadric& q, const Vector& n, double d, double weight)
+	{
+		q.a2 += weight * n.x * n.x;
+		q.b2 += weight * n.y * n.y;
+		q.c2 += weight * n.z * n.z;
+		q.ab += weight * n.x * n.y;
+		q.ac += weight * n.x * n.z;
+		q.bc += weight * n.y * n.z;
+		q.ad += weight * n.x * d;
+		q.bd += weight * n.y * d;
+		q.cd += weight * n.z * d;
+		q.d2 += weight * d * d;
+		q.weight += weight;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a2 += other.a2; q.b2 += other.b2; q.c2 += other.c2;
+		q.ab += other.ab; q.ac += other.ac; q.bc += other.bc;
+		q.ad += other.ad; q.bd += other.bd; q.cd += other.cd;
+		q.d2 += other.d2;
+		q.weight += other.weight;
+	}
+
+	//Mean squared distance from p to the quadric's planes
+	double Evaluate(const Quadric& q, const Vector& p)
+	{
+		double rx = q.a2 * p.x + q.ab * p.y + q.ac * p.z;
+		double ry = q.ab * p.x + q.b2 * p.y + q.bc * p.z;
+		double rz = q.ac * p.x + q.bc * p.y + q.c2 * p.z;
+		double r = rx * p.x + ry * p.y + rz * p.z + 2.0 * (q.ad * p.x + q.bd * p.y + q.cd * p.z) + q.d2;
+		return q.weight > 0.0 ? std::fabs(r) / q.weight : 0.0;
+	}
+
+	struct PositionKey
+	{
+		uint32_t	bits[3];
+
+		bool operator==(const PositionKey& other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const { return static_cast<size_t>(Hash::Fnv1a(key.bits, sizeof(key.bits))); }
+	};
+
+	struct VertexBytesHash
+	{
+		const uint8_t*	vertices;
+		size_t			stride;
+
+		size_t operator()(uint32_t vertex) const { return static_cast<size_t>(Hash::Fnv1a(vertices + vertex * stride, stride)); }
+	};
+
+	struct VertexBytesEqual
+	{
+		const uint8_t*	vertices;
+		size_t			stride;
+
+		bool operator()(uint32_t a, uint32_t b) const { return std::memcmp(vertices + a * stride, vertices + b * stride, stride) == 0; }
+	};
+
+	class Simplifier
+	{
+	public:
+		Simplifier(const float* positions, size_t vertexCount, size_t positionStride);
+
+		size_t Run(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float targetError, float* resultError);
+
+	private:
+		void WeldPositions(const float* positions, size_t positionStride);
+		void ClassifyVertices();
+		void BuildQuadrics();
+		void BuildAdjacency();
+		bool FindCollapse(uint32_t from, uint32_t to, Collapse& collapse) const;
+		bool FlipsTriangle(uint32_t from, uint32_t to) const;
+
+		size_t						m_vertexCount;
+		double						m_scale;			//positions are moved into the unit cube for the quadrics
+		std::vector<Vector>			m_positions;
+		std::vector<uint32_t>		m_triangles;		//indices being simplified
+		std::vector<uint32_t>		m_weld;				//first vertex at the same position
+		std::vector<uint32_t>		m_wedge;			//next vertex at the same position, in a ring
+		std::vector<uint8_t>		m_kind;
+		std::vector<uint32_t>		m_loop;				//the open edge leaving each vertex, c_None if it hasn't exactly one
+		std::vector<uint32_t>		m_loopBack;			//the open edge arriving at it
+		std::vector<Quadric>		m_quadrics;			//per welded vertex
+		std::vector<uint32_t>		m_adjacencyStart;	//triangles around each welded vertex
+		std::vector<uint32_t>		m_adjacency;
+	};
+
+	Simplifier::Simplifier(const float* positions, size_t vertexCount, size_t positionStride) :
+		m_vertexCount(vertexCount),
+		m_scale(1.0)
+	{
+		WeldPositions(positions, positionStride);
+	}
+
+	void Simplifier::WeldPositions(const float* positions, size_t positionStride)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(positions);
+		m_positions.resize(m_vertexCount);
+		m_weld.resize(m_vertexCount);
+		m_wedge.resize(m_vertexCount);
+
+		Vector boundsMin = { 0.0, 0.0, 0.0 }, boundsMax = { 0.0, 0.0, 0.0 };
+		std::unordered_map<PositionKey, uint32_t, PositionKeyHash> first;
+		first.reserve(m_vertexCount);
+		for (size_t v = 0; v < m_vertexCount; ++v)
+		{
+			float p[3];
+			std::memcpy(p, bytes + v * positionStride, sizeof(p));
+			PositionKey key;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float value = p[axis] + 0.0f;		//-0 and 0 weld
+				std::memcpy(&key.bits[axis], &value, sizeof(float));
+			}
+
+			uint32_t vertex = static_cast<uint32_t>(v);
+			auto found = first.emplace(key, vertex).first;
+			uint32_t weld = found->second;
+			m_weld[v] = weld;
+			m_wedge[v] = vertex;
+			if (weld != vertex)
+			{
+				m_wedge[v] = m_wedge[weld];
+				m_wedge[weld] = vertex;
+			}
+
+			m_positions[v] = Load(p);
+			const Vector& position = m_positions[v];
+			boundsMin = v ? Vector{ std::min(boundsMin.x, position.x), std::min(boundsMin.y, position.y), std::min(boundsMin.z, position.z) } : position;
+			boundsMax = v ? Vector{ std::max(boundsMax.x, position.x), std::max(boundsMax.y, position.y), std::max(boundsMax.z, position.z) } : position;
+		}
+
+		double extent = std::max(std::max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+		m_scale = extent > 0.0 ? extent : 1.0;
+		for (Vector& position : m_positions)
+		{
+			position = { (position.x - boundsMin.x) / m_scale, (position.y - boundsMin.y) / m_scale, (position.z - boundsMin.z) / m_scale };
+		}
+	}
+
+	void Simplifier::ClassifyVertices()
+	{
+		// Open edges are the ones whose reverse no triangle has, by vertex rather than position, so seams show up too
+		std::unordered_set<uint64_t> edges;
+		edges.reserve(m_triangles.size());
+		for (size_t i = 0; i < m_triangles.size(); i += 3)
+		{
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				uint64_t a = m_triangles[i + corner], b = m_triangles[i + (corner + 1) % 3];
+				edges.insert(a << 32 | b);
+			}
+		}
+
+		// One open edge leaving and arriving is recorded, more than one marks the vertex itself
+		std::vector<uint32_t> openOut(m_vertexCount, c_None), openIn(m_vertexCount, c_None);
+		for (size_t i = 0; i < m_triangles.size(); i += 3)
+		{
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				uint32_t a = m_triangles[i + corner], b = m_triangles[i + (corner + 1) % 3];
+				if (!edges.count(uint64_t(b) << 32 | a))
+				{
+					openOut[a] = openOut[a] == c_None ? b : a;
+					openIn[b] = openIn[b] == c_None ? a : b;
+				}
+			}
+		}
+
+		m_kind.assign(m_vertexCount, Locked);
+		m_loop.assign(m_vertexCount, c_None);
+		m_loopBack.assign(m_vertexCount, c_None);
+		auto single = [](uint32_t edge, uint32_t vertex) { return edge != c_None && edge != vertex; };
+		for (uint32_t v = 0; v < m_vertexCount; ++v)
+		{
+			m_loop[v] = single(openOut[v], v) ? openOut[v] : c_None;
+			m_loopBack[v] = single(openIn[v], v) ? openIn[v] : c_None;
+			if (m_weld[v] != v)
+			{
+				continue;
+			}
+
+			uint8_t kind = Locked;
+			uint32_t w = m_wedge[v];
+			if (w == v)
+			{
+				if (openIn[v] == c_None && openOut[v] == c_None)
+				{
+					kind = Manifold;
+				}
+				else if (single(openIn[v], v) && single(openOut[v], v))
+				{
+					kind = Border;
+				}
+			}
+			else if (m_wedge[w] == v)
+			{
+				// The copies' open edges run opposite ways between the same two positions
+				uint32_t a = openIn[v], b = openIn[w], c = openOut[v], d = openOut[w];
+				if (single(a, v) && single(b, w) && single(c, v) && single(d, w) && m_weld[a] == m_weld[d] && m_weld[b] == m_weld[c])
+				{
+					kind = Seam;
+				}
+			}
+
+			uint32_t copy = v;
+			do
+			{
+				m_kind[copy] = kind;
+				copy = m_wedge[copy];
+			} while (copy != v);
+		}
+	}
+
+	void Simplifier::BuildQuadrics()
+	{
+		m_quadrics.assign(m_vertexCount, Quadric());
+		for (size_t i = 0; i < m_triangles.size(); i += 3)
+		{
+			uint32_t v[3] = { m_triangles[i], m_triangles[i + 1], m_triangles[i + 2] };
+			const Vector& p0 = m_positions[v[0]];
+			Vector normal = Cross(Sub(m_positions[v[1]], p0), Sub(m_positions[v[2]], p0));
+			double length = std::sqrt(Dot(normal, normal));
+			if (length == 0.0)
+			{
+				continue;
+			}
+			normal = { normal.x / length, normal.y / length, normal.z / length };
+
+			Quadric plane = {};
+			AddPlane(plane, normal, -Dot(normal, p0), length * 0.5);
+			for (uint32_t corner : v)
+			{
+				AddQuadric(m_quadrics[m_weld[corner]], plane);
+			}
+
+			// A plane through each border or seam edge, upright on the triangle, holds the edge where it is
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				uint32_t a = v[corner], b = v[(corner + 1) % 3];
+				if ((m_loop[a] != b && m_loopBack[b] != a) || (m_kind[a] != Border && m_kind[a] != Seam && m_kind[b] != Border && m_kind[b] != Seam))
+				{
+					continue;
+				}
+				Vector edge = Sub(m_positions[b], m_positions[a]);
+				Vector upright = Cross(normal, edge);
+				double uprightLength = std::sqrt(Dot(upright, upright));
+				if (uprightLength == 0.0)
+				{
+					continue;
+				}
+				upright = { upright.x / uprightLength, upright.y / uprightLength, upright.z / uprightLength };
+
+				Quadric edgePlane = {};
+				AddPlane(edgePlane, upright, -Dot(upright, m_positions[a]), Dot(edge, edge) * c_EdgeWeight);
+				AddQuadric(m_quadrics[m_weld[a]], edgePlane);
+				AddQuadric(m_quadrics[m_weld[b]], edgePlane);
+			}
+		}
+	}
+
+	void Simplifier::BuildAdjacency()
+	{
+		m_adjacencyStart.assign(m_vertexCount + 1, 0);
+		for (uint32_t vertex : m_triangles)
+		{
+			++m_adjacencyStart[m_weld[vertex] + 1];
+		}
+		std::partial_sum(m_adjacencyStart.begin(), m_adjacencyStart.end(), m_adjacencyStart.begin());
+
+		std::vector<uint32_t> fill(m_adjacencyStart.begin(), m_adjacencyStart.end() - 1);
+		m_adjacency.resize(m_triangles.size());
+		for (size_t i = 0; i < m_triangles.size(); ++i)
+		{
+			m_adjacency[fill[m_weld[m_triangles[i]]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	bool Simplifier::FindCollapse(uint32_t from, uint32_t to, Collapse& collapse) const
+	{
+		uint8_t kind = m_kind[from], target = m_kind[to];
+		bool alongOpenEdge = m_loop[from] == to || m_loopBack[from] == to;
+
+		collapse = { from, to, c_None, c_None, 0.0 };
+		switch (kind)
+		{
+		case Manifold:
+			break;
+		case Border:
+			if (!alongOpenEdge || (target != Border && target != Locked))
+			{
+				return false;
+			}
+			break;
+		case Seam:
+		{
+			if (!alongOpenEdge || (target != Seam && target != Locked))
+			{
+				return false;
+			}
+			// The other copy runs the seam the opposite way, so it follows its own open edge to the same position
+			uint32_t seamFrom = m_wedge[from];
+			uint32_t seamTo = m_loop[from] == to ? m_loopBack[seamFrom] : m_loop[seamFrom];
+			if (seamTo == c_None || m_weld[seamTo] != m_weld[to])
+			{
+				return false;
+			}
+			collapse.seamFrom = seamFrom;
+			collapse.seamTo = seamTo;
+			break;
+		}
+		default:
+			return false;
+		}
+
+		collapse.error = Evaluate(m_quadrics[m_weld[from]], m_positions[to]);
+		return true;
+	}
+
+	bool Simplifier::FlipsTriangle(uint32_t from, uint32_t to) const
+	{
+		uint32_t weldFrom = m_weld[from], weldTo = m_weld[to];
+		const Vector& moved = m_positions[to];
+		for (uint32_t a = m_adjacencyStart[weldFrom]; a < m_adjacencyStart[weldFrom + 1]; ++a)
+		{
+			const uint32_t* triangle = &m_triangles[m_adjacency[a] * 3];
+			uint32_t welds[3] = { m_weld[triangle[0]], m_weld[triangle[1]], m_weld[triangle[2]] };
+			if (welds[0] == weldTo || welds[1] == weldTo || welds[2] == weldTo)
+			{
+				continue;		//collapses away
+			}
+
+			Vector before[3], after[3];
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				before[corner] = m_positions[triangle[corner]];
+				after[corner] = welds[corner] == weldFrom ? moved : before[corner];
+			}
+			Vector normalBefore = Cross(Sub(before[1], before[0]), Sub(before[2], before[0]));
+			Vector normalAfter = Cross(Sub(after[1], after[0]), Sub(after[2], after[0]));
+			if (Dot(normalBefore, normalAfter) <= 0.0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	size_t Simplifier::Run(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float targetError, float* resultError)
+	{
+		// Triangles that are already degenerate or point outside the vertices are dropped up front
+		m_triangles.clear();
+		m_triangles.reserve(indexCount);
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			if (a < m_vertexCount && b < m_vertexCount && c < m_vertexCount && m_weld[a] != m_weld[b] && m_weld[b] != m_weld[c] && m_weld[a] != m_weld[c])
+			{
+				m_triangles.insert(m_triangles.end(), { a, b, c });
+			}
+		}
+
+		ClassifyVertices();
+		BuildQuadrics();
+
+		double errorLimit = targetError / m_scale;
+		errorLimit *= errorLimit;
+		double worstError = 0.0;
+
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> remap(m_vertexCount);
+		std::vector<uint8_t> locked(m_vertexCount);
+		while (m_triangles.size() > targetIndexCount)
+		{
+			BuildAdjacency();
+
+			// Each edge once, the cheaper way round it may go. Interior edges come up from both triangles, open edges
+			// only from their one.
+			collapses.clear();
+			for (size_t i = 0; i < m_triangles.size(); i += 3)
+			{
+				for (int corner = 0; corner < 3; ++corner)
+				{
+					uint32_t a = m_triangles[i + corner], b = m_triangles[i + (corner + 1) % 3];
+					if (m_loop[a] != b && m_weld[a] > m_weld[b])
+					{
+						continue;
+					}
+
+					Collapse forward, backward;
+					bool canForward = FindCollapse(a, b, forward), canBackward = FindCollapse(b, a, backward);
+					if (canForward || canBackward)
+					{
+						collapses.push_back(!canBackward || (canForward && forward.error <= backward.error) ? forward : backward);
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+			// Cheapest first until enough triangles go, none sharing a triangle with another this pass so the flip
+			// tests see the positions they will end up with
+			std::iota(remap.begin(), remap.end(), 0u);
+			std::fill(locked.begin(), locked.end(), uint8_t(0));
+			size_t triangleGoal = (m_triangles.size() - targetIndexCount) / 3;
+			size_t removed = 0, made = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.error > errorLimit || removed >= triangleGoal)
+				{
+					break;
+				}
+				uint32_t weldFrom = m_weld[collapse.from], weldTo = m_weld[collapse.to];
+				if (locked[weldFrom] || locked[weldTo] || FlipsTriangle(collapse.from, collapse.to))
+				{
+					continue;
+				}
+
+				remap[collapse.from] = collapse.to;
+				if (collapse.seamFrom != c_None)
+				{
+					remap[collapse.seamFrom] = collapse.seamTo;
+				}
+				AddQuadric(m_quadrics[weldTo], m_quadrics[weldFrom]);
+
+				for (uint32_t a = m_adjacencyStart[weldFrom]; a < m_adjacencyStart[weldFrom + 1]; ++a)
+				{
+					const uint32_t* triangle = &m_triangles[m_adjacency[a] * 3];
+					locked[m_weld[triangle[0]]] = locked[m_weld[triangle[1]]] = locked[m_weld[triangle[2]]] = 1;
+				}
+				locked[weldTo] = 1;
+
+				removed += m_kind[collapse.from] == Border ? 1 : 2;
+				worstError = std::max(worstError, collapse.error);
+				++made;
+			}
+			if (!made)
+			{
+				break;
+			}
+
+			size_t kept = 0;
+			for (size_t i = 0; i < m_triangles.size(); i += 3)
+			{
+				uint32_t a = remap[m_triangles[i]], b = remap[m_triangles[i + 1]], c = remap[m_triangles[i + 2]];
+				if (m_weld[a] != m_weld[b] && m_weld[b] != m_weld[c] && m_weld[a] != m_weld[c])
+				{
+					m_triangles[kept++] = a;
+					m_triangles[kept++] = b;
+					m_triangles[kept++] = c;
+				}
+			}
+			m_triangles.resize(kept);
+
+			// Open edges that ran to a collapsed vertex now run to where it went, or past it when it went backwards
+			for (uint32_t v = 0; v < m_vertexCount; ++v)
+			{
+				if (m_loop[v] != c_None)
+				{
+					uint32_t next = m_loop[v];
+					m_loop[v] = remap[next] == v ? m_loop[next] : remap[next];
+				}
+				if (m_loopBack[v] != c_None)
+				{
+					uint32_t previous = m_loopBack[v];
+					m_loopBack[v] = remap[previous] == v ? m_loopBack[previous] : remap[previous];
+				}
+			}
+		}
+
+		std::copy(m_triangles.begin(), m_triangles.end(), destination);
+		if (resultError)
+		{
+			*resultError = static_cast<float>(std::sqrt(worstError) * m_scale);
+		}
+		return m_triangles.size();
+	}
+}
+
+size_t WeldVertices(const void* vertices, size_t stride, size_t vertexCount, uint32_t* remap)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+	std::unordered_set<uint32_t, VertexBytesHash, VertexBytesEqual> first(vertexCount, VertexBytesHash{ bytes, stride }, VertexBytesEqual{ bytes, stride });
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		remap[v] = *first.insert(static_cast<uint32_t>(v)).first;
+	}
+	return first.size();
+}
+
+size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+	size_t positionStride, size_t targetIndexCount, float targetError, float* resultError)
+{
+	Simplifier simplifier(positions, vertexCount, positionStride);
+	return simplifier.Run(destination, indices, indexCount, targetIndexCount, targetError, resultError);
+}
@@ -0,0 +1,31 @@
+//
+// MeshSimplifier.h - Quadric error edge collapse for building a mesh's coarser levels of detail offline
+//
+// Garland and Heckbert's quadric error metric over half edge collapses: each vertex gathers the planes of the triangles
+// around it, weighted by area, and an edge is collapsed into one of its ends at the squared distance those planes put
+// that end from the vertex that moves. Collapses only move vertices onto other existing vertices, so every level is a
+// new index list over the mesh's own vertex buffer and switching level is a different index run, not another mesh.
+//
+// Vertices are welded by position for the quadrics, and their copies are what keep the look intact: an open border
+// only collapses along itself, a uv or normal seam (a position with two copies whose open edges pair up) only along
+// the seam with both copies moving together, and a position with more copies than that never moves. Edge quadrics
+// perpendicular to the borders and seams keep them from drifting inwards, and a collapse that would turn a triangle
+// over is skipped. Each pass takes the cheapest collapses that don't touch each other, then the next pass re-evaluates.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//Maps each vertex to the first one with identical bytes and returns how many distinct ones there are. Meshes stored as
+//unrolled triangles, as ModelClass loads OBJ files, need this first so the simplifier sees which triangles connect.
+size_t WeldVertices(const void* vertices, size_t stride, size_t vertexCount, uint32_t* remap);
+
+//Simplifies a triangle list until at most targetIndexCount indices are left or the next collapse would cost more than
+//targetError, in the positions' units. Positions are three floats every positionStride bytes. Writes the remaining
+//triangles, indices into the same vertices, to destination (room for indexCount) and returns how many indices that
+//is. resultError, if given, receives the error of the costliest collapse made, the root of the mean squared distance
+//from the moved vertex to its original planes.
+size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+	size_t positionStride, size_t targetIndexCount, float targetError, float* resultError);
@@ -0,0 +1,329 @@
+// Desired mip levels and the budgeted load / evict plan
+#include "MipStreaming.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// A texture counts as in use for this many frames after an object last asked for it
+	constexpr uint64_t c_KeepFrames = 30;
+
+	uint32_t LevelSize(uint32_t size, uint32_t mip)
+	{
+		return std::max(1u, size >> mip);
+	}
+}
+
+bool MipStreaming::IsStreamable(const DDS::TextureInfo & info)
+{
+	return info.mipCount > 1 && info.mipCount <= 32 && info.depth == 1 && info.arraySize == 1 && !info.cube
+		&& DDS::GetSurfaceSize(info.format, 1, 1) > 0;
+}
+
+bool MipStreaming::CanBeTopMip(const DDS::TextureInfo & info, uint32_t mip)
+{
+	if (mip >= info.mipCount)
+	{
+		return false;
+	}
+	if (mip == 0 || !DDS::GetBytesPerBlock(info.format))
+	{
+		return true;
+	}
+	return LevelSize(info.width, mip) % 4 == 0 && LevelSize(info.height, mip) % 4 == 0;
+}
+
+uint32_t MipStreaming::GetTailMip(const DDS::TextureInfo & info, uint32_t tailSize)
+{
+	if (!IsStreamable(info))
+	{
+		return 0;
+	}
+
+	// First level small enough that can also be the top, or failing that the coarsest that can
+	uint32_t tail = 0;
+	for (uint32_t mip = 0; mip < info.mipCount; ++mip)
+	{
+		if (!CanBeTopMip(info, mip))
+		{
+			continue;
+		}
+		tail = mip;
+		if (std::max(LevelSize(info.width, mip), LevelSize(info.height, mip)) <= tailSize)
+		{
+			break;
+		}
+	}
+	return tail;
+}
+
+float MipStreaming::ComputeDesiredMip(uint32_t textureSize, float uvRepeat, float objectRadius, float distance, float pixelsPerUnit)
+{
+	float pixels = 2.0f * objectRadius * pixelsPerUnit / std::max(distance, 0.01f);
+	if (pixels <= 0.0f)
+	{
+		return 32.0f;
+	}
+
+	// One texel per pixel is level 0, every halving of the on screen size is one level coarser
+	float texelsPerPixel = float(textureSize) * uvRepeat / pixels;
+	return std::log2(std::max(texelsPerPixel, 1.0f));
+}
+
+MipBudget::MipBudget() :
+	m_budget(64 * 1024 * 1024),
+	m_frame(1)
+{
+}
+
+void MipBudget::Add(uint32_t texture, const DDS::TextureInfo & info, uint32_t residentMip)
+{
+	if (texture >= m_textures.size())
+	{
+		m_textures.resize(texture + 1);
+	}
+
+	Texture& entry = m_textures[texture];
+	entry = Texture();
+	entry.tracked = true;
+	if (MipStreaming::IsStreamable(info))
+	{
+		entry.mipCount = info.mipCount;
+		entry.tailMip = MipStreaming::GetTailMip(info);
+		entry.bytesFrom.assign(entry.mipCount + 1, 0);
+		for (uint32_t mip = entry.mipCount; mip-- > 0;)
+		{
+			entry.bytesFrom[mip] = entry.bytesFrom[mip + 1] + DDS::GetSurfaceSize(info.format, LevelSize(info.width, mip), LevelSize(info.height, mip));
+			if (MipStreaming::CanBeTopMip(info, mip))
+			{
+				entry.topMask |= 1u << mip;
+			}
+		}
+	}
+	else
+	{
+		// Always whole, a single "level" holding everything
+		entry.mipCount = 1;
+		entry.tailMip = 0;
+		entry.topMask = 1;
+		entry.bytesFrom = { DDS::GetTextureSize(info), 0 };
+	}
+	entry.residentMip = std::min(residentMip, entry.tailMip);
+}
+
+void MipBudget::Clear()
+{
+	m_textures.clear();
+}
+
+bool MipBudget::IsTracked(uint32_t texture) const
+{
+	return texture < m_textures.size() && m_textures[texture].tracked;
+}
+
+void MipBudget::Use(uint32_t texture, float mip)
+{
+	if (!IsTracked(texture))
+	{
+		return;
+	}
+
+	Texture& entry = m_textures[texture];
+	entry.desiredMip = entry.lastUsed == m_frame ? std::min(entry.desiredMip, mip) : mip;
+	entry.lastUsed = m_frame;
+}
+
+void MipBudget::Plan(std::vector<MipChange>& loads, std::vector<MipChange>& drops, uint32_t maxLoads)
+{
+	loads.clear();
+	drops.clear();
+	size_t committed = GetCommittedBytes();
+
+	// Frees space until needed more bytes fit. Textures holding levels finer than they need give those up first,
+	// then the least recently used fall back to their tail, but only if they were used before keepLastUsed so
+	// textures on screen this frame never push each other out.
+	auto evict = [&](uint32_t keep, uint64_t keepLastUsed, size_t needed)
+	{
+		while (committed + needed > m_budget)
+		{
+			uint32_t victim = c_None;
+			uint32_t victimMip = 0;
+			size_t victimFreed = 0;
+			uint64_t victimLastUsed = 0;
+			for (uint32_t i = 0; i < m_textures.size(); ++i)
+			{
+				const Texture& entry = m_textures[i];
+				if (i == keep || !entry.tracked || entry.loadingMip != c_None)
+				{
+					continue;
+				}
+
+				uint32_t target = TargetMip(entry);
+				uint32_t mip = entry.residentMip;
+				if (mip < target)
+				{
+					mip = target;
+				}
+				else if (entry.lastUsed < keepLastUsed && mip < entry.tailMip)
+				{
+					mip = entry.tailMip;
+				}
+				else
+				{
+					continue;
+				}
+
+				size_t freed = BytesAt(entry, entry.residentMip) - BytesAt(entry, mip);
+				if (victim == c_None || entry.lastUsed < victimLastUsed || (entry.lastUsed == victimLastUsed && freed > victimFreed))
+				{
+					victim = i;
+					victimMip = mip;
+					victimFreed = freed;
+					victimLastUsed = entry.lastUsed;
+				}
+			}
+			if (victim == c_None)
+			{
+				return false;
+			}
+
+			m_textures[victim].residentMip = victimMip;
+			committed -= victimFreed;
+			drops.push_back({ victim, victimMip });
+		}
+		return true;
+	};
+
+	// A lowered budget takes back from everything not on screen this frame
+	evict(c_None, m_frame, 0);
+
+	// Textures in use that want finer levels than they have, the furthest off first
+	std::vector<uint32_t> wanted;
+	for (uint32_t i = 0; i < m_textures.size(); ++i)
+	{
+		const Texture& entry = m_textures[i];
+		if (entry.tracked && entry.loadingMip == c_None && entry.lastUsed == m_frame && TargetMip(entry) < entry.residentMip)
+		{
+			wanted.push_back(i);
+		}
+	}
+	std::stable_sort(wanted.begin(), wanted.end(), [this](uint32_t a, uint32_t b)
+	{
+		return m_textures[a].residentMip - TargetMip(m_textures[a]) > m_textures[b].residentMip - TargetMip(m_textures[b]);
+	});
+
+	for (uint32_t texture : wanted)
+	{
+		if (loads.size() >= maxLoads)
+		{
+			break;
+		}
+
+		Texture& entry = m_textures[texture];
+		uint32_t target = TargetMip(entry);
+		if (!evict(texture, entry.lastUsed, BytesAt(entry, target) - BytesAt(entry, entry.residentMip)))
+		{
+			// Settle for the finest level that fits
+			while (target < entry.residentMip && committed + BytesAt(entry, target) - BytesAt(entry, entry.residentMip) > m_budget)
+			{
+				target = CoarserTopMip(entry, target + 1);
+			}
+			if (target >= entry.residentMip)
+			{
+				continue;
+			}
+		}
+
+		committed += BytesAt(entry, target) - BytesAt(entry, entry.residentMip);
+		entry.loadingMip = target;
+		loads.push_back({ texture, target });
+	}
+
+	++m_frame;
+}
+
+void MipBudget::SetResident(uint32_t texture, uint32_t mip)
+{
+	if (IsTracked(texture))
+	{
+		Texture& entry = m_textures[texture];
+		entry.residentMip = std::min(mip, entry.mipCount - 1);
+		entry.loadingMip = c_None;
+	}
+}
+
+void MipBudget::CancelLoad(uint32_t texture)
+{
+	if (IsTracked(texture))
+	{
+		m_textures[texture].loadingMip = c_None;
+	}
+}
+
+uint32_t MipBudget::GetResidentMip(uint32_t texture) const
+{
+	return IsTracked(texture) ? m_textures[texture].residentMip : 0;
+}
+
+size_t MipBudget::GetResidentBytes() const
+{
+	size_t bytes = 0;
+	for (const Texture& entry : m_textures)
+	{
+		if (entry.tracked)
+		{
+			bytes += BytesAt(entry, entry.residentMip);
+		}
+	}
+	return bytes;
+}
+
+size_t MipBudget::GetCommittedBytes() const
+{
+	size_t bytes = 0;
+	for (const Texture& entry : m_textures)
+	{
+		if (entry.tracked)
+		{
+			bytes += CommittedBytes(entry);
+		}
+	}
+	return bytes;
+}
+
+size_t MipBudget::CommittedBytes(const Texture & texture) const
+{
+	uint32_t mip = texture.loadingMip != c_None ? std::min(texture.loadingMip, texture.residentMip) : texture.residentMip;
+	return BytesAt(texture, mip);
+}
+
+uint32_t MipBudget::TargetMip(const Texture & texture) const
+{
+	if (!texture.lastUsed || texture.lastUsed + c_KeepFrames < m_frame)
+	{
+		return texture.tailMip;
+	}
+
+	float desired = std::max(texture.desiredMip, 0.0f);
+	uint32_t mip = desired >= float(texture.tailMip) ? texture.tailMip : static_cast<uint32_t>(desired);
+	return FinerTopMip(texture, mip);
+}
+
+uint32_t MipBudget::FinerTopMip(const Texture & texture, uint32_t mip) const
+{
+	while (mip > 0 && !(texture.topMask & (1u << mip)))
+	{
+		--mip;
+	}
+	return mip;
+}
+
+uint32_t MipBudget::CoarserTopMip(const Texture & texture, uint32_t mip) const
+{
+	while (mip < texture.tailMip && !(texture.topMask & (1u << mip)))
+	{
+		++mip;
+	}
+	return std::min(mip, texture.tailMip);
+}
@@ -0,0 +1,98 @@
+//
+// MipStreaming.h - Which mip levels of each texture to keep on the GPU
+//
+// Textures arrive with only their mip tail (the levels up to c_MipTailSize texels across). Each frame the objects
+// that use a texture report the finest level they can show at their size on screen, and MipBudget plans which
+// finer levels to stream in and which to drop so the total stays under a memory budget, taking space from the least
+// recently used textures first. Nothing here touches files or the device; TextureManager carries the plan out.
+//
+
+#pragma once
+
+#include "DDSFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr uint32_t c_MipTailSize = 64;
+
+namespace MipStreaming
+{
+	//Whether the texture can have its finer levels streamed: a single 2D texture with more than one level
+	bool IsStreamable(const DDS::TextureInfo& info);
+
+	//Most detailed level no larger than tailSize that can be the top of the texture, where loading starts
+	uint32_t GetTailMip(const DDS::TextureInfo& info, uint32_t tailSize = c_MipTailSize);
+
+	//Whether a level can be the most detailed one of a texture, block compressed levels need whole 4x4 blocks
+	bool CanBeTopMip(const DDS::TextureInfo& info, uint32_t mip);
+
+	//Finest level worth having for an object of the given radius at the given distance. textureSize is the larger
+	//dimension of level 0, uvRepeat how many times the texture wraps across the object and pixelsPerUnit the
+	//projected size in pixels of one world unit at distance one.
+	float ComputeDesiredMip(uint32_t textureSize, float uvRepeat, float objectRadius, float distance, float pixelsPerUnit);
+}
+
+struct MipChange
+{
+	uint32_t	texture;
+	uint32_t	mip;			//the new most detailed resident level
+};
+
+class MipBudget
+{
+public:
+	MipBudget();
+
+	void SetBudget(size_t bytes) { m_budget = bytes; }
+	size_t GetBudget() const { return m_budget; }
+
+	//Starts tracking a texture once its header is known. Textures that can't stream count with every level.
+	void Add(uint32_t texture, const DDS::TextureInfo& info, uint32_t residentMip);
+	void Clear();
+	bool IsTracked(uint32_t texture) const;
+
+	//Desired level for this frame from one of the objects using the texture, the finest request wins
+	void Use(uint32_t texture, float mip);
+
+	//Works out this frame's changes from the Use calls since the last Plan, then starts a new frame. Drops are
+	//counted as done straight away, loads once SetResident reports them; at most maxLoads are started.
+	void Plan(std::vector<MipChange>& loads, std::vector<MipChange>& drops, uint32_t maxLoads);
+
+	//A load has finished (or a level was dropped outside Plan)
+	void SetResident(uint32_t texture, uint32_t mip);
+	//A load failed, the texture keeps what it had
+	void CancelLoad(uint32_t texture);
+
+	uint32_t GetResidentMip(uint32_t texture) const;
+	size_t GetResidentBytes() const;
+	size_t GetCommittedBytes() const;		//resident plus the loads in flight
+	uint64_t GetFrame() const { return m_frame; }
+
+private:
+	static constexpr uint32_t c_None = 0xffffffff;
+
+	struct Texture
+	{
+		bool				tracked = false;
+		uint32_t			mipCount = 0;
+		uint32_t			tailMip = 0;
+		uint32_t			residentMip = 0;
+		uint32_t			loadingMip = c_None;
+		uint32_t			topMask = 0;		//bit per level that can be the top of the texture
+		float				desiredMip = 0.0f;
+		uint64_t			lastUsed = 0;		//frame of the last Use, 0 for never
+		std::vector<size_t>	bytesFrom;			//bytes in level i and every coarser one, mipCount + 1 entries
+	};
+
+	size_t BytesAt(const Texture& texture, uint32_t mip) const { return texture.bytesFrom[mip]; }
+	size_t CommittedBytes(const Texture& texture) const;
+	uint32_t TargetMip(const Texture& texture) const;
+	uint32_t FinerTopMip(const Texture& texture, uint32_t mip) const;
+	uint32_t CoarserTopMip(const Texture& texture, uint32_t mip) const;
+
+	std::vector<Texture>	m_textures;
+	size_t					m_budget;
+	uint64_t				m_frame;
+};
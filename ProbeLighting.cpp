@@ -0,0 +1,55 @@
+// Per draw upload of the blended light probes
+#include "pch.h"
+#include "ProbeLighting.h"
+
+
+ProbeLighting::ProbeLighting()
+{
+}
+
+
+ProbeLighting::~ProbeLighting()
+{
+}
+
+bool ProbeLighting::Init(ID3D11Device * device)
+{
+	D3D11_BUFFER_DESC probeBufferDesc;
+
+	// Setup the description of the dynamic probe constant buffer that is in the pixel shader.
+	probeBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	probeBufferDesc.ByteWidth = sizeof(ShProbe);
+	probeBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	probeBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	probeBufferDesc.MiscFlags = 0;
+	probeBufferDesc.StructureByteStride = 0;
+	return SUCCEEDED(device->CreateBuffer(&probeBufferDesc, NULL, m_probeBuffer.ReleaseAndGetAddressOf()));
+}
+
+void ProbeLighting::Reset()
+{
+	m_probeBuffer.Reset();
+	m_grid.Clear();
+}
+
+bool ProbeLighting::Load(const std::string & path, uint64_t sourceHash)
+{
+	if (!m_grid.Load(path) || m_grid.sourceHash != sourceHash)
+	{
+		m_grid.Clear();
+		return false;
+	}
+	return true;
+}
+
+void ProbeLighting::Set(ID3D11DeviceContext * context, const ShProbe & probe)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (FAILED(context->Map(m_probeBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+	{
+		return;
+	}
+	memcpy(mappedResource.pData, &probe, sizeof(ShProbe));
+	context->Unmap(m_probeBuffer.Get(), 0);
+	context->PSSetConstantBuffers(3, 1, m_probeBuffer.GetAddressOf());
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "LightProbes.h"
+
+//GPU side of the light probes. Owns the constant buffer probe_ps reads:
+//	b3	ProbeBuffer		SH irradiance blended for the object being drawn, rewritten before every probe lit draw
+class ProbeLighting
+{
+public:
+	ProbeLighting();
+	~ProbeLighting();
+
+	bool Init(ID3D11Device* device);
+	void Reset();
+
+	//Loads a baked grid, keeping it only if it was baked from the scene with this source hash
+	bool Load(const std::string& path, uint64_t sourceHash);
+	void Unload() { m_grid.Clear(); }
+	bool IsLoaded() const { return !m_grid.Empty(); }
+
+	//Blend of the probes around position, once per object
+	void Sample(const float position[3], ShProbe& probe) const { m_grid.Sample(position, probe); }
+
+	//Uploads and binds a probe for the next draw
+	void Set(ID3D11DeviceContext* context, const ShProbe& probe);
+
+private:
+	LightProbeGrid							m_grid;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>	m_probeBuffer;
+};
@@ -0,0 +1,183 @@
+// Rig name table and the .rig file
+#include "Rig.h"
+#include "ByteBuffer.h"
+#include "Hash.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace
+{
+	constexpr uint32_t c_Magic = 0x20474952;		//"RIG "
+	constexpr uint32_t c_Version = 1;
+	constexpr uint32_t c_MaxBones = 65536;
+	constexpr uint32_t c_MaxName = 260;
+
+	using ByteBuffer::ReadValue;
+	using ByteBuffer::WriteValue;
+
+	uint64_t HashFolded(const std::string& folded)
+	{
+		return Hash::Fnv1a(folded.data(), folded.size());
+	}
+}
+
+Rig::Rig()
+{
+}
+
+bool Rig::Set(const std::vector<std::string>& names, const uint32_t * parents, const float * bind, size_t count)
+{
+	Clear();
+	if (names.size() != count || count > c_MaxBones)
+	{
+		return false;
+	}
+	for (size_t bone = 0; bone < count; ++bone)
+	{
+		if (parents[bone] != c_NoBone && parents[bone] >= count)
+		{
+			return false;
+		}
+	}
+
+	m_names = names;
+	m_parents.assign(parents, parents + count);
+	m_bind.assign(bind, bind + count * 16);
+	BuildTable();
+	return true;
+}
+
+void Rig::Clear()
+{
+	m_names.clear();
+	m_folded.clear();
+	m_parents.clear();
+	m_bind.clear();
+	m_slots.clear();
+	m_slotHashes.clear();
+}
+
+uint32_t Rig::Find(const std::string & name) const
+{
+	if (m_slots.empty())
+	{
+		return c_NoBone;
+	}
+
+	std::string folded = FoldName(name);
+	uint64_t hash = HashFolded(folded);
+	const size_t mask = m_slots.size() - 1;
+	for (size_t slot = hash & mask; m_slots[slot] != c_NoBone; slot = (slot + 1) & mask)
+	{
+		if (m_slotHashes[slot] == static_cast<uint32_t>(hash) && m_folded[m_slots[slot]] == folded)
+		{
+			return m_slots[slot];
+		}
+	}
+	return c_NoBone;
+}
+
+void Rig::BuildTable()
+{
+	size_t slotCount = 4;
+	while (slotCount < m_names.size() * 2)
+	{
+		slotCount *= 2;
+	}
+	m_slots.assign(slotCount, c_NoBone);
+	m_slotHashes.assign(slotCount, 0);
+	m_folded.resize(m_names.size());
+
+	// Linear probing, at most half full. A name already in the table keeps the first bone.
+	const size_t mask = slotCount - 1;
+	for (size_t bone = 0; bone < m_names.size(); ++bone)
+	{
+		m_folded[bone] = FoldName(m_names[bone]);
+		uint64_t hash = HashFolded(m_folded[bone]);
+		size_t slot = hash & mask;
+		while (m_slots[slot] != c_NoBone && m_folded[m_slots[slot]] != m_folded[bone])
+		{
+			slot = (slot + 1) & mask;
+		}
+		if (m_slots[slot] == c_NoBone)
+		{
+			m_slots[slot] = static_cast<uint32_t>(bone);
+			m_slotHashes[slot] = static_cast<uint32_t>(hash);
+		}
+	}
+}
+
+std::string Rig::FoldName(const std::string & name)
+{
+	std::string folded(name);
+	for (char& c : folded)
+	{
+		c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	return folded;
+}
+
+void Rig::Serialize(std::vector<uint8_t>& out) const
+{
+	WriteValue(out, c_Magic);
+	WriteValue(out, c_Version);
+	WriteValue(out, static_cast<uint32_t>(m_names.size()));
+	for (size_t bone = 0; bone < m_names.size(); ++bone)
+	{
+		const std::string& name = m_names[bone];
+		WriteValue(out, static_cast<uint32_t>(name.size()));
+		out.insert(out.end(), name.begin(), name.end());
+		WriteValue(out, m_parents[bone]);
+		const uint8_t* bind = reinterpret_cast<const uint8_t*>(&m_bind[bone * 16]);
+		out.insert(out.end(), bind, bind + 16 * sizeof(float));
+	}
+}
+
+bool Rig::Deserialize(const uint8_t * data, size_t size)
+{
+	Clear();
+	size_t offset = 0;
+	uint32_t magic, version, count;
+	if (!ReadValue(data, size, offset, magic) || !ReadValue(data, size, offset, version) || !ReadValue(data, size, offset, count)
+		|| magic != c_Magic || version != c_Version || count > c_MaxBones)
+	{
+		return false;
+	}
+
+	std::vector<std::string> names(count);
+	std::vector<uint32_t> parents(count);
+	std::vector<float> bind(size_t(count) * 16);
+	for (uint32_t bone = 0; bone < count; ++bone)
+	{
+		uint32_t length;
+		if (!ReadValue(data, size, offset, length) || length > c_MaxName || size - offset < length)
+		{
+			return false;
+		}
+		names[bone].assign(reinterpret_cast<const char*>(data + offset), length);
+		offset += length;
+
+		if (!ReadValue(data, size, offset, parents[bone]) || size - offset < 16 * sizeof(float))
+		{
+			return false;
+		}
+		std::memcpy(&bind[bone * 16], data + offset, 16 * sizeof(float));
+		offset += 16 * sizeof(float);
+	}
+	return offset == size && Set(names, parents.data(), bind.data(), count);
+}
+
+bool Rig::Save(const std::string & path) const
+{
+	std::vector<uint8_t> data;
+	Serialize(data);
+	return ByteBuffer::WriteFile(path, data);
+}
+
+bool Rig::Load(const std::string & path)
+{
+	Clear();
+	std::vector<uint8_t> data;
+	return ByteBuffer::ReadFile(path, data) && Deserialize(data.data(), data.size());
+}
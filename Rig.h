@@ -0,0 +1,57 @@
+//
+// Rig.h - A model's bones by name: hierarchy, bind transforms and a hashed name lookup
+//
+// Built once from the model's frames, or read from the .rig file Tools/BakeRig writes next to the mesh, and kept on
+// the CPU, so a device restore rebinds the clips and the crowd without walking the model's bones again. Names are
+// case-folded as they go in and hashed into an open addressed table, Find is a hash, a probe or two and one string
+// compare whatever the bone count.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Rig
+{
+public:
+	static constexpr uint32_t c_NoBone = 0xffffffffu;		//Find's miss, and the parent of a root
+
+	Rig();
+
+	//count bones: names, parents (c_NoBone for roots) and bind transforms (row major 4x4). False if a parent is out of
+	//range or the count is too big, and the rig is then empty. A name given twice finds the first bone.
+	bool Set(const std::vector<std::string>& names, const uint32_t* parents, const float* bind, size_t count);
+	void Clear();
+
+	//Bone of that name ignoring case, c_NoBone if the rig hasn't got one
+	uint32_t Find(const std::string& name) const;
+
+	size_t GetCount() const { return m_names.size(); }
+	bool Empty() const { return m_names.empty(); }
+	const std::vector<std::string>& GetNames() const { return m_names; }		//as given, not folded
+	const std::string& GetName(size_t bone) const { return m_names[bone]; }
+	const uint32_t* GetParents() const { return m_parents.data(); }
+	const float* GetBind() const { return m_bind.data(); }
+
+	//Binary form of the .rig file: a small header, then per bone its name, parent and bind transform. The table is
+	//rebuilt on load, it's cheaper than reading it.
+	void Serialize(std::vector<uint8_t>& out) const;
+	bool Deserialize(const uint8_t* data, size_t size);
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	static std::string FoldName(const std::string& name);
+
+private:
+	void BuildTable();
+
+	std::vector<std::string>	m_names;
+	std::vector<std::string>	m_folded;
+	std::vector<uint32_t>		m_parents;
+	std::vector<float>			m_bind;
+	std::vector<uint32_t>		m_slots;		//bone per slot or c_NoBone, a power of two at least twice the bone count
+	std::vector<uint32_t>		m_slotHashes;	//low half of each slot's hash, compared before the names
+};
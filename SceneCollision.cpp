@@ -0,0 +1,536 @@
+// Box tree build, swept sphere against a rounded box and sliding
+#include "SceneCollision.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	constexpr uint32_t c_MaxLeafSize = 4;
+	constexpr uint32_t c_StackSize = 64;
+	constexpr float c_Parallel = 1e-12f;
+
+	inline float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Squared distance from p to the box and the closest point of it
+	float SquaredDistance(const float p[3], const CollisionBox& box, float closest[3])
+	{
+		float d2 = 0.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			closest[k] = std::min(std::max(p[k], box.min[k]), box.max[k]);
+			d2 += (p[k] - closest[k]) * (p[k] - closest[k]);
+		}
+		return d2;
+	}
+
+	// Axis and side of the face nearest to a point inside the box
+	void NearestFace(const float p[3], const CollisionBox& box, int& axis, float& side, float& depth)
+	{
+		depth = FLT_MAX;
+		for (int k = 0; k < 3; ++k)
+		{
+			if (p[k] - box.min[k] < depth)
+			{
+				depth = p[k] - box.min[k];
+				axis = k;
+				side = -1.0f;
+			}
+			if (box.max[k] - p[k] < depth)
+			{
+				depth = box.max[k] - p[k];
+				axis = k;
+				side = 1.0f;
+			}
+		}
+	}
+
+	// The ray from origin by move against a box grown by grow, entering at tNear, as Bvh's RayBox
+	bool RayBox(const float origin[3], const float invMove[3], const float boxMin[3], const float boxMax[3], float grow, float tMax, float& tNear)
+	{
+		float t0 = 0.0f, t1 = tMax;
+		for (int k = 0; k < 3; ++k)
+		{
+			float a = (boxMin[k] - grow - origin[k]) * invMove[k];
+			float b = (boxMax[k] + grow - origin[k]) * invMove[k];
+			t0 = std::max(t0, std::min(a, b));
+			t1 = std::min(t1, std::max(a, b));
+		}
+		tNear = t0;
+		return t0 <= t1;
+	}
+
+	// First time in 0 to 1 the ray is within radius of a point
+	bool RaySphere(const float origin[3], const float move[3], const float centre[3], float radius, float& t)
+	{
+		float m[3] = { origin[0] - centre[0], origin[1] - centre[1], origin[2] - centre[2] };
+		float a = Dot(move, move);
+		float b = Dot(m, move);
+		float c = Dot(m, m) - radius * radius;
+		if (a <= c_Parallel || (c > 0.0f && b > 0.0f))
+		{
+			return false;
+		}
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+		{
+			return false;
+		}
+		t = std::max((-b - std::sqrt(discriminant)) / a, 0.0f);
+		return t <= 1.0f;
+	}
+
+	// First time in 0 to 1 the ray is within radius of the box's edge along axis k at corner, the side of the edge
+	// then its two ends
+	bool RayEdge(const float origin[3], const float move[3], float radius, const CollisionBox& box, int k, const float corner[3], float& t)
+	{
+		int i = (k + 1) % 3, j = (k + 2) % 3;
+		float mi = origin[i] - corner[i], mj = origin[j] - corner[j];
+		float a = move[i] * move[i] + move[j] * move[j];
+		float b = mi * move[i] + mj * move[j];
+		float c = mi * mi + mj * mj - radius * radius;
+		if (a > c_Parallel && !(c > 0.0f && b > 0.0f))
+		{
+			float discriminant = b * b - a * c;
+			if (discriminant >= 0.0f)
+			{
+				float side = std::max((-b - std::sqrt(discriminant)) / a, 0.0f);
+				float along = origin[k] + side * move[k];
+				if (side <= 1.0f && along >= box.min[k] && along <= box.max[k])
+				{
+					t = side;
+					return true;
+				}
+			}
+		}
+
+		bool hit = false;
+		t = FLT_MAX;
+		for (float end : { box.min[k], box.max[k] })
+		{
+			float centre[3] = { corner[0], corner[1], corner[2] };
+			centre[k] = end;
+			float tEnd;
+			if (RaySphere(origin, move, centre, radius, tEnd) && tEnd < t)
+			{
+				t = tEnd;
+				hit = true;
+			}
+		}
+		return hit;
+	}
+}
+
+bool SweepSphereBox(const float origin[3], const float move[3], float radius, const CollisionBox& box, float& t, float normal[3])
+{
+	// Already overlapping, only a move further in is stopped
+	float closest[3];
+	float d2 = SquaredDistance(origin, box, closest);
+	if (d2 < radius * radius)
+	{
+		if (d2 > 0.0f)
+		{
+			float invLength = 1.0f / std::sqrt(d2);
+			for (int k = 0; k < 3; ++k)
+			{
+				normal[k] = (origin[k] - closest[k]) * invLength;
+			}
+		}
+		else
+		{
+			int axis = 0;
+			float side = 0.0f, depth;
+			NearestFace(origin, box, axis, side, depth);
+			normal[0] = normal[1] = normal[2] = 0.0f;
+			normal[axis] = side;
+		}
+		t = 0.0f;
+		return Dot(move, normal) < 0.0f;
+	}
+
+	// Slab test against the box grown by the radius, which holds the rounded box
+	float tEnter = 0.0f, tExit = 1.0f;
+	int enterAxis = -1;
+	for (int k = 0; k < 3; ++k)
+	{
+		if (std::fabs(move[k]) <= c_Parallel)
+		{
+			if (origin[k] < box.min[k] - radius || origin[k] > box.max[k] + radius)
+			{
+				return false;
+			}
+			continue;
+		}
+		float inv = 1.0f / move[k];
+		float a = (box.min[k] - radius - origin[k]) * inv;
+		float b = (box.max[k] + radius - origin[k]) * inv;
+		if (a > b)
+		{
+			std::swap(a, b);
+		}
+		if (a > tEnter)
+		{
+			tEnter = a;
+			enterAxis = k;
+		}
+		tExit = std::min(tExit, b);
+		if (tEnter > tExit)
+		{
+			return false;
+		}
+	}
+
+	// Entering through a face is the contact. Past two or three of the box's sides it's an edge or a corner that is
+	// met first, the edge there or the three edges from the corner.
+	float p[3];
+	int outside[3], outsideCount = 0, inside = 0;
+	for (int k = 0; k < 3; ++k)
+	{
+		p[k] = origin[k] + tEnter * move[k];
+		if (p[k] < box.min[k] || p[k] > box.max[k])
+		{
+			outside[outsideCount++] = k;
+		}
+		else
+		{
+			inside = k;
+		}
+	}
+
+	t = tEnter;
+	if (outsideCount >= 2)
+	{
+		float corner[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			corner[k] = p[k] < (box.min[k] + box.max[k]) * 0.5f ? box.min[k] : box.max[k];
+		}
+		bool hit = false;
+		t = FLT_MAX;
+		for (int e = 0; e < 3; ++e)
+		{
+			// With two sides out the edge runs along the third axis, with three every axis has one
+			int k = outsideCount == 2 ? inside : outside[e];
+			float tEdge;
+			if (RayEdge(origin, move, radius, box, k, corner, tEdge) && tEdge < t)
+			{
+				t = tEdge;
+				hit = true;
+			}
+			if (outsideCount == 2)
+			{
+				break;
+			}
+		}
+		if (!hit)
+		{
+			return false;
+		}
+	}
+
+	// Normal from the box to the centre at contact, the face entered through if that is too close to tell
+	float contact[3] = { origin[0] + t * move[0], origin[1] + t * move[1], origin[2] + t * move[2] };
+	d2 = SquaredDistance(contact, box, closest);
+	if (d2 > radius * radius * 1e-6f)
+	{
+		float invLength = 1.0f / std::sqrt(d2);
+		for (int k = 0; k < 3; ++k)
+		{
+			normal[k] = (contact[k] - closest[k]) * invLength;
+		}
+	}
+	else if (enterAxis >= 0)
+	{
+		normal[0] = normal[1] = normal[2] = 0.0f;
+		normal[enterAxis] = move[enterAxis] < 0.0f ? 1.0f : -1.0f;
+	}
+	else
+	{
+		return false;
+	}
+	return Dot(move, normal) < 0.0f;
+}
+
+SceneCollision::SceneCollision()
+{
+}
+
+void SceneCollision::Clear()
+{
+	m_nodes.clear();
+	m_boxes.clear();
+	m_ids.clear();
+}
+
+void SceneCollision::Build(const CollisionBox * boxes, size_t count)
+{
+	Clear();
+	if (!count)
+	{
+		return;
+	}
+
+	std::vector<uint32_t> order(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		order[i] = static_cast<uint32_t>(i);
+	}
+	auto centre = [boxes](uint32_t box, int axis) { return boxes[box].min[axis] + boxes[box].max[axis]; };
+
+	// Split ranges of order[] at the median of the widest spread of centres until they are small enough to be
+	// leaves, children always pushed as a pair
+	struct Task
+	{
+		uint32_t	node;
+		uint32_t	first;
+		uint32_t	count;
+	};
+	std::vector<Task> tasks;
+	m_nodes.reserve(count * 2 / c_MaxLeafSize + 1);
+	m_nodes.push_back(Node());
+	tasks.push_back({ 0, 0, static_cast<uint32_t>(count) });
+
+	while (!tasks.empty())
+	{
+		Task task = tasks.back();
+		tasks.pop_back();
+
+		float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		float centreMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, centreMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t i = task.first; i < task.first + task.count; ++i)
+		{
+			const CollisionBox& box = boxes[order[i]];
+			for (int k = 0; k < 3; ++k)
+			{
+				boundsMin[k] = std::min(boundsMin[k], box.min[k]);
+				boundsMax[k] = std::max(boundsMax[k], box.max[k]);
+				centreMin[k] = std::min(centreMin[k], centre(order[i], k));
+				centreMax[k] = std::max(centreMax[k], centre(order[i], k));
+			}
+		}
+
+		Node& node = m_nodes[task.node];
+		for (int k = 0; k < 3; ++k)
+		{
+			node.min[k] = boundsMin[k];
+			node.max[k] = boundsMax[k];
+		}
+		node.first = task.first;
+		node.count = task.count;
+		if (task.count <= c_MaxLeafSize)
+		{
+			continue;
+		}
+
+		int axis = 0;
+		for (int k = 1; k < 3; ++k)
+		{
+			if (centreMax[k] - centreMin[k] > centreMax[axis] - centreMin[axis])
+			{
+				axis = k;
+			}
+		}
+		uint32_t leftCount = task.count / 2;
+		std::nth_element(order.begin() + task.first, order.begin() + task.first + leftCount, order.begin() + task.first + task.count,
+			[&](uint32_t a, uint32_t b) { return centre(a, axis) < centre(b, axis) || (centre(a, axis) == centre(b, axis) && a < b); });
+
+		uint32_t children = static_cast<uint32_t>(m_nodes.size());
+		m_nodes[task.node].first = children;
+		m_nodes[task.node].count = 0;
+		m_nodes.push_back(Node());
+		m_nodes.push_back(Node());
+		tasks.push_back({ children, task.first, leftCount });
+		tasks.push_back({ children + 1, task.first + leftCount, task.count - leftCount });
+	}
+
+	// Leaves index straight into m_boxes, which follows the final order
+	m_boxes.resize(count);
+	m_ids.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_boxes[i] = boxes[order[i]];
+		m_ids[i] = order[i];
+	}
+}
+
+bool SceneCollision::Sweep(const float origin[3], const float move[3], float radius, CollisionHit & hit) const
+{
+	hit.t = 1.0f;
+	hit.normal[0] = hit.normal[1] = hit.normal[2] = 0.0f;
+	hit.box = c_NoBox;
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	float invMove[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		invMove[k] = 1.0f / move[k];
+	}
+
+	float tNear;
+	if (!RayBox(origin, invMove, m_nodes[0].min, m_nodes[0].max, radius, hit.t, tNear))
+	{
+		return false;
+	}
+
+	uint32_t stack[c_StackSize];
+	uint32_t depth = 0;
+	stack[depth++] = 0;
+
+	while (depth)
+	{
+		const Node& node = m_nodes[stack[--depth]];
+
+		if (node.count)
+		{
+			// The earliest contact, the first box passed to Build of those touched at once
+			for (uint32_t i = node.first; i < node.first + node.count; ++i)
+			{
+				float t, normal[3];
+				if (SweepSphereBox(origin, move, radius, m_boxes[i], t, normal) && (t < hit.t || (t == hit.t && m_ids[i] < hit.box)))
+				{
+					hit.t = t;
+					hit.normal[0] = normal[0];
+					hit.normal[1] = normal[1];
+					hit.normal[2] = normal[2];
+					hit.box = m_ids[i];
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first, pushing it last
+		const Node& a = m_nodes[node.first];
+		const Node& b = m_nodes[node.first + 1];
+		float tA, tB;
+		bool hitA = RayBox(origin, invMove, a.min, a.max, radius, hit.t, tA);
+		bool hitB = RayBox(origin, invMove, b.min, b.max, radius, hit.t, tB);
+		if (hitA && hitB)
+		{
+			if (depth + 2 > c_StackSize)
+			{
+				continue;
+			}
+			stack[depth++] = tA < tB ? node.first + 1 : node.first;
+			stack[depth++] = tA < tB ? node.first : node.first + 1;
+		}
+		else if ((hitA || hitB) && depth < c_StackSize)
+		{
+			stack[depth++] = hitA ? node.first : node.first + 1;
+		}
+	}
+
+	return hit.box != c_NoBox;
+}
+
+void SceneCollision::PushOut(float position[3], float radius, float skin) const
+{
+	for (uint32_t pass = 0; pass < c_MaxSlides && !m_nodes.empty(); ++pass)
+	{
+		bool pushed = false;
+		uint32_t stack[c_StackSize];
+		uint32_t depth = 0;
+		stack[depth++] = 0;
+		while (depth)
+		{
+			const Node& node = m_nodes[stack[--depth]];
+			bool overlaps = true;
+			for (int k = 0; k < 3; ++k)
+			{
+				overlaps = overlaps && position[k] + radius > node.min[k] && position[k] - radius < node.max[k];
+			}
+			if (!overlaps)
+			{
+				continue;
+			}
+			if (!node.count)
+			{
+				if (depth + 2 <= c_StackSize)
+				{
+					stack[depth++] = node.first;
+					stack[depth++] = node.first + 1;
+				}
+				continue;
+			}
+
+			for (uint32_t i = node.first; i < node.first + node.count; ++i)
+			{
+				const CollisionBox& box = m_boxes[i];
+				float closest[3];
+				float d2 = SquaredDistance(position, box, closest);
+				if (d2 >= radius * radius)
+				{
+					continue;
+				}
+				if (d2 > 0.0f)
+				{
+					float distance = std::sqrt(d2);
+					float scale = (radius + skin - distance) / distance;
+					for (int k = 0; k < 3; ++k)
+					{
+						position[k] += (position[k] - closest[k]) * scale;
+					}
+				}
+				else
+				{
+					int axis = 0;
+					float side = 0.0f, faceDepth;
+					NearestFace(position, box, axis, side, faceDepth);
+					position[axis] += side * (faceDepth + radius + skin);
+				}
+				pushed = true;
+			}
+		}
+		if (!pushed)
+		{
+			return;
+		}
+	}
+}
+
+uint32_t SceneCollision::Move(float position[3], const float move[3], float radius, float skin) const
+{
+	PushOut(position, radius, skin);
+
+	float remaining[3] = { move[0], move[1], move[2] };
+	uint32_t contacts = 0;
+	for (uint32_t slide = 0; slide < c_MaxSlides; ++slide)
+	{
+		float length2 = Dot(remaining, remaining);
+		if (length2 <= c_Parallel)
+		{
+			break;
+		}
+
+		CollisionHit hit;
+		if (!Sweep(position, remaining, radius, hit))
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				position[k] += remaining[k];
+			}
+			break;
+		}
+
+		// Up to skin short of the contact, then what is left of the move without the part into the box
+		++contacts;
+		float t = std::max(hit.t - skin / std::sqrt(length2), 0.0f);
+		for (int k = 0; k < 3; ++k)
+		{
+			position[k] += remaining[k] * t;
+			remaining[k] *= 1.0f - t;
+		}
+		float into = Dot(remaining, hit.normal);
+		for (int k = 0; k < 3; ++k)
+		{
+			remaining[k] -= hit.normal[k] * into;
+		}
+	}
+	return contacts;
+}
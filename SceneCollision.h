@@ -0,0 +1,77 @@
+//
+// SceneCollision.h - Swept sphere collision against the static scene's boxes, for moving the camera
+//
+// The colliders are axis aligned boxes, the walls, floors and ceilings being boxes themselves. They are kept in a tree
+// laid out like Bvh's, split at the median of the widest spread of centres and flattened with children next to each
+// other. A sweep walks it as a ray against each node grown by the sphere's radius, nearest child first and only as far
+// as the closest contact so far.
+//
+// A sphere against one box is a ray against the box rounded by the radius: the faces pushed out, the edges as
+// cylinders and the corners as spheres. The contact normal points from the box to the sphere's centre, and Move slides
+// what is left of the move along it, a few times over for corners, so walking into a wall at an angle runs along it.
+// A sphere that starts inside a box, after the camera is put back at its start or a box is moved onto it, is pushed
+// out the nearest way first.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct CollisionBox
+{
+	float	min[3];
+	float	max[3];
+};
+
+struct CollisionHit
+{
+	float		t;				//0 to 1 along the move
+	float		normal[3];		//unit, from the box to the sphere's centre at contact
+	uint32_t	box;			//index of the box as passed to Build
+};
+
+//The first contact of a sphere moving from origin by move with one box, false if there is none before the end of the
+//move or the sphere is moving away from it. A sphere already overlapping the box hits at 0 if it is moving further in.
+bool SweepSphereBox(const float origin[3], const float move[3], float radius, const CollisionBox& box, float& t, float normal[3]);
+
+class SceneCollision
+{
+public:
+	static constexpr uint32_t c_MaxSlides = 4;
+	static constexpr uint32_t c_NoBox = 0xffffffffu;
+
+	SceneCollision();
+
+	void Build(const CollisionBox* boxes, size_t count);
+	void Clear();
+
+	//The first box the sphere touches on the way, as SweepSphereBox over every box
+	bool Sweep(const float origin[3], const float move[3], float radius, CollisionHit& hit) const;
+
+	//Moves a sphere by move, stopping skin short of each contact and sliding along it. Returns how many contacts
+	//there were.
+	uint32_t Move(float position[3], const float move[3], float radius, float skin = 1e-3f) const;
+
+	bool Empty() const { return m_nodes.empty(); }
+	size_t GetBoxCount() const { return m_boxes.size(); }
+	size_t GetNodeCount() const { return m_nodes.size(); }
+
+private:
+	//32 bytes. Interior nodes have count 0 and their children at first and first + 1.
+	struct Node
+	{
+		float		min[3];
+		uint32_t	first;
+		float		max[3];
+		uint32_t	count;
+	};
+
+	//Pushes the sphere out of the boxes it overlaps, nearest way out first
+	void PushOut(float position[3], float radius, float skin) const;
+
+	std::vector<Node>			m_nodes;
+	std::vector<CollisionBox>	m_boxes;		//in leaf order
+	std::vector<uint32_t>		m_ids;			//index passed to Build of each of m_boxes
+};
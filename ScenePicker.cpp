@@ -0,0 +1,239 @@
+// Instance culling, rays into object space and screen rays
+#include "ScenePicker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+	// Inverse of a 4x4 by cofactors, in double so a projection's small and large terms survive. False if singular.
+	bool Invert(const double a[16], double out[16])
+	{
+		double inv[16];
+		inv[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+		inv[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+		inv[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+		inv[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+		inv[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+		inv[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+		inv[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+		inv[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+		inv[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+		inv[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+		inv[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+		inv[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+		inv[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+		inv[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+		inv[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+		inv[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+		double det = a[0] * inv[0] + a[1] * inv[4] + a[2] * inv[8] + a[3] * inv[12];
+		if (!std::isfinite(det) || std::fabs(det) < 1e-30)
+		{
+			return false;
+		}
+		double invDet = 1.0 / det;
+		for (int i = 0; i < 16; ++i)
+		{
+			out[i] = inv[i] * invDet;
+		}
+		return true;
+	}
+
+	bool Invert(const float m[16], float out[16])
+	{
+		double a[16], inv[16];
+		for (int i = 0; i < 16; ++i)
+		{
+			a[i] = m[i];
+		}
+		if (!Invert(a, inv))
+		{
+			return false;
+		}
+		for (int i = 0; i < 16; ++i)
+		{
+			out[i] = static_cast<float>(inv[i]);
+		}
+		return true;
+	}
+
+	// Row vector times a matrix, w of 1 for points and 0 for directions
+	void Transform(const float v[3], float w, const float m[16], float out[3])
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			out[c] = v[0] * m[c] + v[1] * m[4 + c] + v[2] * m[8 + c] + w * m[12 + c];
+		}
+	}
+
+	// As Bvh's RayBox, entering at tNear
+	bool RayBox(const float origin[3], const float invDirection[3], const float boxMin[3], const float boxMax[3], float tMax, float& tNear)
+	{
+		float t0 = 0.0f, t1 = tMax;
+		for (int k = 0; k < 3; ++k)
+		{
+			float a = (boxMin[k] - origin[k]) * invDirection[k];
+			float b = (boxMax[k] - origin[k]) * invDirection[k];
+			t0 = std::max(t0, std::min(a, b));
+			t1 = std::min(t1, std::max(a, b));
+		}
+		tNear = t0;
+		return t0 <= t1;
+	}
+}
+
+ScenePicker::ScenePicker()
+{
+}
+
+void ScenePicker::Clear()
+{
+	m_meshes.clear();
+	m_instances.clear();
+}
+
+uint32_t ScenePicker::AddMesh(const float * positions, size_t vertexCount, const uint32_t * indices, size_t triangleCount)
+{
+	m_meshes.emplace_back();
+	m_meshes.back().Build(positions, vertexCount, indices, triangleCount);
+	return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+uint32_t ScenePicker::AddInstance(uint32_t mesh, uint32_t object, const float world[16])
+{
+	Instance instance = {};
+	instance.mesh = mesh;
+	instance.object = object;
+	m_instances.push_back(instance);
+	uint32_t index = static_cast<uint32_t>(m_instances.size() - 1);
+	SetWorld(index, world);
+	return index;
+}
+
+void ScenePicker::SetWorld(uint32_t instance, const float world[16])
+{
+	Instance& placed = m_instances[instance];
+	const Bvh& mesh = m_meshes[placed.mesh];
+	placed.valid = !mesh.Empty() && Invert(world, placed.inverse);
+	if (!placed.valid)
+	{
+		return;
+	}
+
+	// World bounds of the mesh's bounds, each axis of the box taken through the matrix (Arvo)
+	float boundsMin[3], boundsMax[3];
+	mesh.GetBounds(boundsMin, boundsMax);
+	for (int c = 0; c < 3; ++c)
+	{
+		placed.min[c] = placed.max[c] = world[12 + c];
+		for (int r = 0; r < 3; ++r)
+		{
+			float a = boundsMin[r] * world[r * 4 + c];
+			float b = boundsMax[r] * world[r * 4 + c];
+			placed.min[c] += std::min(a, b);
+			placed.max[c] += std::max(a, b);
+		}
+	}
+}
+
+bool ScenePicker::Pick(const BvhRay & ray, PickHit & hit) const
+{
+	hit.t = ray.tMax;
+	hit.u = hit.v = 0.0f;
+	hit.object = hit.instance = hit.triangle = c_NoHit;
+
+	float invDirection[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		invDirection[k] = 1.0f / ray.direction[k];
+	}
+
+	// Instances whose bounds the ray enters, nearest first
+	std::vector<std::pair<float, uint32_t>> candidates;
+	for (size_t i = 0; i < m_instances.size(); ++i)
+	{
+		const Instance& instance = m_instances[i];
+		float tNear;
+		if (instance.valid && RayBox(ray.origin, invDirection, instance.min, instance.max, hit.t, tNear))
+		{
+			candidates.push_back({ tNear, static_cast<uint32_t>(i) });
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	for (const auto& candidate : candidates)
+	{
+		if (candidate.first > hit.t)
+		{
+			break;
+		}
+
+		// The same ray in object space, only as far as the closest hit so far
+		const Instance& instance = m_instances[candidate.second];
+		BvhRay local;
+		Transform(ray.origin, 1.0f, instance.inverse, local.origin);
+		Transform(ray.direction, 0.0f, instance.inverse, local.direction);
+		local.tMax = hit.t;
+
+		BvhHit meshHit;
+		if (m_meshes[instance.mesh].Intersect(local, meshHit) && meshHit.t < hit.t)
+		{
+			hit.t = meshHit.t;
+			hit.u = meshHit.u;
+			hit.v = meshHit.v;
+			hit.object = instance.object;
+			hit.instance = candidate.second;
+			hit.triangle = meshHit.triangle;
+		}
+	}
+	return hit.instance != c_NoHit;
+}
+
+bool ScenePicker::ScreenRay(float x, float y, float width, float height, const float view[16], const float projection[16], BvhRay & ray)
+{
+	// All in double: with a near plane close in, the far end is many times the near one's distance away
+	double viewProjection[16];
+	for (int r = 0; r < 4; ++r)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			viewProjection[r * 4 + c] = double(view[r * 4]) * projection[c] + double(view[r * 4 + 1]) * projection[4 + c]
+				+ double(view[r * 4 + 2]) * projection[8 + c] + double(view[r * 4 + 3]) * projection[12 + c];
+		}
+	}
+	double inverse[16];
+	if (!(width > 0.0f) || !(height > 0.0f) || !Invert(viewProjection, inverse))
+	{
+		return false;
+	}
+
+	// The pixel on the near and far planes, y down on screen and up in clip space
+	double clip[2] = { double(x) / width * 2.0 - 1.0, 1.0 - double(y) / height * 2.0 };
+	double ends[2][3];
+	for (int end = 0; end < 2; ++end)
+	{
+		double point[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			point[c] = clip[0] * inverse[c] + clip[1] * inverse[4 + c] + end * inverse[8 + c] + inverse[12 + c];
+		}
+		if (point[3] == 0.0)
+		{
+			return false;
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			ends[end][k] = point[k] / point[3];
+		}
+	}
+
+	for (int k = 0; k < 3; ++k)
+	{
+		ray.origin[k] = static_cast<float>(ends[0][k]);
+		ray.direction[k] = static_cast<float>(ends[1][k] - ends[0][k]);
+	}
+	ray.tMax = 1.0f;
+	return true;
+}
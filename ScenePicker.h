@@ -0,0 +1,73 @@
+//
+// ScenePicker.h - Which object and triangle is under a screen position, for clicking on the scene
+//
+// Each distinct mesh gets its own Bvh in object space, built once, and the scene places instances of them with a world
+// matrix that can change every frame for nothing more than inverting it. A pick takes the instances whose world bounds
+// the ray passes through, nearest first, carries the ray into each one's object space and casts it against its mesh,
+// stopping once the next instance starts beyond the closest hit so far. A ray carried through an affine transform keeps
+// its t, so hits in different instances compare directly.
+//
+// ScreenRay unprojects a pixel through the inverse of view times projection, so any projection works, and the ray runs
+// from the near plane at t 0 to the far plane at t 1.
+//
+
+#pragma once
+
+#include "Bvh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct PickHit
+{
+	float		t;				//along the ray, in units of its direction's length
+	float		u;				//barycentrics of the hit, weight of vertex 1 and vertex 2
+	float		v;
+	uint32_t	object;			//as given to AddInstance
+	uint32_t	instance;
+	uint32_t	triangle;		//of the instance's mesh, as passed to AddMesh
+};
+
+class ScenePicker
+{
+public:
+	static constexpr uint32_t c_NoHit = Bvh::c_NoHit;
+
+	ScenePicker();
+
+	//Object space positions (xyz per vertex) and triangles of a mesh, returns its index for AddInstance
+	uint32_t AddMesh(const float* positions, size_t vertexCount, const uint32_t* indices, size_t triangleCount);
+
+	//A mesh placed by a world matrix (row vector, SimpleMath layout), reported as object when it is hit. A world that
+	//can't be inverted leaves the instance out of picks until SetWorld gives it one that can.
+	uint32_t AddInstance(uint32_t mesh, uint32_t object, const float world[16]);
+	void SetWorld(uint32_t instance, const float world[16]);
+
+	void ClearInstances() { m_instances.clear(); }
+	void Clear();
+
+	size_t GetMeshCount() const { return m_meshes.size(); }
+	size_t GetInstanceCount() const { return m_instances.size(); }
+
+	//Closest hit before ray.tMax over every instance. Triangles are hit from both sides.
+	bool Pick(const BvhRay& ray, PickHit& hit) const;
+
+	//The ray through pixel (x, y) of a width by height viewport, from row vector view and projection matrices. False
+	//if they can't be inverted.
+	static bool ScreenRay(float x, float y, float width, float height, const float view[16], const float projection[16], BvhRay& ray);
+
+private:
+	struct Instance
+	{
+		float		inverse[16];		//world to object
+		float		min[3];				//world bounds of the mesh's bounds
+		float		max[3];
+		uint32_t	mesh;
+		uint32_t	object;
+		bool		valid;
+	};
+
+	std::vector<Bvh>		m_meshes;
+	std::vector<Instance>	m_instances;
+};
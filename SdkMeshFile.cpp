@@ -0,0 +1,401 @@
+// Validation and the buffer tables of a mapped SDKMESH file
+#include "SdkMeshFile.h"
+#include "Rig.h"
+
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+	using namespace SdkMesh;
+
+	// The layout is the file's, natural alignment gives it on every 64 bit target and MSVC x86
+	static_assert(sizeof(Header) == 104 && offsetof(Header, headerSize) == 8 && offsetof(Header, vertexStreamHeadersOffset) == 56, "SDKMESH header layout");
+	static_assert(sizeof(SdkMesh::VertexElement) == 8, "D3DVERTEXELEMENT9 layout");
+	static_assert(sizeof(VertexBufferHeader) == 288 && offsetof(VertexBufferHeader, dataOffset) == 280, "vertex buffer header layout");
+	static_assert(sizeof(IndexBufferHeader) == 32 && offsetof(IndexBufferHeader, dataOffset) == 24, "index buffer header layout");
+	static_assert(sizeof(Mesh) == 224 && offsetof(Mesh, vertexBuffers) == 104 && offsetof(Mesh, subsetOffset) == 208, "mesh layout");
+	static_assert(sizeof(Subset) == 144 && offsetof(Subset, indexStart) == 112, "subset layout");
+	static_assert(sizeof(Frame) == 184 && offsetof(Frame, matrix) == 116, "frame layout");
+	static_assert(sizeof(Material) == 1256 && offsetof(Material, diffuse) == 1140 && offsetof(Material, runtime) == 1208, "material layout");
+
+	constexpr uint16_t c_DeclEnd = 0xff;
+
+	// D3DDECLTYPE values
+	constexpr uint8_t c_DeclFloat1 = 0;
+	constexpr uint8_t c_DeclFloat2 = 1;
+	constexpr uint8_t c_DeclFloat3 = 2;
+	constexpr uint8_t c_DeclFloat4 = 3;
+	constexpr uint8_t c_DeclUByte4 = 5;
+	constexpr uint8_t c_DeclUByte4N = 8;
+	constexpr uint8_t c_DeclFloat16x2 = 15;
+	constexpr uint8_t c_DeclFloat16x4 = 16;
+
+	VertexElementFormat GetElementFormat(uint8_t type)
+	{
+		switch (type)
+		{
+		case c_DeclFloat1:		return VertexElementFormat::Float1;
+		case c_DeclFloat2:		return VertexElementFormat::Float2;
+		case c_DeclFloat3:		return VertexElementFormat::Float3;
+		case c_DeclFloat4:		return VertexElementFormat::Float4;
+		case c_DeclUByte4:		return VertexElementFormat::UByte4;
+		case c_DeclUByte4N:		return VertexElementFormat::UByte4Norm;
+		case c_DeclFloat16x2:	return VertexElementFormat::Half2;
+		case c_DeclFloat16x4:	return VertexElementFormat::Half4;
+		default:				return VertexElementFormat::Unknown;
+		}
+	}
+
+	// D3DDECLUSAGE to the semantic DirectXTK's SDKMESH loader gives it, null for the ones it ignores
+	const char* GetSemantic(uint8_t usage)
+	{
+		switch (usage)
+		{
+		case 0:		return "SV_Position";
+		case 1:		return "BLENDWEIGHT";
+		case 2:		return "BLENDINDICES";
+		case 3:		return "NORMAL";
+		case 5:		return "TEXCOORD";
+		case 6:		return "TANGENT";
+		case 7:		return "BINORMAL";
+		case 10:	return "COLOR";
+		default:	return nullptr;
+		}
+	}
+
+	// count elements of elementSize at offset, all inside size bytes and aligned for the struct read there
+	bool InFile(uint64_t offset, uint64_t count, size_t elementSize, size_t alignment, size_t size)
+	{
+		return offset % alignment == 0 && offset <= size && count <= (size - offset) / elementSize;
+	}
+}
+
+SdkMeshFile::SdkMeshFile() :
+	m_data(nullptr),
+	m_size(0),
+	m_header(nullptr),
+	m_meshes(nullptr),
+	m_subsets(nullptr),
+	m_frames(nullptr),
+	m_materials(nullptr)
+{
+}
+
+bool SdkMeshFile::Open(const std::string & path)
+{
+	Close();
+	if (!m_file.Open(path) || !Parse(m_file.GetData(), m_file.GetSize()))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool SdkMeshFile::Parse(const void * data, size_t size)
+{
+	Clear();
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = size;
+	if (!data || reinterpret_cast<uintptr_t>(data) % alignof(Header) != 0 || !Validate())
+	{
+		Clear();
+		return false;
+	}
+	return true;
+}
+
+void SdkMeshFile::Close()
+{
+	Clear();
+	m_file.Close();
+}
+
+void SdkMeshFile::Clear()
+{
+	m_data = nullptr;
+	m_size = 0;
+	m_header = nullptr;
+	m_meshes = nullptr;
+	m_subsets = nullptr;
+	m_frames = nullptr;
+	m_materials = nullptr;
+	m_vertexBuffers.clear();
+	m_indexBuffers.clear();
+}
+
+bool SdkMeshFile::Validate()
+{
+	if (m_size < sizeof(Header))
+	{
+		return false;
+	}
+
+	// Everything the header promises has to be in the file before any table is looked at
+	const Header& header = *reinterpret_cast<const Header*>(m_data);
+	if (header.version != c_Version || header.isBigEndian || header.headerSize > m_size || header.nonBufferDataSize > m_size - header.headerSize
+		|| header.bufferDataSize > m_size - header.headerSize - header.nonBufferDataSize
+		|| !InFile(header.vertexStreamHeadersOffset, header.numVertexBuffers, sizeof(VertexBufferHeader), alignof(VertexBufferHeader), m_size)
+		|| !InFile(header.indexStreamHeadersOffset, header.numIndexBuffers, sizeof(IndexBufferHeader), alignof(IndexBufferHeader), m_size)
+		|| !InFile(header.meshDataOffset, header.numMeshes, sizeof(Mesh), alignof(Mesh), m_size)
+		|| !InFile(header.subsetDataOffset, header.numTotalSubsets, sizeof(Subset), alignof(Subset), m_size)
+		|| !InFile(header.frameDataOffset, header.numFrames, sizeof(Frame), alignof(Frame), m_size)
+		|| !InFile(header.materialDataOffset, header.numMaterials, sizeof(Material), alignof(Material), m_size))
+	{
+		return false;
+	}
+	m_header = &header;
+	m_meshes = reinterpret_cast<const Mesh*>(m_data + header.meshDataOffset);
+	m_subsets = reinterpret_cast<const Subset*>(m_data + header.subsetDataOffset);
+	m_frames = reinterpret_cast<const Frame*>(m_data + header.frameDataOffset);
+	m_materials = reinterpret_cast<const Material*>(m_data + header.materialDataOffset);
+
+	// Buffers: their bytes in the file, their counts in their bytes and each declared element within the stride
+	const VertexBufferHeader* vertexHeaders = reinterpret_cast<const VertexBufferHeader*>(m_data + header.vertexStreamHeadersOffset);
+	m_vertexBuffers.resize(header.numVertexBuffers);
+	for (uint32_t i = 0; i < header.numVertexBuffers; ++i)
+	{
+		const VertexBufferHeader& vb = vertexHeaders[i];
+		SdkMeshVertexBuffer& buffer = m_vertexBuffers[i];
+		if (vb.strideBytes == 0 || vb.strideBytes > UINT32_MAX || vb.numVertices > UINT32_MAX || vb.numVertices > vb.sizeBytes / vb.strideBytes
+			|| !InFile(vb.dataOffset, vb.sizeBytes, 1, 1, m_size))
+		{
+			return false;
+		}
+		buffer.data = m_data + vb.dataOffset;
+		buffer.size = static_cast<size_t>(vb.sizeBytes);
+		buffer.vertexCount = static_cast<uint32_t>(vb.numVertices);
+		buffer.stride = static_cast<uint32_t>(vb.strideBytes);
+		if (ToVertexFormat(vb.decl, buffer.format) && buffer.format.GetStride() > buffer.stride)
+		{
+			return false;
+		}
+	}
+
+	const IndexBufferHeader* indexHeaders = reinterpret_cast<const IndexBufferHeader*>(m_data + header.indexStreamHeadersOffset);
+	m_indexBuffers.resize(header.numIndexBuffers);
+	for (uint32_t i = 0; i < header.numIndexBuffers; ++i)
+	{
+		const IndexBufferHeader& ib = indexHeaders[i];
+		SdkMeshIndexBuffer& buffer = m_indexBuffers[i];
+		if (ib.indexType != IndexType16 && ib.indexType != IndexType32)
+		{
+			return false;
+		}
+		buffer.indexSize = ib.indexType == IndexType16 ? 2 : 4;
+		if (ib.numIndices > UINT32_MAX || ib.numIndices > ib.sizeBytes / buffer.indexSize || !InFile(ib.dataOffset, ib.sizeBytes, 1, 1, m_size))
+		{
+			return false;
+		}
+		buffer.data = m_data + ib.dataOffset;
+		buffer.size = static_cast<size_t>(ib.sizeBytes);
+		buffer.indexCount = static_cast<uint32_t>(ib.numIndices);
+	}
+
+	// Meshes: their buffers, subsets and influences exist, and each subset's ranges fit the mesh's buffers
+	for (uint32_t i = 0; i < header.numMeshes; ++i)
+	{
+		const Mesh& mesh = m_meshes[i];
+		if (mesh.numVertexBuffers == 0 || mesh.numVertexBuffers > c_MaxVertexStreams || mesh.indexBuffer >= header.numIndexBuffers
+			|| !InFile(mesh.subsetOffset, mesh.numSubsets, sizeof(uint32_t), alignof(uint32_t), m_size)
+			|| !InFile(mesh.frameInfluenceOffset, mesh.numFrameInfluences, sizeof(uint32_t), alignof(uint32_t), m_size))
+		{
+			return false;
+		}
+		for (uint32_t stream = 0; stream < mesh.numVertexBuffers; ++stream)
+		{
+			if (mesh.vertexBuffers[stream] >= header.numVertexBuffers)
+			{
+				return false;
+			}
+		}
+
+		const SdkMeshVertexBuffer& vertices = m_vertexBuffers[mesh.vertexBuffers[0]];
+		const SdkMeshIndexBuffer& indices = m_indexBuffers[mesh.indexBuffer];
+		const uint32_t* subsets = GetMeshSubsets(mesh);
+		for (uint32_t s = 0; s < mesh.numSubsets; ++s)
+		{
+			if (subsets[s] >= header.numTotalSubsets)
+			{
+				return false;
+			}
+			const Subset& subset = m_subsets[subsets[s]];
+			if (subset.indexStart > indices.indexCount || subset.indexCount > indices.indexCount - subset.indexStart
+				|| subset.vertexStart > vertices.vertexCount || subset.vertexCount > vertices.vertexCount - subset.vertexStart)
+			{
+				return false;
+			}
+		}
+		const uint32_t* influences = GetMeshFrameInfluences(mesh);
+		for (uint32_t f = 0; f < mesh.numFrameInfluences; ++f)
+		{
+			if (influences[f] >= header.numFrames)
+			{
+				return false;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < header.numTotalSubsets; ++i)
+	{
+		if (m_subsets[i].materialId >= header.numMaterials)
+		{
+			return false;
+		}
+	}
+
+	// Frames: every link is to something that exists. Cycles are left to whoever builds a hierarchy from them.
+	for (uint32_t i = 0; i < header.numFrames; ++i)
+	{
+		const Frame& frame = m_frames[i];
+		if ((frame.mesh != c_Invalid && frame.mesh >= header.numMeshes)
+			|| (frame.parentFrame != c_Invalid && frame.parentFrame >= header.numFrames)
+			|| (frame.childFrame != c_Invalid && frame.childFrame >= header.numFrames)
+			|| (frame.siblingFrame != c_Invalid && frame.siblingFrame >= header.numFrames))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+const SdkMeshVertexBuffer * SdkMeshFile::GetVertexBuffer(uint32_t index) const
+{
+	return index < m_vertexBuffers.size() ? &m_vertexBuffers[index] : nullptr;
+}
+
+const SdkMeshIndexBuffer * SdkMeshFile::GetIndexBuffer(uint32_t index) const
+{
+	return index < m_indexBuffers.size() ? &m_indexBuffers[index] : nullptr;
+}
+
+const SdkMesh::Mesh * SdkMeshFile::GetMesh(uint32_t index) const
+{
+	return m_header && index < m_header->numMeshes ? &m_meshes[index] : nullptr;
+}
+
+const SdkMesh::Subset * SdkMeshFile::GetSubset(uint32_t index) const
+{
+	return m_header && index < m_header->numTotalSubsets ? &m_subsets[index] : nullptr;
+}
+
+const SdkMesh::Frame * SdkMeshFile::GetFrame(uint32_t index) const
+{
+	return m_header && index < m_header->numFrames ? &m_frames[index] : nullptr;
+}
+
+const SdkMesh::Material * SdkMeshFile::GetMaterial(uint32_t index) const
+{
+	return m_header && index < m_header->numMaterials ? &m_materials[index] : nullptr;
+}
+
+const uint32_t * SdkMeshFile::GetMeshSubsets(const SdkMesh::Mesh & mesh) const
+{
+	return reinterpret_cast<const uint32_t*>(m_data + mesh.subsetOffset);
+}
+
+const uint32_t * SdkMeshFile::GetMeshFrameInfluences(const SdkMesh::Mesh & mesh) const
+{
+	return reinterpret_cast<const uint32_t*>(m_data + mesh.frameInfluenceOffset);
+}
+
+bool SdkMeshFile::GetRig(Rig & rig) const
+{
+	const uint32_t count = GetFrameCount();
+	std::vector<std::string> names(count);
+	std::vector<uint32_t> parents(count);
+	std::vector<float> bind(size_t(count) * 16);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		names[i] = SdkMesh::GetString(m_frames[i].name);
+		parents[i] = m_frames[i].parentFrame;
+		for (int e = 0; e < 16; ++e)
+		{
+			bind[i * 16 + e] = m_frames[i].matrix[e];
+		}
+	}
+	return rig.Set(names, parents.data(), bind.data(), count);
+}
+
+bool SdkMeshFile::GetTriangles(uint32_t index, std::vector<float>& positions, std::vector<uint32_t>& indices) const
+{
+	positions.clear();
+	indices.clear();
+	const SdkMesh::Mesh* mesh = GetMesh(index);
+	const SdkMeshVertexBuffer* vb = mesh ? GetVertexBuffer(mesh->vertexBuffers[0]) : nullptr;
+	const SdkMeshIndexBuffer* ib = mesh ? GetIndexBuffer(mesh->indexBuffer) : nullptr;
+	const ::VertexElement* position = vb ? vb->format.Find("SV_Position", 0) : nullptr;
+	if (!ib || !position || position->format != VertexElementFormat::Float3)
+	{
+		return false;
+	}
+
+	const uint32_t* subsets = GetMeshSubsets(*mesh);
+	for (uint32_t s = 0; s < mesh->numSubsets; ++s)
+	{
+		const SdkMesh::Subset* subset = GetSubset(subsets[s]);
+		if (!subset || subset->primitiveType != TriangleList || subset->vertexStart > vb->vertexCount
+			|| vb->vertexCount - subset->vertexStart < subset->vertexCount || subset->indexStart > ib->indexCount
+			|| ib->indexCount - subset->indexStart < subset->indexCount)
+		{
+			continue;
+		}
+
+		// A subset with an index past the buffer is left out whole
+		size_t first = indices.size();
+		bool inRange = true;
+		for (uint64_t i = 0; i < subset->indexCount / 3 * 3 && inRange; ++i)
+		{
+			size_t at = static_cast<size_t>(subset->indexStart + i);
+			uint32_t vertex = 0;
+			if (ib->indexSize == 2)
+			{
+				uint16_t vertex16;
+				std::memcpy(&vertex16, ib->data + at * 2, sizeof(vertex16));
+				vertex = vertex16;
+			}
+			else
+			{
+				std::memcpy(&vertex, ib->data + at * 4, sizeof(vertex));
+			}
+			uint64_t offset = vertex + subset->vertexStart;
+			inRange = offset < vb->vertexCount;
+			indices.push_back(static_cast<uint32_t>(offset));
+		}
+		if (!inRange)
+		{
+			indices.resize(first);
+		}
+	}
+	if (indices.empty())
+	{
+		return false;
+	}
+
+	positions.resize(size_t(vb->vertexCount) * 3);
+	for (uint32_t v = 0; v < vb->vertexCount; ++v)
+	{
+		std::memcpy(&positions[size_t(v) * 3], vb->data + size_t(v) * vb->stride + position->offset, 3 * sizeof(float));
+	}
+	return true;
+}
+
+bool SdkMeshFile::ToVertexFormat(const SdkMesh::VertexElement * decl, VertexFormat & format)
+{
+	// Only the first stream, the one DirectXTK's loader reads, with the semantics it gives each usage
+	format = VertexFormat();
+	for (uint32_t i = 0; i < c_MaxVertexElements && decl[i].stream != c_DeclEnd; ++i)
+	{
+		const SdkMesh::VertexElement& element = decl[i];
+		VertexElementFormat elementFormat = GetElementFormat(element.type);
+		const char* semantic = GetSemantic(element.usage);
+		if (element.stream != 0 || elementFormat == VertexElementFormat::Unknown || !semantic)
+		{
+			format = VertexFormat();
+			return false;
+		}
+		format.AddAt(element.offset, semantic, element.usageIndex, elementFormat);
+	}
+	return !format.Empty();
+}
@@ -0,0 +1,243 @@
+//
+// SdkMeshFile.h - Zero copy access to the meshes, buffers, frames and materials of an SDKMESH file
+//
+// The version 101 layout DirectXTK's Model::CreateFromSDKMESH reads, declared without the Windows headers so the tools
+// build anywhere. The file is memory mapped (or the caller's buffer borrowed) and checked once: header, every table
+// and buffer inside the file, every index between them in range and each vertex declaration within its stride. After
+// that the tables are pointers straight into the mapping and each vertex and index buffer a pointer and size ready for
+// CreateBuffer, with its declaration as a VertexFormat for the input layout cache. Nothing is copied.
+//
+
+#pragma once
+
+#include "MappedFile.h"
+#include "VertexFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Rig;
+
+namespace SdkMesh
+{
+	constexpr uint32_t c_Version = 101;
+	constexpr uint32_t c_Invalid = 0xffffffffu;		//no mesh, parent, child or sibling
+	constexpr uint32_t c_MaxVertexStreams = 16;
+	constexpr uint32_t c_MaxVertexElements = 32;
+	constexpr size_t c_MaxName = 100;
+	constexpr size_t c_MaxPath = 260;
+
+	enum IndexType : uint32_t
+	{
+		IndexType16 = 0,
+		IndexType32 = 1,
+	};
+
+	//D3D_PRIMITIVE_TOPOLOGY is this plus one for the list and strip types
+	enum PrimitiveType : uint32_t
+	{
+		TriangleList = 0,
+		TriangleStrip = 1,
+		LineList = 2,
+		LineStrip = 3,
+		PointList = 4,
+	};
+
+	struct Header
+	{
+		uint32_t	version;
+		uint8_t		isBigEndian;
+		uint64_t	headerSize;
+		uint64_t	nonBufferDataSize;
+		uint64_t	bufferDataSize;
+		uint32_t	numVertexBuffers;
+		uint32_t	numIndexBuffers;
+		uint32_t	numMeshes;
+		uint32_t	numTotalSubsets;
+		uint32_t	numFrames;
+		uint32_t	numMaterials;
+		uint64_t	vertexStreamHeadersOffset;
+		uint64_t	indexStreamHeadersOffset;
+		uint64_t	meshDataOffset;
+		uint64_t	subsetDataOffset;
+		uint64_t	frameDataOffset;
+		uint64_t	materialDataOffset;
+	};
+
+	//D3DVERTEXELEMENT9, the list ends at the element with stream 0xff
+	struct VertexElement
+	{
+		uint16_t	stream;
+		uint16_t	offset;
+		uint8_t		type;
+		uint8_t		method;
+		uint8_t		usage;
+		uint8_t		usageIndex;
+	};
+
+	struct VertexBufferHeader
+	{
+		uint64_t		numVertices;
+		uint64_t		sizeBytes;
+		uint64_t		strideBytes;
+		VertexElement	decl[c_MaxVertexElements];
+		uint64_t		dataOffset;
+	};
+
+	struct IndexBufferHeader
+	{
+		uint64_t	numIndices;
+		uint64_t	sizeBytes;
+		uint32_t	indexType;
+		uint64_t	dataOffset;
+	};
+
+	struct Mesh
+	{
+		char		name[c_MaxName];
+		uint8_t		numVertexBuffers;
+		uint32_t	vertexBuffers[c_MaxVertexStreams];
+		uint32_t	indexBuffer;
+		uint32_t	numSubsets;
+		uint32_t	numFrameInfluences;
+		float		boundingBoxCenter[3];
+		float		boundingBoxExtents[3];
+		uint64_t	subsetOffset;				//numSubsets subset indices
+		uint64_t	frameInfluenceOffset;		//numFrameInfluences frame indices
+	};
+
+	struct Subset
+	{
+		char		name[c_MaxName];
+		uint32_t	materialId;
+		uint32_t	primitiveType;
+		uint64_t	indexStart;
+		uint64_t	indexCount;
+		uint64_t	vertexStart;
+		uint64_t	vertexCount;
+	};
+
+	struct Frame
+	{
+		char		name[c_MaxName];
+		uint32_t	mesh;
+		uint32_t	parentFrame;
+		uint32_t	childFrame;
+		uint32_t	siblingFrame;
+		float		matrix[16];				//row major, relative to the parent frame
+		uint32_t	animationDataIndex;
+	};
+
+	struct Material
+	{
+		char		name[c_MaxName];
+		char		materialInstancePath[c_MaxPath];
+		char		diffuseTexture[c_MaxPath];
+		char		normalTexture[c_MaxPath];
+		char		specularTexture[c_MaxPath];
+		float		diffuse[4];
+		float		ambient[4];
+		float		specular[4];
+		float		emissive[4];
+		float		power;
+		uint64_t	runtime[6];				//texture and view pointers at runtime, zero in the file
+	};
+
+	//A fixed size name field as a string, without the padding after its terminator
+	template<size_t N>
+	std::string GetString(const char(&field)[N])
+	{
+		size_t length = 0;
+		while (length < N && field[length])
+		{
+			++length;
+		}
+		return std::string(field, length);
+	}
+}
+
+//One vertex buffer inside the file
+struct SdkMeshVertexBuffer
+{
+	const uint8_t*	data;
+	size_t			size;
+	uint32_t		vertexCount;
+	uint32_t		stride;
+	VertexFormat	format;			//empty when the declaration has a type VertexFormat can't describe
+};
+
+//One index buffer inside the file
+struct SdkMeshIndexBuffer
+{
+	const uint8_t*	data;
+	size_t			size;
+	uint32_t		indexCount;
+	uint32_t		indexSize;		//2 or 4 bytes
+};
+
+class SdkMeshFile
+{
+public:
+	SdkMeshFile();
+
+	SdkMeshFile(SdkMeshFile const&) = delete;
+	SdkMeshFile& operator= (SdkMeshFile const&) = delete;
+
+	//Maps and validates a file, false (and closed) if it is missing or not an SDKMESH that fits in it
+	bool Open(const std::string& path);
+	//The same over memory the caller keeps alive, 8 byte aligned, for as long as the tables and buffers are used
+	bool Parse(const void* data, size_t size);
+	void Close();
+
+	bool IsValid() const { return m_data != nullptr; }
+	const SdkMesh::Header& GetHeader() const { return *m_header; }		//only while valid
+
+	//The file as it is, for loaders that take a whole SDKMESH from memory
+	const uint8_t* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+	//Each null when out of range
+	const SdkMeshVertexBuffer* GetVertexBuffer(uint32_t index) const;
+	const SdkMeshIndexBuffer* GetIndexBuffer(uint32_t index) const;
+	const SdkMesh::Mesh* GetMesh(uint32_t index) const;
+	const SdkMesh::Subset* GetSubset(uint32_t index) const;
+	const SdkMesh::Frame* GetFrame(uint32_t index) const;
+	const SdkMesh::Material* GetMaterial(uint32_t index) const;
+
+	uint32_t GetMeshCount() const { return m_header ? m_header->numMeshes : 0; }
+	uint32_t GetFrameCount() const { return m_header ? m_header->numFrames : 0; }
+	uint32_t GetMaterialCount() const { return m_header ? m_header->numMaterials : 0; }
+
+	//A mesh's subsets and the frames that influence it, mesh.numSubsets and mesh.numFrameInfluences of them
+	const uint32_t* GetMeshSubsets(const SdkMesh::Mesh& mesh) const;
+	const uint32_t* GetMeshFrameInfluences(const SdkMesh::Mesh& mesh) const;
+
+	//The frames as bones in file order, the way Model::CreateFromSDKMESH numbers them
+	bool GetRig(Rig& rig) const;
+
+	//A mesh's triangle list subsets as one list: every position (xyz) of its first vertex buffer and indices into
+	//them, each subset's offset by its vertexStart as DirectXTK draws it. Subsets out of range or of another topology
+	//are left out. False if there are no triangles or the buffer has no float3 SV_Position.
+	bool GetTriangles(uint32_t mesh, std::vector<float>& positions, std::vector<uint32_t>& indices) const;
+
+	//A vertex buffer's declaration, up to c_MaxVertexElements ending at stream 0xff, with the semantics DirectXTK's
+	//loader gives it. False and empty if an element has no VertexFormat equivalent.
+	static bool ToVertexFormat(const SdkMesh::VertexElement* decl, VertexFormat& format);
+
+private:
+	void Clear();
+	bool Validate();
+
+	MappedFile							m_file;
+	const uint8_t*						m_data;
+	size_t								m_size;
+	const SdkMesh::Header*				m_header;
+	const SdkMesh::Mesh*				m_meshes;
+	const SdkMesh::Subset*				m_subsets;
+	const SdkMesh::Frame*				m_frames;
+	const SdkMesh::Material*			m_materials;
+	std::vector<SdkMeshVertexBuffer>	m_vertexBuffers;
+	std::vector<SdkMeshIndexBuffer>		m_indexBuffers;
+};
@@ -1,6 +1,6 @@
 #include "pch.h"
 #include "Shader.h"
-#include <ReadData.h>
+#include "AssetData.h"
 
 
 Shader::Shader()
@@ -12,58 +12,24 @@ Shader::~Shader()
 {
 }
 
-bool Shader::InitStandard(ID3D11Device * device, WCHAR * vsFilename, WCHAR * psFilename)
+bool Shader::InitStandard(ID3D11Device * device, InputLayoutCache * layouts, StateCache * states, const VertexFormat & format, WCHAR * vsFilename, WCHAR * psFilename, AssetLoader * assets)
 {
-	D3D11_BUFFER_DESC	matrixBufferDesc;
-	D3D11_SAMPLER_DESC	samplerDesc;
 	D3D11_BUFFER_DESC	lightBufferDesc;
 
-	//LOAD SHADER:	VERTEX
-	auto vertexShaderBuffer = DX::ReadData(vsFilename);
-	HRESULT result = device->CreateVertexShader(vertexShaderBuffer.data(), vertexShaderBuffer.size(), NULL, &m_vertexShader);
-	if (result != S_OK)
+	if (!LoadVertexShader(device, layouts, format, vsFilename, assets))
 	{
-		//if loading failed.  
 		return false;
 	}
 
-	// Create the vertex input layout description.
-	// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-	};
-
-	// Get a count of the elements in the layout.
-	unsigned int numElements;
-	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
-
-	// Create the vertex input layout.
-	device->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer.data(), vertexShaderBuffer.size(), &m_layout);
-	
-
 	//LOAD SHADER:	PIXEL
-	auto pixelShaderBuffer = DX::ReadData(psFilename);	
-	result = device->CreatePixelShader(pixelShaderBuffer.data(), pixelShaderBuffer.size(), NULL, &m_pixelShader);
+	auto pixelShaderBuffer = DX::ReadAsset(assets, psFilename);	
+	HRESULT result = device->CreatePixelShader(pixelShaderBuffer.data(), pixelShaderBuffer.size(), NULL, &m_pixelShader);
 	if (result != S_OK)
 	{
 		//if loading failed. 
 		return false;
 	}
 
-	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
-	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
-	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixBufferDesc.MiscFlags = 0;
-	matrixBufferDesc.StructureByteStride = 0;
-
-	// Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class.
-	device->CreateBuffer(&matrixBufferDesc, NULL, &m_matrixBuffer);
-
-
 	// Setup light buffer
 	// Setup the description of the light dynamic constant buffer that is in the pixel shader.
 	// Note that ByteWidth always needs to be a multiple of 16 if using D3D11_BIND_CONSTANT_BUFFER or CreateBuffer will fail.
@@ -77,32 +43,26 @@ bool Shader::InitStandard(ID3D11Device * device, WCHAR * vsFilename, WCHAR * psF
 	// Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class.
 	device->CreateBuffer(&lightBufferDesc, NULL, &m_lightBuffer);
 
-	// Create a texture sampler state description.
-	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.MipLODBias = 0.0f;
-	samplerDesc.MaxAnisotropy = 1;
-	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
-	samplerDesc.BorderColor[0] = 0;
-	samplerDesc.BorderColor[1] = 0;
-	samplerDesc.BorderColor[2] = 0;
-	samplerDesc.BorderColor[3] = 0;
-	samplerDesc.MinLOD = 0;
-	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
-
-	// Create the texture sampler state.
-	device->CreateSamplerState(&samplerDesc, &m_sampleState);
+	// Share the linear wrap sampler with every other shader through the state cache.
+	m_sampleState = states->LinearWrap();
 
 	return true;
 }
 
-bool Shader::SetShaderParameters(ID3D11DeviceContext * context, DirectX::SimpleMath::Matrix * world, DirectX::SimpleMath::Matrix * view, DirectX::SimpleMath::Matrix * projection, Light *sceneLight1, ID3D11ShaderResourceView* texture1)
+bool Shader::InitDepthOnly(ID3D11Device * device, InputLayoutCache * layouts, const VertexFormat & format, WCHAR * vsFilename, AssetLoader * assets)
+{
+	// No pixel shader, EnableShader unbinds it so only depth is written
+	m_pixelShader.Reset();
+	m_sampleState = nullptr;
+	m_lightBuffer = nullptr;
+
+	return LoadVertexShader(device, layouts, format, vsFilename, assets);
+}
+
+void Shader::SetMatrixParameters(ID3D11DeviceContext * context, DirectX::SimpleMath::Matrix * world, DirectX::SimpleMath::Matrix * view, DirectX::SimpleMath::Matrix * projection)
 {
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
 	MatrixBufferType* dataPtr;
-	LightBufferType* lightPtr;
 	DirectX::SimpleMath::Matrix  tworld, tview, tproj;
 
 	// Transpose the matrices to prepare them for the shader.
@@ -116,6 +76,23 @@ bool Shader::SetShaderParameters(ID3D11DeviceContext * context, DirectX::SimpleM
 	dataPtr->projection = tproj;
 	context->Unmap(m_matrixBuffer, 0);
 	context->VSSetConstantBuffers(0, 1, &m_matrixBuffer);	//note the first variable is the mapped buffer ID.  Corresponding to what you set in the VS
+}
+
+bool Shader::SetShaderParameters(ID3D11DeviceContext * context, DirectX::SimpleMath::Matrix * world, DirectX::SimpleMath::Matrix * view, DirectX::SimpleMath::Matrix * projection, Light *sceneLight1, ID3D11ShaderResourceView* texture1)
+{
+	SetMatrixParameters(context, world, view, projection);
+	SetLightParameters(context, sceneLight1);
+
+	//pass the desired texture to the pixel shader.
+	context->PSSetShaderResources(0, 1, &texture1);
+
+	return false;
+}
+
+void Shader::SetLightParameters(ID3D11DeviceContext * context, Light * sceneLight1)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	LightBufferType* lightPtr;
 
 	context->Map(m_lightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
 	lightPtr = (LightBufferType*)mappedResource.pData;
@@ -125,19 +102,53 @@ bool Shader::SetShaderParameters(ID3D11DeviceContext * context, DirectX::SimpleM
 	lightPtr->padding = 0.0f;
 	context->Unmap(m_lightBuffer, 0);
 	context->PSSetConstantBuffers(0, 1, &m_lightBuffer);	//note the first variable is the mapped buffer ID.  Corresponding to what you set in the PS
+}
 
-	//pass the desired texture to the pixel shader.
-	context->PSSetShaderResources(0, 1, &texture1);
+bool Shader::LoadVertexShader(ID3D11Device * device, InputLayoutCache * layouts, const VertexFormat & format, WCHAR * vsFilename, AssetLoader * assets)
+{
+	D3D11_BUFFER_DESC	matrixBufferDesc;
 
-	return false;
+	//LOAD SHADER:	VERTEX
+	auto vertexShaderBuffer = DX::ReadAsset(assets, vsFilename);
+	HRESULT result = device->CreateVertexShader(vertexShaderBuffer.data(), vertexShaderBuffer.size(), NULL, &m_vertexShader);
+	if (result != S_OK)
+	{
+		//if loading failed.  
+		return false;
+	}
+
+	// Fetch the vertex input layout from the shared cache.
+	// The format needs to match the VertexType stucture in the MeshClass and the inputs of the shader.
+	m_layout = layouts->Get(device, format, vertexShaderBuffer.data(), vertexShaderBuffer.size());
+	if (!m_layout)
+	{
+		//if the shader expects inputs the mesh format doesn't provide.
+		return false;
+	}
+
+	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
+	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
+	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	matrixBufferDesc.MiscFlags = 0;
+	matrixBufferDesc.StructureByteStride = 0;
+
+	// Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class.
+	device->CreateBuffer(&matrixBufferDesc, NULL, &m_matrixBuffer);
+
+	return true;
 }
 
 void Shader::EnableShader(ID3D11DeviceContext * context)
 {
 	context->IASetInputLayout(m_layout);							//set the input layout for the shader to match out geometry
 	context->VSSetShader(m_vertexShader.Get(), 0, 0);				//turn on vertex shader
-	context->PSSetShader(m_pixelShader.Get(), 0, 0);				//turn on pixel shader
+	context->PSSetShader(m_pixelShader.Get(), 0, 0);				//turn on pixel shader (or off for depth only shaders)
 	// Set the sampler state in the pixel shader.
-	context->PSSetSamplers(0, 1, &m_sampleState);
+	if (m_sampleState)
+	{
+		context->PSSetSamplers(0, 1, &m_sampleState);
+	}
 
 }
@@ -2,6 +2,9 @@
 
 #include "DeviceResources.h"
 #include "Light.h"
+#include "InputLayoutCache.h"
+#include "StateCache.h"
+#include "AssetLoader.h"
 
 //Class from which we create all shader objects used by the framework
 //This single class can be expanded to accomodate shaders of all different types with different parameters
@@ -13,8 +16,12 @@ public:
 
 	//we could extend this to load in only a vertex shader, only a pixel shader etc.  or specialised init for Geometry or domain shader. 
 	//All the methods here simply create new versions corresponding to your needs
-	bool InitStandard(ID3D11Device * device, WCHAR * vsFilename, WCHAR * psFilename);		//Loads the Vert / pixel Shader pair
+	//The compiled shaders come from assets when it holds them, loose .cso files otherwise
+	bool InitStandard(ID3D11Device * device, InputLayoutCache * layouts, StateCache * states, const VertexFormat & format, WCHAR * vsFilename, WCHAR * psFilename, AssetLoader * assets = nullptr);		//Loads the Vert / pixel Shader pair
+	bool InitDepthOnly(ID3D11Device * device, InputLayoutCache * layouts, const VertexFormat & format, WCHAR * vsFilename, AssetLoader * assets = nullptr);		//Vertex shader only, for passes that just write depth
+	void SetMatrixParameters(ID3D11DeviceContext * context, DirectX::SimpleMath::Matrix  *world, DirectX::SimpleMath::Matrix  *view, DirectX::SimpleMath::Matrix  *projection);
 	bool SetShaderParameters(ID3D11DeviceContext * context, DirectX::SimpleMath::Matrix  *world, DirectX::SimpleMath::Matrix  *view, DirectX::SimpleMath::Matrix  *projection, Light *sceneLight1, ID3D11ShaderResourceView* texture1);
+	void SetLightParameters(ID3D11DeviceContext * context, Light *sceneLight1);		//the light alone, for shaders whose textures are bound once per pass
 	void EnableShader(ID3D11DeviceContext * context);
 
 private:
@@ -45,9 +52,11 @@ private:
 	//Shaders
 	Microsoft::WRL::ComPtr<ID3D11VertexShader>								m_vertexShader;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader>								m_pixelShader;
-	ID3D11InputLayout*														m_layout;
+	ID3D11InputLayout*														m_layout;		//owned by the InputLayoutCache
 	ID3D11Buffer*															m_matrixBuffer;
-	ID3D11SamplerState*														m_sampleState;
+	ID3D11SamplerState*														m_sampleState;	//owned by the StateCache
 	ID3D11Buffer*															m_lightBuffer;
+
+	bool LoadVertexShader(ID3D11Device * device, InputLayoutCache * layouts, const VertexFormat & format, WCHAR * vsFilename, AssetLoader * assets);
 };
 
@@ -0,0 +1,138 @@
+// Dirty tracking for the cached static shadow views
+#include "ShadowCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+ShadowCache::ShadowCache()
+{
+}
+
+void ShadowCache::Resize(uint32_t viewCount)
+{
+	m_views.resize(viewCount);
+	InvalidateAll();
+}
+
+void ShadowCache::SetView(uint32_t view, const float viewProj[16], uint32_t resolution)
+{
+	View& v = m_views[view];
+	if (v.resolution != resolution || std::memcmp(v.viewProj, viewProj, sizeof(v.viewProj)) != 0)
+	{
+		std::memcpy(v.viewProj, viewProj, sizeof(v.viewProj));
+		v.resolution = resolution;
+		v.full = true;
+	}
+}
+
+void ShadowCache::InvalidateAll()
+{
+	for (View& v : m_views)
+	{
+		std::memset(v.viewProj, 0, sizeof(v.viewProj));
+		v.resolution = 0;
+		v.full = true;
+		v.dirty = ShadowRect();
+	}
+}
+
+void ShadowCache::InvalidateBounds(const ShadowBounds & bounds)
+{
+	for (uint32_t i = 0; i < GetViewCount(); ++i)
+	{
+		View& v = m_views[i];
+		ShadowRect rect;
+		if (v.full || !ProjectBounds(i, bounds, rect))
+		{
+			continue;
+		}
+
+		if (v.dirty.left >= v.dirty.right)
+		{
+			v.dirty = rect;
+		}
+		else
+		{
+			v.dirty.left = std::min(v.dirty.left, rect.left);
+			v.dirty.top = std::min(v.dirty.top, rect.top);
+			v.dirty.right = std::max(v.dirty.right, rect.right);
+			v.dirty.bottom = std::max(v.dirty.bottom, rect.bottom);
+		}
+	}
+}
+
+bool ShadowCache::IsDirty(uint32_t view) const
+{
+	const View& v = m_views[view];
+	return v.full || v.dirty.left < v.dirty.right;
+}
+
+void ShadowCache::MarkClean(uint32_t view)
+{
+	m_views[view].full = false;
+	m_views[view].dirty = ShadowRect();
+}
+
+bool ShadowCache::ProjectBounds(uint32_t view, const ShadowBounds & bounds, ShadowRect & rect) const
+{
+	const View& v = m_views[view];
+	const float* m = v.viewProj;
+	const uint32_t size = v.resolution;
+
+	float minX = 1.0f, minY = 1.0f, maxX = -1.0f, maxY = -1.0f;
+	int behind = 0;
+	for (int i = 0; i < 8; ++i)
+	{
+		float p[3] =
+		{
+			(i & 1) ? bounds.max[0] : bounds.min[0],
+			(i & 2) ? bounds.max[1] : bounds.min[1],
+			(i & 4) ? bounds.max[2] : bounds.min[2],
+		};
+		float x = p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12];
+		float y = p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13];
+		float w = p[0] * m[3] + p[1] * m[7] + p[2] * m[11] + m[15];
+		if (w <= 1e-5f)
+		{
+			++behind;
+			continue;
+		}
+		minX = std::min(minX, x / w);
+		maxX = std::max(maxX, x / w);
+		minY = std::min(minY, y / w);
+		maxY = std::max(maxY, y / w);
+	}
+
+	if (behind == 8)
+	{
+		return false;
+	}
+	if (behind)
+	{
+		// Straddles the light's plane, the projection is unbounded so take the whole view
+		rect = { 0, 0, size, size };
+		return true;
+	}
+	if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+	{
+		return false;
+	}
+
+	// Clip space to texels (y flips), widened by a texel for the bias and filtering
+	auto toTexel = [size](float ndc, bool flip)
+	{
+		float t = (flip ? -ndc : ndc) * 0.5f + 0.5f;
+		return std::max(0.0f, std::min(float(size), t * float(size)));
+	};
+	rect.left = static_cast<uint32_t>(std::max(0.0f, std::floor(toTexel(minX, false)) - 1.0f));
+	rect.right = static_cast<uint32_t>(std::min(float(size), std::ceil(toTexel(maxX, false)) + 1.0f));
+	rect.top = static_cast<uint32_t>(std::max(0.0f, std::floor(toTexel(maxY, true)) - 1.0f));
+	rect.bottom = static_cast<uint32_t>(std::min(float(size), std::ceil(toTexel(minY, true)) + 1.0f));
+	return rect.left < rect.right && rect.top < rect.bottom;
+}
+
+bool ShadowCache::Overlaps(const ShadowRect & a, const ShadowRect & b)
+{
+	return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
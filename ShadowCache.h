@@ -0,0 +1,69 @@
+//
+// ShadowCache.h - Bookkeeping for shadow maps that keep the static casters between frames
+//
+// Every shadow view (a cascade or a cube face) has a copy holding only the static casters. It stays valid while the
+// view's matrix is unchanged; when a static caster moves only the texels its old and new bounds cover are redrawn.
+// Dynamic casters are drawn on top of a copy of the cached depth every frame.
+//
+
+#pragma once
+
+#include "ShadowCascades.h"
+
+//Texel rectangle in a shadow view, right / bottom exclusive
+struct ShadowRect
+{
+	uint32_t	left;
+	uint32_t	top;
+	uint32_t	right;
+	uint32_t	bottom;
+};
+
+//What the shadow passes did in a frame
+struct ShadowDrawStats
+{
+	uint32_t	staticDraws;		//static casters drawn into the caches
+	uint32_t	dynamicDraws;		//casters drawn into the live maps (every caster when caching is off)
+	uint32_t	viewsRebuilt;		//views whose cache was redrawn completely
+	uint32_t	viewsPatched;		//views where only a dirty rectangle was redrawn
+	uint32_t	viewsCopied;		//cached views copied into the live maps
+};
+
+class ShadowCache
+{
+public:
+	ShadowCache();
+
+	void Resize(uint32_t viewCount);
+	uint32_t GetViewCount() const { return static_cast<uint32_t>(m_views.size()); }
+
+	//Call before drawing a view. A matrix or resolution different from the cached one invalidates the whole view.
+	void SetView(uint32_t view, const float viewProj[16], uint32_t resolution);
+
+	void InvalidateAll();
+
+	//Marks the texels the box covers in every view for redrawing. Call with both the old and the new bounds of a
+	//static caster that moved.
+	void InvalidateBounds(const ShadowBounds& bounds);
+
+	bool IsDirty(uint32_t view) const;
+	bool IsFullyDirty(uint32_t view) const { return m_views[view].full; }
+	const ShadowRect& GetDirtyRect(uint32_t view) const { return m_views[view].dirty; }
+	void MarkClean(uint32_t view);
+
+	//Texels the box covers in the view, false if it misses the view entirely
+	bool ProjectBounds(uint32_t view, const ShadowBounds& bounds, ShadowRect& rect) const;
+
+	static bool Overlaps(const ShadowRect& a, const ShadowRect& b);
+
+private:
+	struct View
+	{
+		float		viewProj[16];
+		uint32_t	resolution;
+		bool		full;			//whole view needs redrawing
+		ShadowRect	dirty;			//empty when left >= right
+	};
+
+	std::vector<View>	m_views;
+};
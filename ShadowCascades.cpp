@@ -0,0 +1,313 @@
+// Cascade fitting, cube face matrices and shadow caster culling
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	inline float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	inline void Cross(const float a[3], const float b[3], float out[3])
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	inline void Normalize(float v[3])
+	{
+		float length = std::sqrt(Dot(v, v));
+		if (length > 0.0f)
+		{
+			v[0] /= length;
+			v[1] /= length;
+			v[2] /= length;
+		}
+	}
+
+	// Right / up / forward basis for a left handed view looking along forward
+	void MakeBasis(const float forward[3], const float upHint[3], float basis[3][3])
+	{
+		basis[2][0] = forward[0];
+		basis[2][1] = forward[1];
+		basis[2][2] = forward[2];
+		Normalize(basis[2]);
+		Cross(upHint, basis[2], basis[0]);
+		Normalize(basis[0]);
+		Cross(basis[2], basis[0], basis[1]);
+	}
+
+	// Smallest distance from p to the box, 0 inside
+	float DistanceToBox(const float p[3], const ShadowBounds& bounds)
+	{
+		float distanceSq = 0.0f;
+		for (int i = 0; i < 3; ++i)
+		{
+			float d = std::max(std::max(bounds.min[i] - p[i], 0.0f), p[i] - bounds.max[i]);
+			distanceSq += d * d;
+		}
+		return std::sqrt(distanceSq);
+	}
+
+	const float c_CubeForward[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	const float c_CubeUp[6][3] = { { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 0 } };
+}
+
+ShadowCascades::ShadowCascades()
+{
+	SetDesc(ShadowCascadeDesc());
+	for (auto& row : m_basis)
+	{
+		row[0] = row[1] = row[2] = 0.0f;
+	}
+	for (auto& cascade : m_cascades)
+	{
+		cascade = ShadowCascade();
+	}
+}
+
+void ShadowCascades::SetDesc(const ShadowCascadeDesc & desc)
+{
+	m_desc = desc;
+	m_desc.count = std::max(1u, std::min(desc.count, c_MaxCascades));
+	m_desc.resolution = std::max(1u, desc.resolution);
+}
+
+void ShadowCascades::ComputeSplits(float nearZ, float farZ, uint32_t count, float lambda, float * splits)
+{
+	splits[0] = nearZ;
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		float fraction = float(i) / float(count);
+		float logSplit = nearZ * std::pow(farZ / nearZ, fraction);
+		float uniformSplit = nearZ + (farZ - nearZ) * fraction;
+		splits[i] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+	}
+	splits[count] = farZ;
+}
+
+void ShadowCascades::Build(const float view[16], bool rightHanded, float projScaleX, float projScaleY, float nearZ,
+	const float lightDirection[3], const ShadowBounds & sceneBounds)
+{
+	const float up[3] = { 0.0f, 1.0f, 0.0f };
+	const float side[3] = { 1.0f, 0.0f, 0.0f };
+	float forward[3] = { lightDirection[0], lightDirection[1], lightDirection[2] };
+	Normalize(forward);
+	MakeBasis(forward, std::fabs(forward[1]) < 0.99f ? up : side, m_basis);
+
+	// Start of the scene along the light, every cascade reaches back to here
+	float sceneCentre[3], sceneExtent[3];
+	ToLightSpace(sceneBounds, sceneCentre, sceneExtent);
+	float sceneDepthMin = sceneCentre[2] - sceneExtent[2];
+
+	float splits[c_MaxCascades + 1];
+	ComputeSplits(nearZ, std::max(m_desc.maxDistance, nearZ * 2.0f), m_desc.count, m_desc.lambda, splits);
+
+	// Camera position and axes in world space, the view matrix is a rigid transform so its inverse is the transpose
+	const float zSign = rightHanded ? -1.0f : 1.0f;
+	float translation[3] = { view[12], view[13], view[14] };
+
+	for (uint32_t c = 0; c < m_desc.count; ++c)
+	{
+		ShadowCascade& cascade = m_cascades[c];
+		cascade.splitNear = splits[c];
+		cascade.splitFar = splits[c + 1];
+
+		// The 8 corners of this slice of the frustum, in world space
+		float corners[8][3];
+		for (int i = 0; i < 8; ++i)
+		{
+			float depth = (i & 4) ? cascade.splitFar : cascade.splitNear;
+			float viewPos[3] =
+			{
+				((i & 1) ? depth : -depth) / projScaleX - translation[0],
+				((i & 2) ? depth : -depth) / projScaleY - translation[1],
+				depth * zSign - translation[2],
+			};
+			for (int j = 0; j < 3; ++j)
+			{
+				corners[i][j] = viewPos[0] * view[j * 4 + 0] + viewPos[1] * view[j * 4 + 1] + viewPos[2] * view[j * 4 + 2];
+			}
+		}
+
+		// Bounding sphere of the slice. Its size doesn't change as the camera turns, which keeps the texel size fixed.
+		float centre[3] = { 0.0f, 0.0f, 0.0f };
+		for (auto& corner : corners)
+		{
+			centre[0] += corner[0] * 0.125f;
+			centre[1] += corner[1] * 0.125f;
+			centre[2] += corner[2] * 0.125f;
+		}
+		float radius = 0.0f;
+		for (auto& corner : corners)
+		{
+			float d[3] = { corner[0] - centre[0], corner[1] - centre[1], corner[2] - centre[2] };
+			radius = std::max(radius, std::sqrt(Dot(d, d)));
+		}
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		// Snap the centre to whole texels in light space
+		float texelSize = 2.0f * radius / float(m_desc.resolution);
+		float lightX = std::floor(Dot(m_basis[0], centre) / texelSize) * texelSize;
+		float lightY = std::floor(Dot(m_basis[1], centre) / texelSize) * texelSize;
+		float lightZ = Dot(m_basis[2], centre);
+
+		cascade.centre[0] = lightX;
+		cascade.centre[1] = lightY;
+		cascade.halfSize = radius;
+		cascade.depthMax = lightZ + radius;
+		cascade.depthMin = std::min(lightZ - radius, sceneDepthMin);
+		cascade.texelSize = texelSize;
+
+		// Light view (basis at the world origin) followed by the off centre orthographic projection
+		float depthScale = 1.0f / std::max(cascade.depthMax - cascade.depthMin, 0.001f);
+		float* m = cascade.viewProj;
+		for (int row = 0; row < 3; ++row)
+		{
+			m[row * 4 + 0] = m_basis[0][row] / radius;
+			m[row * 4 + 1] = m_basis[1][row] / radius;
+			m[row * 4 + 2] = m_basis[2][row] * depthScale;
+			m[row * 4 + 3] = 0.0f;
+		}
+		m[12] = -lightX / radius;
+		m[13] = -lightY / radius;
+		m[14] = -cascade.depthMin * depthScale;
+		m[15] = 1.0f;
+	}
+}
+
+void ShadowCascades::CullCasters(uint32_t cascade, const ShadowBounds * casters, size_t count, std::vector<uint32_t>& visible) const
+{
+	const ShadowCascade& c = m_cascades[cascade];
+	visible.clear();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		float centre[3], extent[3];
+		ToLightSpace(casters[i], centre, extent);
+
+		// Has to overlap the cascade's square and start before its far end. Anything closer to the light than the
+		// receivers can still cast onto them, so there is no near test.
+		if (std::fabs(centre[0] - c.centre[0]) <= c.halfSize + extent[0]
+			&& std::fabs(centre[1] - c.centre[1]) <= c.halfSize + extent[1]
+			&& centre[2] - extent[2] <= c.depthMax)
+		{
+			visible.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+void ShadowCascades::BuildCubeFace(const float position[3], float nearZ, float farZ, uint32_t face, float viewProj[16])
+{
+	float basis[3][3];
+	MakeBasis(c_CubeForward[face], c_CubeUp[face], basis);
+
+	// 90 degree left handed perspective, so x and y only need the divide by depth
+	float depthScale = farZ / (farZ - nearZ);
+	float depthBias = -nearZ * farZ / (farZ - nearZ);
+
+	for (int row = 0; row < 3; ++row)
+	{
+		viewProj[row * 4 + 0] = basis[0][row];
+		viewProj[row * 4 + 1] = basis[1][row];
+		viewProj[row * 4 + 2] = basis[2][row] * depthScale;
+		viewProj[row * 4 + 3] = basis[2][row];
+	}
+	float eyeX = -Dot(basis[0], position);
+	float eyeY = -Dot(basis[1], position);
+	float eyeZ = -Dot(basis[2], position);
+	viewProj[12] = eyeX;
+	viewProj[13] = eyeY;
+	viewProj[14] = eyeZ * depthScale + depthBias;
+	viewProj[15] = eyeZ;
+}
+
+void ShadowCascades::CullCubeFace(const float position[3], float range, uint32_t face, const ShadowBounds * casters, size_t count,
+	std::vector<uint32_t>& visible)
+{
+	visible.clear();
+
+	// The face's frustum is the pyramid where the face axis dominates the other two, i.e. four planes through the light.
+	// The fifth, facing along the axis, culls boxes wholly behind the light that are wide enough to pass the other four
+	// on opposite sides of it.
+	uint32_t axis = face / 2;
+	float sign = (face & 1) ? -1.0f : 1.0f;
+	float planes[5][3];
+	for (int p = 0; p < 5; ++p)
+	{
+		planes[p][0] = planes[p][1] = planes[p][2] = 0.0f;
+		planes[p][axis] = sign;
+		if (p < 4)
+		{
+			uint32_t other = (axis + 1 + p / 2) % 3;
+			planes[p][other] = (p & 1) ? -1.0f : 1.0f;
+		}
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const ShadowBounds& bounds = casters[i];
+		if (DistanceToBox(position, bounds) > range)
+		{
+			continue;
+		}
+
+		bool inside = true;
+		for (int p = 0; p < 5 && inside; ++p)
+		{
+			// furthest corner along the plane normal
+			float distance = 0.0f;
+			for (int k = 0; k < 3; ++k)
+			{
+				float corner = planes[p][k] > 0.0f ? bounds.max[k] : bounds.min[k];
+				distance += planes[p][k] * (corner - position[k]);
+			}
+			inside = distance >= 0.0f;
+		}
+
+		if (inside)
+		{
+			visible.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+ShadowBounds ShadowCascades::Merge(const ShadowBounds * bounds, size_t count)
+{
+	ShadowBounds result = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			result.min[k] = std::min(result.min[k], bounds[i].min[k]);
+			result.max[k] = std::max(result.max[k], bounds[i].max[k]);
+		}
+	}
+	if (!count)
+	{
+		result = ShadowBounds();
+	}
+	return result;
+}
+
+void ShadowCascades::ToLightSpace(const ShadowBounds & bounds, float centre[3], float extent[3]) const
+{
+	float worldCentre[3], worldExtent[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		worldCentre[k] = (bounds.min[k] + bounds.max[k]) * 0.5f;
+		worldExtent[k] = (bounds.max[k] - bounds.min[k]) * 0.5f;
+	}
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		centre[axis] = Dot(m_basis[axis], worldCentre);
+		extent[axis] = std::fabs(m_basis[axis][0]) * worldExtent[0]
+			+ std::fabs(m_basis[axis][1]) * worldExtent[1]
+			+ std::fabs(m_basis[axis][2]) * worldExtent[2];
+	}
+}
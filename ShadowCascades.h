@@ -0,0 +1,84 @@
+//
+// ShadowCascades.h - Light space fitting and caster culling for the shadow passes
+//
+// Directional lights use cascades: the camera frustum is split in depth and each split gets its own orthographic
+// shadow map fitted around the split's bounding sphere, snapped to whole texels so the edges don't shimmer as the
+// camera moves. Point lights use the six faces of a cube map. Both come with a culling step that keeps only the
+// casters that can throw a shadow into a given cascade / face.
+//
+// All matrices are row-major in the row-vector convention used by SimpleMath (v' = v * M).
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//World space bounding box of a shadow caster
+struct ShadowBounds
+{
+	float	min[3];
+	float	max[3];
+};
+
+struct ShadowCascade
+{
+	float	viewProj[16];		//world to light clip space, depth in [0, 1]
+	float	splitNear;			//camera view depth covered by this cascade
+	float	splitFar;
+	float	centre[2];			//light space x / y of the fitted square
+	float	halfSize;			//half the side of the square, in world units
+	float	depthMin;			//light space depth range of the orthographic projection
+	float	depthMax;
+	float	texelSize;
+};
+
+struct ShadowCascadeDesc
+{
+	uint32_t	count = 3;
+	uint32_t	resolution = 1024;
+	float		lambda = 0.75f;			//0 gives uniform splits, 1 logarithmic
+	float		maxDistance = 60.0f;	//no shadows beyond this view depth
+};
+
+class ShadowCascades
+{
+public:
+	static constexpr uint32_t c_MaxCascades = 4;
+
+	ShadowCascades();
+
+	void SetDesc(const ShadowCascadeDesc& desc);
+	const ShadowCascadeDesc& GetDesc() const { return m_desc; }
+
+	//Fills splits[0..count] with the view depths between cascades, blending logarithmic and uniform spacing
+	static void ComputeSplits(float nearZ, float farZ, uint32_t count, float lambda, float* splits);
+
+	//Fits every cascade for the camera. view is the world to view matrix, projScaleX / projScaleY the _11 and _22
+	//terms of its projection. The depth range of each cascade is pulled back to the start of sceneBounds so casters
+	//between the light and the split still land in the map.
+	void Build(const float view[16], bool rightHanded, float projScaleX, float projScaleY, float nearZ,
+		const float lightDirection[3], const ShadowBounds& sceneBounds);
+
+	uint32_t GetCount() const { return m_desc.count; }
+	const ShadowCascade& GetCascade(uint32_t index) const { return m_cascades[index]; }
+
+	//Indices of the casters that can shadow anything inside the cascade
+	void CullCasters(uint32_t cascade, const ShadowBounds* casters, size_t count, std::vector<uint32_t>& visible) const;
+
+	//Cube map faces for a point light, in the D3D face order +X -X +Y -Y +Z -Z
+	static void BuildCubeFace(const float position[3], float nearZ, float farZ, uint32_t face, float viewProj[16]);
+	static void CullCubeFace(const float position[3], float range, uint32_t face, const ShadowBounds* casters, size_t count,
+		std::vector<uint32_t>& visible);
+
+	//Union of a set of boxes
+	static ShadowBounds Merge(const ShadowBounds* bounds, size_t count);
+
+private:
+	void ToLightSpace(const ShadowBounds& bounds, float centre[3], float extent[3]) const;
+
+	ShadowCascadeDesc	m_desc;
+	ShadowCascade		m_cascades[c_MaxCascades];
+	float				m_basis[3][3];		//light space right, up and forward (the light direction) in world space
+};
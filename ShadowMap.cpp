@@ -0,0 +1,275 @@
+// Depth targets and shader data for the main light's shadows
+#include "pch.h"
+#include "ShadowMap.h"
+#include "AssetData.h"
+
+using Microsoft::WRL::ComPtr;
+
+
+ShadowMap::ShadowMap() :
+	m_states(nullptr),
+	m_comparisonSampler(nullptr),
+	m_resolution(0),
+	m_cubeResolution(0),
+	m_cascadeCount(0)
+{
+}
+
+
+ShadowMap::~ShadowMap()
+{
+}
+
+bool ShadowMap::Init(ID3D11Device * device, StateCache * states, UINT resolution, UINT cascadeCount, UINT cubeResolution, AssetLoader * assets)
+{
+	D3D11_BUFFER_DESC shadowBufferDesc;
+
+	m_resolution = resolution;
+	m_cubeResolution = cubeResolution;
+	m_cascadeCount = std::max<UINT>(1u, std::min<UINT>(cascadeCount, ShadowCascades::c_MaxCascades));
+
+	if (!CreateDepthTarget(device, resolution, m_cascadeCount, false, true, m_cascades)
+		|| !CreateDepthTarget(device, cubeResolution, 6, true, true, m_cube)
+		|| !CreateDepthTarget(device, resolution, m_cascadeCount, false, false, m_cascadeCache)
+		|| !CreateDepthTarget(device, cubeResolution, 6, true, false, m_cubeCache))
+	{
+		return false;
+	}
+
+	auto clearShaderBuffer = DX::ReadAsset(assets, L"shadow_clear_vs.cso");
+	if (FAILED(device->CreateVertexShader(clearShaderBuffer.data(), clearShaderBuffer.size(), NULL, m_clearShader.ReleaseAndGetAddressOf())))
+	{
+		return false;
+	}
+
+	// Setup the description of the dynamic shadow constant buffer that is in the pixel shader.
+	shadowBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	shadowBufferDesc.ByteWidth = sizeof(ShadowBufferType);
+	shadowBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	shadowBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	shadowBufferDesc.MiscFlags = 0;
+	shadowBufferDesc.StructureByteStride = 0;
+	if (FAILED(device->CreateBuffer(&shadowBufferDesc, NULL, m_shadowBuffer.ReleaseAndGetAddressOf())))
+	{
+		return false;
+	}
+
+	m_states = states;
+	m_comparisonSampler = states->ShadowComparison();
+	return true;
+}
+
+void ShadowMap::Reset()
+{
+	for (DepthTarget* target : { &m_cascades, &m_cube, &m_cascadeCache, &m_cubeCache })
+	{
+		target->texture.Reset();
+		target->srv.Reset();
+		target->dsvs.clear();
+	}
+	m_clearShader.Reset();
+	m_shadowBuffer.Reset();
+	m_states = nullptr;
+	m_comparisonSampler = nullptr;
+}
+
+void ShadowMap::BeginCascade(ID3D11DeviceContext * context, UINT cascade)
+{
+	Begin(context, m_cascades, cascade);
+}
+
+void ShadowMap::BeginCubeFace(ID3D11DeviceContext * context, UINT face)
+{
+	Begin(context, m_cube, face);
+}
+
+void ShadowMap::BeginCachedCascade(ID3D11DeviceContext * context, UINT cascade, const ShadowRect * dirty)
+{
+	BeginCached(context, m_cascadeCache, cascade, dirty);
+}
+
+void ShadowMap::BeginCachedCubeFace(ID3D11DeviceContext * context, UINT face, const ShadowRect * dirty)
+{
+	BeginCached(context, m_cubeCache, face, dirty);
+}
+
+void ShadowMap::RestoreCascade(ID3D11DeviceContext * context, UINT cascade)
+{
+	Restore(context, m_cascades, m_cascadeCache, cascade);
+}
+
+void ShadowMap::RestoreCubeFace(ID3D11DeviceContext * context, UINT face)
+{
+	Restore(context, m_cube, m_cubeCache, face);
+}
+
+void ShadowMap::Update(ID3D11DeviceContext * context, ShadowMode mode, const ShadowCascades & cascades, const float lightDirection[3],
+	const float lightPosition[3], float pointNear, float pointFar)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (FAILED(context->Map(m_shadowBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+	{
+		return;
+	}
+
+	ShadowBufferType* dataPtr = (ShadowBufferType*)mappedResource.pData;
+	UINT count = std::min<UINT>(m_cascadeCount, cascades.GetCount());
+	for (UINT i = 0; i < ShadowCascades::c_MaxCascades; ++i)
+	{
+		if (i < count)
+		{
+			const ShadowCascade& cascade = cascades.GetCascade(i);
+			// Transpose the matrices to prepare them for the shader.
+			dataPtr->cascadeViewProj[i] = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(reinterpret_cast<const DirectX::XMFLOAT4X4*>(cascade.viewProj)));
+			dataPtr->splitFar[i] = cascade.splitFar;
+		}
+		else
+		{
+			dataPtr->cascadeViewProj[i] = DirectX::XMMatrixIdentity();
+			dataPtr->splitFar[i] = 0.0f;
+		}
+	}
+	for (int i = 0; i < 3; ++i)
+	{
+		dataPtr->lightDirection[i] = lightDirection[i];
+		dataPtr->lightPosition[i] = lightPosition[i];
+	}
+	dataPtr->mode = static_cast<uint32_t>(mode);
+	dataPtr->cascadeCount = count;
+	dataPtr->pointDepthScale = pointFar / (pointFar - pointNear);
+	dataPtr->pointDepthBias = -pointNear * pointFar / (pointFar - pointNear);
+	dataPtr->texelSize = 1.0f / float(m_resolution);
+	dataPtr->padding = 0.0f;
+	context->Unmap(m_shadowBuffer.Get(), 0);
+}
+
+void ShadowMap::Bind(ID3D11DeviceContext * context)
+{
+	ID3D11ShaderResourceView* views[2] = { m_cascades.srv.Get(), m_cube.srv.Get() };
+	context->PSSetShaderResources(4, 2, views);
+	context->PSSetSamplers(1, 1, &m_comparisonSampler);
+	context->PSSetConstantBuffers(2, 1, m_shadowBuffer.GetAddressOf());
+}
+
+void ShadowMap::Unbind(ID3D11DeviceContext * context)
+{
+	ID3D11ShaderResourceView* views[2] = { nullptr, nullptr };
+	context->PSSetShaderResources(4, 2, views);
+}
+
+void ShadowMap::Begin(ID3D11DeviceContext * context, DepthTarget & target, UINT slice)
+{
+	ID3D11DepthStencilView* dsv = target.dsvs[slice].Get();
+	context->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH, 1.0f, 0);
+	context->OMSetRenderTargets(0, nullptr, dsv);
+	context->RSSetViewports(1, &target.viewport);
+}
+
+void ShadowMap::BeginCached(ID3D11DeviceContext * context, DepthTarget & target, UINT slice, const ShadowRect * dirty)
+{
+	if (!dirty)
+	{
+		Begin(context, target, slice);
+		return;
+	}
+
+	ID3D11DepthStencilView* dsv = target.dsvs[slice].Get();
+	context->OMSetRenderTargets(0, nullptr, dsv);
+	context->RSSetViewports(1, &target.viewport);
+
+	// ClearDepthStencilView can't take a rect, so push a triangle at the far plane through the scissor instead
+	D3D11_RECT scissor = { LONG(dirty->left), LONG(dirty->top), LONG(dirty->right), LONG(dirty->bottom) };
+	context->RSSetScissorRects(1, &scissor);
+	context->RSSetState(m_states->DepthBiased(0, 0.0f, D3D11_CULL_NONE, true));
+	context->OMSetDepthStencilState(m_states->DepthOverwrite(), 0);
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->VSSetShader(m_clearShader.Get(), nullptr, 0);
+	context->PSSetShader(nullptr, nullptr, 0);
+	context->Draw(3, 0);
+	context->OMSetDepthStencilState(m_states->DepthDefault(), 0);
+}
+
+void ShadowMap::Restore(ID3D11DeviceContext * context, DepthTarget & live, DepthTarget & cache, UINT slice)
+{
+	// Depth stencil copies have to take the whole subresource
+	UINT subresource = D3D11CalcSubresource(0, slice, 1);
+	context->CopySubresourceRegion(live.texture.Get(), subresource, 0, 0, 0, cache.texture.Get(), subresource, nullptr);
+
+	context->OMSetRenderTargets(0, nullptr, live.dsvs[slice].Get());
+	context->RSSetViewports(1, &live.viewport);
+}
+
+bool ShadowMap::CreateDepthTarget(ID3D11Device * device, UINT size, UINT slices, bool cube, bool shaderResource, DepthTarget & target)
+{
+	D3D11_TEXTURE2D_DESC depthBufferDesc;
+	D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc;
+	D3D11_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc;
+	ComPtr<ID3D11Texture2D> texture;
+	ComPtr<ID3D11ShaderResourceView> srv;
+
+	// Typeless so the same memory can be a D24 depth target and an R24 texture
+	ZeroMemory(&depthBufferDesc, sizeof(depthBufferDesc));
+	depthBufferDesc.Width = size;
+	depthBufferDesc.Height = size;
+	depthBufferDesc.MipLevels = 1;
+	depthBufferDesc.ArraySize = slices;
+	depthBufferDesc.Format = DXGI_FORMAT_R24G8_TYPELESS;
+	depthBufferDesc.SampleDesc.Count = 1;
+	depthBufferDesc.SampleDesc.Quality = 0;
+	depthBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	depthBufferDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | (shaderResource ? D3D11_BIND_SHADER_RESOURCE : 0);
+	depthBufferDesc.CPUAccessFlags = 0;
+	depthBufferDesc.MiscFlags = cube ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+	if (FAILED(device->CreateTexture2D(&depthBufferDesc, NULL, texture.GetAddressOf())))
+	{
+		return false;
+	}
+
+	// One depth stencil view per slice / face
+	ZeroMemory(&depthStencilViewDesc, sizeof(depthStencilViewDesc));
+	depthStencilViewDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	depthStencilViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+	depthStencilViewDesc.Texture2DArray.MipSlice = 0;
+	depthStencilViewDesc.Texture2DArray.ArraySize = 1;
+
+	std::vector<ComPtr<ID3D11DepthStencilView>> dsvs(slices);
+	for (UINT i = 0; i < slices; ++i)
+	{
+		depthStencilViewDesc.Texture2DArray.FirstArraySlice = i;
+		if (FAILED(device->CreateDepthStencilView(texture.Get(), &depthStencilViewDesc, dsvs[i].GetAddressOf())))
+		{
+			return false;
+		}
+	}
+
+	if (shaderResource)
+	{
+		ZeroMemory(&shaderResourceViewDesc, sizeof(shaderResourceViewDesc));
+		shaderResourceViewDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+		if (cube)
+		{
+			shaderResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+			shaderResourceViewDesc.TextureCube.MostDetailedMip = 0;
+			shaderResourceViewDesc.TextureCube.MipLevels = 1;
+		}
+		else
+		{
+			shaderResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+			shaderResourceViewDesc.Texture2DArray.MostDetailedMip = 0;
+			shaderResourceViewDesc.Texture2DArray.MipLevels = 1;
+			shaderResourceViewDesc.Texture2DArray.FirstArraySlice = 0;
+			shaderResourceViewDesc.Texture2DArray.ArraySize = slices;
+		}
+		if (FAILED(device->CreateShaderResourceView(texture.Get(), &shaderResourceViewDesc, srv.GetAddressOf())))
+		{
+			return false;
+		}
+	}
+
+	target.texture = texture;
+	target.srv = srv;
+	target.dsvs = dsvs;
+	target.viewport = { 0.0f, 0.0f, float(size), float(size), 0.0f, 1.0f };
+	return true;
+}
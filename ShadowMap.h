@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ShadowCache.h"
+#include "ShadowCascades.h"
+#include "StateCache.h"
+#include "AssetLoader.h"
+
+enum class ShadowMode : uint32_t
+{
+	Directional = 0,		//cascades, fitted to the camera
+	Point = 1,				//cube map around the light position
+};
+
+//Depth targets for the main light's shadows and the data light_ps needs to sample them.
+//Like RenderTexture it owns its views and viewport, but the depth is created typeless so it can also be read as a
+//texture, and there is no colour target since the caster passes only write depth.
+//	t4	Texture2DArray	one slice per cascade
+//	t5	TextureCube		point light depth
+//	s1	SamplerComparisonState
+//	b2	ShadowBuffer
+//Each target has a twin holding only the static casters. Game redraws it when ShadowCache says it is dirty, then copies
+//it into the live target and draws the dynamic casters on top.
+class ShadowMap
+{
+public:
+	ShadowMap();
+	~ShadowMap();
+
+	//The clear shader comes from assets when it holds it
+	bool Init(ID3D11Device* device, StateCache* states, UINT resolution, UINT cascadeCount, UINT cubeResolution, AssetLoader* assets = nullptr);
+	void Reset();
+
+	//Clears the slice / face and makes it the depth target with a matching viewport. No colour target is bound.
+	void BeginCascade(ID3D11DeviceContext* context, UINT cascade);
+	void BeginCubeFace(ID3D11DeviceContext* context, UINT face);
+
+	//Makes the static cache's slice / face the depth target. With a dirty rect only that rect is cleared, and the
+	//scissor is left set to it so the casters must be drawn with a scissor enabled rasterizer.
+	void BeginCachedCascade(ID3D11DeviceContext* context, UINT cascade, const ShadowRect* dirty);
+	void BeginCachedCubeFace(ID3D11DeviceContext* context, UINT face, const ShadowRect* dirty);
+
+	//Copies the static cache into the live slice / face and makes that the depth target, without clearing it
+	void RestoreCascade(ID3D11DeviceContext* context, UINT cascade);
+	void RestoreCubeFace(ID3D11DeviceContext* context, UINT face);
+
+	//Uploads the matrices and split depths used by light_ps. lightDirection is only used for Directional,
+	//lightPosition / pointNear / pointFar only for Point.
+	void Update(ID3D11DeviceContext* context, ShadowMode mode, const ShadowCascades& cascades, const float lightDirection[3],
+		const float lightPosition[3], float pointNear, float pointFar);
+
+	void Bind(ID3D11DeviceContext* context);
+	//Unbinds the depth textures so they can be rendered to again
+	void Unbind(ID3D11DeviceContext* context);
+
+	UINT GetResolution() const { return m_resolution; }
+	UINT GetCascadeCount() const { return m_cascadeCount; }
+	UINT GetCubeResolution() const { return m_cubeResolution; }
+
+private:
+	struct ShadowBufferType
+	{
+		DirectX::XMMATRIX	cascadeViewProj[ShadowCascades::c_MaxCascades];
+		float				splitFar[ShadowCascades::c_MaxCascades];
+		float				lightDirection[3];
+		uint32_t			mode;
+		float				lightPosition[3];
+		uint32_t			cascadeCount;
+		float				pointDepthScale;		//NDC depth of a point at distance d along a cube axis is scale + bias / d
+		float				pointDepthBias;
+		float				texelSize;				//1 / resolution of the cascades
+		float				padding;
+	};
+
+	struct DepthTarget
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D>							texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>				srv;		//live targets only
+		std::vector<Microsoft::WRL::ComPtr<ID3D11DepthStencilView>>		dsvs;		//one per slice / face
+		D3D11_VIEWPORT													viewport;
+	};
+
+	bool CreateDepthTarget(ID3D11Device* device, UINT size, UINT slices, bool cube, bool shaderResource, DepthTarget& target);
+	void Begin(ID3D11DeviceContext* context, DepthTarget& target, UINT slice);
+	void BeginCached(ID3D11DeviceContext* context, DepthTarget& target, UINT slice, const ShadowRect* dirty);
+	void Restore(ID3D11DeviceContext* context, DepthTarget& live, DepthTarget& cache, UINT slice);
+
+	DepthTarget														m_cascades;
+	DepthTarget														m_cube;
+	DepthTarget														m_cascadeCache;
+	DepthTarget														m_cubeCache;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader>						m_clearShader;		//far plane triangle for partial clears
+	Microsoft::WRL::ComPtr<ID3D11Buffer>							m_shadowBuffer;
+	StateCache*														m_states;
+	ID3D11SamplerState*												m_comparisonSampler;	//owned by the StateCache
+	UINT															m_resolution;
+	UINT															m_cubeResolution;
+	UINT															m_cascadeCount;
+};
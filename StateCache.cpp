@@ -0,0 +1,364 @@
+// Value-hashed cache of sampler / blend / rasterizer / depth-stencil state objects
+#include "pch.h"
+#include "StateCache.h"
+#include "Hash.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Field by field to and from the portable descriptions, which Normalize and HashDesc work on
+	SamplerStateDesc ToPortable(const D3D11_SAMPLER_DESC& desc)
+	{
+		SamplerStateDesc out;
+		out.filter = desc.Filter;
+		out.addressU = desc.AddressU;
+		out.addressV = desc.AddressV;
+		out.addressW = desc.AddressW;
+		out.mipLodBias = desc.MipLODBias;
+		out.maxAnisotropy = desc.MaxAnisotropy;
+		out.comparisonFunc = desc.ComparisonFunc;
+		for (int i = 0; i < 4; ++i)
+		{
+			out.borderColor[i] = desc.BorderColor[i];
+		}
+		out.minLod = desc.MinLOD;
+		out.maxLod = desc.MaxLOD;
+		return out;
+	}
+
+	D3D11_SAMPLER_DESC ToD3D(const SamplerStateDesc& desc)
+	{
+		D3D11_SAMPLER_DESC out;
+		out.Filter = D3D11_FILTER(desc.filter);
+		out.AddressU = D3D11_TEXTURE_ADDRESS_MODE(desc.addressU);
+		out.AddressV = D3D11_TEXTURE_ADDRESS_MODE(desc.addressV);
+		out.AddressW = D3D11_TEXTURE_ADDRESS_MODE(desc.addressW);
+		out.MipLODBias = desc.mipLodBias;
+		out.MaxAnisotropy = desc.maxAnisotropy;
+		out.ComparisonFunc = D3D11_COMPARISON_FUNC(desc.comparisonFunc);
+		for (int i = 0; i < 4; ++i)
+		{
+			out.BorderColor[i] = desc.borderColor[i];
+		}
+		out.MinLOD = desc.minLod;
+		out.MaxLOD = desc.maxLod;
+		return out;
+	}
+
+	BlendStateDesc ToPortable(const D3D11_BLEND_DESC& desc)
+	{
+		BlendStateDesc out;
+		out.alphaToCoverageEnable = desc.AlphaToCoverageEnable;
+		out.independentBlendEnable = desc.IndependentBlendEnable;
+		for (int i = 0; i < 8; ++i)
+		{
+			const D3D11_RENDER_TARGET_BLEND_DESC& src = desc.RenderTarget[i];
+			RenderTargetBlendStateDesc& dst = out.renderTarget[i];
+			dst.blendEnable = src.BlendEnable;
+			dst.srcBlend = src.SrcBlend;
+			dst.destBlend = src.DestBlend;
+			dst.blendOp = src.BlendOp;
+			dst.srcBlendAlpha = src.SrcBlendAlpha;
+			dst.destBlendAlpha = src.DestBlendAlpha;
+			dst.blendOpAlpha = src.BlendOpAlpha;
+			dst.writeMask = src.RenderTargetWriteMask;
+		}
+		return out;
+	}
+
+	D3D11_BLEND_DESC ToD3D(const BlendStateDesc& desc)
+	{
+		D3D11_BLEND_DESC out;
+		out.AlphaToCoverageEnable = desc.alphaToCoverageEnable;
+		out.IndependentBlendEnable = desc.independentBlendEnable;
+		for (int i = 0; i < 8; ++i)
+		{
+			const RenderTargetBlendStateDesc& src = desc.renderTarget[i];
+			D3D11_RENDER_TARGET_BLEND_DESC& dst = out.RenderTarget[i];
+			dst.BlendEnable = src.blendEnable;
+			dst.SrcBlend = D3D11_BLEND(src.srcBlend);
+			dst.DestBlend = D3D11_BLEND(src.destBlend);
+			dst.BlendOp = D3D11_BLEND_OP(src.blendOp);
+			dst.SrcBlendAlpha = D3D11_BLEND(src.srcBlendAlpha);
+			dst.DestBlendAlpha = D3D11_BLEND(src.destBlendAlpha);
+			dst.BlendOpAlpha = D3D11_BLEND_OP(src.blendOpAlpha);
+			dst.RenderTargetWriteMask = UINT8(src.writeMask);
+		}
+		return out;
+	}
+
+	RasterizerStateDesc ToPortable(const D3D11_RASTERIZER_DESC& desc)
+	{
+		RasterizerStateDesc out;
+		out.fillMode = desc.FillMode;
+		out.cullMode = desc.CullMode;
+		out.frontCounterClockwise = desc.FrontCounterClockwise;
+		out.depthBias = desc.DepthBias;
+		out.depthBiasClamp = desc.DepthBiasClamp;
+		out.slopeScaledDepthBias = desc.SlopeScaledDepthBias;
+		out.depthClipEnable = desc.DepthClipEnable;
+		out.scissorEnable = desc.ScissorEnable;
+		out.multisampleEnable = desc.MultisampleEnable;
+		out.antialiasedLineEnable = desc.AntialiasedLineEnable;
+		return out;
+	}
+
+	D3D11_RASTERIZER_DESC ToD3D(const RasterizerStateDesc& desc)
+	{
+		D3D11_RASTERIZER_DESC out;
+		out.FillMode = D3D11_FILL_MODE(desc.fillMode);
+		out.CullMode = D3D11_CULL_MODE(desc.cullMode);
+		out.FrontCounterClockwise = desc.frontCounterClockwise;
+		out.DepthBias = desc.depthBias;
+		out.DepthBiasClamp = desc.depthBiasClamp;
+		out.SlopeScaledDepthBias = desc.slopeScaledDepthBias;
+		out.DepthClipEnable = desc.depthClipEnable;
+		out.ScissorEnable = desc.scissorEnable;
+		out.MultisampleEnable = desc.multisampleEnable;
+		out.AntialiasedLineEnable = desc.antialiasedLineEnable;
+		return out;
+	}
+
+	StencilFaceStateDesc ToPortable(const D3D11_DEPTH_STENCILOP_DESC& desc)
+	{
+		return { uint32_t(desc.StencilFailOp), uint32_t(desc.StencilDepthFailOp), uint32_t(desc.StencilPassOp), uint32_t(desc.StencilFunc) };
+	}
+
+	D3D11_DEPTH_STENCILOP_DESC ToD3D(const StencilFaceStateDesc& desc)
+	{
+		return { D3D11_STENCIL_OP(desc.failOp), D3D11_STENCIL_OP(desc.depthFailOp), D3D11_STENCIL_OP(desc.passOp), D3D11_COMPARISON_FUNC(desc.func) };
+	}
+
+	DepthStencilStateDesc ToPortable(const D3D11_DEPTH_STENCIL_DESC& desc)
+	{
+		DepthStencilStateDesc out;
+		out.depthEnable = desc.DepthEnable;
+		out.depthWriteMask = desc.DepthWriteMask;
+		out.depthFunc = desc.DepthFunc;
+		out.stencilEnable = desc.StencilEnable;
+		out.stencilReadMask = desc.StencilReadMask;
+		out.stencilWriteMask = desc.StencilWriteMask;
+		out.frontFace = ToPortable(desc.FrontFace);
+		out.backFace = ToPortable(desc.BackFace);
+		return out;
+	}
+
+	D3D11_DEPTH_STENCIL_DESC ToD3D(const DepthStencilStateDesc& desc)
+	{
+		D3D11_DEPTH_STENCIL_DESC out;
+		out.DepthEnable = desc.depthEnable;
+		out.DepthWriteMask = D3D11_DEPTH_WRITE_MASK(desc.depthWriteMask);
+		out.DepthFunc = D3D11_COMPARISON_FUNC(desc.depthFunc);
+		out.StencilEnable = desc.stencilEnable;
+		out.StencilReadMask = UINT8(desc.stencilReadMask);
+		out.StencilWriteMask = UINT8(desc.stencilWriteMask);
+		out.FrontFace = ToD3D(desc.frontFace);
+		out.BackFace = ToD3D(desc.backFace);
+		return out;
+	}
+
+	D3D11_SAMPLER_DESC MakeSamplerDesc(D3D11_FILTER filter, D3D11_TEXTURE_ADDRESS_MODE address)
+	{
+		D3D11_SAMPLER_DESC desc;
+		memset(&desc, 0, sizeof(desc));
+		desc.Filter = filter;
+		desc.AddressU = address;
+		desc.AddressV = address;
+		desc.AddressW = address;
+		desc.MipLODBias = 0.0f;
+		desc.MaxAnisotropy = 1;
+		desc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+		desc.MinLOD = 0;
+		desc.MaxLOD = D3D11_FLOAT32_MAX;
+		return desc;
+	}
+
+	D3D11_RASTERIZER_DESC MakeRasterizerDesc(D3D11_CULL_MODE cull)
+	{
+		D3D11_RASTERIZER_DESC desc;
+		memset(&desc, 0, sizeof(desc));
+		desc.FillMode = D3D11_FILL_SOLID;
+		desc.CullMode = cull;
+		desc.DepthClipEnable = TRUE;
+		desc.MultisampleEnable = TRUE;
+		return desc;
+	}
+}
+
+
+StateCache::StateCache() :
+	m_hits(0),
+	m_misses(0)
+{
+}
+
+
+StateCache::~StateCache()
+{
+}
+
+void StateCache::SetDevice(ID3D11Device * device)
+{
+	m_device = device;
+}
+
+void StateCache::Reset()
+{
+	m_samplers = {};
+	m_blends = {};
+	m_rasterizers = {};
+	m_depthStencils = {};
+	m_device.Reset();
+}
+
+size_t StateCache::GetCount() const
+{
+	return m_samplers.count + m_blends.count + m_rasterizers.count + m_depthStencils.count;
+}
+
+template<typename Desc, typename State, typename Create>
+State* StateCache::Lookup(Table<Desc, State>& table, const Desc& desc, Create create)
+{
+	Desc normalized = Normalize(desc);
+	uint64_t hash = Hash::OfValue(normalized);
+
+	auto& bucket = table.entries[hash];
+	for (const auto& entry : bucket)
+	{
+		if (memcmp(&entry.desc, &normalized, sizeof(Desc)) == 0)
+		{
+			++m_hits;
+			return entry.state.Get();
+		}
+	}
+
+	++m_misses;
+	if (!m_device)
+	{
+		return nullptr;
+	}
+
+	typename Table<Desc, State>::Entry entry;
+	entry.desc = normalized;
+	DX::ThrowIfFailed(create(ToD3D(normalized), entry.state.GetAddressOf()));
+
+	State* state = entry.state.Get();
+	bucket.push_back(std::move(entry));
+	++table.count;
+	return state;
+}
+
+ID3D11SamplerState* StateCache::GetSampler(const D3D11_SAMPLER_DESC & desc)
+{
+	return Lookup(m_samplers, ToPortable(desc), [this](const D3D11_SAMPLER_DESC& d, ID3D11SamplerState** s) { return m_device->CreateSamplerState(&d, s); });
+}
+
+ID3D11BlendState* StateCache::GetBlend(const D3D11_BLEND_DESC & desc)
+{
+	return Lookup(m_blends, ToPortable(desc), [this](const D3D11_BLEND_DESC& d, ID3D11BlendState** s) { return m_device->CreateBlendState(&d, s); });
+}
+
+ID3D11RasterizerState* StateCache::GetRasterizer(const D3D11_RASTERIZER_DESC & desc)
+{
+	return Lookup(m_rasterizers, ToPortable(desc), [this](const D3D11_RASTERIZER_DESC& d, ID3D11RasterizerState** s) { return m_device->CreateRasterizerState(&d, s); });
+}
+
+ID3D11DepthStencilState* StateCache::GetDepthStencil(const D3D11_DEPTH_STENCIL_DESC & desc)
+{
+	return Lookup(m_depthStencils, ToPortable(desc), [this](const D3D11_DEPTH_STENCIL_DESC& d, ID3D11DepthStencilState** s) { return m_device->CreateDepthStencilState(&d, s); });
+}
+
+ID3D11SamplerState* StateCache::LinearWrap()
+{
+	return GetSampler(MakeSamplerDesc(D3D11_FILTER_MIN_MAG_MIP_LINEAR, D3D11_TEXTURE_ADDRESS_WRAP));
+}
+
+ID3D11SamplerState* StateCache::AnisotropicWrap(UINT maxAnisotropy)
+{
+	D3D11_SAMPLER_DESC desc = MakeSamplerDesc(D3D11_FILTER_ANISOTROPIC, D3D11_TEXTURE_ADDRESS_WRAP);
+	desc.MaxAnisotropy = maxAnisotropy;
+	return GetSampler(desc);
+}
+
+ID3D11SamplerState* StateCache::ShadowComparison()
+{
+	// Outside the shadow map counts as lit, hence the white border
+	D3D11_SAMPLER_DESC desc = MakeSamplerDesc(D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT, D3D11_TEXTURE_ADDRESS_BORDER);
+	desc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+	desc.BorderColor[0] = 1.0f;
+	desc.BorderColor[1] = 1.0f;
+	desc.BorderColor[2] = 1.0f;
+	desc.BorderColor[3] = 1.0f;
+	return GetSampler(desc);
+}
+
+ID3D11BlendState* StateCache::Opaque()
+{
+	D3D11_BLEND_DESC desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.RenderTarget[0].BlendEnable = FALSE;
+	desc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+	desc.RenderTarget[0].DestBlend = D3D11_BLEND_ZERO;
+	desc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	desc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	desc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+	desc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	desc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	return GetBlend(desc);
+}
+
+ID3D11DepthStencilState* StateCache::DepthDefault()
+{
+	D3D11_DEPTH_STENCIL_DESC desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.DepthEnable = TRUE;
+	desc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	desc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+	desc.StencilEnable = FALSE;
+	desc.StencilReadMask = D3D11_DEFAULT_STENCIL_READ_MASK;
+	desc.StencilWriteMask = D3D11_DEFAULT_STENCIL_WRITE_MASK;
+	desc.FrontFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
+	desc.FrontFace.StencilDepthFailOp = D3D11_STENCIL_OP_KEEP;
+	desc.FrontFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
+	desc.FrontFace.StencilFailOp = D3D11_STENCIL_OP_KEEP;
+	desc.BackFace = desc.FrontFace;
+	return GetDepthStencil(desc);
+}
+
+ID3D11DepthStencilState* StateCache::DepthOverwrite()
+{
+	D3D11_DEPTH_STENCIL_DESC desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.DepthEnable = TRUE;
+	desc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	desc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	desc.StencilEnable = FALSE;
+	desc.StencilReadMask = D3D11_DEFAULT_STENCIL_READ_MASK;
+	desc.StencilWriteMask = D3D11_DEFAULT_STENCIL_WRITE_MASK;
+	desc.FrontFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
+	desc.FrontFace.StencilDepthFailOp = D3D11_STENCIL_OP_KEEP;
+	desc.FrontFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
+	desc.FrontFace.StencilFailOp = D3D11_STENCIL_OP_KEEP;
+	desc.BackFace = desc.FrontFace;
+	return GetDepthStencil(desc);
+}
+
+ID3D11RasterizerState* StateCache::CullClockwise()
+{
+	return GetRasterizer(MakeRasterizerDesc(D3D11_CULL_FRONT));
+}
+
+ID3D11RasterizerState* StateCache::CullCounterClockwise()
+{
+	return GetRasterizer(MakeRasterizerDesc(D3D11_CULL_BACK));
+}
+
+ID3D11RasterizerState* StateCache::DepthBiased(INT depthBias, float slopeScaledDepthBias, D3D11_CULL_MODE cullMode, bool scissor)
+{
+	D3D11_RASTERIZER_DESC desc = MakeRasterizerDesc(cullMode);
+	desc.DepthBias = depthBias;
+	desc.SlopeScaledDepthBias = slopeScaledDepthBias;
+	desc.ScissorEnable = scissor ? TRUE : FALSE;
+	return GetRasterizer(desc);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "StateDesc.h"
+#include <unordered_map>
+#include <vector>
+
+//Deduplicates sampler, blend, rasterizer and depth-stencil state objects by the value of their description.
+//Every Shader and the render loop ask the cache for a description and get back a shared object, so identical
+//states are only ever created once per device. Reset() must be called on device loss. Descriptions are keyed by
+//their normalised portable form, see StateDesc.h.
+class StateCache
+{
+public:
+	StateCache();
+	~StateCache();
+
+	void SetDevice(ID3D11Device* device);
+	void Reset();
+
+	ID3D11SamplerState*			GetSampler(const D3D11_SAMPLER_DESC& desc);
+	ID3D11BlendState*			GetBlend(const D3D11_BLEND_DESC& desc);
+	ID3D11RasterizerState*		GetRasterizer(const D3D11_RASTERIZER_DESC& desc);
+	ID3D11DepthStencilState*	GetDepthStencil(const D3D11_DEPTH_STENCIL_DESC& desc);
+
+	//Presets matching the ones the framework used to create by hand / through CommonStates
+	ID3D11SamplerState*			LinearWrap();
+	ID3D11SamplerState*			AnisotropicWrap(UINT maxAnisotropy = 8);
+	ID3D11SamplerState*			ShadowComparison();			///< LESS_EQUAL comparison sampler with white border, for PCF shadow lookups
+	ID3D11BlendState*			Opaque();
+	ID3D11DepthStencilState*	DepthDefault();
+	ID3D11RasterizerState*		CullClockwise();
+	ID3D11RasterizerState*		CullCounterClockwise();
+	ID3D11RasterizerState*		DepthBiased(INT depthBias, float slopeScaledDepthBias, D3D11_CULL_MODE cullMode = D3D11_CULL_BACK,
+									bool scissor = false);		///< depth bias, for shadow caster passes
+	ID3D11DepthStencilState*	DepthOverwrite();			///< always passes and writes depth, for clearing part of a depth target
+
+	uint32_t GetHits() const { return m_hits; }
+	uint32_t GetMisses() const { return m_misses; }
+	size_t GetCount() const;
+	void ResetCounters() { m_hits = 0; m_misses = 0; }
+
+private:
+	template<typename Desc, typename State>
+	struct Table
+	{
+		struct Entry
+		{
+			Desc								desc;
+			Microsoft::WRL::ComPtr<State>		state;
+		};
+		std::unordered_map<uint64_t, std::vector<Entry>>	entries;
+		size_t												count = 0;
+	};
+
+	template<typename Desc, typename State, typename Create>
+	State* Lookup(Table<Desc, State>& table, const Desc& desc, Create create);
+
+	Microsoft::WRL::ComPtr<ID3D11Device>								m_device;
+	Table<SamplerStateDesc, ID3D11SamplerState>							m_samplers;
+	Table<BlendStateDesc, ID3D11BlendState>								m_blends;
+	Table<RasterizerStateDesc, ID3D11RasterizerState>					m_rasterizers;
+	Table<DepthStencilStateDesc, ID3D11DepthStencilState>				m_depthStencils;
+	uint32_t															m_hits;
+	uint32_t															m_misses;
+};
@@ -0,0 +1,126 @@
+// Normalising and hashing of portable state descriptions
+#include "StateDesc.h"
+#include "Hash.h"
+
+#include <cstring>
+
+namespace
+{
+	// The Direct3D 11 enum values the normalised fields are reset to
+	constexpr uint32_t c_BlendZero = 1;
+	constexpr uint32_t c_BlendOne = 2;
+	constexpr uint32_t c_BlendOpAdd = 1;
+	constexpr uint32_t c_ComparisonNever = 1;
+	constexpr uint32_t c_ComparisonLess = 2;
+	constexpr uint32_t c_ComparisonAlways = 8;
+	constexpr uint32_t c_DepthWriteZero = 0;
+	constexpr uint32_t c_StencilKeep = 1;
+	constexpr uint32_t c_StencilMask = 0xff;
+	constexpr uint32_t c_AddressBorder = 4;
+
+	// D3D11_FILTER bits: the reduction type sits above bit 7, 1 being comparison, and every anisotropic filter has
+	// the low bits 0x55
+	bool IsComparison(uint32_t filter) { return (filter >> 7 & 3) == 1; }
+	bool IsAnisotropic(uint32_t filter) { return (filter & 0x7f) == 0x55; }
+
+	uint32_t Bool(uint32_t value) { return value ? 1 : 0; }
+}
+
+SamplerStateDesc Normalize(const SamplerStateDesc & desc)
+{
+	SamplerStateDesc out = desc;
+	if (!IsAnisotropic(desc.filter))
+	{
+		out.maxAnisotropy = 1;
+	}
+	if (!IsComparison(desc.filter))
+	{
+		out.comparisonFunc = c_ComparisonNever;
+	}
+	if (desc.addressU != c_AddressBorder && desc.addressV != c_AddressBorder && desc.addressW != c_AddressBorder)
+	{
+		memset(out.borderColor, 0, sizeof(out.borderColor));
+	}
+	return out;
+}
+
+BlendStateDesc Normalize(const BlendStateDesc & desc)
+{
+	BlendStateDesc out;
+	memset(&out, 0, sizeof(out));
+	out.alphaToCoverageEnable = Bool(desc.alphaToCoverageEnable);
+	out.independentBlendEnable = Bool(desc.independentBlendEnable);
+
+	// Without independent blending only the first target is used, so ignore whatever is in the rest
+	int targets = desc.independentBlendEnable ? 8 : 1;
+	for (int i = 0; i < targets; ++i)
+	{
+		const RenderTargetBlendStateDesc& src = desc.renderTarget[i];
+		RenderTargetBlendStateDesc& dst = out.renderTarget[i];
+		dst = src;
+		dst.blendEnable = Bool(src.blendEnable);
+		dst.writeMask = src.writeMask & 0xf;
+		if (!dst.blendEnable)
+		{
+			dst.srcBlend = dst.srcBlendAlpha = c_BlendOne;
+			dst.destBlend = dst.destBlendAlpha = c_BlendZero;
+			dst.blendOp = dst.blendOpAlpha = c_BlendOpAdd;
+		}
+	}
+	return out;
+}
+
+RasterizerStateDesc Normalize(const RasterizerStateDesc & desc)
+{
+	RasterizerStateDesc out = desc;
+	out.frontCounterClockwise = Bool(desc.frontCounterClockwise);
+	out.depthClipEnable = Bool(desc.depthClipEnable);
+	out.scissorEnable = Bool(desc.scissorEnable);
+	out.multisampleEnable = Bool(desc.multisampleEnable);
+	out.antialiasedLineEnable = Bool(desc.antialiasedLineEnable);
+	return out;
+}
+
+DepthStencilStateDesc Normalize(const DepthStencilStateDesc & desc)
+{
+	DepthStencilStateDesc out = desc;
+	out.depthEnable = Bool(desc.depthEnable);
+	out.stencilEnable = Bool(desc.stencilEnable);
+	if (!out.depthEnable)
+	{
+		out.depthWriteMask = c_DepthWriteZero;
+		out.depthFunc = c_ComparisonLess;
+	}
+	if (!out.stencilEnable)
+	{
+		out.stencilReadMask = out.stencilWriteMask = c_StencilMask;
+		out.frontFace = { c_StencilKeep, c_StencilKeep, c_StencilKeep, c_ComparisonAlways };
+		out.backFace = out.frontFace;
+	}
+	else
+	{
+		out.stencilReadMask &= c_StencilMask;
+		out.stencilWriteMask &= c_StencilMask;
+	}
+	return out;
+}
+
+uint64_t HashDesc(const SamplerStateDesc & desc)
+{
+	return Hash::OfValue(Normalize(desc));
+}
+
+uint64_t HashDesc(const BlendStateDesc & desc)
+{
+	return Hash::OfValue(Normalize(desc));
+}
+
+uint64_t HashDesc(const RasterizerStateDesc & desc)
+{
+	return Hash::OfValue(Normalize(desc));
+}
+
+uint64_t HashDesc(const DepthStencilStateDesc & desc)
+{
+	return Hash::OfValue(Normalize(desc));
+}
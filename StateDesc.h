@@ -0,0 +1,96 @@
+//
+// StateDesc.h - Portable sampler, blend, rasterizer and depth-stencil descriptions, as StateCache keys them
+//
+// Each mirrors its D3D11_*_DESC field for field with the same enum values, but every field is 4 bytes so there is no
+// padding to zero and a description can be hashed and compared as raw bytes. StateCache converts the Direct3D
+// description into one of these, normalises it and looks the state up by its hash, so the same state reached through
+// different but equivalent descriptions is only created once.
+//
+// Normalising puts every BOOL in 0 or 1 and resets the fields Direct3D ignores to fixed values: blend targets past the
+// first without independent blending and the factors of a target that doesn't blend, the anisotropy of a sampler that
+// doesn't filter anisotropically, the comparison of one that doesn't compare and the border colour of one with no
+// border address, the depth test of a state without depth and the stencil faces and masks of one without stencil.
+//
+
+#pragma once
+
+#include <cstdint>
+
+struct SamplerStateDesc
+{
+	uint32_t	filter;				//D3D11_FILTER
+	uint32_t	addressU;			//D3D11_TEXTURE_ADDRESS_MODE
+	uint32_t	addressV;
+	uint32_t	addressW;
+	float		mipLodBias;
+	uint32_t	maxAnisotropy;
+	uint32_t	comparisonFunc;		//D3D11_COMPARISON_FUNC
+	float		borderColor[4];
+	float		minLod;
+	float		maxLod;
+};
+
+struct RenderTargetBlendStateDesc
+{
+	uint32_t	blendEnable;
+	uint32_t	srcBlend;			//D3D11_BLEND
+	uint32_t	destBlend;
+	uint32_t	blendOp;			//D3D11_BLEND_OP
+	uint32_t	srcBlendAlpha;
+	uint32_t	destBlendAlpha;
+	uint32_t	blendOpAlpha;
+	uint32_t	writeMask;			//D3D11_COLOR_WRITE_ENABLE bits, a UINT8 in Direct3D
+};
+
+struct BlendStateDesc
+{
+	uint32_t					alphaToCoverageEnable;
+	uint32_t					independentBlendEnable;
+	RenderTargetBlendStateDesc	renderTarget[8];
+};
+
+struct RasterizerStateDesc
+{
+	uint32_t	fillMode;			//D3D11_FILL_MODE
+	uint32_t	cullMode;			//D3D11_CULL_MODE
+	uint32_t	frontCounterClockwise;
+	int32_t		depthBias;
+	float		depthBiasClamp;
+	float		slopeScaledDepthBias;
+	uint32_t	depthClipEnable;
+	uint32_t	scissorEnable;
+	uint32_t	multisampleEnable;
+	uint32_t	antialiasedLineEnable;
+};
+
+struct StencilFaceStateDesc
+{
+	uint32_t	failOp;				//D3D11_STENCIL_OP
+	uint32_t	depthFailOp;
+	uint32_t	passOp;
+	uint32_t	func;				//D3D11_COMPARISON_FUNC
+};
+
+struct DepthStencilStateDesc
+{
+	uint32_t				depthEnable;
+	uint32_t				depthWriteMask;		//D3D11_DEPTH_WRITE_MASK
+	uint32_t				depthFunc;			//D3D11_COMPARISON_FUNC
+	uint32_t				stencilEnable;
+	uint32_t				stencilReadMask;	//UINT8s in Direct3D
+	uint32_t				stencilWriteMask;
+	StencilFaceStateDesc	frontFace;
+	StencilFaceStateDesc	backFace;
+};
+
+//The description with what Direct3D ignores reset, so equivalent descriptions compare and hash alike
+SamplerStateDesc Normalize(const SamplerStateDesc& desc);
+BlendStateDesc Normalize(const BlendStateDesc& desc);
+RasterizerStateDesc Normalize(const RasterizerStateDesc& desc);
+DepthStencilStateDesc Normalize(const DepthStencilStateDesc& desc);
+
+//Hash of the normalised description
+uint64_t HashDesc(const SamplerStateDesc& desc);
+uint64_t HashDesc(const BlendStateDesc& desc);
+uint64_t HashDesc(const RasterizerStateDesc& desc);
+uint64_t HashDesc(const DepthStencilStateDesc& desc);
@@ -0,0 +1,256 @@
+// Placeholders and per frame creation of the streamed textures
+#include "pch.h"
+#include "TextureManager.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	uint32_t LevelSize(uint32_t size, uint32_t mip)
+	{
+		return std::max<uint32_t>(1, size >> mip);
+	}
+}
+
+
+TextureManager::TextureManager() :
+	m_pixelsPerUnit(500.0f)
+{
+}
+
+
+TextureManager::~TextureManager()
+{
+}
+
+bool TextureManager::Init(ID3D11Device * device)
+{
+	m_device = device;
+
+	// Mid grey, so an untextured wall is lit the same as it will be once the texture arrives
+	const uint32_t grey = 0xff808080;
+	CD3D11_TEXTURE2D_DESC textureDesc(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
+	D3D11_SUBRESOURCE_DATA initialData = { &grey, sizeof(grey), 0 };
+	ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(device->CreateTexture2D(&textureDesc, &initialData, texture.GetAddressOf())))
+	{
+		return false;
+	}
+	return SUCCEEDED(device->CreateShaderResourceView(texture.Get(), nullptr, m_placeholder.ReleaseAndGetAddressOf()));
+}
+
+void TextureManager::Reset()
+{
+	m_views.clear();
+	m_placeholder.Reset();
+	m_device.Reset();
+	m_budget.Clear();
+	m_streamer.Requeue();
+}
+
+ID3D11ShaderResourceView * TextureManager::Get(TextureHandle handle) const
+{
+	if (handle < m_views.size() && m_views[handle])
+	{
+		return m_views[handle].Get();
+	}
+	return m_placeholder.Get();
+}
+
+void TextureManager::Use(TextureHandle handle, float radius, float distance, float uvRepeat)
+{
+	if (!m_budget.IsTracked(handle))
+	{
+		return;
+	}
+
+	const DDS::TextureInfo& info = m_streamer.GetInfo(handle);
+	m_budget.Use(handle, MipStreaming::ComputeDesiredMip(std::max(info.width, info.height), uvRepeat, radius, distance, m_pixelsPerUnit));
+}
+
+void TextureManager::Update(ID3D11DeviceContext * context, uint32_t maxCreates, uint32_t maxLoads)
+{
+	if (!m_device)
+	{
+		return;
+	}
+
+	m_streamer.Update([this](TextureHandle handle, const TextureFile& file)
+	{
+		return Create(handle, file);
+	}, maxCreates, [this, context](TextureHandle handle, const TextureFile* file)
+	{
+		if (file)
+		{
+			AddLevels(context, handle, *file);
+		}
+		else
+		{
+			m_budget.CancelLoad(handle);
+		}
+	});
+
+	// Drops are made room for the loads, so they go first
+	m_budget.Plan(m_loads, m_drops, maxLoads);
+	for (const MipChange& drop : m_drops)
+	{
+		DropLevels(context, drop.texture, drop.mip);
+	}
+	for (const MipChange& load : m_loads)
+	{
+		if (!m_streamer.RequestLevels(load.texture, load.mip, m_budget.GetResidentMip(load.texture)))
+		{
+			m_budget.CancelLoad(load.texture);
+		}
+	}
+}
+
+bool TextureManager::Create(TextureHandle handle, const TextureFile & file)
+{
+	if (!MipStreaming::IsStreamable(file.info))
+	{
+		ComPtr<ID3D11ShaderResourceView> view;
+		if (FAILED(CreateDDSTextureFromMemory(m_device.Get(), file.image.GetData(), file.image.GetSize(), nullptr, view.GetAddressOf())))
+		{
+			return false;
+		}
+
+		if (handle >= m_views.size())
+		{
+			m_views.resize(handle + 1);
+		}
+		m_views[handle] = view;
+		m_budget.Add(handle, file.info, 0);
+		return true;
+	}
+
+	// Straight from the mapped file
+	const DDS::TextureInfo& info = file.info;
+	std::vector<D3D11_SUBRESOURCE_DATA> initialData(file.endMip - file.firstMip);
+	for (uint32_t mip = file.firstMip; mip < file.endMip; ++mip)
+	{
+		const DDSSurface& level = file.GetLevel(mip);
+		D3D11_SUBRESOURCE_DATA& data = initialData[mip - file.firstMip];
+		data.pSysMem = level.data;
+		data.SysMemPitch = level.rowPitch;
+		data.SysMemSlicePitch = static_cast<UINT>(level.slicePitch);
+	}
+
+	ComPtr<ID3D11Texture2D> texture = CreateLevels(info, file.firstMip, initialData.data());
+	if (!texture || !SetView(handle, texture.Get()))
+	{
+		return false;
+	}
+	m_budget.Add(handle, info, file.firstMip);
+	return true;
+}
+
+void TextureManager::AddLevels(ID3D11DeviceContext * context, TextureHandle handle, const TextureFile & file)
+{
+	// The texture can't have changed while the levels were read, Plan leaves loading textures alone
+	uint32_t resident = m_budget.GetResidentMip(handle);
+	if (handle >= m_views.size() || !m_views[handle] || file.endMip != resident)
+	{
+		m_budget.CancelLoad(handle);
+		return;
+	}
+
+	const DDS::TextureInfo& info = file.info;
+	ComPtr<ID3D11Texture2D> texture = CreateLevels(info, file.firstMip, nullptr);
+	if (!texture)
+	{
+		m_budget.CancelLoad(handle);
+		return;
+	}
+
+	// New levels from the file, the coarser ones already on the GPU copied across
+	for (uint32_t mip = file.firstMip; mip < file.endMip; ++mip)
+	{
+		const DDSSurface& level = file.GetLevel(mip);
+		context->UpdateSubresource(texture.Get(), mip - file.firstMip, nullptr, level.data, level.rowPitch, static_cast<UINT>(level.slicePitch));
+	}
+
+	ComPtr<ID3D11Resource> old;
+	m_views[handle]->GetResource(old.GetAddressOf());
+	for (uint32_t mip = resident; mip < info.mipCount; ++mip)
+	{
+		context->CopySubresourceRegion(texture.Get(), mip - file.firstMip, 0, 0, 0, old.Get(), mip - resident, nullptr);
+	}
+
+	if (!SetView(handle, texture.Get()))
+	{
+		m_budget.CancelLoad(handle);
+		return;
+	}
+	m_budget.SetResident(handle, file.firstMip);
+}
+
+void TextureManager::DropLevels(ID3D11DeviceContext * context, TextureHandle handle, uint32_t mip)
+{
+	// Plan already counts the memory as free, so if the smaller copy can't be made the texture just stays as it was
+	if (handle >= m_views.size() || !m_views[handle])
+	{
+		return;
+	}
+	const DDS::TextureInfo& info = m_streamer.GetInfo(handle);
+	ComPtr<ID3D11Resource> old;
+	m_views[handle]->GetResource(old.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+	m_views[handle]->GetDesc(&viewDesc);
+	uint32_t resident = info.mipCount - viewDesc.Texture2D.MipLevels;
+	if (mip <= resident)
+	{
+		return;
+	}
+
+	ComPtr<ID3D11Texture2D> texture = CreateLevels(info, mip, nullptr);
+	if (!texture)
+	{
+		return;
+	}
+	for (uint32_t level = mip; level < info.mipCount; ++level)
+	{
+		context->CopySubresourceRegion(texture.Get(), level - mip, 0, 0, 0, old.Get(), level - resident, nullptr);
+	}
+	SetView(handle, texture.Get());
+}
+
+ComPtr<ID3D11Texture2D> TextureManager::CreateLevels(const DDS::TextureInfo & info, uint32_t firstMip, const D3D11_SUBRESOURCE_DATA * initialData)
+{
+	D3D11_TEXTURE2D_DESC textureDesc;
+	textureDesc.Width = LevelSize(info.width, firstMip);
+	textureDesc.Height = LevelSize(info.height, firstMip);
+	textureDesc.MipLevels = info.mipCount - firstMip;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = static_cast<DXGI_FORMAT>(info.format);
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.CPUAccessFlags = 0;
+	textureDesc.MiscFlags = 0;
+
+	ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(m_device->CreateTexture2D(&textureDesc, initialData, texture.GetAddressOf())))
+	{
+		return nullptr;
+	}
+	return texture;
+}
+
+bool TextureManager::SetView(TextureHandle handle, ID3D11Texture2D * texture)
+{
+	ComPtr<ID3D11ShaderResourceView> view;
+	if (FAILED(m_device->CreateShaderResourceView(texture, nullptr, view.GetAddressOf())))
+	{
+		return false;
+	}
+
+	if (handle >= m_views.size())
+	{
+		m_views.resize(handle + 1);
+	}
+	m_views[handle] = view;
+	return true;
+}
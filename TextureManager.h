@@ -0,0 +1,62 @@
+#pragma once
+
+#include "MipStreaming.h"
+#include "TextureStreamer.h"
+
+//D3D side of the texture streamer. Hands out handles straight away and resolves them to a 1x1 grey placeholder
+//until the real texture has been read in the background and created, a few per frame.
+//Textures with mip chains are created from their mip tail. Objects report each frame how close they are with Use,
+//and the finer levels are streamed in, or dropped again, to keep the total under the budget.
+class TextureManager
+{
+public:
+	TextureManager();
+	~TextureManager();
+
+	//Creates the placeholder. Textures requested before a device loss are streamed in again from here on.
+	bool Init(ID3D11Device* device);
+	void Reset();
+
+	//Reads the textures the archive holds from it rather than from loose files, see TextureStreamer::SetArchive
+	void SetArchive(const AssetArchive* archive) { m_streamer.SetArchive(archive); }
+
+	TextureHandle Load(const std::string& path, int priority = 0) { return m_streamer.Request(path, priority); }
+
+	//The texture if it is resident, otherwise the placeholder
+	ID3D11ShaderResourceView* Get(TextureHandle handle) const;
+
+	void SetBudget(size_t bytes) { m_budget.SetBudget(bytes); }
+	//From the projection matrix (_22) and the viewport height, for working out how large objects are on screen
+	void SetProjection(float projScaleY, float screenHeight) { m_pixelsPerUnit = projScaleY * screenHeight * 0.5f; }
+
+	//An object of the given bounding radius is drawn with the texture this frame, distance is from the camera to
+	//its nearest point and uvRepeat how many times the texture wraps across it
+	void Use(TextureHandle handle, float radius, float distance, float uvRepeat = 1.0f);
+
+	//Creates up to maxCreates of the textures that have finished reading, swaps in finished mip levels and starts
+	//up to maxLoads more, call once a frame after the Use calls for the previous one
+	void Update(ID3D11DeviceContext* context, uint32_t maxCreates = 2, uint32_t maxLoads = 2);
+
+	bool IsLoading() const { return m_streamer.GetPendingCount() > 0 || m_streamer.GetLevelReads() > 0; }
+	const TextureStreamer& GetStreamer() const { return m_streamer; }
+	const MipBudget& GetBudget() const { return m_budget; }
+
+private:
+	bool Create(TextureHandle handle, const TextureFile& file);
+	void AddLevels(ID3D11DeviceContext* context, TextureHandle handle, const TextureFile& file);
+	void DropLevels(ID3D11DeviceContext* context, TextureHandle handle, uint32_t mip);
+
+	//A texture holding levels [firstMip, mipCount) of info, filled from initialData if there is any
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> CreateLevels(const DDS::TextureInfo& info, uint32_t firstMip, const D3D11_SUBRESOURCE_DATA* initialData);
+	//Swaps the view of handle over to texture
+	bool SetView(TextureHandle handle, ID3D11Texture2D* texture);
+
+	TextureStreamer													m_streamer;
+	MipBudget														m_budget;
+	float															m_pixelsPerUnit;
+	std::vector<MipChange>											m_loads;
+	std::vector<MipChange>											m_drops;
+	Microsoft::WRL::ComPtr<ID3D11Device>							m_device;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>				m_placeholder;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>	m_views;
+};
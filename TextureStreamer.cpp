@@ -0,0 +1,345 @@
+// Queueing and residency for the background texture loads
+#include "TextureStreamer.h"
+
+#include <algorithm>
+
+namespace
+{
+	constexpr size_t c_PageSize = 4096;
+
+	// Touches every page of a range so the OS reads it in here rather than when the render thread uploads it
+	void Prefetch(const uint8_t* data, size_t size)
+	{
+		volatile uint8_t sink = 0;
+		for (size_t offset = 0; offset < size; offset += c_PageSize)
+		{
+			sink = sink ^ data[offset];
+		}
+		if (size)
+		{
+			sink = sink ^ data[size - 1];
+		}
+	}
+
+	void PrefetchLevels(const TextureFile& file)
+	{
+		if (!MipStreaming::IsStreamable(file.info))
+		{
+			Prefetch(file.image.GetData(), file.image.GetSize());
+			return;
+		}
+		const DDSSurface& first = file.GetLevel(file.firstMip);
+		const DDSSurface& last = file.GetLevel(file.endMip - 1);
+		Prefetch(first.data, last.data + last.size - first.data);
+	}
+
+	// The file from the archive if it has it, in place when stored there, otherwise mapped from disk
+	bool OpenImage(TextureFile& file, const std::string& path, const AssetArchive* archive)
+	{
+		const AssetEntry* entry = archive ? archive->Find(path) : nullptr;
+		if (!entry)
+		{
+			return file.image.Open(path);
+		}
+		if (const uint8_t* data = archive->GetStoredData(*entry))
+		{
+			return file.image.Parse(data, entry->size);
+		}
+		return archive->Read(*entry, file.buffer) && file.image.Parse(file.buffer.data(), file.buffer.size());
+	}
+
+	// The first read of a file, on an I/O thread: from the mip tail down for a streamable texture, otherwise all of it
+	std::unique_ptr<TextureFile> ReadTextureFile(const std::string& path, uint32_t tailSize, const AssetArchive* archive)
+	{
+		std::unique_ptr<TextureFile> file(new TextureFile());
+		if (!OpenImage(*file, path, archive))
+		{
+			return nullptr;
+		}
+
+		file->info = file->image.GetInfo();
+		file->firstMip = MipStreaming::IsStreamable(file->info) ? MipStreaming::GetTailMip(file->info, tailSize) : 0;
+		file->endMip = file->info.mipCount;
+		PrefetchLevels(*file);
+		return file;
+	}
+
+	// Finer levels of a texture already created from the same file, which must not have changed since
+	std::unique_ptr<TextureFile> ReadTextureLevels(const std::string& path, const AssetArchive* archive, const DDS::TextureInfo& info,
+		uint32_t firstMip, uint32_t endMip)
+	{
+		std::unique_ptr<TextureFile> file(new TextureFile());
+		if (!OpenImage(*file, path, archive))
+		{
+			return nullptr;
+		}
+
+		file->info = file->image.GetInfo();
+		if (file->info.width != info.width || file->info.height != info.height
+			|| file->info.mipCount != info.mipCount || file->info.format != info.format)
+		{
+			return nullptr;
+		}
+		file->firstMip = firstMip;
+		file->endMip = endMip;
+		PrefetchLevels(*file);
+		return file;
+	}
+}
+
+size_t TextureFile::GetBytes() const
+{
+	if (!MipStreaming::IsStreamable(info))
+	{
+		return DDS::GetTextureSize(info);
+	}
+
+	size_t bytes = 0;
+	for (uint32_t mip = firstMip; mip < endMip; ++mip)
+	{
+		bytes += GetLevel(mip).size;
+	}
+	return bytes;
+}
+
+TextureStreamer::TextureStreamer(unsigned ioThreads, uint32_t maxReads, uint32_t tailSize) :
+	m_completed(std::make_shared<Completed>()),
+	m_maxReads(std::max(maxReads, 1u)),
+	m_reading(0),
+	m_levelReads(0),
+	m_tailSize(tailSize),
+	m_residentBytes(0),
+	m_archive(nullptr),
+	m_io(std::max(ioThreads, 1u))
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	m_io.WaitIdle();
+}
+
+TextureHandle TextureStreamer::Request(const std::string & path, int priority)
+{
+	for (size_t i = 0; i < m_entries.size(); ++i)
+	{
+		if (m_entries[i].path == path)
+		{
+			m_entries[i].priority = std::max(m_entries[i].priority, priority);
+			return static_cast<TextureHandle>(i);
+		}
+	}
+
+	Entry entry;
+	entry.path = path;
+	entry.priority = priority;
+	entry.state = TextureState::Queued;
+	entry.info = DDS::TextureInfo();
+	entry.generation = 0;
+	m_entries.push_back(std::move(entry));
+	return static_cast<TextureHandle>(m_entries.size() - 1);
+}
+
+void TextureStreamer::SetPriority(TextureHandle handle, int priority)
+{
+	if (handle < m_entries.size())
+	{
+		m_entries[handle].priority = priority;
+	}
+}
+
+uint32_t TextureStreamer::Update(const CreateFunction & create, uint32_t maxCreates, const LevelsFunction & levels)
+{
+	CollectReads();
+	StartReads();
+
+	std::vector<Read> finished;
+	finished.swap(m_finishedLevels);
+	if (levels)
+	{
+		for (const Read& read : finished)
+		{
+			levels(read.handle, read.file.get());
+		}
+	}
+
+	// Most urgent loaded files first, the rest wait for the next call
+	std::vector<TextureHandle> loaded;
+	for (size_t i = 0; i < m_entries.size(); ++i)
+	{
+		if (m_entries[i].state == TextureState::Loaded)
+		{
+			loaded.push_back(static_cast<TextureHandle>(i));
+		}
+	}
+	std::stable_sort(loaded.begin(), loaded.end(), [this](TextureHandle a, TextureHandle b)
+	{
+		return m_entries[a].priority > m_entries[b].priority;
+	});
+
+	uint32_t created = 0;
+	for (TextureHandle handle : loaded)
+	{
+		if (created == maxCreates)
+		{
+			break;
+		}
+
+		Entry& entry = m_entries[handle];
+		if (create(handle, *entry.file))
+		{
+			entry.state = TextureState::Resident;
+			m_residentBytes += entry.file->GetBytes();
+			++created;
+		}
+		else
+		{
+			entry.state = TextureState::Failed;
+		}
+		entry.file.reset();
+	}
+	return created;
+}
+
+bool TextureStreamer::RequestLevels(TextureHandle handle, uint32_t firstMip, uint32_t endMip)
+{
+	if (handle >= m_entries.size() || m_entries[handle].state != TextureState::Resident
+		|| !MipStreaming::IsStreamable(m_entries[handle].info) || firstMip >= endMip || endMip > m_entries[handle].info.mipCount)
+	{
+		return false;
+	}
+
+	const Entry& entry = m_entries[handle];
+	++m_levelReads;
+
+	std::shared_ptr<Completed> completed = m_completed;
+	std::string path = entry.path;
+	DDS::TextureInfo info = entry.info;
+	uint32_t generation = entry.generation;
+	const AssetArchive* archive = m_archive;
+	m_io.Submit([completed, handle, generation, path, archive, info, firstMip, endMip]()
+	{
+		std::unique_ptr<TextureFile> file = ReadTextureLevels(path, archive, info, firstMip, endMip);
+		std::lock_guard<std::mutex> lock(completed->mutex);
+		completed->reads.push_back({ handle, generation, std::move(file) });
+	});
+	return true;
+}
+
+void TextureStreamer::Requeue()
+{
+	for (Entry& entry : m_entries)
+	{
+		if (entry.state == TextureState::Resident)
+		{
+			entry.state = TextureState::Queued;
+		}
+		++entry.generation;
+	}
+	m_finishedLevels.clear();
+	m_residentBytes = 0;
+}
+
+void TextureStreamer::WaitForReads()
+{
+	m_io.WaitIdle();
+	CollectReads();
+}
+
+TextureState TextureStreamer::GetState(TextureHandle handle) const
+{
+	return handle < m_entries.size() ? m_entries[handle].state : TextureState::Failed;
+}
+
+const std::string & TextureStreamer::GetPath(TextureHandle handle) const
+{
+	static const std::string empty;
+	return handle < m_entries.size() ? m_entries[handle].path : empty;
+}
+
+const DDS::TextureInfo & TextureStreamer::GetInfo(TextureHandle handle) const
+{
+	static const DDS::TextureInfo empty = DDS::TextureInfo();
+	return handle < m_entries.size() ? m_entries[handle].info : empty;
+}
+
+uint32_t TextureStreamer::GetPendingCount() const
+{
+	return static_cast<uint32_t>(std::count_if(m_entries.begin(), m_entries.end(), [](const Entry& entry)
+	{
+		return entry.state == TextureState::Queued || entry.state == TextureState::Reading || entry.state == TextureState::Loaded;
+	}));
+}
+
+void TextureStreamer::StartReads()
+{
+	while (m_reading < m_maxReads)
+	{
+		// Highest priority queued entry, the earliest request on a tie
+		Entry* next = nullptr;
+		TextureHandle handle = c_InvalidTexture;
+		for (size_t i = 0; i < m_entries.size(); ++i)
+		{
+			Entry& entry = m_entries[i];
+			if (entry.state == TextureState::Queued && (!next || entry.priority > next->priority))
+			{
+				next = &entry;
+				handle = static_cast<TextureHandle>(i);
+			}
+		}
+		if (!next)
+		{
+			return;
+		}
+
+		next->state = TextureState::Reading;
+		++m_reading;
+
+		std::shared_ptr<Completed> completed = m_completed;
+		std::string path = next->path;
+		uint32_t tailSize = m_tailSize;
+		const AssetArchive* archive = m_archive;
+		m_io.Submit([completed, handle, path, tailSize, archive]()
+		{
+			std::unique_ptr<TextureFile> file = ReadTextureFile(path, tailSize, archive);
+			std::lock_guard<std::mutex> lock(completed->mutex);
+			completed->reads.push_back({ handle, c_InitialRead, std::move(file) });
+		});
+	}
+}
+
+void TextureStreamer::CollectReads()
+{
+	std::vector<Read> reads;
+	{
+		std::lock_guard<std::mutex> lock(m_completed->mutex);
+		reads.swap(m_completed->reads);
+	}
+
+	for (Read& read : reads)
+	{
+		Entry& entry = m_entries[read.handle];
+		if (read.generation != c_InitialRead)
+		{
+			// Levels for a texture that has since been lost with the device are of no use
+			--m_levelReads;
+			if (read.generation == entry.generation)
+			{
+				m_finishedLevels.push_back(std::move(read));
+			}
+			continue;
+		}
+
+		--m_reading;
+		if (read.file)
+		{
+			entry.info = read.file->info;
+			entry.file = std::move(read.file);
+			entry.state = TextureState::Loaded;
+		}
+		else
+		{
+			entry.state = TextureState::Failed;
+		}
+	}
+}
@@ -0,0 +1,142 @@
+//
+// TextureStreamer.h - Background loading of DDS files, independent of the graphics device
+//
+// Files are mapped, validated and paged in on a small pool of I/O threads. Everything else, the queue, priorities and
+// which textures are resident, lives on the thread that calls Update, which also hands finished files to a create
+// callback. The game passes one that makes D3D textures (TextureManager), anything else can pass a fake.
+//
+// Textures with a full mip chain are first read only down to their mip tail (see MipStreaming.h); the finer levels
+// are read later with RequestLevels, when the budget has room for them.
+//
+// With an AssetArchive set, files it holds are read from it instead, stored entries in place in its mapping.
+//
+
+#pragma once
+
+#include "AssetArchive.h"
+#include "DDSImage.h"
+#include "MipStreaming.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+typedef uint32_t TextureHandle;
+constexpr TextureHandle c_InvalidTexture = 0xffffffff;
+
+enum class TextureState : uint8_t
+{
+	Queued,			//waiting for a read slot
+	Reading,		//on an I/O thread
+	Loaded,			//file in memory, waiting for the create callback
+	Resident,		//created, the file data has been dropped
+	Failed,			//missing, unreadable or rejected by the create callback
+};
+
+//A mapped file with levels [firstMip, endMip) paged in, as handed to the create and levels callbacks. Textures that
+//can't stream (cubes, arrays, volumes and single levels) always come whole. The mapping closes with the TextureFile.
+struct TextureFile
+{
+	DDS::TextureInfo		info;
+	uint32_t				firstMip;
+	uint32_t				endMip;
+	DDSImage				image;
+	std::vector<uint8_t>	buffer;		//a compressed archive entry, decompressed for the image to point into
+
+	//Level of a streamable texture, which must lie in [firstMip, endMip)
+	const DDSSurface& GetLevel(uint32_t mip) const { return *image.GetSurface(mip); }
+
+	//Bytes of texture data in the paged in levels
+	size_t GetBytes() const;
+};
+
+class TextureStreamer
+{
+public:
+	typedef std::function<bool(TextureHandle, const TextureFile&)> CreateFunction;
+	typedef std::function<void(TextureHandle, const TextureFile*)> LevelsFunction;		//null file for a failed read
+
+	//maxReads caps the files in flight, so a long queue doesn't hold every file in memory at once. Streamable textures
+	//are first read from the level no larger than tailSize down.
+	explicit TextureStreamer(unsigned ioThreads = 2, uint32_t maxReads = 4, uint32_t tailSize = c_MipTailSize);
+	~TextureStreamer();
+
+	TextureStreamer(TextureStreamer const&) = delete;
+	TextureStreamer& operator= (TextureStreamer const&) = delete;
+
+	//Files in the archive are read from it, anything else from disk. The archive has to outlive the streamer and
+	//should be set before the first Update.
+	void SetArchive(const AssetArchive* archive) { m_archive = archive; }
+
+	//Queues a file, or returns the handle it already has. Higher priorities are read and created first.
+	TextureHandle Request(const std::string& path, int priority = 0);
+	void SetPriority(TextureHandle handle, int priority);
+
+	//Starts reads for the most urgent queued files, then passes up to maxCreates finished ones to create, most
+	//urgent first, on the calling thread. Returns how many were created.
+	//Finished RequestLevels reads go to levels, all of them.
+	uint32_t Update(const CreateFunction& create, uint32_t maxCreates, const LevelsFunction& levels = nullptr);
+
+	//Reads levels [firstMip, endMip) of a resident texture in the background, for Update to hand to levels
+	bool RequestLevels(TextureHandle handle, uint32_t firstMip, uint32_t endMip);
+
+	//Everything resident goes back in the queue, for when the textures were lost with the device. Level reads still
+	//in flight are thrown away when they finish.
+	void Requeue();
+
+	//Blocks until no reads are in flight. Queued files stay queued until the next Update.
+	void WaitForReads();
+
+	TextureState GetState(TextureHandle handle) const;
+	const std::string& GetPath(TextureHandle handle) const;
+	const DDS::TextureInfo& GetInfo(TextureHandle handle) const;		//valid once Loaded
+
+	uint32_t GetCount() const { return static_cast<uint32_t>(m_entries.size()); }
+	uint32_t GetPendingCount() const;				//queued, reading or loaded
+	size_t GetResidentBytes() const { return m_residentBytes; }		//as first created, before any levels streamed in
+	uint32_t GetLevelReads() const { return m_levelReads; }
+
+private:
+	struct Entry
+	{
+		std::string							path;
+		int									priority;
+		TextureState						state;
+		DDS::TextureInfo					info;
+		std::unique_ptr<TextureFile>		file;		//while Loaded
+		uint32_t							generation;	//bumped by Requeue, so stale level reads can be told apart
+	};
+
+	struct Read
+	{
+		TextureHandle					handle;
+		uint32_t						generation;		//c_InitialRead for the first read of a file
+		std::unique_ptr<TextureFile>	file;			//null for a failed read
+	};
+	static constexpr uint32_t c_InitialRead = 0xffffffff;
+
+	//Results the I/O threads leave for Update, shared so a read finishing late never touches a dead streamer
+	struct Completed
+	{
+		std::mutex			mutex;
+		std::vector<Read>	reads;
+	};
+
+	void StartReads();
+	void CollectReads();
+
+	std::vector<Entry>				m_entries;
+	std::shared_ptr<Completed>		m_completed;
+	std::vector<Read>				m_finishedLevels;		//collected, waiting for Update to hand them out
+	uint32_t						m_maxReads;
+	uint32_t						m_reading;
+	uint32_t						m_levelReads;
+	uint32_t						m_tailSize;
+	size_t							m_residentBytes;
+	const AssetArchive*				m_archive;
+	ThreadPool						m_io;				//last, so its threads are joined before the rest goes
+};
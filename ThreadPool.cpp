@@ -0,0 +1,149 @@
+// Fixed size worker pool with a blocking parallel-for
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned threadCount) :
+	m_active(0),
+	m_stop(false)
+{
+	if (threadCount == 0)
+	{
+		unsigned hardware = std::thread::hardware_concurrency();
+		threadCount = hardware > 1 ? hardware - 1 : 1;
+	}
+
+	m_threads.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; ++i)
+	{
+		m_threads.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_wake.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max<size_t>(grain, 1);
+	size_t chunks = (count + grain - 1) / grain;
+	if (chunks == 1)
+	{
+		fn(0, count);
+		return;
+	}
+
+	// Shared between the caller and the helpers. A helper that only starts after every chunk was claimed never
+	// touches fn, so the caller only has to wait for helpers that are mid-chunk. That also keeps nested calls from
+	// a worker thread from deadlocking on helpers stuck in the queue.
+	struct State
+	{
+		std::atomic<size_t>		next{ 0 };
+		std::atomic<size_t>		running{ 0 };
+		std::mutex				mutex;
+		std::condition_variable	done;
+	};
+	auto state = std::make_shared<State>();
+	const std::function<void(size_t, size_t)>* body = &fn;
+
+	auto run = [state, count, grain, body]()
+	{
+		for (;;)
+		{
+			size_t begin = state->next.fetch_add(grain);
+			if (begin >= count)
+				break;
+			(*body)(begin, std::min(begin + grain, count));
+		}
+	};
+
+	size_t helperCount = std::min<size_t>(chunks - 1, m_threads.size());
+	for (size_t i = 0; i < helperCount; ++i)
+	{
+		Submit([state, run]()
+		{
+			state->running.fetch_add(1);
+			run();
+			if (state->running.fetch_sub(1) == 1)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->done.notify_all();
+			}
+		});
+	}
+
+	run();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->done.wait(lock, [&state]() { return state->running.load() == 0; });
+}
+
+void ThreadPool::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return m_tasks.empty() && m_active == 0; });
+}
+
+void ThreadPool::For(ThreadPool* pool, size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+	if (pool)
+	{
+		pool->ParallelFor(count, grain, fn);
+	}
+	else if (count)
+	{
+		fn(0, count);
+	}
+}
+
+void ThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+			if (m_stop && m_tasks.empty())
+				return;
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			++m_active;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_active;
+			if (m_tasks.empty() && m_active == 0)
+				m_idle.notify_all();
+		}
+	}
+}
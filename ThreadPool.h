@@ -0,0 +1,50 @@
+//
+// ThreadPool.h - Fixed set of worker threads for the CPU side jobs (light binning, baking, streaming ...)
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	//threadCount of 0 uses one worker per hardware thread minus the calling thread (at least one).
+	explicit ThreadPool(unsigned threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator= (ThreadPool const&) = delete;
+
+	//Queues a task to run on a worker.
+	void Submit(std::function<void()> task);
+
+	//Splits [0, count) into chunks of at least grain items and runs fn(begin, end) on the workers and the
+	//calling thread. Blocks until every chunk has finished.
+	void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+	//Blocks until the queue is empty and no task is running.
+	void WaitIdle();
+
+	unsigned GetThreadCount() const { return static_cast<unsigned>(m_threads.size()); }
+
+	//Runs fn over [0, count) on pool if there is one, otherwise inline on the caller.
+	static void For(ThreadPool* pool, size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread>				m_threads;
+	std::deque<std::function<void()>>		m_tasks;
+	std::mutex								m_mutex;
+	std::condition_variable					m_wake;
+	std::condition_variable					m_idle;
+	size_t									m_active;
+	bool									m_stop;
+};
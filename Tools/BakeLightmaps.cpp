@@ -0,0 +1,121 @@
+//
+// BakeLightmaps - offline light baker for the static scene
+//
+// Reads the scene.lmscene the game writes when B is pressed in it, and writes <output>.dds (RGBA16F atlas),
+// <output>.lmscene (the scene with lightmap UVs) and <output>.probes (SH light probes for the objects without a
+// lightmap) for the game to pick up from its working directory.
+// Needs no GPU and nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -pthread -I. Tools/BakeLightmaps.cpp LightBaker.cpp LightmapScene.cpp LightProbes.cpp Bvh.cpp DDSFile.cpp ThreadPool.cpp -o BakeLightmaps
+//	./BakeLightmaps scene.lmscene -o lightmap
+//
+
+#include "LightBaker.h"
+#include "ThreadPool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace
+{
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BakeLightmaps <scene.lmscene> [options]\n"
+			"  -o <name>          output name, writes <name>.dds, <name>.lmscene and <name>.probes (default lightmap)\n"
+			"  -size <texels>     atlas width and height (default 1024)\n"
+			"  -density <texels>  texels per world unit, 0 fits the atlas (default 0)\n"
+			"  -bounces <n>       indirect bounces (default 2)\n"
+			"  -samples <n>       hemisphere rays per texel per bounce (default 64)\n"
+			"  -probes <units>    light probe spacing, 0 for no probes (default 2)\n"
+			"  -threads <n>       worker threads, 0 for one per core (default 0)\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::string input = argv[1];
+	std::string output = "lightmap";
+	LightBakeSettings settings;
+	unsigned threads = 0;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-o"))				output = value;
+		else if (!std::strcmp(arg, "-size"))		settings.atlasSize = static_cast<uint32_t>(std::atoi(value));
+		else if (!std::strcmp(arg, "-density"))		settings.texelsPerUnit = static_cast<float>(std::atof(value));
+		else if (!std::strcmp(arg, "-bounces"))		settings.bounces = static_cast<uint32_t>(std::atoi(value));
+		else if (!std::strcmp(arg, "-samples"))		settings.samples = static_cast<uint32_t>(std::atoi(value));
+		else if (!std::strcmp(arg, "-probes"))		settings.probeSpacing = static_cast<float>(std::atof(value));
+		else if (!std::strcmp(arg, "-threads"))		threads = static_cast<unsigned>(std::atoi(value));
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	LightmapScene scene;
+	if (!scene.Load(input))
+	{
+		std::fprintf(stderr, "could not read %s\n", input.c_str());
+		return 1;
+	}
+
+	ThreadPool pool(threads);
+	LightBaker baker(&pool);
+
+	if (!baker.Unwrap(scene, settings))
+	{
+		std::fprintf(stderr, "the charts don't fit a %u atlas, try a larger -size or lower -density\n", settings.atlasSize);
+		return 1;
+	}
+
+	std::vector<float> texels;
+	if (!baker.Bake(scene, settings, texels))
+	{
+		std::fprintf(stderr, "bake failed\n");
+		return 1;
+	}
+
+	if (!LightBaker::WriteAtlas(output + ".dds", texels.data(), scene.atlasSize) || !scene.Save(output + ".lmscene"))
+	{
+		std::fprintf(stderr, "could not write %s.dds / %s.lmscene\n", output.c_str(), output.c_str());
+		return 1;
+	}
+
+	LightProbeGrid probes;
+	if (settings.probeSpacing > 0.0f && (!baker.BakeProbes(scene, settings, texels, probes) || !probes.Save(output + ".probes")))
+	{
+		std::fprintf(stderr, "could not bake or write %s.probes\n", output.c_str());
+		return 1;
+	}
+
+	const LightBakeStats& stats = baker.GetStats();
+	std::printf("%zu meshes, %u charts (%u not planar), %.2f texels per unit, %u texels\n",
+		scene.meshes.size(), stats.charts, stats.nonPlanarCharts, stats.texelsPerUnit, stats.texels);
+	if (!probes.Empty())
+	{
+		std::printf("%u light probes, %u usable\n", stats.probes, stats.validProbes);
+	}
+	std::printf("%llu rays in %.2fs on %u threads, %.2f Mrays/s\n", static_cast<unsigned long long>(stats.rays), stats.seconds,
+		pool.GetThreadCount() + 1, stats.GetRaysPerSecond() / 1e6);
+	return 0;
+}
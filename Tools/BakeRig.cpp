@@ -0,0 +1,97 @@
+//
+// BakeRig - writes an SDKMESH's frames as a .rig file for the game to bind clips against, see Rig.h
+//
+// Each frame is a bone, in file order the way Model::CreateFromSDKMESH numbers them, with its name, parent frame and
+// matrix, see SdkMeshFile.h. The file is mapped so only its tables are read, the vertex and index data are never
+// touched. Prints the bones and checks every name finds itself through the table before writing. Needs nothing from
+// Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BakeRig.cpp Rig.cpp SdkMeshFile.cpp VertexFormat.cpp MappedFile.cpp -o BakeRig
+//	./BakeRig tank.sdkmesh -out tank.rig
+//
+
+#include "Rig.h"
+#include "SdkMeshFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace
+{
+	struct Options
+	{
+		std::string	input;
+		std::string	output = "tank.rig";
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BakeRig <mesh.sdkmesh> [options]\n"
+			"  -out <path>    rig file to write (default tank.rig)\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			options.input = arg;
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-out"))		options.output = value;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.input.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	SdkMeshFile mesh;
+	Rig rig;
+	if (!mesh.Open(options.input) || !mesh.GetRig(rig))
+	{
+		std::fprintf(stderr, "%s isn't an SDKMESH with a valid frame hierarchy\n", options.input.c_str());
+		return 1;
+	}
+
+	for (size_t bone = 0; bone < rig.GetCount(); ++bone)
+	{
+		uint32_t parent = rig.GetParents()[bone];
+		std::printf("%3zu %-24s parent %s\n", bone, rig.GetName(bone).c_str(), parent == Rig::c_NoBone ? "-" : std::to_string(parent).c_str());
+		uint32_t found = rig.Find(rig.GetName(bone));
+		if (found == Rig::c_NoBone || (found != bone && Rig::FoldName(rig.GetName(found)) != Rig::FoldName(rig.GetName(bone))))
+		{
+			std::fprintf(stderr, "%s finds bone %u\n", rig.GetName(bone).c_str(), found);
+			return 1;
+		}
+	}
+
+	if (!rig.Save(options.output))
+	{
+		std::fprintf(stderr, "can't write %s\n", options.output.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,169 @@
+//
+// BakeTankClips - bakes the tank's animation into tank.anim, see AnimationClip.h
+//
+// The motion the game used to compute every frame, wheels turning, steering, the turret and cannon swinging and the
+// hatch opening, becomes the "drive" clip, and the turret slowly looking around with everything else still becomes
+// "idle". Each clip is sampled for one whole period of all its motions so it loops without a seam: the turret turns
+// at a third of a radian a second rather than 0.333 so the periods meet, after 24 pi seconds for drive and 8 pi for
+// idle, and the sample rate is nudged so the last frame lands exactly on the period.
+// Needs nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BakeTankClips.cpp AnimationClip.cpp Rig.cpp -o BakeTankClips
+//	./BakeTankClips -out tank.anim
+//
+
+#include "AnimationClip.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::string	output = "tank.anim";
+		float		sampleRate = 30.0f;
+		float		rotationTolerance = 0.002f;		//radians, about a tenth of a degree
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BakeTankClips [options]\n"
+			"  -out <path>          clip file to write (default tank.anim)\n"
+			"  -rate <hz>           frames a second before fitting (default 30)\n"
+			"  -tolerance <rad>     largest rotation error a track may keep (default 0.002)\n");
+	}
+
+	constexpr float c_Pi = 3.14159265f;
+
+	enum class Axis { X, Y };
+
+	// A bone turned about one axis by an angle over time
+	struct Channel
+	{
+		const char*						bone;
+		Axis							axis;
+		std::function<float(float)>		angle;
+	};
+
+	BonePose Rotation(Axis axis, float angle)
+	{
+		BonePose pose = BonePose::Identity();
+		pose.rotation[axis == Axis::X ? 0 : 1] = std::sin(angle * 0.5f);
+		pose.rotation[3] = std::cos(angle * 0.5f);
+		return pose;
+	}
+
+	std::vector<Channel> DriveChannels()
+	{
+		auto wheel = [](float time) { return time * 5.0f; };
+		auto steer = [](float time) { return std::sin(time * 0.75f) * 0.5f; };
+		return {
+			{ "l_back_wheel_geo", Axis::X, wheel },
+			{ "r_back_wheel_geo", Axis::X, wheel },
+			{ "l_front_wheel_geo", Axis::X, wheel },
+			{ "r_front_wheel_geo", Axis::X, wheel },
+			{ "l_steer_geo", Axis::X, steer },
+			{ "r_steer_geo", Axis::X, steer },
+			{ "turret_geo", Axis::Y, [](float time) { return std::sin(time / 3.0f) * 1.25f; } },
+			{ "canon_geo", Axis::X, [](float time) { return std::sin(time * 0.25f) * 0.333f - 0.333f; } },
+			{ "hatch_geo", Axis::X, [](float time) { return std::min(0.0f, std::max(std::sin(time * 2.0f) * 2.0f, -1.0f)); } },
+		};
+	}
+
+	std::vector<Channel> IdleChannels()
+	{
+		auto still = [](float) { return 0.0f; };
+		return {
+			{ "l_back_wheel_geo", Axis::X, still },
+			{ "r_back_wheel_geo", Axis::X, still },
+			{ "l_front_wheel_geo", Axis::X, still },
+			{ "r_front_wheel_geo", Axis::X, still },
+			{ "l_steer_geo", Axis::X, still },
+			{ "r_steer_geo", Axis::X, still },
+			{ "turret_geo", Axis::Y, [](float time) { return std::sin(time * 0.25f) * 0.75f; } },
+			{ "canon_geo", Axis::X, [](float time) { return std::sin(time * 0.5f) * 0.1f - 0.2f; } },
+			{ "hatch_geo", Axis::X, still },
+		};
+	}
+
+	bool Bake(const char* name, const std::vector<Channel>& channels, float period, const Options& options, AnimationClip& clip)
+	{
+		uint32_t frameCount = static_cast<uint32_t>(std::ceil(period * options.sampleRate)) + 1;
+		if (!clip.Reset(name, (frameCount - 1) / period, frameCount))
+		{
+			std::fprintf(stderr, "%s: %u frames is too long\n", name, frameCount);
+			return false;
+		}
+
+		std::vector<BonePose> frames(frameCount);
+		for (const Channel& channel : channels)
+		{
+			for (uint32_t frame = 0; frame < frameCount; ++frame)
+			{
+				frames[frame] = Rotation(channel.axis, channel.angle(period * frame / (frameCount - 1)));
+			}
+			if (!clip.AddTrack(channel.bone, frames.data(), options.rotationTolerance, 1e-4f))
+			{
+				std::fprintf(stderr, "%s: two tracks for %s\n", name, channel.bone);
+				return false;
+			}
+		}
+
+		size_t raw = size_t(frameCount) * channels.size() * sizeof(BonePose);
+		std::printf("%-6s %5u frames at %.2f Hz, %u tracks, %zu keys, %zu bytes (%.1fx smaller than %zu)\n", name, frameCount,
+			clip.GetSampleRate(), clip.GetTrackCount(), clip.GetKeyCount(), clip.GetDataSize(), double(raw) / clip.GetDataSize(), raw);
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-out"))					options.output = value;
+		else if (!std::strcmp(arg, "-rate"))			options.sampleRate = static_cast<float>(std::atof(value));
+		else if (!std::strcmp(arg, "-tolerance"))		options.rotationTolerance = static_cast<float>(std::atof(value));
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.sampleRate <= 0.0f || options.rotationTolerance < 0.0f)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<AnimationClip> clips(2);
+	if (!Bake("drive", DriveChannels(), 24.0f * c_Pi, options, clips[0]) || !Bake("idle", IdleChannels(), 8.0f * c_Pi, options, clips[1]))
+	{
+		return 1;
+	}
+	if (!AnimationClip::Save(options.output, clips))
+	{
+		std::fprintf(stderr, "can't write %s\n", options.output.c_str());
+		return 1;
+	}
+	return 0;
+}
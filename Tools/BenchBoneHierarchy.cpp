@@ -0,0 +1,347 @@
+//
+// BenchBoneHierarchy - times a crowd of tanks from clip samples to palette, recursively and in instance blocks, see
+// BoneHierarchy.h
+//
+// Every tank has the tank.sdkmesh hierarchy (14 bones, 6 levels), a random bind pose and world, and plays a random
+// clip over every bone below tank_geo from its own start time. A frame samples each tank's clip, composes the local
+// transforms over the bind pose, solves the absolute ones and writes the palette, all of it timed. The first version
+// does it a tank at a time in matrices, solving as Model::CopyAbsoluteBoneTransforms does, walking children and
+// siblings recursively a 4x4 multiply at a time. The block versions sample into the tanks' lanes, compose and solve
+// whole blocks, with the plain C++ solve and with the SIMD kernel, and write the palette from the lanes, so nothing
+// is converted on the way. The three palettes are checked against each other, and the hierarchy alone is timed too.
+// Needs nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BenchBoneHierarchy.cpp BoneHierarchy.cpp AnimationClip.cpp Rig.cpp -o BenchBoneHierarchy
+//	./BenchBoneHierarchy -tanks 1000 -frames 2000
+//
+
+#include "AnimationClip.h"
+#include "BoneHierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		size_t	tanks = 1000;
+		int		frames = 1000;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchBoneHierarchy [options]\n"
+			"  -tanks <n>     instances posed each frame (default 1000)\n"
+			"  -frames <n>    frames timed per version (default 1000)\n");
+	}
+
+	constexpr uint32_t c_None = BoneHierarchy::c_NoParent;
+
+	// tank.sdkmesh's frames: the unnamed root, RootNode, tank_geo, then the engines, wheels, steering, turret, cannon
+	// and hatch
+	const uint32_t c_TankParents[] = { c_None, 0, 1, 2, 3, 3, 5, 2, 7, 7, 9, 2, 11, 11 };
+	constexpr size_t c_TankBones = sizeof(c_TankParents) / sizeof(c_TankParents[0]);
+	constexpr size_t c_FirstAnimated = 3;
+	constexpr float c_SampleRate = 30.0f;
+	constexpr uint32_t c_ClipFrames = 121;
+
+	void RandomTransform(std::mt19937& random, float* m)
+	{
+		std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f), offset(-2.0f, 2.0f);
+		float a = angle(random), b = angle(random);
+		float ca = std::cos(a), sa = std::sin(a), cb = std::cos(b), sb = std::sin(b);
+		const float transform[16] = {
+			ca, 0.0f, -sa, 0.0f,
+			sa * sb, cb, ca * sb, 0.0f,
+			sa * cb, -sb, ca * cb, 0.0f,
+			offset(random), offset(random), offset(random), 1.0f };
+		std::memcpy(m, transform, sizeof(transform));
+	}
+
+	// Each animated bone turning about a random axis and sliding a little, one pose per frame
+	void RandomClip(std::mt19937& random, const std::vector<std::string>& boneNames, AnimationClip& clip)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f), rate(0.5f, 3.0f);
+		clip.Reset("random", c_SampleRate, c_ClipFrames);
+		std::vector<BonePose> frames(c_ClipFrames);
+		for (size_t bone = c_FirstAnimated; bone < boneNames.size(); ++bone)
+		{
+			float axis[3] = { unit(random), unit(random), unit(random) };
+			float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]) + 1e-6f;
+			float speed = rate(random), swing = unit(random) * 1.5f;
+			for (uint32_t frame = 0; frame < c_ClipFrames; ++frame)
+			{
+				float time = frame / c_SampleRate, angle = std::sin(time * speed) * swing;
+				for (int i = 0; i < 3; ++i)
+				{
+					frames[frame].rotation[i] = axis[i] / length * std::sin(angle * 0.5f);
+					frames[frame].translation[i] = std::sin(time * speed * (i + 1)) * 0.2f;
+				}
+				frames[frame].rotation[3] = std::cos(angle * 0.5f);
+			}
+			clip.AddTrack(boneNames[bone], frames.data(), 0.002f, 0.0005f);
+		}
+	}
+
+	void Multiply(const float* a, const float* b, float* out)
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				out[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column]
+					+ a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+			}
+		}
+	}
+
+	// Model::CopyAbsoluteBoneTransforms' walk: each bone's children then its next sibling, recursively
+	struct Tree
+	{
+		std::vector<uint32_t>	child;
+		std::vector<uint32_t>	sibling;
+
+		Tree()
+			: child(c_TankBones, c_None), sibling(c_TankBones, c_None)
+		{
+			for (size_t bone = c_TankBones; bone-- > 0; )
+			{
+				uint32_t parent = c_TankParents[bone];
+				if (parent != c_None)
+				{
+					sibling[bone] = child[parent];
+					child[parent] = static_cast<uint32_t>(bone);
+				}
+			}
+		}
+
+		void Walk(uint32_t bone, const float* parent, const float* local, float* absolute) const
+		{
+			for (; bone != c_None; bone = sibling[bone])
+			{
+				float* out = absolute + bone * 16;
+				Multiply(local + bone * 16, parent, out);
+				Walk(child[bone], out, local, absolute);
+			}
+		}
+	};
+
+	// Each absolute transform times the world, the first three columns as rows
+	void WritePalette(const float* absolute, const float* world, PaletteEntry* palette)
+	{
+		for (size_t bone = 0; bone < c_TankBones; ++bone)
+		{
+			float m[16];
+			Multiply(absolute + bone * 16, world, m);
+			for (int column = 0; column < 3; ++column)
+			{
+				for (int row = 0; row < 4; ++row)
+				{
+					palette[bone].rows[column][row] = m[row * 4 + column];
+				}
+			}
+		}
+	}
+
+	float MaxDifference(const std::vector<PaletteEntry>& a, const std::vector<PaletteEntry>& b)
+	{
+		float error = 0.0f;
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			for (size_t e = 0; e < 12; ++e)
+			{
+				error = std::fmax(error, std::fabs(a[i].rows[e / 4][e % 4] - b[i].rows[e / 4][e % 4]));
+			}
+		}
+		return error;
+	}
+
+	template<typename Fn>
+	double NanosecondsPerFrame(int frames, Fn pose)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			pose(frame / 60.0f);
+		}
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / frames;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-tanks"))			options.tanks = std::strtoul(value, nullptr, 10);
+		else if (!std::strcmp(arg, "-frames"))		options.frames = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.tanks == 0 || options.frames <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	BoneHierarchy hierarchy;
+	if (!hierarchy.SetHierarchy(c_TankParents, c_TankBones))
+	{
+		std::fprintf(stderr, "tank hierarchy rejected\n");
+		return 1;
+	}
+
+	const size_t tanks = options.tanks, blocks = BoneHierarchy::GetBlockCount(tanks);
+	std::mt19937 random(1);
+	std::vector<std::string> boneNames(c_TankBones);
+	std::vector<float> bind(c_TankBones * 16);
+	for (size_t bone = 0; bone < c_TankBones; ++bone)
+	{
+		boneNames[bone] = "bone" + std::to_string(bone);
+		RandomTransform(random, &bind[bone * 16]);
+	}
+	Rig rig;
+	AnimationClip clip;
+	RandomClip(random, boneNames, clip);
+	if (!rig.Set(boneNames, c_TankParents, bind.data(), c_TankBones))
+	{
+		std::fprintf(stderr, "tank rig rejected\n");
+		return 1;
+	}
+
+	// Every version has its own samplers, so each one's cursors step forward from the start as the game's do
+	std::vector<float> worlds(tanks * 16), starts(tanks);
+	std::uniform_real_distribution<float> start(0.0f, clip.GetDuration());
+	for (size_t tank = 0; tank < tanks; ++tank)
+	{
+		RandomTransform(random, &worlds[tank * 16]);
+		starts[tank] = start(random);
+	}
+	ClipSampler bound;
+	bound.Bind(&clip, rig);
+	std::vector<ClipSampler> samplers[3] = { std::vector<ClipSampler>(tanks, bound), std::vector<ClipSampler>(tanks, bound), std::vector<ClipSampler>(tanks, bound) };
+
+	static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	Tree tree;
+	std::vector<BonePose> poses(c_TankBones);
+	std::vector<float> local(c_TankBones * 16), absolute(tanks * c_TankBones * 16);
+	std::vector<PaletteEntry> palettes[3] = { std::vector<PaletteEntry>(tanks * c_TankBones), std::vector<PaletteEntry>(tanks * c_TankBones), std::vector<PaletteEntry>(tanks * c_TankBones) };
+	auto walk = [&](float time)
+	{
+		for (size_t tank = 0; tank < tanks; ++tank)
+		{
+			poses.assign(c_TankBones, BonePose::Identity());
+			samplers[0][tank].Sample(starts[tank] + time, true, poses.data());
+			ComposeBoneTransforms(poses.data(), bind.data(), c_TankBones, local.data());
+			tree.Walk(0, identity, local.data(), &absolute[tank * c_TankBones * 16]);
+			WritePalette(&absolute[tank * c_TankBones * 16], &worlds[tank * 16], &palettes[0][tank * c_TankBones]);
+		}
+	};
+
+	// Bones without a track keep the identity pose they are given once, as a crowd's do until an instance's clips change
+	std::vector<float> poseBlocks(blocks * hierarchy.GetPoseBlockSize()), localBlocks(blocks * hierarchy.GetBlockSize()), absoluteBlocks(localBlocks.size());
+	for (size_t tank = 0; tank < tanks; ++tank)
+	{
+		hierarchy.ResetPoses(poseBlocks.data(), tank);
+	}
+	auto block = [&](float time, bool kernel)
+	{
+		std::vector<ClipSampler>& tankSamplers = samplers[kernel ? 2 : 1];
+		for (size_t tank = 0; tank < tanks; ++tank)
+		{
+			tankSamplers[tank].Sample(starts[tank] + time, true, poseBlocks.data() + hierarchy.GetPoseLane(tank), hierarchy.GetPoseOffsets(), BoneHierarchy::c_Lanes);
+		}
+		hierarchy.Compose(poseBlocks.data(), bind.data(), localBlocks.data(), blocks);
+		if (kernel)
+		{
+			hierarchy.Solve(localBlocks.data(), absoluteBlocks.data(), blocks);
+		}
+		else
+		{
+			hierarchy.SolveReference(localBlocks.data(), absoluteBlocks.data(), blocks);
+		}
+		PaletteEntry* palette = palettes[kernel ? 2 : 1].data();
+		for (size_t tank = 0; tank < tanks; ++tank)
+		{
+			hierarchy.WritePalette(absoluteBlocks.data(), tank, &worlds[tank * 16], palette + tank * c_TankBones);
+		}
+	};
+
+	walk(0.5f);
+	block(0.5f, false);
+	block(0.5f, true);
+	float error = std::fmax(MaxDifference(palettes[0], palettes[1]), MaxDifference(palettes[0], palettes[2]));
+	std::vector<float> unpacked(c_TankBones * 16);
+	for (size_t tank = 0; tank < tanks; ++tank)
+	{
+		hierarchy.Unpack(absoluteBlocks.data(), tank, unpacked.data());
+		for (size_t i = 0; i < unpacked.size(); ++i)
+		{
+			error = std::fmax(error, std::fabs(unpacked[i] - absolute[tank * c_TankBones * 16 + i]));
+		}
+	}
+	if (error > 1e-3f)
+	{
+		std::fprintf(stderr, "blocks differ from the recursive walk by %g\n", error);
+		return 1;
+	}
+
+	double recursive = NanosecondsPerFrame(options.frames, walk);
+	double reference = NanosecondsPerFrame(options.frames, [&](float time) { block(time, false); });
+	double kernel = NanosecondsPerFrame(options.frames, [&](float time) { block(time, true); });
+
+	// The hierarchy alone, the animation changing a little every frame so nothing can be hoisted out of the loop
+	std::vector<float> locals(tanks * c_TankBones * 16);
+	for (size_t tank = 0; tank < tanks; ++tank)
+	{
+		ComposeBoneTransforms(poses.data(), bind.data(), c_TankBones, &locals[tank * c_TankBones * 16]);
+	}
+	double walkAlone = NanosecondsPerFrame(options.frames, [&](float)
+	{
+		locals[12] += 1e-6f;
+		for (size_t tank = 0; tank < tanks; ++tank)
+		{
+			tree.Walk(0, identity, &locals[tank * c_TankBones * 16], &absolute[tank * c_TankBones * 16]);
+		}
+	});
+	double solveAlone = NanosecondsPerFrame(options.frames, [&](float)
+	{
+		localBlocks[9 * BoneHierarchy::c_Lanes] += 1e-6f;
+		hierarchy.Solve(localBlocks.data(), absoluteBlocks.data(), blocks);
+	});
+
+	const double bones = double(tanks * c_TankBones);
+	std::printf("%zu tanks, %zu bones each, %s kernels\n", tanks, c_TankBones, BoneHierarchy::HasAvx2() ? "avx2" : "sse2");
+	std::printf("  sample to palette:\n");
+	std::printf("    recursive walk     %10.0f ns a frame (%5.2f ns a bone)\n", recursive, recursive / bones);
+	std::printf("    blocks, plain C++  %10.0f ns a frame (%5.2f ns a bone)   %.2fx\n", reference, reference / bones, recursive / reference);
+	std::printf("    blocks, SIMD       %10.0f ns a frame (%5.2f ns a bone)   %.2fx\n", kernel, kernel / bones, recursive / kernel);
+	std::printf("  the hierarchy alone:\n");
+	std::printf("    recursive walk     %10.0f ns a frame (%5.2f ns a bone)\n", walkAlone, walkAlone / bones);
+	std::printf("    blocks, SIMD       %10.0f ns a frame (%5.2f ns a bone)   %.2fx\n", solveAlone, solveAlone / bones, walkAlone / solveAlone);
+	std::printf("  max error %.2g\n", error);
+	return 0;
+}
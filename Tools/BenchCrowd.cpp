@@ -0,0 +1,196 @@
+//
+// BenchCrowd - poses a crowd of animated tanks and reports poses a second, see AnimationCrowd.h
+//
+// The tanks stand on a square grid 4 units apart, each playing tank.anim's drive clip from its own start time at its
+// own speed, every other one blending in the idle clip. The crowd is posed for a number of frames with every tank
+// posed every frame, then with animation LOD from a camera at one corner of the grid. Each thread count gets a pool
+// of that many workers, the calling thread works as well. Needs nothing from Windows, e.g. on Linux from the repository
+// root after Tools/BakeTankClips:
+//
+//	g++ -std=c++17 -O2 -pthread -I. Tools/BenchCrowd.cpp AnimationCrowd.cpp AnimationClip.cpp BoneHierarchy.cpp Rig.cpp ThreadPool.cpp -o BenchCrowd
+//	./BenchCrowd -clips tank.anim -instances 1000,10000 -threads 0,1,3
+//
+
+#include "AnimationCrowd.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::string				clips = "tank.anim";
+		std::vector<size_t>		instanceCounts = { 1000, 10000 };
+		std::vector<size_t>		threadCounts = { 0, 1, 3 };		//workers besides the calling thread
+		int						frames = 200;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchCrowd [options]\n"
+			"  -clips <path>          clip file with drive and idle clips (default tank.anim)\n"
+			"  -instances <a,b,...>   crowd sizes (default 1000,10000)\n"
+			"  -threads <a,b,...>     pool workers besides the calling thread (default 0,1,3)\n"
+			"  -frames <n>            frames posed per case (default 200)\n");
+	}
+
+	bool ParseList(const char* value, std::vector<size_t>& list, bool allowZero)
+	{
+		list.clear();
+		for (const char* p = value; *p; )
+		{
+			char* end;
+			unsigned long count = std::strtoul(p, &end, 10);
+			if (end == p || (count == 0 && !allowZero))
+			{
+				return false;
+			}
+			list.push_back(count);
+			p = *end == ',' ? end + 1 : end;
+		}
+		return !list.empty();
+	}
+
+	// tank.sdkmesh's frames, see BenchBoneHierarchy
+	constexpr uint32_t c_None = Rig::c_NoBone;
+	const uint32_t c_TankParents[] = { c_None, 0, 1, 2, 3, 3, 5, 2, 7, 7, 9, 2, 11, 11 };
+	const char* const c_TankBones[] = { "", "RootNode", "tank_geo", "r_engine_geo", "r_back_wheel_geo", "r_steer_geo",
+		"r_front_wheel_geo", "l_engine_geo", "l_back_wheel_geo", "l_steer_geo", "l_front_wheel_geo", "turret_geo", "canon_geo", "hatch_geo" };
+	constexpr size_t c_BoneCount = sizeof(c_TankParents) / sizeof(c_TankParents[0]);
+
+	double PosesPerSecond(AnimationCrowd& crowd, ThreadPool* pool, int frames, const float* camera, std::vector<PaletteEntry>& palette)
+	{
+		size_t posed = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			crowd.Update(1.0f / 60.0f, camera, pool, palette.data());
+			posed += crowd.GetPosedCount();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return posed / seconds;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		bool valid = true;
+		if (!std::strcmp(arg, "-clips"))				options.clips = value;
+		else if (!std::strcmp(arg, "-instances"))		valid = ParseList(value, options.instanceCounts, false);
+		else if (!std::strcmp(arg, "-threads"))			valid = ParseList(value, options.threadCounts, true);
+		else if (!std::strcmp(arg, "-frames"))			options.frames = std::atoi(value);
+		else											valid = false;
+		if (!valid)
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.frames <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<AnimationClip> clips;
+	if (!AnimationClip::Load(options.clips, clips) || clips.size() < 2)
+	{
+		std::fprintf(stderr, "can't load two clips from %s, see Tools/BakeTankClips\n", options.clips.c_str());
+		return 1;
+	}
+
+	// Every bone a little way from its parent, the poses don't need to look like a tank to cost the same
+	std::vector<std::string> boneNames(c_TankBones, c_TankBones + c_BoneCount);
+	std::vector<float> bind(c_BoneCount * 16, 0.0f);
+	for (size_t bone = 0; bone < c_BoneCount; ++bone)
+	{
+		float* m = &bind[bone * 16];
+		m[0] = m[5] = m[10] = m[15] = 1.0f;
+		m[13] = 0.25f;
+	}
+	Rig rig;
+	rig.Set(boneNames, c_TankParents, bind.data(), c_BoneCount);
+
+	for (size_t count : options.instanceCounts)
+	{
+		AnimationCrowd crowd;
+		if (!crowd.Init(&clips, rig))
+		{
+			std::fprintf(stderr, "tank hierarchy rejected\n");
+			return 1;
+		}
+
+		size_t side = static_cast<size_t>(std::ceil(std::sqrt(double(count))));
+		for (size_t i = 0; i < count; ++i)
+		{
+			CrowdInstance instance = {};
+			instance.world[0] = instance.world[5] = instance.world[10] = instance.world[15] = 1.0f;
+			instance.world[12] = float(i % side) * 4.0f;
+			instance.world[14] = float(i / side) * 4.0f;
+			instance.clip = 0;
+			instance.blendClip = i % 2 ? 1 : CrowdInstance::c_NoClip;
+			instance.blend = 0.5f;
+			instance.speed = 0.75f + (i % 7) * 0.1f;
+			instance.time = float(i % 97) * 0.37f;
+			crowd.AddInstance(instance);
+		}
+		std::vector<PaletteEntry> palette(count * (c_BoneCount + 1));
+
+		// LOD distances too far to skip anything, then the real ones from a camera at the grid's corner
+		const float origin[3] = { 0.0f, 0.0f, 0.0f }, corner[3] = { 0.0f, 2.0f, 0.0f };
+		for (size_t threads : options.threadCounts)
+		{
+			std::unique_ptr<ThreadPool> pool;
+			if (threads > 0)
+			{
+				pool = std::make_unique<ThreadPool>(static_cast<unsigned>(threads));
+			}
+
+			crowd.SetLodDistances(1e9f, 2e9f, 3e9f);
+			crowd.Update(0.0f, origin, pool.get(), palette.data());
+			double all = PosesPerSecond(crowd, pool.get(), options.frames, origin, palette);
+
+			crowd.SetLodDistances(20.0f, 40.0f, 80.0f);
+			size_t posed = 0;
+			for (int frame = 0; frame < 8; ++frame)
+			{
+				crowd.Update(1.0f / 60.0f, corner, pool.get(), palette.data());
+				posed += crowd.GetPosedCount();
+			}
+			auto start = std::chrono::steady_clock::now();
+			for (int frame = 0; frame < options.frames; ++frame)
+			{
+				crowd.Update(1.0f / 60.0f, corner, pool.get(), palette.data());
+			}
+			double lodFrame = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / options.frames;
+
+			std::printf("%6zu tanks, %zu workers + caller   every frame: %9.0f poses/s (%7.0f us a frame)   "
+				"LOD: %5.1f%% posed a frame, %7.0f us a frame\n",
+				count, threads, all, count / all * 1e6, 100.0 * posed / (8.0 * count), lodFrame);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,245 @@
+//
+// BenchDDS - checks and times parsing DDS files, see DDSImage.h
+//
+// Every file given must open, with ReadInfo agreeing with the image, one surface per level of every item laid out
+// back to back from the end of the headers, each the size its format and dimensions make and the last ending inside
+// the file. Every copy cut short of the last surface must be refused, by ReadInfo too while the headers are cut. Then
+// every bit of the headers is flipped in turn, and -fuzz copies have random header bytes overwritten: the magic and
+// the two structure sizes must never survive a flip, and whatever else parses must still describe surfaces inside
+// the buffer that match its own info. The copies are exactly as long as they claim, so building with
+// -fsanitize=address catches any read past them. Last, Parse and Open are timed per file. Needs nothing from Windows,
+// e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BenchDDS.cpp DDSImage.cpp DDSFile.cpp MappedFile.cpp -o BenchDDS
+//	./BenchDDS *.dds -fuzz 10000 -runs 1000
+//
+
+#include "DDSImage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr size_t c_HeadersSize = 4 + sizeof(DDS::Header);
+
+	struct Options
+	{
+		std::vector<std::string>	files;
+		int							fuzz = 10000;
+		int							runs = 1000;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchDDS <file.dds>... [options]\n"
+			"  -fuzz <n>    copies of each file with random header bytes parsed (default 10000)\n"
+			"  -runs <n>    times each file is parsed and opened when timing (default 1000)\n");
+	}
+
+	bool Check(bool condition, const std::string& file, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s: %s\n", file.c_str(), what);
+		}
+		return condition;
+	}
+
+	// Surfaces item by item, levels back to back from the headers, each as large as the info says and inside the
+	// size bytes at data
+	bool Consistent(const DDSImage& image, const uint8_t* data, size_t size)
+	{
+		const DDS::TextureInfo& info = image.GetInfo();
+		if (image.GetData() != data || image.GetSize() != size || image.GetSurfaceCount() != info.mipCount * info.arraySize
+			|| info.dataOffset > size)
+		{
+			return false;
+		}
+
+		const uint8_t* next = data + info.dataOffset;
+		for (uint32_t item = 0; item < info.arraySize; ++item)
+		{
+			for (uint32_t mip = 0; mip < info.mipCount; ++mip)
+			{
+				const DDSSurface* surface = image.GetSurface(mip, item);
+				uint32_t width = std::max(1u, info.width >> mip), height = std::max(1u, info.height >> mip);
+				uint32_t depth = std::max(1u, info.depth >> mip);
+				if (!surface || surface->data != next || surface->width != width || surface->height != height || surface->depth != depth
+					|| surface->slicePitch != DDS::GetSurfaceSize(info.format, width, height)
+					|| surface->size != surface->slicePitch * depth || size_t(surface->data - data) + surface->size > size)
+				{
+					return false;
+				}
+				next += surface->size;
+			}
+		}
+		return !image.GetSurface(info.mipCount, 0) && !image.GetSurface(0, info.arraySize)
+			&& size_t(next - data) == info.dataOffset + DDS::GetTextureSize(info);
+	}
+
+	// Parses an exactly sized heap copy of bytes, true if it was accepted; an accepted image must be consistent
+	bool ParseCopy(const std::vector<uint8_t>& bytes, size_t size, bool& consistent)
+	{
+		std::vector<uint8_t> copy(bytes.begin(), bytes.begin() + size);
+		DDSImage image;
+		// data() of an empty vector may be null, which Parse refuses anyway
+		bool parsed = image.Parse(copy.data(), copy.size());
+		consistent = !parsed || Consistent(image, copy.data(), copy.size());
+		return parsed;
+	}
+
+	bool CheckFile(const std::string& path, int fuzz, uint32_t seed)
+	{
+		bool ok = true;
+		DDSImage image;
+		if (!Check(image.Open(path), path, "opens"))
+		{
+			return false;
+		}
+		const DDS::TextureInfo& info = image.GetInfo();
+		DDS::TextureInfo read;
+		ok &= Check(DDS::ReadInfo(image.GetData(), image.GetSize(), read) && read.width == info.width && read.height == info.height
+			&& read.mipCount == info.mipCount && read.format == info.format && read.dataOffset == info.dataOffset, path, "ReadInfo agrees");
+		ok &= Check(Consistent(image, image.GetData(), image.GetSize()), path, "surfaces laid out back to back inside the file");
+
+		std::vector<uint8_t> bytes(image.GetData(), image.GetData() + image.GetSize());
+		size_t end = info.dataOffset + DDS::GetTextureSize(info);
+		bool consistent;
+		ok &= Check(ParseCopy(bytes, bytes.size(), consistent) && consistent, path, "parses from memory");
+
+		// Cut anywhere in the headers, just short of every surface's end and at random in between
+		bool refused = true;
+		for (size_t size = 0; size <= info.dataOffset; ++size)
+		{
+			refused &= !ParseCopy(bytes, size, consistent);
+			refused &= size >= info.dataOffset || !DDS::ReadInfo(bytes.data(), size, read);
+		}
+		for (uint32_t i = 0; i < image.GetSurfaceCount(); ++i)
+		{
+			const DDSSurface& surface = *image.GetSurface(i % info.mipCount, i / info.mipCount);
+			refused &= !ParseCopy(bytes, size_t(surface.data - image.GetData()) + surface.size - 1, consistent);
+		}
+		std::mt19937 random(seed);
+		for (int i = 0; i < 64; ++i)
+		{
+			refused &= !ParseCopy(bytes, info.dataOffset + random() % (end - info.dataOffset), consistent);
+		}
+		ok &= Check(refused, path, "truncated copies refused");
+		ok &= Check(ParseCopy(bytes, end, consistent) && consistent, path, "cut right after the last surface still parses");
+
+		// Single bit flips in the headers: the magic and structure sizes must refuse, the rest stay in bounds
+		bool inBounds = true;
+		refused = true;
+		for (size_t bit = 0; bit < info.dataOffset * 8; ++bit)
+		{
+			bytes[bit / 8] ^= uint8_t(1u << (bit % 8));
+			bool parsed = ParseCopy(bytes, bytes.size(), consistent);
+			size_t offset = bit / 8;
+			bool vital = offset < 8 || (offset >= 4 + 72 && offset < 4 + 76);		//magic, Header::size, PixelFormat::size
+			refused &= !(vital && parsed);
+			inBounds &= consistent;
+			bytes[bit / 8] ^= uint8_t(1u << (bit % 8));
+		}
+		ok &= Check(refused, path, "flipped magic or structure sizes refused");
+		ok &= Check(inBounds, path, "flipped headers that parse stay inside the file");
+
+		// Several random header bytes at once, in copies cut at random too
+		for (int i = 0; i < fuzz; ++i)
+		{
+			std::vector<uint8_t> fuzzed(bytes);
+			for (int changes = 1 + random() % 4; changes > 0; --changes)
+			{
+				fuzzed[random() % std::min(info.dataOffset, c_HeadersSize + sizeof(DDS::HeaderDXT10))] = uint8_t(random());
+			}
+			ParseCopy(fuzzed, i % 2 ? fuzzed.size() : random() % (fuzzed.size() + 1), consistent);
+			inBounds &= consistent;
+		}
+		ok &= Check(inBounds, path, "fuzzed headers that parse stay inside the file");
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			options.files.push_back(arg);
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-fuzz"))			options.fuzz = std::atoi(value);
+		else if (!std::strcmp(arg, "-runs"))	options.runs = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.files.empty() || options.fuzz < 0 || options.runs <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < options.files.size(); ++i)
+	{
+		ok &= CheckFile(options.files[i], options.fuzz, uint32_t(36 + i));
+	}
+	if (!ok)
+	{
+		return 1;
+	}
+	std::printf("%zu files parsed, truncated and bit flipped copies refused\n", options.files.size());
+
+	for (const std::string& path : options.files)
+	{
+		DDSImage mapped;
+		mapped.Open(path);
+		const DDS::TextureInfo& info = mapped.GetInfo();
+
+		DDSImage image;
+		uint32_t surfaces = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int run = 0; run < options.runs; ++run)
+		{
+			image.Parse(mapped.GetData(), mapped.GetSize());
+			surfaces += image.GetSurfaceCount();
+		}
+		double parseNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / options.runs;
+
+		start = std::chrono::steady_clock::now();
+		for (int run = 0; run < options.runs; ++run)
+		{
+			image.Open(path);
+			surfaces += image.GetSurfaceCount();
+		}
+		double openUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / options.runs;
+		std::printf("  %-28s %5ux%-5u %2u levels x %-2u format %-3u %9zu bytes: parse %.0f ns, open %.1f us (%u)\n", path.c_str(),
+			info.width, info.height, info.mipCount, info.arraySize, info.format, mapped.GetSize(), parseNs, openUs,
+			surfaces / (2 * options.runs));
+	}
+	return 0;
+}
@@ -0,0 +1,389 @@
+//
+// BenchFileIO - compares plain ifstream loading with AsyncFileReader and AssetLoader, see AsyncFile.h and AssetLoader.h
+//
+// Every input file is read runs times each way and the throughput and latency (median and 99th percentile) are
+// reported. Latency is the same thing for every way: from the start of the run to that file's data being in hand,
+// which is what code waiting on the file sees. Read one after another, the files wait for the ones before them too.
+//	readdata	an ifstream opened at the end, sized with tellg, seekg back and read, the way DX::ReadData loaded
+//	now			AsyncFileReader::ReadFileNow on the calling thread, the same work without the stream
+//	single		each file submitted on its own and waited for before the next, so the difference to now is the cost
+//				of handing a read to an I/O thread and its result back
+//	async		every file submitted as its own read at once, then waited for in order
+//	batch		the files of a run as one ReadFiles task per I/O thread
+//	prefetch	AssetLoader::Prefetch of every file, then Read of each in order, as the game starts up
+// -ranges also reads that many small ranges at random offsets of the largest input into one buffer: seekg and read
+// per range against one ReadBatch per I/O thread. -cold asks the kernel to drop the inputs from the page cache before
+// every run so the disk is measured too, which only works for files nothing else has dirty. Linux, or any POSIX
+// system without -cold, e.g. from the build output directory:
+//
+//	g++ -std=c++17 -O2 -pthread -I. Tools/BenchFileIO.cpp AssetLoader.cpp AsyncFile.cpp AssetArchive.cpp MappedFile.cpp Lz4.cpp ThreadPool.cpp -o BenchFileIO
+//	./BenchFileIO *.cso *.dds tank.sdkmesh -runs 20 -ranges 4096
+//
+
+#include "AssetLoader.h"
+#include "AsyncFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Options
+	{
+		int			runs = 10;
+		unsigned	threads = 4;
+		size_t		ranges = 0;
+		size_t		rangeSize = 4096;
+		bool		cold = false;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchFileIO <file>... [options]\n"
+			"  -runs <n>          times every file is read each way (default 10)\n"
+			"  -threads <n>       I/O threads of the async reader (default 4)\n"
+			"  -ranges <n>        also read n small ranges at random offsets of the largest file\n"
+			"  -range-size <n>    bytes per range (default 4096)\n"
+			"  -cold              drop the files from the page cache before every run (Linux)\n");
+	}
+
+	double Microseconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+
+	// What DX::ReadData did before the game moved to AssetLoader, minus the fallback to the executable's directory
+	bool ReadData(const std::string& path, std::vector<uint8_t>& blob)
+	{
+		std::ifstream inFile(path, std::ios::in | std::ios::binary | std::ios::ate);
+		if (!inFile)
+		{
+			return false;
+		}
+		std::streampos length = inFile.tellg();
+		blob.resize(size_t(length));
+		inFile.seekg(0, std::ios::beg);
+		inFile.read(reinterpret_cast<char*>(blob.data()), length);
+		return bool(inFile);
+	}
+
+	void DropCache(const std::vector<std::string>& paths)
+	{
+#ifdef __linux__
+		for (const std::string& path : paths)
+		{
+			int file = open(path.c_str(), O_RDONLY);
+			if (file >= 0)
+			{
+				posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+				close(file);
+			}
+		}
+#else
+		(void)paths;
+#endif
+	}
+
+	// Latencies in microseconds, sorted in place
+	void Report(const char* name, double seconds, size_t bytes, std::vector<double>& latencies)
+	{
+		std::sort(latencies.begin(), latencies.end());
+		double median = latencies.empty() ? 0.0 : latencies[latencies.size() / 2];
+		double p99 = latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+		std::printf("  %-10s %8.3f s %8.0f MB/s   latency median %8.1f us, p99 %8.1f us\n", name, seconds, bytes / 1e6 / seconds, median, p99);
+	}
+
+	// Splits [0, count) into one contiguous share per thread
+	size_t ShareBegin(size_t count, unsigned shares, unsigned share)
+	{
+		return count * share / shares;
+	}
+
+	bool BenchFiles(const std::vector<std::string>& paths, const Options& options)
+	{
+		std::vector<uint8_t> data;
+		size_t bytes = 0;
+		for (const std::string& path : paths)
+		{
+			FileData file = AsyncFileReader::ReadFileNow(path);
+			if (file.status != ReadStatus::Done || !ReadData(path, data) || data != file.data)
+			{
+				std::fprintf(stderr, "%s: could not read, or read differently each way\n", path.c_str());
+				return false;
+			}
+			bytes += data.size();
+		}
+		size_t totalBytes = bytes * options.runs;
+		std::printf("%d runs of %zu files (%.1f MB), %u I/O threads%s:\n", options.runs, paths.size(), bytes / 1e6, options.threads,
+			options.cold ? ", cold cache" : "");
+
+		AsyncFileReader reader(options.threads);
+		std::vector<double> latencies;
+		latencies.reserve(paths.size() * options.runs);
+		double seconds = 0.0;
+
+		for (int run = 0; run < options.runs; ++run)
+		{
+			if (options.cold) DropCache(paths);
+			auto start = Clock::now();
+			for (const std::string& path : paths)
+			{
+				ReadData(path, data);
+				latencies.push_back(Microseconds(Clock::now() - start));
+			}
+			seconds += std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		Report("readdata", seconds, totalBytes, latencies);
+
+		latencies.clear();
+		seconds = 0.0;
+		for (int run = 0; run < options.runs; ++run)
+		{
+			if (options.cold) DropCache(paths);
+			auto start = Clock::now();
+			for (const std::string& path : paths)
+			{
+				FileData file = AsyncFileReader::ReadFileNow(path);
+				latencies.push_back(Microseconds(Clock::now() - start));
+			}
+			seconds += std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		Report("now", seconds, totalBytes, latencies);
+
+		latencies.clear();
+		seconds = 0.0;
+		for (int run = 0; run < options.runs; ++run)
+		{
+			if (options.cold) DropCache(paths);
+			auto start = Clock::now();
+			for (const std::string& path : paths)
+			{
+				FileData file = reader.ReadFile(path).get();
+				latencies.push_back(Microseconds(Clock::now() - start));
+			}
+			seconds += std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		Report("single", seconds, totalBytes, latencies);
+
+		// Waited for in order rather than polled: a polling loop takes a core from the I/O threads it is waiting on
+		latencies.clear();
+		seconds = 0.0;
+		for (int run = 0; run < options.runs; ++run)
+		{
+			if (options.cold) DropCache(paths);
+			auto start = Clock::now();
+			std::vector<std::future<FileData>> futures;
+			futures.reserve(paths.size());
+			for (const std::string& path : paths)
+			{
+				futures.push_back(reader.ReadFile(path));
+			}
+			for (auto& future : futures)
+			{
+				future.get();
+				latencies.push_back(Microseconds(Clock::now() - start));
+			}
+			seconds += std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		Report("async", seconds, totalBytes, latencies);
+
+		// A file's latency is when its whole share is, so each share's is counted for every file in it
+		latencies.clear();
+		seconds = 0.0;
+		for (int run = 0; run < options.runs; ++run)
+		{
+			if (options.cold) DropCache(paths);
+			auto start = Clock::now();
+			std::vector<std::future<std::vector<FileData>>> futures;
+			for (unsigned share = 0; share < options.threads; ++share)
+			{
+				size_t begin = ShareBegin(paths.size(), options.threads, share), end = ShareBegin(paths.size(), options.threads, share + 1);
+				if (begin < end)
+				{
+					futures.push_back(reader.ReadFiles(std::vector<std::string>(paths.begin() + begin, paths.begin() + end)));
+				}
+			}
+			for (auto& future : futures)
+			{
+				size_t files = future.get().size();
+				latencies.insert(latencies.end(), files, Microseconds(Clock::now() - start));
+			}
+			seconds += std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		Report("batch", seconds, totalBytes, latencies);
+
+		AssetLoader loader(options.threads);
+		latencies.clear();
+		seconds = 0.0;
+		for (int run = 0; run < options.runs; ++run)
+		{
+			if (options.cold) DropCache(paths);
+			auto start = Clock::now();
+			loader.Prefetch(paths);
+			for (const std::string& path : paths)
+			{
+				if (!loader.Read(path, data))
+				{
+					std::fprintf(stderr, "%s: prefetch failed\n", path.c_str());
+					return false;
+				}
+				latencies.push_back(Microseconds(Clock::now() - start));
+			}
+			seconds += std::chrono::duration<double>(Clock::now() - start).count();
+			loader.ClearPrefetches();
+		}
+		Report("prefetch", seconds, totalBytes, latencies);
+		return true;
+	}
+
+	// Small reads into one caller owned buffer, the case a streamer reading mip tails or mesh chunks would have
+	bool BenchRanges(const std::vector<std::string>& paths, const Options& options)
+	{
+		std::string path;
+		uint64_t size = 0;
+		for (const std::string& candidate : paths)
+		{
+			std::ifstream file(candidate, std::ios::binary | std::ios::ate);
+			uint64_t candidateSize = file ? static_cast<uint64_t>(file.tellg()) : 0;
+			if (candidateSize > size)
+			{
+				path = candidate;
+				size = candidateSize;
+			}
+		}
+		if (size < options.rangeSize)
+		{
+			std::fprintf(stderr, "no input holds a range of %zu bytes\n", options.rangeSize);
+			return false;
+		}
+
+		std::mt19937_64 random(1);
+		std::vector<uint8_t> buffer(options.ranges * options.rangeSize), check(buffer.size());
+		std::vector<ReadRange> ranges(options.ranges);
+		for (size_t i = 0; i < ranges.size(); ++i)
+		{
+			ranges[i] = { random() % (size - options.rangeSize + 1), options.rangeSize, buffer.data() + i * options.rangeSize };
+		}
+		size_t totalBytes = buffer.size() * options.runs;
+		std::printf("%d runs of %zu ranges of %zu bytes from %s:\n", options.runs, ranges.size(), options.rangeSize, path.c_str());
+
+		AsyncFileReader reader(options.threads);
+		std::vector<double> latencies;
+		double seconds = 0.0;
+		for (int run = 0; run < options.runs; ++run)
+		{
+			if (options.cold) DropCache({ path });
+			auto start = Clock::now();
+			std::ifstream file(path, std::ios::binary);
+			for (size_t i = 0; i < ranges.size(); ++i)
+			{
+				file.seekg(static_cast<std::streamoff>(ranges[i].offset));
+				file.read(reinterpret_cast<char*>(check.data() + i * options.rangeSize), options.rangeSize);
+			}
+			latencies.push_back(Microseconds(Clock::now() - start));
+			seconds += std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		Report("seekg", seconds, totalBytes, latencies);
+
+		latencies.clear();
+		seconds = 0.0;
+		for (int run = 0; run < options.runs; ++run)
+		{
+			if (options.cold) DropCache({ path });
+			auto start = Clock::now();
+			std::vector<std::future<ReadResult>> futures;
+			for (unsigned share = 0; share < options.threads; ++share)
+			{
+				size_t begin = ShareBegin(ranges.size(), options.threads, share), end = ShareBegin(ranges.size(), options.threads, share + 1);
+				if (begin < end)
+				{
+					futures.push_back(reader.ReadBatch(path, std::vector<ReadRange>(ranges.begin() + begin, ranges.begin() + end)));
+				}
+			}
+			bool failed = false;
+			for (auto& future : futures)
+			{
+				failed |= future.get().status != ReadStatus::Done;
+			}
+			latencies.push_back(Microseconds(Clock::now() - start));
+			seconds += std::chrono::duration<double>(Clock::now() - start).count();
+			if (failed || buffer != check)
+			{
+				std::fprintf(stderr, "%s: batched ranges read differently\n", path.c_str());
+				return false;
+			}
+		}
+		Report("batch", seconds, totalBytes, latencies);
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			paths.push_back(arg);
+			continue;
+		}
+		if (!std::strcmp(arg, "-cold"))
+		{
+			options.cold = true;
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-runs"))				options.runs = std::atoi(value);
+		else if (!std::strcmp(arg, "-threads"))		options.threads = static_cast<unsigned>(std::atoi(value));
+		else if (!std::strcmp(arg, "-ranges"))		options.ranges = static_cast<size_t>(std::atoll(value));
+		else if (!std::strcmp(arg, "-range-size"))	options.rangeSize = static_cast<size_t>(std::atoll(value));
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (paths.empty() || options.runs <= 0 || options.threads == 0 || options.rangeSize == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (!BenchFiles(paths, options))
+	{
+		return 1;
+	}
+	if (options.ranges > 0 && !BenchRanges(paths, options))
+	{
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,345 @@
+//
+// BenchInput - checks the input queue and the per frame integration of input events, see InputQueue.h
+//
+// First the parts on their own: message times backdated across the tick count's wrap, a full queue dropping and
+// counting what doesn't fit, Pop leaving events after the frame for the next one, and a scripted run of frames whose key
+// holds, drags and focus loss must come out to the tick. Then a producer thread pushes events as fast as it can while
+// the main thread pops them, every one arriving once and in order, timed as events a second. Last, a random timeline
+// of key presses and a mouse drag, from a fixed seed, is cut into frames of varying length and measured twice: through
+// InputIntegrator, which must match the timeline, and by polling once a frame as Game::Update used to, whose error is
+// reported. Needs nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -pthread -I. Tools/BenchInput.cpp InputQueue.cpp InputIntegrator.cpp -o BenchInput
+//	./BenchInput -events 10000000 -seconds 60
+//
+
+#include "InputIntegrator.h"
+#include "InputQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		int		events = 10000000;
+		int		seconds = 60;
+		int		capacity = 4096;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchInput [options]\n"
+			"  -events <n>            events through the queue between two threads (default 10000000)\n"
+			"  -seconds <n>           length of the random input timeline (default 60)\n"
+			"  -capacity <n>          queue capacity in events (default 4096)\n");
+	}
+
+	constexpr int64_t c_TicksPerSecond = 1000000;		//microseconds, like a QPC at 1 MHz
+
+	InputEvent Key(int64_t time, uint16_t key, bool down)
+	{
+		return { time, InputEventType::Key, down, key, 0, 0 };
+	}
+
+	InputEvent Button(int64_t time, uint16_t button, bool down)
+	{
+		return { time, InputEventType::Button, down, button, 0, 0 };
+	}
+
+	InputEvent Move(int64_t time, int32_t x, int32_t y)
+	{
+		return { time, InputEventType::MouseMove, false, 0, x, y };
+	}
+
+	bool Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s\n", what);
+		}
+		return condition;
+	}
+
+	bool CheckBackdate()
+	{
+		const int64_t now = 50 * c_TicksPerSecond, maxAge = c_TicksPerSecond / 10;
+		bool ok = true;
+		ok &= Check(BackdateTicks(now, 1000, 995, c_TicksPerSecond, maxAge, 0) == now - 5000, "5 ms old message");
+		ok &= Check(BackdateTicks(now, 3, 0xfffffffeu, c_TicksPerSecond, maxAge, 0) == now - 5000, "5 ms old across the wrap");
+		ok &= Check(BackdateTicks(now, 1000, 1001, c_TicksPerSecond, maxAge, 0) == now, "message stamped after now");
+		ok &= Check(BackdateTicks(now, 1000, 0, c_TicksPerSecond, maxAge, 0) == now - maxAge, "age clamped");
+		ok &= Check(BackdateTicks(now, 1000, 990, c_TicksPerSecond, maxAge, now - 2000) == now - 2000, "kept after the last event");
+		ok &= Check(BackdateTicks(now, 1000, 990, c_TicksPerSecond, maxAge, now + 2000) == now, "never after now");
+		return ok;
+	}
+
+	bool CheckQueue()
+	{
+		bool ok = true;
+		InputQueue queue(8);
+		size_t capacity = queue.GetCapacity();
+		ok &= Check(capacity >= 8, "capacity");
+		for (size_t i = 0; i < capacity + 10; ++i)
+		{
+			ok &= Check(queue.Push(Move(int64_t(i), int32_t(i), 0)) == (i < capacity), "push into a full queue fails");
+		}
+		ok &= Check(queue.TakeDropped() == 10 && queue.TakeDropped() == 0, "dropped events counted once");
+
+		InputEvent event;
+		ok &= Check(queue.Pop(event, 3) && event.x == 0, "oldest first");
+		for (int32_t i = 1; i <= 3; ++i)
+		{
+			ok &= Check(queue.Pop(event, 3) && event.x == i, "in order");
+		}
+		ok &= Check(!queue.Pop(event, 3), "events after the frame stay");
+		ok &= Check(queue.Push(Move(100, 100, 0)), "room again after popping");
+		for (size_t i = 4; i < capacity; ++i)
+		{
+			ok &= Check(queue.Pop(event) && event.x == int32_t(i), "rest in order");
+		}
+		ok &= Check(queue.Pop(event) && event.x == 100 && !queue.Pop(event), "wrapped around");
+		return ok;
+	}
+
+	// Frames of 100 ms, times in ms turned to ticks
+	bool CheckIntegrator()
+	{
+		const int64_t ms = c_TicksPerSecond / 1000;
+		const uint16_t w = 'W', a = 'A', s = 'S', d = 'D';
+		bool ok = true;
+		InputIntegrator input;
+		input.Reset(c_TicksPerSecond, 0);
+		auto near = [](float value, float expected) { return std::fabs(value - expected) < 1e-6f; };
+
+		// 0 to 100: W goes down at 30
+		input.BeginFrame(100 * ms);
+		input.Apply(Key(30 * ms, w, true));
+		ok &= Check(near(input.GetHeldSeconds(w), 0.07f) && input.WasKeyPressed(w), "held from its press");
+		ok &= Check(near(input.GetFrameSeconds(), 0.1f), "frame length");
+
+		// 100 to 200: W held throughout and repeating, A tapped for 5 ms, S's down arrives late and counts from 100
+		input.BeginFrame(200 * ms);
+		input.Apply(Key(50 * ms, s, true));
+		input.Apply(Key(120 * ms, a, true));
+		input.Apply(Key(125 * ms, a, false));
+		input.Apply(Key(150 * ms, w, true));
+		input.Apply(Key(180 * ms, s, false));
+		ok &= Check(near(input.GetHeldSeconds(w), 0.1f) && !input.WasKeyPressed(w), "held across the frame, repeats ignored");
+		ok &= Check(near(input.GetHeldSeconds(a), 0.005f) && input.WasKeyPressed(a) && !input.IsKeyDown(a), "tap inside a frame");
+		ok &= Check(near(input.GetHeldSeconds(s), 0.08f), "late event from the frame's start");
+
+		// 200 to 300: W let go at 250
+		input.BeginFrame(300 * ms);
+		input.Apply(Key(250 * ms, w, false));
+		ok &= Check(near(input.GetHeldSeconds(w), 0.05f) && !input.IsKeyDown(w), "held until let go");
+		ok &= Check(near(input.GetHeldSeconds(a), 0.0f), "last frame's tap gone");
+
+		// 300 to 400: motion before, during and after a left drag, D held until focus goes at 360, an event stamped
+		// after the frame counts at its end
+		input.BeginFrame(400 * ms);
+		input.Apply(Key(305 * ms, d, true));
+		input.Apply(Move(310 * ms, 5, 0));
+		input.Apply(Button(320 * ms, 0, true));
+		input.Apply(Move(330 * ms, 3, 1));
+		input.Apply(Button(340 * ms, 0, false));
+		input.Apply(Move(350 * ms, 2, 2));
+		input.Apply({ 360 * ms, InputEventType::Focus, false, 0, 0, 0 });
+		input.Apply(Key(450 * ms, a, true));
+		int32_t x, y, dragX, dragY;
+		input.GetMouseDelta(x, y);
+		input.GetDragDelta(0, dragX, dragY);
+		ok &= Check(x == 10 && y == 3, "all the motion");
+		ok &= Check(dragX == 3 && dragY == 1, "only the motion while dragging");
+		ok &= Check(near(input.GetHeldSeconds(d), 0.055f) && !input.IsKeyDown(d), "let go when focus is lost");
+		ok &= Check(near(input.GetHeldSeconds(a), 0.0f) && input.IsKeyDown(a), "stamped after the frame");
+		return ok;
+	}
+
+	bool RunThreads(const Options& options)
+	{
+		InputQueue queue(static_cast<size_t>(options.capacity));
+		const int count = options.events;
+		uint64_t fullSpins = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		std::thread producer([&]()
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				while (!queue.Push(Move(i, i, -i)))
+				{
+					++fullSpins;
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		bool ordered = true;
+		InputEvent event;
+		for (int next = 0; next < count; )
+		{
+			if (!queue.Pop(event))
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			ordered &= event.time == next && event.x == next && event.y == -next;
+			++next;
+		}
+		producer.join();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		uint32_t dropped = queue.TakeDropped();
+
+		std::printf("queue: %d events between two threads, %.1f M events/s (%.1f ns each), producer found it full %llu times\n",
+			count, count / seconds * 1e-6, seconds / count * 1e9, static_cast<unsigned long long>(fullSpins));
+		return Check(ordered && !queue.Pop(event), "every event once and in order")
+			&& Check(dropped == fullSpins, "each full push counted as dropped");
+	}
+
+	// A random timeline of W presses and left drags with 1 kHz mouse motion, cut into 8 to 40 ms frames
+	bool RunTimeline(const Options& options)
+	{
+		std::mt19937 random(7);
+		std::uniform_int_distribution<int64_t> hold(5000, 300000), gap(5000, 400000), frame(8000, 40000);
+		const int64_t end = int64_t(options.seconds) * c_TicksPerSecond;
+		const uint16_t w = 'W';
+
+		// Presses as ground truth, events pushed in time order
+		std::vector<InputEvent> events;
+		int64_t heldTruth = 0, taps = 0;
+		for (int64_t t = gap(random); t < end; )
+		{
+			int64_t length = std::min(hold(random), end - t);
+			events.push_back(Key(t, w, true));
+			events.push_back(Key(t + length, w, false));
+			heldTruth += length;
+			taps += length < 40000;
+			t += length + gap(random);
+		}
+		int64_t dragTruth = 0;
+		bool dragging = false;
+		int64_t nextToggle = gap(random);
+		std::vector<InputEvent> motion;
+		for (int64_t t = 500; t < end; t += 1000)
+		{
+			if (t >= nextToggle)
+			{
+				dragging = !dragging;
+				motion.push_back(Button(t - 1, 0, dragging));
+				nextToggle = t + (dragging ? hold(random) : gap(random));
+			}
+			motion.push_back(Move(t, 1, 0));
+			dragTruth += dragging;
+		}
+		std::vector<InputEvent> merged(events.size() + motion.size());
+		std::merge(events.begin(), events.end(), motion.begin(), motion.end(), merged.begin(),
+			[](const InputEvent& a, const InputEvent& b) { return a.time < b.time; });
+
+		InputQueue queue(merged.size());
+		for (const InputEvent& event : merged)
+		{
+			queue.Push(event);
+		}
+
+		// Integrated from the events, and polled at each frame's start as the state then times the frame
+		InputIntegrator input;
+		input.Reset(c_TicksPerSecond, 0);
+		double heldIntegrated = 0.0, heldPolled = 0.0;
+		int64_t dragIntegrated = 0, dragPolled = 0;
+		bool polledKey = false, polledButton = false;
+		int64_t frames = 0;
+		for (int64_t frameEnd = 0; frameEnd < end; ++frames)
+		{
+			int64_t frameStart = frameEnd;
+			frameEnd = std::min(frameEnd + frame(random), end);
+			if (polledKey)
+			{
+				heldPolled += double(frameEnd - frameStart) / c_TicksPerSecond;
+			}
+
+			input.BeginFrame(frameEnd);
+			InputEvent event;
+			int32_t polledMotion = 0;
+			while (queue.Pop(event, frameEnd))
+			{
+				input.Apply(event);
+				polledMotion += event.type == InputEventType::MouseMove ? event.x : 0;
+			}
+			heldIntegrated += input.GetHeldSeconds(w);
+			int32_t x, y;
+			input.GetDragDelta(0, x, y);
+			dragIntegrated += x;
+			dragPolled += polledButton ? polledMotion : 0;
+
+			polledKey = input.IsKeyDown(w);
+			polledButton = input.IsButtonDown(0);
+		}
+
+		double truth = double(heldTruth) / c_TicksPerSecond;
+		std::printf("timeline: %.0f s, %lld frames, W held %.3f s over %zu presses (%lld shorter than 40 ms), dragged %lld counts\n",
+			double(options.seconds), static_cast<long long>(frames), truth, events.size() / 2, static_cast<long long>(taps),
+			static_cast<long long>(dragTruth));
+		std::printf("  integrated: held %.6f s (error %.2e s), dragged %lld counts\n", heldIntegrated, std::fabs(heldIntegrated - truth),
+			static_cast<long long>(dragIntegrated));
+		std::printf("  polled once a frame: held %.6f s (error %.3f s, %.2f%%), dragged %lld counts (error %lld)\n", heldPolled,
+			std::fabs(heldPolled - truth), std::fabs(heldPolled - truth) / truth * 100.0, static_cast<long long>(dragPolled),
+			static_cast<long long>(std::llabs(dragPolled - dragTruth)));
+
+		return Check(std::fabs(heldIntegrated - truth) < 1e-6 * double(frames), "integrated hold matches the timeline")
+			&& Check(dragIntegrated == dragTruth, "integrated drag matches the timeline");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-events"))				options.events = std::atoi(value);
+		else if (!std::strcmp(arg, "-seconds"))		options.seconds = std::atoi(value);
+		else if (!std::strcmp(arg, "-capacity"))		options.capacity = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.events <= 0 || options.seconds <= 0 || options.capacity <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (!CheckBackdate() || !CheckQueue() || !CheckIntegrator())
+	{
+		return 1;
+	}
+	std::printf("message times, queue and scripted frames checked\n");
+
+	if (!RunThreads(options) || !RunTimeline(options))
+	{
+		return 1;
+	}
+	return 0;
+}
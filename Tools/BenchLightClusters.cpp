@@ -0,0 +1,395 @@
+//
+// BenchLightClusters - checks and times binning lights into clusters, see LightClusters.h
+//
+// Random point and spot lights from a fixed seed are scattered through the frustum Game sets up (70 degree field of
+// view, 16:9, 0.1 to 100), some behind the camera, some past the far plane and some around the eye. They're binned by
+// LightClusters with the SSE tests, and again by a scalar reference in double precision that tests every light's
+// sphere against every cluster. Every light reaching a cluster must be in its list, unless the list is full, and
+// every light in the list must reach the box around the cluster, which LightClusters tests against, but for pairs
+// within rounding of touching. Then Build is timed with 1k and 10k lights, on the calling thread alone and across a
+// pool. Needs nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -pthread -I. Tools/BenchLightClusters.cpp LightClusters.cpp ThreadPool.cpp -o BenchLightClusters
+//	./BenchLightClusters -lights 1000,10000 -threads 0,3 -frames 200
+//
+
+#include "LightClusters.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::vector<size_t>		lightCounts = { 1000, 10000 };
+		std::vector<size_t>		threadCounts = { 0, 3 };		//workers besides the calling thread
+		int						frames = 200;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchLightClusters [options]\n"
+			"  -lights <a,b,...>      light counts (default 1000,10000)\n"
+			"  -threads <a,b,...>     pool workers besides the calling thread (default 0,3)\n"
+			"  -frames <n>            builds timed per case (default 200)\n");
+	}
+
+	bool ParseList(const char* value, std::vector<size_t>& list, bool allowZero)
+	{
+		list.clear();
+		for (const char* p = value; *p; )
+		{
+			char* end;
+			unsigned long count = std::strtoul(p, &end, 10);
+			if (end == p || (count == 0 && !allowZero))
+			{
+				return false;
+			}
+			list.push_back(count);
+			p = *end == ',' ? end + 1 : end;
+		}
+		return !list.empty();
+	}
+
+	bool Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s\n", what);
+		}
+		return condition;
+	}
+
+	// Game's projection, 70 degrees vertically at 16:9
+	const float c_ProjScaleY = 1.0f / std::tan(35.0f * 3.14159265f / 180.0f);
+	const float c_ProjScaleX = c_ProjScaleY * 9.0f / 16.0f;
+
+	// Right handed look at from (2, 2, 2) towards the origin as rows, the way Game's m_view is laid out
+	void LookAt(float view[16])
+	{
+		const double eye[3] = { 2.0, 2.0, 2.0 };
+		double z[3] = { eye[0], eye[1], eye[2] };
+		double length = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		for (double& v : z)
+		{
+			v /= length;
+		}
+		double x[3] = { z[2], 0.0, -z[0] };		//up cross z
+		length = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+		x[0] /= length;
+		x[2] /= length;
+		double y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+		for (int i = 0; i < 3; ++i)
+		{
+			view[i * 4 + 0] = float(x[i]);
+			view[i * 4 + 1] = float(y[i]);
+			view[i * 4 + 2] = float(z[i]);
+			view[i * 4 + 3] = 0.0f;
+		}
+		view[12] = float(-(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]));
+		view[13] = float(-(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]));
+		view[14] = float(-(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]));
+		view[15] = 1.0f;
+	}
+
+	std::vector<ClusterLight> MakeLights(size_t count, const float view[16], std::mt19937& random)
+	{
+		// Placed in view space and taken back to the world by the transpose of the view's rotation
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<ClusterLight> lights(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			ClusterLight& light = lights[i];
+			float depth, radius;
+			switch (i % 10)
+			{
+			case 0:		depth = -3.0f * unit(random); radius = 0.2f + 1.0f * unit(random); break;		//behind the eye
+			case 1:		depth = 0.3f * unit(random); radius = 0.05f + 0.5f * unit(random); break;		//around it
+			case 2:		depth = 95.0f + 10.0f * unit(random); radius = 0.5f + 2.0f * unit(random); break;	//across the far plane
+			default:	depth = 0.1f + 100.0f * unit(random) * unit(random); radius = 0.1f + 1.0f * unit(random); break;
+			}
+			float spread = 1.3f * std::max(depth, 1.0f);
+			float local[3] = { spread / c_ProjScaleX * (2.0f * unit(random) - 1.0f), spread / c_ProjScaleY * (2.0f * unit(random) - 1.0f), -depth };
+			local[0] -= view[12];
+			local[1] -= view[13];
+			local[2] -= view[14];
+			for (int a = 0; a < 3; ++a)
+			{
+				light.position[a] = local[0] * view[a * 4 + 0] + local[1] * view[a * 4 + 1] + local[2] * view[a * 4 + 2];
+			}
+			light.radius = radius;
+			light.colour[0] = light.colour[1] = light.colour[2] = 1.0f;
+			light.intensity = 1.0f;
+			light.type = i % 3 ? ClusterLightType::Point : ClusterLightType::Spot;
+			light.direction[0] = 0.0f;
+			light.direction[1] = -1.0f;
+			light.direction[2] = 0.0f;
+			light.cosOuter = 0.7f;
+			light.cosInner = 0.9f;
+		}
+		return lights;
+	}
+
+	// The scalar reference. A cluster is the part of its screen tile between two depths; LightClusters tests spheres
+	// against the box around it, which is a little larger, so a pair is needed when the sphere reaches the cluster
+	// itself and allowed when it reaches the box.
+	struct Reference
+	{
+		std::vector<double>					cells;			//left, right, bottom, top of the tile as x / depth and y / depth, near and far depth
+		std::vector<double>					spheres;		//view space centre, z as depth, and radius of each light
+		std::vector<std::vector<uint32_t>>	clusters;		//lights reaching each cluster's box
+
+		// Sphere surface to the cluster's box, negative inside
+		double BoxDistance(size_t cluster, size_t light) const
+		{
+			const double* cell = &cells[cluster * 6];
+			const double* sphere = &spheres[light * 4];
+			double box[6] =
+			{
+				std::min(cell[0] * cell[4], cell[0] * cell[5]), std::max(cell[1] * cell[4], cell[1] * cell[5]),
+				std::min(cell[2] * cell[4], cell[2] * cell[5]), std::max(cell[3] * cell[4], cell[3] * cell[5]),
+				cell[4], cell[5],
+			};
+			double d2 = 0.0;
+			for (int a = 0; a < 3; ++a)
+			{
+				double d = std::max(std::max(box[a * 2] - sphere[a], sphere[a] - box[a * 2 + 1]), 0.0);
+				d2 += d * d;
+			}
+			return std::sqrt(d2) - sphere[3];
+		}
+
+		// Sphere surface to the cluster itself. The distance to the cluster's rectangle at a depth is convex in the
+		// depth, the cluster being convex, so its smallest value is found by a ternary search.
+		double CellDistance(size_t cluster, size_t light) const
+		{
+			const double* cell = &cells[cluster * 6];
+			const double* sphere = &spheres[light * 4];
+			auto at = [&](double depth)
+			{
+				double dx = std::max(std::max(cell[0] * depth - sphere[0], sphere[0] - cell[1] * depth), 0.0);
+				double dy = std::max(std::max(cell[2] * depth - sphere[1], sphere[1] - cell[3] * depth), 0.0);
+				double dz = depth - sphere[2];
+				return dx * dx + dy * dy + dz * dz;
+			};
+			double lo = cell[4], hi = cell[5];
+			for (int i = 0; i < 100; ++i)
+			{
+				double a = lo + (hi - lo) / 3.0, b = hi - (hi - lo) / 3.0;
+				if (at(a) < at(b))
+				{
+					hi = b;
+				}
+				else
+				{
+					lo = a;
+				}
+			}
+			return std::sqrt(at((lo + hi) * 0.5)) - sphere[3];
+		}
+	};
+
+	Reference Bin(const ClusterGridDesc& grid, const float view[16], const ClusterLight* lights, size_t count)
+	{
+		Reference reference;
+		size_t clusterCount = size_t(grid.tilesX) * grid.tilesY * grid.slices;
+		reference.cells.resize(clusterCount * 6);
+		for (uint32_t z = 0; z < grid.slices; ++z)
+		{
+			// As SetGrid, the first slice reaches back to the eye
+			double nearDepth = z == 0 ? 0.0 : grid.nearZ * std::pow(double(grid.farZ) / grid.nearZ, double(z) / grid.slices);
+			double farDepth = grid.nearZ * std::pow(double(grid.farZ) / grid.nearZ, double(z + 1) / grid.slices);
+			for (uint32_t y = 0; y < grid.tilesY; ++y)
+			{
+				for (uint32_t x = 0; x < grid.tilesX; ++x)
+				{
+					double* cell = &reference.cells[((size_t(z) * grid.tilesY + y) * grid.tilesX + x) * 6];
+					cell[0] = (-1.0 + 2.0 * x / grid.tilesX) / c_ProjScaleX;
+					cell[1] = (-1.0 + 2.0 * (x + 1) / grid.tilesX) / c_ProjScaleX;
+					cell[2] = (1.0 - 2.0 * (y + 1) / grid.tilesY) / c_ProjScaleY;
+					cell[3] = (1.0 - 2.0 * y / grid.tilesY) / c_ProjScaleY;
+					cell[4] = nearDepth;
+					cell[5] = farDepth;
+				}
+			}
+		}
+
+		reference.spheres.resize(count * 4);
+		for (size_t l = 0; l < count; ++l)
+		{
+			const float* p = lights[l].position;
+			double* sphere = &reference.spheres[l * 4];
+			for (int a = 0; a < 3; ++a)
+			{
+				sphere[a] = double(p[0]) * view[a] + double(p[1]) * view[4 + a] + double(p[2]) * view[8 + a] + view[12 + a];
+			}
+			sphere[2] = -sphere[2];		//right handed, depth is positive in front
+			sphere[3] = lights[l].radius;
+		}
+
+		reference.clusters.resize(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			for (size_t l = 0; l < count; ++l)
+			{
+				if (reference.BoxDistance(c, l) <= 0.0)
+				{
+					reference.clusters[c].push_back(uint32_t(l));
+				}
+			}
+		}
+		return reference;
+	}
+
+	bool CheckAgainstReference(size_t count, std::mt19937& random)
+	{
+		float view[16];
+		LookAt(view);
+		std::vector<ClusterLight> lights = MakeLights(count, view, random);
+
+		ClusterGridDesc grid;
+		LightClusters clusters;
+		clusters.SetGrid(grid, c_ProjScaleX, c_ProjScaleY);
+		clusters.Build(view, true, lights.data(), lights.size(), nullptr);
+		Reference reference = Bin(grid, view, lights.data(), lights.size());
+
+		const std::vector<uint32_t>& ranges = clusters.GetClusterRanges();
+		const std::vector<uint32_t>& indices = clusters.GetLightIndices();
+		size_t binnedPairs = 0, needed = 0, boxOnly = 0, borderline = 0, dropped = 0, missing = 0, extra = 0;
+		for (uint32_t c = 0; c < clusters.GetClusterCount(); ++c)
+		{
+			std::vector<uint32_t> binned(indices.begin() + ranges[c * 2], indices.begin() + ranges[c * 2] + ranges[c * 2 + 1]);
+			std::sort(binned.begin(), binned.end());
+			binnedPairs += binned.size();
+			bool full = binned.size() == LightClusters::c_MaxLightsPerCluster;
+
+			// Every binned light must reach the box, but within rounding
+			for (uint32_t l : binned)
+			{
+				double distance = reference.BoxDistance(c, l);
+				if (distance > 0.0)
+				{
+					distance <= 1e-4 * (1.0 + reference.spheres[l * 4 + 2]) ? ++borderline : ++extra;
+				}
+			}
+
+			// And every light reaching the cluster itself must be binned, unless the cluster was full
+			for (uint32_t l : reference.clusters[c])
+			{
+				double distance = reference.CellDistance(c, l);
+				bool binnedHere = std::binary_search(binned.begin(), binned.end(), l);
+				needed += distance <= 0.0;
+				boxOnly += distance > 0.0 && binnedHere;
+				if (binnedHere || distance > 0.0)
+				{
+					continue;
+				}
+				if (full)
+				{
+					++dropped;
+				}
+				else
+				{
+					distance >= -1e-4 * (1.0 + reference.spheres[l * 4 + 2]) ? ++borderline : ++missing;
+				}
+			}
+		}
+
+		std::printf("%6zu lights: %zu pairs binned, %zu reach the cluster, %zu only its box, %zu decided by rounding, "
+			"%zu dropped from full clusters (%u counted)\n", count, binnedPairs, needed, boxOnly, borderline, dropped, clusters.GetOverflowCount());
+		bool ok = Check(missing == 0, "every light reaching a cluster binned");
+		ok &= Check(extra == 0, "only lights reaching a cluster's box binned");
+		ok &= Check(borderline * 1000 <= binnedPairs + 1000, "few pairs decided by rounding");
+		ok &= Check(dropped <= clusters.GetOverflowCount(), "dropped lights counted");
+		return ok;
+	}
+
+	double BuildMicroseconds(LightClusters& clusters, const float view[16], const std::vector<ClusterLight>& lights, ThreadPool* pool, int frames)
+	{
+		clusters.Build(view, true, lights.data(), lights.size(), pool);
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			clusters.Build(view, true, lights.data(), lights.size(), pool);
+		}
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		bool valid = true;
+		if (!std::strcmp(arg, "-lights"))			valid = ParseList(value, options.lightCounts, false);
+		else if (!std::strcmp(arg, "-threads"))		valid = ParseList(value, options.threadCounts, true);
+		else if (!std::strcmp(arg, "-frames"))		options.frames = std::atoi(value);
+		else										valid = false;
+
+		if (!valid)
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.frames <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::mt19937 random(28);
+	bool ok = true;
+	for (size_t count : options.lightCounts)
+	{
+		ok &= CheckAgainstReference(count, random);
+	}
+	if (!ok)
+	{
+		return 1;
+	}
+
+	float view[16];
+	LookAt(view);
+	for (size_t count : options.lightCounts)
+	{
+		std::vector<ClusterLight> lights = MakeLights(count, view, random);
+		for (size_t threads : options.threadCounts)
+		{
+			std::unique_ptr<ThreadPool> pool;
+			if (threads > 0)
+			{
+				pool = std::make_unique<ThreadPool>(static_cast<unsigned>(threads));
+			}
+			LightClusters clusters;
+			clusters.SetGrid(ClusterGridDesc(), c_ProjScaleX, c_ProjScaleY);
+			double us = BuildMicroseconds(clusters, view, lights, pool.get(), options.frames);
+			std::printf("%6zu lights, %zu workers + caller: %8.1f us a build, %zu indices\n", count, threads, us,
+				clusters.GetLightIndices().size());
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,437 @@
+//
+// BenchLightProbes - checks the SH projection, evaluation and probe grid blend, see LightProbes.h
+//
+// Environments whose radiance is a polynomial of degree two in the direction are projected from an even spread of
+// directions and evaluated at random normals against their irradiance worked out by hand: a constant gives the same
+// constant everywhere, a linear term two thirds of it and the quadratic terms a quarter of their band 2 part. Probe
+// grids holding a value linear in position must blend back to it at every random point inside, clamp to the edge
+// outside, skip and reweight invalid probes and return a zero probe when none of the eight around a point is usable.
+// Then a grid is saved, loaded back and a truncated copy refused. Last, projecting rays and blending probes are timed.
+// Needs nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BenchLightProbes.cpp LightProbes.cpp -o BenchLightProbes
+//	./BenchLightProbes -rays 4096 -samples 1000000
+//
+
+#include "LightProbes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace
+{
+	constexpr float c_Pi = 3.14159265f;
+
+	struct Options
+	{
+		int		rays = 4096;
+		int		samples = 1000000;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchLightProbes [options]\n"
+			"  -rays <n>       directions each probe is projected from when timing (default 4096)\n"
+			"  -samples <n>    grid blends timed (default 1000000)\n");
+	}
+
+	bool Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s\n", what);
+		}
+		return condition;
+	}
+
+	// count directions spread evenly over the sphere on a Fibonacci spiral
+	std::vector<float> SphereDirections(int count)
+	{
+		std::vector<float> directions;
+		directions.reserve(size_t(count) * 3);
+		const float golden = c_Pi * (3.0f - std::sqrt(5.0f));
+		for (int i = 0; i < count; ++i)
+		{
+			float z = 1.0f - (2.0f * i + 1.0f) / count;
+			float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+			float phi = golden * i;
+			directions.insert(directions.end(), { r * std::cos(phi), r * std::sin(phi), z });
+		}
+		return directions;
+	}
+
+	void RandomUnit(std::mt19937& random, float direction[3])
+	{
+		std::normal_distribution<float> normal;
+		float length = 0.0f;
+		while (length < 1e-3f)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				direction[k] = normal(random);
+			}
+			length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			direction[k] /= length;
+		}
+	}
+
+	// Radiance constant + linear . w + zz * z^2 + xy * x * y + xxyy * (x^2 - y^2), one term set per channel
+	struct Environment
+	{
+		float	constant = 0.0f;
+		float	linear[3] = {};
+		float	zz = 0.0f;
+		float	xy = 0.0f;
+		float	xxyy = 0.0f;
+
+		float Radiance(const float w[3]) const
+		{
+			return constant + linear[0] * w[0] + linear[1] * w[1] + linear[2] * w[2] + zz * w[2] * w[2]
+				+ xy * w[0] * w[1] + xxyy * (w[0] * w[0] - w[1] * w[1]);
+		}
+
+		// The cosine weighted mean over the hemisphere around n. Band 1 scales by 2/3 and band 2 by 1/4, and
+		// z^2 = 1/3 + (3z^2 - 1) / 3 splits into bands 0 and 2.
+		float Irradiance(const float n[3]) const
+		{
+			return constant + (2.0f / 3.0f) * (linear[0] * n[0] + linear[1] * n[1] + linear[2] * n[2])
+				+ zz * (1.0f / 3.0f + (3.0f * n[2] * n[2] - 1.0f) / 12.0f)
+				+ 0.25f * (xy * n[0] * n[1] + xxyy * (n[0] * n[0] - n[1] * n[1]));
+		}
+	};
+
+	ShProbe Project(const Environment (&channels)[3], const std::vector<float>& directions)
+	{
+		ShRadiance radiance;
+		size_t count = directions.size() / 3;
+		float weight = 4.0f * c_Pi / float(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float* w = &directions[i * 3];
+			float value[3] = { channels[0].Radiance(w), channels[1].Radiance(w), channels[2].Radiance(w) };
+			radiance.Add(w, value, weight);
+		}
+		return ShProbe::FromRadiance(radiance);
+	}
+
+	bool CheckProjection()
+	{
+		bool ok = true;
+		std::vector<float> directions = SphereDirections(20000);
+		std::mt19937 random(33);
+
+		// Only the constant reaches every channel the same, the rest differ per channel
+		const Environment constant[3] = { { 0.75f }, { 0.75f }, { 0.75f } };
+		const Environment mixed[3] =
+		{
+			{ 1.0f, { 0.3f, -0.2f, 0.1f }, 0.5f, 0.4f, -0.3f },
+			{ 0.6f, { 0.0f, 0.25f, -0.15f }, -0.2f, 0.0f, 0.2f },
+			{ 2.0f, { -0.5f, 0.0f, 0.4f }, 0.0f, -0.6f, 0.0f },
+		};
+
+		ShProbe probe = Project(constant, directions);
+		float worst = 0.0f;
+		for (int i = 0; i < 1000; ++i)
+		{
+			float normal[3], irradiance[3];
+			RandomUnit(random, normal);
+			probe.Evaluate(normal, irradiance);
+			for (int c = 0; c < 3; ++c)
+			{
+				worst = std::max(worst, std::fabs(irradiance[c] - 0.75f));
+			}
+		}
+		ok &= Check(worst < 5e-4f, "a constant environment gives the same irradiance at every normal");
+
+		probe = Project(mixed, directions);
+		worst = 0.0f;
+		for (int i = 0; i < 1000; ++i)
+		{
+			float normal[3], irradiance[3];
+			RandomUnit(random, normal);
+			probe.Evaluate(normal, irradiance);
+			for (int c = 0; c < 3; ++c)
+			{
+				worst = std::max(worst, std::fabs(irradiance[c] - mixed[c].Irradiance(normal)));
+			}
+		}
+		ok &= Check(worst < 1e-3f, "bands 0 to 2 convolved with the cosine lobe");
+		ok &= Check(probe.coefficients[6][3] == 0.0f, "unused lane of ShC zero");
+
+		// Darker than nothing reads as nothing
+		const Environment negative[3] = { { -1.0f }, { -1.0f }, { -1.0f } };
+		float up[3] = { 0.0f, 0.0f, 1.0f }, irradiance[3];
+		Project(negative, directions).Evaluate(up, irradiance);
+		ok &= Check(irradiance[0] == 0.0f && irradiance[1] == 0.0f && irradiance[2] == 0.0f, "irradiance clamped at zero");
+		return ok;
+	}
+
+	// A probe whose every coefficient is the same linear function of the probe position, so a blend can be checked
+	// against the function at the sampled point
+	float Linear(const float position[3])
+	{
+		return 1.0f + 0.5f * position[0] - 0.25f * position[1] + 0.125f * position[2];
+	}
+
+	ShProbe Filled(float value)
+	{
+		ShProbe probe;
+		for (int j = 0; j < 7; ++j)
+		{
+			for (int k = 0; k < 4; ++k)
+			{
+				probe.coefficients[j][k] = value;
+			}
+		}
+		return probe;
+	}
+
+	bool Holds(const ShProbe& probe, float value, float tolerance)
+	{
+		for (int j = 0; j < 7; ++j)
+		{
+			for (int k = 0; k < 4; ++k)
+			{
+				if (std::fabs(probe.coefficients[j][k] - value) > tolerance)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void FillLinear(LightProbeGrid& grid)
+	{
+		for (uint32_t i = 0; i < grid.GetProbeCount(); ++i)
+		{
+			float position[3];
+			grid.GetProbePosition(i, position);
+			grid.SetProbe(i, Filled(Linear(position)), true);
+		}
+	}
+
+	bool CheckGrid()
+	{
+		bool ok = true;
+		const float origin[3] = { -4.0f, 0.5f, 2.0f }, spacing[3] = { 2.0f, 1.5f, 3.0f };
+		const uint32_t counts[3] = { 5, 4, 3 };
+		LightProbeGrid grid;
+		ShProbe probe;
+		float position[3] = { 0.0f, 0.0f, 0.0f };
+		ok &= Check(!grid.Sample(position, probe) && Holds(probe, 0.0f, 0.0f), "empty grid");
+
+		grid.Resize(origin, spacing, counts);
+		ok &= Check(grid.GetProbeCount() == 60 && grid.GetValidCount() == 0, "resized");
+		grid.GetProbePosition(5 + 2 * 20 + 3, position);
+		ok &= Check(position[0] == 2.0f && position[1] == 2.0f && position[2] == 8.0f, "probe position x fastest");
+
+		FillLinear(grid);
+		ok &= Check(grid.GetValidCount() == 60, "all probes valid");
+
+		std::mt19937 random(33);
+		float worst = 0.0f;
+		bool usable = true;
+		for (int i = 0; i < 10000; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				position[k] = std::uniform_real_distribution<float>(origin[k], origin[k] + spacing[k] * (counts[k] - 1))(random);
+			}
+			usable &= grid.Sample(position, probe) && Holds(probe, probe.coefficients[0][0], 0.0f);
+			worst = std::max(worst, std::fabs(probe.coefficients[0][0] - Linear(position)));
+		}
+		ok &= Check(usable, "every sample inside the grid usable and each lane blended alike");
+		ok &= Check(worst < 1e-4f, "trilinear blend reproduces a linear field");
+
+		// Outside the grid the nearest point on its edge
+		const float outside[3] = { -10.0f, 100.0f, 5.0f }, clamped[3] = { -4.0f, 5.0f, 5.0f };
+		grid.Sample(outside, probe);
+		ok &= Check(std::fabs(probe.coefficients[0][0] - Linear(clamped)) < 1e-5f, "clamped to the grid edge");
+
+		// A buried probe is left out, a point right on it takes its neighbours
+		grid.GetProbePosition(26, position);
+		grid.SetProbe(26, Filled(1000.0f), false);
+		ok &= Check(grid.GetValidCount() == 59, "invalid probe counted");
+		// Right on it every trilinear weight is its own, the other seven corners of the cell share it evenly: their
+		// mean is eight times the centre of the cell less the buried probe, over seven
+		const float centre[3] = { position[0] + 1.0f, position[1] + 0.75f, position[2] + 1.5f };
+		float others = (8.0f * Linear(centre) - Linear(position)) / 7.0f;
+		ok &= Check(grid.Sample(position, probe) && std::fabs(probe.coefficients[0][0] - others) < 1e-5f, "invalid probe skipped");
+		position[0] += 0.5f;
+		ok &= Check(grid.Sample(position, probe) && probe.coefficients[0][0] < 100.0f, "invalid probe skipped between probes");
+
+		// With a constant field the reweighting must leave the constant
+		for (uint32_t i = 0; i < grid.GetProbeCount(); ++i)
+		{
+			grid.SetProbe(i, Filled(2.5f), i % 3 != 0);
+		}
+		bool constant = true;
+		for (int i = 0; i < 1000; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				position[k] = std::uniform_real_distribution<float>(origin[k], origin[k] + spacing[k] * (counts[k] - 1))(random);
+			}
+			constant &= !grid.Sample(position, probe) || Holds(probe, 2.5f, 1e-5f);
+		}
+		ok &= Check(constant, "reweighted blend of a constant field");
+
+		for (uint32_t i = 0; i < grid.GetProbeCount(); ++i)
+		{
+			grid.SetProbe(i, Filled(2.5f), false);
+		}
+		ok &= Check(!grid.Sample(origin, probe) && Holds(probe, 0.0f, 0.0f), "no usable probe gives zero");
+
+		// One probe along an axis always takes it
+		const uint32_t flat[3] = { 3, 1, 2 };
+		grid.Resize(origin, spacing, flat);
+		FillLinear(grid);
+		position[0] = origin[0] + 1.0f;
+		position[1] = 50.0f;
+		position[2] = origin[2] + 1.0f;
+		const float onPlane[3] = { position[0], origin[1], position[2] };
+		ok &= Check(grid.Sample(position, probe) && std::fabs(probe.coefficients[0][0] - Linear(onPlane)) < 1e-5f,
+			"single probe layer");
+		return ok;
+	}
+
+	bool CheckFile()
+	{
+		bool ok = true;
+		const char* path = "BenchLightProbes.probes";
+		const float origin[3] = { 1.0f, 2.0f, 3.0f }, spacing[3] = { 0.5f, 1.0f, 2.0f };
+		const uint32_t counts[3] = { 4, 3, 2 };
+		LightProbeGrid grid;
+		grid.Resize(origin, spacing, counts);
+		FillLinear(grid);
+		grid.SetProbe(7, Filled(0.0f), false);
+		grid.sourceHash = 0x0123456789abcdefull;
+		ok &= Check(grid.Save(path), "saved");
+
+		LightProbeGrid loaded;
+		ok &= Check(loaded.Load(path) && loaded.sourceHash == grid.sourceHash && loaded.GetProbeCount() == 24
+			&& loaded.GetValidCount() == 23, "loaded back");
+		for (int i = 0; i < 100 && ok; ++i)
+		{
+			float position[3] = { 1.0f + 0.017f * i, 2.0f + 0.02f * i, 3.0f + 0.02f * i };
+			ShProbe a, b;
+			grid.Sample(position, a);
+			loaded.Sample(position, b);
+			ok &= Check(std::memcmp(&a, &b, sizeof(ShProbe)) == 0, "loaded grid blends the same");
+		}
+
+		std::vector<char> bytes;
+		{
+			std::ifstream file(path, std::ios::binary);
+			bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		for (size_t size : { size_t(0), size_t(4), size_t(40), bytes.size() / 2, bytes.size() - 1 })
+		{
+			{
+				std::ofstream file(path, std::ios::binary | std::ios::trunc);
+				file.write(bytes.data(), size);
+			}
+			ok &= Check(!loaded.Load(path), "truncated file refused");
+		}
+		bytes[0] ^= 1;
+		{
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			file.write(bytes.data(), bytes.size());
+		}
+		ok &= Check(!loaded.Load(path), "wrong magic refused");
+		std::remove(path);
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-rays"))				options.rays = std::atoi(value);
+		else if (!std::strcmp(arg, "-samples"))		options.samples = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.rays <= 0 || options.samples <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (!CheckProjection() || !CheckGrid() || !CheckFile())
+	{
+		return 1;
+	}
+	std::printf("probes projected, evaluated and blended\n");
+
+	const Environment sky[3] = { { 0.4f, { 0.0f, 0.0f, 0.3f } }, { 0.5f, { 0.0f, 0.0f, 0.35f } }, { 0.7f, { 0.0f, 0.0f, 0.5f } } };
+	std::vector<float> directions = SphereDirections(options.rays);
+	auto start = std::chrono::steady_clock::now();
+	ShProbe probe;
+	float checksum = 0.0f;
+	for (int run = 0; run < 100; ++run)
+	{
+		probe = Project(sky, directions);
+		checksum += probe.coefficients[0][3];
+	}
+	double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / 100;
+	std::printf("  %d rays projected into a probe: %.1f us (%.3f)\n", options.rays, us, checksum / 100);
+
+	const float origin[3] = { -50.0f, 0.0f, -50.0f }, spacing[3] = { 2.0f, 2.0f, 2.0f };
+	const uint32_t counts[3] = { 51, 8, 51 };
+	LightProbeGrid grid;
+	grid.Resize(origin, spacing, counts);
+	for (uint32_t i = 0; i < grid.GetProbeCount(); ++i)
+	{
+		grid.SetProbe(i, probe, i % 17 != 0);
+	}
+	std::mt19937 random(33);
+	std::uniform_real_distribution<float> across(-55.0f, 55.0f), up(-1.0f, 16.0f);
+	std::vector<float> positions(size_t(options.samples) * 3);
+	for (int i = 0; i < options.samples; ++i)
+	{
+		positions[i * 3 + 0] = across(random);
+		positions[i * 3 + 1] = up(random);
+		positions[i * 3 + 2] = across(random);
+	}
+	checksum = 0.0f;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < options.samples; ++i)
+	{
+		ShProbe blended;
+		grid.Sample(&positions[i * 3], blended);
+		checksum += blended.coefficients[0][3];
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / options.samples;
+	std::printf("  %u probes, %d blends: %.1f ns each (%.3f)\n", grid.GetProbeCount(), options.samples, ns,
+		checksum / options.samples);
+	return 0;
+}
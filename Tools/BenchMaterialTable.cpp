@@ -0,0 +1,278 @@
+//
+// BenchMaterialTable - checks building, saving and looking up the packed material table, see MaterialTable.h
+//
+// A table built the way PackMaterials builds it must hand out slices in order, give a texture added twice (or with a
+// directory in front, either kind of slash) its first slice, and find each name whatever directory it is asked with.
+// It must save and load back to the same names, slices and array path. Truncated or corrupted copies must be refused
+// and leave the table empty: a wrong magic or version, a name longer than a path can be, more slices than an array
+// can hold. A table file given on the command line (the repository's materials.mat) must load, and each of its names
+// must be a scene texture the game loads. The array it names must exist next to it and have a slice for every name.
+// Last, Find is timed on a table as large as an array can be. Needs nothing from Windows, e.g. on Linux from the
+// repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BenchMaterialTable.cpp MaterialTable.cpp DDSFile.cpp -o BenchMaterialTable
+//	./BenchMaterialTable materials.mat -runs 1000000
+//
+
+#include "DDSFile.h"
+#include "MaterialTable.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::string		table;
+		int				runs = 1000000;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchMaterialTable [table.mat] [options]\n"
+			"  -runs <n>    lookups timed (default 1000000)\n");
+	}
+
+	bool Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s\n", what);
+		}
+		return condition;
+	}
+
+	bool ReadBytes(const std::string& path, std::vector<char>& bytes)
+	{
+		std::ifstream file(path, std::ios::binary);
+		bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return bool(file) || file.eof();
+	}
+
+	bool WriteBytes(const std::string& path, const std::vector<char>& bytes, size_t size)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(bytes.data(), size);
+		return file.good();
+	}
+
+	void PutValue(std::vector<char>& bytes, size_t offset, uint32_t value)
+	{
+		std::memcpy(&bytes[offset], &value, sizeof(value));
+	}
+
+	bool CheckBuild()
+	{
+		bool ok = true;
+		MaterialTable table;
+		ok &= Check(table.Empty() && table.Find("wood.dds") == -1, "empty table");
+		ok &= Check(table.Add("wood.dds") == 0 && table.Add("wallpaper.dds") == 1 && table.Add("tile.dds") == 2, "slices in order");
+		ok &= Check(table.Add("wood.dds") == 0 && table.Add("textures/wallpaper.dds") == 1 && table.Add("C:\\scene\\tile.dds") == 2,
+			"a texture added again keeps its slice");
+		ok &= Check(table.Add("textures\\GRASS.dds") == 3 && table.GetName(3) == "GRASS.dds", "stored without its directory");
+		ok &= Check(table.GetCount() == 4 && !table.Empty(), "four slices");
+
+		ok &= Check(table.Find("tile.dds") == 2 && table.Find("./tile.dds") == 2 && table.Find("a/b\\tile.dds") == 2,
+			"found whatever the directory");
+		ok &= Check(table.Find("stone.dds") == -1 && table.Find("tile") == -1 && table.Find("tile.dds/") == -1 && table.Find("") == -1,
+			"others missing");
+		ok &= Check(table.Find("TILE.dds") == -1, "names as they were packed");
+
+		table.texturePath = "materials.dds";
+		table.Clear();
+		ok &= Check(table.Empty() && table.texturePath.empty() && table.Find("wood.dds") == -1, "cleared");
+		return ok;
+	}
+
+	bool CheckFile()
+	{
+		bool ok = true;
+		const char* path = "BenchMaterialTable.mat";
+		MaterialTable table;
+		table.texturePath = "materials.dds";
+		for (const char* name : { "wood.dds", "wallpaper.dds", "tile.dds", "space.dds", "GRASS.dds", "cobble.dds", "white.dds" })
+		{
+			table.Add(name);
+		}
+		ok &= Check(table.Save(path), "saved");
+
+		MaterialTable loaded;
+		ok &= Check(loaded.Load(path) && loaded.texturePath == table.texturePath && loaded.GetCount() == table.GetCount(), "loaded back");
+		for (uint32_t slice = 0; slice < table.GetCount() && ok; ++slice)
+		{
+			ok &= Check(loaded.GetName(slice) == table.GetName(slice) && loaded.Find(table.GetName(slice)) == int(slice),
+				"same names and slices");
+		}
+
+		MaterialTable empty;
+		ok &= Check(empty.Save(path) && loaded.Load(path) && loaded.Empty() && loaded.texturePath.empty(), "empty table round trip");
+
+		std::vector<char> bytes;
+		ok &= Check(table.Save(path) && ReadBytes(path, bytes) && bytes.size() > 12, "read back");
+		if (!ok)
+		{
+			return false;
+		}
+
+		// Every cut is refused and leaves nothing behind
+		bool refused = true;
+		for (size_t size = 0; size < bytes.size(); ++size)
+		{
+			WriteBytes(path, bytes, size);
+			refused &= !loaded.Load(path) && loaded.Empty() && loaded.texturePath.empty();
+		}
+		ok &= Check(refused, "truncated tables refused");
+
+		// magic, version, array path length (13 for materials.dds), then the slice count
+		const size_t countOffset = 12 + table.texturePath.size();
+		struct Corruption
+		{
+			size_t		offset;
+			uint32_t	value;
+			const char*	what;
+		};
+		const Corruption corruptions[] =
+		{
+			{ 0, 0x4c42544e, "wrong magic refused" },
+			{ 4, 2, "wrong version refused" },
+			{ 8, 261, "overlong array path refused" },
+			{ 8, 0xffffffff, "wrapping array path refused" },
+			{ countOffset, 2049, "too many slices refused" },
+			{ countOffset, 8, "more slices than names refused" },
+			{ countOffset + 4, 261, "overlong name refused" },
+		};
+		for (const Corruption& corruption : corruptions)
+		{
+			std::vector<char> corrupt(bytes);
+			PutValue(corrupt, corruption.offset, corruption.value);
+			WriteBytes(path, corrupt, corrupt.size());
+			ok &= Check(!loaded.Load(path) && loaded.Empty() && loaded.texturePath.empty(), corruption.what);
+		}
+
+		// Fewer slices than names is only trailing bytes, and still reads the ones it counts
+		std::vector<char> fewer(bytes);
+		PutValue(fewer, countOffset, 3);
+		WriteBytes(path, fewer, fewer.size());
+		ok &= Check(loaded.Load(path) && loaded.GetCount() == 3 && loaded.Find("tile.dds") == 2 && loaded.Find("space.dds") == -1,
+			"fewer slices read");
+
+		std::remove(path);
+		ok &= Check(!loaded.Load(path) && loaded.Empty(), "missing file refused");
+		return ok;
+	}
+
+	// The table PackMaterials wrote, against the textures the game loads and the array next to it
+	bool CheckPacked(const std::string& path)
+	{
+		bool ok = true;
+		MaterialTable table;
+		if (!Check(table.Load(path), "table loads"))
+		{
+			return false;
+		}
+
+		// As Game::CreateDeviceDependentResources loads them
+		const char* sceneTextures[] =
+		{
+			"GRASS.dds", "stone.dds", "cobble.dds", "white.dds", "sky.dds", "planet1.dds", "planet2.dds", "planet3.dds",
+			"planet4.dds", "wallpaper.dds", "wood.dds", "t.dds", "space.dds", "tile.dds", "tree.dds"
+		};
+		uint32_t found = 0;
+		for (uint32_t slice = 0; slice < table.GetCount(); ++slice)
+		{
+			const std::string& name = table.GetName(slice);
+			bool known = false;
+			for (const char* texture : sceneTextures)
+			{
+				known |= name == texture;
+			}
+			ok &= Check(known && table.Find(name) == int(slice), "each slice a scene texture, found again");
+		}
+		for (const char* texture : sceneTextures)
+		{
+			found += table.Find(texture) >= 0;
+		}
+		ok &= Check(found == table.GetCount(), "every slice reached from a scene texture");
+
+		size_t slash = path.find_last_of("/\\");
+		std::string arrayPath = (slash == std::string::npos ? std::string() : path.substr(0, slash + 1)) + table.texturePath;
+		std::vector<char> header;
+		DDS::TextureInfo info;
+		ok &= Check(!table.texturePath.empty() && ReadBytes(arrayPath, header) && DDS::ReadInfo(header.data(), header.size(), info),
+			"array next to the table");
+		ok &= Check(ok && info.arraySize >= table.GetCount() && !info.cube && info.depth == 1, "a slice in the array for every name");
+		if (ok)
+		{
+			std::printf("%s: %u slices of %ux%u in %s\n", path.c_str(), table.GetCount(), info.width, info.height, arrayPath.c_str());
+		}
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			options.table = arg;
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-runs"))		options.runs = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.runs <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (!CheckBuild() || !CheckFile() || (!options.table.empty() && !CheckPacked(options.table)))
+	{
+		return 1;
+	}
+	std::printf("material table built, saved and looked up\n");
+
+	MaterialTable table;
+	std::vector<std::string> paths;
+	for (uint32_t slice = 0; slice < 2048; ++slice)
+	{
+		std::string name = "texture" + std::to_string(slice) + ".dds";
+		table.Add(name);
+		paths.push_back("scene/textures/" + name);
+	}
+	long long sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int run = 0; run < options.runs; ++run)
+	{
+		sum += table.Find(paths[(run * 7919u) % 2048]);
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / options.runs;
+	std::printf("  2048 slices: %.0f ns a lookup (%lld)\n", ns, sum / options.runs);
+	return 0;
+}
@@ -0,0 +1,165 @@
+//
+// BenchMeshLoad - times opening an SDKMESH by copying it into memory against mapping it, see SdkMeshFile.h
+//
+// Prints what the file holds, then times reading the whole file into a heap buffer before parsing, as DirectXTK's
+// loader does with a path, against mapping it and validating the tables, which only pages in the headers. Each is
+// timed again with every vertex and index buffer copied out once the way CreateBuffer copies its initial data, which
+// from the mapping is the only copy. The file is in the OS cache after the first run, so this is the warm case. Needs
+// nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BenchMeshLoad.cpp SdkMeshFile.cpp VertexFormat.cpp MappedFile.cpp Rig.cpp -o BenchMeshLoad
+//	./BenchMeshLoad tank.sdkmesh -runs 200
+//
+
+#include "SdkMeshFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::string	input = "tank.sdkmesh";
+		int			runs = 200;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchMeshLoad [mesh.sdkmesh] [options]\n"
+			"  -runs <n>    times each way is timed (default 200)\n");
+	}
+
+	// Every vertex and index buffer copied out once, as CreateBuffer copies its initial data
+	bool CopyBuffers(const SdkMeshFile& mesh, std::vector<uint8_t>& staging)
+	{
+		for (uint32_t i = 0; i < mesh.GetHeader().numVertexBuffers; ++i)
+		{
+			const SdkMeshVertexBuffer* buffer = mesh.GetVertexBuffer(i);
+			staging.resize(std::max(staging.size(), buffer->size));
+			std::memcpy(staging.data(), buffer->data, buffer->size);
+		}
+		for (uint32_t i = 0; i < mesh.GetHeader().numIndexBuffers; ++i)
+		{
+			const SdkMeshIndexBuffer* buffer = mesh.GetIndexBuffer(i);
+			staging.resize(std::max(staging.size(), buffer->size));
+			std::memcpy(staging.data(), buffer->data, buffer->size);
+		}
+		return true;
+	}
+
+	template<typename Fn>
+	double MicrosecondsPerRun(int runs, Fn load)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; ++run)
+		{
+			if (!load())
+			{
+				return -1.0;
+			}
+		}
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			options.input = arg;
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-runs"))		options.runs = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.runs <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	SdkMeshFile mesh;
+	if (!mesh.Open(options.input))
+	{
+		std::fprintf(stderr, "%s isn't a valid SDKMESH\n", options.input.c_str());
+		return 1;
+	}
+
+	const SdkMesh::Header& header = mesh.GetHeader();
+	std::printf("%s: %zu bytes, %u meshes, %u subsets, %u frames, %u materials\n", options.input.c_str(), mesh.GetSize(),
+		header.numMeshes, header.numTotalSubsets, header.numFrames, header.numMaterials);
+	for (uint32_t i = 0; i < header.numVertexBuffers; ++i)
+	{
+		const SdkMeshVertexBuffer* buffer = mesh.GetVertexBuffer(i);
+		std::printf("  vb %2u %6u vertices, stride %2u, %zu elements\n", i, buffer->vertexCount, buffer->stride, buffer->format.GetElements().size());
+	}
+	for (uint32_t i = 0; i < header.numIndexBuffers; ++i)
+	{
+		const SdkMeshIndexBuffer* buffer = mesh.GetIndexBuffer(i);
+		std::printf("  ib %2u %6u indices, %u bytes each\n", i, buffer->indexCount, buffer->indexSize);
+	}
+	for (uint32_t i = 0; i < mesh.GetMeshCount(); ++i)
+	{
+		const SdkMesh::Mesh* part = mesh.GetMesh(i);
+		std::printf("  mesh %2u %-24s vb %u ib %u, %u subsets\n", i, SdkMesh::GetString(part->name).c_str(), part->vertexBuffers[0],
+			part->indexBuffer, part->numSubsets);
+	}
+	mesh.Close();
+
+	std::vector<uint8_t> staging;
+	double times[2][2];
+	for (int upload = 0; upload < 2; ++upload)
+	{
+		times[0][upload] = MicrosecondsPerRun(options.runs, [&]()
+		{
+			// Sized from the end and read in one go, like BinaryReader::ReadEntireFile
+			std::ifstream file(options.input, std::ios::binary | std::ios::ate);
+			std::vector<char> data(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			SdkMeshFile parsed;
+			return file.read(data.data(), data.size()) && parsed.Parse(data.data(), data.size()) && (!upload || CopyBuffers(parsed, staging));
+		});
+		times[1][upload] = MicrosecondsPerRun(options.runs, [&]()
+		{
+			SdkMeshFile opened;
+			return opened.Open(options.input) && (!upload || CopyBuffers(opened, staging));
+		});
+		if (times[0][upload] < 0.0 || times[1][upload] < 0.0)
+		{
+			std::fprintf(stderr, "%s changed while timing\n", options.input.c_str());
+			return 1;
+		}
+	}
+
+	std::printf("  read into memory, parse   %9.1f us   with the buffers copied out %9.1f us\n", times[0][0], times[0][1]);
+	std::printf("  map, validate             %9.1f us   with the buffers copied out %9.1f us   %.1fx and %.1fx faster\n",
+		times[1][0], times[1][1], times[0][0] / times[1][0], times[0][1] / times[1][1]);
+	return 0;
+}
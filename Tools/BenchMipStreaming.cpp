@@ -0,0 +1,503 @@
+//
+// BenchMipStreaming - simulates the mip streaming budget with a moving camera, see MipStreaming.h
+//
+// A few desired levels are checked against the texel to pixel ratio worked out by hand. Then objects scattered over
+// a plane ask for their textures' levels while the camera circles over them; loads land one to three frames after
+// they are planned and some of them fail. The simulation keeps its own copy of which level each texture holds and
+// checks every frame that:
+//	- the bytes resident and committed (resident plus loads in flight) match it and never exceed the budget
+//	- loads are only for textures in use this frame, one at a time each, no more than asked for, to finer top levels
+//	- textures in use this frame only ever give up levels finer than they want
+//	- textures the camera left go back to their tail in least recently used order: none that keeps finer levels was
+//	  last used before one that was sent back
+// The camera goes round three times, the second time on a budget lowered below what is resident, and everything
+// off screen must fall back to its tail until it fits. Every lap must load levels and the lowered one evict them,
+// however many frames are timed. With the camera still and room for everything every texture must end at the level
+// it wants or finer, as finer levels are only given up when the space is needed. Last, planning is timed for a larger
+// scene.
+// Needs nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BenchMipStreaming.cpp MipStreaming.cpp DDSFile.cpp -o BenchMipStreaming
+//	./BenchMipStreaming -frames 3000 -textures 1000 -objects 5000
+//
+
+#include "MipStreaming.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t c_FormatRGBA8 = 28;		//DXGI_FORMAT_R8G8B8A8_UNORM
+	constexpr uint32_t c_FormatBC1 = 71;		//DXGI_FORMAT_BC1_UNORM
+	constexpr uint32_t c_FormatBC3 = 77;		//DXGI_FORMAT_BC3_UNORM
+	constexpr uint64_t c_KeepFrames = 30;		//as MipStreaming.cpp
+	constexpr int c_LapFrames = 629;			//once round at the camera's 0.01 radians a frame
+	constexpr float c_PixelsPerUnit = 1000.0f;
+
+	struct Options
+	{
+		int		frames = 3000;
+		int		textures = 1000;
+		int		objects = 5000;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchMipStreaming [options]\n"
+			"  -frames <n>      frames planned when timing (default 3000)\n"
+			"  -textures <n>    textures in the timed scene (default 1000)\n"
+			"  -objects <n>     objects in the timed scene (default 5000)\n");
+	}
+
+	bool Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s\n", what);
+		}
+		return condition;
+	}
+
+	uint32_t LevelSize(uint32_t size, uint32_t mip)
+	{
+		return std::max(1u, size >> mip);
+	}
+
+	uint32_t FullMipCount(uint32_t width, uint32_t height)
+	{
+		uint32_t count = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+		{
+			++count;
+		}
+		return count;
+	}
+
+	DDS::TextureInfo MakeInfo(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t format, bool cube = false)
+	{
+		DDS::TextureInfo info = {};
+		info.width = width;
+		info.height = height;
+		info.depth = 1;
+		info.mipCount = mipCount;
+		info.arraySize = cube ? 6 : 1;
+		info.format = format;
+		info.cube = cube;
+		return info;
+	}
+
+	bool CheckDesiredMip()
+	{
+		bool ok = true;
+		// 1024 texels across an object 1024 pixels wide is one texel a pixel
+		ok &= Check(MipStreaming::ComputeDesiredMip(1024, 1.0f, 0.5f, 1.0f, 1024.0f) == 0.0f, "one texel a pixel");
+		ok &= Check(std::fabs(MipStreaming::ComputeDesiredMip(1024, 1.0f, 0.5f, 4.0f, 1024.0f) - 2.0f) < 1e-5f, "four times as far");
+		ok &= Check(std::fabs(MipStreaming::ComputeDesiredMip(1024, 2.0f, 0.5f, 4.0f, 1024.0f) - 3.0f) < 1e-5f, "wrapped twice");
+		ok &= Check(MipStreaming::ComputeDesiredMip(1024, 1.0f, 0.5f, 0.0f, 1024.0f) == 0.0f, "close up clamped to level 0");
+		ok &= Check(MipStreaming::ComputeDesiredMip(1024, 1.0f, 0.0f, 1.0f, 1024.0f) >= 31.0f, "nothing on screen");
+
+		DDS::TextureInfo info = MakeInfo(1024, 256, 11, c_FormatBC1);
+		ok &= Check(MipStreaming::IsStreamable(info) && MipStreaming::GetTailMip(info) == 4, "tail of a wide texture");
+		ok &= Check(MipStreaming::CanBeTopMip(info, 6) && !MipStreaming::CanBeTopMip(info, 7), "whole blocks at the top");
+		ok &= Check(!MipStreaming::IsStreamable(MakeInfo(256, 256, 9, c_FormatRGBA8, true)), "cube maps come whole");
+		ok &= Check(!MipStreaming::IsStreamable(MakeInfo(256, 256, 1, c_FormatRGBA8)), "single levels come whole");
+		return ok;
+	}
+
+	// What MipBudget should be holding for one texture, kept from outside through the changes it hands out
+	struct Model
+	{
+		DDS::TextureInfo		info;
+		bool					streamable = false;
+		uint32_t				tailMip = 0;
+		uint32_t				resident = 0;
+		uint32_t				loading = 0xffffffff;
+		uint64_t				lastUsed = 0;
+		float					desired = 0.0f;
+		std::vector<size_t>		bytesFrom;
+
+		void Init(const DDS::TextureInfo& textureInfo)
+		{
+			info = textureInfo;
+			streamable = MipStreaming::IsStreamable(info);
+			uint32_t levels = streamable ? info.mipCount : 1;
+			tailMip = streamable ? MipStreaming::GetTailMip(info) : 0;
+			resident = tailMip;
+			bytesFrom.assign(levels + 1, 0);
+			for (uint32_t mip = levels; mip-- > 0;)
+			{
+				bytesFrom[mip] = bytesFrom[mip + 1] + (streamable
+					? DDS::GetSurfaceSize(info.format, LevelSize(info.width, mip), LevelSize(info.height, mip)) : DDS::GetTextureSize(info));
+			}
+		}
+
+		// The finest level worth keeping in frame, as MipBudget works it out
+		uint32_t Target(uint64_t frame) const
+		{
+			if (!lastUsed || lastUsed + c_KeepFrames < frame)
+			{
+				return tailMip;
+			}
+			float mip = std::max(desired, 0.0f);
+			uint32_t target = mip >= float(tailMip) ? tailMip : static_cast<uint32_t>(mip);
+			while (target > 0 && !MipStreaming::CanBeTopMip(info, target))
+			{
+				--target;
+			}
+			return target;
+		}
+
+		size_t Committed() const { return bytesFrom[loading != 0xffffffff ? std::min(loading, resident) : resident]; }
+	};
+
+	struct Object
+	{
+		float		position[2];
+		float		radius;
+		float		uvRepeat;
+		uint32_t	texture;
+	};
+
+	struct Load
+	{
+		uint32_t	texture;
+		uint32_t	mip;
+		uint64_t	due;
+	};
+
+	struct Scene
+	{
+		std::vector<Model>		models;
+		std::vector<Object>		objects;
+		MipBudget				budget;
+		std::vector<Load>		inFlight;
+		std::vector<MipChange>	loads;
+		std::vector<MipChange>	drops;
+		size_t					tailBytes = 0;
+
+		void Build(std::mt19937& random, int textureCount, int objectCount)
+		{
+			const uint32_t sizes[] = { 128, 256, 512, 1024, 2048 };
+			const uint32_t formats[] = { c_FormatRGBA8, c_FormatBC1, c_FormatBC3 };
+			models.resize(textureCount);
+			for (int i = 0; i < textureCount; ++i)
+			{
+				uint32_t width = sizes[random() % 5], height = random() % 4 ? width : LevelSize(width, 2);
+				DDS::TextureInfo info = i % 50 == 7 ? MakeInfo(256, 256, 9, c_FormatRGBA8, true)
+					: i % 50 == 19 ? MakeInfo(width, height, 1, formats[random() % 3])
+					: MakeInfo(width, height, FullMipCount(width, height), formats[random() % 3]);
+				models[i].Init(info);
+				budget.Add(uint32_t(i), info, models[i].resident);
+				tailBytes += models[i].bytesFrom[models[i].resident];
+			}
+
+			std::uniform_real_distribution<float> across(-100.0f, 100.0f), radius(0.5f, 5.0f), repeat(1.0f, 4.0f);
+			objects.resize(objectCount);
+			for (Object& object : objects)
+			{
+				object.position[0] = across(random);
+				object.position[1] = across(random);
+				object.radius = radius(random);
+				object.uvRepeat = repeat(random);
+				object.texture = uint32_t(random() % textureCount);
+			}
+		}
+
+		// Objects within 60 units of the camera and in front of it ask for their levels
+		void UseVisible(const float camera[2], const float forward[2])
+		{
+			uint64_t frame = budget.GetFrame();
+			for (const Object& object : objects)
+			{
+				float dx = object.position[0] - camera[0], dy = object.position[1] - camera[1];
+				float distance = std::sqrt(dx * dx + dy * dy);
+				if (distance > 60.0f || dx * forward[0] + dy * forward[1] < -object.radius)
+				{
+					continue;
+				}
+				Model& model = models[object.texture];
+				uint32_t size = std::max(model.info.width, model.info.height);
+				float mip = MipStreaming::ComputeDesiredMip(size, object.uvRepeat, object.radius, distance, c_PixelsPerUnit);
+				budget.Use(object.texture, mip);
+				model.desired = model.lastUsed == frame ? std::min(model.desired, mip) : mip;
+				model.lastUsed = frame;
+			}
+		}
+
+		size_t ResidentBytes() const
+		{
+			size_t bytes = 0;
+			for (const Model& model : models)
+			{
+				bytes += model.bytesFrom[model.resident];
+			}
+			return bytes;
+		}
+
+		size_t CommittedBytes() const
+		{
+			size_t bytes = 0;
+			for (const Model& model : models)
+			{
+				bytes += model.Committed();
+			}
+			return bytes;
+		}
+
+		// Plans the frame and checks the plan against the model. False on the first broken rule.
+		bool Plan(uint32_t maxLoads)
+		{
+			uint64_t frame = budget.GetFrame();
+			std::vector<uint32_t> before(models.size());
+			for (size_t i = 0; i < models.size(); ++i)
+			{
+				before[i] = models[i].resident;
+			}
+			budget.Plan(loads, drops, maxLoads);
+			bool ok = Check(budget.GetFrame() == frame + 1, "one frame a plan");
+
+			std::vector<bool> dropped(models.size(), false);
+			for (const MipChange& drop : drops)
+			{
+				Model& model = models[drop.texture];
+				ok &= Check(drop.mip > model.resident && drop.mip <= model.tailMip && model.loading == 0xffffffff,
+					"drops only give up levels and never under a load");
+				if (model.lastUsed == frame)
+				{
+					ok &= Check(drop.mip == model.Target(frame), "textures in use keep the levels they want");
+				}
+				model.resident = drop.mip;
+				dropped[drop.texture] = true;
+			}
+
+			ok &= Check(loads.size() <= maxLoads, "no more loads than asked for");
+			for (const MipChange& load : loads)
+			{
+				Model& model = models[load.texture];
+				ok &= Check(model.lastUsed == frame && model.loading == 0xffffffff && load.mip < model.resident
+					&& load.mip >= model.Target(frame) && MipStreaming::CanBeTopMip(model.info, load.mip),
+					"loads for textures in use, to finer top levels they want");
+				model.loading = load.mip;
+			}
+
+			// Least recently used first: nothing off screen that could still have given up levels is older than a
+			// texture that did
+			uint64_t newestDropped = 0;
+			for (size_t i = 0; i < models.size(); ++i)
+			{
+				if (dropped[i] && models[i].lastUsed != frame)
+				{
+					newestDropped = std::max(newestDropped, models[i].lastUsed);
+				}
+			}
+			for (size_t i = 0; i < models.size() && newestDropped; ++i)
+			{
+				const Model& model = models[i];
+				if (model.lastUsed != frame && model.loading == 0xffffffff && model.resident < model.tailMip)
+				{
+					ok &= Check(model.lastUsed >= newestDropped, "evicted in least recently used order");
+				}
+			}
+
+			ok &= Check(budget.GetResidentBytes() == ResidentBytes() && budget.GetCommittedBytes() == CommittedBytes(),
+				"resident and committed bytes as modelled");
+			return ok;
+		}
+
+		// Loads due by this frame (or all of them) land, with failOneIn one in that many failing and keeping what the
+		// texture had
+		void Land(std::mt19937& random, bool all, uint32_t failOneIn)
+		{
+			for (size_t i = 0; i < inFlight.size();)
+			{
+				const Load& load = inFlight[i];
+				if (!all && load.due > budget.GetFrame())
+				{
+					++i;
+					continue;
+				}
+				Model& model = models[load.texture];
+				if (failOneIn && random() % failOneIn == 0)
+				{
+					budget.CancelLoad(load.texture);
+				}
+				else
+				{
+					budget.SetResident(load.texture, load.mip);
+					model.resident = load.mip;
+				}
+				model.loading = 0xffffffff;
+				inFlight[i] = inFlight.back();
+				inFlight.pop_back();
+			}
+		}
+
+		void Start(std::mt19937& random)
+		{
+			for (const MipChange& load : loads)
+			{
+				inFlight.push_back({ load.texture, load.mip, budget.GetFrame() + random() % 3 });
+			}
+		}
+	};
+
+	void Camera(int frame, float camera[2], float forward[2])
+	{
+		float angle = float(frame) * 0.01f;
+		camera[0] = 70.0f * std::cos(angle);
+		camera[1] = 70.0f * std::sin(angle);
+		forward[0] = -std::sin(angle);
+		forward[1] = std::cos(angle);
+	}
+
+	bool CheckSimulation()
+	{
+		std::mt19937 random(35);
+		Scene scene;
+		scene.Build(random, 120, 600);
+		size_t roomy = scene.tailBytes + 48 * 1024 * 1024;
+		size_t tight = scene.tailBytes + 6 * 1024 * 1024;
+		scene.budget.SetBudget(roomy);
+
+		bool ok = Check(scene.budget.GetResidentBytes() == scene.tailBytes, "tails resident to start with");
+		uint32_t loaded[3] = {}, evicted[3] = {};
+		// Over budget is only allowed from the cut until the plans first bring it back under
+		bool fits = true;
+		for (int frame = 0; frame < 3 * c_LapFrames && ok; ++frame)
+		{
+			// The middle lap runs on a budget well under what the camera wants
+			int lap = frame / c_LapFrames;
+			if (frame % c_LapFrames == 0 && lap > 0)
+			{
+				scene.budget.SetBudget(lap == 1 ? tight : roomy);
+				fits = lap != 1;
+			}
+
+			float camera[2], forward[2];
+			Camera(frame, camera, forward);
+			scene.Land(random, false, 16);
+			ok &= Check(!fits || scene.CommittedBytes() <= scene.budget.GetBudget(), "landed loads within budget");
+			scene.UseVisible(camera, forward);
+			uint64_t planned = scene.budget.GetFrame();
+			ok &= scene.Plan(1 + random() % 8);
+			scene.Start(random);
+			loaded[lap] += uint32_t(scene.loads.size());
+			evicted[lap] += uint32_t(scene.drops.size());
+
+			if (scene.CommittedBytes() <= scene.budget.GetBudget())
+			{
+				fits = true;
+				continue;
+			}
+			ok &= Check(!fits, "planned within budget");
+			// and then only because what is on screen holds more than it
+			for (const Model& model : scene.models)
+			{
+				ok &= Check(model.lastUsed == planned || model.loading != 0xffffffff || model.resident == model.tailMip,
+					"over budget only with everything off screen back at its tail");
+			}
+		}
+		ok &= Check(loaded[0] > 100 && loaded[1] > 100 && loaded[2] > 100, "every lap loads");
+		ok &= Check(evicted[1] > 100, "the lowered budget evicts");
+
+		// Standing still with room for everything, each texture on screen settles at the level it wants
+		scene.budget.SetBudget(size_t(1) << 40);
+		float camera[2], forward[2];
+		Camera(3 * c_LapFrames, camera, forward);
+		for (int frame = 0; frame < 200 && ok; ++frame)
+		{
+			scene.Land(random, true, 16);
+			scene.UseVisible(camera, forward);
+			ok &= scene.Plan(8);
+			scene.Start(random);
+		}
+		scene.Land(random, true, 0);
+		uint32_t onScreen = 0;
+		for (const Model& model : scene.models)
+		{
+			if (model.lastUsed + 1 == scene.budget.GetFrame())
+			{
+				++onScreen;
+				ok &= Check(model.resident <= model.Target(model.lastUsed), "settled at the wanted level or finer");
+			}
+		}
+		ok &= Check(onScreen > 10, "something on screen");
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-frames"))			options.frames = std::atoi(value);
+		else if (!std::strcmp(arg, "-textures"))	options.textures = std::atoi(value);
+		else if (!std::strcmp(arg, "-objects"))		options.objects = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.frames <= 0 || options.textures <= 0 || options.objects <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (!CheckDesiredMip() || !CheckSimulation())
+	{
+		return 1;
+	}
+	std::printf("mip levels streamed within budget\n");
+
+	std::mt19937 random(35);
+	Scene scene;
+	scene.Build(random, options.textures, options.objects);
+	scene.budget.SetBudget(scene.tailBytes + 128 * 1024 * 1024);
+	double planUs = 0.0;
+	size_t changes = 0;
+	for (int frame = 0; frame < options.frames; ++frame)
+	{
+		float camera[2], forward[2];
+		Camera(frame, camera, forward);
+		scene.Land(random, false, 16);
+		scene.UseVisible(camera, forward);
+		auto start = std::chrono::steady_clock::now();
+		scene.budget.Plan(scene.loads, scene.drops, 8);
+		planUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		changes += scene.loads.size() + scene.drops.size();
+		for (const MipChange& drop : scene.drops)
+		{
+			scene.models[drop.texture].resident = drop.mip;
+		}
+		for (const MipChange& load : scene.loads)
+		{
+			scene.models[load.texture].loading = load.mip;
+		}
+		scene.Start(random);
+	}
+	std::printf("  %d textures, %d objects: %.1f us a plan, %.2f changes a frame\n", options.textures, options.objects,
+		planUs / options.frames, double(changes) / options.frames);
+	return 0;
+}
@@ -0,0 +1,309 @@
+//
+// BenchRig - checks the rig's name lookup and .rig file, see Rig.h
+//
+// Names must be found whatever their case, and near misses (a character short or over, another bone's name with a
+// suffix) must not be. A name given twice, in any case, finds the first bone. Names picked so they all hash to the
+// last slot of the table must wrap around to its start and still be found, and a miss hashing there must stop at the
+// first empty slot. Set must refuse parents out of range. Serialize and Deserialize must round trip names as given,
+// parents and bind transforms, and every truncated copy, a trailing byte, a wrong magic or version, too many bones
+// and an overlong name must be refused with the rig left empty. A .rig file given on the command line (the
+// repository's tank.rig) must load, find every bone by its own name and serialize back to the same bytes. Last, Find
+// is timed on a large rig. Needs nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BenchRig.cpp Rig.cpp -o BenchRig
+//	./BenchRig tank.rig -runs 1000000
+//
+
+#include "Hash.h"
+#include "Rig.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::string		rig;
+		int				runs = 1000000;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchRig [file.rig] [options]\n"
+			"  -runs <n>    lookups timed (default 1000000)\n");
+	}
+
+	bool Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s\n", what);
+		}
+		return condition;
+	}
+
+	// Parents as a chain from bone 0 and a bind transform per bone holding its index, so mix ups show
+	bool MakeRig(Rig& rig, const std::vector<std::string>& names)
+	{
+		std::vector<uint32_t> parents(names.size());
+		std::vector<float> bind(names.size() * 16);
+		for (size_t bone = 0; bone < names.size(); ++bone)
+		{
+			parents[bone] = bone ? static_cast<uint32_t>(bone - 1) : Rig::c_NoBone;
+			for (int i = 0; i < 16; ++i)
+			{
+				bind[bone * 16 + i] = float(bone) + float(i) / 16.0f;
+			}
+		}
+		return rig.Set(names, parents.data(), bind.data(), names.size());
+	}
+
+	bool CheckFind()
+	{
+		bool ok = true;
+		Rig rig;
+		ok &= Check(rig.Empty() && rig.Find("turret") == Rig::c_NoBone, "empty rig finds nothing");
+
+		const std::vector<std::string> names = { "tank_geom", "l_back_wheel_geom", "Turret_Geom", "canon_geom", "HATCH_GEOM", "turret_geom2" };
+		ok &= Check(MakeRig(rig, names) && rig.GetCount() == 6, "rig set");
+		for (uint32_t bone = 0; bone < names.size(); ++bone)
+		{
+			ok &= Check(rig.Find(names[bone]) == bone, "each name finds its bone");
+		}
+		ok &= Check(rig.Find("turret_geom") == 2 && rig.Find("TURRET_GEOM") == 2 && rig.Find("tUrReT_gEoM") == 2
+			&& rig.Find("hatch_geom") == 4, "case folded hits");
+		ok &= Check(rig.GetName(2) == "Turret_Geom", "names kept as given");
+		ok &= Check(rig.Find("turret_geo") == Rig::c_NoBone && rig.Find("turret_geom_") == Rig::c_NoBone
+			&& rig.Find("turret_geom3") == Rig::c_NoBone && rig.Find("") == Rig::c_NoBone && rig.Find(" turret_geom") == Rig::c_NoBone,
+			"near misses");
+
+		// The first of a repeated name, whatever case either was given in
+		ok &= Check(MakeRig(rig, { "root", "Wheel", "hub", "WHEEL", "wheel" }) && rig.Find("wheel") == 1 && rig.Find("WHEEL") == 1,
+			"a repeated name finds the first bone");
+		ok &= Check(rig.GetCount() == 5 && rig.GetName(3) == "WHEEL", "repeated bones still there");
+
+		// Parents out of range are refused and leave nothing behind
+		const uint32_t badParents[] = { Rig::c_NoBone, 2 };
+		const float bind[32] = {};
+		ok &= Check(!rig.Set({ "a", "b" }, badParents, bind, 2) && rig.Empty() && rig.Find("a") == Rig::c_NoBone, "parent out of range");
+		ok &= Check(!rig.Set({ "a" }, badParents, bind, 2) && rig.Empty(), "name count differs");
+		const uint32_t selfParents[] = { Rig::c_NoBone, 1 };
+		ok &= Check(rig.Set({ "a", "b" }, selfParents, bind, 2) && rig.GetParents()[1] == 1, "in range parents accepted");
+
+		rig.Clear();
+		ok &= Check(rig.Empty() && rig.Find("a") == Rig::c_NoBone, "cleared");
+		return ok;
+	}
+
+	// Names whose hash lands on the last slot of a table of slotCount, which must wrap to slot 0 on a collision
+	std::vector<std::string> NamesOnLastSlot(size_t slotCount, size_t count)
+	{
+		std::vector<std::string> names;
+		for (uint32_t i = 0; names.size() < count; ++i)
+		{
+			std::string name = "bone" + std::to_string(i);
+			if ((Hash::Fnv1a(name.data(), name.size()) & (slotCount - 1)) == slotCount - 1)
+			{
+				names.push_back(name);
+			}
+		}
+		return names;
+	}
+
+	bool CheckWrap()
+	{
+		bool ok = true;
+		// Three bones take a table of eight slots: the three land on 7, 0 and 1, the miss probes on to the empty 2
+		std::vector<std::string> names = NamesOnLastSlot(8, 4);
+		std::string miss = names.back();
+		names.pop_back();
+		Rig rig;
+		ok &= Check(MakeRig(rig, names), "colliding rig set");
+		for (uint32_t bone = 0; bone < names.size(); ++bone)
+		{
+			ok &= Check(rig.Find(names[bone]) == bone && rig.Find(Rig::FoldName(names[bone])) == bone, "found past the end of the table");
+		}
+		ok &= Check(rig.Find(miss) == Rig::c_NoBone, "colliding miss stops at an empty slot");
+
+		// And a half full table of them, every probe but the last running off the end
+		names = NamesOnLastSlot(16, 8);
+		ok &= Check(MakeRig(rig, names), "half full rig set");
+		for (uint32_t bone = 0; bone < names.size(); ++bone)
+		{
+			ok &= Check(rig.Find(names[bone]) == bone, "half full table found");
+		}
+		ok &= Check(rig.Find(NamesOnLastSlot(16, 9).back()) == Rig::c_NoBone, "half full miss");
+		return ok;
+	}
+
+	bool SameRig(const Rig& a, const Rig& b)
+	{
+		return a.GetCount() == b.GetCount() && a.GetNames() == b.GetNames()
+			&& std::memcmp(a.GetParents(), b.GetParents(), a.GetCount() * sizeof(uint32_t)) == 0
+			&& std::memcmp(a.GetBind(), b.GetBind(), a.GetCount() * 16 * sizeof(float)) == 0;
+	}
+
+	void PutValue(std::vector<uint8_t>& bytes, size_t offset, uint32_t value)
+	{
+		std::memcpy(&bytes[offset], &value, sizeof(value));
+	}
+
+	bool CheckSerialize()
+	{
+		bool ok = true;
+		Rig rig, loaded;
+		ok &= Check(MakeRig(rig, { "Root", "Body", "Turret", "Gun", "body" }), "rig set");
+		std::vector<uint8_t> bytes;
+		rig.Serialize(bytes);
+		ok &= Check(loaded.Deserialize(bytes.data(), bytes.size()) && SameRig(rig, loaded), "round trip");
+		ok &= Check(loaded.Find("turret") == 2 && loaded.Find("BODY") == 1, "table rebuilt on load");
+
+		Rig empty;
+		std::vector<uint8_t> none;
+		empty.Serialize(none);
+		ok &= Check(none.size() == 12 && loaded.Deserialize(none.data(), none.size()) && loaded.Empty(), "empty rig round trip");
+
+		// Every cut and a trailing byte are refused, and leave the rig empty
+		bool refused = true;
+		for (size_t size = 0; size < bytes.size(); ++size)
+		{
+			std::vector<uint8_t> cut(bytes.begin(), bytes.begin() + size);
+			refused &= !loaded.Deserialize(cut.data(), cut.size()) && loaded.Empty();
+		}
+		ok &= Check(refused, "truncated rigs refused");
+		std::vector<uint8_t> longer(bytes);
+		longer.push_back(0);
+		ok &= Check(!loaded.Deserialize(longer.data(), longer.size()) && loaded.Empty(), "trailing byte refused");
+
+		// magic, version, count, then the first name's length and "Root" and its parent
+		struct Corruption
+		{
+			size_t		offset;
+			uint32_t	value;
+			const char*	what;
+		};
+		const Corruption corruptions[] =
+		{
+			{ 0, 0x20474953, "wrong magic refused" },
+			{ 4, 2, "wrong version refused" },
+			{ 8, 65537, "too many bones refused" },
+			{ 8, 6, "more bones than written refused" },
+			{ 8, 4, "fewer bones than written refused" },
+			{ 12, 261, "overlong name refused" },
+			{ 12, 0xffffffff, "wrapping name length refused" },
+			{ 20, 5, "parent out of range refused" },
+		};
+		for (const Corruption& corruption : corruptions)
+		{
+			std::vector<uint8_t> corrupt(bytes);
+			PutValue(corrupt, corruption.offset, corruption.value);
+			ok &= Check(!loaded.Deserialize(corrupt.data(), corrupt.size()) && loaded.Empty(), corruption.what);
+		}
+
+		const char* path = "BenchRig.rig";
+		ok &= Check(rig.Save(path) && loaded.Load(path) && SameRig(rig, loaded), "file round trip");
+		std::remove(path);
+		ok &= Check(!loaded.Load(path) && loaded.Empty(), "missing file refused");
+		return ok;
+	}
+
+	// A rig BakeRig wrote: every bone found by its own name (or the first of that name) and written back the same
+	bool CheckFile(const std::string& path)
+	{
+		bool ok = true;
+		Rig rig;
+		if (!Check(rig.Load(path), "rig file loads"))
+		{
+			return false;
+		}
+		for (uint32_t bone = 0; bone < rig.GetCount(); ++bone)
+		{
+			uint32_t found = rig.Find(rig.GetName(bone));
+			ok &= Check(found <= bone && Rig::FoldName(rig.GetName(found)) == Rig::FoldName(rig.GetName(bone)), "every bone found by name");
+			ok &= Check(rig.GetParents()[bone] == Rig::c_NoBone || rig.GetParents()[bone] < rig.GetCount(), "parents in range");
+		}
+
+		std::ifstream file(path, std::ios::binary);
+		std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		std::vector<uint8_t> written;
+		rig.Serialize(written);
+		ok &= Check(written == bytes, "serialized back to the same bytes");
+		if (ok)
+		{
+			std::printf("%s: %zu bones\n", path.c_str(), rig.GetCount());
+		}
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			options.rig = arg;
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-runs"))		options.runs = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.runs <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (!CheckFind() || !CheckWrap() || !CheckSerialize() || (!options.rig.empty() && !CheckFile(options.rig)))
+	{
+		return 1;
+	}
+	std::printf("rig names found and rigs round tripped\n");
+
+	// Mixed case lookups, a quarter of them misses
+	std::vector<std::string> names, lookups;
+	for (int bone = 0; bone < 1024; ++bone)
+	{
+		names.push_back("Bone_" + std::to_string(bone) + "_Geom");
+	}
+	for (int i = 0; i < 4096; ++i)
+	{
+		lookups.push_back(i % 4 ? "BONE_" + std::to_string(i % 1024) + "_geom" : "missing_" + std::to_string(i));
+	}
+	Rig rig;
+	MakeRig(rig, names);
+	uint64_t found = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int run = 0; run < options.runs; ++run)
+	{
+		found += rig.Find(lookups[run & 4095]) != Rig::c_NoBone;
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / options.runs;
+	std::printf("  1024 bones: %.1f ns a lookup, %.0f%% found\n", ns, 100.0 * double(found) / options.runs);
+	return 0;
+}
@@ -0,0 +1,335 @@
+//
+// BenchShaderSignature - checks reading a vertex shader's input signature and matching it to a VertexFormat, see
+// VertexFormat.h
+//
+// light_vs.cso is compiled by the Windows build, so a container is put together here with the ISGN chunk fxc writes for
+// light_vs.hlsl: POSITION float4, TEXCOORD0 float2 and NORMAL float3, and TEXCOORD1 float2 as well when it's built
+// LIGHTMAPPED. Given the path of a compiled light_vs.cso it is read too and must agree. The signature's hash must be
+// the same each parse and across containers that only differ outside the signature chunk, ModelClass's formats must
+// match the inputs they feed and not the ones they don't, and a chunk whose element count would wrap the size check
+// must be turned down rather than read past. Then parsing is timed. Needs nothing from Windows, e.g. on Linux from the
+// repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BenchShaderSignature.cpp VertexFormat.cpp -o BenchShaderSignature
+//	./BenchShaderSignature [path/to/light_vs.cso] -runs 1000000
+//
+
+#include "VertexFormat.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::string	input;
+		int			runs = 1000000;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchShaderSignature [light_vs.cso] [options]\n"
+			"  -runs <n>    parses timed (default 1000000)\n");
+	}
+
+	// D3D_REGISTER_COMPONENT_TYPE
+	constexpr uint32_t c_UInt32 = 1;
+	constexpr uint32_t c_Float32 = 3;
+
+	struct Input
+	{
+		const char*	semantic;
+		uint32_t	semanticIndex;
+		uint32_t	componentType;
+		uint8_t		mask;
+	};
+
+	const Input c_LightInputs[] =
+	{
+		{ "POSITION", 0, c_Float32, 0xf },
+		{ "TEXCOORD", 0, c_Float32, 0x3 },
+		{ "NORMAL", 0, c_Float32, 0x7 },
+	};
+
+	const Input c_LightmappedInputs[] =
+	{
+		{ "POSITION", 0, c_Float32, 0xf },
+		{ "TEXCOORD", 0, c_Float32, 0x3 },
+		{ "NORMAL", 0, c_Float32, 0x7 },
+		{ "TEXCOORD", 1, c_Float32, 0x3 },
+	};
+
+	void Put32(std::vector<uint8_t>& out, uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			out.push_back(uint8_t(value >> (i * 8)));
+		}
+	}
+
+	void Set32(std::vector<uint8_t>& out, size_t offset, uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			out[offset + i] = uint8_t(value >> (i * 8));
+		}
+	}
+
+	// ISGN chunk data as fxc lays it out: count, 8, 24 byte elements, then the names each written once
+	std::vector<uint8_t> SignatureChunk(const Input* inputs, size_t count)
+	{
+		std::vector<uint8_t> data;
+		Put32(data, uint32_t(count));
+		Put32(data, 8);
+		std::vector<std::string> names;
+		std::vector<uint32_t> nameOffsets;
+		uint32_t nameOffset = uint32_t(8 + count * 24);
+		for (size_t i = 0; i < count; ++i)
+		{
+			size_t name = 0;
+			while (name < names.size() && names[name] != inputs[i].semantic)
+			{
+				++name;
+			}
+			if (name == names.size())
+			{
+				names.push_back(inputs[i].semantic);
+				nameOffsets.push_back(nameOffset);
+				nameOffset += uint32_t((names.back().size() + 4) & ~size_t(3));
+			}
+			Put32(data, nameOffsets[name]);
+			Put32(data, inputs[i].semanticIndex);
+			Put32(data, 0);
+			Put32(data, inputs[i].componentType);
+			Put32(data, uint32_t(i));
+			Put32(data, inputs[i].mask | inputs[i].mask << 8);
+		}
+		for (const std::string& name : names)
+		{
+			data.insert(data.end(), name.begin(), name.end());
+			data.resize((data.size() + 4) & ~size_t(3), 0);
+		}
+		return data;
+	}
+
+	// DXBC container of the given chunks, the checksum left zero as nothing here verifies it
+	std::vector<uint8_t> Container(const std::vector<std::pair<const char*, std::vector<uint8_t>>>& chunks)
+	{
+		std::vector<uint8_t> blob = { 'D', 'X', 'B', 'C' };
+		blob.resize(20, 0);
+		Put32(blob, 1);
+		Put32(blob, 0);
+		Put32(blob, uint32_t(chunks.size()));
+		size_t offsets = blob.size();
+		blob.resize(offsets + chunks.size() * 4, 0);
+		for (size_t i = 0; i < chunks.size(); ++i)
+		{
+			Set32(blob, offsets + i * 4, uint32_t(blob.size()));
+			blob.insert(blob.end(), chunks[i].first, chunks[i].first + 4);
+			Put32(blob, uint32_t(chunks[i].second.size()));
+			blob.insert(blob.end(), chunks[i].second.begin(), chunks[i].second.end());
+		}
+		Set32(blob, 24, uint32_t(blob.size()));
+		return blob;
+	}
+
+	bool Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s\n", what);
+		}
+		return condition;
+	}
+
+	bool Parse(const std::vector<uint8_t>& blob, ShaderInputSignature& signature)
+	{
+		return ParseShaderInputSignature(blob.data(), blob.size(), signature);
+	}
+
+	bool CheckSignature(const ShaderInputSignature& signature, const Input* inputs, size_t count)
+	{
+		if (signature.parameters.size() != count)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			const ShaderInputSignature::Parameter& parameter = signature.parameters[i];
+			if (parameter.semantic != inputs[i].semantic || parameter.semanticIndex != inputs[i].semanticIndex ||
+				parameter.systemValue != 0 || parameter.componentType != inputs[i].componentType || parameter.mask != inputs[i].mask)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// ModelClass::GetVertexFormat and GetLightmappedVertexFormat, which need Direct3D to include
+	VertexFormat ModelFormat()
+	{
+		return VertexFormat()
+			.Add("POSITION", 0, VertexElementFormat::Float3)
+			.Add("TEXCOORD", 0, VertexElementFormat::Float2)
+			.Add("NORMAL", 0, VertexElementFormat::Float3);
+	}
+
+	VertexFormat LightmappedFormat()
+	{
+		return VertexFormat(ModelFormat())
+			.Add("TEXCOORD", 1, VertexElementFormat::Float2, 1);
+	}
+
+	bool CheckSynthetic()
+	{
+		std::vector<uint8_t> light = SignatureChunk(c_LightInputs, std::size(c_LightInputs));
+		std::vector<uint8_t> lightmapped = SignatureChunk(c_LightmappedInputs, std::size(c_LightmappedInputs));
+		std::vector<uint8_t> code(64, 0x5a), otherCode(96, 0xa5);
+		std::vector<uint8_t> blob = Container({ { "RDEF", code }, { "ISGN", light }, { "SHDR", code } });
+		std::vector<uint8_t> otherBlob = Container({ { "SHDR", otherCode }, { "ISGN", light } });
+		std::vector<uint8_t> lightmappedBlob = Container({ { "RDEF", code }, { "ISGN", lightmapped }, { "SHDR", code } });
+
+		bool ok = true;
+		ShaderInputSignature signature, again, other, lightmappedSignature;
+		ok &= Check(Parse(blob, signature) && CheckSignature(signature, c_LightInputs, std::size(c_LightInputs)), "light_vs signature read");
+		ok &= Check(Parse(blob, again) && again.hash == signature.hash, "hash the same each parse");
+		ok &= Check(Parse(otherBlob, other) && other.hash == signature.hash, "hash the same in another container");
+		ok &= Check(Parse(lightmappedBlob, lightmappedSignature) && CheckSignature(lightmappedSignature, c_LightmappedInputs, std::size(c_LightmappedInputs)),
+			"lightmapped signature read");
+		ok &= Check(lightmappedSignature.hash != signature.hash, "lightmapped hash differs");
+
+		ok &= Check(VertexFormatMatchesSignature(ModelFormat(), signature), "model format feeds light_vs");
+		ok &= Check(VertexFormatMatchesSignature(LightmappedFormat(), signature), "extra elements are left unused");
+		ok &= Check(VertexFormatMatchesSignature(LightmappedFormat(), lightmappedSignature), "lightmapped format feeds the lightmapped shader");
+		ok &= Check(!VertexFormatMatchesSignature(ModelFormat(), lightmappedSignature), "model format lacks TEXCOORD1");
+		ok &= Check(!VertexFormatMatchesSignature(VertexFormat().Add("POSITION", 0, VertexElementFormat::Float3).Add("TEXCOORD", 0, VertexElementFormat::Float2),
+			signature), "format without NORMAL");
+		ok &= Check(!VertexFormatMatchesSignature(VertexFormat().Add("POSITION", 0, VertexElementFormat::Float3).Add("TEXCOORD", 0, VertexElementFormat::Float2)
+			.Add("NORMAL", 0, VertexElementFormat::UByte4), signature), "integer NORMAL for a float input");
+
+		// An integer input, as the bone palette shader's BONEINDEX, wants an integer element
+		const Input boneInputs[] = { { "POSITION", 0, c_Float32, 0xf }, { "BONEINDEX", 0, c_UInt32, 0x1 } };
+		ShaderInputSignature boneSignature;
+		ok &= Check(Parse(Container({ { "ISGN", SignatureChunk(boneInputs, std::size(boneInputs)) } }), boneSignature), "bone signature read");
+		ok &= Check(VertexFormatMatchesSignature(VertexFormat().Add("POSITION", 0, VertexElementFormat::Float3)
+			.Add("BONEINDEX", 0, VertexElementFormat::UInt1, 1, true, 1), boneSignature), "uint BONEINDEX");
+		ok &= Check(!VertexFormatMatchesSignature(VertexFormat().Add("POSITION", 0, VertexElementFormat::Float3)
+			.Add("BONEINDEX", 0, VertexElementFormat::Float1, 1, true, 1), boneSignature), "float BONEINDEX for a uint input");
+
+		// Counts whose 24 byte elements would wrap a 32 bit size back under the chunk's, and one just past its end
+		for (uint32_t count : { 0x0aaaaaabu, 0xffffffffu, 5u })
+		{
+			std::vector<uint8_t> bad = light;
+			Set32(bad, 0, count);
+			ShaderInputSignature rejected;
+			ok &= Check(!Parse(Container({ { "ISGN", bad } }), rejected), "element count past the chunk");
+		}
+		std::vector<uint8_t> truncated = blob;
+		Set32(truncated, 28, 0x40000000u);
+		ShaderInputSignature rejected;
+		ok &= Check(!Parse(truncated, rejected), "chunk count past the blob");
+		truncated = blob;
+		Set32(truncated, 32, 0xfffffffcu);
+		ok &= Check(!Parse(truncated, rejected), "chunk offset past the blob");
+		truncated = blob;
+		truncated.resize(truncated.size() - code.size() - 8 - 4);
+		ok &= Check(!Parse(truncated, rejected), "signature chunk cut short");
+
+		ShaderInputSignature none;
+		ok &= Check(Parse(Container({ { "SHDR", code } }), none) && none.parameters.empty(), "no signature chunk, no inputs");
+		return ok;
+	}
+
+	bool CheckCompiled(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::vector<uint8_t> blob((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		ShaderInputSignature signature, again;
+		if (!Check(!blob.empty() && Parse(blob, signature), "compiled shader read"))
+		{
+			return false;
+		}
+		std::printf("%s: %zu bytes, hash %016llx\n", path.c_str(), blob.size(), (unsigned long long)signature.hash);
+		for (const ShaderInputSignature::Parameter& parameter : signature.parameters)
+		{
+			std::printf("  %-12s %u  register %u  type %u  mask %x\n", parameter.semantic.c_str(), parameter.semanticIndex,
+				parameter.registerIndex, parameter.componentType, parameter.mask);
+		}
+
+		bool ok = true;
+		ok &= Check(Parse(blob, again) && again.hash == signature.hash, "compiled hash the same each parse");
+		ok &= Check(CheckSignature(signature, c_LightInputs, std::size(c_LightInputs)) ||
+			CheckSignature(signature, c_LightmappedInputs, std::size(c_LightmappedInputs)), "compiled inputs are light_vs's");
+		ok &= Check(VertexFormatMatchesSignature(LightmappedFormat(), signature), "lightmapped format feeds the compiled shader");
+		ok &= Check(!VertexFormatMatchesSignature(VertexFormat().Add("POSITION", 0, VertexElementFormat::Float3), signature), "position alone doesn't");
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			options.input = arg;
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-runs"))		options.runs = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.runs <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	bool ok = CheckSynthetic();
+	if (!options.input.empty())
+	{
+		ok &= CheckCompiled(options.input);
+	}
+	if (!ok)
+	{
+		return 1;
+	}
+	std::printf("signatures read, hashed and matched\n");
+
+	std::vector<uint8_t> blob = Container({ { "ISGN", SignatureChunk(c_LightmappedInputs, std::size(c_LightmappedInputs)) } });
+	ShaderInputSignature signature;
+	uint64_t hashes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int run = 0; run < options.runs; ++run)
+	{
+		ParseShaderInputSignature(blob.data(), blob.size(), signature);
+		hashes += signature.hash;
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / options.runs;
+	std::printf("  parse and hash a 4 input signature %8.1f ns   (%016llx)\n", ns, (unsigned long long)hashes);
+	return 0;
+}
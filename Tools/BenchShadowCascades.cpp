@@ -0,0 +1,441 @@
+//
+// BenchShadowCascades - checks fitting the shadow cascades and culling casters for them and for cube faces, see
+// ShadowCascades.h
+//
+// The splits must run from the near plane to the far distance in order, uniformly at lambda 0, logarithmically at 1 and
+// between the two otherwise. For a camera Game could have, every corner of each cascade's slice of the frustum must
+// land inside its map, the centre on whole texels, and the map's size must stay put while the camera turns and moves so
+// the edges don't shimmer. Casters beside or past a cascade are culled and ones between it and the light are kept. For
+// the cube faces of a point light, points along a face's axis project to the middle of that face at depths from 0 to
+// 1, and random boxes from a fixed seed are checked against points sampled inside them: a box with a point in a face's
+// pyramid within range has to be kept for that face, and one out of range or wholly behind it culled. Then culling is
+// timed. Needs nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BenchShadowCascades.cpp ShadowCascades.cpp -o BenchShadowCascades
+//	./BenchShadowCascades -casters 10000 -runs 200
+//
+
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		int		casters = 10000;
+		int		runs = 200;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchShadowCascades [options]\n"
+			"  -casters <n>    random boxes culled (default 10000)\n"
+			"  -runs <n>       times they are culled against every cascade and face (default 200)\n");
+	}
+
+	bool Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s\n", what);
+		}
+		return condition;
+	}
+
+	// Row vector times a row-major matrix, returning w
+	float Transform(const float m[16], const float p[3], float out[3])
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			out[i] = p[0] * m[i] + p[1] * m[4 + i] + p[2] * m[8 + i] + m[12 + i];
+		}
+		return p[0] * m[3] + p[1] * m[7] + p[2] * m[11] + m[15];
+	}
+
+	// Right handed look at as rows, the way Game's m_view is laid out
+	void LookAt(const float eye[3], const float target[3], float view[16])
+	{
+		float z[3] = { eye[0] - target[0], eye[1] - target[1], eye[2] - target[2] };
+		float length = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		for (float& v : z)
+		{
+			v /= length;
+		}
+		float x[3] = { z[2], 0.0f, -z[0] };		//up cross z
+		length = std::sqrt(x[0] * x[0] + x[2] * x[2]);
+		x[0] /= length;
+		x[2] /= length;
+		float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+		for (int i = 0; i < 3; ++i)
+		{
+			view[i * 4 + 0] = x[i];
+			view[i * 4 + 1] = y[i];
+			view[i * 4 + 2] = z[i];
+			view[i * 4 + 3] = 0.0f;
+		}
+		view[12] = -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]);
+		view[13] = -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]);
+		view[14] = -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]);
+		view[15] = 1.0f;
+	}
+
+	// Game's camera: 70 degrees at 16:9 from 0.01, shadows to 60 and a sun coming down at an angle
+	const float c_ProjScaleY = 1.0f / std::tan(35.0f * 3.14159265f / 180.0f);
+	const float c_ProjScaleX = c_ProjScaleY * 9.0f / 16.0f;
+	const float c_NearZ = 0.01f;
+	const float c_LightDirection[3] = { 0.4f, -0.8f, 0.45f };
+	const ShadowBounds c_Scene = { { -40.0f, -5.0f, -40.0f }, { 40.0f, 15.0f, 40.0f } };
+
+	bool CheckSplits()
+	{
+		bool ok = true;
+		float uniform[5], logarithmic[5], blended[5];
+		ShadowCascades::ComputeSplits(0.1f, 60.0f, 4, 0.0f, uniform);
+		ShadowCascades::ComputeSplits(0.1f, 60.0f, 4, 1.0f, logarithmic);
+		ShadowCascades::ComputeSplits(0.1f, 60.0f, 4, 0.75f, blended);
+		for (int i = 0; i <= 4; ++i)
+		{
+			ok &= Check(std::fabs(uniform[i] - (0.1f + 59.9f * i / 4.0f)) < 1e-3f, "uniform splits");
+			ok &= Check(std::fabs(logarithmic[i] - 0.1f * std::pow(600.0f, i / 4.0f)) < 1e-3f * logarithmic[i], "logarithmic splits");
+			ok &= Check(blended[i] >= logarithmic[i] - 1e-4f && blended[i] <= uniform[i] + 1e-4f, "blended between the two");
+			ok &= Check(i == 0 || (blended[i] > blended[i - 1] && logarithmic[i] > logarithmic[i - 1]), "splits in order");
+		}
+		ok &= Check(blended[0] == 0.1f && blended[4] == 60.0f, "splits run from near to far");
+
+		float one[2];
+		ShadowCascades::ComputeSplits(0.5f, 10.0f, 1, 0.5f, one);
+		ok &= Check(one[0] == 0.5f && one[1] == 10.0f, "a single cascade");
+		return ok;
+	}
+
+	// Every corner of each cascade's slice, in world space, must project inside its map
+	bool CornersInside(const ShadowCascades& cascades, const float eye[3], const float target[3])
+	{
+		float view[16];
+		LookAt(eye, target, view);
+		float forward[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+		float length = std::sqrt(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+		for (uint32_t c = 0; c < cascades.GetCount(); ++c)
+		{
+			const ShadowCascade& cascade = cascades.GetCascade(c);
+			for (int i = 0; i < 8; ++i)
+			{
+				float depth = (i & 4) ? cascade.splitFar : cascade.splitNear;
+				float right = ((i & 1) ? depth : -depth) / c_ProjScaleX, up = ((i & 2) ? depth : -depth) / c_ProjScaleY;
+				float corner[3], clip[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					corner[k] = eye[k] + forward[k] / length * depth + view[k * 4 + 0] * right + view[k * 4 + 1] * up;
+				}
+				Transform(cascade.viewProj, corner, clip);
+				if (std::fabs(clip[0]) > 1.0001f || std::fabs(clip[1]) > 1.0001f || clip[2] < -1e-4f || clip[2] > 1.0001f)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool CheckCascades()
+	{
+		ShadowCascades cascades;
+		ShadowCascadeDesc desc;
+		desc.count = 4;
+		desc.resolution = 2048;
+		cascades.SetDesc(desc);
+		bool ok = true;
+
+		float view[16];
+		const float eye[3] = { 2.0f, 2.0f, 2.0f }, origin[3] = { 0.0f, 0.0f, 0.0f };
+		LookAt(eye, origin, view);
+		cascades.Build(view, true, c_ProjScaleX, c_ProjScaleY, c_NearZ, c_LightDirection, c_Scene);
+		ok &= Check(cascades.GetCascade(0).splitNear == c_NearZ && cascades.GetCascade(3).splitFar == desc.maxDistance, "cascades cover near to max distance");
+
+		float halfSize[ShadowCascades::c_MaxCascades];
+		for (uint32_t c = 0; c < cascades.GetCount(); ++c)
+		{
+			const ShadowCascade& cascade = cascades.GetCascade(c);
+			halfSize[c] = cascade.halfSize;
+			ok &= Check(c == 0 || cascade.splitNear == cascades.GetCascade(c - 1).splitFar, "cascades meet");
+			ok &= Check(c == 0 || cascade.halfSize >= cascades.GetCascade(c - 1).halfSize, "further cascades are larger");
+			ok &= Check(std::fabs(cascade.texelSize * desc.resolution - 2.0f * cascade.halfSize) < 1e-4f * cascade.halfSize, "texel size");
+			for (float centre : cascade.centre)
+			{
+				float texels = centre / cascade.texelSize;
+				ok &= Check(std::fabs(texels - std::round(texels)) < 1e-3f, "centre on whole texels");
+			}
+
+			// No part of the scene is nearer the light than the depth range starts
+			for (int i = 0; i < 8; ++i)
+			{
+				float corner[3] = { (i & 1 ? c_Scene.max : c_Scene.min)[0], (i & 2 ? c_Scene.max : c_Scene.min)[1], (i & 4 ? c_Scene.max : c_Scene.min)[2] };
+				float clip[3];
+				Transform(cascade.viewProj, corner, clip);
+				ok &= Check(clip[2] >= -1e-4f, "casters from the scene's start in range");
+			}
+		}
+		ok &= Check(CornersInside(cascades, eye, origin), "slices inside their maps");
+
+		// Turning and moving the camera keeps every map's size, so only whole texel moves show
+		std::mt19937 random(30);
+		std::uniform_real_distribution<float> offset(-20.0f, 20.0f);
+		for (int step = 0; step < 200; ++step)
+		{
+			float from[3] = { offset(random), 1.0f + std::fabs(offset(random)) * 0.25f, offset(random) };
+			float to[3] = { from[0] + offset(random), offset(random) * 0.1f, from[2] + offset(random) };
+			LookAt(from, to, view);
+			cascades.Build(view, true, c_ProjScaleX, c_ProjScaleY, c_NearZ, c_LightDirection, c_Scene);
+			for (uint32_t c = 0; c < cascades.GetCount(); ++c)
+			{
+				ok &= Check(std::fabs(cascades.GetCascade(c).halfSize - halfSize[c]) <= 1.0f / 16.0f, "map size stable as the camera moves");
+			}
+			ok &= Check(CornersInside(cascades, from, to), "slices inside their maps as the camera moves");
+			if (!ok)
+			{
+				break;
+			}
+		}
+
+		// Casters in light space: beside the first cascade, past it, and between it and the light
+		LookAt(eye, origin, view);
+		cascades.Build(view, true, c_ProjScaleX, c_ProjScaleY, c_NearZ, c_LightDirection, c_Scene);
+		const ShadowCascade& first = cascades.GetCascade(0);
+		float length = std::sqrt(c_LightDirection[0] * c_LightDirection[0] + c_LightDirection[1] * c_LightDirection[1] + c_LightDirection[2] * c_LightDirection[2]);
+		float toLight[3] = { -c_LightDirection[0] / length, -c_LightDirection[1] / length, -c_LightDirection[2] / length };
+		float mid[3] = { (eye[0] + origin[0]) * 0.5f, (eye[1] + origin[1]) * 0.5f, (eye[2] + origin[2]) * 0.5f };
+		auto box = [](const float centre[3], float half)
+		{
+			ShadowBounds bounds;
+			for (int k = 0; k < 3; ++k)
+			{
+				bounds.min[k] = centre[k] - half;
+				bounds.max[k] = centre[k] + half;
+			}
+			return bounds;
+		};
+		float inside[3] = { eye[0] - 0.1f, eye[1] - 0.1f, eye[2] - 0.1f };
+		float above[3] = { mid[0] + toLight[0] * 30.0f, mid[1] + toLight[1] * 30.0f, mid[2] + toLight[2] * 30.0f };
+		float below[3] = { mid[0] - toLight[0] * 30.0f, mid[1] - toLight[1] * 30.0f, mid[2] - toLight[2] * 30.0f };
+		float aside[3] = { mid[0] + 50.0f, mid[1], mid[2] - 50.0f };
+		ShadowBounds casters[] = { box(inside, 0.05f), box(above, 0.5f), box(below, 0.5f), box(aside, 0.5f) };
+		std::vector<uint32_t> visible;
+		cascades.CullCasters(0, casters, 4, visible);
+		ok &= Check(first.halfSize < 30.0f, "first cascade is small");
+		ok &= Check(std::find(visible.begin(), visible.end(), 0u) != visible.end(), "caster inside the cascade kept");
+		ok &= Check(std::find(visible.begin(), visible.end(), 1u) != visible.end(), "caster between the cascade and the light kept");
+		ok &= Check(std::find(visible.begin(), visible.end(), 2u) == visible.end(), "caster past the cascade culled");
+		ok &= Check(std::find(visible.begin(), visible.end(), 3u) == visible.end(), "caster beside the cascade culled");
+		return ok;
+	}
+
+	bool CheckCubeFaces(std::mt19937& random)
+	{
+		const float light[3] = { 1.0f, 3.0f, -2.0f };
+		const float nearZ = 0.1f, range = 10.0f;
+		const float axes[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		bool ok = true;
+
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			float viewProj[16];
+			ShadowCascades::BuildCubeFace(light, nearZ, range, face, viewProj);
+			for (float distance : { nearZ, 1.0f, range })
+			{
+				float p[3], clip[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					p[k] = light[k] + axes[face][k] * distance;
+				}
+				float w = Transform(viewProj, p, clip);
+				float expected = range / (range - nearZ) * (1.0f - nearZ / distance);
+				ok &= Check(std::fabs(w - distance) < 1e-4f && std::fabs(clip[0]) < 1e-4f && std::fabs(clip[1]) < 1e-4f, "face axis projects to its middle");
+				ok &= Check(std::fabs(clip[2] / w - expected) < 1e-4f, "depth from 0 at near to 1 at far");
+			}
+			// A point off the face's corner edge projects to its corner
+			float p[3], clip[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				p[k] = light[k] + axes[face][k] * 2.0f;
+			}
+			p[(face / 2 + 1) % 3] += 2.0f;
+			p[(face / 2 + 2) % 3] += 2.0f;
+			float w = Transform(viewProj, p, clip);
+			ok &= Check(std::fabs(std::fabs(clip[0] / w) - 1.0f) < 1e-4f && std::fabs(std::fabs(clip[1] / w) - 1.0f) < 1e-4f, "90 degree faces");
+		}
+
+		// Random boxes around the light, each sampled on a grid of points
+		std::uniform_real_distribution<float> place(-14.0f, 14.0f), size(0.05f, 3.0f);
+		std::vector<ShadowBounds> boxes(2000);
+		for (ShadowBounds& b : boxes)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				float centre = light[k] + place(random), half = size(random);
+				b.min[k] = centre - half;
+				b.max[k] = centre + half;
+			}
+		}
+		ShadowBounds around = { { light[0] - 0.5f, light[1] - 0.5f, light[2] - 0.5f }, { light[0] + 0.5f, light[1] + 0.5f, light[2] + 0.5f } };
+		boxes.push_back(around);
+
+		std::vector<uint32_t> visible[6];
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			ShadowCascades::CullCubeFace(light, range, face, boxes.data(), boxes.size(), visible[face]);
+		}
+
+		size_t needed = 0, kept = 0;
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			const ShadowBounds& b = boxes[i];
+			bool reaches[6] = {}, inFront[6] = {};
+			const int steps = 8;
+			for (int x = 0; x <= steps; ++x)
+			{
+				for (int y = 0; y <= steps; ++y)
+				{
+					for (int z = 0; z <= steps; ++z)
+					{
+						float d[3] =
+						{
+							b.min[0] + (b.max[0] - b.min[0]) * x / steps - light[0],
+							b.min[1] + (b.max[1] - b.min[1]) * y / steps - light[1],
+							b.min[2] + (b.max[2] - b.min[2]) * z / steps - light[2],
+						};
+						bool inRange = d[0] * d[0] + d[1] * d[1] + d[2] * d[2] <= range * range;
+						for (uint32_t face = 0; face < 6; ++face)
+						{
+							uint32_t axis = face / 2;
+							float along = (face & 1) ? -d[axis] : d[axis];
+							inFront[face] |= along > 0.0f;
+							reaches[face] |= inRange && along >= std::fabs(d[(axis + 1) % 3]) && along >= std::fabs(d[(axis + 2) % 3]);
+						}
+					}
+				}
+			}
+
+			float distanceSq = 0.0f;
+			for (int k = 0; k < 3; ++k)
+			{
+				float d = std::max(std::max(b.min[k] - light[k], 0.0f), light[k] - b.max[k]);
+				distanceSq += d * d;
+			}
+			bool outOfRange = distanceSq > range * range;
+
+			for (uint32_t face = 0; face < 6; ++face)
+			{
+				bool culled = std::find(visible[face].begin(), visible[face].end(), uint32_t(i)) == visible[face].end();
+				needed += reaches[face];
+				kept += !culled;
+				if (reaches[face] && culled)
+				{
+					ok &= Check(false, "box reaching a face kept for it");
+				}
+				if ((outOfRange || !inFront[face]) && !culled)
+				{
+					ok &= Check(false, "box out of range or behind a face culled");
+				}
+			}
+		}
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			ok &= Check(std::find(visible[face].begin(), visible[face].end(), uint32_t(boxes.size() - 1)) != visible[face].end(), "box around the light in every face");
+		}
+		std::printf("cube faces: %zu boxes, %zu box/face pairs reach a face, %zu kept\n", boxes.size(), needed, kept);
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-casters"))		options.casters = std::atoi(value);
+		else if (!std::strcmp(arg, "-runs"))	options.runs = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.casters <= 0 || options.runs <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::mt19937 random(30);
+	bool ok = CheckSplits();
+	ok &= CheckCascades();
+	ok &= CheckCubeFaces(random);
+	if (!ok)
+	{
+		return 1;
+	}
+	std::printf("cascades fitted and casters culled\n");
+
+	std::uniform_real_distribution<float> place(-40.0f, 40.0f), size(0.2f, 2.0f);
+	std::vector<ShadowBounds> casters(options.casters);
+	for (ShadowBounds& b : casters)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			float centre = place(random) * (k == 1 ? 0.2f : 1.0f), half = size(random);
+			b.min[k] = centre - half;
+			b.max[k] = centre + half;
+		}
+	}
+
+	ShadowCascades cascades;
+	float view[16];
+	const float eye[3] = { 2.0f, 2.0f, 2.0f }, origin[3] = { 0.0f, 0.0f, 0.0f }, light[3] = { 0.0f, 3.0f, 0.0f };
+	LookAt(eye, origin, view);
+	std::vector<uint32_t> visible;
+	size_t cascadeCasters = 0, faceCasters = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int run = 0; run < options.runs; ++run)
+	{
+		cascades.Build(view, true, c_ProjScaleX, c_ProjScaleY, c_NearZ, c_LightDirection, c_Scene);
+		for (uint32_t c = 0; c < cascades.GetCount(); ++c)
+		{
+			cascades.CullCasters(c, casters.data(), casters.size(), visible);
+			cascadeCasters += visible.size();
+		}
+	}
+	double cascadeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / options.runs;
+	start = std::chrono::steady_clock::now();
+	for (int run = 0; run < options.runs; ++run)
+	{
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			ShadowCascades::CullCubeFace(light, 10.0f, face, casters.data(), casters.size(), visible);
+			faceCasters += visible.size();
+		}
+	}
+	double faceUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / options.runs;
+	std::printf("  %d casters: %u cascades fitted and culled %8.1f us (%.0f kept)   6 cube faces culled %8.1f us (%.0f kept)\n",
+		options.casters, cascades.GetCount(), cascadeUs, double(cascadeCasters) / options.runs, faceUs, double(faceCasters) / options.runs);
+	return 0;
+}
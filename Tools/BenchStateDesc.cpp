@@ -0,0 +1,350 @@
+//
+// BenchStateDesc - checks the normalising and hashing StateCache keys its states by, see StateDesc.h
+//
+// The presets StateCache builds (linear and anisotropic wrap, the shadow comparison sampler, opaque blending, the
+// default and overwrite depth states, the culling and depth biased rasterizers) are written out here with Direct3D's
+// enum values. Each must hash the same every time and apart from the others, and a copy changed only in a field
+// Direct3D ignores, or holding a BOOL as some other non zero value, must hash and compare the same so it doesn't split
+// the cache, while changing a field that matters must not. Then hashing is timed. Needs nothing from Windows, e.g. on
+// Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -I. Tools/BenchStateDesc.cpp StateDesc.cpp -o BenchStateDesc
+//	./BenchStateDesc -runs 10000000
+//
+
+#include "StateDesc.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		int		runs = 10000000;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchStateDesc [options]\n"
+			"  -runs <n>    descriptions hashed (default 10000000)\n");
+	}
+
+	// The Direct3D 11 values the presets use
+	constexpr uint32_t c_FilterMinMagMipLinear = 0x15;
+	constexpr uint32_t c_FilterAnisotropic = 0x55;
+	constexpr uint32_t c_FilterComparisonMinMagLinearMipPoint = 0x94;
+	constexpr uint32_t c_AddressWrap = 1;
+	constexpr uint32_t c_AddressClamp = 3;
+	constexpr uint32_t c_AddressBorder = 4;
+	constexpr uint32_t c_ComparisonLess = 2;
+	constexpr uint32_t c_ComparisonLessEqual = 4;
+	constexpr uint32_t c_ComparisonAlways = 8;
+	constexpr uint32_t c_BlendZero = 1;
+	constexpr uint32_t c_BlendOne = 2;
+	constexpr uint32_t c_BlendSrcAlpha = 5;
+	constexpr uint32_t c_BlendInvSrcAlpha = 6;
+	constexpr uint32_t c_BlendOpAdd = 1;
+	constexpr uint32_t c_FillSolid = 3;
+	constexpr uint32_t c_CullFront = 2;
+	constexpr uint32_t c_CullBack = 3;
+	constexpr uint32_t c_DepthWriteAll = 1;
+	constexpr uint32_t c_StencilKeep = 1;
+	constexpr uint32_t c_StencilReplace = 3;
+	constexpr float c_Float32Max = 3.402823466e+38f;
+
+	SamplerStateDesc MakeSampler(uint32_t filter, uint32_t address)
+	{
+		SamplerStateDesc desc;
+		memset(&desc, 0, sizeof(desc));
+		desc.filter = filter;
+		desc.addressU = desc.addressV = desc.addressW = address;
+		desc.maxAnisotropy = 1;
+		desc.comparisonFunc = c_ComparisonAlways;
+		desc.maxLod = c_Float32Max;
+		return desc;
+	}
+
+	SamplerStateDesc ShadowComparison()
+	{
+		SamplerStateDesc desc = MakeSampler(c_FilterComparisonMinMagLinearMipPoint, c_AddressBorder);
+		desc.comparisonFunc = c_ComparisonLessEqual;
+		for (float& channel : desc.borderColor)
+		{
+			channel = 1.0f;
+		}
+		return desc;
+	}
+
+	BlendStateDesc Opaque()
+	{
+		BlendStateDesc desc;
+		memset(&desc, 0, sizeof(desc));
+		desc.renderTarget[0] = { 0, c_BlendOne, c_BlendZero, c_BlendOpAdd, c_BlendOne, c_BlendZero, c_BlendOpAdd, 0xf };
+		return desc;
+	}
+
+	BlendStateDesc AlphaBlend()
+	{
+		BlendStateDesc desc = Opaque();
+		desc.renderTarget[0].blendEnable = 1;
+		desc.renderTarget[0].srcBlend = c_BlendSrcAlpha;
+		desc.renderTarget[0].destBlend = c_BlendInvSrcAlpha;
+		return desc;
+	}
+
+	RasterizerStateDesc MakeRasterizer(uint32_t cull)
+	{
+		RasterizerStateDesc desc;
+		memset(&desc, 0, sizeof(desc));
+		desc.fillMode = c_FillSolid;
+		desc.cullMode = cull;
+		desc.depthClipEnable = 1;
+		desc.multisampleEnable = 1;
+		return desc;
+	}
+
+	DepthStencilStateDesc MakeDepth(uint32_t func)
+	{
+		DepthStencilStateDesc desc;
+		memset(&desc, 0, sizeof(desc));
+		desc.depthEnable = 1;
+		desc.depthWriteMask = c_DepthWriteAll;
+		desc.depthFunc = func;
+		desc.stencilReadMask = desc.stencilWriteMask = 0xff;
+		desc.frontFace = { c_StencilKeep, c_StencilKeep, c_StencilKeep, c_ComparisonAlways };
+		desc.backFace = desc.frontFace;
+		return desc;
+	}
+
+	bool Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s\n", what);
+		}
+		return condition;
+	}
+
+	// Equal as the cache compares them: the same hash and the same bytes once normalised
+	template<typename Desc>
+	bool Same(const Desc& a, const Desc& b)
+	{
+		Desc na = Normalize(a), nb = Normalize(b);
+		return HashDesc(a) == HashDesc(b) && memcmp(&na, &nb, sizeof(Desc)) == 0;
+	}
+
+	template<typename Desc>
+	bool Differ(const Desc& a, const Desc& b)
+	{
+		Desc na = Normalize(a), nb = Normalize(b);
+		return HashDesc(a) != HashDesc(b) && memcmp(&na, &nb, sizeof(Desc)) != 0;
+	}
+
+	bool CheckPresets()
+	{
+		std::vector<uint64_t> hashes =
+		{
+			HashDesc(MakeSampler(c_FilterMinMagMipLinear, c_AddressWrap)),
+			HashDesc(MakeSampler(c_FilterAnisotropic, c_AddressWrap)),
+			HashDesc(ShadowComparison()),
+			HashDesc(Opaque()),
+			HashDesc(MakeDepth(c_ComparisonLessEqual)),
+			HashDesc(MakeDepth(c_ComparisonAlways)),
+			HashDesc(MakeRasterizer(c_CullFront)),
+			HashDesc(MakeRasterizer(c_CullBack)),
+		};
+		bool ok = Check(HashDesc(ShadowComparison()) == hashes[2] && HashDesc(Opaque()) == hashes[3], "hash the same every time");
+		for (size_t i = 0; i < hashes.size(); ++i)
+		{
+			for (size_t j = i + 1; j < hashes.size(); ++j)
+			{
+				ok &= Check(hashes[i] != hashes[j], "presets hash apart");
+			}
+		}
+		return ok;
+	}
+
+	bool CheckSamplers()
+	{
+		SamplerStateDesc linear = MakeSampler(c_FilterMinMagMipLinear, c_AddressWrap);
+		SamplerStateDesc anisotropic = MakeSampler(c_FilterAnisotropic, c_AddressWrap);
+		SamplerStateDesc shadow = ShadowComparison();
+		bool ok = true;
+
+		SamplerStateDesc other = linear;
+		other.maxAnisotropy = 16;
+		ok &= Check(Same(linear, other), "anisotropy of a linear sampler ignored");
+		other = anisotropic;
+		other.maxAnisotropy = 16;
+		ok &= Check(Differ(anisotropic, other), "anisotropy of an anisotropic sampler kept");
+
+		other = linear;
+		other.comparisonFunc = c_ComparisonLess;
+		ok &= Check(Same(linear, other), "comparison of a sampler that doesn't compare ignored");
+		other = shadow;
+		other.comparisonFunc = c_ComparisonLess;
+		ok &= Check(Differ(shadow, other), "comparison of the shadow sampler kept");
+
+		other = linear;
+		other.borderColor[3] = 1.0f;
+		ok &= Check(Same(linear, other), "border colour without a border address ignored");
+		other = shadow;
+		other.borderColor[0] = 0.0f;
+		ok &= Check(Differ(shadow, other), "border colour of the shadow sampler kept");
+		other = MakeSampler(c_FilterMinMagMipLinear, c_AddressClamp);
+		other.addressV = c_AddressBorder;
+		SamplerStateDesc colored = other;
+		colored.borderColor[1] = 0.5f;
+		ok &= Check(Differ(other, colored), "border colour kept with one border address");
+
+		other = linear;
+		other.maxLod = 4.0f;
+		ok &= Check(Differ(linear, other), "max LOD kept");
+		ok &= Check(Differ(linear, MakeSampler(c_FilterMinMagMipLinear, c_AddressClamp)), "address mode kept");
+		return ok;
+	}
+
+	bool CheckBlends()
+	{
+		BlendStateDesc opaque = Opaque();
+		BlendStateDesc alpha = AlphaBlend();
+		bool ok = true;
+
+		BlendStateDesc other = opaque;
+		other.renderTarget[3] = alpha.renderTarget[0];
+		ok &= Check(Same(opaque, other), "targets past the first ignored without independent blending");
+		other.independentBlendEnable = 1;
+		ok &= Check(Differ(opaque, other), "targets past the first kept with independent blending");
+
+		other = opaque;
+		other.renderTarget[0].srcBlend = c_BlendSrcAlpha;
+		other.renderTarget[0].destBlendAlpha = c_BlendInvSrcAlpha;
+		ok &= Check(Same(opaque, other), "factors of a target that doesn't blend ignored");
+		ok &= Check(Differ(opaque, alpha), "factors of a target that blends kept");
+
+		other = alpha;
+		other.renderTarget[0].blendEnable = 0xffffffffu;
+		ok &= Check(Same(alpha, other), "any non zero BOOL is TRUE");
+		other = opaque;
+		other.renderTarget[0].writeMask = 0x7;
+		ok &= Check(Differ(opaque, other), "write mask kept");
+		other.renderTarget[0].writeMask = 0xf7;
+		ok &= Check(Same(Normalize(other), Normalize(Normalize(other))), "normalising twice changes nothing");
+		return ok;
+	}
+
+	bool CheckRasterizers()
+	{
+		RasterizerStateDesc back = MakeRasterizer(c_CullBack);
+		bool ok = Check(Differ(back, MakeRasterizer(c_CullFront)), "cull mode kept");
+
+		RasterizerStateDesc other = back;
+		other.depthClipEnable = 7;
+		other.multisampleEnable = 0x100;
+		ok &= Check(Same(back, other), "any non zero BOOL is TRUE");
+		other = back;
+		other.depthBias = 100;
+		other.slopeScaledDepthBias = 1.5f;
+		ok &= Check(Differ(back, other), "depth bias kept");
+		other.scissorEnable = 1;
+		RasterizerStateDesc biased = back;
+		biased.depthBias = 100;
+		biased.slopeScaledDepthBias = 1.5f;
+		ok &= Check(Differ(biased, other), "scissor kept");
+		return ok;
+	}
+
+	bool CheckDepthStencils()
+	{
+		DepthStencilStateDesc depth = MakeDepth(c_ComparisonLessEqual);
+		bool ok = Check(Differ(depth, MakeDepth(c_ComparisonAlways)), "depth function kept");
+
+		DepthStencilStateDesc other = depth;
+		other.stencilReadMask = 0x0f;
+		other.frontFace.passOp = c_StencilReplace;
+		other.backFace.func = c_ComparisonLess;
+		ok &= Check(Same(depth, other), "stencil faces and masks ignored without stencil");
+		DepthStencilStateDesc stencil = depth;
+		stencil.stencilEnable = 1;
+		other.stencilEnable = 1;
+		ok &= Check(Differ(stencil, other), "stencil faces and masks kept with stencil");
+		other = stencil;
+		other.stencilWriteMask = 0x1ff;
+		ok &= Check(Same(stencil, other), "stencil masks are 8 bits");
+
+		DepthStencilStateDesc off = depth, offAlways = MakeDepth(c_ComparisonAlways);
+		off.depthEnable = offAlways.depthEnable = 0;
+		ok &= Check(Same(off, offAlways), "depth function ignored without depth");
+		offAlways.depthEnable = 2;
+		ok &= Check(Differ(off, offAlways), "depth enabled by any non zero BOOL");
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-runs"))		options.runs = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.runs <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	bool ok = CheckPresets();
+	ok &= CheckSamplers();
+	ok &= CheckBlends();
+	ok &= CheckRasterizers();
+	ok &= CheckDepthStencils();
+	if (!ok)
+	{
+		return 1;
+	}
+	std::printf("descriptions normalised and hashed\n");
+
+	// Every Get normalises and hashes its description, blend descriptions being the largest
+	BlendStateDesc blend = AlphaBlend();
+	SamplerStateDesc sampler = ShadowComparison();
+	uint64_t hashes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int run = 0; run < options.runs; ++run)
+	{
+		blend.renderTarget[0].writeMask = uint32_t(run) & 0xf;
+		hashes += HashDesc(blend);
+	}
+	double blendNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / options.runs;
+	start = std::chrono::steady_clock::now();
+	for (int run = 0; run < options.runs; ++run)
+	{
+		sampler.maxLod = float(run & 15);
+		hashes += HashDesc(sampler);
+	}
+	double samplerNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / options.runs;
+	std::printf("  blend %zu bytes %6.1f ns   sampler %zu bytes %6.1f ns   (%016llx)\n", sizeof(BlendStateDesc), blendNs,
+		sizeof(SamplerStateDesc), samplerNs, (unsigned long long)hashes);
+	return 0;
+}
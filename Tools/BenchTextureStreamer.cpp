@@ -0,0 +1,448 @@
+//
+// BenchTextureStreamer - checks the queue, reads and residency of the texture streamer against a fake device, see
+// TextureStreamer.h
+//
+// Small DDS files are written with a known byte pattern in every level: a streamable texture, a single level and an
+// array that must come whole, one that isn't a DDS file and one that isn't there. Requests of the same path share a
+// handle and keep the higher priority, and with one read at a time the files must be read and created in priority
+// order, earliest request first on a tie. The create callback stands in for the device: it checks the levels it is
+// handed (only the mip tail of the streamable texture) and can refuse a texture. Level reads must deliver the finer
+// levels, reject bad ranges, hand a read of a file changed since as failed, and be thrown away when Requeue cancels
+// them in flight. The same files are then streamed from an archive, stored and LZ4 compressed, and a streamer is
+// destroyed with reads in flight. Last, loading a set of larger files is timed. Needs nothing from Windows, e.g. on
+// Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -pthread -I. Tools/BenchTextureStreamer.cpp TextureStreamer.cpp AssetArchive.cpp DDSImage.cpp DDSFile.cpp MappedFile.cpp MipStreaming.cpp Lz4.cpp ThreadPool.cpp -o BenchTextureStreamer
+//	./BenchTextureStreamer -files 32 -size 512 -runs 10
+//
+
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t c_FormatRGBA8 = 28;		//DXGI_FORMAT_R8G8B8A8_UNORM
+
+	struct Options
+	{
+		int			files = 32;
+		uint32_t	size = 512;
+		int			runs = 10;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BenchTextureStreamer [options]\n"
+			"  -files <n>    textures streamed when timing (default 32)\n"
+			"  -size <n>     width and height of those textures, a power of two (default 512)\n"
+			"  -runs <n>     times the set is streamed (default 10)\n");
+	}
+
+	bool Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "failed: %s\n", what);
+		}
+		return condition;
+	}
+
+	uint32_t FullMipCount(uint32_t size)
+	{
+		uint32_t count = 1;
+		while (size > 1)
+		{
+			size >>= 1;
+			++count;
+		}
+		return count;
+	}
+
+	uint8_t Pattern(uint32_t seed, uint32_t item, uint32_t mip, size_t offset)
+	{
+		return static_cast<uint8_t>(seed * 13 + item * 101 + mip * 37 + offset * 7);
+	}
+
+	// An RGBA8 texture with every level of every item filled with Pattern
+	std::vector<uint8_t> MakeLevels(uint32_t size, uint32_t mipCount, uint32_t arraySize, uint32_t seed)
+	{
+		std::vector<uint8_t> data;
+		for (uint32_t item = 0; item < arraySize; ++item)
+		{
+			for (uint32_t mip = 0; mip < mipCount; ++mip)
+			{
+				size_t bytes = DDS::GetSurfaceSize(c_FormatRGBA8, std::max(size >> mip, 1u), std::max(size >> mip, 1u));
+				for (size_t i = 0; i < bytes; ++i)
+				{
+					data.push_back(Pattern(seed, item, mip, i));
+				}
+			}
+		}
+		return data;
+	}
+
+	bool WriteTexture(const std::string& path, uint32_t size, uint32_t mipCount, uint32_t arraySize, uint32_t seed)
+	{
+		std::vector<uint8_t> data = MakeLevels(size, mipCount, arraySize, seed);
+		return DDS::Write(path, size, size, mipCount, c_FormatRGBA8, data.data(), data.size(), arraySize);
+	}
+
+	bool ReadBytes(const std::string& path, std::vector<uint8_t>& bytes)
+	{
+		FILE* file = std::fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
+		bytes.clear();
+		uint8_t chunk[4096];
+		size_t read;
+		while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+		{
+			bytes.insert(bytes.end(), chunk, chunk + read);
+		}
+		std::fclose(file);
+		return true;
+	}
+
+	// Levels [firstMip, endMip) of item 0 of a streamable texture, or every surface of one that comes whole
+	bool LevelsMatch(const TextureFile& file, uint32_t seed)
+	{
+		bool streamable = MipStreaming::IsStreamable(file.info);
+		uint32_t items = streamable ? 1 : file.image.GetSurfaceCount() / file.info.mipCount;
+		for (uint32_t item = 0; item < items; ++item)
+		{
+			for (uint32_t mip = file.firstMip; mip < file.endMip; ++mip)
+			{
+				const DDSSurface* surface = file.image.GetSurface(mip, item);
+				if (!surface || surface->width != std::max(file.info.width >> mip, 1u))
+				{
+					return false;
+				}
+				for (size_t i = 0; i < surface->size; ++i)
+				{
+					if (surface->data[i] != Pattern(seed, item, mip, i))
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	// The files the checks stream, written to the working directory and removed again
+	struct TestFiles
+	{
+		std::vector<std::string>	paths;
+
+		TestFiles()
+		{
+			paths = { "BenchTextureStreamer_a.dds", "BenchTextureStreamer_b.dds", "BenchTextureStreamer_c.dds",
+				"BenchTextureStreamer_d.dds", "BenchTextureStreamer_e.dds" };
+		}
+
+		~TestFiles()
+		{
+			for (const std::string& path : paths)
+			{
+				std::remove(path.c_str());
+			}
+			std::remove("BenchTextureStreamer.pak");
+		}
+
+		// The pattern seed each file was written with
+		uint32_t SeedOf(const std::string& path) const
+		{
+			return static_cast<uint32_t>(std::find(paths.begin(), paths.end(), path) - paths.begin()) + 1;
+		}
+
+		bool Write()
+		{
+			FILE* junk = std::fopen(paths[3].c_str(), "wb");
+			if (!junk)
+			{
+				return false;
+			}
+			std::fputs("DDS not really", junk);
+			std::fclose(junk);
+			std::remove(paths[4].c_str());
+			return WriteTexture(paths[0], 256, 9, 1, 1) && WriteTexture(paths[1], 48, 1, 1, 2) && WriteTexture(paths[2], 64, 7, 2, 3);
+		}
+	};
+
+	// Updates until nothing is queued, reading or loaded, waiting for the reads between calls
+	void Drain(TextureStreamer& streamer, const TextureStreamer::CreateFunction& create, uint32_t maxCreates,
+		const TextureStreamer::LevelsFunction& levels = nullptr)
+	{
+		for (int i = 0; i < 1000 && (streamer.GetPendingCount() || streamer.GetLevelReads()); ++i)
+		{
+			streamer.WaitForReads();
+			streamer.Update(create, maxCreates, levels);
+		}
+	}
+
+	bool CheckQueue(const TestFiles& files)
+	{
+		bool ok = true;
+		TextureStreamer streamer(1, 1);
+		TextureHandle a = streamer.Request(files.paths[0], 1);
+		TextureHandle b = streamer.Request(files.paths[1], 5);
+		TextureHandle c = streamer.Request(files.paths[2], 3);
+		TextureHandle junk = streamer.Request(files.paths[3], 3);
+		TextureHandle missing = streamer.Request(files.paths[4], 0);
+		ok &= Check(streamer.Request(files.paths[0], 4) == a && streamer.Request(files.paths[1], 0) == b,
+			"the same path keeps its handle");
+		ok &= Check(streamer.GetCount() == 5 && streamer.GetPendingCount() == 5, "five queued");
+		ok &= Check(streamer.GetState(a) == TextureState::Queued && streamer.GetPath(c) == files.paths[2], "queued state");
+		ok &= Check(streamer.GetState(c_InvalidTexture) == TextureState::Failed && streamer.GetPath(99).empty(),
+			"unknown handles");
+
+		// b 5, a raised to 4, then c and junk on 3 in the order asked for, missing last
+		std::vector<TextureHandle> created;
+		auto create = [&](TextureHandle handle, const TextureFile& file)
+		{
+			ok &= Check(LevelsMatch(file, files.SeedOf(streamer.GetPath(handle))), "created from the right levels");
+			created.push_back(handle);
+			return handle != c;
+		};
+
+		ok &= Check(streamer.Update(create, 8) == 0 && streamer.GetState(b) == TextureState::Reading
+			&& streamer.GetState(a) == TextureState::Queued, "one read at a time, most urgent first");
+		streamer.WaitForReads();
+		ok &= Check(streamer.GetState(b) == TextureState::Loaded && streamer.GetInfo(b).width == 48, "loaded with its header");
+		Drain(streamer, create, 1);
+
+		const std::vector<TextureHandle> order = { b, a, c };
+		ok &= Check(created == order, "created in priority order");
+		ok &= Check(streamer.GetState(a) == TextureState::Resident && streamer.GetState(b) == TextureState::Resident,
+			"created textures resident");
+		ok &= Check(streamer.GetState(c) == TextureState::Failed, "refused by the create callback");
+		ok &= Check(streamer.GetState(junk) == TextureState::Failed && streamer.GetState(missing) == TextureState::Failed,
+			"unreadable files failed");
+		ok &= Check(streamer.GetPendingCount() == 0, "nothing pending");
+
+		// The streamable texture only as far as its 64 texel tail, the single level whole
+		size_t tail = 0;
+		for (uint32_t mip = 2; mip < 9; ++mip)
+		{
+			tail += DDS::GetSurfaceSize(c_FormatRGBA8, 256 >> mip, 256 >> mip);
+		}
+		ok &= Check(streamer.GetResidentBytes() == tail + 48 * 48 * 4, "resident bytes from the tail");
+
+		// SetPriority reorders what is still queued
+		TextureStreamer later(1, 1);
+		TextureHandle first = later.Request(files.paths[0], 2);
+		TextureHandle second = later.Request(files.paths[1], 1);
+		TextureHandle third = later.Request(files.paths[2], 0);
+		later.SetPriority(third, 9);
+		created.clear();
+		Drain(later, [&](TextureHandle handle, const TextureFile&) { created.push_back(handle); return true; }, 8);
+		const std::vector<TextureHandle> raised = { third, first, second };
+		ok &= Check(created == raised, "raised priority read first");
+		return ok;
+	}
+
+	bool CheckLevels(const TestFiles& files)
+	{
+		bool ok = true;
+		TextureStreamer streamer(2, 4);
+		TextureHandle a = streamer.Request(files.paths[0]);
+		TextureHandle b = streamer.Request(files.paths[1]);
+		auto create = [&](TextureHandle, const TextureFile&) { return true; };
+		ok &= Check(!streamer.RequestLevels(a, 0, 2), "no levels before resident");
+		Drain(streamer, create, 8);
+
+		ok &= Check(!streamer.RequestLevels(b, 0, 1), "single level textures don't stream");
+		ok &= Check(!streamer.RequestLevels(a, 2, 2) && !streamer.RequestLevels(a, 0, 10) && !streamer.RequestLevels(c_InvalidTexture, 0, 1),
+			"bad level ranges refused");
+
+		uint32_t delivered = 0;
+		auto levels = [&](TextureHandle handle, const TextureFile* file)
+		{
+			++delivered;
+			ok &= Check(handle == a && file && file->firstMip == 0 && file->endMip == 2 && LevelsMatch(*file, 1),
+				"finer levels delivered");
+			ok &= Check(file && file->GetBytes() == 256 * 256 * 4 + 128 * 128 * 4, "level bytes");
+		};
+		ok &= Check(streamer.RequestLevels(a, 0, 2) && streamer.GetLevelReads() == 1, "level read started");
+		Drain(streamer, create, 8, levels);
+		ok &= Check(delivered == 1 && streamer.GetLevelReads() == 0, "level read handed out once");
+
+		// Requeue cancels the reads in flight: they still finish but never reach the callback
+		delivered = 0;
+		ok &= Check(streamer.RequestLevels(a, 0, 2) && streamer.RequestLevels(a, 1, 2), "two level reads started");
+		streamer.Requeue();
+		ok &= Check(streamer.GetState(a) == TextureState::Queued && streamer.GetResidentBytes() == 0, "requeued");
+		ok &= Check(!streamer.RequestLevels(a, 0, 2), "no levels while requeued");
+		streamer.WaitForReads();
+		ok &= Check(streamer.GetLevelReads() == 0, "cancelled reads collected");
+		Drain(streamer, create, 8, levels);
+		ok &= Check(delivered == 0 && streamer.GetState(a) == TextureState::Resident, "cancelled reads dropped, texture read again");
+
+		// A file that changed under a resident texture hands back a failed read
+		WriteTexture(files.paths[0], 128, 8, 1, 1);
+		bool failed = false;
+		auto changed = [&](TextureHandle, const TextureFile* file) { failed = !file; };
+		ok &= Check(streamer.RequestLevels(a, 0, 1), "read of a changed file started");
+		Drain(streamer, create, 8, changed);
+		ok &= Check(failed, "changed file refused");
+		ok &= Check(WriteTexture(files.paths[0], 256, 9, 1, 1), "file written back");
+		return ok;
+	}
+
+	bool CheckArchive(const TestFiles& files)
+	{
+		bool ok = true;
+		AssetArchiveWriter writer;
+		std::vector<uint8_t> bytes;
+		ok &= Check(ReadBytes(files.paths[0], bytes) && writer.Add("stored.dds", bytes.data(), bytes.size(), AssetCompression::None),
+			"stored entry added");
+		ok &= Check(ReadBytes(files.paths[2], bytes) && writer.Add("packed.dds", bytes.data(), bytes.size(), AssetCompression::Lz4),
+			"compressed entry added");
+		AssetArchive archive;
+		ok &= Check(writer.Write("BenchTextureStreamer.pak") && archive.Open("BenchTextureStreamer.pak"), "archive written");
+		if (!ok)
+		{
+			return false;
+		}
+
+		TextureStreamer streamer(2, 4);
+		streamer.SetArchive(&archive);
+		TextureHandle stored = streamer.Request("stored.dds");
+		TextureHandle packed = streamer.Request("packed.dds");
+		TextureHandle loose = streamer.Request(files.paths[1]);
+		auto create = [&](TextureHandle handle, const TextureFile& file)
+		{
+			ok &= Check(LevelsMatch(file, handle == stored ? 1 : handle == loose ? 2 : 3), "archive levels");
+			return true;
+		};
+		bool delivered = false;
+		auto levels = [&](TextureHandle handle, const TextureFile* file)
+		{
+			delivered = true;
+			ok &= Check(handle == stored && file && LevelsMatch(*file, 1), "levels from the archive");
+		};
+		Drain(streamer, create, 8);
+		ok &= Check(streamer.GetState(stored) == TextureState::Resident && streamer.GetState(packed) == TextureState::Resident
+			&& streamer.GetState(loose) == TextureState::Resident, "archive and loose files resident");
+		ok &= Check(streamer.RequestLevels(stored, 0, 2), "archive level read started");
+		Drain(streamer, create, 8, levels);
+		ok &= Check(delivered, "archive level read delivered");
+		return ok;
+	}
+
+	// Reads still running when the streamer goes must neither crash nor leak, see Completed
+	bool CheckShutdown(const TestFiles& files)
+	{
+		for (int run = 0; run < 20; ++run)
+		{
+			TextureStreamer streamer(2, 4);
+			for (int i = 0; i < 3; ++i)
+			{
+				streamer.Request(files.paths[i]);
+			}
+			streamer.Update([](TextureHandle, const TextureFile&) { return true; }, 8);
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-files"))			options.files = std::atoi(value);
+		else if (!std::strcmp(arg, "-size"))		options.size = static_cast<uint32_t>(std::atoi(value));
+		else if (!std::strcmp(arg, "-runs"))		options.runs = std::atoi(value);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.files <= 0 || options.runs <= 0 || options.size < 4 || options.size > 4096 || (options.size & (options.size - 1)))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	{
+		TestFiles files;
+		if (!Check(files.Write(), "test files written") || !CheckQueue(files) || !CheckLevels(files) || !CheckArchive(files)
+			|| !CheckShutdown(files))
+		{
+			return 1;
+		}
+	}
+	std::printf("textures queued, read and created\n");
+
+	std::vector<std::string> paths;
+	uint32_t mipCount = FullMipCount(options.size);
+	for (int i = 0; i < options.files; ++i)
+	{
+		paths.push_back("BenchTextureStreamer_" + std::to_string(i) + ".dds");
+		if (!Check(WriteTexture(paths.back(), options.size, mipCount, 1, uint32_t(i)), "timing file written"))
+		{
+			return 1;
+		}
+	}
+
+	auto create = [](TextureHandle, const TextureFile&) { return true; };
+	double tailMs = 0.0, fullMs = 0.0;
+	for (int run = 0; run < options.runs; ++run)
+	{
+		TextureStreamer streamer(2, 4);
+		auto start = std::chrono::steady_clock::now();
+		for (const std::string& path : paths)
+		{
+			streamer.Request(path);
+		}
+		while (streamer.GetPendingCount())
+		{
+			streamer.Update(create, 4);
+			std::this_thread::yield();
+		}
+		auto resident = std::chrono::steady_clock::now();
+		for (uint32_t handle = 0; handle < streamer.GetCount(); ++handle)
+		{
+			streamer.RequestLevels(handle, 0, MipStreaming::GetTailMip(streamer.GetInfo(handle)));
+		}
+		while (streamer.GetLevelReads())
+		{
+			streamer.Update(create, 4, [](TextureHandle, const TextureFile*) {});
+			std::this_thread::yield();
+		}
+		auto end = std::chrono::steady_clock::now();
+		tailMs += std::chrono::duration<double, std::milli>(resident - start).count();
+		fullMs += std::chrono::duration<double, std::milli>(end - resident).count();
+	}
+	for (const std::string& path : paths)
+	{
+		std::remove(path.c_str());
+	}
+	std::printf("  %d textures of %ux%u: %.2f ms to the tails resident, %.2f ms more for the finer levels\n", options.files,
+		options.size, options.size, tailMs / options.runs, fullMs / options.runs);
+	return 0;
+}
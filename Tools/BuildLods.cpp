@@ -0,0 +1,482 @@
+//
+// BuildLods - simplifies every part of an SDKMESH or OBJ into a chain of levels of detail, see LodChain.h
+//
+// Each level after the first aims at a fixed fraction of the previous one's triangles and is simplified from the full
+// part, see MeshSimplifier.h. Its error is then measured rather than taken from the quadrics, which only bound the
+// distance to planes: the largest distance between the level and the full part, both ways. Every level of every part
+// is its own job on the thread pool. A part stops at the level that can't get meaningfully smaller, its seams and
+// borders hold it. Vertices with identical bytes are welded first, which OBJ files need since the game unrolls them the
+// way ModelClass does, one vertex per face corner. Prints each level's triangles and error, as a share of the part's
+// size too. Needs nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -pthread -I. Tools/BuildLods.cpp MeshSimplifier.cpp LodChain.cpp SdkMeshFile.cpp VertexFormat.cpp MappedFile.cpp Rig.cpp ThreadPool.cpp -o BuildLods
+//	./BuildLods tank.sdkmesh -out tank.lod
+//	./BuildLods fence.obj -out fence.lod
+//
+
+#include "LodChain.h"
+#include "MeshSimplifier.h"
+#include "SdkMeshFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::string	input;
+		std::string	output;				//input with .lod in place of its extension by default
+		uint32_t	levels = 4;			//including the full one
+		float		ratio = 0.5f;		//triangles kept from one level to the next
+		float		maxError = 0.0f;	//share of the part's size, 0 for no limit
+		float		minShrink = 0.9f;	//a level with more than this of the one before isn't kept
+		unsigned	threads = 0;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: BuildLods <mesh.sdkmesh | mesh.obj> [options]\n"
+			"  -out <path>        chain file to write (default the input's name with .lod)\n"
+			"  -levels <n>        levels including the full one, up to 8 (default 4)\n"
+			"  -ratio <r>         triangles kept from one level to the next (default 0.5)\n"
+			"  -error <e>         largest error as a share of each part's size, 0 for none (default 0)\n"
+			"  -threads <n>       worker threads, 0 for one per core (default 0)\n");
+	}
+
+	// One part as the simplifier takes it: positions and welded indices, plus its own indices for level 0
+	struct Part
+	{
+		std::string				mesh;
+		uint32_t				part;
+		uint32_t				vertexCount;
+		std::vector<float>		positions;			//three a vertex
+		std::vector<uint32_t>	indices;			//as the file has them
+		std::vector<uint32_t>	welded;				//each vertex replaced by the first with the same bytes
+		float					size;				//bounding box diagonal
+	};
+
+	struct Job
+	{
+		size_t					part;
+		uint32_t				level;
+		std::vector<uint32_t>	indices;
+		float					error;				//measured against the full part
+		double					milliseconds;
+	};
+
+	void Weld(Part& part, const uint8_t* vertices, size_t stride)
+	{
+		std::vector<uint32_t> remap(part.vertexCount);
+		WeldVertices(vertices, stride, part.vertexCount, remap.data());
+		part.welded.resize(part.indices.size());
+		for (size_t i = 0; i < part.indices.size(); ++i)
+		{
+			part.welded[i] = remap[part.indices[i]];
+		}
+
+		float boundsMin[3], boundsMax[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			boundsMin[axis] = part.vertexCount ? part.positions[axis] : 0.0f;
+			boundsMax[axis] = boundsMin[axis];
+		}
+		for (uint32_t v = 1; v < part.vertexCount; ++v)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				boundsMin[axis] = std::min(boundsMin[axis], part.positions[v * 3 + axis]);
+				boundsMax[axis] = std::max(boundsMax[axis], part.positions[v * 3 + axis]);
+			}
+		}
+		float dx = boundsMax[0] - boundsMin[0], dy = boundsMax[1] - boundsMin[1], dz = boundsMax[2] - boundsMin[2];
+		part.size = std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+
+	// Every triangle list subset, indices relative to its first vertex the way the draws offset them
+	bool ReadSdkMesh(const std::string& path, std::vector<Part>& parts)
+	{
+		SdkMeshFile file;
+		if (!file.Open(path))
+		{
+			return false;
+		}
+
+		for (uint32_t m = 0; m < file.GetMeshCount(); ++m)
+		{
+			const SdkMesh::Mesh* mesh = file.GetMesh(m);
+			const SdkMeshVertexBuffer* vb = file.GetVertexBuffer(mesh->vertexBuffers[0]);
+			const SdkMeshIndexBuffer* ib = file.GetIndexBuffer(mesh->indexBuffer);
+			const VertexElement* position = vb ? vb->format.Find("SV_Position", 0) : nullptr;
+			if (!vb || !ib || !position || position->format != VertexElementFormat::Float3)
+			{
+				continue;
+			}
+
+			const uint32_t* subsets = file.GetMeshSubsets(*mesh);
+			for (uint32_t s = 0; s < mesh->numSubsets; ++s)
+			{
+				const SdkMesh::Subset* subset = file.GetSubset(subsets[s]);
+				if (!subset || subset->primitiveType != SdkMesh::TriangleList || subset->vertexStart > vb->vertexCount
+					|| vb->vertexCount - subset->vertexStart < subset->vertexCount || subset->indexStart > ib->indexCount
+					|| ib->indexCount - subset->indexStart < subset->indexCount)
+				{
+					continue;
+				}
+
+				Part part;
+				part.mesh = SdkMesh::GetString(mesh->name);
+				part.part = s;
+				part.vertexCount = static_cast<uint32_t>(subset->vertexCount);
+				const uint8_t* vertices = vb->data + subset->vertexStart * vb->stride;
+				part.positions.resize(size_t(part.vertexCount) * 3);
+				for (uint32_t v = 0; v < part.vertexCount; ++v)
+				{
+					std::memcpy(&part.positions[v * 3], vertices + v * vb->stride + position->offset, 3 * sizeof(float));
+				}
+
+				part.indices.resize(static_cast<size_t>(subset->indexCount / 3 * 3));
+				bool inRange = true;
+				for (size_t i = 0; i < part.indices.size(); ++i)
+				{
+					size_t at = static_cast<size_t>(subset->indexStart) + i;
+					uint32_t index = 0;
+					if (ib->indexSize == 2)
+					{
+						uint16_t index16;
+						std::memcpy(&index16, ib->data + at * 2, sizeof(index16));
+						index = index16;
+					}
+					else
+					{
+						std::memcpy(&index, ib->data + at * 4, sizeof(index));
+					}
+					inRange = inRange && index < part.vertexCount;
+					part.indices[i] = index;
+				}
+				if (!inRange)
+				{
+					continue;
+				}
+
+				Weld(part, vertices, vb->stride);
+				parts.push_back(std::move(part));
+			}
+		}
+		return true;
+	}
+
+	// The triangle faces ModelClass::LoadModel reads, unrolled the same way into a vertex per corner
+	bool ReadObj(const std::string& path, std::vector<Part>& parts)
+	{
+		std::ifstream file(path);
+		if (!file)
+		{
+			return false;
+		}
+
+		std::vector<float> positions, uvs, normals;
+		std::vector<float> corners;			//position, uv and normal of each corner
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream stream(line);
+			std::string type;
+			stream >> type;
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			if (type == "v" && stream >> x >> y >> z)			{ positions.insert(positions.end(), { x, y, z }); }
+			else if (type == "vt" && stream >> x >> y)			{ uvs.insert(uvs.end(), { x, y }); }
+			else if (type == "vn" && stream >> x >> y >> z)		{ normals.insert(normals.end(), { x, y, z }); }
+			else if (type == "f")
+			{
+				for (int corner = 0; corner < 3; ++corner)
+				{
+					size_t v, t, n;
+					char slash1, slash2;
+					if (!(stream >> v >> slash1 >> t >> slash2 >> n) || slash1 != '/' || slash2 != '/' || !v || !t || !n
+						|| v * 3 > positions.size() || t * 2 > uvs.size() || n * 3 > normals.size())
+					{
+						return false;
+					}
+					corners.insert(corners.end(), positions.begin() + (v - 1) * 3, positions.begin() + v * 3);
+					corners.insert(corners.end(), uvs.begin() + (t - 1) * 2, uvs.begin() + t * 2);
+					corners.insert(corners.end(), normals.begin() + (n - 1) * 3, normals.begin() + n * 3);
+				}
+			}
+		}
+
+		// Named after the file, e.g. "fence" for fence.obj
+		Part part;
+		size_t slash = path.find_last_of("/\\");
+		part.mesh = path.substr(slash == std::string::npos ? 0 : slash + 1);
+		part.mesh = part.mesh.substr(0, part.mesh.find_last_of('.'));
+		part.part = 0;
+		part.vertexCount = static_cast<uint32_t>(corners.size() / 8);
+		part.positions.resize(size_t(part.vertexCount) * 3);
+		part.indices.resize(part.vertexCount);
+		for (uint32_t v = 0; v < part.vertexCount; ++v)
+		{
+			std::memcpy(&part.positions[v * 3], &corners[v * 8], 3 * sizeof(float));
+			part.indices[v] = v;
+		}
+		Weld(part, reinterpret_cast<const uint8_t*>(corners.data()), 8 * sizeof(float));
+		parts.push_back(std::move(part));
+		return true;
+	}
+
+	float ClosestDistance(const float* p, const float* a, const float* b, const float* c)
+	{
+		// Which feature of the triangle is nearest, from the barycentric regions (Ericson, Real-Time Collision Detection 5.1.5)
+		float ab[3], ac[3], ap[3], closest[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			ab[axis] = b[axis] - a[axis];
+			ac[axis] = c[axis] - a[axis];
+			ap[axis] = p[axis] - a[axis];
+		}
+		auto dot = [](const float* x, const float* y) { return x[0] * y[0] + x[1] * y[1] + x[2] * y[2]; };
+		auto at = [&](float v, float w)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				closest[axis] = a[axis] + ab[axis] * v + ac[axis] * w;
+			}
+		};
+
+		float d1 = dot(ab, ap), d2 = dot(ac, ap);
+		float bp[3] = { p[0] - b[0], p[1] - b[1], p[2] - b[2] }, cp[3] = { p[0] - c[0], p[1] - c[1], p[2] - c[2] };
+		float d3 = dot(ab, bp), d4 = dot(ac, bp), d5 = dot(ab, cp), d6 = dot(ac, cp);
+		float va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+		if (d1 <= 0.0f && d2 <= 0.0f)									at(0.0f, 0.0f);
+		else if (d3 >= 0.0f && d4 <= d3)								at(1.0f, 0.0f);
+		else if (d6 >= 0.0f && d5 <= d6)								at(0.0f, 1.0f);
+		else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)				at(d1 / (d1 - d3), 0.0f);
+		else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)				at(0.0f, d2 / (d2 - d6));
+		else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+		{
+			float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			at(1.0f - w, w);
+		}
+		else
+		{
+			float sum = va + vb + vc;
+			at(sum != 0.0f ? vb / sum : 0.0f, sum != 0.0f ? vc / sum : 0.0f);
+		}
+		float d[3] = { p[0] - closest[0], p[1] - closest[1], p[2] - closest[2] };
+		return std::sqrt(dot(d, d));
+	}
+
+	float DistanceToSurface(const float* p, const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		float nearest = INFINITY;
+		for (size_t i = 0; i + 2 < indices.size() && nearest > 0.0f; i += 3)
+		{
+			nearest = std::min(nearest, ClosestDistance(p, &positions[indices[i] * 3], &positions[indices[i + 1] * 3], &positions[indices[i + 2] * 3]));
+		}
+		return nearest;
+	}
+
+	// Largest distance between a level and the full part, both ways: from every vertex of the part to the level's
+	// triangles, and from the middle of every one of the level's triangles to the part's. Brute force, the parts are
+	// small and this runs on the pool with the simplification.
+	float Deviation(const Part& part, const std::vector<uint32_t>& level)
+	{
+		if (level.empty())
+		{
+			return INFINITY;
+		}
+
+		std::vector<uint8_t> used(part.vertexCount, 0);
+		float deviation = 0.0f;
+		for (uint32_t index : part.welded)
+		{
+			if (!used[index])
+			{
+				used[index] = 1;
+				deviation = std::max(deviation, DistanceToSurface(&part.positions[index * 3], part.positions, level));
+			}
+		}
+		for (size_t i = 0; i < level.size(); i += 3)
+		{
+			float middle[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				middle[axis] = (part.positions[level[i] * 3 + axis] + part.positions[level[i + 1] * 3 + axis] + part.positions[level[i + 2] * 3 + axis]) / 3.0f;
+			}
+			deviation = std::max(deviation, DistanceToSurface(middle, part.positions, part.welded));
+		}
+		return deviation;
+	}
+
+	bool EndsWith(const std::string& text, const char* suffix)
+	{
+		size_t length = std::strlen(suffix);
+		if (text.size() < length)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < length; ++i)
+		{
+			if (std::tolower(static_cast<unsigned char>(text[text.size() - length + i])) != suffix[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			options.input = arg;
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-out"))				options.output = value;
+		else if (!std::strcmp(arg, "-levels"))		options.levels = static_cast<uint32_t>(std::atoi(value));
+		else if (!std::strcmp(arg, "-ratio"))		options.ratio = static_cast<float>(std::atof(value));
+		else if (!std::strcmp(arg, "-error"))		options.maxError = static_cast<float>(std::atof(value));
+		else if (!std::strcmp(arg, "-threads"))		options.threads = static_cast<unsigned>(std::atoi(value));
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (options.input.empty() || options.levels < 1 || options.levels > LodChain::c_MaxLevels || !(options.ratio > 0.0f && options.ratio < 1.0f)
+		|| options.maxError < 0.0f)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (options.output.empty())
+	{
+		options.output = options.input.substr(0, options.input.find_last_of('.')) + ".lod";
+	}
+
+	std::vector<Part> parts;
+	bool read = EndsWith(options.input, ".obj") ? ReadObj(options.input, parts) : ReadSdkMesh(options.input, parts);
+	if (!read || parts.empty())
+	{
+		std::fprintf(stderr, "%s isn't an SDKMESH or OBJ with triangle lists\n", options.input.c_str());
+		return 1;
+	}
+
+	// Every coarser level of every part is one job, simplified from the full part
+	std::vector<Job> jobs;
+	for (size_t p = 0; p < parts.size(); ++p)
+	{
+		for (uint32_t level = 1; level < options.levels; ++level)
+		{
+			jobs.push_back({ p, level, {}, 0.0f, 0.0 });
+		}
+	}
+
+	ThreadPool pool(options.threads);
+	auto start = std::chrono::steady_clock::now();
+	ThreadPool::For(&pool, jobs.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j < end; ++j)
+		{
+			auto jobStart = std::chrono::steady_clock::now();
+			Job& job = jobs[j];
+			const Part& part = parts[job.part];
+			size_t target = static_cast<size_t>(part.welded.size() / 3 * std::pow(double(options.ratio), double(job.level))) * 3;
+			float maxError = options.maxError > 0.0f ? options.maxError * part.size : INFINITY;
+			job.indices.resize(part.welded.size());
+			job.indices.resize(SimplifyMesh(job.indices.data(), part.welded.data(), part.welded.size(), part.positions.data(), part.vertexCount,
+				3 * sizeof(float), target, maxError, nullptr));
+			job.error = Deviation(part, job.indices);
+			job.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - jobStart).count();
+		}
+	});
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::printf("%s: %zu parts, %u levels at %.2f each, %zu jobs on %u threads and this one, %.1f ms\n", options.input.c_str(), parts.size(),
+		options.levels, options.ratio, jobs.size(), pool.GetThreadCount(), milliseconds);
+	std::printf("  %-24s %4s %5s %9s %7s %10s %8s %8s\n", "mesh", "part", "level", "triangles", "kept", "error", "of size", "ms");
+
+	// A part's levels in order, stopping where one doesn't shrink enough. Errors are kept from going down, a coarser
+	// level can come out slightly better than the one before since each starts from the full part.
+	std::vector<LodChain> chains(parts.size());
+	std::vector<size_t> totals(options.levels, 0);
+	size_t job = 0;
+	for (size_t p = 0; p < parts.size(); ++p)
+	{
+		const Part& part = parts[p];
+		std::vector<LodLevel> levels = { { 0, static_cast<uint32_t>(part.indices.size()), 0.0f } };
+		std::vector<uint32_t> indices = part.indices;
+		std::printf("  %-24s %4u %5u %9zu %6.1f%% %10.5f %7.3f%% %8s\n", part.mesh.c_str(), part.part, 0u, part.indices.size() / 3, 100.0, 0.0, 0.0, "-");
+		totals[0] += part.indices.size() / 3;
+
+		for (uint32_t level = 1; level < options.levels; ++level, ++job)
+		{
+			const Job& result = jobs[job];
+			const LodLevel& previous = levels.back();
+			if (levels.size() != level || result.indices.empty() || result.indices.size() > previous.indexCount * options.minShrink)
+			{
+				continue;
+			}
+
+			float error = std::max(result.error, previous.error);
+			levels.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(result.indices.size()), error });
+			indices.insert(indices.end(), result.indices.begin(), result.indices.end());
+			totals[level] += result.indices.size() / 3;
+			std::printf("  %-24s %4s %5u %9zu %6.1f%% %10.5f %7.3f%% %8.2f\n", "", "", level, result.indices.size() / 3,
+				100.0 * result.indices.size() / part.indices.size(), error, part.size > 0.0f ? 100.0 * error / part.size : 0.0, result.milliseconds);
+		}
+
+		if (!chains[p].Set(part.mesh, part.part, part.vertexCount, levels, indices))
+		{
+			std::fprintf(stderr, "%s part %u came out inconsistent\n", part.mesh.c_str(), part.part);
+			return 1;
+		}
+	}
+
+	// Parts that stopped early draw their last level at the coarser ones, which the totals count
+	for (uint32_t level = 1; level < options.levels; ++level)
+	{
+		for (const LodChain& chain : chains)
+		{
+			if (chain.GetLevelCount() <= level)
+			{
+				totals[level] += chain.GetLevel(chain.GetLevelCount() - 1).indexCount / 3;
+			}
+		}
+		std::printf("  %-24s %4s %5u %9zu %6.1f%%\n", "all parts", "", level, totals[level], 100.0 * totals[level] / totals[0]);
+	}
+
+	if (!LodChain::Save(options.output, chains))
+	{
+		std::fprintf(stderr, "can't write %s\n", options.output.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,378 @@
+//
+// CompressTextures - offline block compression and mip chains for the scene's DDS files
+//
+// Decodes the top level of each input, builds the full mip chain from it and writes the texture back block
+// compressed, over the input unless -o gives a directory. Inputs already in the target format keep their top level
+// untouched, and opaque BC3 files going to BC1 have their colour blocks carried across as they are, so neither loses
+// anything to a second encode. Textures with alpha become BC7, and so do opaque ones whose BC1 top level falls below
+// the PSNR floor; whatever is still below it is refused rather than written. Reports the PSNR of the new top level
+// against the old one and the encode throughput.
+// Needs no GPU and nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -pthread -I. Tools/CompressTextures.cpp BlockCompression.cpp DDSImage.cpp DDSFile.cpp MappedFile.cpp ThreadPool.cpp -o CompressTextures
+//	./CompressTextures sky.dds tree.dds planet1.dds
+//
+
+#include "BlockCompression.h"
+#include "DDSImage.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using BlockCompression::Quality;
+
+namespace
+{
+	struct Options
+	{
+		uint32_t	format = DDS::FormatUnknown;		//unknown picks BC1 or BC3 from the alpha
+		Quality		quality = Quality::Normal;
+		bool		mips = true;
+		double		minPsnr = 32.0;		//top levels worse than this, in dB, are not written
+		std::string	directory;
+	};
+
+	struct Totals
+	{
+		size_t		bytesBefore = 0;
+		size_t		bytesAfter = 0;
+		size_t		encodedBytes = 0;		//RGBA8 input to the encoder
+		double		encodeSeconds = 0.0;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: CompressTextures <input.dds>... [options]\n"
+			"  -o <directory>     write the results there instead of over the inputs\n"
+			"  -format <f>        bc1, bc3, bc5, bc7 or auto, BC1 when every pixel is opaque and BC7 otherwise (default auto)\n"
+			"  -minpsnr <dB>      lowest PSNR a new top level may have, auto moves opaque textures from BC1 to BC7 to reach\n"
+			"                     it and anything still below is not written, 0 for no floor (default 32)\n"
+			"  -quality <q>       fast, normal or high (default normal)\n"
+			"  -nomips            a single level instead of the full chain\n"
+			"  -threads <n>       worker threads, 0 for one per core (default 0)\n");
+	}
+
+	const char* GetFormatName(uint32_t format)
+	{
+		switch (format)
+		{
+		case DDS::FormatBC1Unorm:			return "BC1";
+		case DDS::FormatBC2Unorm:			return "BC2";
+		case DDS::FormatBC3Unorm:			return "BC3";
+		case DDS::FormatBC4Unorm:			return "BC4";
+		case DDS::FormatBC5Unorm:			return "BC5";
+		case DDS::FormatBC7Unorm:			return "BC7";
+		case DDS::FormatR8G8B8A8Unorm:		return "RGBA8";
+		case DDS::FormatB8G8R8A8Unorm:		return "BGRA8";
+		case DDS::FormatB8G8R8X8Unorm:		return "BGRX8";
+		case DDS::FormatR16G16B16A16Float:	return "RGBA16F";
+		default:							return "?";
+		}
+	}
+
+	double Seconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// 10 log10(255^2 / MSE) over the given channels, infinite for an exact match
+	double ComputePsnr(const uint8_t* a, const uint8_t* b, size_t pixels, int firstChannel, int channelCount)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < pixels; ++i)
+		{
+			for (int c = firstChannel; c < firstChannel + channelCount; ++c)
+			{
+				double d = double(a[i * 4 + c]) - double(b[i * 4 + c]);
+				sum += d * d;
+			}
+		}
+		double mse = sum / (double(pixels) * channelCount);
+		return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : INFINITY;
+	}
+
+	// BC3 colour blocks are always decoded with four colours, BC1 only when c0 > c1, so the endpoints may need
+	// swapping (or, when equal, every index pointing at the first) to keep the same colours
+	void TranscodeBC3ToBC1(const uint8_t* input, size_t blocks, uint8_t* output)
+	{
+		for (size_t i = 0; i < blocks; ++i)
+		{
+			uint8_t* block = output + i * 8;
+			std::memcpy(block, input + i * 16 + 8, 8);
+
+			uint16_t c0 = uint16_t(block[0] | (block[1] << 8));
+			uint16_t c1 = uint16_t(block[2] | (block[3] << 8));
+			uint32_t indices;
+			std::memcpy(&indices, block + 4, 4);
+			if (c0 < c1)
+			{
+				std::swap(block[0], block[2]);
+				std::swap(block[1], block[3]);
+				indices ^= 0x55555555;
+			}
+			else if (c0 == c1)
+			{
+				indices = 0;
+			}
+			std::memcpy(block + 4, &indices, 4);
+		}
+	}
+
+	std::string GetOutputPath(const std::string& input, const Options& options)
+	{
+		if (options.directory.empty())
+		{
+			return input;
+		}
+		size_t slash = input.find_last_of("/\\");
+		return options.directory + "/" + (slash == std::string::npos ? input : input.substr(slash + 1));
+	}
+
+	// The whole chain in format: the top level carried across when that loses nothing, encoded otherwise, and the
+	// finer levels from the decoded source, never from the compressed ones. Returns how the top level was made.
+	const char* EncodeChain(const DDSImage& image, const std::vector<uint8_t>& source, bool opaque, uint32_t format,
+		uint32_t mipCount, const Options& options, ThreadPool& pool, Totals& totals, std::vector<uint8_t>& output)
+	{
+		const DDS::TextureInfo& info = image.GetInfo();
+		const DDSSurface& top = *image.GetSurface(0);
+		uint32_t width = info.width, height = info.height;
+
+		size_t size = 0;
+		for (uint32_t mip = 0; mip < mipCount; ++mip)
+		{
+			size += DDS::GetSurfaceSize(format, std::max(1u, width >> mip), std::max(1u, height >> mip));
+		}
+		output.assign(size, 0);
+
+		const char* method = "encoded";
+		size_t blocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+		if (format == info.format)
+		{
+			std::memcpy(output.data(), top.data, top.size);
+			method = "kept";
+		}
+		else if (format == DDS::FormatBC1Unorm && info.format == DDS::FormatBC3Unorm && opaque)
+		{
+			TranscodeBC3ToBC1(top.data, blocks, output.data());
+			method = "transcoded";
+		}
+		else
+		{
+			auto start = std::chrono::steady_clock::now();
+			BlockCompression::EncodeImage(format, source.data(), width, height, output.data(), options.quality, &pool);
+			totals.encodeSeconds += Seconds(start);
+			totals.encodedBytes += source.size();
+		}
+
+		std::vector<uint8_t> level = source, next;
+		size_t offset = DDS::GetSurfaceSize(format, width, height);
+		for (uint32_t mip = 1; mip < mipCount; ++mip)
+		{
+			uint32_t levelWidth = std::max(1u, width >> (mip - 1)), levelHeight = std::max(1u, height >> (mip - 1));
+			uint32_t nextWidth = std::max(1u, width >> mip), nextHeight = std::max(1u, height >> mip);
+			next.resize(size_t(nextWidth) * nextHeight * 4);
+			BlockCompression::Downsample(level.data(), levelWidth, levelHeight, next.data());
+
+			auto start = std::chrono::steady_clock::now();
+			BlockCompression::EncodeImage(format, next.data(), nextWidth, nextHeight, output.data() + offset, options.quality, &pool);
+			totals.encodeSeconds += Seconds(start);
+			totals.encodedBytes += next.size();
+
+			offset += DDS::GetSurfaceSize(format, nextWidth, nextHeight);
+			level.swap(next);
+		}
+		return method;
+	}
+
+	bool CompressFile(const std::string& input, const Options& options, ThreadPool& pool, Totals& totals)
+	{
+		DDSImage image;
+		if (!image.Open(input))
+		{
+			std::fprintf(stderr, "%s: could not read\n", input.c_str());
+			return false;
+		}
+
+		const DDS::TextureInfo info = image.GetInfo();
+		if (info.depth != 1 || info.arraySize != 1)
+		{
+			std::printf("%s: skipped, only single 2D textures\n", input.c_str());
+			return true;
+		}
+
+		uint32_t width = info.width, height = info.height;
+		size_t pixels = size_t(width) * height;
+		std::vector<uint8_t> source(pixels * 4);
+		const DDSSurface& top = *image.GetSurface(0);
+		if (!BlockCompression::DecodeImage(info.format, top.data, width, height, source.data()))
+		{
+			std::printf("%s: skipped, can't decode %s\n", input.c_str(), GetFormatName(info.format));
+			return true;
+		}
+
+		bool opaque = true;
+		for (size_t i = 0; i < pixels && opaque; ++i)
+		{
+			opaque = source[i * 4 + 3] == 255;
+		}
+
+		uint32_t format = options.format != DDS::FormatUnknown ? options.format : opaque ? DDS::FormatBC1Unorm : DDS::FormatBC7Unorm;
+		uint32_t mipCount = 1;
+		if (options.mips)
+		{
+			for (uint32_t largest = std::max(width, height); largest > 1; largest >>= 1)
+			{
+				++mipCount;
+			}
+		}
+		if (format == info.format && info.mipCount >= mipCount)
+		{
+			std::printf("%s: already %s with %u levels\n", input.c_str(), GetFormatName(format), info.mipCount);
+			return true;
+		}
+
+		std::vector<uint8_t> output;
+		const char* method = EncodeChain(image, source, opaque, format, mipCount, options, pool, totals, output);
+
+		// What the top level looks like now against what it looked like before
+		std::vector<uint8_t> decoded(pixels * 4);
+		BlockCompression::DecodeImage(format, output.data(), width, height, decoded.data());
+		int colourChannels = format == DDS::FormatBC4Unorm ? 1 : format == DDS::FormatBC5Unorm ? 2 : 3;
+		double colourPsnr = ComputePsnr(source.data(), decoded.data(), pixels, 0, colourChannels);
+		bool alpha = !opaque && (format == DDS::FormatBC1Unorm || format == DDS::FormatBC3Unorm || format == DDS::FormatBC7Unorm);
+		double alphaPsnr = alpha ? ComputePsnr(source.data(), decoded.data(), pixels, 3, 1) : INFINITY;
+
+		// An opaque texture BC1 can't hold well enough is given BC7's finer endpoints and indices instead
+		if (options.format == DDS::FormatUnknown && format == DDS::FormatBC1Unorm && colourPsnr < options.minPsnr)
+		{
+			std::printf("%s: BC1 only reaches %.2f dB, trying BC7\n", input.c_str(), colourPsnr);
+			format = DDS::FormatBC7Unorm;
+			method = EncodeChain(image, source, opaque, format, mipCount, options, pool, totals, output);
+			BlockCompression::DecodeImage(format, output.data(), width, height, decoded.data());
+			colourPsnr = ComputePsnr(source.data(), decoded.data(), pixels, 0, colourChannels);
+		}
+		if (std::min(colourPsnr, alphaPsnr) < options.minPsnr)
+		{
+			std::fprintf(stderr, "%s: %s only reaches %.2f dB, below the %.2f dB floor, not written\n", input.c_str(),
+				GetFormatName(format), std::min(colourPsnr, alphaPsnr), options.minPsnr);
+			return false;
+		}
+
+		size_t sizeBefore = image.GetSize();
+		image.Close();		//before the file is overwritten
+		std::string path = GetOutputPath(input, options);
+		if (!DDS::Write(path, width, height, mipCount, format, output.data(), output.size()))
+		{
+			std::fprintf(stderr, "%s: could not write\n", path.c_str());
+			return false;
+		}
+
+		size_t sizeAfter = sizeof(uint32_t) + sizeof(DDS::Header) + sizeof(DDS::HeaderDXT10) + output.size();
+		totals.bytesBefore += sizeBefore;
+		totals.bytesAfter += sizeAfter;
+		std::printf("%s: %ux%u %s, %u level%s -> %s, %u levels (top %s), %zu -> %zu bytes, PSNR %.2f dB",
+			input.c_str(), width, height, GetFormatName(info.format), info.mipCount, info.mipCount > 1 ? "s" : "",
+			GetFormatName(format), mipCount, method, sizeBefore, sizeAfter, colourPsnr);
+		if (alpha)
+		{
+			std::printf(", alpha %.2f dB", alphaPsnr);
+		}
+		std::printf("\n");
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	unsigned threads = 0;
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			inputs.push_back(arg);
+			continue;
+		}
+		if (!std::strcmp(arg, "-nomips"))
+		{
+			options.mips = false;
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-o"))				options.directory = value;
+		else if (!std::strcmp(arg, "-threads"))		threads = static_cast<unsigned>(std::atoi(value));
+		else if (!std::strcmp(arg, "-minpsnr"))		options.minPsnr = std::atof(value);
+		else if (!std::strcmp(arg, "-format"))
+		{
+			if (!std::strcmp(value, "bc1"))			options.format = DDS::FormatBC1Unorm;
+			else if (!std::strcmp(value, "bc3"))	options.format = DDS::FormatBC3Unorm;
+			else if (!std::strcmp(value, "bc5"))	options.format = DDS::FormatBC5Unorm;
+			else if (!std::strcmp(value, "bc7"))	options.format = DDS::FormatBC7Unorm;
+			else if (std::strcmp(value, "auto"))
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (!std::strcmp(arg, "-quality"))
+		{
+			if (!std::strcmp(value, "fast"))		options.quality = Quality::Fast;
+			else if (!std::strcmp(value, "normal"))	options.quality = Quality::Normal;
+			else if (!std::strcmp(value, "high"))	options.quality = Quality::High;
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (inputs.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	ThreadPool pool(threads);
+	Totals totals;
+	bool ok = true;
+	for (const std::string& input : inputs)
+	{
+		ok &= CompressFile(input, options, pool, totals);
+	}
+
+	if (totals.bytesBefore)
+	{
+		std::printf("%zu -> %zu bytes", totals.bytesBefore, totals.bytesAfter);
+		if (totals.encodeSeconds > 0.0)
+		{
+			std::printf(", encoded %.1f MB of RGBA8 in %.2fs on %u threads, %.1f MB/s", totals.encodedBytes / 1e6,
+				totals.encodeSeconds, pool.GetThreadCount() + 1, totals.encodedBytes / 1e6 / totals.encodeSeconds);
+		}
+		std::printf("\n");
+	}
+	return ok ? 0 : 1;
+}
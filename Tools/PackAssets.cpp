@@ -0,0 +1,276 @@
+//
+// PackAssets - packs the game's loose files into one archive, see AssetArchive.h
+//
+// Inputs are files or directories (their files, not recursively), stored under the name they were given with, or
+// relative to the directory. By default DDS files are stored so the texture streamer can map their levels straight
+// from the archive, and everything else is LZ4 compressed where that saves anything worth having. -bench reads every
+// entry back a number of times, from the loose files and from the archive, and reports the throughput of both.
+// Needs nothing from Windows, e.g. on Linux from the build output directory:
+//
+//	g++ -std=c++17 -O2 -I. Tools/PackAssets.cpp AssetArchive.cpp Lz4.cpp MappedFile.cpp -o PackAssets
+//	./PackAssets *.dds *.cso tank.sdkmesh tank.rig tank.lod -o assets.pak -bench 20
+//
+
+#include "AssetArchive.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	enum class CompressMode
+	{
+		None,
+		Lz4,
+		Auto,		//LZ4 for everything but DDS files
+	};
+
+	struct Options
+	{
+		std::string		output = "assets.pak";
+		CompressMode	compress = CompressMode::Auto;
+		uint32_t		alignment = AssetArchiveWriter::c_DefaultAlignment;
+		int				benchRuns = 0;
+	};
+
+	struct Input
+	{
+		std::string	path;		//on disk
+		std::string	name;		//in the archive
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: PackAssets <file or directory>... [options]\n"
+			"  -o <archive>       output path (default assets.pak)\n"
+			"  -compress <c>      none, lz4 or auto, LZ4 for everything but DDS files (default auto)\n"
+			"  -align <n>         alignment of stored entries, a power of two (default 4096)\n"
+			"  -bench <runs>      read every entry back runs times from the loose files and from the archive\n");
+	}
+
+	double Seconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return false;
+		}
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		return data.empty() || bool(file.read(reinterpret_cast<char*>(data.data()), data.size()));
+	}
+
+	bool IsDDS(const std::string& name)
+	{
+		return name.size() >= 4 && AssetArchive::NormalizeName(name.substr(name.size() - 4)) == ".dds";
+	}
+
+	bool GatherInputs(const std::string& argument, std::vector<Input>& inputs)
+	{
+		std::error_code error;
+		if (!std::filesystem::is_directory(argument, error))
+		{
+			inputs.push_back({ argument, argument });
+			return true;
+		}
+
+		std::vector<Input> found;
+		for (const auto& item : std::filesystem::directory_iterator(argument, error))
+		{
+			if (item.is_regular_file())
+			{
+				found.push_back({ item.path().string(), item.path().filename().string() });
+			}
+		}
+		if (error)
+		{
+			std::fprintf(stderr, "%s: could not list\n", argument.c_str());
+			return false;
+		}
+		// Directory order varies between systems, names keep the archive the same everywhere
+		std::sort(found.begin(), found.end(), [](const Input& a, const Input& b) { return a.name < b.name; });
+		inputs.insert(inputs.end(), found.begin(), found.end());
+		return true;
+	}
+
+	// Every entry read runs times each way. The loose files come from the OS cache after the first run, like the
+	// archive's pages, so this compares the per file overhead and LZ4 against a plain copy rather than the disk.
+	bool Bench(const std::vector<Input>& inputs, const std::string& archivePath, int runs)
+	{
+		AssetArchive archive;
+		auto start = std::chrono::steady_clock::now();
+		if (!archive.Open(archivePath))
+		{
+			std::fprintf(stderr, "%s: could not open\n", archivePath.c_str());
+			return false;
+		}
+		double openSeconds = Seconds(start);
+
+		size_t bytes = 0, compressedBytes = 0;
+		std::vector<uint8_t> data, check;
+		for (const Input& input : inputs)
+		{
+			if (!archive.Read(input.name, data) || !ReadFile(input.path, check) || data != check)
+			{
+				std::fprintf(stderr, "%s: differs in the archive\n", input.name.c_str());
+				return false;
+			}
+			bytes += data.size();
+			const AssetEntry* entry = archive.Find(input.name);
+			compressedBytes += entry->compression == AssetCompression::Lz4 ? entry->originalSize : 0;
+		}
+
+		start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; ++run)
+		{
+			for (const Input& input : inputs)
+			{
+				ReadFile(input.path, data);
+			}
+		}
+		double looseSeconds = Seconds(start);
+
+		start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; ++run)
+		{
+			for (const Input& input : inputs)
+			{
+				archive.Read(input.name, data);
+			}
+		}
+		double archiveSeconds = Seconds(start);
+
+		// Lookups alone, and the stored entries used in place the way the texture streamer does
+		start = std::chrono::steady_clock::now();
+		volatile uint8_t sink = 0;
+		for (int run = 0; run < runs; ++run)
+		{
+			for (const Input& input : inputs)
+			{
+				const AssetEntry* entry = archive.Find(input.name);
+				if (const uint8_t* stored = archive.GetStoredData(*entry))
+				{
+					for (size_t offset = 0; offset < entry->size; offset += 4096)
+					{
+						sink = sink ^ stored[offset];
+					}
+				}
+			}
+		}
+		double mappedSeconds = Seconds(start);
+
+		double megabytes = double(bytes) * runs / 1e6;
+		std::printf("bench, %d runs of %zu entries (%.1f MB, %.1f MB of it LZ4):\n", runs, inputs.size(), bytes / 1e6, compressedBytes / 1e6);
+		std::printf("  archive open     %.3f ms\n", openSeconds * 1e3);
+		std::printf("  loose files      %.3f s, %.0f MB/s, %.1f us per file\n", looseSeconds, megabytes / looseSeconds,
+			looseSeconds * 1e6 / (double(runs) * inputs.size()));
+		std::printf("  archive read     %.3f s, %.0f MB/s, %.1f us per entry\n", archiveSeconds, megabytes / archiveSeconds,
+			archiveSeconds * 1e6 / (double(runs) * inputs.size()));
+		std::printf("  archive mapped   %.3f s, lookups plus touching each page of the stored entries\n", mappedSeconds);
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	std::vector<Input> inputs;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			if (!GatherInputs(arg, inputs))
+			{
+				return 1;
+			}
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-o"))				options.output = value;
+		else if (!std::strcmp(arg, "-align"))		options.alignment = static_cast<uint32_t>(std::atoi(value));
+		else if (!std::strcmp(arg, "-bench"))		options.benchRuns = std::atoi(value);
+		else if (!std::strcmp(arg, "-compress"))
+		{
+			if (!std::strcmp(value, "none"))		options.compress = CompressMode::None;
+			else if (!std::strcmp(value, "lz4"))	options.compress = CompressMode::Lz4;
+			else if (!std::strcmp(value, "auto"))	options.compress = CompressMode::Auto;
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (inputs.empty() || !options.alignment || (options.alignment & (options.alignment - 1)))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	AssetArchiveWriter writer;
+	std::vector<uint8_t> data;
+	auto start = std::chrono::steady_clock::now();
+	for (const Input& input : inputs)
+	{
+		if (!ReadFile(input.path, data))
+		{
+			std::fprintf(stderr, "%s: could not read\n", input.path.c_str());
+			return 1;
+		}
+
+		bool compress = options.compress == CompressMode::Lz4 || (options.compress == CompressMode::Auto && !IsDDS(input.name));
+		size_t storedBefore = writer.GetStoredBytes();
+		if (!writer.Add(input.name, data.data(), data.size(), compress ? AssetCompression::Lz4 : AssetCompression::None))
+		{
+			std::fprintf(stderr, "%s: empty, too long or already in the archive\n", input.name.c_str());
+			return 1;
+		}
+		size_t stored = writer.GetStoredBytes() - storedBefore;
+		std::printf("%s: %zu bytes%s\n", input.name.c_str(), data.size(),
+			stored < data.size() ? (" -> " + std::to_string(stored) + " LZ4").c_str() : "");
+	}
+	double packSeconds = Seconds(start);
+
+	if (!writer.Write(options.output, options.alignment))
+	{
+		std::fprintf(stderr, "%s: could not write\n", options.output.c_str());
+		return 1;
+	}
+	std::printf("%s: %u entries, %zu -> %zu bytes of data, packed in %.2fs\n", options.output.c_str(), writer.GetCount(),
+		writer.GetOriginalBytes(), writer.GetStoredBytes(), packSeconds);
+
+	if (options.benchRuns > 0 && !Bench(inputs, options.output, options.benchRuns))
+	{
+		return 1;
+	}
+	return 0;
+}
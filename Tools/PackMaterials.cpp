@@ -0,0 +1,213 @@
+//
+// PackMaterials - packs the scene's surface textures into one Texture2DArray and a MaterialTable
+//
+// Every input is decoded, resampled to the same square size (the UVs of a surface cover its texture whatever shape
+// it was, so only the texel density changes) and given a full mip chain, then they are all block compressed into a
+// single array: BC1 if every input is opaque, BC3 otherwise. The table maps each input's file name to its slice, see
+// MaterialTable.h. An atlas would have needed no new shader, but the walls and floors tile their texture, which
+// wrapping inside an atlas tile can't do without bleeding into the neighbours.
+// Needs no GPU and nothing from Windows, e.g. on Linux from the repository root:
+//
+//	g++ -std=c++17 -O2 -pthread -I. Tools/PackMaterials.cpp MaterialTable.cpp BlockCompression.cpp DDSImage.cpp DDSFile.cpp MappedFile.cpp ThreadPool.cpp -o PackMaterials
+//	./PackMaterials wood.dds wallpaper.dds tile.dds space.dds GRASS.dds cobble.dds white.dds
+//
+
+#include "BlockCompression.h"
+#include "DDSImage.h"
+#include "MaterialTable.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using BlockCompression::Quality;
+
+namespace
+{
+	struct Options
+	{
+		std::string	output = "materials";		//writes <output>.dds and <output>.mat
+		uint32_t	size = 1024;
+		Quality		quality = Quality::Normal;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"usage: PackMaterials <input.dds>... [options]\n"
+			"  -o <name>          writes <name>.dds and <name>.mat (default materials)\n"
+			"  -size <n>          width and height of every slice, a multiple of 4 (default 1024)\n"
+			"  -quality <q>       fast, normal or high (default normal)\n"
+			"  -threads <n>       worker threads, 0 for one per core (default 0)\n");
+	}
+
+	// The top level of a texture as RGBA8, resampled to size x size
+	bool ReadSlice(const std::string& input, uint32_t size, std::vector<uint8_t>& slice)
+	{
+		DDSImage image;
+		if (!image.Open(input))
+		{
+			std::fprintf(stderr, "%s: could not read\n", input.c_str());
+			return false;
+		}
+
+		const DDS::TextureInfo& info = image.GetInfo();
+		if (info.depth != 1 || info.arraySize != 1)
+		{
+			std::fprintf(stderr, "%s: only single 2D textures can be packed\n", input.c_str());
+			return false;
+		}
+
+		std::vector<uint8_t> source(size_t(info.width) * info.height * 4);
+		if (!BlockCompression::DecodeImage(info.format, image.GetSurface(0)->data, info.width, info.height, source.data()))
+		{
+			std::fprintf(stderr, "%s: can't decode its format\n", input.c_str());
+			return false;
+		}
+
+		slice.resize(size_t(size) * size * 4);
+		BlockCompression::Resize(source.data(), info.width, info.height, slice.data(), size, size);
+		std::printf("%s: %ux%u, %u level%s\n", input.c_str(), info.width, info.height, info.mipCount, info.mipCount > 1 ? "s" : "");
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	unsigned threads = 0;
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		if (arg[0] != '-')
+		{
+			inputs.push_back(arg);
+			continue;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (!std::strcmp(arg, "-o"))				options.output = value;
+		else if (!std::strcmp(arg, "-size"))		options.size = static_cast<uint32_t>(std::atoi(value));
+		else if (!std::strcmp(arg, "-threads"))		threads = static_cast<unsigned>(std::atoi(value));
+		else if (!std::strcmp(arg, "-quality"))
+		{
+			if (!std::strcmp(value, "fast"))		options.quality = Quality::Fast;
+			else if (!std::strcmp(value, "normal"))	options.quality = Quality::Normal;
+			else if (!std::strcmp(value, "high"))	options.quality = Quality::High;
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+		++i;
+	}
+
+	if (inputs.empty() || inputs.size() > DDS::c_MaxArraySize || !options.size || options.size % 4 || options.size > DDS::c_MaxDimension)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	// Every slice decoded first, the format depends on whether any of them has alpha
+	MaterialTable table;
+	std::vector<std::vector<uint8_t>> slices;
+	for (const std::string& input : inputs)
+	{
+		if (table.Find(input) >= 0)
+		{
+			std::fprintf(stderr, "%s: a texture of that name is already packed\n", input.c_str());
+			return 1;
+		}
+		slices.emplace_back();
+		if (!ReadSlice(input, options.size, slices.back()))
+		{
+			return 1;
+		}
+		table.Add(input);
+	}
+
+	bool opaque = true;
+	for (const std::vector<uint8_t>& slice : slices)
+	{
+		for (size_t i = 3; i < slice.size() && opaque; i += 4)
+		{
+			opaque = slice[i] == 255;
+		}
+	}
+	uint32_t format = opaque ? DDS::FormatBC1Unorm : DDS::FormatBC3Unorm;
+
+	uint32_t mipCount = 1;
+	for (uint32_t largest = options.size; largest > 1; largest >>= 1)
+	{
+		++mipCount;
+	}
+	size_t sliceBytes = 0;
+	for (uint32_t mip = 0; mip < mipCount; ++mip)
+	{
+		uint32_t levelSize = std::max(1u, options.size >> mip);
+		sliceBytes += DDS::GetSurfaceSize(format, levelSize, levelSize);
+	}
+
+	// Item major, each slice's whole chain before the next slice
+	ThreadPool pool(threads);
+	std::vector<uint8_t> output(sliceBytes * slices.size());
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < slices.size(); ++i)
+	{
+		std::vector<uint8_t> level = std::move(slices[i]), next;
+		size_t offset = i * sliceBytes;
+		for (uint32_t mip = 0; mip < mipCount; ++mip)
+		{
+			uint32_t levelSize = std::max(1u, options.size >> mip);
+			if (mip > 0)
+			{
+				uint32_t previousSize = std::max(1u, options.size >> (mip - 1));
+				next.resize(size_t(levelSize) * levelSize * 4);
+				BlockCompression::Downsample(level.data(), previousSize, previousSize, next.data());
+				level.swap(next);
+			}
+			BlockCompression::EncodeImage(format, level.data(), levelSize, levelSize, output.data() + offset, options.quality, &pool);
+			offset += DDS::GetSurfaceSize(format, levelSize, levelSize);
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::string texturePath = options.output + ".dds";
+	std::string tablePath = options.output + ".mat";
+	size_t slash = texturePath.find_last_of("/\\");
+	table.texturePath = slash == std::string::npos ? texturePath : texturePath.substr(slash + 1);
+	if (!DDS::Write(texturePath, options.size, options.size, mipCount, format, output.data(), output.size(), table.GetCount()))
+	{
+		std::fprintf(stderr, "%s: could not write\n", texturePath.c_str());
+		return 1;
+	}
+	if (!table.Save(tablePath))
+	{
+		std::fprintf(stderr, "%s: could not write\n", tablePath.c_str());
+		return 1;
+	}
+
+	std::printf("%s: %u slices of %ux%u %s, %u levels, %zu bytes, encoded in %.2fs\n%s: %u materials\n", texturePath.c_str(),
+		table.GetCount(), options.size, options.size, opaque ? "BC1" : "BC3", mipCount, output.size(), seconds,
+		tablePath.c_str(), table.GetCount());
+	return 0;
+}
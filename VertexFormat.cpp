@@ -0,0 +1,244 @@
+// Portable vertex layout descriptor and DXBC input signature reader
+#include "VertexFormat.h"
+#include "Hash.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace
+{
+	// D3D_REGISTER_COMPONENT_TYPE values, repeated here so this file does not need the Windows headers
+	constexpr uint32_t c_ComponentUInt32 = 1;
+	constexpr uint32_t c_ComponentSInt32 = 2;
+	constexpr uint32_t c_ComponentFloat32 = 3;
+
+	uint32_t ReadU32(const uint8_t* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	bool SemanticEquals(const char* a, const char* b)
+	{
+		for (; *a && *b; ++a, ++b)
+		{
+			if (toupper(static_cast<unsigned char>(*a)) != toupper(static_cast<unsigned char>(*b)))
+				return false;
+		}
+		return *a == *b;
+	}
+
+	uint32_t ComponentTypeOf(VertexElementFormat format)
+	{
+		switch (format)
+		{
+		case VertexElementFormat::UInt1:
+		case VertexElementFormat::UByte4:
+			return c_ComponentUInt32;
+		default:
+			return c_ComponentFloat32;
+		}
+	}
+}
+
+VertexFormat::VertexFormat()
+{
+	Rehash();
+}
+
+VertexFormat& VertexFormat::Add(const char* semantic, uint32_t semanticIndex, VertexElementFormat format, uint32_t slot, bool perInstance, uint32_t instanceStepRate)
+{
+	return AddAt(GetStride(slot), semantic, semanticIndex, format, slot, perInstance, instanceStepRate);
+}
+
+VertexFormat& VertexFormat::AddAt(uint32_t offset, const char* semantic, uint32_t semanticIndex, VertexElementFormat format, uint32_t slot, bool perInstance, uint32_t instanceStepRate)
+{
+	VertexElement element;
+	memset(&element, 0, sizeof(element));
+
+	for (size_t i = 0; semantic[i] && i < sizeof(element.semantic) - 1; ++i)
+	{
+		element.semantic[i] = static_cast<char>(toupper(static_cast<unsigned char>(semantic[i])));
+	}
+	element.semanticIndex = static_cast<uint8_t>(semanticIndex);
+	element.format = format;
+	element.slot = static_cast<uint8_t>(slot);
+	element.perInstance = perInstance ? 1 : 0;
+	element.offset = offset;
+	element.instanceStepRate = perInstance ? instanceStepRate : 0;
+
+	m_elements.push_back(element);
+	Rehash();
+	return *this;
+}
+
+const VertexElement* VertexFormat::Find(const char* semantic, uint32_t semanticIndex) const
+{
+	for (const auto& element : m_elements)
+	{
+		if (element.semanticIndex == semanticIndex && SemanticEquals(element.semantic, semantic))
+			return &element;
+	}
+	return nullptr;
+}
+
+uint32_t VertexFormat::GetStride(uint32_t slot) const
+{
+	uint32_t stride = 0;
+	for (const auto& element : m_elements)
+	{
+		if (element.slot == slot)
+		{
+			uint32_t end = element.offset + GetFormatSize(element.format);
+			if (end > stride)
+				stride = end;
+		}
+	}
+	return stride;
+}
+
+bool VertexFormat::operator==(const VertexFormat& other) const
+{
+	return m_hash == other.m_hash
+		&& m_elements.size() == other.m_elements.size()
+		&& (m_elements.empty() || memcmp(m_elements.data(), other.m_elements.data(), m_elements.size() * sizeof(VertexElement)) == 0);
+}
+
+void VertexFormat::Serialize(std::vector<uint8_t>& out) const
+{
+	uint32_t count = static_cast<uint32_t>(m_elements.size());
+	size_t start = out.size();
+	out.resize(start + sizeof(count) + count * sizeof(VertexElement));
+	memcpy(out.data() + start, &count, sizeof(count));
+	if (count)
+		memcpy(out.data() + start + sizeof(count), m_elements.data(), count * sizeof(VertexElement));
+}
+
+bool VertexFormat::Deserialize(const uint8_t* data, size_t size, size_t* bytesRead)
+{
+	if (size < sizeof(uint32_t))
+		return false;
+
+	uint32_t count = ReadU32(data);
+	size_t needed = sizeof(uint32_t) + size_t(count) * sizeof(VertexElement);
+	if (count > 64 || size < needed)
+		return false;
+
+	m_elements.resize(count);
+	if (count)
+		memcpy(m_elements.data(), data + sizeof(uint32_t), count * sizeof(VertexElement));
+	Rehash();
+
+	if (bytesRead)
+		*bytesRead = needed;
+	return true;
+}
+
+uint32_t VertexFormat::GetFormatSize(VertexElementFormat format)
+{
+	switch (format)
+	{
+	case VertexElementFormat::Float1:		return 4;
+	case VertexElementFormat::Float2:		return 8;
+	case VertexElementFormat::Float3:		return 12;
+	case VertexElementFormat::Float4:		return 16;
+	case VertexElementFormat::UInt1:		return 4;
+	case VertexElementFormat::UByte4:		return 4;
+	case VertexElementFormat::UByte4Norm:	return 4;
+	case VertexElementFormat::Half2:		return 4;
+	case VertexElementFormat::Half4:		return 8;
+	default:								return 0;
+	}
+}
+
+void VertexFormat::Rehash()
+{
+	m_hash = Hash::Fnv1a(m_elements.data(), m_elements.size() * sizeof(VertexElement));
+}
+
+bool ParseShaderInputSignature(const void* bytecode, size_t size, ShaderInputSignature& signature)
+{
+	const uint8_t* blob = static_cast<const uint8_t*>(bytecode);
+
+	// DXBC header: magic, 16 byte checksum, version, total size, chunk count, chunk offsets
+	if (!blob || size < 32 || memcmp(blob, "DXBC", 4) != 0)
+		return false;
+
+	// Every size check is written as a division or subtraction that can't wrap, size_t is 32 bits on x86
+	uint32_t chunkCount = ReadU32(blob + 28);
+	if (chunkCount > (size - 32) / 4)
+		return false;
+
+	for (uint32_t c = 0; c < chunkCount; ++c)
+	{
+		uint32_t chunkOffset = ReadU32(blob + 32 + c * 4);
+		if (chunkOffset > size - 8)
+			return false;
+
+		const uint8_t* chunk = blob + chunkOffset;
+		uint32_t chunkSize = ReadU32(chunk + 4);
+		bool isg1 = memcmp(chunk, "ISG1", 4) == 0;
+		if (!isg1 && memcmp(chunk, "ISGN", 4) != 0)
+			continue;
+
+		const uint8_t* data = chunk + 8;
+		if (chunkSize > size - 8 - chunkOffset || chunkSize < 8)
+			return false;
+
+		// ISGN elements are 24 bytes, ISG1 adds a leading stream index and trailing min precision
+		uint32_t count = ReadU32(data);
+		size_t elementSize = isg1 ? 32 : 24;
+		size_t first = isg1 ? 4 : 0;
+		if (count > (chunkSize - 8) / elementSize)
+			return false;
+
+		signature.parameters.clear();
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint8_t* element = data + 8 + i * elementSize + first;
+			uint32_t nameOffset = ReadU32(element);
+			if (nameOffset >= chunkSize)
+				return false;
+
+			ShaderInputSignature::Parameter parameter;
+			const char* name = reinterpret_cast<const char*>(data + nameOffset);
+			parameter.semantic.assign(name, strnlen(name, chunkSize - nameOffset));
+			parameter.semanticIndex = ReadU32(element + 4);
+			parameter.systemValue = ReadU32(element + 8);
+			parameter.componentType = ReadU32(element + 12);
+			parameter.registerIndex = ReadU32(element + 16);
+			parameter.mask = element[20];
+			signature.parameters.push_back(parameter);
+		}
+
+		signature.hash = Hash::Fnv1a(data, chunkSize);
+		return true;
+	}
+
+	// No signature chunk means the shader takes no vertex inputs.
+	signature.parameters.clear();
+	signature.hash = Hash::c_Fnv64Offset;
+	return true;
+}
+
+bool VertexFormatMatchesSignature(const VertexFormat& format, const ShaderInputSignature& signature)
+{
+	for (const auto& parameter : signature.parameters)
+	{
+		// System values (SV_VertexID, SV_InstanceID ...) are generated by the input assembler
+		if (parameter.systemValue != 0)
+			continue;
+
+		const VertexElement* element = format.Find(parameter.semantic.c_str(), parameter.semanticIndex);
+		if (!element)
+			return false;
+
+		uint32_t type = ComponentTypeOf(element->format);
+		bool integerInput = parameter.componentType == c_ComponentUInt32 || parameter.componentType == c_ComponentSInt32;
+		bool integerElement = type != c_ComponentFloat32;
+		if (integerInput != integerElement)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,94 @@
+//
+// VertexFormat.h - Portable vertex layout descriptor
+//
+// Describes the vertex streams of a mesh without any Direct3D types so the same descriptor can be
+// used by ModelClass, written into mesh cache files and hashed by the input layout cache.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class VertexElementFormat : uint8_t
+{
+	Unknown = 0,
+	Float1,
+	Float2,
+	Float3,
+	Float4,
+	UInt1,
+	UByte4,
+	UByte4Norm,
+	Half2,
+	Half4,
+};
+
+//Single attribute of a vertex. Fixed size with no padding so it can be hashed and serialised as raw bytes.
+struct VertexElement
+{
+	char				semantic[16];		//upper case semantic name, zero padded
+	uint8_t				semanticIndex;
+	VertexElementFormat	format;
+	uint8_t				slot;				//input assembler slot
+	uint8_t				perInstance;		//1 if the element steps per instance
+	uint32_t			offset;				//byte offset within the slot
+	uint32_t			instanceStepRate;
+};
+
+class VertexFormat
+{
+public:
+	VertexFormat();
+
+	//Appends an element at the next aligned offset of its slot. Returns *this so formats can be built in one expression.
+	VertexFormat& Add(const char* semantic, uint32_t semanticIndex, VertexElementFormat format, uint32_t slot = 0, bool perInstance = false, uint32_t instanceStepRate = 0);
+	//Appends an element at an explicit byte offset, for layouts that are not tightly packed.
+	VertexFormat& AddAt(uint32_t offset, const char* semantic, uint32_t semanticIndex, VertexElementFormat format, uint32_t slot = 0, bool perInstance = false, uint32_t instanceStepRate = 0);
+
+	const std::vector<VertexElement>& GetElements() const { return m_elements; }
+	const VertexElement* Find(const char* semantic, uint32_t semanticIndex) const;
+	uint32_t GetStride(uint32_t slot = 0) const;
+	uint64_t GetHash() const { return m_hash; }
+	bool Empty() const { return m_elements.empty(); }
+
+	bool operator==(const VertexFormat& other) const;
+	bool operator!=(const VertexFormat& other) const { return !(*this == other); }
+
+	//Binary form used by the mesh cache: uint32 count followed by the raw elements.
+	void Serialize(std::vector<uint8_t>& out) const;
+	bool Deserialize(const uint8_t* data, size_t size, size_t* bytesRead = nullptr);
+
+	static uint32_t GetFormatSize(VertexElementFormat format);
+
+private:
+	void Rehash();
+
+	std::vector<VertexElement>	m_elements;
+	uint64_t					m_hash;
+};
+
+//Input parameters of a compiled vertex shader, read from the ISGN / ISG1 chunk of the DXBC container.
+struct ShaderInputSignature
+{
+	struct Parameter
+	{
+		std::string	semantic;
+		uint32_t	semanticIndex;
+		uint32_t	systemValue;		//0 for ordinary attributes, otherwise a D3D_NAME value (SV_VertexID etc.)
+		uint32_t	componentType;		//D3D_REGISTER_COMPONENT_TYPE
+		uint32_t	registerIndex;
+		uint8_t		mask;
+	};
+
+	std::vector<Parameter>	parameters;
+	uint64_t				hash = 0;		//hash of the raw signature chunk, shared by every shader with the same inputs
+};
+
+//Parses the input signature out of vertex shader bytecode. Returns false if the blob is not a valid DXBC container.
+bool ParseShaderInputSignature(const void* bytecode, size_t size, ShaderInputSignature& signature);
+
+//True if every non system-value input of the shader is supplied by the format with a compatible component type.
+bool VertexFormatMatchesSignature(const VertexFormat& format, const ShaderInputSignature& signature);
@@ -1,9 +1,67 @@
 // Light pixel shader
-// Calculate diffuse lighting for a single directional light(also texturing)
+// Calculate diffuse lighting for the shadowed main light plus every clustered light that reaches this pixel (also texturing)
 
+#ifdef MATERIAL_ARRAY
+// Every packed material in one array bound for the whole pass, the draw only picks its slice. See MaterialTable.h
+Texture2DArray materialTextures : register(t7);
+cbuffer MaterialBuffer : register(b4)
+{
+	uint materialSlice;
+	uint3 materialPadding;
+};
+#else
 Texture2D shaderTexture : register(t0);
+#endif
 SamplerState SampleType : register(s0);
 
+// Clustered lights, see PackedLight in LightManager.h
+struct PackedLight
+{
+	float4 positionRadius;
+	float4 colourIntensity;
+	float3 direction;
+	uint cone;			// half floats, cosOuter low, cosInner high. Point lights have a cone that is always open
+};
+
+StructuredBuffer<PackedLight> sceneLights : register(t1);
+StructuredBuffer<uint2> clusterRanges : register(t2);
+StructuredBuffer<uint> clusterLightIndices : register(t3);
+
+// Main light shadows, see ShadowMap.h
+Texture2DArray shadowCascades : register(t4);
+TextureCube shadowCube : register(t5);
+SamplerComparisonState shadowSampler : register(s1);
+
+#ifdef LIGHTMAPPED
+// Baked by BakeLightmaps: rgb bounced light, a the main light's N.L with static occluders
+Texture2D lightmap : register(t6);
+#endif
+
+#ifdef PROBE_LIT
+// Bounced light around the object, blended from the baked SH probes, see LightProbes.h
+cbuffer ProbeBuffer : register(b3)
+{
+	float4 shAr;
+	float4 shAg;
+	float4 shAb;
+	float4 shBr;
+	float4 shBg;
+	float4 shBb;
+	float4 shC;
+};
+
+float3 ProbeIrradiance(float3 normal)
+{
+	float4 n = float4(normal, 1.0f);
+	float3 linearTerm = float3(dot(shAr, n), dot(shAg, n), dot(shAb, n));
+
+	float4 quadratic = normal.xyzz * normal.yzzx;
+	float3 quadraticTerm = float3(dot(shBr, quadratic), dot(shBg, quadratic), dot(shBb, quadratic));
+	quadraticTerm += shC.rgb * (normal.x * normal.x - normal.y * normal.y);
+
+	return max(linearTerm + quadraticTerm, 0.0f);
+}
+#endif
 
 cbuffer LightBuffer : register(b0)
 {
@@ -13,14 +71,114 @@ cbuffer LightBuffer : register(b0)
     float padding;
 };
 
+cbuffer ClusterBuffer : register(b1)
+{
+	float2 screenSize;
+	float sliceScale;
+	float sliceBias;
+	uint tilesX;
+	uint tilesY;
+	uint slices;
+	uint lightCount;
+};
+
+cbuffer ShadowBuffer : register(b2)
+{
+	matrix cascadeViewProj[4];
+	float4 splitFar;
+	float3 shadowLightDirection;
+	uint shadowMode;				// 0 directional (cascades), 1 point (cube)
+	float3 shadowLightPosition;
+	uint cascadeCount;
+	float pointDepthScale;
+	float pointDepthBias;
+	float shadowTexelSize;
+	float shadowPadding;
+};
+
 struct InputType
 {
     float4 position : SV_POSITION;
     float2 tex : TEXCOORD0;
     float3 normal : NORMAL;
 	float3 position3D : TEXCOORD2;
+	float viewDepth : TEXCOORD3;
+#ifdef LIGHTMAPPED
+	float2 lightmapUV : TEXCOORD4;
+#endif
 };
 
+// Diffuse contribution of one clustered light, with a smooth window so it reaches zero at its radius
+float3 ClusterLightDiffuse(PackedLight light, float3 worldPosition, float3 normal)
+{
+	float3 toLight = light.positionRadius.xyz - worldPosition;
+	float distanceSq = dot(toLight, toLight);
+	float3 lightDir = toLight * rsqrt(max(distanceSq, 0.0001f));
+
+	float radius = light.positionRadius.w;
+	float window = saturate(1.0f - pow(distanceSq / (radius * radius), 2.0f));
+	float attenuation = window * window / (distanceSq + 1.0f);
+
+	// fade between the inner and outer cone, always 1 for point lights
+	float cosOuter = f16tof32(light.cone);
+	float cosInner = f16tof32(light.cone >> 16);
+	attenuation *= smoothstep(cosOuter, cosInner, dot(-lightDir, light.direction));
+
+	return light.colourIntensity.rgb * (light.colourIntensity.a * attenuation * saturate(dot(normal, lightDir)));
+}
+
+// 3x3 PCF over the cascade this pixel falls in, each tap is itself a bilinear 2x2 comparison
+float CascadeShadow(float3 worldPosition, float viewDepth)
+{
+	uint cascade = 0;
+	[unroll]
+	for (uint i = 0; i < 3; ++i)
+	{
+		cascade += (i + 1 < cascadeCount && viewDepth > splitFar[i]) ? 1 : 0;
+	}
+	if (viewDepth > splitFar[cascadeCount - 1])
+	{
+		return 1.0f;
+	}
+
+	float4 lightPos = mul(float4(worldPosition, 1.0f), cascadeViewProj[cascade]);
+	float2 uv = lightPos.xy * float2(0.5f, -0.5f) + 0.5f;
+	float depth = lightPos.z - 0.0015f;
+
+	float shadow = 0.0f;
+	[unroll]
+	for (int y = -1; y <= 1; ++y)
+	{
+		[unroll]
+		for (int x = -1; x <= 1; ++x)
+		{
+			shadow += shadowCascades.SampleCmpLevelZero(shadowSampler, float3(uv, cascade), depth, int2(x, y));
+		}
+	}
+	return shadow / 9.0f;
+}
+
+// Cube lookups can't use texel offsets, so the taps are spread around the lookup direction instead
+float PointShadow(float3 worldPosition)
+{
+	float3 toPixel = worldPosition - shadowLightPosition;
+	float3 absToPixel = abs(toPixel);
+	float majorAxis = max(absToPixel.x, max(absToPixel.y, absToPixel.z));
+	float depth = pointDepthScale + pointDepthBias / majorAxis - 0.0005f;
+
+	float3 direction = normalize(toPixel);
+	float3 side = normalize(cross(direction, abs(direction.y) < 0.99f ? float3(0, 1, 0) : float3(1, 0, 0)));
+	float3 up = cross(direction, side);
+	float spread = majorAxis * 0.004f;
+
+	float shadow = shadowCube.SampleCmpLevelZero(shadowSampler, toPixel, depth);
+	shadow += shadowCube.SampleCmpLevelZero(shadowSampler, toPixel + side * spread, depth);
+	shadow += shadowCube.SampleCmpLevelZero(shadowSampler, toPixel - side * spread, depth);
+	shadow += shadowCube.SampleCmpLevelZero(shadowSampler, toPixel + up * spread, depth);
+	shadow += shadowCube.SampleCmpLevelZero(shadowSampler, toPixel - up * spread, depth);
+	return shadow / 5.0f;
+}
+
 float4 main(InputType input) : SV_TARGET
 {
 	float4	textureColor;
@@ -28,20 +186,51 @@ float4 main(InputType input) : SV_TARGET
     float	lightIntensity;
     float4	color;
 
-	// Invert the light direction for calculations.
-	lightDir = normalize(input.position3D - lightPosition);
+#ifdef LIGHTMAPPED
+	// Static surfaces take N.L and the bounces from the bake. The shadow map is still applied so the dynamic
+	// objects keep their shadows; where a static object already blocks the light the baked term is zero anyway.
+	float4 baked = lightmap.Sample(SampleType, input.lightmapUV);
+	lightIntensity = baked.a;
+	lightIntensity *= shadowMode == 0 ? CascadeShadow(input.position3D, input.viewDepth) : PointShadow(input.position3D);
+
+	color = ambientColor + (diffuseColor * lightIntensity) + float4(baked.rgb, 0.0f);
+#else
+	// Invert the light direction for calculations. The cascaded shadows are for the main light used as a directional light.
+	lightDir = shadowMode == 0 ? normalize(shadowLightDirection) : normalize(input.position3D - lightPosition);
 
-	// Calculate the amount of light on this pixel.
+	// Calculate the amount of light on this pixel, less whatever the main light's shadow map hides.
 	lightIntensity = saturate(dot(input.normal, -lightDir));
+	lightIntensity *= shadowMode == 0 ? CascadeShadow(input.position3D, input.viewDepth) : PointShadow(input.position3D);
 
 	// Determine the final amount of diffuse color based on the diffuse color combined with the light intensity.
 	color = ambientColor + (diffuseColor * lightIntensity); //adding ambient
+
+#ifdef PROBE_LIT
+	// the main light stays real time, the probes add what bounces off the static scene
+	color.rgb += ProbeIrradiance(normalize(input.normal));
+#endif
+#endif
+
+	// Find this pixel's cluster and add the lights binned into it
+	uint2 tile = min(uint2(input.position.xy / screenSize * float2(tilesX, tilesY)), uint2(tilesX - 1, tilesY - 1));
+	uint slice = (uint)clamp(log(max(input.viewDepth, 0.0001f)) * sliceScale + sliceBias, 0.0f, (float)(slices - 1));
+	uint2 range = clusterRanges[(slice * tilesY + tile.y) * tilesX + tile.x];
+
+	for (uint i = 0; i < range.y; ++i)
+	{
+		PackedLight light = sceneLights[clusterLightIndices[range.x + i]];
+		color.rgb += ClusterLightDiffuse(light, input.position3D, input.normal);
+	}
+
 	color = saturate(color);
 
 	// Sample the pixel color from the texture using the sampler at this texture coordinate location.
+#ifdef MATERIAL_ARRAY
+	textureColor = materialTextures.Sample(SampleType, float3(input.tex, materialSlice));
+#else
 	textureColor = shaderTexture.Sample(SampleType, input.tex);
+#endif
 	color = color * textureColor;
 
     return color;
 }
-
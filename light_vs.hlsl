@@ -8,11 +8,27 @@ cbuffer MatrixBuffer : register(b0)
     matrix projectionMatrix;
 };
 
+#ifdef BONE_PALETTE
+// Each bone's transform times the world, the first three columns as rows. See BonePaletteModel.h
+struct PaletteBone
+{
+	float4 rows[3];
+};
+
+StructuredBuffer<PaletteBone> bonePalette : register(t0);
+#endif
+
 struct InputType
 {
     float4 position : POSITION;
     float2 tex : TEXCOORD0;
     float3 normal : NORMAL;
+#ifdef LIGHTMAPPED
+	float2 lightmapUV : TEXCOORD1;
+#endif
+#ifdef BONE_PALETTE
+	uint boneIndex : BONEINDEX;		// per instance, the draw's start instance picks the part's bone
+#endif
 };
 
 struct OutputType
@@ -21,6 +37,10 @@ struct OutputType
     float2 tex : TEXCOORD0;
     float3 normal : NORMAL;
 	float3 position3D : TEXCOORD2;
+	float viewDepth : TEXCOORD3;
+#ifdef LIGHTMAPPED
+	float2 lightmapUV : TEXCOORD4;
+#endif
 };
 
 OutputType main(InputType input)
@@ -29,22 +49,44 @@ OutputType main(InputType input)
     
     input.position.w = 1.0f;
 
+#ifdef BONE_PALETTE
+	// the palette holds the world already, worldMatrix isn't used
+	PaletteBone bone = bonePalette[input.boneIndex];
+	float4 worldPosition = float4(dot(bone.rows[0], input.position), dot(bone.rows[1], input.position), dot(bone.rows[2], input.position), 1.0f);
+	float3 worldNormal = float3(dot(bone.rows[0].xyz, input.normal), dot(bone.rows[1].xyz, input.normal), dot(bone.rows[2].xyz, input.normal));
+#else
+	float4 worldPosition = mul(input.position, worldMatrix);
+	float3 worldNormal = mul(input.normal, (float3x3)worldMatrix);
+#endif
+
     // Calculate the position of the vertex against the world, view, and projection matrices.
-    output.position = mul(input.position, worldMatrix);
-    output.position = mul(output.position, viewMatrix);
+    output.position = mul(worldPosition, viewMatrix);
+
+	// distance in front of the camera, used to find the light cluster (right handed view looks down -z)
+	output.viewDepth = -output.position.z;
+
     output.position = mul(output.position, projectionMatrix);
     
     // Store the texture coordinates for the pixel shader.
+#if defined(PROBE_LIT) || defined(BONE_PALETTE)
+	// primitives and the tank aren't tiled
+	output.tex = input.tex;
+#else
     output.tex = input.tex * 2;
+#endif
 
 	 // Calculate the normal vector against the world matrix only.
-    output.normal = mul(input.normal, (float3x3)worldMatrix);
+    output.normal = worldNormal;
 	
     // Normalize the normal vector.
     output.normal = normalize(output.normal);
 
 	// world position of vertex (for point light)
-	output.position3D = (float3)mul(input.position, worldMatrix);
+	output.position3D = worldPosition.xyz;
+
+#ifdef LIGHTMAPPED
+	output.lightmapUV = input.lightmapUV;
+#endif
 
     return output;
 }
\ No newline at end of file
@@ -0,0 +1,6 @@
+// Lightmapped material array pixel shader
+// lightmap_ps with the texture taken from a slice of the packed material array, see MaterialArray.h
+
+#define LIGHTMAPPED
+#define MATERIAL_ARRAY
+#include "light_ps.hlsl"
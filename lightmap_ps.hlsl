@@ -0,0 +1,5 @@
+// Lightmap pixel shader
+// light_ps with the main light and its bounces read from the baked lightmap
+
+#define LIGHTMAPPED
+#include "light_ps.hlsl"
@@ -0,0 +1,5 @@
+// Lightmap vertex shader
+// light_vs with the lightmap uvs from vertex slot 1 passed through
+
+#define LIGHTMAPPED
+#include "light_vs.hlsl"
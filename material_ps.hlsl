@@ -0,0 +1,5 @@
+// Material array pixel shader
+// light_ps with the texture taken from a slice of the packed material array, see MaterialArray.h
+
+#define MATERIAL_ARRAY
+#include "light_ps.hlsl"
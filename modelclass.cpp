@@ -11,6 +11,8 @@ ModelClass::ModelClass()
 {
 	m_vertexBuffer = 0;
 	m_indexBuffer = 0;
+	m_lightmapBuffer = 0;
+	m_lodIndexBuffer = 0;
 
 }
 ModelClass::~ModelClass()
@@ -121,10 +123,19 @@ void ModelClass::Shutdown()
 }
 
 
-void ModelClass::Render(ID3D11DeviceContext* deviceContext)
+void ModelClass::Render(ID3D11DeviceContext* deviceContext, uint32_t lod)
 {
 	// Put the vertex and index buffers on the graphics pipeline to prepare them for drawing.
 	RenderBuffers(deviceContext);
+
+	// A coarser level is a run of the lod index buffer over the same vertices.
+	if (lod > 0 && !m_lods.empty())
+	{
+		const LodLevel& level = m_lods[lod < m_lods.size() ? lod : m_lods.size() - 1];
+		deviceContext->IASetIndexBuffer(m_lodIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		deviceContext->DrawIndexed(level.indexCount, level.indexStart, 0);
+		return;
+	}
 	deviceContext->DrawIndexed(m_indexCount, 0, 0);
 
 	return;
@@ -136,6 +147,103 @@ int ModelClass::GetIndexCount()
 	return m_indexCount;
 }
 
+void ModelClass::GetBounds(DirectX::SimpleMath::Vector3& boundsMin, DirectX::SimpleMath::Vector3& boundsMax)
+{
+	boundsMin = m_boundsMin;
+	boundsMax = m_boundsMax;
+}
+
+const VertexFormat& ModelClass::GetVertexFormat()
+{
+	static const VertexFormat format = VertexFormat()
+		.Add("POSITION", 0, VertexElementFormat::Float3)
+		.Add("TEXCOORD", 0, VertexElementFormat::Float2)
+		.Add("NORMAL", 0, VertexElementFormat::Float3);
+	return format;
+}
+
+const VertexFormat& ModelClass::GetLightmappedVertexFormat()
+{
+	static const VertexFormat format = VertexFormat(GetVertexFormat())
+		.Add("TEXCOORD", 1, VertexElementFormat::Float2, 1);
+	return format;
+}
+
+bool ModelClass::SetLightmapUVs(ID3D11Device* device, const std::vector<float>& uvs)
+{
+	D3D11_BUFFER_DESC lightmapBufferDesc;
+	D3D11_SUBRESOURCE_DATA lightmapData;
+
+	if (uvs.size() != size_t(m_vertexCount) * 2)
+	{
+		return false;
+	}
+
+	if (m_lightmapBuffer)
+	{
+		m_lightmapBuffer->Release();
+		m_lightmapBuffer = 0;
+	}
+
+	// Set up the description of the static lightmap uv buffer.
+	lightmapBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	lightmapBufferDesc.ByteWidth = static_cast<UINT>(sizeof(float) * uvs.size());
+	lightmapBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	lightmapBufferDesc.CPUAccessFlags = 0;
+	lightmapBufferDesc.MiscFlags = 0;
+	lightmapBufferDesc.StructureByteStride = 0;
+
+	lightmapData.pSysMem = uvs.data();
+	lightmapData.SysMemPitch = 0;
+	lightmapData.SysMemSlicePitch = 0;
+
+	return SUCCEEDED(device->CreateBuffer(&lightmapBufferDesc, &lightmapData, &m_lightmapBuffer));
+}
+
+bool ModelClass::SetLods(ID3D11Device* device, const LodChain& chain)
+{
+	D3D11_BUFFER_DESC lodBufferDesc;
+	D3D11_SUBRESOURCE_DATA lodData;
+
+	if (chain.GetLevelCount() < 2 || chain.GetVertexCount() != uint32_t(m_vertexCount)
+		|| chain.GetLevel(0).indexCount != uint32_t(m_indexCount))
+	{
+		return false;
+	}
+
+	if (m_lodIndexBuffer)
+	{
+		m_lodIndexBuffer->Release();
+		m_lodIndexBuffer = 0;
+	}
+	m_lods.clear();
+	m_lodErrors.clear();
+
+	// Set up the description of the static lod index buffer, every level of the chain in one.
+	lodBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	lodBufferDesc.ByteWidth = static_cast<UINT>(sizeof(uint32_t) * chain.GetIndices().size());
+	lodBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	lodBufferDesc.CPUAccessFlags = 0;
+	lodBufferDesc.MiscFlags = 0;
+	lodBufferDesc.StructureByteStride = 0;
+
+	lodData.pSysMem = chain.GetIndices().data();
+	lodData.SysMemPitch = 0;
+	lodData.SysMemSlicePitch = 0;
+
+	if (FAILED(device->CreateBuffer(&lodBufferDesc, &lodData, &m_lodIndexBuffer)))
+	{
+		return false;
+	}
+
+	for (uint32_t level = 0; level < chain.GetLevelCount(); level++)
+	{
+		m_lods.push_back(chain.GetLevel(level));
+		m_lodErrors.push_back(chain.GetLevel(level).error);
+	}
+	return true;
+}
+
 
 bool ModelClass::InitializeBuffers(ID3D11Device* device)
 {
@@ -172,6 +280,15 @@ bool ModelClass::InitializeBuffers(ID3D11Device* device)
 		indices[i] = preFabIndices[i];
 	}
 
+	// Bounds for culling, left empty at the origin if nothing was loaded
+	m_boundsMin = m_vertexCount ? vertices[0].position : DirectX::SimpleMath::Vector3::Zero;
+	m_boundsMax = m_boundsMin;
+	for (i = 1; i < m_vertexCount; i++)
+	{
+		m_boundsMin = DirectX::SimpleMath::Vector3::Min(m_boundsMin, vertices[i].position);
+		m_boundsMax = DirectX::SimpleMath::Vector3::Max(m_boundsMax, vertices[i].position);
+	}
+
 	// Set up the description of the static vertex buffer.
     vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
     vertexBufferDesc.ByteWidth = sizeof(VertexType) * m_vertexCount;
@@ -225,6 +342,22 @@ bool ModelClass::InitializeBuffers(ID3D11Device* device)
 
 void ModelClass::ShutdownBuffers()
 {
+	// Release the lightmap uv buffer.
+	if (m_lightmapBuffer)
+	{
+		m_lightmapBuffer->Release();
+		m_lightmapBuffer = 0;
+	}
+
+	// Release the lod index buffer.
+	if (m_lodIndexBuffer)
+	{
+		m_lodIndexBuffer->Release();
+		m_lodIndexBuffer = 0;
+	}
+	m_lods.clear();
+	m_lodErrors.clear();
+
 	// Release the index buffer.
 	if(m_indexBuffer)
 	{
@@ -255,6 +388,13 @@ void ModelClass::RenderBuffers(ID3D11DeviceContext* deviceContext)
 	// Set the vertex buffer to active in the input assembler so it can be rendered.
 	deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
 
+	// Lightmap uvs go alongside in slot 1, only read by the lightmapped shaders.
+	if (m_lightmapBuffer)
+	{
+		stride = sizeof(float) * 2;
+		deviceContext->IASetVertexBuffers(1, 1, &m_lightmapBuffer, &stride, &offset);
+	}
+
     // Set the index buffer to active in the input assembler so it can be rendered.
 	deviceContext->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
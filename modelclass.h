@@ -9,6 +9,8 @@
 // INCLUDES //
 //////////////
 #include "pch.h"
+#include "LodChain.h"
+#include "VertexFormat.h"
 //#include <d3dx10math.h>
 //#include <fstream>
 //using namespace std;
@@ -40,10 +42,33 @@ public:
 	bool InitializeBox(ID3D11Device*, float xwidth, float yheight, float zdepth);
 	bool InitializeCustom(ID3D11DeviceContext*);
 	void Shutdown();
-	void Render(ID3D11DeviceContext*);
+	void Render(ID3D11DeviceContext*, uint32_t lod = 0);
 	
 	int GetIndexCount();
 
+	//Object space bounding box of the loaded vertices
+	void GetBounds(DirectX::SimpleMath::Vector3& boundsMin, DirectX::SimpleMath::Vector3& boundsMax);
+
+	//Layout of VertexType, used to fetch matching input layouts from the InputLayoutCache
+	static const VertexFormat& GetVertexFormat();
+	//VertexType plus the lightmap UVs in slot 1
+	static const VertexFormat& GetLightmappedVertexFormat();
+
+	//CPU copy of the geometry, for exporting to the light baker
+	const std::vector<VertexPositionNormalTexture>& GetVertices() const { return preFabVertices; }
+	const std::vector<uint16_t>& GetIndices() const { return preFabIndices; }
+
+	//Second vertex stream with one uv pair per vertex, bound to slot 1 whenever the model renders
+	bool SetLightmapUVs(ID3D11Device* device, const std::vector<float>& uvs);
+	bool HasLightmapUVs() const { return m_lightmapBuffer != 0; }
+
+	//Coarser index runs over the loaded vertices from Tools/BuildLods, Render's lod picks one. False unless the chain
+	//was built from this model's vertices and triangles.
+	bool SetLods(ID3D11Device* device, const LodChain& chain);
+	uint32_t GetLodCount() const { return m_lods.empty() ? 1 : static_cast<uint32_t>(m_lods.size()); }
+	//Each level's error in object space, for LodSelector::Select
+	const float* GetLodErrors() const { return m_lodErrors.data(); }
+
 
 private:
 	bool InitializeBuffers(ID3D11Device*);
@@ -54,8 +79,11 @@ private:
 	void ReleaseModel();
 
 private:
-	ID3D11Buffer *m_vertexBuffer, *m_indexBuffer;
+	ID3D11Buffer *m_vertexBuffer, *m_indexBuffer, *m_lightmapBuffer, *m_lodIndexBuffer;
 	int m_vertexCount, m_indexCount;
+	DirectX::SimpleMath::Vector3 m_boundsMin, m_boundsMax;
+	std::vector<LodLevel> m_lods;
+	std::vector<float> m_lodErrors;
 
 	//arrays for our generated objects Made by directX
 	std::vector<VertexPositionNormalTexture> preFabVertices;
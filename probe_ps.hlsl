@@ -0,0 +1,5 @@
+// Probe lit pixel shader
+// light_ps with the bounced light taken from the SH probes around the object, see LightProbes.h
+
+#define PROBE_LIT
+#include "light_ps.hlsl"
@@ -0,0 +1,5 @@
+// Probe lit vertex shader
+// light_vs for the objects lit by the SH probes, see LightProbes.h
+
+#define PROBE_LIT
+#include "light_vs.hlsl"
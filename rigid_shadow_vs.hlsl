@@ -0,0 +1,5 @@
+// Rigid shadow vertex shader
+// shadow_vs for the tank, every part placed by its bone from the palette, see BonePaletteModel.h
+
+#define BONE_PALETTE
+#include "shadow_vs.hlsl"
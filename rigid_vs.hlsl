@@ -0,0 +1,5 @@
+// Rigid vertex shader
+// light_vs for the tank, every part placed by its bone from the palette, see BonePaletteModel.h
+
+#define BONE_PALETTE
+#include "light_vs.hlsl"
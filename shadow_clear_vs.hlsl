@@ -0,0 +1,8 @@
+// Shadow clear vertex shader
+// Triangle covering the whole target at the far plane, drawn under a scissor rect to clear part of a cached shadow map
+
+float4 main(uint id : SV_VertexID) : SV_POSITION
+{
+    float2 uv = float2((id << 1) & 2, id & 2);
+    return float4(uv.x * 2.0f - 1.0f, 1.0f - uv.y * 2.0f, 1.0f, 1.0f);
+}
@@ -0,0 +1,41 @@
+// Shadow vertex shader
+// Depth only pass for the shadow casters, the projection holds the light's view * projection
+
+cbuffer MatrixBuffer : register(b0)
+{
+    matrix worldMatrix;
+    matrix viewMatrix;
+    matrix projectionMatrix;
+};
+
+#ifdef BONE_PALETTE
+// Each bone's transform times the world, see light_vs and BonePaletteModel.h
+struct PaletteBone
+{
+	float4 rows[3];
+};
+
+StructuredBuffer<PaletteBone> bonePalette : register(t0);
+#endif
+
+struct InputType
+{
+    float4 position : POSITION;
+#ifdef BONE_PALETTE
+	uint boneIndex : BONEINDEX;
+#endif
+};
+
+float4 main(InputType input) : SV_POSITION
+{
+    input.position.w = 1.0f;
+
+#ifdef BONE_PALETTE
+	PaletteBone bone = bonePalette[input.boneIndex];
+	float4 position = float4(dot(bone.rows[0], input.position), dot(bone.rows[1], input.position), dot(bone.rows[2], input.position), 1.0f);
+#else
+    float4 position = mul(input.position, worldMatrix);
+#endif
+    position = mul(position, viewMatrix);
+    return mul(position, projectionMatrix);
+}